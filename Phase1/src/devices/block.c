@@ -4,6 +4,7 @@
 #include <stdio.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
+#include "threads/percpu.h"
 
 /* A block device. */
 struct block
@@ -17,8 +18,8 @@ struct block
     const struct block_operations *ops;  /* Driver operations. */
     void *aux;                          /* Extra data owned by driver. */
 
-    unsigned long long read_cnt;        /* Number of sectors read. */
-    unsigned long long write_cnt;       /* Number of sectors written. */
+    struct percpu_counter read_cnt;     /* Number of sectors read. */
+    struct percpu_counter write_cnt;    /* Number of sectors written. */
   };
 
 /* List of all block devices. */
@@ -122,7 +123,7 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 {
   check_sector (block, sector);
   block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  percpu_inc (&block->read_cnt);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -136,7 +137,7 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
   block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  percpu_inc (&block->write_cnt);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -171,9 +172,10 @@ block_print_stats (void)
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
-          printf ("%s (%s): %llu reads, %llu writes\n",
+          printf ("%s (%s): %lld reads, %lld writes\n",
                   block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
+                  percpu_sum (&block->read_cnt),
+                  percpu_sum (&block->write_cnt));
         }
     }
 }
@@ -198,8 +200,8 @@ block_register (const char *name, enum block_type type,
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
+  percpu_reset (&block->read_cnt);
+  percpu_reset (&block->write_cnt);
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -0,0 +1,57 @@
+#include "devices/ioapic.h"
+#include <debug.h>
+#include "threads/init.h"
+
+/* I/O APIC.  On a multiprocessor the I/O APIC, rather than the
+   8259 PIC, can route each device interrupt to any processor's
+   local APIC.  Refer to the Intel 82093AA I/O APIC data sheet.
+
+   Pintos keeps taking device interrupts from the PIC, which
+   BIOSes leave connected to the bootstrap processor in "virtual
+   wire" mode, so all we do here is make sure the I/O APIC does
+   not deliver the same interrupts a second time. */
+
+/* Registers, reached by writing the register's index into
+   IOREGSEL and then accessing IOWIN. */
+#define IOREGSEL 0x00
+#define IOWIN    0x10
+
+#define IOAPIC_ID    0x00       /* I/O APIC ID. */
+#define IOAPIC_VER   0x01       /* Version and entry count. */
+#define IOAPIC_REDTBL(N) (0x10 + 2 * (N))   /* Redirection entry N. */
+
+/* Redirection entry bits. */
+#define REDTBL_MASKED 0x00010000   /* Interrupt masked. */
+
+/* Virtual address of the registers. */
+static volatile uint32_t *ioapic;
+
+static uint32_t
+ioapic_read (uint32_t reg)
+{
+  ioapic[IOREGSEL / sizeof *ioapic] = reg;
+  return ioapic[IOWIN / sizeof *ioapic];
+}
+
+static void
+ioapic_write (uint32_t reg, uint32_t value)
+{
+  ioapic[IOREGSEL / sizeof *ioapic] = reg;
+  ioapic[IOWIN / sizeof *ioapic] = value;
+}
+
+/* Maps the I/O APIC at physical address PHYS and masks every
+   interrupt it could deliver. */
+void
+ioapic_init (uintptr_t phys)
+{
+  int entry_cnt, i;
+
+  ioapic = paging_map_io (phys);
+  entry_cnt = ((ioapic_read (IOAPIC_VER) >> 16) & 0xff) + 1;
+  for (i = 0; i < entry_cnt; i++)
+    {
+      ioapic_write (IOAPIC_REDTBL (i), REDTBL_MASKED);
+      ioapic_write (IOAPIC_REDTBL (i) + 1, 0);
+    }
+}
@@ -0,0 +1,8 @@
+#ifndef DEVICES_IOAPIC_H
+#define DEVICES_IOAPIC_H
+
+#include <stdint.h>
+
+void ioapic_init (uintptr_t phys);
+
+#endif /* devices/ioapic.h */
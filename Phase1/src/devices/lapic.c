@@ -0,0 +1,255 @@
+#include "devices/lapic.h"
+#include <debug.h>
+#include <stddef.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "devices/timer.h"
+
+/* Local APIC.  Every processor has one, at the same physical
+   address, through which it receives interrupts and sends them
+   to the other processors.  Refer to [IA32-v3a] chapter 10
+   "Advanced Programmable Interrupt Controller (APIC)". */
+
+/* Register offsets, in bytes from the base. */
+#define LAPIC_ID     0x020      /* Local APIC ID. */
+#define LAPIC_VER    0x030      /* Version. */
+#define LAPIC_TPR    0x080      /* Task priority. */
+#define LAPIC_EOI    0x0b0      /* End of interrupt. */
+#define LAPIC_SVR    0x0f0      /* Spurious interrupt vector. */
+#define LAPIC_ESR    0x280      /* Error status. */
+#define LAPIC_ICRLO  0x300      /* Interrupt command, low half. */
+#define LAPIC_ICRHI  0x310      /* Interrupt command, high half. */
+#define LAPIC_TIMER  0x320      /* Local vector table: timer. */
+#define LAPIC_LINT0  0x350      /* Local vector table: LINT0 pin. */
+#define LAPIC_LINT1  0x360      /* Local vector table: LINT1 pin. */
+#define LAPIC_ERROR  0x370      /* Local vector table: errors. */
+#define LAPIC_TICR   0x380      /* Timer initial count. */
+#define LAPIC_TCCR   0x390      /* Timer current count. */
+#define LAPIC_TDCR   0x3e0      /* Timer divide configuration. */
+
+/* TDCR values. */
+#define TDCR_DIV16   0x00000003 /* Count once every 16 bus cycles. */
+
+/* SVR bits. */
+#define SVR_ENABLE   0x00000100 /* Software enable. */
+
+/* Local vector table and ICR bits. */
+#define LVT_MASKED   0x00010000 /* Interrupt masked. */
+#define DM_FIXED     0x00000000 /* Delivery mode: fixed vector. */
+#define DM_NMI       0x00000400 /* Delivery mode: NMI. */
+#define DM_INIT      0x00000500 /* Delivery mode: INIT. */
+#define DM_STARTUP   0x00000600 /* Delivery mode: start-up. */
+#define DM_EXTINT    0x00000700 /* Delivery mode: from 8259 PIC. */
+#define ICR_PENDING  0x00001000 /* Delivery status: send pending. */
+#define ICR_ASSERT   0x00004000 /* Level assert. */
+#define ICR_LEVEL    0x00008000 /* Level triggered. */
+#define ICR_OTHERS   0x000c0000 /* Destination: all but ourselves. */
+
+/* Virtual address of the registers, or a null pointer if no
+   local APIC has been found. */
+static volatile uint32_t *lapic;
+
+/* Local APIC timer counts per second, or 0 if not calibrated. */
+static uint64_t timer_hz;
+
+static intr_handler_func spurious_interrupt;
+
+/* Returns the value of the register at byte offset REG. */
+static inline uint32_t
+lapic_read (size_t reg)
+{
+  return lapic[reg / sizeof *lapic];
+}
+
+/* Sets the register at byte offset REG to VALUE, then waits for
+   the write to finish by reading back the ID register. */
+static inline void
+lapic_write (size_t reg, uint32_t value)
+{
+  lapic[reg / sizeof *lapic] = value;
+  (void) lapic[LAPIC_ID / sizeof *lapic];
+}
+
+/* Makes the local APIC registers, at physical address PHYS,
+   accessible. */
+void
+lapic_map (uintptr_t phys)
+{
+  lapic = paging_map_io (phys);
+}
+
+/* Returns true if lapic_map() has been called. */
+bool
+lapic_present (void)
+{
+  return lapic != NULL;
+}
+
+/* Enables the calling processor's local APIC.  Program
+   interrupts still come from the 8259 PIC, which is wired to the
+   bootstrap processor's LINT0 pin (BSP is true for the bootstrap
+   processor); the other processors ignore it. */
+void
+lapic_init (bool bsp)
+{
+  static bool registered;
+
+  ASSERT (lapic_present ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!registered)
+    {
+      intr_register_int (LAPIC_SPURIOUS_VEC, 0, INTR_OFF,
+                         spurious_interrupt, "APIC Spurious");
+      registered = true;
+    }
+
+  lapic_write (LAPIC_SVR, SVR_ENABLE | LAPIC_SPURIOUS_VEC);
+  lapic_write (LAPIC_TIMER, LVT_MASKED);
+  lapic_write (LAPIC_LINT0, bsp ? DM_EXTINT : LVT_MASKED);
+  lapic_write (LAPIC_LINT1, bsp ? DM_NMI : LVT_MASKED);
+  lapic_write (LAPIC_ERROR, LVT_MASKED);
+
+  /* Clear errors; the register latches on a write. */
+  lapic_write (LAPIC_ESR, 0);
+  lapic_write (LAPIC_ESR, 0);
+
+  /* Accept interrupts of every priority. */
+  lapic_write (LAPIC_TPR, 0);
+}
+
+/* Returns the calling processor's local APIC ID. */
+uint8_t
+lapic_id (void)
+{
+  ASSERT (lapic_present ());
+  return lapic_read (LAPIC_ID) >> 24;
+}
+
+/* Acknowledges an interrupt delivered by the local APIC. */
+void
+lapic_eoi (void)
+{
+  if (lapic_present ())
+    lapic_write (LAPIC_EOI, 0);
+}
+
+/* Sends the interprocessor interrupt described by LOW to the
+   processor with local APIC ID APIC_ID and waits for it to be
+   accepted. */
+static void
+send_ipi (uint8_t apic_id, uint32_t low)
+{
+  lapic_write (LAPIC_ICRHI, (uint32_t) apic_id << 24);
+  lapic_write (LAPIC_ICRLO, low);
+  while (lapic_read (LAPIC_ICRLO) & ICR_PENDING)
+    continue;
+}
+
+/* Sends interrupt VEC to the processor whose local APIC ID is
+   APIC_ID. */
+void
+lapic_send_ipi (uint8_t apic_id, uint8_t vec)
+{
+  send_ipi (apic_id, DM_FIXED | vec);
+}
+
+/* Sends interrupt VEC to every processor but the caller. */
+void
+lapic_broadcast_ipi (uint8_t vec)
+{
+  send_ipi (0, ICR_OTHERS | DM_FIXED | vec);
+}
+
+/* Resets the processor whose local APIC ID is APIC_ID, leaving
+   it waiting for a start-up interrupt.  The caller should wait
+   10 ms before sending one. */
+void
+lapic_send_init (uint8_t apic_id)
+{
+  send_ipi (apic_id, DM_INIT | ICR_LEVEL | ICR_ASSERT);
+  send_ipi (apic_id, DM_INIT | ICR_LEVEL);
+}
+
+/* Starts the processor whose local APIC ID is APIC_ID running
+   in real mode at physical address PHYS, which must be
+   page-aligned and below 1 MB.  [IA32-v3a] 8.4.4.1 "Typical BSP
+   Initialization Sequence" sends it twice, 200 us apart. */
+void
+lapic_send_startup (uint8_t apic_id, uintptr_t phys)
+{
+  ASSERT ((phys & 0xfff) == 0 && phys < 0x100000);
+  send_ipi (apic_id, DM_STARTUP | (phys >> 12));
+}
+
+/* Measures the rate of the calling processor's local APIC timer
+   against the PIT, over a few timer ticks.  Interrupts must be
+   on.  Every processor's timer runs at the same rate, that of
+   the bus. */
+void
+lapic_timer_calibrate (void)
+{
+  const int calib_ticks = 5;
+  uint32_t counted;
+  int64_t start;
+
+  ASSERT (lapic_present ());
+  ASSERT (intr_get_level () == INTR_ON);
+
+  lapic_write (LAPIC_TDCR, TDCR_DIV16);
+  lapic_write (LAPIC_TIMER, LVT_MASKED);
+
+  /* Start counting on a tick boundary. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  lapic_write (LAPIC_TICR, UINT32_MAX);
+  start = timer_ticks ();
+  while (timer_elapsed (start) < calib_ticks)
+    continue;
+  counted = UINT32_MAX - lapic_read (LAPIC_TCCR);
+  lapic_write (LAPIC_TICR, 0);
+
+  timer_hz = (uint64_t) counted * TIMER_FREQ / calib_ticks;
+}
+
+/* Returns true if lapic_timer_calibrate() has been called, so
+   that lapic_timer_oneshot() will work. */
+bool
+lapic_timer_present (void)
+{
+  return timer_hz != 0;
+}
+
+/* Arranges for the calling processor's local APIC timer to
+   interrupt once, on LAPIC_TIMER_VEC, about NS nanoseconds from
+   now, cancelling any earlier request.  Returns false, doing
+   nothing, if the timer has not been calibrated. */
+bool
+lapic_timer_oneshot (int64_t ns)
+{
+  uint64_t count;
+
+  if (timer_hz == 0)
+    return false;
+
+  /* Past about ten seconds the count would not fit anyway. */
+  if (ns > 10000000000LL)
+    ns = 10000000000LL;
+  count = ns <= 0 ? 1 : (uint64_t) ns * timer_hz / 1000000000;
+  if (count == 0)
+    count = 1;
+  else if (count > UINT32_MAX)
+    count = UINT32_MAX;
+
+  lapic_write (LAPIC_TDCR, TDCR_DIV16);
+  lapic_write (LAPIC_TIMER, LAPIC_TIMER_VEC);
+  lapic_write (LAPIC_TICR, count);
+  return true;
+}
+
+/* Spurious interrupt handler.  Nothing to do, not even EOI. */
+static void
+spurious_interrupt (struct intr_frame *f UNUSED)
+{
+}
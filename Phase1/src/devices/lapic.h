@@ -0,0 +1,34 @@
+#ifndef DEVICES_LAPIC_H
+#define DEVICES_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Interrupts delivered by the local APIC: interprocessor
+   interrupts and the local APIC timer.  intr_register_lapic()
+   accepts vectors from LAPIC_VEC_MIN up to LAPIC_VEC_MAX. */
+#define LAPIC_VEC_MIN 0xf0
+#define LAPIC_IPI_RESCHEDULE 0xf0   /* Run the scheduler. */
+#define LAPIC_IPI_TICK 0xf1         /* Forwarded timer tick. */
+#define LAPIC_TIMER_VEC 0xf2        /* Local APIC timer expired. */
+#define LAPIC_IPI_TLB 0xf3          /* Flush stale TLB entries. */
+#define LAPIC_VEC_MAX 0xfe
+
+/* Interrupt the local APIC raises when it drops an interrupt
+   it was about to deliver.  Needs no EOI. */
+#define LAPIC_SPURIOUS_VEC 0xff
+
+void lapic_map (uintptr_t phys);
+bool lapic_present (void);
+void lapic_init (bool bsp);
+uint8_t lapic_id (void);
+void lapic_eoi (void);
+void lapic_send_ipi (uint8_t apic_id, uint8_t vec);
+void lapic_broadcast_ipi (uint8_t vec);
+void lapic_send_init (uint8_t apic_id);
+void lapic_send_startup (uint8_t apic_id, uintptr_t phys);
+void lapic_timer_calibrate (void);
+bool lapic_timer_present (void);
+bool lapic_timer_oneshot (int64_t ns);
+
+#endif /* devices/lapic.h */
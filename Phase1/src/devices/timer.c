@@ -1,12 +1,16 @@
 #include "devices/timer.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
+#include "devices/lapic.h"
 #include "devices/pit.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 
 /* See [8254] for hardware details of the 8254 timer chip. */
 
@@ -22,11 +26,69 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Last tick whose per-tick work (thread_tick() and the mlfqs
+   updates) has been done. */
+static int64_t processed_ticks;
+
+/* If false (default), the PIT interrupts every tick.
+   If true, the idle thread stretches the PIT period up to the
+   next sleeper's deadline, so an idle kernel takes no periodic
+   interrupts.  Controlled by kernel command-line option
+   "-tickless". */
+bool timer_tickless;
+
+/* PIT cycles per timer tick. */
+#define TICK_COUNT ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Number of ticks that the PIT's current period ends, 1 unless
+   timer_idle_enter() stretched it. */
+static int64_t tick_stretch = 1;
+
+/* Ticks that passed without a timer interrupt. */
+static int64_t skipped_ticks;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* If nonzero, timer_calibrate() uses this as loops_per_tick
+   instead of measuring it.  Set by the -lpt kernel option. */
+unsigned timer_cached_lpt;
+
+/* Time-stamp counter cycles per second, or 0 until
+   timer_calibrate() has measured it.  timer_ns() counts from
+   TSC_BASE, read at NS_BASE nanoseconds after boot.  The
+   processors' counters are assumed to run in step. */
+static uint64_t tsc_hz;
+static uint64_t tsc_base;
+static int64_t ns_base;
+
+/* Sleeps shorter than this many nanoseconds are busy-waited even
+   if the local APIC timer could wake us, since blocking and
+   being woken again would take about as long. */
+#define HR_SLEEP_MIN_NS 20000
+
+/* A thread sleeping less than a tick, waiting for the local APIC
+   timer.  Lives on the sleeping thread's stack. */
+struct hr_sleeper
+{
+  struct list_elem elem;  /* Element in hr_sleepers. */
+  int64_t deadline;       /* Wake-up time, in timer_ns() units. */
+  struct thread *thread;  /* The sleeping thread. */
+};
+
+/* Sub-tick sleepers, ordered by deadline.  Protected by the
+   scheduler lock.  Whenever the list is nonempty, some
+   processor's local APIC timer is due to go off no later than
+   its front's deadline. */
+static struct list hr_sleepers;
+LIST_DEFINE_ORDERED(hr_sleeper, struct hr_sleeper, elem, deadline)
+
 static intr_handler_func timer_interrupt;
+static intr_handler_func timer_tick_interrupt;
+static intr_handler_func hr_timer_interrupt;
+static void hr_sleep(int64_t ns);
+static void timer_run_tick (int64_t tick);
 static bool too_many_loops(unsigned loops);
 static void busy_wait(int64_t loops);
 static void real_time_sleep(int64_t num, int32_t denom);
@@ -38,32 +100,61 @@ void timer_init(void)
 {
   pit_configure_channel(0, 2, TIMER_FREQ);
   intr_register_ext(0x20, timer_interrupt, "8254 Timer");
+  intr_register_lapic(LAPIC_IPI_TICK, timer_tick_interrupt, "Timer Tick");
+  intr_register_lapic(LAPIC_TIMER_VEC, hr_timer_interrupt, "LAPIC Timer");
+  list_init(&hr_sleepers);
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Calibrates loops_per_tick, used to implement brief delays, and
+   the time-stamp counter rate behind timer_ns(). */
 void timer_calibrate(void)
 {
+  const int tsc_calib_ticks = 5;
   unsigned high_bit, test_bit;
+  uint64_t tsc_start;
+  int64_t start;
 
   ASSERT(intr_get_level() == INTR_ON);
-  printf("Calibrating timer...  ");
-
-  /* Approximate loops_per_tick as the largest power-of-two
-     still less than one timer tick. */
-  loops_per_tick = 1u << 10;
-  while (!too_many_loops(loops_per_tick << 1))
+  if (timer_cached_lpt != 0)
   {
-    loops_per_tick <<= 1;
-    ASSERT(loops_per_tick != 0);
+    loops_per_tick = timer_cached_lpt;
+    printf("Timer: %'" PRIu64 " loops/s (cached lpt=%u).\n",
+           (uint64_t)loops_per_tick * TIMER_FREQ, loops_per_tick);
   }
+  else
+  {
+    printf("Calibrating timer...  ");
 
-  /* Refine the next 8 bits of loops_per_tick. */
-  high_bit = loops_per_tick;
-  for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
-    if (!too_many_loops(loops_per_tick | test_bit))
-      loops_per_tick |= test_bit;
+    /* Approximate loops_per_tick as the largest power-of-two
+       still less than one timer tick. */
+    loops_per_tick = 1u << 10;
+    while (!too_many_loops(loops_per_tick << 1))
+    {
+      loops_per_tick <<= 1;
+      ASSERT(loops_per_tick != 0);
+    }
+
+    /* Refine the next 8 bits of loops_per_tick. */
+    high_bit = loops_per_tick;
+    for (test_bit = high_bit >> 1; test_bit != high_bit >> 10; test_bit >>= 1)
+      if (!too_many_loops(loops_per_tick | test_bit))
+        loops_per_tick |= test_bit;
+
+    printf("%'" PRIu64 " loops/s (lpt=%u).\n",
+           (uint64_t)loops_per_tick * TIMER_FREQ, loops_per_tick);
+  }
 
-  printf("%'" PRIu64 " loops/s.\n", (uint64_t)loops_per_tick * TIMER_FREQ);
+  /* Count TSC cycles over a few whole ticks. */
+  start = ticks;
+  while (ticks == start)
+    barrier();
+  start = ticks;
+  tsc_start = rdtsc();
+  while (ticks - start < tsc_calib_ticks)
+    barrier();
+  tsc_base = rdtsc();
+  ns_base = ticks * (1000000000 / TIMER_FREQ);
+  tsc_hz = (tsc_base - tsc_start) * TIMER_FREQ / tsc_calib_ticks;
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -84,6 +175,24 @@ timer_elapsed(int64_t then)
   return timer_ticks() - then;
 }
 
+/* Returns the number of nanoseconds since the OS booted.  The
+   count never goes backward, and once timer_calibrate() has run
+   it has the resolution of the time-stamp counter; before that,
+   it advances a tick at a time. */
+int64_t
+timer_ns(void)
+{
+  uint64_t delta;
+
+  if (tsc_hz == 0)
+    return timer_ticks() * (1000000000 / TIMER_FREQ);
+
+  /* Split the conversion so that DELTA * 10**9 cannot overflow. */
+  delta = rdtsc() - tsc_base;
+  return ns_base + (int64_t)(delta / tsc_hz * 1000000000
+                             + delta % tsc_hz * 1000000000 / tsc_hz);
+}
+
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
    be turned on. */
 void timer_sleep(int64_t ticks)
@@ -158,19 +267,151 @@ void timer_ndelay(int64_t ns)
   real_time_delay(ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts.  In tickless mode, stretches the PIT's current period
+   so that the next timer interrupt arrives on the tick boundary
+   at which the earliest sleeper is due, rather than at the next
+   tick.  The period that follows is an ordinary one-tick
+   period again. */
+void timer_idle_enter(void)
+{
+  int64_t next, stretch, max_stretch;
+  unsigned remaining;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  /* The other processors get their ticks from ours. */
+  if (!timer_tickless || thread_smp || tick_stretch > 1
+      || intr_ext_pending(0x20))
+    return;
+
+  next = thread_next_wakeup();
+  if (next - ticks <= 1)
+    return;
+
+  /* Keep the phase of the tick boundaries by extending the part
+     of the current tick that is still to come. */
+  remaining = pit_read_count(0);
+  if (remaining > TICK_COUNT)
+    remaining = TICK_COUNT;
+  max_stretch = (65536 - remaining) / TICK_COUNT + 1;
+  stretch = next - ticks < max_stretch ? next - ticks : max_stretch;
+  if (stretch <= 1)
+    return;
+
+  tick_stretch = stretch;
+  pit_configure_count(0, 2, remaining + (stretch - 1) * TICK_COUNT);
+  pit_reload_count(0, TICK_COUNT);
+}
+
+/* Called by the idle thread, with interrupts off, after it wakes
+   up from halting.  If an interrupt other than the timer woke it
+   while the PIT period was stretched, shortens the period to end
+   at the next tick boundary, so that whatever thread was woken
+   runs with ordinary tick-driven preemption and timekeeping. */
+void timer_idle_exit(void)
+{
+  unsigned remaining, early;
+  int64_t boundaries;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (tick_stretch <= 1 || intr_ext_pending(0x20))
+    return;
+
+  /* Tick boundaries lie every TICK_COUNT cycles before the end
+     of the stretched period.  Find the next one that is still
+     far enough away to program. */
+  remaining = pit_read_count(0);
+  boundaries = remaining / TICK_COUNT;
+  early = remaining % TICK_COUNT;
+  if (early < 2)
+  {
+    if (boundaries == 0)
+      return;
+    boundaries--;
+    early += TICK_COUNT;
+  }
+  if (boundaries == 0)
+    return;
+
+  tick_stretch -= boundaries;
+  pit_configure_count(0, 2, early);
+  pit_reload_count(0, TICK_COUNT);
+}
+
 /* Prints timer statistics. */
 void timer_print_stats(void)
 {
   printf("Timer: %" PRId64 " ticks\n", timer_ticks());
+  if (timer_tickless)
+    printf("Timer: %" PRId64 " ticks skipped while idle\n", skipped_ticks);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt(struct intr_frame *args UNUSED)
 {
+  /* A stretched period covers several ticks; the PIT has already
+     been told to go back to single-tick periods. */
+  ticks += tick_stretch;
+  skipped_ticks += tick_stretch - 1;
+  tick_stretch = 1;
 
-  ticks++;
+  while (processed_ticks < ticks)
+    timer_run_tick(++processed_ticks);
 
+  if (thread_smp && cpu_cnt > 1)
+    lapic_broadcast_ipi(LAPIC_IPI_TICK);
+}
+
+/* Local APIC timer interrupt handler.  Wakes the sub-tick
+   sleepers whose deadlines have passed and sets this processor's
+   timer to go off for the next one. */
+static void
+hr_timer_interrupt(struct intr_frame *args UNUSED)
+{
+  enum intr_level old_level = sched_lock_acquire();
+  int64_t now = timer_ns();
+
+  while (!list_empty(&hr_sleepers))
+  {
+    struct hr_sleeper *s = list_entry(list_front(&hr_sleepers),
+                                      struct hr_sleeper, elem);
+    if (s->deadline > now)
+    {
+      lapic_timer_oneshot(s->deadline - now);
+      break;
+    }
+    list_pop_front(&hr_sleepers);
+    trace_event(TRACE_WAKEUP, s->thread->tid, 0, 0);
+    thread_unblock(s->thread);
+  }
+  sched_lock_release(old_level);
+
+  thread_try_yeild();
+}
+
+/* Timer tick forwarded to another processor by the bootstrap
+   processor's timer interrupt.  Does the per-tick work that
+   concerns the thread running here. */
+static void
+timer_tick_interrupt(struct intr_frame *args UNUSED)
+{
+  thread_tick();
+
+  if (thread_mlfqs)
+  {
+    inc_recent_cpu(thread_current());
+    if (timer_ticks() % TIME_SLICE == 0)
+      thread_update_priority_mlfqs_current();
+  }
+}
+
+/* Does the per-tick work for TICK. */
+static void
+timer_run_tick(int64_t tick)
+{
   thread_tick();
 
   if (thread_mlfqs)
@@ -180,17 +421,36 @@ timer_interrupt(struct intr_frame *args UNUSED)
 
     inc_recent_cpu(t);
 
-    if (timer_ticks() % TIMER_FREQ == 0)
+    if (tick % TIMER_FREQ == 0)
     {
       thread_update_recent_cpu_and_load_avg();
     }
-    else if (timer_ticks() % TIME_SLICE == 0)
+    else if (tick % TIME_SLICE == 0)
     {
-      thread_update_priority_mlfqs_all();
+      thread_update_priority_mlfqs_current();
     }
   }
 }
 
+/* Blocks the running thread for NS nanoseconds, to be woken by
+   the local APIC timer.  A sleeper that becomes the earliest one
+   sets this processor's timer for itself; otherwise a timer is
+   already due to go off earlier. */
+static void
+hr_sleep(int64_t ns)
+{
+  struct hr_sleeper s;
+  enum intr_level old_level = sched_lock_acquire();
+
+  s.deadline = timer_ns() + ns;
+  s.thread = thread_current();
+  hr_sleeper_insert_ordered(&hr_sleepers, &s.elem);
+  if (list_front(&hr_sleepers) == &s.elem)
+    lapic_timer_oneshot(ns);
+  thread_block();
+  sched_lock_release(old_level);
+}
+
 /* Returns true if LOOPS iterations waits for more than one timer
    tick, otherwise false. */
 static bool
@@ -246,9 +506,14 @@ real_time_sleep(int64_t num, int32_t denom)
   }
   else
   {
-    /* Otherwise, use a busy-wait loop for more accurate
-       sub-tick timing. */
-    real_time_delay(num, denom);
+    /* Less than a tick.  If the local APIC timer can wake us,
+       block until it does; otherwise use a busy-wait loop for
+       more accurate sub-tick timing. */
+    int64_t ns = num * (1000000000 / denom);
+    if (lapic_timer_present() && ns >= HR_SLEEP_MIN_NS)
+      hr_sleep(ns);
+    else
+      real_time_delay(num, denom);
   }
 }
 
@@ -0,0 +1,245 @@
+#include "radix.h"
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* See radix.h for basic information. */
+
+/* A radix tree node.  A node with SHIFT 0 is a leaf, whose slots
+   hold items; otherwise, slot I points to the child covering
+   keys whose bits SHIFT through SHIFT + RADIX_BITS - 1 equal I. */
+struct radix_node 
+  {
+    int shift;                  /* Key bits below this level. */
+    void *slots[RADIX_FANOUT];  /* Children or items, or nulls. */
+  };
+
+/* Prevents the compiler from moving stores across it, so that a
+   node is fully initialized before it is published.  (x86 does
+   not reorder stores with other stores.) */
+#define publish_barrier() asm volatile ("" : : : "memory")
+
+/* Reads a pointer that a concurrent writer may be changing
+   exactly once. */
+#define READ_ONCE(PTR) (*(void *volatile *) &(PTR))
+
+static struct radix_node *new_node (int shift, void *first_slot);
+static void destroy_node (struct radix_node *);
+static size_t gang_lookup (struct radix_node *, uint32_t base,
+                           uint32_t first_key, void **items,
+                           uint32_t *keys, size_t max_cnt);
+
+/* Returns true if a node of the given SHIFT covers KEY. */
+static inline bool
+covers (int shift, uint32_t key) 
+{
+  return shift + RADIX_BITS >= 32 || key >> (shift + RADIX_BITS) == 0;
+}
+
+/* Returns the slot index for KEY in a node of the given SHIFT. */
+static inline size_t
+slot_idx (int shift, uint32_t key) 
+{
+  return (key >> shift) & (RADIX_FANOUT - 1);
+}
+
+/* Initializes TREE as empty. */
+void
+radix_init (struct radix_tree *tree) 
+{
+  tree->root = NULL;
+  tree->item_cnt = 0;
+}
+
+/* Frees TREE's nodes, but not its items.  TREE is empty
+   afterward.  No reader may be using TREE. */
+void
+radix_destroy (struct radix_tree *tree) 
+{
+  destroy_node (tree->root);
+  radix_init (tree);
+}
+
+/* Adds ITEM, which must not be null, to TREE under KEY.  Returns
+   true if successful, false if KEY is already in TREE or memory
+   allocation failed. */
+bool
+radix_insert (struct radix_tree *tree, uint32_t key, void *item) 
+{
+  struct radix_node *node;
+  size_t idx;
+
+  ASSERT (item != NULL);
+
+  /* Make the root tall enough to cover KEY, adding levels above
+     the old root rather than changing it. */
+  if (tree->root == NULL)
+    {
+      int shift = 0;
+      while (!covers (shift, key))
+        shift += RADIX_BITS;
+      node = new_node (shift, NULL);
+      if (node == NULL)
+        return false;
+      publish_barrier ();
+      tree->root = node;
+    }
+  while (!covers (tree->root->shift, key))
+    {
+      node = new_node (tree->root->shift + RADIX_BITS, tree->root);
+      if (node == NULL)
+        return false;
+      publish_barrier ();
+      tree->root = node;
+    }
+
+  /* Walk down, adding nodes as needed. */
+  for (node = tree->root; node->shift > 0; node = node->slots[idx])
+    {
+      idx = slot_idx (node->shift, key);
+      if (node->slots[idx] == NULL)
+        {
+          struct radix_node *child = new_node (node->shift - RADIX_BITS,
+                                               NULL);
+          if (child == NULL)
+            return false;
+          publish_barrier ();
+          node->slots[idx] = child;
+        }
+    }
+
+  idx = slot_idx (0, key);
+  if (node->slots[idx] != NULL)
+    return false;
+  publish_barrier ();
+  node->slots[idx] = item;
+  tree->item_cnt++;
+  return true;
+}
+
+/* Removes the item under KEY from TREE and returns it, or
+   returns a null pointer if KEY is not in TREE. */
+void *
+radix_delete (struct radix_tree *tree, uint32_t key) 
+{
+  struct radix_node *node = tree->root;
+  void *item;
+
+  if (node == NULL || !covers (node->shift, key))
+    return NULL;
+  while (node->shift > 0)
+    {
+      node = node->slots[slot_idx (node->shift, key)];
+      if (node == NULL)
+        return NULL;
+    }
+
+  item = node->slots[slot_idx (0, key)];
+  if (item != NULL)
+    {
+      node->slots[slot_idx (0, key)] = NULL;
+      tree->item_cnt--;
+    }
+  return item;
+}
+
+/* Returns the item under KEY in TREE, or a null pointer if KEY
+   is not in TREE. */
+void *
+radix_lookup (const struct radix_tree *tree, uint32_t key) 
+{
+  struct radix_node *node = READ_ONCE (tree->root);
+
+  if (node == NULL || !covers (node->shift, key))
+    return NULL;
+  while (node->shift > 0)
+    {
+      node = READ_ONCE (node->slots[slot_idx (node->shift, key)]);
+      if (node == NULL)
+        return NULL;
+    }
+  return READ_ONCE (node->slots[slot_idx (0, key)]);
+}
+
+/* Stores up to MAX_CNT items from TREE whose keys are
+   FIRST_KEY or greater into ITEMS, in ascending order of key,
+   and their keys into KEYS if it is non-null.  Returns the
+   number of items stored. */
+size_t
+radix_gang_lookup (const struct radix_tree *tree, uint32_t first_key,
+                   void **items, uint32_t *keys, size_t max_cnt) 
+{
+  struct radix_node *root = READ_ONCE (tree->root);
+
+  if (root == NULL || !covers (root->shift, first_key))
+    return 0;
+  return gang_lookup (root, 0, first_key, items, keys, max_cnt);
+}
+
+/* Returns the number of items in TREE. */
+size_t
+radix_size (const struct radix_tree *tree) 
+{
+  return tree->item_cnt;
+}
+
+/* Returns a new node with the given SHIFT whose first slot is
+   FIRST_SLOT and whose other slots are null, or a null pointer
+   if memory allocation fails. */
+static struct radix_node *
+new_node (int shift, void *first_slot) 
+{
+  struct radix_node *node = calloc (1, sizeof *node);
+  if (node != NULL)
+    {
+      node->shift = shift;
+      node->slots[0] = first_slot;
+    }
+  return node;
+}
+
+/* Frees NODE, which may be null, and all of its descendants. */
+static void
+destroy_node (struct radix_node *node) 
+{
+  size_t i;
+
+  if (node == NULL)
+    return;
+  if (node->shift > 0)
+    for (i = 0; i < RADIX_FANOUT; i++)
+      destroy_node (node->slots[i]);
+  free (node);
+}
+
+/* Does the work of radix_gang_lookup() for the subtree rooted
+   at NODE, which covers keys starting from BASE. */
+static size_t
+gang_lookup (struct radix_node *node, uint32_t base, uint32_t first_key,
+             void **items, uint32_t *keys, size_t max_cnt) 
+{
+  size_t found = 0;
+  size_t i;
+
+  i = first_key > base ? slot_idx (node->shift, first_key) : 0;
+  for (; i < RADIX_FANOUT && found < max_cnt; i++) 
+    {
+      void *slot = READ_ONCE (node->slots[i]);
+      uint32_t slot_base;
+
+      if (slot == NULL)
+        continue;
+      slot_base = base + ((uint32_t) i << node->shift);
+      if (node->shift == 0)
+        {
+          items[found] = slot;
+          if (keys != NULL)
+            keys[found] = slot_base;
+          found++;
+        }
+      else
+        found += gang_lookup (slot, slot_base, first_key, items + found,
+                              keys != NULL ? keys + found : NULL,
+                              max_cnt - found);
+    }
+  return found;
+}
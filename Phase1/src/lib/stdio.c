@@ -13,7 +13,7 @@ struct vsnprintf_aux
     int max_length;     /* Max length of output string. */
   };
 
-static void vsnprintf_helper (char, void *);
+static void vsnprintf_helper (const char *, size_t, void *);
 
 /* Like vprintf(), except that output is stored into BUFFER,
    which must have space for BUF_SIZE characters.  Writes at most
@@ -32,7 +32,7 @@ vsnprintf (char *buffer, size_t buf_size, const char *format, va_list args)
   aux.max_length = buf_size > 0 ? buf_size - 1 : 0;
 
   /* Do most of the work. */
-  __vprintf (format, args, vsnprintf_helper, &aux);
+  __vprintf_runs (format, args, vsnprintf_helper, &aux);
 
   /* Add null terminator. */
   if (buf_size > 0)
@@ -43,12 +43,18 @@ vsnprintf (char *buffer, size_t buf_size, const char *format, va_list args)
 
 /* Helper function for vsnprintf(). */
 static void
-vsnprintf_helper (char ch, void *aux_)
+vsnprintf_helper (const char *run, size_t n, void *aux_)
 {
   struct vsnprintf_aux *aux = aux_;
 
-  if (aux->length++ < aux->max_length)
-    *aux->p++ = ch;
+  if (aux->length < aux->max_length)
+    {
+      size_t room = aux->max_length - aux->length;
+      size_t copy_cnt = n < room ? n : room;
+      memcpy (aux->p, run, copy_cnt);
+      aux->p += copy_cnt;
+    }
+  aux->length += n;
 }
 
 /* Like printf(), except that output is stored into BUFFER,
@@ -140,23 +146,47 @@ static const struct integer_base base_o = {8, "01234567", 0, 3};
 static const struct integer_base base_x = {16, "0123456789abcdef", 'x', 4};
 static const struct integer_base base_X = {16, "0123456789ABCDEF", 'X', 4};
 
+/* Formatted output in progress.  Characters accumulate in BUF
+   and reach WRITE a run at a time, so that a sink such as the
+   console or a file descriptor sees a few calls per printf()
+   rather than one per character. */
+struct printf_out
+  {
+    char buf[64];               /* Pending output. */
+    size_t len;                 /* Number of bytes in BUF. */
+    void (*write) (const char *, size_t, void *);  /* Sink. */
+    void *aux;                  /* Sink's auxiliary data. */
+  };
+
 static const char *parse_conversion (const char *format,
                                      struct printf_conversion *,
                                      va_list *);
 static void format_integer (uintmax_t value, bool is_signed, bool negative, 
                             const struct integer_base *,
                             const struct printf_conversion *,
-                            void (*output) (char, void *), void *aux);
-static void output_dup (char ch, size_t cnt,
-                        void (*output) (char, void *), void *aux);
+                            struct printf_out *);
+static void output_dup (char ch, size_t cnt, struct printf_out *);
 static void format_string (const char *string, int length,
                            struct printf_conversion *,
-                           void (*output) (char, void *), void *aux);
-
+                           struct printf_out *);
+static void output_char (char, struct printf_out *);
+static void output_run (const char *, size_t, struct printf_out *);
+static void output_flush (struct printf_out *);
+
+/* Formats FORMAT with ARGS like vprintf(), passing the output to
+   WRITE with auxiliary data AUX in runs of one or more
+   characters.  The runs, concatenated, are the formatted
+   output; how it is split into runs is unspecified. */
 void
-__vprintf (const char *format, va_list args,
-           void (*output) (char, void *), void *aux)
+__vprintf_runs (const char *format, va_list args,
+                void (*write) (const char *, size_t, void *), void *aux)
 {
+  struct printf_out out;
+
+  out.len = 0;
+  out.write = write;
+  out.aux = aux;
+
   for (; *format != '\0'; format++)
     {
       struct printf_conversion c;
@@ -164,7 +194,11 @@ __vprintf (const char *format, va_list args,
       /* Literally copy non-conversions to output. */
       if (*format != '%') 
         {
-          output (*format, aux);
+          const char *end = strchr (format, '%');
+          if (end == NULL)
+            end = format + strlen (format);
+          output_run (format, end - format, &out);
+          format = end - 1;
           continue;
         }
       format++;
@@ -172,7 +206,7 @@ __vprintf (const char *format, va_list args,
       /* %% => %. */
       if (*format == '%') 
         {
-          output ('%', aux);
+          output_char ('%', &out);
           continue;
         }
 
@@ -221,7 +255,7 @@ __vprintf (const char *format, va_list args,
               }
 
             format_integer (value < 0 ? -value : value,
-                            true, value < 0, &base_d, &c, output, aux);
+                            true, value < 0, &base_d, &c, &out);
           }
           break;
           
@@ -276,7 +310,7 @@ __vprintf (const char *format, va_list args,
               default: NOT_REACHED ();
               }
 
-            format_integer (value, false, false, b, &c, output, aux);
+            format_integer (value, false, false, b, &c, &out);
           }
           break;
 
@@ -284,7 +318,7 @@ __vprintf (const char *format, va_list args,
           {
             /* Treat character as single-character string. */
             char ch = va_arg (args, int);
-            format_string (&ch, 1, &c, output, aux);
+            format_string (&ch, 1, &c, &out);
           }
           break;
 
@@ -298,7 +332,7 @@ __vprintf (const char *format, va_list args,
             /* Limit string length according to precision.
                Note: if c.precision == -1 then strnlen() will get
                SIZE_MAX for MAXLEN, which is just what we want. */
-            format_string (s, strnlen (s, c.precision), &c, output, aux);
+            format_string (s, strnlen (s, c.precision), &c, &out);
           }
           break;
           
@@ -310,7 +344,7 @@ __vprintf (const char *format, va_list args,
 
             c.flags = POUND;
             format_integer ((uintptr_t) p, false, false,
-                            &base_x, &c, output, aux);
+                            &base_x, &c, &out);
           }
           break;
       
@@ -322,14 +356,50 @@ __vprintf (const char *format, va_list args,
         case 'n':
           /* We don't support floating-point arithmetic,
              and %n can be part of a security hole. */
-          __printf ("<<no %%%c in kernel>>", output, aux, *format);
+          output_run ("<<no %", 5, &out);
+          output_char (*format, &out);
+          output_run (" in kernel>>", 12, &out);
           break;
 
         default:
-          __printf ("<<no %%%c conversion>>", output, aux, *format);
+          output_run ("<<no %", 5, &out);
+          output_char (*format, &out);
+          output_run (" conversion>>", 13, &out);
           break;
         }
     }
+  output_flush (&out);
+}
+
+/* Adapter between __vprintf() and __vprintf_runs(). */
+struct vprintf_chars_aux
+  {
+    void (*output) (char, void *);
+    void *aux;
+  };
+
+/* Passes each character in the N-byte RUN to the per-character
+   callback in AUX_. */
+static void
+vprintf_chars_helper (const char *run, size_t n, void *aux_)
+{
+  struct vprintf_chars_aux *aux = aux_;
+
+  while (n-- > 0)
+    aux->output (*run++, aux->aux);
+}
+
+/* Like __vprintf_runs(), but passes the output to OUTPUT one
+   character at a time. */
+void
+__vprintf (const char *format, va_list args,
+           void (*output) (char, void *), void *aux)
+{
+  struct vprintf_chars_aux chars_aux;
+
+  chars_aux.output = output;
+  chars_aux.aux = aux;
+  __vprintf_runs (format, args, vprintf_chars_helper, &chars_aux);
 }
 
 /* Parses conversion option characters starting at FORMAT and
@@ -459,8 +529,7 @@ parse_conversion (const char *format, struct printf_conversion *c,
   return format;
 }
 
-/* Performs an integer conversion, writing output to OUTPUT with
-   auxiliary data AUX.  The integer converted has absolute value
+/* Performs an integer conversion, writing output to OUT.  The integer converted has absolute value
    VALUE.  If IS_SIGNED is true, does a signed conversion with
    NEGATIVE indicating a negative value; otherwise does an
    unsigned conversion and ignores NEGATIVE.  The output is done
@@ -470,9 +539,10 @@ static void
 format_integer (uintmax_t value, bool is_signed, bool negative, 
                 const struct integer_base *b,
                 const struct printf_conversion *c,
-                void (*output) (char, void *), void *aux)
+                struct printf_out *out)
 {
   char buf[64], *cp;            /* Buffer and current position. */
+  char *lo, *hi;                /* Ends of digits being reversed. */
   int x;                        /* `x' character to use or 0 if none. */
   int sign;                     /* Sign character or 0 if none. */
   int precision;                /* Rendered precision. */
@@ -530,45 +600,88 @@ format_integer (uintmax_t value, bool is_signed, bool negative,
 
   /* Do output. */
   if ((c->flags & (MINUS | ZERO)) == 0)
-    output_dup (' ', pad_cnt, output, aux);
+    output_dup (' ', pad_cnt, out);
   if (sign)
-    output (sign, aux);
+    output_char (sign, out);
   if (x) 
     {
-      output ('0', aux);
-      output (x, aux); 
+      output_char ('0', out);
+      output_char (x, out); 
     }
   if (c->flags & ZERO)
-    output_dup ('0', pad_cnt, output, aux);
-  while (cp > buf)
-    output (*--cp, aux);
+    output_dup ('0', pad_cnt, out);
+
+  /* Reverse the digits in place, then emit them as one run. */
+  lo = buf;
+  hi = cp;
+  while (hi - lo > 1)
+    {
+      char t = *lo;
+      *lo++ = *--hi;
+      *hi = t;
+    }
+  output_run (buf, cp - buf, out);
   if (c->flags & MINUS)
-    output_dup (' ', pad_cnt, output, aux);
+    output_dup (' ', pad_cnt, out);
 }
 
-/* Writes CH to OUTPUT with auxiliary data AUX, CNT times. */
+/* Writes CH to OUT, CNT times. */
 static void
-output_dup (char ch, size_t cnt, void (*output) (char, void *), void *aux) 
+output_dup (char ch, size_t cnt, struct printf_out *out) 
 {
   while (cnt-- > 0)
-    output (ch, aux);
+    output_char (ch, out);
 }
 
 /* Formats the LENGTH characters starting at STRING according to
-   the conversion specified in C.  Writes output to OUTPUT with
-   auxiliary data AUX. */
+   the conversion specified in C.  Writes output to OUT. */
 static void
 format_string (const char *string, int length,
                struct printf_conversion *c,
-               void (*output) (char, void *), void *aux) 
+               struct printf_out *out) 
 {
-  int i;
   if (c->width > length && (c->flags & MINUS) == 0)
-    output_dup (' ', c->width - length, output, aux);
-  for (i = 0; i < length; i++)
-    output (string[i], aux);
+    output_dup (' ', c->width - length, out);
+  output_run (string, length, out);
   if (c->width > length && (c->flags & MINUS) != 0)
-    output_dup (' ', c->width - length, output, aux);
+    output_dup (' ', c->width - length, out);
+}
+
+/* Appends CH to OUT's buffer, flushing it if it fills up. */
+static void
+output_char (char ch, struct printf_out *out) 
+{
+  out->buf[out->len++] = ch;
+  if (out->len >= sizeof out->buf)
+    output_flush (out);
+}
+
+/* Appends the N bytes in RUN to OUT.  A run too long to buffer
+   goes straight to the sink after whatever is pending. */
+static void
+output_run (const char *run, size_t n, struct printf_out *out) 
+{
+  if (n >= sizeof out->buf)
+    {
+      output_flush (out);
+      out->write (run, n, out->aux);
+      return;
+    }
+  if (n > sizeof out->buf - out->len)
+    output_flush (out);
+  memcpy (out->buf + out->len, run, n);
+  out->len += n;
+  if (out->len >= sizeof out->buf)
+    output_flush (out);
+}
+
+/* Passes OUT's buffered characters, if any, to its sink. */
+static void
+output_flush (struct printf_out *out) 
+{
+  if (out->len > 0)
+    out->write (out->buf, out->len, out->aux);
+  out->len = 0;
 }
 
 /* Wrapper for __vprintf() that converts varargs into a
@@ -166,6 +166,11 @@ sub compare_output {
 	delete $options{IGNORE_EXIT_CODES};
 	@output = grep (!/^[a-zA-Z0-9-_]+: exit\(\-?\d+\)$/, @output);
     }
+    my $ignore_bench = exists $options{IGNORE_BENCH};
+    if ($ignore_bench) {
+	delete $options{IGNORE_BENCH};
+	@output = grep (!/^\([^)]+\) bench: /, @output);
+    }
     my $ignore_user_faults = exists $options{IGNORE_USER_FAULTS};
     if ($ignore_user_faults) {
 	delete $options{IGNORE_USER_FAULTS};
@@ -224,6 +229,8 @@ sub compare_output {
       if $ignore_exit_codes;
     $msg .= "\n(User fault messages are excluded for matching purposes.)\n"
       if $ignore_user_faults;
+    $msg .= "\n(Benchmark results are excluded for matching purposes.)\n"
+      if $ignore_bench;
     fail "Test output failed to match any acceptable form.\n\n$msg";
 }
 
@@ -0,0 +1,61 @@
+/* Sleeps for less than a timer tick and checks that timer_ns()
+   saw at least that much time go by.  With a local APIC timer,
+   the sleep must also block: a lower-priority thread that could
+   not otherwise run gets to run while we sleep. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/lapic.h"
+#include "devices/timer.h"
+
+#define SLEEPS 10
+#define SLEEP_US 500
+
+static thread_func spinner;
+static volatile bool ran, done;
+
+void
+test_alarm_usleep (void) 
+{
+  int64_t prev, start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_create ("spinner", PRI_DEFAULT - 1, spinner, NULL);
+
+  prev = timer_ns ();
+  for (i = 0; i < SLEEPS; i++) 
+    {
+      int64_t now = timer_ns ();
+      if (now < prev)
+        fail ("timer_ns() went backward");
+      prev = now;
+    }
+
+  start = timer_ns ();
+  for (i = 0; i < SLEEPS; i++)
+    timer_usleep (SLEEP_US);
+  if (timer_ns () - start < (int64_t) SLEEPS * SLEEP_US * 1000)
+    fail ("slept %lld ns, expected at least %lld ns",
+          timer_ns () - start, (long long) SLEEPS * SLEEP_US * 1000);
+  msg ("slept at least %d us.", SLEEPS * SLEEP_US);
+
+  if (lapic_timer_present () && !ran)
+    fail ("lower-priority thread did not run while we slept");
+  msg ("cpu free while sleeping.");
+
+  /* Let the spinner finish. */
+  done = true;
+  thread_set_priority (PRI_MIN);
+}
+
+static void
+spinner (void *aux UNUSED) 
+{
+  while (!done)
+    ran = true;
+}
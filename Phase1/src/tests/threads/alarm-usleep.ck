@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-usleep) begin
+(alarm-usleep) slept at least 5000 us.
+(alarm-usleep) cpu free while sleeping.
+(alarm-usleep) end
+EOF
+pass;
@@ -0,0 +1,118 @@
+/* Times the mlfqs load_avg and recent_cpu equations, evaluated
+   with the inline operations of threads/fixed_point.h and with
+   out-of-line copies of the same operations, the way
+   fixed_point.c used to provide them.  Both must compute the same
+   values. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/fixed_point.h"
+#include "threads/synch.h"
+#include "devices/timer.h"
+
+#define ITERATIONS 2000000
+
+static struct real NO_INLINE ool_add (struct real, struct real);
+static struct real NO_INLINE ool_add_real_to_int (struct real, int);
+static struct real NO_INLINE ool_multiply (struct real, struct real);
+static struct real NO_INLINE ool_multiply_by_int (struct real, int);
+static struct real NO_INLINE ool_divide (struct real, struct real);
+static struct real NO_INLINE ool_int_to_real (int);
+
+void
+test_fixed_point_bench (void) 
+{
+  struct real load_avg, recent_cpu;
+  struct real inline_load_avg, inline_recent_cpu;
+  int64_t start, inline_ticks, ool_ticks;
+  int i;
+
+  /* Inline operations. */
+  load_avg = int_to_real (0);
+  recent_cpu = int_to_real (0);
+  start = timer_ticks ();
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      struct real coeff;
+
+      load_avg = add (multiply (FP_59_60, load_avg),
+                      multiply (FP_1_60, int_to_real (i % 8)));
+      coeff = divide (multiply_by_int (load_avg, 2),
+                      add_real_to_int (multiply_by_int (load_avg, 2), 1));
+      recent_cpu = add_real_to_int (multiply (recent_cpu, coeff), i % 4);
+      barrier ();
+    }
+  inline_ticks = timer_elapsed (start);
+  inline_load_avg = load_avg;
+  inline_recent_cpu = recent_cpu;
+
+  /* Out-of-line operations. */
+  load_avg = ool_int_to_real (0);
+  recent_cpu = ool_int_to_real (0);
+  start = timer_ticks ();
+  for (i = 0; i < ITERATIONS; i++) 
+    {
+      struct real coeff;
+
+      load_avg = ool_add (ool_multiply (ool_divide (ool_int_to_real (59),
+                                                    ool_int_to_real (60)),
+                                        load_avg),
+                          ool_multiply (ool_divide (ool_int_to_real (1),
+                                                    ool_int_to_real (60)),
+                                        ool_int_to_real (i % 8)));
+      coeff = ool_divide (ool_multiply_by_int (load_avg, 2),
+                          ool_add_real_to_int (ool_multiply_by_int (load_avg,
+                                                                    2), 1));
+      recent_cpu = ool_add_real_to_int (ool_multiply (recent_cpu, coeff),
+                                        i % 4);
+      barrier ();
+    }
+  ool_ticks = timer_elapsed (start);
+
+  bench ("%d updates with inline operations: %"PRId64" ticks",
+         ITERATIONS, inline_ticks);
+  bench ("%d updates with out-of-line operations: %"PRId64" ticks",
+         ITERATIONS, ool_ticks);
+
+  if (inline_load_avg.val != load_avg.val
+      || inline_recent_cpu.val != recent_cpu.val)
+    fail ("inline and out-of-line results differ");
+  msg ("Inline and out-of-line results agree.");
+}
+
+static struct real NO_INLINE
+ool_int_to_real (int n) 
+{
+  return int_to_real (n);
+}
+
+static struct real NO_INLINE
+ool_add (struct real x, struct real y) 
+{
+  return add (x, y);
+}
+
+static struct real NO_INLINE
+ool_add_real_to_int (struct real x, int n) 
+{
+  return add_real_to_int (x, n);
+}
+
+static struct real NO_INLINE
+ool_multiply (struct real x, struct real y) 
+{
+  return multiply (x, y);
+}
+
+static struct real NO_INLINE
+ool_multiply_by_int (struct real x, int n) 
+{
+  return multiply_by_int (x, n);
+}
+
+static struct real NO_INLINE
+ool_divide (struct real x, struct real y) 
+{
+  return divide (x, y);
+}
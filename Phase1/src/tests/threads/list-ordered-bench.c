@@ -0,0 +1,105 @@
+/* Times ordered insertion, sorting, and maximum search on lists
+   with the generic list functions, which call a list_less_func
+   through a pointer, and with the inline comparisons generated
+   by LIST_DEFINE_ORDERED.  Both must put the list in the same
+   order. */
+
+#include <inttypes.h>
+#include <list.h>
+#include <random.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "devices/timer.h"
+
+#define ELEM_CNT 256
+#define ROUNDS 200
+
+struct item
+  {
+    struct list_elem elem;
+    int key;
+  };
+
+LIST_DEFINE_ORDERED (item, struct item, elem, key)
+
+static struct item items[ELEM_CNT];
+
+static bool
+generic_item_less (const struct list_elem *a, const struct list_elem *b,
+                   void *aux UNUSED) 
+{
+  return (list_entry (a, struct item, elem)->key
+          < list_entry (b, struct item, elem)->key);
+}
+
+/* Runs ROUNDS rounds of building a list of ITEMS by ordered
+   insertion, finding its maximum, and then re-sorting it after
+   reversing it, using the inline functions if TYPED is true and
+   the generic ones otherwise.  Leaves the final list in LIST
+   and returns the elapsed time in ticks. */
+static int64_t
+run (struct list *list, bool typed) 
+{
+  int64_t start = timer_ticks ();
+  int round, i;
+
+  for (round = 0; round < ROUNDS; round++) 
+    {
+      struct list_elem *max;
+
+      list_init (list);
+      for (i = 0; i < ELEM_CNT; i++)
+        if (typed)
+          item_insert_ordered (list, &items[i].elem);
+        else
+          list_insert_ordered (list, &items[i].elem, generic_item_less, NULL);
+
+      max = typed ? item_max (list) : list_max (list, generic_item_less, NULL);
+      if (max != list_back (list)
+          && list_entry (max, struct item, elem)->key
+             != list_entry (list_back (list), struct item, elem)->key)
+        fail ("maximum is not at the back of the list");
+
+      list_reverse (list);
+      if (typed)
+        item_sort (list);
+      else
+        list_sort (list, generic_item_less, NULL);
+      barrier ();
+    }
+  return timer_elapsed (start);
+}
+
+void
+test_list_ordered_bench (void) 
+{
+  struct list generic_list, typed_list;
+  struct list_elem *e;
+  int64_t generic_ticks, typed_ticks;
+  int generic_keys[ELEM_CNT];
+  int i;
+
+  random_init (0);
+  for (i = 0; i < ELEM_CNT; i++)
+    items[i].key = random_ulong () % (ELEM_CNT / 2);
+
+  generic_ticks = run (&generic_list, false);
+  for (i = 0, e = list_begin (&generic_list); e != list_end (&generic_list);
+       e = list_next (e))
+    generic_keys[i++] = list_entry (e, struct item, elem)->key;
+
+  typed_ticks = run (&typed_list, true);
+  for (i = 0, e = list_begin (&typed_list); e != list_end (&typed_list);
+       e = list_next (e), i++)
+    if (list_entry (e, struct item, elem)->key != generic_keys[i])
+      fail ("generic and typed lists differ at element %d", i);
+  if (i != ELEM_CNT)
+    fail ("typed list has %d elements, expected %d", i, ELEM_CNT);
+
+  bench ("%d rounds with generic list functions: %"PRId64" ticks",
+         ROUNDS, generic_ticks);
+  bench ("%d rounds with typed list functions: %"PRId64" ticks",
+         ROUNDS, typed_ticks);
+  msg ("Generic and typed results agree.");
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(list-ordered-bench) begin
+(list-ordered-bench) Generic and typed results agree.
+(list-ordered-bench) end
+EOF
+pass;
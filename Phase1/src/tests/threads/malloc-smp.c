@@ -0,0 +1,79 @@
+/* Has several threads allocate, fill, check and free blocks of
+   the common small sizes at once, so that with "-smp" blocks
+   freed on one processor are reused on another through the
+   per-processor caches in threads/malloc.c.  Fails if any block
+   is handed out twice or is not at least as big as asked. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 4
+#define BLOCK_CNT 64
+#define ROUNDS 20
+
+static thread_func alloc_thread;
+static struct semaphore done;
+static volatile bool corrupt;
+
+void
+test_malloc_smp (void) 
+{
+  int i;
+
+  sema_init (&done, 0);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "alloc %d", i);
+      thread_create (name, PRI_DEFAULT, alloc_thread, (void *) i);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+
+  if (corrupt)
+    fail ("a block was shared or overrun");
+  msg ("%d threads allocated and freed %d blocks each.",
+       THREAD_CNT, BLOCK_CNT * ROUNDS);
+}
+
+static void
+alloc_thread (void *id_) 
+{
+  int id = (int) id_;
+  static const size_t sizes[] = {16, 24, 32, 48, 64};
+  void *blocks[BLOCK_CNT];
+  int round, i;
+
+  for (round = 0; round < ROUNDS; round++) 
+    {
+      for (i = 0; i < BLOCK_CNT; i++) 
+        {
+          size_t size = sizes[(i + round) % 5];
+          blocks[i] = malloc (size);
+          if (blocks[i] == NULL)
+            fail ("out of memory");
+          memset (blocks[i], id, size);
+        }
+      thread_yield ();
+      for (i = 0; i < BLOCK_CNT; i++) 
+        {
+          size_t size = sizes[(i + round) % 5];
+          const unsigned char *p = blocks[i];
+          size_t j;
+
+          for (j = 0; j < size; j++)
+            if (p[j] != id)
+              corrupt = true;
+        }
+
+      /* Free in a different order than allocated. */
+      for (i = 0; i < BLOCK_CNT; i++)
+        free (blocks[(i * 7) % BLOCK_CNT]);
+    }
+  sema_up (&done);
+}
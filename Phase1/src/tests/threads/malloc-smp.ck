@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-smp) begin
+(malloc-smp) 4 threads allocated and freed 1280 blocks each.
+(malloc-smp) end
+EOF
+pass;
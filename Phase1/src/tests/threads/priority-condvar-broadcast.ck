@@ -0,0 +1,30 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-condvar-broadcast) begin
+(priority-condvar-broadcast) Thread priority 23 starting.
+(priority-condvar-broadcast) Thread priority 22 starting.
+(priority-condvar-broadcast) Thread priority 21 starting.
+(priority-condvar-broadcast) Thread priority 30 starting.
+(priority-condvar-broadcast) Thread priority 29 starting.
+(priority-condvar-broadcast) Thread priority 28 starting.
+(priority-condvar-broadcast) Thread priority 27 starting.
+(priority-condvar-broadcast) Thread priority 26 starting.
+(priority-condvar-broadcast) Thread priority 25 starting.
+(priority-condvar-broadcast) Thread priority 24 starting.
+(priority-condvar-broadcast) Broadcasting...
+(priority-condvar-broadcast) Thread priority 30 woke up.
+(priority-condvar-broadcast) Thread priority 29 woke up.
+(priority-condvar-broadcast) Thread priority 28 woke up.
+(priority-condvar-broadcast) Thread priority 27 woke up.
+(priority-condvar-broadcast) Thread priority 26 woke up.
+(priority-condvar-broadcast) Thread priority 25 woke up.
+(priority-condvar-broadcast) Thread priority 24 woke up.
+(priority-condvar-broadcast) Thread priority 23 woke up.
+(priority-condvar-broadcast) Thread priority 22 woke up.
+(priority-condvar-broadcast) Thread priority 21 woke up.
+(priority-condvar-broadcast) end
+EOF
+pass;
@@ -0,0 +1,89 @@
+/* Builds a chain of DEPTH nested priority donations, far deeper
+   than priority-donate-chain, and times building and unwinding
+   it over several rounds.
+
+   The main thread sets its priority to PRI_MIN and acquires
+   lock 0.  It then creates threads 1..DEPTH with priorities
+   PRI_MIN + 1, 2, 3, ...  Thread i acquires lock i (unless i ==
+   DEPTH) and then blocks on lock i - 1, so each new thread
+   donates its priority along a chain of i locks back to the main
+   thread.  When the main thread releases lock 0, the threads
+   acquire and release their locks in turn, each running with the
+   priority of thread DEPTH donated through the rest of the
+   chain. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define DEPTH 60
+#define ROUNDS 20
+
+static struct lock locks[DEPTH];
+static int wrong_priorities;
+
+static thread_func donor_thread_func;
+
+void
+test_priority_donate_deep (void) 
+{
+  int64_t start;
+  int round;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  thread_set_priority (PRI_MIN);
+  msg ("%d rounds of donation chains of depth %d.", ROUNDS, DEPTH);
+
+  start = timer_ticks ();
+  for (round = 0; round < ROUNDS; round++)
+    {
+      int i;
+
+      for (i = 0; i < DEPTH; i++)
+        lock_init (&locks[i]);
+
+      lock_acquire (&locks[0]);
+      for (i = 1; i <= DEPTH; i++)
+        {
+          char name[16];
+
+          snprintf (name, sizeof name, "donor %d", i);
+          thread_create (name, PRI_MIN + i, donor_thread_func,
+                         (void *) i);
+          if (thread_get_priority () != PRI_MIN + i)
+            wrong_priorities++;
+        }
+      lock_release (&locks[0]);
+      if (thread_get_priority () != PRI_MIN)
+        wrong_priorities++;
+    }
+  bench ("%d donations in %"PRId64" ticks",
+         ROUNDS * DEPTH * (DEPTH + 1) / 2, timer_elapsed (start));
+
+  if (wrong_priorities != 0)
+    fail ("%d priorities were wrong", wrong_priorities);
+  msg ("All donated priorities were correct.");
+}
+
+static void
+donor_thread_func (void *i_) 
+{
+  int i = (int) i_;
+
+  if (i < DEPTH)
+    lock_acquire (&locks[i]);
+  lock_acquire (&locks[i - 1]);
+
+  if (thread_get_priority () != PRI_MIN + DEPTH)
+    wrong_priorities++;
+
+  lock_release (&locks[i - 1]);
+  if (i < DEPTH)
+    lock_release (&locks[i]);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(priority-donate-deep) begin
+(priority-donate-deep) 20 rounds of donation chains of depth 60.
+(priority-donate-deep) All donated priorities were correct.
+(priority-donate-deep) end
+EOF
+pass;
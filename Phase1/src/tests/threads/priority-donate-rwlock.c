@@ -0,0 +1,74 @@
+/* The main thread and a "reader" thread both hold a
+   readers-writer lock for reading when a higher-priority
+   "writer" thread blocks acquiring it for writing.  The writer's
+   priority must be donated to both readers.  Once the main
+   thread lets go of the lock, the reader still holds it and must
+   keep the donation until it releases the lock in turn, at which
+   point the writer gets in. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct rwlock_test
+  {
+    struct rwlock rw;
+    struct semaphore go;
+  };
+
+static thread_func reader_thread_func;
+static thread_func writer_thread_func;
+
+void
+test_priority_donate_rwlock (void)
+{
+  struct rwlock_test t;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  rw_init (&t.rw, RW_PREFER_WRITERS);
+  sema_init (&t.go, 0);
+
+  rw_read_acquire (&t.rw);
+  msg ("Main acquired read lock.");
+  thread_create ("reader", PRI_DEFAULT + 1, reader_thread_func, &t);
+  thread_create ("writer", PRI_DEFAULT + 10, writer_thread_func, &t);
+  msg ("Main should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+  msg ("Main releasing read lock.");
+  rw_read_release (&t.rw);
+  sema_up (&t.go);
+  msg ("Main finished.");
+}
+
+static void
+reader_thread_func (void *t_)
+{
+  struct rwlock_test *t = t_;
+
+  rw_read_acquire (&t->rw);
+  msg ("Reader acquired read lock.");
+  sema_down (&t->go);
+  msg ("Reader should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 10, thread_get_priority ());
+  rw_read_release (&t->rw);
+  msg ("Reader finished.");
+}
+
+static void
+writer_thread_func (void *t_)
+{
+  struct rwlock_test *t = t_;
+
+  msg ("Writer waiting.");
+  rw_write_acquire (&t->rw);
+  msg ("Writer acquired write lock.");
+  rw_write_release (&t->rw);
+  msg ("Writer finished.");
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-donate-rwlock) begin
+(priority-donate-rwlock) Main acquired read lock.
+(priority-donate-rwlock) Reader acquired read lock.
+(priority-donate-rwlock) Writer waiting.
+(priority-donate-rwlock) Main should have priority 41.  Actual priority: 41.
+(priority-donate-rwlock) Main releasing read lock.
+(priority-donate-rwlock) Reader should have priority 41.  Actual priority: 41.
+(priority-donate-rwlock) Writer acquired write lock.
+(priority-donate-rwlock) Writer finished.
+(priority-donate-rwlock) Reader finished.
+(priority-donate-rwlock) Main finished.
+(priority-donate-rwlock) end
+EOF
+pass;
@@ -8,13 +8,26 @@
    waking up M.  H terminates, then M, then L, and finally the
    main thread.
 
+   Then the test measures how long an inversion through a
+   semaphore lasts.  Low priority thread S registers itself as
+   the signaler of a semaphore and blocks, and high priority
+   thread H blocks downing that semaphore, donating its priority
+   to S.  Medium priority thread M wakes S and then spins for
+   SPIN_TICKS timer ticks.  Without the donation M would keep S
+   off the CPU, and so H waiting, for all of its spin; with it,
+   S runs at once and H wakes within a tick of blocking.  Every
+   thread is kept on one CPU so that S cannot simply run
+   elsewhere.
+
    Written by Godmar Back <gback@cs.vt.edu>. */
 
 #include <stdio.h>
 #include "tests/threads/tests.h"
+#include "threads/cpu.h"
 #include "threads/init.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
 
 struct lock_and_sema 
   {
@@ -22,9 +35,24 @@ struct lock_and_sema
     struct semaphore sema;
   };
 
+/* Timer ticks the medium priority thread spins for. */
+#define SPIN_TICKS 50
+
+struct inversion 
+  {
+    struct semaphore go;        /* Wakes S. */
+    struct semaphore done;      /* Upped by S, downed by H. */
+    int64_t start;              /* When H blocked. */
+    int64_t duration;           /* Ticks H waited. */
+  };
+
 static thread_func l_thread_func;
 static thread_func m_thread_func;
 static thread_func h_thread_func;
+static thread_func s_inv_func;
+static thread_func m_inv_func;
+static thread_func h_inv_func;
+static void measure_inversion (void);
 
 void
 test_priority_donate_sema (void) 
@@ -43,9 +71,32 @@ test_priority_donate_sema (void)
   thread_create ("med", PRI_DEFAULT + 3, m_thread_func, &ls);
   thread_create ("high", PRI_DEFAULT + 5, h_thread_func, &ls);
   sema_up (&ls.sema);
+  measure_inversion ();
   msg ("Main thread finished.");
 }
 
+static void
+measure_inversion (void) 
+{
+  struct inversion inv;
+
+  if (!thread_set_affinity (1u << 0))
+    fail ("CPU 0 is not running threads.");
+
+  sema_init (&inv.go, 0);
+  sema_init (&inv.done, 0);
+  thread_create ("signaler", PRI_DEFAULT + 1, s_inv_func, &inv);
+  thread_create ("high", PRI_DEFAULT + 5, h_inv_func, &inv);
+  thread_create ("med", PRI_DEFAULT + 3, m_inv_func, &inv);
+
+  if (inv.duration >= SPIN_TICKS)
+    fail ("Inversion lasted %lld ticks, the whole of M's spin.",
+          inv.duration);
+  msg ("Inversion lasted less than M's spin.");
+
+  thread_set_affinity (CPU_MASK_ALL);
+}
+
 static void
 l_thread_func (void *ls_) 
 {
@@ -80,3 +131,39 @@ h_thread_func (void *ls_)
   lock_release (&ls->lock);
   msg ("Thread H finished.");
 }
+
+static void
+s_inv_func (void *inv_) 
+{
+  struct inversion *inv = inv_;
+
+  sema_set_signaler (&inv->done, thread_current ());
+  sema_down (&inv->go);
+  msg ("Thread S should have priority %d.  Actual priority: %d.",
+       PRI_DEFAULT + 5, thread_get_priority ());
+  sema_up (&inv->done);
+  sema_set_signaler (&inv->done, NULL);
+  msg ("Thread S finished.");
+}
+
+static void
+m_inv_func (void *inv_) 
+{
+  struct inversion *inv = inv_;
+
+  sema_up (&inv->go);
+  while (timer_elapsed (inv->start) < SPIN_TICKS)
+    continue;
+  msg ("Thread M finished spinning.");
+}
+
+static void
+h_inv_func (void *inv_) 
+{
+  struct inversion *inv = inv_;
+
+  inv->start = timer_ticks ();
+  sema_down (&inv->done);
+  inv->duration = timer_elapsed (inv->start);
+  msg ("Thread H finished.");
+}
@@ -10,6 +10,11 @@ check_expected ([<<'EOF']);
 (priority-donate-sema) Thread H finished.
 (priority-donate-sema) Thread M finished.
 (priority-donate-sema) Thread L finished.
+(priority-donate-sema) Thread S should have priority 36.  Actual priority: 36.
+(priority-donate-sema) Thread H finished.
+(priority-donate-sema) Thread M finished spinning.
+(priority-donate-sema) Thread S finished.
+(priority-donate-sema) Inversion lasted less than M's spin.
 (priority-donate-sema) Main thread finished.
 (priority-donate-sema) end
 EOF
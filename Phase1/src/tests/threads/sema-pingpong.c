@@ -0,0 +1,60 @@
+/* Bounces control between two threads of equal priority through
+   a pair of semaphores, the way sema_self_test() does, and
+   reports how many context switches each round trip costs.
+
+   Waking a thread of equal priority must not preempt the waker,
+   so a round trip needs only the two switches forced by the
+   threads blocking in sema_down(), plus the odd one from the end
+   of a time slice. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ROUNDS 10000
+
+static thread_func pong_thread;
+static struct semaphore ping, pong;
+
+void
+test_sema_pingpong (void) 
+{
+  int64_t start;
+  int64_t switches;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&ping, 0);
+  sema_init (&pong, 0);
+  thread_create ("pong", PRI_DEFAULT, pong_thread, NULL);
+
+  start = thread_switch_count ();
+  for (i = 0; i < ROUNDS; i++) 
+    {
+      sema_up (&ping);
+      sema_down (&pong);
+    }
+  switches = thread_switch_count () - start;
+
+  bench ("%d round trips: %"PRId64" context switches, %"PRId64".%02"PRId64
+         " per round trip", ROUNDS, switches, switches / ROUNDS,
+         switches * 100 / ROUNDS % 100);
+  msg ("%d round trips completed.", ROUNDS);
+}
+
+static void
+pong_thread (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ROUNDS; i++) 
+    {
+      sema_down (&ping);
+      sema_up (&pong);
+    }
+}
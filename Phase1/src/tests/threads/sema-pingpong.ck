@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(sema-pingpong) begin
+(sema-pingpong) 10000 round trips completed.
+(sema-pingpong) end
+EOF
+pass;
@@ -0,0 +1,66 @@
+/* Pins busy threads to the bootstrap processor and checks that
+   none of them is ever seen running anywhere else, even with
+   "-smp" and other processors idle, and that an affinity naming
+   no processor that runs threads is refused. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 4
+#define BUSY_TICKS 10
+
+static thread_func busy_thread;
+static struct semaphore done;
+static volatile bool strayed;
+
+void
+test_smp_affinity (void) 
+{
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  if (thread_set_affinity (0))
+    fail ("empty affinity accepted");
+  msg ("empty affinity refused.");
+
+  /* The threads inherit our affinity. */
+  sema_init (&done, 0);
+  if (!thread_set_affinity (1u << 0))
+    fail ("affinity to cpu 0 refused");
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "busy %d", i);
+      thread_create (name, PRI_DEFAULT, busy_thread, NULL);
+    }
+  thread_set_affinity (CPU_MASK_ALL);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  if (strayed)
+    fail ("pinned thread ran on another processor");
+  msg ("%d pinned threads stayed on cpu 0.", THREAD_CNT);
+}
+
+static void
+busy_thread (void *aux UNUSED) 
+{
+  int64_t start = timer_ticks ();
+
+  while (timer_elapsed (start) < BUSY_TICKS) 
+    {
+      enum intr_level old_level = intr_disable ();
+      if (cpu_current ()->id != 0)
+        strayed = true;
+      intr_set_level (old_level);
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(smp-affinity) begin
+(smp-affinity) empty affinity refused.
+(smp-affinity) 4 pinned threads stayed on cpu 0.
+(smp-affinity) end
+EOF
+pass;
@@ -0,0 +1,66 @@
+/* Creates more busy threads of equal priority than there are
+   processors and checks that they all finish.  With "-smp", the
+   first ones go to idle processors as they are made ready, and
+   processors that run out of work steal the rest.  The number
+   of processors that ran one is reported as a benchmark, since
+   it depends on the machine. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 8
+#define BUSY_TICKS 10
+
+static thread_func busy_thread;
+static struct semaphore done;
+static bool ran_on[CPU_MAX];
+
+void
+test_smp_steal (void) 
+{
+  int cpu_used = 0;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  thread_set_priority (PRI_DEFAULT + 1);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "busy %d", i);
+      thread_create (name, PRI_DEFAULT, busy_thread, NULL);
+    }
+  thread_set_priority (PRI_DEFAULT);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  msg ("%d threads finished.", THREAD_CNT);
+
+  for (i = 0; i < CPU_MAX; i++)
+    if (ran_on[i])
+      cpu_used++;
+  bench ("threads ran on %d of %d processors", cpu_used, cpu_cnt);
+}
+
+static void
+busy_thread (void *aux UNUSED) 
+{
+  int64_t start = timer_ticks ();
+  enum intr_level old_level;
+
+  while (timer_elapsed (start) < BUSY_TICKS)
+    continue;
+
+  old_level = intr_disable ();
+  ran_on[cpu_current ()->id] = true;
+  intr_set_level (old_level);
+  sema_up (&done);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(smp-steal) begin
+(smp-steal) 8 threads finished.
+(smp-steal) end
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Acquires a spin lock again while holding it, the way the
+   scheduler lock is taken again by thread_block() inside
+   sema_down().  Interrupts must stay off until the outermost
+   release, which must turn them back on. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/spinlock.h"
+
+void
+test_spinlock_nest (void) 
+{
+  struct spinlock lock;
+  enum intr_level outer, inner;
+
+  spinlock_init (&lock, "test");
+  ASSERT (!spinlock_held (&lock));
+
+  outer = spinlock_acquire (&lock);
+  ASSERT (outer == INTR_ON);
+  ASSERT (spinlock_held (&lock));
+
+  inner = spinlock_acquire (&lock);
+  ASSERT (inner == INTR_OFF);
+  spinlock_release (&lock, inner);
+  ASSERT (spinlock_held (&lock));
+  ASSERT (intr_get_level () == INTR_OFF);
+  msg ("Inner release kept the lock.");
+
+  spinlock_release (&lock, outer);
+  ASSERT (!spinlock_held (&lock));
+  ASSERT (intr_get_level () == INTR_ON);
+  msg ("Outer release freed the lock.");
+}
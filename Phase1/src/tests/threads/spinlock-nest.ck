@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spinlock-nest) begin
+(spinlock-nest) Inner release kept the lock.
+(spinlock-nest) Outer release freed the lock.
+(spinlock-nest) end
+EOF
+pass;
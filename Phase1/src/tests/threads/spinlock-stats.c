@@ -0,0 +1,29 @@
+/* Checks a spin lock's acquisition counters: only the outermost
+   of nested acquisitions counts, and a lock that no other
+   processor wants is never contended. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/spinlock.h"
+
+#define ROUNDS 3
+
+void
+test_spinlock_stats (void) 
+{
+  static struct spinlock lock;
+  int i;
+
+  spinlock_init (&lock, "test");
+  for (i = 0; i < ROUNDS; i++) 
+    {
+      enum intr_level old_level = spinlock_acquire (&lock);
+      spinlock_lock (&lock);
+      spinlock_unlock (&lock);
+      spinlock_release (&lock, old_level);
+    }
+
+  msg ("%d acquisitions, %d contended.",
+       (int) lock.acquire_cnt, (int) lock.contend_cnt);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spinlock-stats) begin
+(spinlock-stats) 3 acquisitions, 0 contended.
+(spinlock-stats) end
+EOF
+pass;
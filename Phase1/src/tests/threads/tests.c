@@ -25,10 +25,21 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-donate-deep", test_priority_donate_deep},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"priority-condvar-broadcast", test_priority_condvar_broadcast},
+    {"priority-donate-rwlock", test_priority_donate_rwlock},
+    {"sema-pingpong", test_sema_pingpong},
+    {"spinlock-nest", test_spinlock_nest},
+    {"spinlock-stats", test_spinlock_stats},
+    {"smp-steal", test_smp_steal},
+    {"alarm-usleep", test_alarm_usleep},
+    {"smp-affinity", test_smp_affinity},
+    {"malloc-smp", test_malloc_smp},
+    {"thread-churn", test_thread_churn},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
@@ -38,6 +49,8 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"fixed-point-bench", test_fixed_point_bench},
+    {"list-ordered-bench", test_list_ordered_bench},
   };
 
 static const char *test_name;
@@ -93,6 +106,23 @@ fail (const char *format, ...)
   PANIC ("test failed");
 }
 
+/* Prints benchmark result FORMAT as if with printf(),
+   prefixing the output by the name of the test and bench:
+   and following it with a new-line character.  Checkers that
+   pass IGNORE_BENCH to check_expected() skip these lines, since
+   their values vary from run to run. */
+void
+bench (const char *format, ...) 
+{
+  va_list args;
+  
+  printf ("(%s) bench: ", test_name);
+  va_start (args, format);
+  vprintf (format, args);
+  va_end (args);
+  putchar ('\n');
+}
+
 /* Prints a message indicating the current test passed. */
 void
 pass (void) 
@@ -19,10 +19,21 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_donate_deep;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_priority_condvar_broadcast;
+extern test_func test_priority_donate_rwlock;
+extern test_func test_sema_pingpong;
+extern test_func test_spinlock_nest;
+extern test_func test_spinlock_stats;
+extern test_func test_smp_steal;
+extern test_func test_alarm_usleep;
+extern test_func test_smp_affinity;
+extern test_func test_malloc_smp;
+extern test_func test_thread_churn;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -32,9 +43,12 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_fixed_point_bench;
+extern test_func test_list_ordered_bench;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
+void bench (const char *, ...);
 void pass (void);
 
 #endif /* tests/threads/tests.h */
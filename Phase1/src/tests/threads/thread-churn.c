@@ -0,0 +1,77 @@
+/* Creates many short-lived threads, some one at a time and some
+   in a burst that exits all at once, so that thread pages go
+   both through the recycled-page cache and to the reaper.  Each
+   thread checks that it starts out with fresh state. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SERIAL_CNT 200
+#define BURST_CNT 40
+
+static thread_func churn_thread;
+static struct semaphore done;
+static int started;
+
+void
+test_thread_churn (void) 
+{
+  char name[16];
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+
+  /* Each thread outranks us, so it runs and exits before
+     thread_create() returns, leaving its page for the next. */
+  start = timer_ns ();
+  for (i = 0; i < SERIAL_CNT; i++) 
+    {
+      snprintf (name, sizeof name, "churn %d", i);
+      thread_create (name, PRI_DEFAULT + 1, churn_thread, (void *) i);
+      sema_down (&done);
+    }
+  bench ("%lld ns per create/exit cycle",
+         (timer_ns () - start) / SERIAL_CNT);
+  msg ("%d threads ran one at a time.", SERIAL_CNT);
+
+  /* These all wait until we block, then exit together. */
+  for (i = 0; i < BURST_CNT; i++) 
+    {
+      snprintf (name, sizeof name, "churn %d", SERIAL_CNT + i);
+      thread_create (name, PRI_DEFAULT - 1, churn_thread,
+                     (void *) (SERIAL_CNT + i));
+    }
+  for (i = 0; i < BURST_CNT; i++)
+    sema_down (&done);
+  msg ("%d threads ran together.", BURST_CNT);
+
+  if (started != SERIAL_CNT + BURST_CNT)
+    fail ("%d threads ran, expected %d", started, SERIAL_CNT + BURST_CNT);
+}
+
+static void
+churn_thread (void *aux) 
+{
+  int id = (int) aux;
+  char name[16];
+  int expected = id < SERIAL_CNT ? PRI_DEFAULT + 1 : PRI_DEFAULT - 1;
+
+  snprintf (name, sizeof name, "churn %d", id);
+  if (strcmp (thread_name (), name))
+    fail ("thread %d is named \"%s\"", id, thread_name ());
+  if (thread_get_priority () != expected)
+    fail ("thread %d has priority %d, expected %d",
+          id, thread_get_priority (), expected);
+
+  started++;
+  sema_up (&done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(thread-churn) begin
+(thread-churn) 200 threads ran one at a time.
+(thread-churn) 40 threads ran together.
+(thread-churn) end
+EOF
+pass;
@@ -0,0 +1,77 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <string.h>
+#include "devices/lapic.h"
+
+/* All the processors we know about.  cpus[0] is the bootstrap
+   processor, the one running main(). */
+struct cpu cpus[CPU_MAX];
+int cpu_cnt;
+
+/* Processors kept out of general load balancing: only threads
+   whose affinity names them explicitly run there.  Controlled by
+   kernel command-line option "-isolcpus". */
+unsigned cpu_isolated;
+
+/* Maps a local APIC ID to its entry in cpus[].  Until the
+   bootstrap processor has been entered, which also means that
+   the local APIC can be asked for our ID, every caller is taken
+   to be the bootstrap processor. */
+static struct cpu *apic_to_cpu[256];
+static bool by_apic_id;
+
+/* Sets up the entry for the bootstrap processor.  Until
+   smp_init() finds the others, that is the only CPU. */
+void
+cpu_init (void)
+{
+  memset (cpus, 0, sizeof cpus);
+  cpus[0].id = 0;
+  cpus[0].started = true;
+  cpu_cnt = 1;
+}
+
+/* Records a processor whose local APIC ID is APIC_ID.  The
+   bootstrap processor, whose ID lapic_id() returns, keeps
+   cpus[0].  Returns the processor's struct cpu, or a null
+   pointer if there are already CPU_MAX of them. */
+struct cpu *
+cpu_add (uint8_t apic_id)
+{
+  struct cpu *c;
+
+  if (apic_id == lapic_id ())
+    c = &cpus[0];
+  else if (cpu_cnt < CPU_MAX)
+    {
+      c = &cpus[cpu_cnt];
+      c->id = cpu_cnt++;
+    }
+  else
+    return NULL;
+
+  c->apic_id = apic_id;
+  apic_to_cpu[apic_id] = c;
+  if (c == &cpus[0])
+    by_apic_id = true;
+  return c;
+}
+
+/* Returns the processor we are running on.  Before smp_init()
+   has found the others, that can only be the bootstrap
+   processor.
+
+   The answer is only stable while interrupts are off: otherwise
+   the caller might be preempted and resumed elsewhere. */
+struct cpu *
+cpu_current (void)
+{
+  struct cpu *c;
+
+  if (!by_apic_id)
+    return &cpus[0];
+
+  c = apic_to_cpu[lapic_id ()];
+  ASSERT (c != NULL);
+  return c;
+}
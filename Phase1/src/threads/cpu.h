@@ -0,0 +1,62 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Most processors we will bring up. */
+#define CPU_MAX 8
+
+/* Sets of processors are bitmasks of their indexes in cpus[]. */
+#define CPU_MASK_ALL ((1u << CPU_MAX) - 1)
+
+/* Per-CPU state.  Everything a processor needs to know about
+   what it alone is doing lives here rather than in globals, so
+   that each processor can update its own copy without locking.
+   A CPU only ever touches its own struct cpu, except that the
+   bootstrap processor fills in the others while starting them. */
+struct cpu
+  {
+    int id;                     /* Index in cpus[]. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    struct thread *current;     /* Thread running on this CPU. */
+    struct thread *idle_thread; /* Runs when nothing else is ready. */
+
+    /* Statistics. */
+    long long idle_ticks;       /* # of timer ticks spent idle. */
+    long long kernel_ticks;     /* # of timer ticks in kernel threads. */
+    long long user_ticks;       /* # of timer ticks in user programs. */
+    unsigned thread_ticks;      /* # of timer ticks since last yield. */
+
+    /* Interrupt nesting. */
+    bool in_external_intr;      /* Processing an external interrupt? */
+    bool yield_on_return;       /* Yield on interrupt return? */
+
+    volatile bool started;      /* Set by the CPU once it is running. */
+    bool online;                /* Running threads? */
+
+#ifdef USERPROG
+    /* Owned by userprog/pagedir.c. */
+    uint32_t *volatile pagedir; /* Page directory loaded in CR3. */
+#endif
+  };
+
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+extern unsigned cpu_isolated;
+
+/* Returns the processor's time-stamp counter, which counts
+   cycles at a constant rate on the machines we run on. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+void cpu_init (void);
+struct cpu *cpu_add (uint8_t apic_id);
+struct cpu *cpu_current (void);
+
+#endif /* threads/cpu.h */
@@ -3,24 +3,87 @@
 
 #include <stdint.h>
 
+/* Signed 17.14 fixed-point real numbers, used by the mlfqs
+   scheduler.  Every operation is a static inline function, so
+   the arithmetic done from the timer interrupt compiles down to
+   a few integer instructions, and operations on constants fold
+   at compile time. */
 struct real {
     int val;
 };
 
-extern const int q;
-extern const int f;
+#define FP_Q 14                 /* Number of fraction bits. */
+#define FP_F (1 << FP_Q)        /* The fixed-point value 1. */
 
+/* The real N/D, rounded toward zero.  Constant N and D fold to
+   a constant. */
+#define FP_CONST(N, D) \
+  ((struct real) { (int) ((int64_t) (N) * FP_F / (D)) })
 
-struct real int_to_real(int n);
-int real_to_int_toward_zero(struct real r);
-int real_to_int_toward_nearest(struct real r);
-struct real add(struct real x, struct real y);
-struct real subtract(struct real x, struct real y);
-struct real add_real_to_int(struct real r,int n);
-struct real sub_int_from_real(struct real r,int n);
-struct real multiply(struct real x, struct real y);
-struct real multiply_by_int(struct real x, int n);
-struct real divide(struct real x, struct real y);
-struct real divide_by_int(struct real x, int n);
+/* Coefficients of the load_avg equation. */
+#define FP_59_60 FP_CONST (59, 60)
+#define FP_1_60 FP_CONST (1, 60)
 
-#endif
\ No newline at end of file
+static inline struct real int_to_real(int n) {
+    struct real r;
+    r.val = n * FP_F;
+    return r;
+}
+
+static inline int real_to_int_toward_zero(struct real r) {
+    return r.val / FP_F;
+}
+
+static inline int real_to_int_toward_nearest(struct real r) {
+    return (r.val >= 0) ? (r.val + FP_F / 2) / FP_F : (r.val - FP_F / 2) / FP_F;
+}
+
+static inline struct real add(struct real x, struct real y) {
+    struct real res;
+    res.val = x.val + y.val;
+    return res;
+}
+
+static inline struct real subtract(struct real x, struct real y) {
+    struct real res;
+    res.val = x.val - y.val;
+    return res;
+}
+
+static inline struct real add_real_to_int(struct real r,int n){
+    struct real res;
+    res.val = r.val + n * FP_F;
+    return res;
+}
+
+static inline struct real sub_int_from_real(struct real r,int n){
+    struct real res;
+    res.val = r.val - n * FP_F;
+    return res;
+}
+
+static inline struct real multiply(struct real x, struct real y) {
+    struct real res;
+    res.val = ((int64_t) x.val) * y.val / FP_F;
+    return res;
+}
+
+static inline struct real multiply_by_int(struct real x, int n) {
+    struct real res;
+    res.val = x.val * n;
+    return res;
+}
+
+static inline struct real divide(struct real x, struct real y) {
+    struct real res;
+    res.val = ((int64_t) x.val) * FP_F / y.val;
+    return res;
+}
+
+static inline struct real divide_by_int(struct real x, int n) {
+    struct real res;
+    res.val = x.val / n;
+    return res;
+}
+
+#endif
@@ -15,17 +15,21 @@
 #include "devices/timer.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/cpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/smp.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #else
@@ -62,6 +66,7 @@ static void paging_init (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
+static void parse_isolcpus (char *list);
 static void run_actions (char **argv);
 static void usage (void);
 
@@ -113,12 +118,15 @@ main (void)
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  pagedir_init ();
 #endif
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
   timer_calibrate ();
+  smp_init ();
+  trace_init ();
 
 #ifdef FILESYS
   /* Initialize file system. */
@@ -188,6 +196,33 @@ paging_init (void)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
 }
 
+/* Maps the page of memory-mapped device registers at physical
+   address PHYS, which lies above all of RAM, uncached into the
+   kernel's address space at the same virtual address, and
+   returns that address.  The registers of the local and I/O
+   APICs live near the top of the 4 GB physical address space,
+   where paging_init() leaves the kernel's virtual address space
+   unused. */
+void *
+paging_map_io (uintptr_t phys)
+{
+  uint32_t *pd = init_page_dir;
+  uint32_t *pt;
+  void *vaddr = (void *) (phys & PTE_ADDR);
+
+  ASSERT (vaddr >= ptov (init_ram_pages * PGSIZE));
+
+  if (pd[pd_no (vaddr)] == 0)
+    pd[pd_no (vaddr)] = pde_create (palloc_get_page (PAL_ASSERT | PAL_ZERO));
+  pt = pde_get_pt (pd[pd_no (vaddr)]);
+  pt[pt_no (vaddr)] = (phys & PTE_ADDR) | PTE_PCD | PTE_PWT | PTE_W | PTE_P;
+
+  /* Flush the TLB entry.  See [IA32-v3a] 3.12 "Translation
+     Lookaside Buffers (TLBs)". */
+  asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+  return (void *) phys;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -223,6 +258,27 @@ read_command_line (void)
   return argv;
 }
 
+/* Parses LIST, a comma-separated list of processor indexes, as
+   the value of the "-isolcpus" option.  The bootstrap processor,
+   0, cannot be isolated, since it is the only one that runs
+   threads unless "-smp" is given. */
+static void
+parse_isolcpus (char *list) 
+{
+  char *cpu, *save_ptr;
+
+  if (list == NULL)
+    PANIC ("-isolcpus requires a list of CPUs");
+  for (cpu = strtok_r (list, ",", &save_ptr); cpu != NULL;
+       cpu = strtok_r (NULL, ",", &save_ptr))
+    {
+      int id = atoi (cpu);
+      if (id <= 0 || id >= CPU_MAX)
+        PANIC ("-isolcpus: cannot isolate CPU `%s'", cpu);
+      cpu_isolated |= 1u << id;
+    }
+}
+
 /* Parses options in ARGV[]
    and returns the first non-option argument. */
 static char **
@@ -254,8 +310,18 @@ parse_options (char **argv)
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
+      else if (!strcmp (name, "-lpt"))
+        timer_cached_lpt = atoi (value);
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-smp"))
+        thread_smp = true;
+      else if (!strcmp (name, "-isolcpus"))
+        parse_isolcpus (value);
+      else if (!strcmp (name, "-trace"))
+        thread_trace = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -378,7 +444,12 @@ usage (void)
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
+          "  -lpt=N             Use N timer loops per tick; skip calibration.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -tickless          Skip timer ticks while idle.\n"
+          "  -smp               Run threads on every processor.\n"
+          "  -isolcpus=LIST     Run only pinned threads on CPUs in LIST.\n"
+          "  -trace             Trace the scheduler, dump trace at power off.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
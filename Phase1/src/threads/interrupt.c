@@ -3,11 +3,13 @@
 #include <inttypes.h>
 #include <stdint.h>
 #include <stdio.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#include "devices/lapic.h"
 #include "devices/timer.h"
 
 /* Programmable Interrupt Controller (PIC) registers.
@@ -43,9 +45,9 @@ static unsigned int unexpected_cnt[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.  Each processor tracks this for itself, in
+   the in_external_intr and yield_on_return members of its struct
+   cpu. */
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
@@ -157,6 +159,15 @@ intr_init (void)
   intr_names[19] = "#XF SIMD Floating-Point Exception";
 }
 
+/* Points the calling processor, other than the bootstrap
+   processor, at the IDT set up by intr_init(). */
+void
+intr_init_ap (void)
+{
+  uint64_t idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
+}
+
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
    privilege level DPL.  Names the interrupt NAME for debugging
    purposes.  The interrupt handler will be invoked with
@@ -185,6 +196,19 @@ intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
+/* Registers local APIC interrupt VEC_NO, an interprocessor
+   interrupt or the local APIC timer, to invoke HANDLER, which is
+   named NAME for debugging purposes.  These are handled like
+   external interrupts, except that they are acknowledged on the
+   local APIC rather than the PIC. */
+void
+intr_register_lapic (uint8_t vec_no, intr_handler_func *handler,
+                   const char *name) 
+{
+  ASSERT (vec_no >= LAPIC_VEC_MIN && vec_no <= LAPIC_VEC_MAX);
+  register_handler (vec_no, 0, INTR_OFF, handler, name);
+}
+
 /* Registers internal interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The interrupt handler
    will be invoked with interrupt status LEVEL.
@@ -211,6 +235,10 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 bool
 intr_context (void) 
 {
+  enum intr_level old_level = intr_disable ();
+  bool in_external_intr = cpu_current ()->in_external_intr;
+  intr_set_level (old_level);
+
   return in_external_intr;
 }
 
@@ -222,9 +250,25 @@ void
 intr_yield_on_return (void) 
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  cpu_current ()->yield_on_return = true;
 }
 
+/* Returns true if external interrupt VEC has been raised at the
+   PIC but not yet delivered to the CPU, as happens while
+   interrupts are turned off. */
+bool
+intr_ext_pending (uint8_t vec)
+{
+  int irq = vec - 0x20;
+  int port = irq < 8 ? PIC0_CTRL : PIC1_CTRL;
+
+  ASSERT (vec >= 0x20 && vec <= 0x2f);
+
+  /* OCW3: read the interrupt request register. */
+  outb (port, 0x0a);
+  return (inb (port) & (1 << (irq & 7))) != 0;
+}
+
 /* 8259A Programmable Interrupt Controller. */
 
 /* Initializes the PICs.  Refer to [8259A] for details.
@@ -344,6 +388,7 @@ make_idtr_operand (uint16_t limit, void *base)
 void
 intr_handler (struct intr_frame *frame) 
 {
+  struct cpu *c = cpu_current ();
   bool external;
   intr_handler_func *handler;
 
@@ -351,14 +396,16 @@ intr_handler (struct intr_frame *frame)
      We only handle one at a time (so interrupts must be off)
      and they need to be acknowledged on the PIC (see below).
      An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+  external = ((frame->vec_no >= 0x20 && frame->vec_no < 0x30)
+              || (frame->vec_no >= LAPIC_VEC_MIN
+                  && frame->vec_no <= LAPIC_VEC_MAX));
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (!intr_context ());
 
-      in_external_intr = true;
-      yield_on_return = false;
+      c->in_external_intr = true;
+      c->yield_on_return = false;
     }
 
   /* Invoke the interrupt's handler. */
@@ -380,10 +427,13 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no); 
+      c->in_external_intr = false;
+      if (frame->vec_no < 0x30)
+        pic_end_of_interrupt (frame->vec_no); 
+      else
+        lapic_eoi ();
 
-      if (yield_on_return) 
+      if (c->yield_on_return) 
         thread_yield (); 
     }
 }
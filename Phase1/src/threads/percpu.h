@@ -0,0 +1,104 @@
+#ifndef THREADS_PERCPU_H
+#define THREADS_PERCPU_H
+
+#include <stdint.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/* Per-CPU event counters.
+
+   A counter bumped on a hot path, such as sectors read or page
+   faults, keeps a slot per CPU, each in a cache line of its own.
+   percpu_add() touches only the running CPU's slot, so CPUs never
+   contend for a counter's line and need no locked instruction,
+   and percpu_sum() adds the slots up when the counter is read,
+   which is rare.
+
+   Only a slot's own CPU writes it, with interrupts off, so
+   writers never race.  The 64-bit add takes two instructions on
+   an 80x86, though, so a CPU summing another's slot could see it
+   torn mid-add.  Each slot therefore has a sequence number that
+   is odd while an add is under way, and a reader retries until
+   it reads the same even number before and after the value. */
+
+/* Bytes in a CPU cache line. */
+#define CACHE_LINE 64
+
+/* One CPU's part of a counter. */
+struct percpu_slot
+  {
+    unsigned seq;               /* Odd while an add is under way. */
+    int64_t value;
+  } __attribute__ ((aligned (CACHE_LINE)));
+
+/* A per-CPU counter.  A static one starts at zero; one in
+   allocated memory must be cleared with percpu_reset(). */
+struct percpu_counter
+  {
+    struct percpu_slot cpu[CPU_MAX];
+  };
+
+/* Adds N to counter C, in the running CPU's slot. */
+static inline void
+percpu_add (struct percpu_counter *c, int64_t n)
+{
+  enum intr_level old_level = intr_disable ();
+  volatile struct percpu_slot *s = &c->cpu[cpu_current ()->id];
+
+  s->seq++;
+  barrier ();
+  s->value += n;
+  barrier ();
+  s->seq++;
+  intr_set_level (old_level);
+}
+
+/* Adds 1 to counter C. */
+static inline void
+percpu_inc (struct percpu_counter *c)
+{
+  percpu_add (c, 1);
+}
+
+/* Returns the value of counter C, summed over every CPU. */
+static inline int64_t
+percpu_sum (const struct percpu_counter *c)
+{
+  int64_t sum = 0;
+  int i;
+
+  for (i = 0; i < CPU_MAX; i++)
+    {
+      const volatile struct percpu_slot *s = &c->cpu[i];
+      unsigned seq;
+      int64_t value;
+
+      do
+        {
+          seq = s->seq;
+          barrier ();
+          value = s->value;
+          barrier ();
+        }
+      while ((seq & 1) != 0 || seq != s->seq);
+      sum += value;
+    }
+  return sum;
+}
+
+/* Sets counter C to zero on every CPU.  No CPU may be adding to
+   it meanwhile. */
+static inline void
+percpu_reset (struct percpu_counter *c)
+{
+  int i;
+
+  for (i = 0; i < CPU_MAX; i++)
+    {
+      c->cpu[i].seq = 0;
+      c->cpu[i].value = 0;
+    }
+}
+
+#endif /* threads/percpu.h */
@@ -0,0 +1,313 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/ioapic.h"
+#include "devices/lapic.h"
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/pte.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Multiprocessor start-up.
+
+   The BIOS describes the processors and APICs in the tables of
+   the MultiProcessor Specification, version 1.4 [MP].  We find
+   them, enable the local APIC, and start each application
+   processor (AP), that is, each processor other than the
+   bootstrap processor that is running main(), with the
+   INIT-SIPI-SIPI sequence of [IA32-v3a] 8.4.4.1 "Typical BSP
+   Initialization Sequence".
+
+   Device interrupts keep coming only to the bootstrap
+   processor, through the 8259 PIC, which forwards timer ticks
+   to the APs.  Unless the "-smp" option is given, every AP is
+   parked in its idle thread with interrupts off once it is up. */
+
+/* MP floating pointer structure, [MP] 4.1. */
+struct mp_fps
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of config table. */
+    uint8_t length;             /* In 16-byte units; always 1. */
+    uint8_t spec_rev;           /* Version of the specification. */
+    uint8_t checksum;           /* All bytes add up to 0. */
+    uint8_t feature[5];         /* Nonzero FEATURE[0]: default config. */
+  } __attribute__ ((packed));
+
+/* MP configuration table header, [MP] 4.2. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Base table length, with header. */
+    uint8_t spec_rev;           /* Version of the specification. */
+    uint8_t checksum;           /* All bytes add up to 0. */
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_cnt;         /* Entries following the header. */
+    uint32_t lapic;             /* Physical address of local APICs. */
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+  } __attribute__ ((packed));
+
+/* Configuration table entry types and their lengths. */
+#define MP_PROCESSOR 0          /* struct mp_processor, 20 bytes. */
+#define MP_IOAPIC    2          /* struct mp_ioapic, 8 bytes. */
+
+/* Processor entry, [MP] 4.3.1. */
+struct mp_processor
+  {
+    uint8_t type;               /* MP_PROCESSOR. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_ver;
+    uint8_t flags;              /* MPP_* below. */
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+  } __attribute__ ((packed));
+
+#define MPP_ENABLED 0x01        /* Usable. */
+
+/* I/O APIC entry, [MP] 4.3.3. */
+struct mp_ioapic
+  {
+    uint8_t type;               /* MP_IOAPIC. */
+    uint8_t apic_id;
+    uint8_t apic_ver;
+    uint8_t flags;              /* MPIO_* below. */
+    uint32_t addr;              /* Physical address. */
+  } __attribute__ ((packed));
+
+#define MPIO_ENABLED 0x01       /* Usable. */
+
+/* Start-up code, in ap-start.S. */
+extern uint8_t ap_start[], ap_start_end[];
+extern uint8_t ap_cr3[], ap_esp[], ap_entry[];
+
+/* Kernel virtual address of LABEL in the copy of the start-up
+   code at AP_START_PHYS. */
+#define AP_SLOT(LABEL) \
+  ((uint32_t *) ((uint8_t *) ptov (AP_START_PHYS) + ((LABEL) - ap_start)))
+
+/* Set by the bootstrap processor once every AP has started and
+   the low memory mapping they started on is gone. */
+static volatile bool aps_released;
+
+static struct mp_config *mp_config_find (void);
+static uintptr_t lapic_base_find (void);
+static void start_ap (struct cpu *);
+static void ap_main (void) NO_RETURN;
+
+/* Finds the processors described by the BIOS and starts all but
+   the one we are running on. */
+void
+smp_init (void)
+{
+  struct mp_config *config = mp_config_find ();
+  uint32_t *pd = init_page_dir;
+  enum intr_level old_level;
+  uintptr_t lapic_base;
+  uint8_t *p;
+  int started;
+  int i;
+
+  /* Without an MP table there is only the one processor, but its
+     local APIC, if it has one, still provides a timer. */
+  lapic_base = config != NULL ? config->lapic : lapic_base_find ();
+  if (lapic_base == 0)
+    return;
+
+  old_level = intr_disable ();
+  lapic_map (lapic_base);
+  p = config != NULL ? (uint8_t *) (config + 1) : NULL;
+  for (i = 0; config != NULL && i < config->entry_cnt; i++)
+    if (*p == MP_PROCESSOR)
+      {
+        struct mp_processor *proc = (struct mp_processor *) p;
+        if ((proc->flags & MPP_ENABLED) && cpu_add (proc->apic_id) == NULL)
+          printf ("smp: ignoring processor %d, only %d supported\n",
+                  proc->apic_id, CPU_MAX);
+        p += sizeof *proc;
+      }
+    else if (*p == MP_IOAPIC)
+      {
+        struct mp_ioapic *io = (struct mp_ioapic *) p;
+        if (io->flags & MPIO_ENABLED)
+          ioapic_init (io->addr);
+        p += sizeof *io;
+      }
+    else
+      p += 8;
+
+  /* The bootstrap processor might be missing from a broken
+     table. */
+  cpu_add (lapic_id ());
+  lapic_init (true);
+  intr_set_level (old_level);
+  lapic_timer_calibrate ();
+
+  if (cpu_cnt == 1)
+    return;
+
+  /* Copy the start-up code, and map it at its physical address,
+     where it runs until paging is enabled. */
+  memcpy (ptov (AP_START_PHYS), ap_start, ap_start_end - ap_start);
+  *AP_SLOT (ap_cr3) = vtop (init_page_dir);
+  *AP_SLOT (ap_entry) = (uint32_t) ap_main;
+  pd[0] = pd[pd_no (PHYS_BASE)];
+
+  started = 1;
+  for (i = 1; i < cpu_cnt; i++)
+    {
+      start_ap (&cpus[i]);
+      if (cpus[i].started)
+        started++;
+      else
+        printf ("smp: cpu%d (APIC %d) did not start\n",
+                i, cpus[i].apic_id);
+    }
+
+  pd[0] = 0;
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+  aps_released = true;
+
+  printf ("smp: %d of %d processors running\n", started, cpu_cnt);
+}
+
+/* Returns true if the LEN bytes at P add up to 0. */
+static bool
+checksum_ok (const void *p, size_t len)
+{
+  const uint8_t *b = p;
+  uint8_t sum = 0;
+
+  while (len-- > 0)
+    sum += *b++;
+  return sum == 0;
+}
+
+/* Searches the LEN bytes at physical address PHYS for an MP
+   floating pointer structure and returns it, or a null pointer
+   if there is none. */
+static struct mp_fps *
+mp_fps_search (uintptr_t phys, size_t len)
+{
+  uint8_t *p = ptov (phys);
+  uint8_t *end = p + len;
+
+  for (; p + sizeof (struct mp_fps) <= end; p += sizeof (struct mp_fps))
+    if (!memcmp (p, "_MP_", 4) && checksum_ok (p, sizeof (struct mp_fps)))
+      return (struct mp_fps *) p;
+  return NULL;
+}
+
+/* Finds the MP configuration table in the places listed in [MP]
+   4 "MP Configuration Table": the first kB of the extended BIOS
+   data area, the last kB of base memory, and the BIOS ROM.
+   Returns a null pointer if there is none, or if the BIOS uses a
+   default configuration, which no virtual machine we run on
+   does. */
+static struct mp_config *
+mp_config_find (void)
+{
+  uintptr_t ebda = *(uint16_t *) ptov (0x40e) << 4;
+  uintptr_t base_kb = *(uint16_t *) ptov (0x413);
+  struct mp_fps *fps = NULL;
+  struct mp_config *config;
+
+  if (ebda != 0)
+    fps = mp_fps_search (ebda, 1024);
+  if (fps == NULL)
+    fps = mp_fps_search (base_kb * 1024 - 1024, 1024);
+  if (fps == NULL)
+    fps = mp_fps_search (0xf0000, 0x10000);
+  if (fps == NULL || fps->config == 0
+      || fps->config >= init_ram_pages * PGSIZE)
+    return NULL;
+
+  config = ptov (fps->config);
+  if (memcmp (config->signature, "PCMP", 4)
+      || !checksum_ok (config, config->length))
+    return NULL;
+  return config;
+}
+
+/* Returns the physical address of the local APIC, as read from
+   the IA32_APIC_BASE MSR, or 0 if CPUID says the processor does
+   not have one.  [IA32-v3a] 10.4.4 "Local APIC Status and
+   Location". */
+static uintptr_t
+lapic_base_find (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  uint64_t base;
+
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (1));
+  if (!(edx & (1u << 9)))
+    return 0;
+
+  asm volatile ("rdmsr" : "=A" (base) : "c" (0x1b));
+  return base & 0xfffff000;
+}
+
+/* Starts application processor C and waits up to 100 ms for it
+   to come up. */
+static void
+start_ap (struct cpu *c)
+{
+  struct thread *idle = thread_create_idle (c);
+  int ms;
+
+  if (idle == NULL)
+    return;
+  *AP_SLOT (ap_esp) = (uint32_t) idle + PGSIZE;
+
+  lapic_send_init (c->apic_id);
+  timer_mdelay (10);
+  lapic_send_startup (c->apic_id, AP_START_PHYS);
+  timer_udelay (200);
+  if (!c->started)
+    {
+      lapic_send_startup (c->apic_id, AP_START_PHYS);
+      timer_udelay (200);
+    }
+
+  for (ms = 0; ms < 100 && !c->started; ms++)
+    timer_mdelay (1);
+}
+
+/* Where an AP arrives from ap-start.S, running on the stack of
+   its idle thread with interrupts off. */
+static void
+ap_main (void)
+{
+  struct cpu *c;
+
+  intr_init_ap ();
+  lapic_init (false);
+  c = cpu_current ();
+  c->started = true;
+
+  /* Drop the low memory mapping from the TLB once it is gone. */
+  while (!aps_released)
+    asm volatile ("pause");
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)) : "memory");
+
+  if (thread_smp)
+    thread_start_ap ();
+
+  /* Park. */
+  for (;;)
+    asm volatile ("hlt");
+}
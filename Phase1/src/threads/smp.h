@@ -0,0 +1,14 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+/* Physical address to which the application processors' start-up
+   code is copied.  It must be page-aligned and below 1 MB, and
+   Pintos does not otherwise use memory between the loader and
+   the initial thread's page (see start.S). */
+#define AP_START_PHYS 0x8000
+
+#ifndef __ASSEMBLER__
+void smp_init (void);
+#endif
+
+#endif /* threads/smp.h */
@@ -0,0 +1,168 @@
+#include "threads/spinlock.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+
+/* All spin locks passed to spinlock_init(), most recent first,
+   and the lock that protects the list. */
+static struct spinlock *all_locks;
+static struct spinlock all_locks_lock;
+
+/* Initializes LOCK, called NAME, as free. */
+void
+spinlock_init (struct spinlock *lock, const char *name)
+{
+  enum intr_level old_level;
+
+  ASSERT (lock != NULL);
+
+  lock->next = lock->owner = 0;
+  lock->holder = NULL;
+  lock->depth = 0;
+  lock->name = name;
+  lock->acquire_cnt = lock->contend_cnt = lock->spin_cycles = 0;
+
+  old_level = spinlock_acquire (&all_locks_lock);
+  lock->next_lock = all_locks;
+  all_locks = lock;
+  spinlock_release (&all_locks_lock, old_level);
+}
+
+/* Acquires LOCK, spinning until it is our turn.  Interrupts
+   must be off. */
+void
+spinlock_lock (struct spinlock *lock)
+{
+  struct cpu *c;
+  uint16_t ticket;
+
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  c = cpu_current ();
+  if (lock->holder == c)
+    {
+      lock->depth++;
+      return;
+    }
+
+  /* Take a ticket, then wait to be served. */
+  ticket = 1;
+  asm volatile ("lock xaddw %0, %1"
+                : "+r" (ticket), "+m" (lock->next) : : "memory");
+  if (lock->owner != ticket)
+    {
+      uint64_t start = rdtsc ();
+      while (lock->owner != ticket)
+        asm volatile ("pause" : : : "memory");
+      lock->spin_cycles += rdtsc () - start;
+      lock->contend_cnt++;
+    }
+
+  lock->holder = c;
+  lock->depth = 1;
+  lock->acquire_cnt++;
+}
+
+/* Acquires LOCK if it is free or already ours, without waiting.
+   Returns true if successful, false if another processor holds
+   LOCK or is waiting for it.  Interrupts must be off. */
+bool
+spinlock_try_lock (struct spinlock *lock)
+{
+  struct cpu *c;
+  uint16_t ticket, seen;
+
+  ASSERT (lock != NULL);
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  c = cpu_current ();
+  if (lock->holder == c)
+    {
+      lock->depth++;
+      return true;
+    }
+
+  /* The lock is free when the next ticket is the one being
+     served.  Take it only if no one else takes it first. */
+  ticket = seen = lock->owner;
+  if (lock->next != ticket)
+    return false;
+  asm volatile ("lock cmpxchgw %2, %1"
+                : "+a" (seen), "+m" (lock->next)
+                : "r" ((uint16_t) (ticket + 1))
+                : "memory");
+  if (seen != ticket)
+    return false;
+
+  lock->holder = c;
+  lock->depth = 1;
+  lock->acquire_cnt++;
+  return true;
+}
+
+/* Releases LOCK, which the current processor must hold. */
+void
+spinlock_unlock (struct spinlock *lock)
+{
+  ASSERT (spinlock_held (lock));
+
+  if (--lock->depth == 0)
+    {
+      lock->holder = NULL;
+
+      /* Only the holder writes OWNER, so no locked instruction
+         is needed, only that the compiler and the processor do
+         not move the critical section's stores past this one,
+         which x86 guarantees for stores. */
+      asm volatile ("" : : : "memory");
+      lock->owner++;
+    }
+}
+
+/* Turns interrupts off and acquires LOCK.  Returns the previous
+   interrupt level, to be passed to spinlock_release(). */
+enum intr_level
+spinlock_acquire (struct spinlock *lock)
+{
+  enum intr_level old_level = intr_disable ();
+  spinlock_lock (lock);
+  return old_level;
+}
+
+/* Releases LOCK, which the current processor must hold, and
+   sets the interrupt level to OLD_LEVEL, as returned by the
+   matching spinlock_acquire(). */
+void
+spinlock_release (struct spinlock *lock, enum intr_level old_level)
+{
+  spinlock_unlock (lock);
+  intr_set_level (old_level);
+}
+
+/* Returns true if the current processor holds LOCK.  (Asking
+   whether some other processor holds it would be racy.) */
+bool
+spinlock_held (const struct spinlock *lock)
+{
+  ASSERT (lock != NULL);
+
+  return intr_get_level () == INTR_OFF && lock->holder == cpu_current ();
+}
+
+/* Prints the statistics of every spin lock that has been
+   acquired, so that contended ones stand out. */
+void
+spinlock_print_stats (void)
+{
+  struct spinlock *lock;
+
+  for (lock = all_locks; lock != NULL; lock = lock->next_lock)
+    if (lock->acquire_cnt > 0)
+      printf ("Spinlock %s: %"PRIu64" acquisitions, %"PRIu64" contended, "
+              "%"PRIu64" cycles spinning\n",
+              lock->name, lock->acquire_cnt, lock->contend_cnt,
+              lock->spin_cycles);
+}
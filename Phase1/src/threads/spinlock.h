@@ -0,0 +1,58 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* Spin lock.
+
+   A spin lock keeps the other processors out of a critical
+   section in the same way that turning interrupts off keeps out
+   the other threads on this one.  It is a ticket lock: each
+   processor that wants the lock takes the next ticket and waits
+   for its number to be served, so processors get the lock in
+   the order they asked for it, and while waiting they only read
+   the lock.
+
+   spinlock_acquire() also turns interrupts off until the
+   matching spinlock_release(), which makes it a drop-in
+   replacement for an intr_disable() / intr_set_level() pair.
+   Code that already runs with interrupts off, such as an
+   interrupt handler, may use spinlock_lock() and
+   spinlock_unlock() instead.  spinlock_try_lock() takes the
+   lock only if it is free, for code that already holds another
+   spin lock and must not wait for this one.
+
+   Like intr_disable(), a spin lock may be acquired again by the
+   processor that holds it.  Each acquisition must be matched by
+   a release.
+
+   An all-zero spin lock is free, so a static one needs no
+   initialization.  spinlock_init() also enters a lock in the
+   list that spinlock_print_stats() reports on. */
+struct spinlock
+  {
+    volatile uint16_t next;     /* Next ticket to hand out. */
+    volatile uint16_t owner;    /* Ticket being served. */
+    struct cpu *holder;         /* Processor holding the lock. */
+    unsigned depth;             /* Times HOLDER has acquired it. */
+    const char *name;           /* For debugging. */
+
+    /* Statistics. */
+    uint64_t acquire_cnt;       /* # of times acquired. */
+    uint64_t contend_cnt;       /* # of those it was held elsewhere. */
+    uint64_t spin_cycles;       /* Time spent waiting, in TSC cycles. */
+    struct spinlock *next_lock; /* Next in list of all spin locks. */
+  };
+
+void spinlock_init (struct spinlock *, const char *name);
+enum intr_level spinlock_acquire (struct spinlock *);
+void spinlock_release (struct spinlock *, enum intr_level);
+void spinlock_lock (struct spinlock *);
+bool spinlock_try_lock (struct spinlock *);
+void spinlock_unlock (struct spinlock *);
+bool spinlock_held (const struct spinlock *);
+void spinlock_print_stats (void);
+
+#endif /* threads/spinlock.h */
@@ -32,6 +32,278 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* Arrival counter for wait_elem.seq. */
+static unsigned wait_seq;
+
+/* Returns true if A should be woken before B. */
+static bool
+wait_before (const struct wait_elem *a, const struct wait_elem *b) 
+{
+  if (a->priority != b->priority)
+    return a->priority > b->priority;
+  return (int) (a->seq - b->seq) < 0;
+}
+
+/* Links heaps A and B, either of which may be empty, and returns
+   the root of the result.  A and B must be detached roots. */
+static struct wait_elem *
+wait_meld (struct wait_elem *a, struct wait_elem *b) 
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (wait_before (b, a)) 
+    {
+      struct wait_elem *t = a;
+      a = b;
+      b = t;
+    }
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  return a;
+}
+
+/* Combines the sibling list starting at FIRST into one heap with
+   the usual two passes: meld pairs left to right, then meld the
+   pairs right to left. */
+static struct wait_elem *
+wait_merge_pairs (struct wait_elem *first) 
+{
+  struct wait_elem *pairs = NULL;
+  struct wait_elem *result = NULL;
+
+  while (first != NULL) 
+    {
+      struct wait_elem *a = first;
+      struct wait_elem *b = a->next;
+      struct wait_elem *m;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+      m = wait_meld (a, b);
+      m->next = pairs;
+      pairs = m;
+    }
+  while (pairs != NULL) 
+    {
+      struct wait_elem *m = pairs;
+      pairs = m->next;
+      m->next = NULL;
+      result = wait_meld (result, m);
+    }
+  return result;
+}
+
+/* Initializes Q as an empty wait queue. */
+void
+wait_queue_init (struct wait_queue *q) 
+{
+  ASSERT (q != NULL);
+  q->root = NULL;
+}
+
+/* Returns true if no thread waits in Q. */
+bool
+wait_queue_empty (const struct wait_queue *q) 
+{
+  return q->root == NULL;
+}
+
+/* Queues E for thread T in Q, keyed by T's current priority.
+   sched_lock must be held. */
+void
+wait_queue_push (struct wait_queue *q, struct wait_elem *e, struct thread *t) 
+{
+  ASSERT (sched_lock_held ());
+
+  e->thread = t;
+  e->queue = q;
+  e->priority = t->priority;
+  e->seq = wait_seq++;
+  e->child = e->next = e->prev = NULL;
+  q->root = wait_meld (q->root, e);
+}
+
+/* Removes and returns the first element of Q, which must not be
+   empty.  sched_lock must be held. */
+struct wait_elem *
+wait_queue_pop (struct wait_queue *q) 
+{
+  struct wait_elem *e = q->root;
+
+  ASSERT (sched_lock_held ());
+  ASSERT (e != NULL);
+
+  q->root = wait_merge_pairs (e->child);
+  e->queue = NULL;
+  return e;
+}
+
+/* Empties Q in linear time and returns its elements, in no
+   particular order, as a list linked through their `next'
+   members.  sched_lock must be held. */
+struct wait_elem *
+wait_queue_take_all (struct wait_queue *q) 
+{
+  struct wait_elem *todo = q->root;
+  struct wait_elem *taken = NULL;
+
+  ASSERT (sched_lock_held ());
+
+  q->root = NULL;
+  while (todo != NULL) 
+    {
+      struct wait_elem *e = todo;
+      struct wait_elem *c;
+
+      /* Put E's children at the front of the to-do list. */
+      todo = e->next;
+      for (c = e->child; c != NULL; c = c->next)
+        if (c->next == NULL) 
+          {
+            c->next = todo;
+            todo = e->child;
+            break;
+          }
+
+      e->queue = NULL;
+      e->next = taken;
+      taken = e;
+    }
+  return taken;
+}
+
+/* Removes E, which may be anywhere in its queue. */
+static void
+wait_queue_remove (struct wait_elem *e) 
+{
+  struct wait_queue *q = e->queue;
+  struct wait_elem *sub;
+
+  if (q->root == e)
+    {
+      wait_queue_pop (q);
+      return;
+    }
+
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+
+  sub = wait_merge_pairs (e->child);
+  q->root = wait_meld (q->root, sub);
+  e->queue = NULL;
+}
+
+/* Requeues E if its thread's priority is no longer the one E was
+   queued with. */
+static void
+wait_elem_requeue (struct wait_elem *e) 
+{
+  if (e != NULL && e->queue != NULL && e->priority != e->thread->priority)
+    {
+      struct wait_queue *q = e->queue;
+      wait_queue_remove (e);
+      wait_queue_push (q, e, e->thread);
+    }
+}
+
+/* Repositions T in the semaphore and condition variable queues
+   it waits in after its priority changed.  sched_lock must be
+   held. */
+void
+wait_queue_priority_changed (struct thread *t) 
+{
+  ASSERT (sched_lock_held ());
+
+  wait_elem_requeue (&t->wait_elem);
+  wait_elem_requeue (t->cond_elem);
+}
+
+static void lock_donate (struct lock *, int priority);
+static void signaler_update (struct signaler *);
+
+/* Initializes S with no signaler, for threads waiting in
+   WAITERS. */
+static void
+signaler_init (struct signaler *s, struct wait_queue *waiters)
+{
+  s->thread = NULL;
+  s->donation = PRI_MIN;
+  s->waiters = waiters;
+}
+
+/* Passes T's priority, just raised, on to whatever T is waiting
+   for.  sched_lock must be held. */
+static void
+donate_onward (struct thread *t)
+{
+  if (t->Waited_on_lock != NULL)
+    lock_donate (t->Waited_on_lock, t->priority);
+  else if (t->Waited_on_signaler != NULL)
+    signaler_update (t->Waited_on_signaler);
+}
+
+/* Recomputes the priority S donates to its signaler from the
+   threads waiting, and passes any rise on along the chain.
+   sched_lock must be held. */
+static void
+signaler_update (struct signaler *s)
+{
+  int donation = PRI_MIN;
+  int old;
+
+  if (thread_mlfqs || s->thread == NULL)
+    return;
+
+  if (!wait_queue_empty (s->waiters))
+    donation = s->waiters->root->priority;
+  if (donation == s->donation)
+    return;
+
+  old = s->donation;
+  thread_remove_donation (s->thread, old);
+  thread_add_donation (s->thread, donation);
+  s->donation = donation;
+  thread_donate_priority (s->thread);
+  if (donation > old)
+    donate_onward (s->thread);
+}
+
+/* Makes T, which may be null, the expected signaler of S, moving
+   the donation from the old one, if any. */
+static void
+signaler_set (struct signaler *s, struct thread *t)
+{
+  enum intr_level old_level = sched_lock_acquire ();
+
+  if (!thread_mlfqs && s->thread != NULL)
+    {
+      thread_remove_donation (s->thread, s->donation);
+      thread_update_priority (s->thread);
+    }
+  s->thread = t;
+  s->donation = PRI_MIN;
+  if (!thread_mlfqs && t != NULL)
+    {
+      thread_add_donation (t, PRI_MIN);
+      signaler_update (s);
+    }
+  sched_lock_release (old_level);
+
+  /* The old signaler may be us, now at a lower priority. */
+  thread_try_yeild ();
+}
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -47,7 +319,20 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  wait_queue_init (&sema->waiters);
+  signaler_init (&sema->signaler, &sema->waiters);
+}
+
+/* Registers T as the thread expected to up SEMA, so that threads
+   waiting in sema_down() donate their priority to it, or with a
+   null T cancels the registration.  Meant for a semaphore that
+   one thread signals, such as a completion another waits for. */
+void
+sema_set_signaler (struct semaphore *sema, struct thread *t)
+{
+  ASSERT (sema != NULL);
+
+  signaler_set (&sema->signaler, t);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -65,14 +350,21 @@ sema_down (struct semaphore *sema)
   ASSERT (sema != NULL);
   ASSERT (!intr_context ());
 
-  old_level = intr_disable ();
+  old_level = sched_lock_acquire ();
   while (sema->value == 0) 
     {
-        list_insert_ordered(&sema->waiters, &thread_current ()->elem, ComparePriority, NULL);
+      struct thread *cur = thread_current ();
+      wait_queue_push (&sema->waiters, &cur->wait_elem, cur);
+      if (sema->signaler.thread != NULL)
+        {
+          cur->Waited_on_signaler = &sema->signaler;
+          signaler_update (&sema->signaler);
+        }
       thread_block ();
+      cur->Waited_on_signaler = NULL;
     }
   sema->value--;
-  intr_set_level (old_level);
+  sched_lock_release (old_level);
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -88,7 +380,7 @@ sema_try_down (struct semaphore *sema)
 
   ASSERT (sema != NULL);
 
-  old_level = intr_disable ();
+  old_level = sched_lock_acquire ();
   if (sema->value > 0) 
     {
       sema->value--;
@@ -96,7 +388,7 @@ sema_try_down (struct semaphore *sema)
     }
   else
     success = false;
-  intr_set_level (old_level);
+  sched_lock_release (old_level);
 
   return success;
 }
@@ -112,20 +404,17 @@ sema_up (struct semaphore *sema)
 
     ASSERT (sema != NULL);
 
-    old_level = intr_disable ();
-    if (!list_empty (&sema->waiters))
-    {
-        /* added */
-        list_sort(&sema->waiters, ComparePriority, NULL);
-
-        thread_unblock(list_entry(list_pop_front(&sema->waiters), struct thread, elem));
-    }
+    old_level = sched_lock_acquire ();
+    if (!wait_queue_empty (&sema->waiters))
+      {
+        thread_unblock (wait_queue_pop (&sema->waiters)->thread);
+        signaler_update (&sema->signaler);
+      }
     sema->value++;
-    /* added */
+    sched_lock_release (old_level);
 
-    intr_set_level (old_level);
-
-    thread_yield();
+    /* Switch only if the woken thread outranks us. */
+    thread_try_yeild ();
 }
 
 static void sema_test_helper (void *sema_);
@@ -190,6 +479,33 @@ lock_init (struct lock *lock)
   lock->Waiting_threads_max_priority=0;
 }
 
+/* Raises the highest waiting priority recorded for LOCK to
+   PRIORITY and donates it to LOCK's holder, then on along the
+   chain of locks that each holder is itself waiting for.
+   sched_lock must be held. */
+static void
+lock_donate (struct lock *lock, int priority)
+{
+    while (lock != NULL && lock->Waiting_threads_max_priority < priority)
+    {
+        struct thread *holder = lock->holder;
+
+        /* Update the max priority, and the holder's record of it */
+        if (holder != NULL)
+            thread_remove_donation(holder, lock->Waiting_threads_max_priority);
+        lock->Waiting_threads_max_priority = priority;
+        if (holder == NULL)
+            break;
+        thread_add_donation(holder, priority);
+        /* Donate priority to its holder thread */
+        thread_donate_priority(holder);
+        /* holder thread priority is changed so we must check if the lock the holder thread is waiting on is affected */
+        lock = holder->Waited_on_lock;
+        if (lock == NULL && holder->Waited_on_signaler != NULL)
+            signaler_update(holder->Waited_on_signaler);
+    }
+}
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
@@ -204,24 +520,16 @@ void lock_acquire (struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
     struct thread *cur = thread_current();
-    struct lock *tmp_lock;
+    enum intr_level old_level = sched_lock_acquire();
     /* Lock is owned by a thread */
     if (!thread_mlfqs && lock->holder != NULL)
     {
         cur->Waited_on_lock = lock;
-        tmp_lock = lock;
-        while (tmp_lock != NULL && tmp_lock->Waiting_threads_max_priority < cur->priority)
-        {
-            /* Update the max priority */
-            tmp_lock->Waiting_threads_max_priority = cur->priority;
-            /* Donate priority to its holder thread */
-            thread_donate_priority(tmp_lock->holder);
-            /* holder thread priority is changed so we must check if the lock the holder thread is waiting on is affected */
-            tmp_lock = tmp_lock->holder->Waited_on_lock;
-        }
+        lock_donate(lock, cur->priority);
     }
+    sched_lock_release(old_level);
     sema_down (&lock->semaphore);
-    enum intr_level old_level = intr_disable();
+    old_level = sched_lock_acquire();
     cur = thread_current();
     if (!thread_mlfqs)
     {
@@ -230,11 +538,12 @@ void lock_acquire (struct lock *lock)
         lock->Waiting_threads_max_priority = cur->priority;
 
         /*thread holds the lock*/
-        list_insert_ordered(&cur->Owned_locks, &lock->elem, lock_cmp_priority, NULL);
+        list_push_back(&cur->Owned_locks, &lock->elem);
+        thread_add_donation(cur, lock->Waiting_threads_max_priority);
         thread_update_priority(cur);
     }
     lock->holder = cur;
-    intr_set_level(old_level);
+    sched_lock_release(old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -253,7 +562,18 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      struct thread *cur = thread_current ();
+      enum intr_level old_level = sched_lock_acquire ();
+      if (!thread_mlfqs)
+        {
+          lock->Waiting_threads_max_priority = cur->priority;
+          list_push_back (&cur->Owned_locks, &lock->elem);
+          thread_add_donation (cur, lock->Waiting_threads_max_priority);
+        }
+      lock->holder = cur;
+      sched_lock_release (old_level);
+    }
   return success;
 }
 
@@ -270,13 +590,14 @@ lock_release (struct lock *lock)
 
 
 
+    enum intr_level old_level = sched_lock_acquire();
     if(!thread_mlfqs){
-    enum intr_level old_level = intr_disable();
     list_remove(&lock->elem);
-    thread_update_priority(thread_current());
-    intr_set_level(old_level);}
+    thread_remove_donation(thread_current(), lock->Waiting_threads_max_priority);
+    thread_update_priority(thread_current());}
     lock->holder = NULL;
     lock->Waiting_threads_max_priority=0;
+    sched_lock_release(old_level);
     sema_up (&lock->semaphore);
 }
 
@@ -291,10 +612,10 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
+/* One semaphore in a condition's wait queue. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct wait_elem elem;              /* Wait queue element. */
     struct semaphore semaphore;         /* This semaphore. */
   };
 
@@ -306,7 +627,19 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  wait_queue_init (&cond->waiters);
+  signaler_init (&cond->signaler, &cond->waiters);
+}
+
+/* Registers T as the thread expected to signal COND, so that
+   threads waiting in cond_wait() donate their priority to it, or
+   with a null T cancels the registration. */
+void
+cond_set_signaler (struct condition *cond, struct thread *t)
+{
+  ASSERT (cond != NULL);
+
+  signaler_set (&cond->signaler, t);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -333,6 +666,8 @@ void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
   struct semaphore_elem waiter;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -340,9 +675,21 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  old_level = sched_lock_acquire ();
+  wait_queue_push (&cond->waiters, &waiter.elem, cur);
+  cur->cond_elem = &waiter.elem;
+  if (cond->signaler.thread != NULL)
+    {
+      cur->Waited_on_signaler = &cond->signaler;
+      signaler_update (&cond->signaler);
+    }
+  sched_lock_release (old_level);
   lock_release (lock);
   sema_down (&waiter.semaphore);
+  old_level = sched_lock_acquire ();
+  cur->cond_elem = NULL;
+  cur->Waited_on_signaler = NULL;
+  sched_lock_release (old_level);
   lock_acquire (lock);
 }
 
@@ -356,15 +703,21 @@ cond_wait (struct condition *cond, struct lock *lock)
 void
 cond_signal (struct condition *cond, struct lock *lock UNUSED) 
 {
+  struct wait_elem *e = NULL;
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters))
-      list_sort(&cond->waiters, cond_cmp_priority, NULL);
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+  old_level = sched_lock_acquire ();
+  if (!wait_queue_empty (&cond->waiters))
+    e = wait_queue_pop (&cond->waiters);
+  signaler_update (&cond->signaler);
+  sched_lock_release (old_level);
+  if (e != NULL)
+    sema_up (&wait_entry (e, struct semaphore_elem, elem)->semaphore);
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -376,17 +729,345 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
 void
 cond_broadcast (struct condition *cond, struct lock *lock) 
 {
+  struct wait_elem *e;
+  enum intr_level old_level;
+
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (lock_held_by_current_thread (lock));
 
-  while (!list_empty (&cond->waiters))
-    cond_signal (cond, lock);
+  /* Every waiter is woken, so there is no need to find them in
+     priority order: the scheduler runs the highest one first. */
+  old_level = sched_lock_acquire ();
+  e = wait_queue_take_all (&cond->waiters);
+  signaler_update (&cond->signaler);
+  sched_lock_release (old_level);
+  while (e != NULL) 
+    {
+      struct wait_elem *next = e->next;
+      sema_up (&wait_entry (e, struct semaphore_elem, elem)->semaphore);
+      e = next;
+    }
+}
+/* Initializes RW as a readers-writer lock.  Any number of
+   threads may hold RW for reading at once, or a single thread
+   may hold it for writing.  With RW_PREFER_WRITERS a waiting
+   writer keeps new readers out, so readers cannot starve
+   writers; with RW_PREFER_READERS readers enter whenever no
+   writer holds RW.
+
+   Outside the MLFQS, the highest priority among the threads
+   waiting for RW is donated to every thread holding it, the
+   writer or all of the readers alike, and from there along any
+   chain of locks a holder is waiting for.
+
+   Like a lock, RW cannot be acquired recursively, for reading or
+   for writing, and it must not be acquired within an interrupt
+   handler.  A thread may hold at most RW_READ_HOLD_MAX
+   readers-writer locks for reading at a time. */
+void
+rw_init (struct rwlock *rw, enum rw_preference preference)
+{
+  ASSERT (rw != NULL);
+
+  rw->writer = NULL;
+  list_init (&rw->readers);
+  rw->reader_cnt = 0;
+  wait_queue_init (&rw->read_waiters);
+  wait_queue_init (&rw->write_waiters);
+  rw->preference = preference;
+  rw->donation = PRI_MIN;
+}
+
+/* Returns true if a new reader may enter RW now. */
+static bool
+rw_read_may_enter (const struct rwlock *rw)
+{
+  return (rw->writer == NULL
+          && (rw->preference == RW_PREFER_READERS
+              || wait_queue_empty (&rw->write_waiters)));
+}
+
+/* Returns true if a writer may enter RW now. */
+static bool
+rw_write_may_enter (const struct rwlock *rw)
+{
+  return rw->writer == NULL && rw->reader_cnt == 0;
+}
+
+/* Returns the read hold T has on RW, or a null pointer. */
+static struct rw_hold *
+rw_find_hold (struct thread *t, const struct rwlock *rw)
+{
+  int i;
+
+  for (i = 0; i < RW_READ_HOLD_MAX; i++)
+    if (t->rw_holds[i].rw == rw)
+      return &t->rw_holds[i];
+  return NULL;
+}
+
+/* Records T, the running thread, as a holder of RW and gives it
+   RW's donation.  T becomes the writer if WRITER, otherwise one
+   more reader. */
+static void
+rw_add_holder (struct rwlock *rw, struct thread *t, bool writer)
+{
+  if (writer)
+    rw->writer = t;
+  else
+    {
+      struct rw_hold *h = rw_find_hold (t, NULL);
+
+      ASSERT (h != NULL);
+      h->rw = rw;
+      h->thread = t;
+      list_push_back (&rw->readers, &h->elem);
+      rw->reader_cnt++;
+    }
+
+  if (!thread_mlfqs)
+    {
+      thread_add_donation (t, rw->donation);
+      thread_update_priority (t);
+    }
+}
+
+/* Removes T, the running thread, as a holder of RW. */
+static void
+rw_remove_holder (struct rwlock *rw, struct thread *t, bool writer)
+{
+  if (writer)
+    rw->writer = NULL;
+  else
+    {
+      struct rw_hold *h = rw_find_hold (t, rw);
+
+      ASSERT (h != NULL);
+      list_remove (&h->elem);
+      h->rw = NULL;
+      rw->reader_cnt--;
+    }
+
+  if (!thread_mlfqs)
+    thread_remove_donation (t, rw->donation);
+}
+
+/* Calls FUNC on each thread holding RW. */
+static void
+rw_foreach_holder (struct rwlock *rw, void (*func) (struct rwlock *,
+                                                    struct thread *))
+{
+  struct list_elem *e;
+
+  if (rw->writer != NULL)
+    func (rw, rw->writer);
+  for (e = list_begin (&rw->readers); e != list_end (&rw->readers);
+       e = list_next (e))
+    func (rw, list_entry (e, struct rw_hold, elem)->thread);
+}
+
+/* Priority being moved to, by rw_redonate(). */
+static int rw_new_donation;
+
+/* Moves holder T of RW from RW's current donation to
+   rw_new_donation. */
+static void
+rw_redonate (struct rwlock *rw, struct thread *t)
+{
+  thread_remove_donation (t, rw->donation);
+  thread_add_donation (t, rw_new_donation);
+  thread_donate_priority (t);
+  if (rw_new_donation > rw->donation)
+    donate_onward (t);
+}
+
+/* Recomputes the priority RW donates to its holders from the
+   threads waiting for it, and passes any change on to them.
+   sched_lock must be held. */
+static void
+rw_update_donation (struct rwlock *rw)
+{
+  int donation = PRI_MIN;
+
+  if (thread_mlfqs)
+    return;
+
+  if (!wait_queue_empty (&rw->read_waiters)
+      && rw->read_waiters.root->priority > donation)
+    donation = rw->read_waiters.root->priority;
+  if (!wait_queue_empty (&rw->write_waiters)
+      && rw->write_waiters.root->priority > donation)
+    donation = rw->write_waiters.root->priority;
+
+  if (donation != rw->donation)
+    {
+      rw_new_donation = donation;
+      rw_foreach_holder (rw, rw_redonate);
+      rw->donation = donation;
+    }
+}
+
+/* Wakes the threads that should enter RW next, if any may.
+   They recheck on waking, since another thread may get in
+   first.  sched_lock must be held. */
+static void
+rw_wake (struct rwlock *rw)
+{
+  bool readers_first;
+
+  if (rw->writer != NULL)
+    return;
+
+  readers_first = (rw->preference == RW_PREFER_READERS
+                   || wait_queue_empty (&rw->write_waiters));
+  if (readers_first && !wait_queue_empty (&rw->read_waiters))
+    {
+      struct wait_elem *e = wait_queue_take_all (&rw->read_waiters);
+      while (e != NULL)
+        {
+          struct wait_elem *next = e->next;
+          thread_unblock (e->thread);
+          e = next;
+        }
+    }
+  else if (rw->reader_cnt == 0 && !wait_queue_empty (&rw->write_waiters))
+    thread_unblock (wait_queue_pop (&rw->write_waiters)->thread);
+}
+
+/* Acquires RW for reading, sleeping until readers may enter. */
+void
+rw_read_acquire (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rw_held_by_current_thread (rw));
+
+  old_level = sched_lock_acquire ();
+  while (!rw_read_may_enter (rw))
+    {
+      wait_queue_push (&rw->read_waiters, &cur->wait_elem, cur);
+      rw_update_donation (rw);
+      thread_block ();
+    }
+  rw_add_holder (rw, cur, false);
+  sched_lock_release (old_level);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it. */
+void
+rw_write_acquire (struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (!rw_held_by_current_thread (rw));
+
+  old_level = sched_lock_acquire ();
+  while (!rw_write_may_enter (rw))
+    {
+      wait_queue_push (&rw->write_waiters, &cur->wait_elem, cur);
+      rw_update_donation (rw);
+      thread_block ();
+    }
+  rw_add_holder (rw, cur, true);
+  sched_lock_release (old_level);
+}
+
+/* Tries to acquire RW for reading without sleeping.  Returns
+   true if successful, false on failure. */
+bool
+rw_try_read_acquire (struct rwlock *rw)
+{
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+  ASSERT (!rw_held_by_current_thread (rw));
+
+  old_level = sched_lock_acquire ();
+  success = rw_read_may_enter (rw);
+  if (success)
+    rw_add_holder (rw, thread_current (), false);
+  sched_lock_release (old_level);
+  return success;
 }
+
+/* Tries to acquire RW for writing without sleeping.  Returns
+   true if successful, false on failure. */
 bool
-cond_cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+rw_try_write_acquire (struct rwlock *rw)
 {
-    struct semaphore_elem *sa = list_entry(a, struct semaphore_elem, elem);
-    struct semaphore_elem *sb = list_entry(b, struct semaphore_elem, elem);
-    return list_entry(list_front(&sa->semaphore.waiters), struct thread, elem)->priority > \
-		 list_entry(list_front(&sb->semaphore.waiters), struct thread, elem)->priority;
-}
\ No newline at end of file
+  enum intr_level old_level;
+  bool success;
+
+  ASSERT (rw != NULL);
+  ASSERT (!rw_held_by_current_thread (rw));
+
+  old_level = sched_lock_acquire ();
+  success = rw_write_may_enter (rw);
+  if (success)
+    rw_add_holder (rw, thread_current (), true);
+  sched_lock_release (old_level);
+  return success;
+}
+
+/* Releases RW, which the current thread holds for reading if
+   WRITER is false, for writing if it is true. */
+static void
+rw_release (struct rwlock *rw, bool writer)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+
+  old_level = sched_lock_acquire ();
+  rw_remove_holder (rw, cur, writer);
+  rw_wake (rw);
+  rw_update_donation (rw);
+  if (!thread_mlfqs)
+    thread_update_priority (cur);
+  sched_lock_release (old_level);
+
+  thread_try_yeild ();
+}
+
+/* Releases RW, which the current thread must hold for reading. */
+void
+rw_read_release (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rw_find_hold (thread_current (), rw) != NULL);
+
+  rw_release (rw, false);
+}
+
+/* Releases RW, which the current thread must hold for writing. */
+void
+rw_write_release (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (rw->writer == thread_current ());
+
+  rw_release (rw, true);
+}
+
+/* Returns true if the current thread holds RW for reading or
+   writing. */
+bool
+rw_held_by_current_thread (const struct rwlock *rw)
+{
+  struct thread *cur = thread_current ();
+
+  ASSERT (rw != NULL);
+
+  return rw->writer == cur || rw_find_hold (cur, rw) != NULL;
+}
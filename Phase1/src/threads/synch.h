@@ -3,15 +3,75 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Queue of threads waiting on a semaphore or condition variable,
+   highest priority first and first-come first-served among
+   threads of equal priority.
+
+   It is a pairing heap, so pushing is O(1) and popping is
+   O(log n) amortized.  Each element stores the priority it was
+   queued with; wait_queue_priority_changed() moves a thread
+   whose priority was raised by donation while it waits. */
+struct wait_elem 
+  {
+    struct thread *thread;      /* Waiting thread. */
+    struct wait_queue *queue;   /* Queue holding this element, if any. */
+    int priority;               /* Priority it was queued with. */
+    unsigned seq;               /* Arrival order, for ties. */
+    struct wait_elem *child;    /* Leftmost child. */
+    struct wait_elem *next;     /* Right sibling. */
+    struct wait_elem *prev;     /* Left sibling, or parent if leftmost. */
+  };
+
+struct wait_queue 
+  {
+    struct wait_elem *root;     /* Highest priority waiter. */
+  };
+
+/* Converts pointer to wait element WAIT_ELEM into a pointer to
+   the structure that WAIT_ELEM is embedded inside, like
+   list_entry(). */
+#define wait_entry(WAIT_ELEM, STRUCT, MEMBER)           \
+        ((STRUCT *) ((uint8_t *) (WAIT_ELEM)            \
+                     - offsetof (STRUCT, MEMBER)))
+
+void wait_queue_init (struct wait_queue *);
+bool wait_queue_empty (const struct wait_queue *);
+void wait_queue_push (struct wait_queue *, struct wait_elem *,
+                      struct thread *);
+struct wait_elem *wait_queue_pop (struct wait_queue *);
+struct wait_elem *wait_queue_take_all (struct wait_queue *);
+void wait_queue_priority_changed (struct thread *);
+
+/* The thread expected to signal a semaphore or condition
+   variable.  A semaphore has no owner, so nothing says whose
+   progress its waiters depend on; registering a signaler says
+   so, and the highest priority waiting is then donated to the
+   signaler just as a lock's waiters donate to its holder, and
+   passed on along the chain if the signaler itself waits.  The
+   signaler must deregister, by registering a null pointer,
+   before it exits. */
+struct signaler
+  {
+    struct thread *thread;      /* Expected signaler, or null. */
+    int donation;               /* Priority donated to it. */
+    struct wait_queue *waiters; /* Threads whose priority it gets. */
+  };
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct wait_queue waiters;  /* Waiting threads. */
+    struct signaler signaler;   /* Thread expected to up it. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
+void sema_set_signaler (struct semaphore *, struct thread *);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
@@ -35,14 +95,53 @@ bool lock_held_by_current_thread (const struct lock *);
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct wait_queue waiters;  /* Waiting threads. */
+    struct signaler signaler;   /* Thread expected to signal it. */
   };
 
 void cond_init (struct condition *);
+void cond_set_signaler (struct condition *, struct thread *);
 void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
-bool cond_cmp_priority(const struct list_elem *, const struct list_elem *, void * UNUSED);
+
+/* Readers-writer lock. */
+enum rw_preference
+  {
+    RW_PREFER_READERS,          /* Readers may pass waiting writers. */
+    RW_PREFER_WRITERS           /* Waiting writers keep new readers out. */
+  };
+
+/* Readers-writer locks a thread may hold for reading at once. */
+#define RW_READ_HOLD_MAX 8
+
+/* One thread's read hold on a readers-writer lock. */
+struct rw_hold
+  {
+    struct list_elem elem;      /* In the lock's readers list. */
+    struct rwlock *rw;          /* Lock held, or null if unused. */
+    struct thread *thread;      /* Holding thread. */
+  };
+
+struct rwlock
+  {
+    struct thread *writer;          /* Holder for writing, if any. */
+    struct list readers;            /* Read holds, as struct rw_hold. */
+    int reader_cnt;                 /* Number of readers. */
+    struct wait_queue read_waiters; /* Threads waiting to read. */
+    struct wait_queue write_waiters;/* Threads waiting to write. */
+    enum rw_preference preference;  /* Who goes first. */
+    int donation;                   /* Priority donated to holders. */
+  };
+
+void rw_init (struct rwlock *, enum rw_preference);
+void rw_read_acquire (struct rwlock *);
+void rw_write_acquire (struct rwlock *);
+bool rw_try_read_acquire (struct rwlock *);
+bool rw_try_write_acquire (struct rwlock *);
+void rw_read_release (struct rwlock *);
+void rw_write_release (struct rwlock *);
+bool rw_held_by_current_thread (const struct rwlock *);
 
 /* Optimization barrier.
 
@@ -6,13 +6,18 @@
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
 #include "threads/palloc.h"
+#include "threads/spinlock.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "threads/trace.h"
+#include "devices/lapic.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -25,22 +30,102 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queues of processes in THREAD_READY state, that is,
+   processes that are ready to run but not actually running.
+   Each processor has its own, in which it looks first for the
+   next thread to run; a ready thread's `cpu' member says whose
+   queue holds it.  There is one FIFO list per priority level,
+   and bit P of `bitmap' is set exactly when queues[P] is
+   nonempty, so the highest-priority ready thread is found in
+   constant time.  Both the priority scheduler and the mlfqs mode
+   use them.
+
+   Priorities stay strict across processors within a bounded
+   lag.  A thread made ready goes to the processor running the
+   lowest-priority thread, interrupting it, if it outranks that
+   thread.  A processor that goes looking for a thread takes one
+   from another queue if it outranks everything in its own.
+   Only an idle processor, stealing from the lowest-priority end
+   of the busiest queue, may run a thread ahead of a
+   higher-priority one, until the end of its time slice.
+
+   Each run queue has its own lock.  It protects the queue, the
+   `cpu' member and the queue position of each thread in it, and
+   its processor's switches from one thread to another: the
+   processor holds it from schedule() until thread_schedule_tail()
+   in the thread switched to.  A processor takes another's run
+   queue lock only to steal a thread, and then only if the lock
+   is free, so no processor ever waits for another's queue while
+   holding its own.  Otherwise other queues are only peeked at,
+   without their locks, to decide whether stealing is worth a
+   try. */
+struct run_queue
+{
+  struct spinlock lock;
+  struct list queues[PRI_MAX + 1];
+  uint64_t bitmap;
+  int cnt;                      /* # of threads in the queue. */
+  long long switch_cnt;         /* # of context switches. */
+  struct thread *migrating;     /* Yielded away, see thread_yield(). */
+};
+static struct run_queue run_queues[CPU_MAX];
 
 /* List of all processes.  Processes are added to this list
-   when they are first scheduled and removed when they exit. */
+   when they are first scheduled and removed when they exit.
+   Kept in order of priority at creation, highest first. */
 static struct list all_list;
-
-static struct list sleeping_list;
-
-/* Idle thread. */
-static struct thread *idle_thread;
+LIST_DEFINE_ORDERED_DESC(all_by_priority, struct thread, allelem, priority)
+
+/* Sleeping threads, kept in a hierarchical timing wheel.  Level
+   L holds threads whose wake-up time is less than
+   WHEEL_SIZE^(L+1) ticks past wheel_time, hashed into slots by
+   the corresponding WHEEL_BITS of the wake-up time.  Every tick
+   expires one level-0 slot; whenever a level's index wraps, the
+   next slot of the level above is cascaded down.  Insertion and
+   per-tick expiry are therefore amortized O(1).  Threads too
+   far in the future for the top level wait on wheel_overflow.
+   Bit S of wheel_bitmap[L] is set when wheel[L][S] is
+   nonempty. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static uint64_t wheel_bitmap[WHEEL_LEVELS];
+static struct list wheel_overflow;
+static int64_t wheel_time;      /* Last tick expired. */
+
+/* Protects the scheduler's state outside the run queues: the
+   timing wheel, all_list, the thread cache, every thread's
+   priority, and each change of a thread's status to or from
+   THREAD_BLOCKED.  It also serves the synchronization primitives
+   in synch.c.  It takes the place of turning interrupts off,
+   which only keeps out other threads on the same processor.  A
+   processor may lock a run queue while holding sched_lock, but
+   never the other way around.
+
+   A thread that blocks while holding sched_lock lets go of it
+   for the switch and takes it back afterward.  See
+   thread_block(). */
+static struct spinlock sched_lock;
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
+/* Pages of exited threads.  Up to THREAD_CACHE_MAX of them wait
+   in thread_cache for thread_create() to reuse, so that a
+   thread's create/exit cycle need not go through the page
+   allocator; init_thread() reinitializes only the struct thread
+   at the bottom of the page.  Any more go on reap_list, for the
+   reaper thread to give back to the page allocator outside the
+   context switch.  All of these are protected by sched_lock. */
+#define THREAD_CACHE_MAX 16
+static struct list thread_cache;
+static size_t thread_cache_cnt;
+static struct list reap_list;
+static struct thread *reaper;   /* Reaper thread, once started. */
+static bool reaper_idle;        /* Reaper blocked on empty reap_list? */
+
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
@@ -52,27 +137,45 @@ struct kernel_thread_frame
   void *aux;             /* Auxiliary data for function. */
 };
 
-/* Statistics. */
-static long long idle_ticks;   /* # of timer ticks spent idle. */
-static long long kernel_ticks; /* # of timer ticks in kernel threads. */
-static long long user_ticks;   /* # of timer ticks in user programs. */
-
 /* Scheduling. */
 #define TIME_SLICE 4 /* # of timer ticks to give each thread. */
 
-static unsigned thread_ticks; /* # of timer ticks since last yield. */
-
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If false (default), only the bootstrap processor runs
+   threads.  If true, every processor does.
+   Controlled by kernel command-line option "-smp". */
+bool thread_smp;
+
 /* System load avgerage */
 static struct real load_avg;
 
+/* Recent_cpu decay in mlfqs mode.  Once per second every
+   thread's recent_cpu is multiplied by a coefficient derived from
+   load_avg.  Only the running and ready threads are decayed at
+   that moment; a blocked thread records in its mlfqs_epoch how
+   many decays it has seen and catches up on the rest when it is
+   unblocked.  decay_history holds the coefficients of the most
+   recent MLFQS_HISTORY decays, indexed by decay number modulo
+   MLFQS_HISTORY; older ones are approximated by repeating the
+   oldest coefficient still recorded. */
+#define MLFQS_HISTORY 256
+static struct real decay_history[MLFQS_HISTORY];
+static int64_t mlfqs_epoch;     /* # of decays so far. */
+
+static void mlfqs_catch_up(struct thread *);
+
 static void kernel_thread(thread_func *, void *aux);
 
 static void idle(void *aux UNUSED);
+static void idle_loop(void) NO_RETURN;
+static void reaper_thread(void *aux UNUSED) NO_RETURN;
+static struct thread *thread_page_get(void);
+static void thread_page_put(struct thread *);
+static bool is_idle(struct thread *);
 static struct thread *running_thread(void);
 static struct thread *next_thread_to_run(void);
 static void init_thread(struct thread *, const char *name, int priority);
@@ -81,6 +184,28 @@ static void *alloc_frame(struct thread *, size_t size);
 static void schedule(void);
 void thread_schedule_tail(struct thread *prev);
 static tid_t allocate_tid(void);
+static void ready_queue_push(struct thread *, struct cpu *);
+static void ready_queue_remove(struct thread *, int priority);
+static int ready_queue_max_priority(void);
+static void set_priority(struct thread *, int priority);
+static struct run_queue *run_queue_lock(struct thread *);
+static struct thread *run_queue_steal(struct run_queue *, struct cpu *,
+                                      bool lowest, int above);
+static unsigned sched_lock_drop(void);
+static void sched_lock_retake(unsigned depth);
+static int run_queue_max_priority(const struct run_queue *);
+static int running_priority(struct cpu *);
+static struct cpu *choose_cpu(struct thread *);
+static bool may_run_on(const struct thread *, const struct cpu *);
+static struct thread *run_queue_find(struct run_queue *, struct cpu *,
+                                     bool lowest);
+static bool steal_before(const struct thread *, const struct thread *,
+                         const struct cpu *);
+static void ready_queue_push_kick(struct thread *, struct cpu *);
+static intr_handler_func reschedule_interrupt;
+static void wheel_insert(struct thread *);
+static void wheel_cascade(int level, int slot);
+static void wheel_advance(int64_t now);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -97,18 +222,45 @@ static tid_t allocate_tid(void);
    finishes. */
 void thread_init(void)
 {
+  int i;
+
   ASSERT(intr_get_level() == INTR_OFF);
 
+  cpu_init();
+  spinlock_init(&sched_lock, "sched");
   lock_init(&tid_lock);
-  list_init(&ready_list);
+  for (i = 0; i < CPU_MAX; i++)
+  {
+    int j;
+    spinlock_init(&run_queues[i].lock, "run queue");
+    for (j = PRI_MIN; j <= PRI_MAX; j++)
+      list_init(&run_queues[i].queues[j]);
+    run_queues[i].bitmap = 0;
+    run_queues[i].cnt = 0;
+    run_queues[i].switch_cnt = 0;
+    run_queues[i].migrating = NULL;
+  }
   list_init(&all_list);
-  list_init(&sleeping_list);
+  list_init(&thread_cache);
+  thread_cache_cnt = 0;
+  list_init(&reap_list);
+  for (i = 0; i < WHEEL_LEVELS; i++)
+  {
+    int j;
+    for (j = 0; j < WHEEL_SIZE; j++)
+      list_init(&wheel[i][j]);
+    wheel_bitmap[i] = 0;
+  }
+  list_init(&wheel_overflow);
+  wheel_time = 0;
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread();
   init_thread(initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid();
+  cpus[0].current = initial_thread;
+  cpus[0].online = true;
 
   if (thread_mlfqs)
   {
@@ -119,13 +271,16 @@ void thread_init(void)
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
-   Also creates the idle thread. */
+   Also creates the idle and reaper threads. */
 void thread_start(void)
 {
   /* Create the idle thread. */
   struct semaphore idle_started;
   sema_init(&idle_started, 0);
   thread_create("idle", PRI_MIN, idle, &idle_started);
+  thread_create("reaper", PRI_MIN, reaper_thread, NULL);
+  intr_register_lapic(LAPIC_IPI_RESCHEDULE, reschedule_interrupt,
+                    "Reschedule");
 
   /* Start preemptive thread scheduling. */
   intr_enable();
@@ -139,43 +294,50 @@ void thread_start(void)
 void thread_tick(void)
 {
   struct thread *t = thread_current();
+  struct cpu *c = cpu_current();
+  enum intr_level old_level;
 
   /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
+  if (t == c->idle_thread)
+    c->idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    c->user_ticks++;
 #endif
   else
-    kernel_ticks++;
-
-  struct list_elem *iter = list_begin(&sleeping_list);
-  struct list_elem *tmp;
-  int64_t current_time = timer_ticks();
+    c->kernel_ticks++;
 
-  while (iter != list_end(&sleeping_list))
+  /* The bootstrap processor keeps time for everyone. */
+  if (c == &cpus[0])
   {
-    struct thread *thr = list_entry(iter, struct thread, sleeping_elem);
-    tmp = iter;
-    iter = list_next(iter);
-
-    if (current_time < thr->waik_up_time)
-      break;
-    thread_unblock(thr);
-    list_remove(tmp);
+    old_level = sched_lock_acquire();
+    wheel_advance(timer_ticks());
+    sched_lock_release(old_level);
   }
 
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  /* Enforce preemption, both of a woken sleeper that outranks
+     us and at the end of the time slice. */
+  if (++c->thread_ticks >= TIME_SLICE)
     intr_yield_on_return();
+  else
+    thread_try_yeild();
 }
 
 /* Prints thread statistics. */
 void thread_print_stats(void)
 {
+  long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+  {
+    idle_ticks += cpus[i].idle_ticks;
+    kernel_ticks += cpus[i].kernel_ticks;
+    user_ticks += cpus[i].user_ticks;
+  }
   printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
          idle_ticks, kernel_ticks, user_ticks);
+  spinlock_print_stats();
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -205,13 +367,15 @@ tid_t thread_create(const char *name, int priority,
   ASSERT(function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page(PAL_ZERO);
+  t = thread_page_get();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread(t, name, priority);
   tid = t->tid = allocate_tid();
+  t->cpu = cpu_current()->id;
+  t->affinity = thread_current()->affinity;
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame(t, sizeof *kf);
@@ -232,33 +396,65 @@ tid_t thread_create(const char *name, int priority,
   {
     t->recent_cpu = thread_current()->recent_cpu;
     t->nice = thread_current()->nice;
+    t->mlfqs_epoch = mlfqs_epoch;
     thread_update_priority_mlfqs(t);
   }
 
   /* Add to run queue. */
   thread_unblock(t);
-
-  if (thread_current()->priority < priority)
-    thread_yield();
+  thread_try_yeild();
 
   return tid;
 }
 
+/* Creates the idle thread for application processor C, which
+   smp_init() is about to start running on the returned thread's
+   stack.  Returns a null pointer if memory is exhausted. */
+struct thread *
+thread_create_idle(struct cpu *c)
+{
+  struct thread *t;
+  char name[16];
+
+  t = palloc_get_page(PAL_ZERO);
+  if (t == NULL)
+    return NULL;
+
+  snprintf(name, sizeof name, "idle%d", c->id);
+  init_thread(t, name, PRI_MIN);
+  t->status = THREAD_RUNNING;
+  t->tid = allocate_tid();
+  t->cpu = c->id;
+  c->idle_thread = c->current = t;
+  return t;
+}
+
 /* Puts the current thread to sleep.  It will not be scheduled
    again until awoken by thread_unblock().
 
    This function must be called with interrupts turned off.  It
    is usually a better idea to use one of the synchronization
-   primitives in synch.h. */
+   primitives in synch.h.  A caller holding sched_lock holds it
+   again on return, but not while other threads run. */
 void thread_block(void)
 {
+  enum intr_level old_level;
+  unsigned depth;
 
   ASSERT(!intr_context());
   ASSERT(intr_get_level() == INTR_OFF);
 
+  old_level = sched_lock_acquire();
   thread_current()->status = THREAD_BLOCKED;
+  trace_event(TRACE_BLOCK, thread_current()->tid, 0, 0);
 
+  /* Lock our run queue before letting go of sched_lock, so that
+     a thread_unblock() of us waits for the switch to finish. */
+  spinlock_lock(&run_queues[cpu_current()->id].lock);
+  depth = sched_lock_drop();
   schedule();
+  sched_lock_retake(depth);
+  sched_lock_release(old_level);
 }
 
 /* Transitions a blocked thread T to the ready-to-run state.
@@ -272,14 +468,26 @@ void thread_block(void)
 void thread_unblock(struct thread *t)
 {
   enum intr_level old_level;
+  struct run_queue *last;
+  struct cpu *c;
 
   ASSERT(is_thread(t));
 
-  old_level = intr_disable();
+  old_level = sched_lock_acquire();
   ASSERT(t->status == THREAD_BLOCKED);
-  list_insert_ordered(&ready_list, &t->elem, ComparePriority, NULL);
-  t->status = THREAD_READY;
-  intr_set_level(old_level);
+
+  /* T may still be switching away on the processor it last ran
+     on, which keeps its run queue locked until it is done. */
+  last = &run_queues[t->cpu];
+  spinlock_lock(&last->lock);
+  spinlock_unlock(&last->lock);
+
+  if (thread_mlfqs)
+    mlfqs_catch_up(t);
+  c = choose_cpu(t);
+  trace_event(TRACE_UNBLOCK, t->tid, running_thread()->tid, c->id);
+  ready_queue_push_kick(t, c);
+  sched_lock_release(old_level);
 }
 
 /* Returns the name of the running thread. */
@@ -327,9 +535,11 @@ void thread_exit(void)
   /* Remove thread from all threads list, set our status to dying,
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
-  intr_disable();
+  sched_lock_acquire();
   list_remove(&thread_current()->allelem);
   thread_current()->status = THREAD_DYING;
+  spinlock_lock(&run_queues[cpu_current()->id].lock);
+  sched_lock_drop();
   schedule();
   NOT_REACHED();
 }
@@ -340,14 +550,40 @@ void thread_yield(void)
 {
   struct thread *cur = thread_current();
   enum intr_level old_level;
+  struct run_queue *rq;
+  struct cpu *c;
 
   ASSERT(!intr_context());
 
   old_level = intr_disable();
-  if (cur != idle_thread)
-    list_insert_ordered(&ready_list, &cur->elem, ComparePriority, NULL);
-  cur->status = THREAD_READY;
-  schedule();
+  c = cpu_current();
+  rq = &run_queues[c->id];
+  if (is_idle(cur) || may_run_on(cur, c))
+  {
+    spinlock_lock(&rq->lock);
+    if (is_idle(cur))
+      cur->status = THREAD_READY;
+    else
+      ready_queue_push(cur, c);
+    schedule();
+  }
+  else
+  {
+    /* We may no longer run here, and another processor must not
+       pick us up before we are off this one.  Block, and leave
+       it to thread_schedule_tail() to make us ready elsewhere
+       once the switch is done. */
+    unsigned depth;
+
+    spinlock_lock(&sched_lock);
+    cur->status = THREAD_BLOCKED;
+    spinlock_lock(&rq->lock);
+    rq->migrating = cur;
+    depth = sched_lock_drop();
+    schedule();
+    sched_lock_retake(depth);
+    spinlock_unlock(&sched_lock);
+  }
   intr_set_level(old_level);
 }
 
@@ -367,15 +603,56 @@ void thread_foreach(thread_action_func *func, void *aux)
   }
 }
 
+/* Turns interrupts off and acquires the scheduler lock, which
+   the synchronization primitives use as well.  Returns the
+   previous interrupt level, to pass to sched_lock_release(). */
+enum intr_level sched_lock_acquire(void)
+{
+  return spinlock_acquire(&sched_lock);
+}
+
+/* Releases the scheduler lock and sets the interrupt level to
+   OLD_LEVEL. */
+void sched_lock_release(enum intr_level old_level)
+{
+  spinlock_release(&sched_lock, old_level);
+}
+
+/* Returns true if this processor holds the scheduler lock. */
+bool sched_lock_held(void)
+{
+  return spinlock_held(&sched_lock);
+}
+
+/* Releases sched_lock, which this processor holds, however many
+   times it has acquired it, leaving interrupts off.  Returns
+   that number, to pass to sched_lock_retake(). */
+static unsigned
+sched_lock_drop(void)
+{
+  unsigned depth = sched_lock.depth;
+
+  sched_lock.depth = 1;
+  spinlock_unlock(&sched_lock);
+  return depth;
+}
+
+/* Acquires sched_lock again to DEPTH, as sched_lock_drop()
+   returned it.  Interrupts must be off. */
+static void
+sched_lock_retake(unsigned depth)
+{
+  spinlock_lock(&sched_lock);
+  sched_lock.depth = depth;
+}
+
 /* Sets the current thread's priority to NEW_PRIORITY. */
 void thread_set_priority(int new_priority)
 {
   if (thread_mlfqs)
     return;
 
-  enum intr_level old_level = intr_disable();
-
-  bool flag = false;
+  enum intr_level old_level = sched_lock_acquire();
 
   struct thread *cur = thread_current();
   int old_priority = cur->priority;
@@ -384,13 +661,10 @@ void thread_set_priority(int new_priority)
   /*if the new given priority is also larger than the donated priority :
    * set the donated priorty to the new given one*/
   if (list_empty(&cur->Owned_locks) || new_priority > old_priority)
-  {
     cur->priority = new_priority;
-    flag = true;
-  }
-  intr_set_level(old_level);
+  sched_lock_release(old_level);
 
-  if (flag) thread_yield();
+  thread_try_yeild();
 }
 
 /* Returns the current thread's priority. */
@@ -399,13 +673,50 @@ int thread_get_priority(void)
   return thread_current()->priority;
 }
 
+/* Returns the set of processors the current thread may run on,
+   as a bitmask of indexes in cpus[]. */
+unsigned thread_get_affinity(void)
+{
+  return thread_current()->affinity;
+}
+
+/* Restricts the current thread to the processors in MASK, a
+   bitmask of indexes in cpus[], moving it to one of them if it
+   is running elsewhere.  Naming an isolated processor is the
+   only way to run there.  Returns false, changing nothing, if
+   none of the processors in MASK is running threads.  Threads
+   the current thread creates from now on inherit MASK. */
+bool thread_set_affinity(unsigned mask)
+{
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
+  bool usable = false;
+  bool move;
+  int i;
+
+  old_level = sched_lock_acquire();
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].online && (mask & (1u << i)))
+      usable = true;
+  if (usable)
+    cur->affinity = mask & CPU_MASK_ALL;
+  move = usable && !may_run_on(cur, cpu_current());
+  sched_lock_release(old_level);
+
+  if (move)
+    thread_yield();
+  return usable;
+}
+
 /* Sets the current thread's nice value to NICE. */
 void thread_set_nice(int nice UNUSED)
 {
   struct thread *t = thread_current();
+  enum intr_level old_level = sched_lock_acquire();
   t->nice = nice;
 
   thread_update_priority_mlfqs(t);
+  sched_lock_release(old_level);
 
   thread_try_yeild();
 }
@@ -431,7 +742,17 @@ int thread_get_recent_cpu(void)
 
 int get_ready_threads(void)
 {
-  return (list_size(&ready_list)) + ((thread_current() != idle_thread) ? 1 : 0);
+  int ready_threads = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].online)
+    {
+      ready_threads += run_queues[i].cnt;
+      if (!is_idle(cpus[i].current))
+        ready_threads++;
+    }
+  return ready_threads;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -447,8 +768,30 @@ static void
 idle(void *idle_started_ UNUSED)
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current();
+  struct thread *cur = thread_current();
+  cpus[0].idle_thread = cur;
   sema_up(idle_started);
+  idle_loop();
+}
+
+/* Adds the calling application processor, which must be
+   running its idle thread, to those that run threads, then
+   becomes its idle thread.  Called by smp.c's ap_main() when
+   thread_smp is set. */
+void thread_start_ap(void)
+{
+  enum intr_level old_level = sched_lock_acquire();
+  cpu_current()->online = true;
+  sched_lock_release(old_level);
+
+  idle_loop();
+}
+
+/* Body of every processor's idle thread. */
+static void
+idle_loop(void)
+{
+  bool bsp = cpu_current() == &cpus[0];
 
   for (;;)
   {
@@ -456,6 +799,12 @@ idle(void *idle_started_ UNUSED)
     intr_disable();
     thread_block();
 
+    /* In tickless mode, sleep through the ticks until the next
+       sleeper is due.  Only the bootstrap processor takes timer
+       interrupts. */
+    if (bsp)
+      timer_idle_enter();
+
     /* Re-enable interrupts and wait for the next one.
 
        The `sti' instruction disables interrupts until the
@@ -472,6 +821,10 @@ idle(void *idle_started_ UNUSED)
                  :
                  :
                  : "memory");
+
+    intr_disable();
+    if (bsp)
+      timer_idle_exit();
   }
 }
 
@@ -481,7 +834,10 @@ kernel_thread(thread_func *function, void *aux)
 {
   ASSERT(function != NULL);
 
-  intr_enable(); /* The scheduler runs with interrupts off. */
+  /* thread_schedule_tail() unlocked the run queue on the way
+     here from switch_entry(), but the scheduler runs with
+     interrupts off. */
+  intr_enable();
   function(aux); /* Execute the thread function. */
   thread_exit(); /* If function() returns, kill the thread. */
 }
@@ -508,6 +864,18 @@ is_thread(struct thread *t)
   return t != NULL && t->magic == THREAD_MAGIC;
 }
 
+/* Returns true if T is some processor's idle thread. */
+static bool
+is_idle(struct thread *t)
+{
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].idle_thread == t)
+      return true;
+  return false;
+}
+
 /* Does basic initialization of T as a blocked thread named
    NAME. */
 static void
@@ -524,16 +892,18 @@ init_thread(struct thread *t, const char *name, int priority)
   strlcpy(t->name, name, sizeof t->name);
   t->stack = (uint8_t *)t + PGSIZE;
   t->priority = priority;
+  t->affinity = CPU_MASK_ALL & ~cpu_isolated;
   t->waik_up_time = 0;
   t->magic = THREAD_MAGIC;
 
   t->real_priority = priority;
   list_init(&t->Owned_locks);
   t->Waited_on_lock = NULL;
+  t->Waited_on_signaler = NULL;
 
-  old_level = intr_disable();
-  list_insert_ordered(&all_list, &t->allelem, (list_less_func *)&ComparePriority, NULL);
-  intr_set_level(old_level);
+  old_level = sched_lock_acquire();
+  all_by_priority_insert_ordered(&all_list, &t->allelem);
+  sched_lock_release(old_level);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -549,18 +919,308 @@ alloc_frame(struct thread *t, size_t size)
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Chooses and returns the next thread to be scheduled, taking
+   it out of its run queue.  Should return a thread from this
+   processor's run queue, which must be locked, unless another
+   queue has a higher-priority thread or ours is empty.  If no
+   thread is ready, returns the idle thread. */
 static struct thread *
 next_thread_to_run(void)
 {
-  if (list_empty(&ready_list))
-    return idle_thread;
+  struct cpu *c = cpu_current();
+  struct run_queue *rq = &run_queues[c->id];
+  int priority = run_queue_max_priority(rq);
+  struct run_queue *victim = NULL;
+  struct thread *t;
+  int i;
+
+  ASSERT(spinlock_held(&rq->lock));
+
+  if (priority < PRI_MIN)
+  {
+    /* Our queue is empty.  Steal from the lowest-priority end of
+       the busiest queue, whose processor will get to those
+       threads last, skipping threads not allowed here, and
+       preferring, as steal_before() says, a thread of the address
+       space we have loaded and then the one whose cache there is
+       coldest. */
+    for (i = 0; i < cpu_cnt; i++)
+      if (i != c->id && cpus[i].online && run_queues[i].cnt > 0
+          && (victim == NULL || run_queues[i].cnt > victim->cnt))
+        victim = &run_queues[i];
+    t = victim != NULL ? run_queue_steal(victim, c, true, PRI_MIN - 1) : NULL;
+    return t != NULL ? t : c->idle_thread;
+  }
+
+  /* Run a higher-priority thread from another queue first. */
+  for (i = 0; i < cpu_cnt; i++)
+    if (i != c->id && cpus[i].online
+        && run_queue_max_priority(&run_queues[i]) > priority)
+    {
+      priority = run_queue_max_priority(&run_queues[i]);
+      victim = &run_queues[i];
+    }
+  t = list_entry(list_front(&rq->queues[run_queue_max_priority(rq)]),
+                 struct thread, elem);
+  if (victim != NULL)
+  {
+    struct thread *stolen = run_queue_steal(victim, c, false, t->priority);
+    if (stolen != NULL)
+      return stolen;
+  }
+  ready_queue_remove(t, t->priority);
+  return t;
+}
+
+/* Takes from RQ, another processor's run queue, the thread that
+   run_queue_find() picks for C, if its priority is above ABOVE,
+   and returns it, to run on C.  Returns a null pointer, without
+   waiting, if RQ is locked or has no such thread.  C's run queue
+   must be locked. */
+static struct thread *
+run_queue_steal(struct run_queue *rq, struct cpu *c, bool lowest, int above)
+{
+  struct thread *t;
+
+  if (!spinlock_try_lock(&rq->lock))
+    return NULL;
+  t = run_queue_find(rq, c, lowest);
+  if (t != NULL && t->priority > above)
+  {
+    ready_queue_remove(t, t->priority);
+    t->cpu = c->id;
+  }
+  else
+    t = NULL;
+  spinlock_unlock(&rq->lock);
+  return t;
+}
+
+/* Returns the ready thread in RQ that may run on C with the
+   lowest priority, if LOWEST is true, or the highest, otherwise.
+   Of equals, takes the first in the second case, and in the
+   first the one steal_before() puts first, then the last.
+   Returns a null pointer if RQ has none that may run on C. */
+static struct thread *
+run_queue_find(struct run_queue *rq, struct cpu *c, bool lowest)
+{
+  int priority;
+
+  for (priority = lowest ? PRI_MIN : PRI_MAX;
+       priority >= PRI_MIN && priority <= PRI_MAX;
+       priority += lowest ? 1 : -1)
+    if (rq->bitmap & ((uint64_t)1 << priority))
+    {
+      struct list *q = &rq->queues[priority];
+      struct list_elem *e;
+
+      if (lowest)
+      {
+        struct thread *best = NULL;
+
+        for (e = list_rbegin(q); e != list_rend(q); e = list_prev(e))
+        {
+          struct thread *t = list_entry(e, struct thread, elem);
+          if (may_run_on(t, c) && (best == NULL || steal_before(t, best, c)))
+            best = t;
+        }
+        if (best != NULL)
+          return best;
+      }
+      else
+      {
+        for (e = list_begin(q); e != list_end(q); e = list_next(e))
+          if (may_run_on(list_entry(e, struct thread, elem), c))
+            return list_entry(e, struct thread, elem);
+      }
+    }
+  return NULL;
+}
+
+/* Returns true if C, stealing, should take A before B: if A
+   shares the address space C has loaded and B does not, which
+   keeps a process's threads together and saves reloading CR3,
+   or else if A has been off its processor longer, which makes
+   its cache there the coldest and so the cheapest to give up. */
+static bool
+steal_before(const struct thread *a, const struct thread *b,
+             const struct cpu *c UNUSED)
+{
+#ifdef USERPROG
+  bool a_local = a->pagedir != NULL && a->pagedir == c->pagedir;
+  bool b_local = b->pagedir != NULL && b->pagedir == c->pagedir;
+
+  if (a_local != b_local)
+    return a_local;
+#endif
+  return a->last_run < b->last_run;
+}
+
+/* Returns true if T's affinity allows it to run on C. */
+static bool
+may_run_on(const struct thread *t, const struct cpu *c)
+{
+  return (t->affinity & (1u << c->id)) != 0;
+}
+
+/* Returns the priority of the thread C is running, counting its
+   idle thread as below every other. */
+static int
+running_priority(struct cpu *c)
+{
+  return c->current == c->idle_thread ? PRI_MIN - 1 : c->current->priority;
+}
+
+/* Chooses the processor in whose run queue to put T, which is
+   becoming ready: the one T last ran on if T outranks what it
+   is running, otherwise the one running the lowest-priority
+   thread if T outranks that, otherwise again the one T last ran
+   on.  What the other processors are running may change as soon
+   as it has been looked at, so the choice is only a good
+   guess. */
+static struct cpu *
+choose_cpu(struct thread *t)
+{
+  struct cpu *last = &cpus[t->cpu];
+  struct cpu *lowest = NULL;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].online && may_run_on(t, &cpus[i])
+        && (lowest == NULL
+            || running_priority(&cpus[i]) < running_priority(lowest)))
+      lowest = &cpus[i];
+
+  /* thread_set_affinity() makes sure T may run on some online
+     processor, but an idle thread has no affinity to speak of. */
+  if (lowest == NULL)
+    return cpu_current();
+
+  if (!last->online || !may_run_on(t, last))
+    last = lowest;
+  if (running_priority(last) < t->priority)
+    return last;
+  return running_priority(lowest) < t->priority ? lowest : last;
+}
+
+/* Adds T, which must not be in any run queue, to the back of C's
+   run queue for T's current priority and marks it ready. */
+static void
+ready_queue_push(struct thread *t, struct cpu *c)
+{
+  struct run_queue *rq = &run_queues[c->id];
+
+  ASSERT(PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  spinlock_lock(&rq->lock);
+  t->cpu = c->id;
+  list_push_back(&rq->queues[t->priority], &t->elem);
+  rq->bitmap |= (uint64_t)1 << t->priority;
+  rq->cnt++;
+  t->status = THREAD_READY;
+  spinlock_unlock(&rq->lock);
+}
+
+/* Like ready_queue_push(), but also interrupts C if it is
+   another processor and T outranks what it is running.
+   Preempting the running thread, if C is ours, is up to our
+   caller. */
+static void
+ready_queue_push_kick(struct thread *t, struct cpu *c)
+{
+  ready_queue_push(t, c);
+  if (c != cpu_current() && running_priority(c) < t->priority)
+    lapic_send_ipi(c->apic_id, LAPIC_IPI_RESCHEDULE);
+}
+
+/* Removes T from the run queue for PRIORITY, which must be the
+   priority T was queued at.  T's run queue must be locked. */
+static void
+ready_queue_remove(struct thread *t, int priority)
+{
+  struct run_queue *rq = &run_queues[t->cpu];
+
+  ASSERT(spinlock_held(&rq->lock));
+
+  list_remove(&t->elem);
+  if (list_empty(&rq->queues[priority]))
+    rq->bitmap &= ~((uint64_t)1 << priority);
+  rq->cnt--;
+}
+
+/* Returns the highest priority that has a ready thread in RQ,
+   or PRI_MIN - 1 if RQ is empty. */
+static int
+run_queue_max_priority(const struct run_queue *rq)
+{
+  uint32_t high = rq->bitmap >> 32;
+  uint32_t low = rq->bitmap;
+
+  if (high != 0)
+    return 63 - __builtin_clz(high);
+  else if (low != 0)
+    return 31 - __builtin_clz(low);
   else
-    return list_entry(list_pop_front(&ready_list), struct thread, elem);
+    return PRI_MIN - 1;
+}
+
+/* Returns the highest priority that has a ready thread in any
+   run queue, or PRI_MIN - 1 if they are all empty.  The queues
+   are not locked, so the answer may be out of date as soon as it
+   is returned. */
+static int
+ready_queue_max_priority(void)
+{
+  int priority = PRI_MIN - 1;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].online)
+      priority = max(priority, run_queue_max_priority(&run_queues[i]));
+  return priority;
+}
+
+/* Locks and returns the run queue that T is in, if T is ready,
+   or that it last ran from.  T may move to another queue until
+   its current one is locked, so this tries again if it did. */
+static struct run_queue *
+run_queue_lock(struct thread *t)
+{
+  for (;;)
+  {
+    struct run_queue *rq = &run_queues[t->cpu];
+
+    spinlock_lock(&rq->lock);
+    if (rq == &run_queues[t->cpu])
+      return rq;
+    spinlock_unlock(&rq->lock);
+  }
+}
+
+/* Sets T's priority to PRIORITY, moving T to the back of its run
+   queue for PRIORITY if T is ready.  sched_lock must be held,
+   unless T is still being created. */
+static void
+set_priority(struct thread *t, int priority)
+{
+  struct run_queue *rq = run_queue_lock(t);
+  int old_priority = t->priority;
+
+  t->priority = priority;
+  if (t->status == THREAD_READY && priority != old_priority)
+  {
+    ready_queue_remove(t, old_priority);
+    ready_queue_push(t, &cpus[t->cpu]);
+  }
+  spinlock_unlock(&rq->lock);
+}
+
+/* Reschedule interrupt, sent by thread_unblock() on another
+   processor when it makes a thread ready that outranks ours. */
+static void
+reschedule_interrupt(struct intr_frame *f UNUSED)
+{
+  intr_yield_on_return();
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -582,52 +1242,156 @@ next_thread_to_run(void)
 void thread_schedule_tail(struct thread *prev)
 {
   struct thread *cur = running_thread();
+  struct cpu *c = cpu_current();
+  struct run_queue *rq = &run_queues[c->id];
+  struct thread *migrating;
 
-  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(spinlock_held(&rq->lock));
 
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
+  c->current = cur;
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  c->thread_ticks = 0;
 
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate();
 #endif
 
-  /* If the thread we switched from is dying, destroy its struct
+  /* The switch is done. */
+  migrating = rq->migrating;
+  rq->migrating = NULL;
+  spinlock_unlock(&rq->lock);
+
+  /* Make a thread that yielded because it may no longer run here
+     ready on a processor where it may. */
+  if (migrating != NULL)
+  {
+    ASSERT(migrating == prev);
+    thread_unblock(migrating);
+  }
+
+  /* If the thread we switched from is dying, recycle its struct
      thread.  This must happen late so that thread_exit() doesn't
-     pull out the rug under itself.  (We don't free
+     pull out the rug under itself.  (We don't recycle
      initial_thread because its memory was not obtained via
      palloc().) */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
   {
     ASSERT(prev != cur);
-    palloc_free_page(prev);
+    spinlock_lock(&sched_lock);
+    thread_page_put(prev);
+    spinlock_unlock(&sched_lock);
+  }
+}
+
+/* Returns a page for a new thread, a recycled one if
+   thread_cache has any, or a null pointer if none is
+   available. */
+static struct thread *
+thread_page_get(void)
+{
+  enum intr_level old_level = sched_lock_acquire();
+  struct thread *t = NULL;
+
+  if (!list_empty(&thread_cache))
+  {
+    t = list_entry(list_pop_front(&thread_cache), struct thread, elem);
+    thread_cache_cnt--;
+  }
+  sched_lock_release(old_level);
+
+  return t != NULL ? t : palloc_get_page(0);
+}
+
+/* Takes the page of dead thread T, keeping it in thread_cache
+   if there is room and otherwise passing it to the reaper.
+   Called from thread_schedule_tail() with sched_lock held, so
+   it must not free the page itself. */
+static void
+thread_page_put(struct thread *t)
+{
+  ASSERT(sched_lock_held());
+
+  if (thread_cache_cnt < THREAD_CACHE_MAX)
+  {
+    list_push_front(&thread_cache, &t->elem);
+    thread_cache_cnt++;
+    return;
+  }
+
+  list_push_back(&reap_list, &t->elem);
+  if (reaper != NULL && reaper_idle)
+  {
+    reaper_idle = false;
+    thread_unblock(reaper);
+  }
+}
+
+/* Reaper thread.  Gives the pages of dead threads that did not
+   fit in thread_cache back to the page allocator.  Runs at
+   PRI_MIN, so it only gets to them when there is nothing better
+   to do. */
+static void
+reaper_thread(void *aux UNUSED)
+{
+  enum intr_level old_level = sched_lock_acquire();
+  reaper = thread_current();
+  sched_lock_release(old_level);
+
+  for (;;)
+  {
+    struct thread *t;
+
+    old_level = sched_lock_acquire();
+    while (list_empty(&reap_list))
+    {
+      reaper_idle = true;
+      thread_block();
+    }
+    t = list_entry(list_pop_front(&reap_list), struct thread, elem);
+    sched_lock_release(old_level);
+
+    palloc_free_page(t);
   }
 }
 
-/* Schedules a new process.  At entry, interrupts must be off and
+/* Schedules a new process.  At entry, this processor's run
+   queue must be locked, once, sched_lock must not be held, and
    the running process's state must have been changed from
    running to some other state.  This function finds another
    thread to run and switches to it.
 
+   The run queue stays locked across the switch, until
+   thread_schedule_tail() in the thread switched to, so this
+   function returns with it unlocked and interrupts still off.
+
    It's not safe to call printf() until thread_schedule_tail()
    has completed. */
 static void
 schedule(void)
 {
   struct thread *cur = running_thread();
-  struct thread *next = next_thread_to_run();
+  struct run_queue *rq = &run_queues[cpu_current()->id];
+  struct thread *next;
   struct thread *prev = NULL;
 
-  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(spinlock_held(&rq->lock) && rq->lock.depth == 1);
+  ASSERT(!sched_lock_held());
   ASSERT(cur->status != THREAD_RUNNING);
+
+  next = next_thread_to_run();
   ASSERT(is_thread(next));
 
   if (cur != next)
+  {
+    cur->last_run = timer_ticks();
+    rq->switch_cnt++;
+    trace_event(TRACE_SWITCH, cur->tid, next->tid, cur->status);
     prev = switch_threads(cur, next);
+  }
   thread_schedule_tail(prev);
 }
 
@@ -663,96 +1427,269 @@ void thread_update_priority_mlfqs(struct thread *t)
   else if (priority > PRI_MAX)
     priority = PRI_MAX;
 
-  t->priority = priority;
+  set_priority(t, priority);
 }
 
-/* Update recent cpu for every theard and updates system load average with eqns:
-  recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice ,
-  load_avg = (59/60) *load_avg + (1/60)*ready_threads */
+/* Updates the system load average and decays recent_cpu with eqns:
+  load_avg = (59/60) *load_avg + (1/60)*ready_threads ,
+  recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice
+  The decay is applied right away only to the running thread and
+  the ready threads; blocked threads pick it up in
+  mlfqs_catch_up() when they are unblocked. */
 void thread_update_recent_cpu_and_load_avg(void)
 {
-
-  enum intr_level old_level = intr_disable();
-
+  enum intr_level old_level = sched_lock_acquire();
   int ready_threads = get_ready_threads();
-
-  struct real _59_60 = divide(int_to_real(59), int_to_real(60)); // 59/60
-  struct real _1_60 = divide(int_to_real(1), int_to_real(60));   // 1/60
+  int priority;
+  int i;
 
   load_avg = add(
-      multiply(_59_60, load_avg),
-      multiply(_1_60, int_to_real(ready_threads)));
+      multiply(FP_59_60, load_avg),
+      multiply(FP_1_60, int_to_real(ready_threads)));
+
+  decay_history[mlfqs_epoch % MLFQS_HISTORY] = divide(
+      multiply_by_int(load_avg, 2),
+      add_real_to_int(multiply_by_int(load_avg, 2), 1));
+  mlfqs_epoch++;
 
-  thread_foreach(thread_update_recent_cpu, NULL);
+  for (i = 0; i < cpu_cnt; i++)
+  {
+    if (!cpus[i].online)
+      continue;
+    spinlock_lock(&run_queues[i].lock);
+    if (!is_idle(cpus[i].current))
+      mlfqs_catch_up(cpus[i].current);
+
+    /* Ready threads may move to a higher bucket, which has
+       already been visited, or be seen twice, which
+       mlfqs_catch_up() ignores. */
+    for (priority = PRI_MAX; priority >= PRI_MIN; priority--)
+    {
+      struct list *q = &run_queues[i].queues[priority];
+      struct list_elem *e = list_begin(q);
+
+      while (e != list_end(q))
+      {
+        struct thread *t = list_entry(e, struct thread, elem);
+        e = list_next(e);
+        mlfqs_catch_up(t);
+      }
+    }
+    spinlock_unlock(&run_queues[i].lock);
+  }
 
-  intr_set_level(old_level);
+  sched_lock_release(old_level);
 }
 
-/* Updates recent cpu for a thread with eqn:
-  recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice */
-void thread_update_recent_cpu(struct thread *t, void *aux UNUSED)
+/* Applies to T every recent_cpu decay it has missed since its
+   mlfqs_epoch and recomputes its priority. */
+static void
+mlfqs_catch_up(struct thread *t)
 {
+  int64_t missed = mlfqs_epoch - t->mlfqs_epoch;
+  int64_t e;
 
-  struct real old_recent_cpu = t->recent_cpu;
+  if (missed <= 0)
+    return;
 
-  struct real recent_coff = divide(
-      multiply_by_int(load_avg, 2),
-      add_real_to_int(multiply_by_int(load_avg, 2), 1));
+  if (missed > MLFQS_HISTORY)
+  {
+    /* For decays older than the history, repeat the oldest
+       recorded coefficient C, in closed form:
+         recent_cpu = C^m * recent_cpu + nice * (1 - C^m) / (1 - C) */
+    struct real c = decay_history[mlfqs_epoch % MLFQS_HISTORY];
+    struct real cm = int_to_real(1);
+    struct real base = c;
+    int64_t m = missed - MLFQS_HISTORY;
+
+    for (; m > 0; m >>= 1)
+    {
+      if (m & 1)
+        cm = multiply(cm, base);
+      base = multiply(base, base);
+    }
+    t->recent_cpu = add(
+        multiply(cm, t->recent_cpu),
+        multiply_by_int(divide(subtract(int_to_real(1), cm),
+                               subtract(int_to_real(1), c)),
+                        t->nice));
+    missed = MLFQS_HISTORY;
+  }
 
-  t->recent_cpu = add_real_to_int(
-      multiply(old_recent_cpu, recent_coff),
-      t->nice);
+  for (e = mlfqs_epoch - missed; e < mlfqs_epoch; e++)
+    t->recent_cpu = add_real_to_int(
+        multiply(t->recent_cpu, decay_history[e % MLFQS_HISTORY]),
+        t->nice);
 
+  t->mlfqs_epoch = mlfqs_epoch;
   thread_update_priority_mlfqs(t);
 }
 
-/* try to yeild the current thread if priority is less than a thread in the ready list*/
+/* Preempts the running thread if a ready thread has strictly
+   higher priority, the check every wakeup ends with.  Within an
+   interrupt handler the yield is deferred until the handler
+   returns. */
 void thread_try_yeild(void)
 {
+  if (ready_queue_max_priority() <= thread_current()->priority)
+    return;
+  if (intr_context())
+    intr_yield_on_return();
+  else
+    thread_yield();
+}
 
-  enum intr_level old_level = intr_disable();
+/* Returns the number of context switches since boot. */
+int64_t thread_switch_count(void)
+{
+  int64_t cnt = 0;
+  int i;
 
-  bool flag = false;
+  for (i = 0; i < cpu_cnt; i++)
+  {
+    enum intr_level old_level = spinlock_acquire(&run_queues[i].lock);
+    cnt += run_queues[i].switch_cnt;
+    spinlock_release(&run_queues[i].lock, old_level);
+  }
+  return cnt;
+}
+
+/* Puts the thread coming from timer_sleep() to sleep. It sets the
+Wake up time of it, puts it in the timing wheel, then send it to be
+blocked.  Interrupts must be off. */
+void thread_sleep(int64_t ticks, int64_t current_time)
+{
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
 
-  if (!list_empty(&ready_list))
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  old_level = sched_lock_acquire();
+  cur->waik_up_time = current_time + ticks;
+  wheel_insert(cur);
+  thread_block();
+  sched_lock_release(old_level);
+}
+
+/* Returns the earliest tick at which a sleeping thread may be
+   due, or INT64_MAX if no thread is sleeping.  The value is
+   exact for threads due within WHEEL_SIZE ticks; for later ones
+   it is the tick at which their slot is cascaded, which is never
+   later than their wake-up time. */
+int64_t thread_next_wakeup(void)
+{
+  enum intr_level old_level = sched_lock_acquire();
+  int64_t next = INT64_MAX;
+  int level;
+
+  for (level = 0; level < WHEEL_LEVELS; level++)
   {
-    struct thread *max_priority_thread = list_entry(
-        list_front(&ready_list), struct thread, elem);
+    int shift = level * WHEEL_BITS;
+    int cur = (wheel_time >> shift) & WHEEL_MASK;
+    int d;
 
-    if (max_priority_thread->priority > thread_current()->priority)
-    {
-      flag = true;
-    }
+    if (wheel_bitmap[level] == 0)
+      continue;
+
+    /* Find the nearest nonempty slot after the current one. */
+    for (d = 1; d <= WHEEL_SIZE; d++)
+      if (wheel_bitmap[level] & ((uint64_t)1 << ((cur + d) & WHEEL_MASK)))
+        break;
+
+    next = min(next, ((wheel_time >> shift) + d) << shift);
+  }
+  if (!list_empty(&wheel_overflow))
+  {
+    int shift = WHEEL_LEVELS * WHEEL_BITS;
+    next = min(next, ((wheel_time >> shift) + 1) << shift);
   }
 
-  intr_set_level(old_level);
+  sched_lock_release(old_level);
+  return next;
+}
+
+/* Files sleeping thread T into the timing wheel by how far its
+   wake-up time lies past wheel_time. */
+static void
+wheel_insert(struct thread *t)
+{
+  int64_t delta = t->waik_up_time - wheel_time;
+  int level;
 
-  if (flag) thread_yield();
-  
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    if (delta < (int64_t)1 << ((level + 1) * WHEEL_BITS))
+    {
+      int slot = (t->waik_up_time >> (level * WHEEL_BITS)) & WHEEL_MASK;
+
+      /* A thread cascaded down exactly at its wake-up time goes
+         in the slot that wheel_advance() is about to expire. */
+      if (delta <= 0)
+        slot = wheel_time & WHEEL_MASK;
+      list_push_back(&wheel[level][slot], &t->sleeping_elem);
+      wheel_bitmap[level] |= (uint64_t)1 << slot;
+      return;
+    }
+  list_push_back(&wheel_overflow, &t->sleeping_elem);
 }
 
-/* Puts the thread coming from timer_sleep() to sleep. It sets the
-Wake up time of it, puts it in the list, then send it to be
-blocked. */
-bool thread_less_waik(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+/* Moves every thread in SLOT of LEVEL to a lower level. */
+static void
+wheel_cascade(int level, int slot)
 {
-  const struct thread *da = list_entry(a, struct thread, sleeping_elem);
-  const struct thread *db = list_entry(b, struct thread, sleeping_elem);
-  return da->waik_up_time < db->waik_up_time;
+  struct list *l = &wheel[level][slot];
+
+  wheel_bitmap[level] &= ~((uint64_t)1 << slot);
+  while (!list_empty(l))
+    wheel_insert(list_entry(list_pop_front(l), struct thread, sleeping_elem));
 }
 
-/* Puts the thread coming from timer_sleep() to sleep. It sets the
-Wake up time of it, puts it in the list, then send it to be
-blocked. */
-void thread_sleep(int64_t ticks, int64_t current_time)
+/* Expires every tick up to and including NOW, waking the
+   threads whose wake-up time has come. */
+static void
+wheel_advance(int64_t now)
 {
+  while (wheel_time < now)
+  {
+    struct list *l;
+    int slot, level;
 
-  int64_t wake_up_time = current_time + ticks;
+    wheel_time++;
+    slot = wheel_time & WHEEL_MASK;
 
-  thread_current()->waik_up_time = wake_up_time;
-  list_insert_ordered(&sleeping_list, &thread_current()->sleeping_elem, thread_less_waik, NULL);
+    /* Cascade each level whose lower neighbour just wrapped. */
+    for (level = 1; level < WHEEL_LEVELS; level++)
+    {
+      int shift = level * WHEEL_BITS;
+      if ((wheel_time & (((int64_t)1 << shift) - 1)) != 0)
+        break;
+      wheel_cascade(level, (wheel_time >> shift) & WHEEL_MASK);
+    }
+    if (level == WHEEL_LEVELS && !list_empty(&wheel_overflow))
+    {
+      struct list overflow;
+      list_init(&overflow);
+      while (!list_empty(&wheel_overflow))
+        list_push_back(&overflow, list_pop_front(&wheel_overflow));
+      while (!list_empty(&overflow))
+        wheel_insert(list_entry(list_pop_front(&overflow),
+                                struct thread, sleeping_elem));
+    }
 
-  thread_block();
+    l = &wheel[0][slot];
+    wheel_bitmap[0] &= ~((uint64_t)1 << slot);
+    while (!list_empty(l))
+    {
+      struct thread *t = list_entry(list_pop_front(l), struct thread,
+                                    sleeping_elem);
+      if (t->waik_up_time <= wheel_time)
+      {
+        trace_event(TRACE_WAKEUP, t->tid, 0, 0);
+        thread_unblock(t);
+      }
+      else
+        wheel_insert(t);
+    }
+  }
 }
 
 bool list_less_by_priority_comp(
@@ -768,75 +1705,80 @@ bool list_less_by_priority_comp(
 
 
 
-void thread_update_priority_mlfqs_all(void)
-{
-  thread_foreach(thread_update_priority_mlfqs_each, NULL);
-  list_sort(&ready_list, ComparePriority, NULL);
-}
-
-void thread_update_priority_mlfqs_each(struct thread *t, void *aux UNUSED)
+/* Recomputes the running thread's priority in mlfqs mode.
+   Between the once-per-second decays only the running thread's
+   recent_cpu changes, so no other thread's priority can. */
+void thread_update_priority_mlfqs_current(void)
 {
-  enum intr_level old_level = intr_disable();
-  thread_update_priority_mlfqs(t);
-  intr_set_level(old_level);
+  enum intr_level old_level = sched_lock_acquire();
+  thread_update_priority_mlfqs(thread_current());
+  sched_lock_release(old_level);
 }
 
 void inc_recent_cpu(struct thread *t)
 {
-  if (t != idle_thread)
+  if (!is_idle(t))
   {
     t->recent_cpu = add_real_to_int(t->recent_cpu, 1);
   }
 }
 
-/* Update the thread's priority. */
-bool ComparePriority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+/* Donate the priority of current thread to thread t. */
+void thread_donate_priority(struct thread *t)
 {
-  return list_entry(a, struct thread, elem)->priority > list_entry(b, struct thread, elem)->priority;
-}
+  enum intr_level old_level = sched_lock_acquire();
+  thread_update_priority(t);
+  trace_event(TRACE_DONATE, t->tid, running_thread()->tid, t->priority);
+
+  /* thread_update_priority() moved T in its run queue, if it is
+     ready.  Move it in the wait queues, if it is blocked. */
+  if (t->status == THREAD_BLOCKED)
+    wait_queue_priority_changed(t);
 
-/* Function for lock max priority comparison. */
-bool lock_cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED)
+  sched_lock_release(old_level);
+}
+/* Records that T now holds a lock whose highest waiting
+   priority is PRIORITY.  sched_lock must be held. */
+void thread_add_donation(struct thread *t, int priority)
 {
-  return list_entry(a, struct lock, elem)->Waiting_threads_max_priority > list_entry(b, struct lock, elem)->Waiting_threads_max_priority;
+  ASSERT(sched_lock_held());
+  ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
+
+  t->donation_cnt[priority]++;
+  t->donation_bitmap |= (uint64_t)1 << priority;
 }
 
-/* Donate the priority of current thread to thread t. */
-void thread_donate_priority(struct thread *t)
+/* Withdraws one lock of highest waiting priority PRIORITY from
+   the donations recorded for T.  sched_lock must be held. */
+void thread_remove_donation(struct thread *t, int priority)
 {
-  enum intr_level old_level = intr_disable();
-  thread_update_priority(t);
-
-  /* Remove the old t and insert the new one in order */
-  if (t->status == THREAD_READY)
-  {
-    list_remove(&t->elem);
-    list_insert_ordered(&ready_list, &t->elem, ComparePriority, NULL);
-  }
+  ASSERT(sched_lock_held());
+  ASSERT(PRI_MIN <= priority && priority <= PRI_MAX);
+  ASSERT(t->donation_cnt[priority] > 0);
 
-  intr_set_level(old_level);
+  if (--t->donation_cnt[priority] == 0)
+    t->donation_bitmap &= ~((uint64_t)1 << priority);
 }
-/* Update the thread's priority. */
+
+/* Update the thread's priority to the larger of its own priority
+   and the highest priority donated through the locks it holds. */
 void thread_update_priority(struct thread *t)
 {
-  enum intr_level old_level = intr_disable();
+  enum intr_level old_level = sched_lock_acquire();
+  uint32_t high = t->donation_bitmap >> 32;
+  uint32_t low = t->donation_bitmap;
   int max_pri = t->real_priority;
-  int lock_pri;
-
-  /*we want to check if after updating the lock max priority the maximum priority
-   * of the all the locks the thread is holding will be affected or not
- /* If the thread is holding locks, pick the one with the highest max_priority.
-  * And if this priority is greater than the original real priority,
-  * the donated priority would be updated.*/
-  if (!list_empty(&t->Owned_locks))
-  {
-    list_sort(&t->Owned_locks, lock_cmp_priority, NULL);
-    lock_pri = list_entry(list_front(&t->Owned_locks), struct lock, elem)->Waiting_threads_max_priority;
-    if (max_pri < lock_pri)
-      max_pri = lock_pri;
-  }
+  int lock_pri = PRI_MIN - 1;
+
+  if (high != 0)
+    lock_pri = 63 - __builtin_clz(high);
+  else if (low != 0)
+    lock_pri = 31 - __builtin_clz(low);
+  if (max_pri < lock_pri)
+    max_pri = lock_pri;
+
   /* thread priorty is assigned with the max value*/
-  t->priority = max_pri;
+  set_priority(t, max_pri);
 
-  intr_set_level(old_level);
+  sched_lock_release(old_level);
 }
@@ -4,6 +4,8 @@
 #include <debug.h>
 #include <list.h>
 #include "fixed_point.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
 
 
 /* States in a thread's life cycle. */
@@ -75,12 +77,10 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `elem' member is an element in the run queue (thread.c).
+   A blocked thread waits on a semaphore through `wait_elem'
+   instead, and a thread in cond_wait() is also queued on the
+   condition variable through `cond_elem' (synch.c). */
 struct thread
   {
     /* Owned by thread.c. */
@@ -91,6 +91,8 @@ struct thread
     int priority;                       /* Priority. */
     int nice;
     struct real recent_cpu;
+    int64_t mlfqs_epoch;                /* Decays applied to recent_cpu. */
+    int64_t last_run;                   /* Tick it last stopped running. */
     struct list_elem allelem;           /* List element for all threads list. */
 
     int64_t waik_up_time;
@@ -99,9 +101,25 @@ struct thread
     int real_priority;
     struct list Owned_locks;
     struct lock *Waited_on_lock;
+    struct signaler *Waited_on_signaler;
+
+    /* Multiset of the Waiting_threads_max_priority values of the
+       locks in Owned_locks: donation_cnt[P] locks have maximum
+       priority P, and bit P of donation_bitmap is set exactly
+       when donation_cnt[P] is nonzero.  Lets the donated priority
+       be found and updated in constant time. */
+    uint16_t donation_cnt[PRI_MAX + 1];
+    uint64_t donation_bitmap;
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    int cpu;                            /* Run queue, or last processor. */
+    unsigned affinity;                  /* Processors it may run on. */
+
+    /* Owned by synch.c. */
+    struct wait_elem wait_elem;         /* In a semaphore's wait queue. */
+    struct wait_elem *cond_elem;        /* In a condition's wait queue. */
+    struct rw_hold rw_holds[RW_READ_HOLD_MAX]; /* Read holds on rwlocks. */
 
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
@@ -117,8 +135,16 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If false (default), only the bootstrap processor runs threads.
+   If true, every processor does.
+   Controlled by kernel command-line option "-smp". */
+extern bool thread_smp;
+
 void thread_init (void);
 void thread_start (void);
+struct cpu;
+struct thread *thread_create_idle (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
 
 void thread_tick (void);
 void thread_print_stats (void);
@@ -140,9 +166,16 @@ void thread_yield (void);
 typedef void thread_action_func (struct thread *t, void *aux);
 void thread_foreach (thread_action_func *, void *);
 
+enum intr_level sched_lock_acquire (void);
+void sched_lock_release (enum intr_level);
+bool sched_lock_held (void);
+
 int thread_get_priority (void);
 void thread_set_priority (int);
 
+unsigned thread_get_affinity (void);
+bool thread_set_affinity (unsigned mask);
+
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
@@ -151,20 +184,18 @@ int thread_get_load_avg (void);
 
 int get_ready_threads(void);
 void inc_recent_cpu(struct thread *t);
-void thread_update_priority_mlfqs_all(void);
-void thread_update_priority_mlfqs_each (struct thread* t, void* aux UNUSED);
+void thread_update_priority_mlfqs_current(void);
 bool list_less_by_priority_comp (const struct list_elem* a,const struct list_elem* b,void* aux UNUSED);
 void thread_sleep(int64_t ticks, int64_t current_time);
-bool thread_less_waik(const struct list_elem *a, const struct list_elem *b, void *aux);
+int64_t thread_next_wakeup(void);
 void thread_try_yeild(void);
-void thread_update_recent_cpu (struct thread* t, void* aux UNUSED);
+int64_t thread_switch_count(void);
 void thread_update_recent_cpu_and_load_avg(void);
 void thread_update_priority_mlfqs(struct thread * t);
 
-bool ComparePriority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 void thread_donate_priority(struct thread *t);
-bool lock_cmp_priority(const struct list_elem *a, const struct list_elem *b, void *aux UNUSED);
 void thread_update_priority(struct thread *t);
-void thread_sleep(int64_t ticks, int64_t current_time);
+void thread_add_donation(struct thread *t, int priority);
+void thread_remove_donation(struct thread *t, int priority);
 
 #endif /* threads/thread.h */
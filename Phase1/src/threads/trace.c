@@ -0,0 +1,158 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <stdio.h>
+#include "devices/serial.h"
+#include "devices/timer.h"
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Each processor's ring buffer holds its TRACE_EVENTS most
+   recent events.  Only the processor itself writes its ring,
+   with interrupts off, so recording takes no lock: the event is
+   filled in first and HEAD advanced after, and a reader that
+   sees HEAD can trust the events before it. */
+#define TRACE_PAGES 8
+#define TRACE_EVENTS (TRACE_PAGES * PGSIZE / sizeof (struct trace_event))
+
+struct trace_ring
+  {
+    struct trace_event *events; /* TRACE_EVENTS events. */
+    volatile uint32_t head;     /* # of events ever recorded. */
+  };
+
+static struct trace_ring rings[CPU_MAX];
+
+/* If false (default), record nothing.
+   Controlled by kernel command-line option "-trace". */
+bool thread_trace;
+
+/* Recording events?  Set once the rings are allocated. */
+bool trace_active;
+
+/* Dump format.  After a "trace: begin" line, the dump is a
+   header, then for each processor a struct trace_cpu followed
+   by its events, oldest first, then a "trace: end" line.  All
+   values are little-endian.  So that the serial line's
+   new-line translation cannot corrupt it, each byte in the
+   binary part that is TRACE_ESC, '\n', or '\r' is sent as
+   TRACE_ESC followed by the byte XOR 0x20. */
+#define TRACE_MAGIC 0x43525450  /* "PTRC". */
+#define TRACE_VERSION 1
+#define TRACE_ESC 0x1b
+
+struct trace_header
+  {
+    uint32_t magic;             /* TRACE_MAGIC. */
+    uint16_t version;           /* TRACE_VERSION. */
+    uint16_t cpu_cnt;           /* # of struct trace_cpu to follow. */
+  };
+
+struct trace_cpu
+  {
+    uint16_t cpu;               /* Index in cpus[]. */
+    uint16_t event_size;        /* sizeof (struct trace_event). */
+    uint32_t event_cnt;         /* # of events to follow. */
+    uint32_t dropped;           /* # of older events overwritten. */
+  };
+
+static void dump_bytes (const void *, size_t);
+
+/* Allocates a ring for every processor and starts recording, if
+   "-trace" was given.  Call after smp_init(), once cpu_cnt is
+   final. */
+void
+trace_init (void)
+{
+  int i;
+
+  if (!thread_trace)
+    return;
+
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      rings[i].events = palloc_get_multiple (0, TRACE_PAGES);
+      if (rings[i].events == NULL)
+        PANIC ("trace: out of memory for ring buffers");
+      rings[i].head = 0;
+    }
+  barrier ();
+  trace_active = true;
+}
+
+/* Records an event in the running processor's ring.  Use
+   trace_event(), which checks trace_active first. */
+void
+trace_record (enum trace_type type, int tid, int other, int arg)
+{
+  enum intr_level old_level = intr_disable ();
+  struct trace_ring *r = &rings[cpu_current ()->id];
+  struct trace_event *e = &r->events[r->head % TRACE_EVENTS];
+
+  e->time = timer_ns ();
+  e->type = type;
+  e->tid = tid;
+  e->other = other;
+  e->arg = arg;
+  barrier ();
+  r->head++;
+
+  intr_set_level (old_level);
+}
+
+/* Stops recording and writes every processor's ring to the
+   serial port in the format described above. */
+void
+trace_dump (void)
+{
+  struct trace_header h;
+  int i;
+
+  if (!trace_active)
+    return;
+  trace_active = false;
+  barrier ();
+
+  printf ("trace: begin\n");
+  serial_flush ();
+
+  h.magic = TRACE_MAGIC;
+  h.version = TRACE_VERSION;
+  h.cpu_cnt = cpu_cnt;
+  dump_bytes (&h, sizeof h);
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      struct trace_ring *r = &rings[i];
+      uint32_t head = r->head;
+      struct trace_cpu c;
+      uint32_t j;
+
+      c.cpu = i;
+      c.event_size = sizeof (struct trace_event);
+      c.event_cnt = head < TRACE_EVENTS ? head : TRACE_EVENTS;
+      c.dropped = head - c.event_cnt;
+      dump_bytes (&c, sizeof c);
+      for (j = c.dropped; j != head; j++)
+        dump_bytes (&r->events[j % TRACE_EVENTS], sizeof *r->events);
+    }
+
+  printf ("\ntrace: end\n");
+}
+
+/* Writes the SIZE bytes at BUF to the serial port, escaped. */
+static void
+dump_bytes (const void *buf_, size_t size)
+{
+  const uint8_t *buf = buf_;
+
+  for (; size > 0; size--, buf++)
+    if (*buf == TRACE_ESC || *buf == '\n' || *buf == '\r')
+      {
+        serial_putc (TRACE_ESC);
+        serial_putc (*buf ^ 0x20);
+      }
+    else
+      serial_putc (*buf);
+}
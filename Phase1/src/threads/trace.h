@@ -0,0 +1,50 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scheduler event trace.
+
+   When enabled with the "-trace" kernel command-line option,
+   the scheduler records what it does into a ring buffer per
+   processor, and shutdown_power_off() dumps the buffers over
+   the serial port for utils/pintos-trace to decode. */
+
+/* Kinds of events. */
+enum trace_type
+  {
+    TRACE_SWITCH,       /* TID switched to OTHER; ARG is TID's status. */
+    TRACE_BLOCK,        /* TID blocked. */
+    TRACE_UNBLOCK,      /* OTHER unblocked TID onto CPU ARG. */
+    TRACE_DONATE,       /* OTHER raised TID to priority ARG. */
+    TRACE_WAKEUP        /* TID's sleep timed out. */
+  };
+
+/* One event, as recorded and as dumped.  Thread identifiers are
+   kept modulo 65536. */
+struct trace_event
+  {
+    int64_t time;       /* timer_ns() when recorded. */
+    uint16_t type;      /* One of enum trace_type. */
+    uint16_t tid;       /* Thread the event happened to. */
+    uint16_t other;     /* Thread that caused it, or 0. */
+    int16_t arg;        /* Depends on TYPE. */
+  };
+
+extern bool thread_trace;
+extern bool trace_active;
+
+void trace_init (void);
+void trace_record (enum trace_type, int tid, int other, int arg);
+void trace_dump (void);
+
+/* Records an event of the given TYPE, if tracing. */
+static inline void
+trace_event (enum trace_type type, int tid, int other, int arg)
+{
+  if (trace_active)
+    trace_record (type, tid, other, arg);
+}
+
+#endif /* threads/trace.h */
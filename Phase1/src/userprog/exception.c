@@ -3,10 +3,11 @@
 #include <stdio.h>
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
+#include "threads/percpu.h"
 #include "threads/thread.h"
 
 /* Number of page faults processed. */
-static long long page_fault_cnt;
+static struct percpu_counter page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
@@ -64,7 +65,7 @@ exception_init (void)
 void
 exception_print_stats (void) 
 {
-  printf ("Exception: %lld page faults\n", page_fault_cnt);
+  printf ("Exception: %lld page faults\n", percpu_sum (&page_fault_cnt));
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -141,7 +142,7 @@ page_fault (struct intr_frame *f)
   intr_enable ();
 
   /* Count page faults. */
-  page_fault_cnt++;
+  percpu_inc (&page_fault_cnt);
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
@@ -2,12 +2,41 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
+#include "devices/lapic.h"
+#include "threads/cpu.h"
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Invalidating more pages than this at once reloads CR3
+   instead, since by then flushing the whole TLB is cheaper. */
+#define INVLPG_MAX 32
+
+/* The TLB shootdown in progress, if any: processors that have
+   SHOOTDOWN_PD loaded must drop their entries for the pages from
+   SHOOTDOWN_START up to SHOOTDOWN_END.  SHOOTDOWN_PENDING counts
+   the processors that have yet to do so.  Senders take turns
+   under SHOOTDOWN_LOCK. */
+static struct lock shootdown_lock;
+static uint32_t *shootdown_pd;
+static uintptr_t shootdown_start, shootdown_end;
+static volatile int shootdown_pending;
 
 static uint32_t *active_pd (void);
-static void invalidate_pagedir (uint32_t *);
+static void invalidate_pagedir (uint32_t *, const void *);
+static void tlb_shootdown (uint32_t *, uintptr_t start, uintptr_t end);
+static intr_handler_func shootdown_interrupt;
+
+/* Sets up cross-processor TLB invalidation. */
+void
+pagedir_init (void) 
+{
+  lock_init (&shootdown_lock);
+  intr_register_lapic (LAPIC_IPI_TLB, shootdown_interrupt, "TLB Shootdown");
+}
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -152,7 +181,7 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      invalidate_pagedir (pd, upage);
     }
 }
 
@@ -180,7 +209,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_pagedir (pd, vpage);
         }
     }
 }
@@ -209,7 +238,7 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_pagedir (pd, vpage);
         }
     }
 }
@@ -219,15 +248,23 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
 void
 pagedir_activate (uint32_t *pd) 
 {
+  enum intr_level old_level;
+
   if (pd == NULL)
     pd = init_page_dir;
 
+  /* Record PD as loaded first, so that tlb_shootdown() either
+     sees it or changed the page table before we loaded it. */
+  old_level = intr_disable ();
+  cpu_current ()->pagedir = pd;
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base
      Address of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+  intr_set_level (old_level);
 }
 
 /* Returns the currently active page directory. */
@@ -248,16 +285,113 @@ active_pd (void)
    table.  When this happens, we have to "invalidate" the TLB by
    re-activating it.
 
-   This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   This function invalidates the TLB entry for UPAGE on every
+   processor that has PD loaded.  (If PD is not active on a
+   processor then its entries are not in that processor's TLB,
+   so there is no need to invalidate anything.) */
+static void
+invalidate_pagedir (uint32_t *pd, const void *upage) 
+{
+  uintptr_t start = (uintptr_t) pg_round_down (upage);
+
+  tlb_shootdown (pd, start, start + PGSIZE);
+}
+
+/* Invalidates the calling processor's TLB entries for the pages
+   from START up to END. */
 static void
-invalidate_pagedir (uint32_t *pd) 
+flush_range (uintptr_t start, uintptr_t end) 
 {
-  if (active_pd () == pd) 
+  uintptr_t va;
+
+  if ((end - start) / PGSIZE > INVLPG_MAX)
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
-    } 
+      /* Re-activating the page directory clears the TLB.  See
+         [IA32-v3a] 3.12 "Translation Lookaside Buffers (TLBs)". */
+      uintptr_t cr3;
+      asm volatile ("movl %%cr3, %0; movl %0, %%cr3"
+                    : "=r" (cr3) : : "memory");
+    }
+  else
+    for (va = start; va < end; va += PGSIZE)
+      asm volatile ("invlpg (%0)" : : "r" (va) : "memory");
+}
+
+/* Returns true if another processor than the caller has PD
+   loaded.  Interrupts must be off. */
+static bool
+loaded_elsewhere (uint32_t *pd) 
+{
+  struct cpu *self = cpu_current ();
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (&cpus[i] != self && cpus[i].pagedir == pd)
+      return true;
+  return false;
+}
+
+/* Invalidates the TLB entries for the pages from START up to END
+   in page directory PD, on every processor that has PD loaded,
+   and waits until they all have.  Processors that have PD loaded
+   are exactly those running one of its threads, so a process
+   that has only ever run on one processor costs no
+   interprocessor interrupts. */
+static void
+tlb_shootdown (uint32_t *pd, uintptr_t start, uintptr_t end) 
+{
+  enum intr_level old_level;
+  uint8_t targets[CPU_MAX];
+  int target_cnt;
+  struct cpu *self;
+  bool remote;
+  int i;
+
+  /* Make the page table change visible before checking who has
+     PD loaded; pagedir_activate() does the converse. */
+  asm volatile ("mfence" : : : "memory");
+
+  old_level = intr_disable ();
+  if (active_pd () == pd)
+    flush_range (start, end);
+  remote = loaded_elsewhere (pd);
+  intr_set_level (old_level);
+  if (!remote)
+    return;
+
+  /* Waiting for the other processors with interrupts off could
+     deadlock against one of them trying to shoot us down. */
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_ON);
+
+  lock_acquire (&shootdown_lock);
+  shootdown_pd = pd;
+  shootdown_start = start;
+  shootdown_end = end;
+
+  /* Count the targets before interrupting any, since they
+     decrement SHOOTDOWN_PENDING as soon as they are done. */
+  old_level = intr_disable ();
+  self = cpu_current ();
+  target_cnt = 0;
+  for (i = 0; i < cpu_cnt; i++)
+    if (&cpus[i] != self && cpus[i].pagedir == pd)
+      targets[target_cnt++] = cpus[i].apic_id;
+  shootdown_pending = target_cnt;
+  for (i = 0; i < target_cnt; i++)
+    lapic_send_ipi (targets[i], LAPIC_IPI_TLB);
+  intr_set_level (old_level);
+
+  while (shootdown_pending > 0)
+    barrier ();
+  lock_release (&shootdown_lock);
+}
+
+/* Interprocessor interrupt sent by tlb_shootdown(). */
+static void
+shootdown_interrupt (struct intr_frame *f UNUSED) 
+{
+  if (active_pd () == shootdown_pd)
+    flush_range (shootdown_start, shootdown_end);
+  asm volatile ("lock decl %0" : "+m" (shootdown_pending) : : "memory");
 }
@@ -1,9 +1,15 @@
 #include "devices/block.h"
 #include <list.h>
+#include <stats.h>
 #include <string.h>
 #include <stdio.h>
+#include "devices/elevator.h"
 #include "devices/ide.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/percpu.h"
+#include "threads/softirq.h"
+#include "threads/synch.h"
 
 /* A block device. */
 struct block
@@ -17,8 +23,10 @@ struct block
     const struct block_operations *ops;  /* Driver operations. */
     void *aux;                          /* Extra data owned by driver. */
 
-    unsigned long long read_cnt;        /* Number of sectors read. */
-    unsigned long long write_cnt;       /* Number of sectors written. */
+    struct percpu_counter read_cnt;     /* Number of sectors read. */
+    struct percpu_counter write_cnt;    /* Number of sectors written. */
+    struct percpu_counter cache_hit_cnt; /* Buffer cache hits. */
+    struct percpu_counter cache_miss_cnt; /* Buffer cache misses. */
   };
 
 /* List of all block devices. */
@@ -27,7 +35,21 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 /* The block block assigned to each Pintos role. */
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
+/* Requests drivers have finished, each with everything merged
+   into it, linked through their elevator elems, for
+   complete_requests() to call back.  Access with interrupts
+   off. */
+static struct list finished = LIST_INITIALIZER (finished);
+
 static struct block *list_elem_to_block (struct list_elem *);
+static softirq_func complete_requests;
+
+/* Initializes the block layer. */
+void
+block_init (void) 
+{
+  softirq_register (SOFTIRQ_BLOCK, complete_requests);
+}
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -122,7 +144,7 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 {
   check_sector (block, sector);
   block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  percpu_inc (&block->read_cnt);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -136,7 +158,148 @@ block_write (struct block *block, block_sector_t sector, const void *buffer)
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
   block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  percpu_inc (&block->write_cnt);
+}
+
+/* Reads the CNT sectors starting at SECTOR from BLOCK into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Uses the driver's multi-sector operation if it has
+   one, so that the whole run costs a single command.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multi (struct block *block, block_sector_t sector, size_t cnt,
+                  void *buffer)
+{
+  ASSERT (cnt > 0);
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  if (block->ops->read_multi != NULL)
+    block->ops->read_multi (block->aux, sector, cnt, buffer);
+  else
+    {
+      size_t i;
+
+      for (i = 0; i < cnt; i++)
+        block->ops->read (block->aux, sector + i,
+                          (uint8_t *) buffer + i * BLOCK_SECTOR_SIZE);
+    }
+  percpu_add (&block->read_cnt, cnt);
+}
+
+/* Writes the CNT sectors starting at SECTOR on BLOCK from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block device has acknowledged receiving the
+   data.  Uses the driver's multi-sector operation if it has one.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multi (struct block *block, block_sector_t sector, size_t cnt,
+                   const void *buffer)
+{
+  ASSERT (cnt > 0);
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  if (block->ops->write_multi != NULL)
+    block->ops->write_multi (block->aux, sector, cnt, buffer);
+  else
+    {
+      size_t i;
+
+      for (i = 0; i < cnt; i++)
+        block->ops->write (block->aux, sector + i,
+                           (const uint8_t *) buffer + i * BLOCK_SECTOR_SIZE);
+    }
+  percpu_add (&block->write_cnt, cnt);
+}
+
+/* Starts request R on BLOCK and returns without waiting for it
+   to finish, so that a caller can keep several devices busy at
+   once.  R->done is called, possibly from an interrupt handler,
+   when the transfer is complete; until then R and its buffer
+   belong to the block layer, which may change R->sector.  R may
+   cover at most BLOCK_SUBMIT_MAX sectors.  If the driver has no
+   submit operation, R is carried out before returning. */
+void
+block_submit (struct block *block, struct io_request *r)
+{
+  ASSERT (r->cnt > 0 && r->cnt <= BLOCK_SUBMIT_MAX);
+  if (block->ops->submit == NULL)
+    {
+      if (r->write)
+        block_write_multi (block, r->sector, r->cnt, r->buffer);
+      else
+        block_read_multi (block, r->sector, r->cnt, r->buffer);
+      r->done (r);
+      return;
+    }
+
+  check_sector (block, r->sector);
+  check_sector (block, r->sector + r->cnt - 1);
+  ASSERT (!r->write || block->type != BLOCK_FOREIGN);
+  percpu_add (r->write ? &block->write_cnt : &block->read_cnt, r->cnt);
+  block->ops->submit (block->aux, r);
+}
+
+/* A completion function for block_submit() that ups the
+   semaphore R->aux points to.  A caller that submits several
+   requests sharing one semaphore downs it once per request to
+   wait for all of them. */
+void
+block_wake_sema (struct io_request *r)
+{
+  sema_up (r->aux);
+}
+
+/* Called by a driver, often from its interrupt handler, when it
+   has finished request R and the requests merged behind it.
+   Their callbacks run later, from complete_requests(), so that
+   the driver can start its next request at once.  R must no
+   longer be on an elevator queue. */
+void
+block_complete (struct io_request *r) 
+{
+  enum intr_level old_level = intr_disable ();
+  list_push_back (&finished, &r->elem);
+  softirq_raise (SOFTIRQ_BLOCK);
+  intr_set_level (old_level);
+}
+
+/* Calls back every finished request.  Each request and those
+   merged into it are done with interrupts off, as they would be
+   from an interrupt handler, which are turned back on between
+   them. */
+static void
+complete_requests (void)
+{
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      struct io_request *r;
+
+      if (list_empty (&finished))
+        {
+          intr_set_level (old_level);
+          break;
+        }
+      r = list_entry (list_pop_front (&finished), struct io_request, elem);
+      while (r != NULL)
+        {
+          struct io_request *next = r->next;
+          r->done (r);
+          r = next;
+        }
+      intr_set_level (old_level);
+    }
+}
+
+/* Records one access to a buffer cache in front of BLOCK, which
+   was satisfied from the cache if HIT is true. */
+void
+block_count_cache_access (struct block *block, bool hit)
+{
+  percpu_inc (hit ? &block->cache_hit_cnt : &block->cache_miss_cnt);
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -171,11 +334,22 @@ block_print_stats (void)
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
+          unsigned long long hits = percpu_sum (&block->cache_hit_cnt);
+          unsigned long long misses = percpu_sum (&block->cache_miss_cnt);
+
           printf ("%s (%s): %llu reads, %llu writes\n",
                   block->name, block_type_name (block->type),
-                  block->read_cnt, block->write_cnt);
+                  (unsigned long long) percpu_sum (&block->read_cnt),
+                  (unsigned long long) percpu_sum (&block->write_cnt));
+
+          if (hits + misses > 0)
+            printf ("%s (%s): %llu cache hits, %llu misses, "
+                    "%llu%% hit rate\n",
+                    block->name, block_type_name (block->type),
+                    hits, misses, hits * 100 / (hits + misses));
         }
     }
+  ide_print_stats ();
 }
 
 /* Registers a new block device with the given NAME.  If
@@ -198,8 +372,16 @@ block_register (const char *name, enum block_type type,
   block->size = size;
   block->ops = ops;
   block->aux = aux;
-  block->read_cnt = 0;
-  block->write_cnt = 0;
+  percpu_reset (&block->read_cnt);
+  percpu_reset (&block->write_cnt);
+  percpu_reset (&block->cache_hit_cnt);
+  percpu_reset (&block->cache_miss_cnt);
+  stats_add_percpu ("block", block->name, "reads", &block->read_cnt);
+  stats_add_percpu ("block", block->name, "writes", &block->write_cnt);
+  stats_add_percpu ("block", block->name, "cache_hits",
+                    &block->cache_hit_cnt);
+  stats_add_percpu ("block", block->name, "cache_misses",
+                    &block->cache_miss_cnt);
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -1,6 +1,7 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
 
@@ -21,6 +22,7 @@ typedef uint32_t block_sector_t;
 /* Higher-level interface for file systems, etc. */
 
 struct block;
+struct io_request;
 
 /* Type of a block device. */
 enum block_type
@@ -41,6 +43,8 @@ enum block_type
 
 const char *block_type_name (enum block_type);
 
+void block_init (void);
+
 /* Finding block devices. */
 struct block *block_get_role (enum block_type);
 void block_set_role (enum block_type, struct block *);
@@ -53,18 +57,40 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multi (struct block *, block_sector_t, size_t cnt, void *);
+void block_write_multi (struct block *, block_sector_t, size_t cnt,
+                        const void *);
+void block_submit (struct block *, struct io_request *);
+void block_complete (struct io_request *);
+void block_wake_sema (struct io_request *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
 /* Statistics. */
 void block_print_stats (void);
+void block_count_cache_access (struct block *, bool hit);
 
+/* Most sectors one block_submit() request may cover. */
+#define BLOCK_SUBMIT_MAX 256
+
 /* Lower-level interface to block device drivers. */
 
 struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Transfer CNT consecutive sectors at once.  Either may be
+       null, in which case the block layer falls back to one
+       read or write call per sector. */
+    void (*read_multi) (void *aux, block_sector_t, size_t cnt,
+                        void *buffer);
+    void (*write_multi) (void *aux, block_sector_t, size_t cnt,
+                         const void *buffer);
+
+    /* Queues a request and returns without waiting for it, or
+       null if the driver can only transfer synchronously. */
+    void (*submit) (void *aux, struct io_request *);
   };
 
 struct block *block_register (const char *name, enum block_type,
@@ -0,0 +1,98 @@
+#include "devices/clock.h"
+#include <debug.h>
+#include "devices/rtc.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/tsc.h"
+#ifdef USERPROG
+#include "userprog/share.h"
+#endif
+
+/* The wall clock and the monotonic clock, combining the RTC time
+   read once at boot, the timer tick count, and the time-stamp
+   counter for the time since the latest tick.  See lib/clock.h
+   for how the clock page is read. */
+
+/* The clock page.  With user programs, it is a shared frame, so
+   that every process can map it and pagedir_destroy() handles it
+   like any other shared page. */
+static struct clock_page *page;
+
+/* TSC at the previous tick. */
+static uint64_t last_tsc;
+
+/* Sets up the clock page, taking the time of boot from the
+   RTC. */
+void
+clock_init (void) 
+{
+  enum intr_level old_level;
+  struct clock_page *p;
+
+#ifdef USERPROG
+  p = share_alloc ();
+#else
+  p = palloc_get_page (PAL_ZERO);
+#endif
+  if (p == NULL)
+    PANIC ("clock_init: out of memory");
+  p->boot_sec = rtc_get_time ();
+
+  old_level = intr_disable ();
+  page = p;
+  intr_set_level (old_level);
+}
+
+/* Brings the clock page up to date for timer tick TICKS.  Called
+   by the timer interrupt handler. */
+void
+clock_tick (int64_t ticks) 
+{
+  uint64_t tsc = rdtsc ();
+  uint64_t cycles = tsc - last_tsc;
+  struct clock_page *p = page;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (p == NULL)
+    return;
+
+  p->seq++;
+  barrier ();
+
+  /* Learn the TSC rate from the cycles between ticks, leaving out
+     gaps long enough that a tick was probably missed. */
+  if (last_tsc != 0 && cycles <= UINT32_MAX
+      && (p->tsc_max == 0 || cycles < 2 * (uint64_t) p->tsc_max))
+    {
+      p->tsc_max = (p->tsc_max == 0 ? cycles
+                    : ((uint64_t) p->tsc_max * 7 + cycles) / 8);
+      p->tsc_mult = (((uint64_t) TIMER_NS_PER_TICK << CLOCK_SHIFT)
+                     / p->tsc_max);
+    }
+  p->tsc_base = tsc;
+  p->ns_base = (uint64_t) ticks * TIMER_NS_PER_TICK;
+
+  barrier ();
+  p->seq++;
+  last_tsc = tsc;
+}
+
+/* Stores in *TS the time by CLOCK, CLOCK_REALTIME or
+   CLOCK_MONOTONIC.  Returns 0 if successful, -1 if CLOCK is not
+   a clock. */
+int
+clock_gettime (int clock, struct timespec *ts) 
+{
+  ASSERT (page != NULL);
+  return clock_page_read (page, clock, ts);
+}
+
+/* Returns the clock page, for mapping into a user process. */
+void *
+clock_kpage (void) 
+{
+  return page;
+}
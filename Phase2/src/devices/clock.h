@@ -0,0 +1,12 @@
+#ifndef DEVICES_CLOCK_H
+#define DEVICES_CLOCK_H
+
+#include <clock.h>
+#include <stdint.h>
+
+void clock_init (void);
+void clock_tick (int64_t ticks);
+int clock_gettime (int clock, struct timespec *);
+void *clock_kpage (void);
+
+#endif /* devices/clock.h */
@@ -0,0 +1,40 @@
+#include "devices/debugcon.h"
+#include "threads/io.h"
+
+/* The debug console of QEMU ("-debugcon") and Bochs (the "port
+   0xe9 hack"): an I/O port whose every byte goes straight to the
+   host.  There is no transmitter to wait for, so a whole buffer
+   goes out with a single "rep outsb", which the hypervisor takes
+   as one string I/O exit instead of one exit per byte as the
+   serial port needs.  With the -debugcon kernel option, the
+   console writes here instead of to the serial port. */
+
+/* The debug console port. */
+#define DEBUGCON_PORT 0xe9
+
+/* True once debugcon_init() has found the port. */
+static bool active;
+
+/* Turns on the debug console, if there is one, and returns true
+   if so.  Reading the port gives back its own number when it
+   exists. */
+bool
+debugcon_init (void) 
+{
+  active = inb (DEBUGCON_PORT) == DEBUGCON_PORT;
+  return active;
+}
+
+/* Returns true if console output goes to the debug console. */
+bool
+debugcon_active (void) 
+{
+  return active;
+}
+
+/* Writes the N bytes in BUFFER to the debug console. */
+void
+debugcon_putbuf (const void *buffer, size_t n) 
+{
+  outsb (DEBUGCON_PORT, buffer, n);
+}
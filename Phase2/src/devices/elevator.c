@@ -0,0 +1,144 @@
+#include "devices/elevator.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+static int request_class (const struct elevator *,
+                          const struct io_request *);
+static bool try_merge (struct elevator *, struct io_request *front,
+                       struct io_request *back);
+
+/* Initializes E as an empty request queue whose merged requests
+   span at most MAX_CNT sectors. */
+void
+elevator_init (struct elevator *e, size_t max_cnt)
+{
+  ASSERT (max_cnt > 0);
+
+  list_init (&e->queue);
+  e->head = 0;
+  e->max_cnt = max_cnt;
+  e->dispatch_cnt = 0;
+}
+
+/* Returns true if E has no pending requests. */
+bool
+elevator_empty (struct elevator *e)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return list_empty (&e->queue);
+}
+
+/* Adds R to E in sector order, merging it with the pending
+   request just before or just after it when they are adjacent
+   on disk.  R takes the current thread's priority, or the
+   default one if this is an interrupt handler. */
+void
+elevator_add (struct elevator *e, struct io_request *r)
+{
+  struct list_elem *pos;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (r->cnt > 0 && r->cnt <= e->max_cnt);
+
+  r->next = NULL;
+  r->total_cnt = r->cnt;
+  r->priority = intr_context () ? PRI_DEFAULT : thread_get_priority ();
+  r->queued = e->dispatch_cnt;
+
+  for (pos = list_begin (&e->queue); pos != list_end (&e->queue);
+       pos = list_next (pos))
+    if (list_entry (pos, struct io_request, elem)->sector > r->sector)
+      break;
+  list_insert (pos, &r->elem);
+
+  /* Merge with the request after R, then with the one before. */
+  if (pos != list_end (&e->queue))
+    try_merge (e, r, list_entry (pos, struct io_request, elem));
+  if (list_prev (&r->elem) != list_head (&e->queue))
+    try_merge (e, list_entry (list_prev (&r->elem), struct io_request, elem),
+               r);
+}
+
+/* Removes and returns the request in E to dispatch next, which
+   must not be empty: the next one in C-LOOK order among those of
+   the highest class pending. */
+struct io_request *
+elevator_next (struct elevator *e)
+{
+  struct io_request *lowest = NULL;     /* First in the class. */
+  struct io_request *above = NULL;      /* First at or past head. */
+  struct list_elem *pos;
+  struct io_request *r;
+  int class = -1;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!list_empty (&e->queue));
+
+  for (pos = list_begin (&e->queue); pos != list_end (&e->queue);
+       pos = list_next (pos))
+    {
+      int c;
+
+      r = list_entry (pos, struct io_request, elem);
+      c = request_class (e, r);
+      if (c < class)
+        continue;
+      if (c > class)
+        {
+          class = c;
+          lowest = r;
+          above = NULL;
+        }
+      if (above == NULL && r->sector >= e->head)
+        above = r;
+    }
+
+  r = above != NULL ? above : lowest;
+  list_remove (&r->elem);
+  e->head = r->sector + r->total_cnt;
+  e->dispatch_cnt++;
+  return r;
+}
+
+/* Returns the class of queued request R in E: that of its
+   priority, plus one for every ELEVATOR_AGE dispatches it has
+   waited. */
+static int
+request_class (const struct elevator *e, const struct io_request *r)
+{
+  int class = r->priority * ELEVATOR_CLASSES / (PRI_MAX + 1);
+  unsigned long age = (e->dispatch_cnt - r->queued) / ELEVATOR_AGE;
+
+  if (age >= (unsigned long) (ELEVATOR_CLASSES - 1 - class))
+    return ELEVATOR_CLASSES - 1;
+  return class + age;
+}
+
+/* If queued requests FRONT and BACK, which are neighbours in E,
+   are in the same direction and BACK starts where FRONT ends,
+   removes BACK from E and chains it behind FRONT, which takes
+   the higher priority and the longer wait of the two.  Returns
+   true if they were merged. */
+static bool
+try_merge (struct elevator *e, struct io_request *front,
+           struct io_request *back)
+{
+  struct io_request *last;
+
+  if (front->write != back->write
+      || front->sector + front->total_cnt != back->sector
+      || front->total_cnt + back->total_cnt > e->max_cnt)
+    return false;
+
+  for (last = front; last->next != NULL; last = last->next)
+    continue;
+  last->next = back;
+  front->total_cnt += back->total_cnt;
+  if (back->priority > front->priority)
+    front->priority = back->priority;
+  if (back->queued < front->queued)
+    front->queued = back->queued;
+  list_remove (&back->elem);
+  return true;
+}
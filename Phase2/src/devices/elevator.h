@@ -0,0 +1,71 @@
+#ifndef DEVICES_ELEVATOR_H
+#define DEVICES_ELEVATOR_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* A per-device queue of pending block requests, which a driver
+   dispatches in C-LOOK order: ascending sector order from the
+   last position of the disk head, wrapping around to the lowest
+   pending sector once none lie above it.  Requests for adjacent
+   sectors in the same direction are merged, so that the driver
+   can satisfy them with one command.
+
+   Each request is tagged with the priority of the thread that
+   queued it, donations included, and falls into one of
+   ELEVATOR_CLASSES classes by it.  Only requests of the highest
+   class pending take part in the C-LOOK sweep, so that a
+   low-priority thread streaming a big file cannot hold up a
+   high-priority one's small reads.  So that it cannot starve in
+   turn, a request moves up a class for every ELEVATOR_AGE
+   requests dispatched while it waits.
+
+   Elevator functions can be called from kernel threads or from
+   external interrupt handlers.  Except for elevator_init(),
+   interrupts must be off in either case. */
+
+#define ELEVATOR_CLASSES 4       /* Priority classes. */
+#define ELEVATOR_AGE 8            /* Dispatches per class of aging. */
+
+struct io_request;
+
+/* Called when an I/O request has completed, possibly from an
+   interrupt handler. */
+typedef void io_done_func (struct io_request *);
+
+/* A request to transfer CNT sectors starting at SECTOR. */
+struct io_request
+  {
+    /* Filled in by the submitter. */
+    bool write;                 /* Write if true, read if false. */
+    block_sector_t sector;      /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    void *buffer;               /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    io_done_func *done;         /* Called on completion. */
+    void *aux;                  /* For use by DONE. */
+
+    /* Owned by the elevator. */
+    struct list_elem elem;      /* Element in an elevator's queue. */
+    struct io_request *next;    /* Next request merged behind this one. */
+    size_t total_cnt;           /* Sectors in this and merged requests. */
+    int priority;               /* Highest submitter priority. */
+    unsigned long queued;       /* Earliest dispatch_cnt when queued. */
+  };
+
+/* A request queue. */
+struct elevator
+  {
+    struct list queue;          /* Pending requests by ascending sector. */
+    block_sector_t head;        /* Sector just past the last dispatch. */
+    size_t max_cnt;             /* Most sectors one dispatch may cover. */
+    unsigned long dispatch_cnt; /* Requests dispatched so far. */
+  };
+
+void elevator_init (struct elevator *, size_t max_cnt);
+bool elevator_empty (struct elevator *);
+void elevator_add (struct elevator *, struct io_request *);
+struct io_request *elevator_next (struct elevator *);
+
+#endif /* devices/elevator.h */
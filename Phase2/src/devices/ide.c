@@ -1,17 +1,27 @@
 #include "devices/ide.h"
 #include <ctype.h>
 #include <debug.h>
+#include <inttypes.h>
+#include <stats.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include "devices/block.h"
+#include "devices/elevator.h"
 #include "devices/partition.h"
+#include "devices/pci.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/tsc.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].  If the
+   controller is a PCI bus master, transfers use DMA as described
+   by the Programming Interface for Bus Master IDE Controller,
+   otherwise programmed I/O. */
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -30,10 +40,45 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses, relative to the channel's
+   bus_master base. */
+#define bm_command(CHANNEL) ((CHANNEL)->bm_base + 0)    /* Command. */
+#define bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)     /* Status. */
+#define bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)       /* PRD table. */
+
+/* Bus master command register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer from disk to memory. */
+
+/* Bus master status register bits.  ERR and INTR are cleared by
+   writing 1 to them. */
+#define BM_STA_ERR 0x02         /* Transfer failed. */
+#define BM_STA_INTR 0x04        /* Disk raised its interrupt. */
+
+/* PCI class and subclass of an IDE controller, and the bit of
+   its programming interface byte meaning it is a bus master. */
+#define PCI_CLASS_STORAGE 0x01
+#define PCI_SUBCLASS_IDE 0x01
+#define PCI_IDE_BUS_MASTER 0x80
+
+/* A physical region descriptor, one entry in the table that
+   tells the bus master where a DMA transfer goes in memory.  A
+   region may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Byte count, 0 meaning 64 kB. */
+    uint16_t flags;             /* PRD_EOT on the last entry. */
+  };
+
+#define PRD_EOT 0x8000          /* End of table. */
+#define PRD_CNT (PGSIZE / sizeof (struct prd))
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +94,15 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Most sectors one command can transfer: the sector count
+   register holds 8 bits, with 0 meaning 256. */
+#define MAX_COMMAND_SECTORS 256
 
 /* An ATA device. */
 struct ata_disk
@@ -57,8 +111,26 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    int multi_cnt;              /* Sectors per READ/WRITE MULTIPLE data
+                                   block, 0 if multiple mode is off. */
+    bool dma;                   /* Does the disk support DMA? */
+    struct elevator queue;      /* Requests waiting for the channel. */
+
+    /* Synchronous transfers, for choosing between spinning and
+       sleeping until they complete.  Times in TSC cycles. */
+    uint64_t avg_cycles;        /* Recent completion time, averaged. */
+    uint64_t poll_cnt;          /* Transfers waited for by spinning. */
+    uint64_t poll_cycles;       /* Total time of those. */
+    uint64_t sleep_cnt;         /* Transfers waited for by sleeping. */
+    uint64_t sleep_cycles;      /* Total time of those. */
   };
 
+/* A synchronous transfer that starts at once spins for up to
+   twice the disk's average completion time instead of sleeping,
+   saving two context switches, if that average is at most this
+   many cycles.  Otherwise, or if it runs out, it sleeps. */
+#define POLL_MAX_CYCLES 500000
+
 /* An ATA channel (aka controller).
    Each channel can control up to two disks. */
 struct channel
@@ -66,11 +138,23 @@ struct channel
     char name[8];               /* Name, e.g. "ide0". */
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
+    uint16_t bm_base;           /* Bus master base I/O port, 0 if none. */
+    struct prd *prdt;           /* PRD table, if bm_base is nonzero. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
-    struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    struct semaphore completion_wait;   /* Up'd by interrupt handler while
+                                           no request is active. */
+
+    /* Request being carried out, driven by the interrupt
+       handler.  Access with interrupts off. */
+    struct io_request *active;  /* Active request, or null if idle. */
+    struct ata_disk *active_disk;       /* Disk ACTIVE is for. */
+    struct io_request *seg;     /* Merged request of the next sector. */
+    size_t seg_ofs;             /* Offset of that sector within SEG. */
+    size_t left;                /* Sectors ACTIVE has yet to move. */
+    size_t per_block;           /* Sectors per interrupt. */
+    bool dma;                   /* Is ACTIVE a DMA transfer? */
 
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
@@ -81,26 +165,44 @@ static struct channel channels[CHANNEL_CNT];
 
 static struct block_operations ide_operations;
 
+/* Use bus master DMA if the controller supports it?
+   Cleared by the kernel command-line option "-pio". */
+bool ide_dma = true;
+
+static uint16_t find_bus_master (void);
+
 static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
+static void set_multiple_mode (struct ata_disk *, const char *id);
+static void select_sector (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
+static void start_request (struct channel *);
+static void transfer_block (struct channel *);
+static void finish_request (struct channel *);
+static bool dma_possible (struct channel *, struct ata_disk *,
+                          struct io_request *);
+static void start_dma (struct channel *, struct io_request *);
+
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
+static bool poll_while_busy (const struct ata_disk *);
 static void select_device (const struct ata_disk *);
 static void select_device_wait (const struct ata_disk *);
 
+static void request_interrupt (struct channel *, uint8_t status);
+static void dma_interrupt (struct channel *, uint8_t status);
 static void interrupt_handler (struct intr_frame *);
 
 /* Initialize the disk subsystem and detect disks. */
 void
 ide_init (void) 
 {
+  uint16_t bm_base = ide_dma ? find_bus_master () : 0;
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
@@ -123,9 +225,18 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      c->bm_base = 0;
+      c->prdt = NULL;
+      if (bm_base != 0)
+        {
+          c->prdt = palloc_get_page (0);
+          if (c->prdt != NULL)
+            c->bm_base = bm_base + 8 * chan_no;
+        }
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      c->active = NULL;
+      c->active_disk = NULL;
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +247,11 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->dma = false;
+          elevator_init (&d->queue, MAX_COMMAND_SECTORS);
+          d->avg_cycles = 0;
+          d->poll_cnt = d->poll_cycles = 0;
+          d->sleep_cnt = d->sleep_cycles = 0;
         }
 
       /* Register interrupt handler. */
@@ -155,8 +271,55 @@ ide_init (void)
     }
 }
 
+/* Prints how each ATA disk's synchronous transfers were waited
+   for, and how long they took on average. */
+void
+ide_print_stats (void)
+{
+  size_t chan_no;
+  int dev_no;
+
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    for (dev_no = 0; dev_no < 2; dev_no++)
+      {
+        struct ata_disk *d = &channels[chan_no].devices[dev_no];
+        if (!d->is_ata || d->poll_cnt + d->sleep_cnt == 0)
+          continue;
+        printf ("%s: %"PRIu64" polled (%"PRIu64" cycles avg), "
+                "%"PRIu64" slept (%"PRIu64" cycles avg)\n", d->name,
+                d->poll_cnt, d->poll_cnt ? d->poll_cycles / d->poll_cnt : 0,
+                d->sleep_cnt,
+                d->sleep_cnt ? d->sleep_cycles / d->sleep_cnt : 0);
+      }
+}
+
 /* Disk detection and identification. */
 
+/* Looks for a PCI IDE controller that can act as a bus master
+   and enables bus mastering on it.  Returns the base I/O port of
+   its bus master registers, whose first 8 ports are for channel
+   0 and next 8 for channel 1, or 0 if there is none. */
+static uint16_t
+find_bus_master (void)
+{
+  struct pci_addr a;
+  uint32_t bar;
+
+  if (!pci_find_class (PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, &a)
+      || !(pci_read_config (a, PCI_REG_CLASS) >> 8 & PCI_IDE_BUS_MASTER))
+    return 0;
+
+  /* The bus master registers are in I/O space at BAR 4. */
+  bar = pci_read_config (a, PCI_REG_BAR0 + 4 * 4);
+  if (!(bar & 1) || (bar & 0xfffc) == 0)
+    return 0;
+
+  pci_write_config (a, PCI_REG_COMMAND,
+                    (pci_read_config (a, PCI_REG_COMMAND) & 0xffff)
+                    | PCI_CMD_IO | PCI_CMD_MASTER);
+  return bar & 0xfffc;
+}
+
 static char *descramble_ata_string (char *, int size);
 
 /* Resets an ATA channel and waits for any devices present on it
@@ -280,6 +443,8 @@ identify_ata_device (struct ata_disk *d)
       return;
     }
   input_sector (c, id);
+  set_multiple_mode (d, id);
+  d->dma = (*(uint16_t *) &id[49 * 2] & 0x0100) != 0;
 
   /* Calculate capacity.
      Read model name and serial number. */
@@ -306,9 +471,35 @@ identify_ata_device (struct ata_disk *d)
   /* Register. */
   block = block_register (d->name, BLOCK_RAW, extra_info, capacity,
                           &ide_operations, d);
+  stats_add_uint64 ("ide", d->name, "poll.cnt", &d->poll_cnt);
+  stats_add_uint64 ("ide", d->name, "poll.cycles", &d->poll_cycles);
+  stats_add_uint64 ("ide", d->name, "sleep.cnt", &d->sleep_cnt);
+  stats_add_uint64 ("ide", d->name, "sleep.cycles", &d->sleep_cycles);
   partition_scan (block);
 }
 
+/* Turns on multiple mode for disk D if its IDENTIFY DEVICE
+   response ID says it is supported, so that READ/WRITE MULTIPLE
+   interrupt once per block of sectors instead of per sector. */
+static void
+set_multiple_mode (struct ata_disk *d, const char *id) 
+{
+  struct channel *c = d->channel;
+  uint8_t max_cnt = id[47 * 2];
+
+  d->multi_cnt = 0;
+  if (max_cnt == 0)
+    return;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), max_cnt);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  sema_down (&c->completion_wait);
+  wait_while_busy (d);
+  if (!(inb (reg_status (c)) & STA_ERR))
+    d->multi_cnt = max_cnt;
+}
+
 /* Translates STRING, which consists of SIZE bytes in a funky
    format, into a null-terminated string in-place.  Drops
    trailing whitespace and null bytes.  Returns STRING.  */
@@ -337,23 +528,114 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
+/* Request queue. */
+
+/* Wakes the thread waiting for request R. */
+static void
+wake_requester (struct io_request *r)
+{
+  sema_up (r->aux);
+}
+
+/* Adds R to disk D's queue and starts it at once if D's channel
+   is idle.  Returns true if R was started, or merged into the
+   request that was. */
+static bool
+queue_request (struct ata_disk *d, struct io_request *r)
+{
+  struct channel *c = d->channel;
+  enum intr_level old_level = intr_disable ();
+  bool started = false;
+
+  elevator_add (&d->queue, r);
+  if (c->active == NULL)
+    {
+      start_request (c);
+      started = elevator_empty (&d->queue);
+    }
+  intr_set_level (old_level);
+  return started;
+}
+
+/* Waits for DONE to be upped by the completion of a request to
+   disk D, queued at START, and records how long that took.  If
+   the request was STARTED at once and D has been completing
+   requests quickly, spins for a while first: the interrupt then
+   completes the request on the way back into this thread, and
+   no thread switch is needed. */
+static void
+wait_for_request (struct ata_disk *d, struct semaphore *done, bool started,
+                  uint64_t start)
+{
+  uint64_t budget = 2 * d->avg_cycles;
+  bool polled = false;
+  uint64_t cycles;
+
+  if (started && d->avg_cycles <= POLL_MAX_CYCLES)
+    while (!(polled = sema_try_down (done)))
+      if (rdtsc () - start >= budget)
+        break;
+  if (!polled)
+    sema_down (done);
+
+  cycles = rdtsc () - start;
+  d->avg_cycles = (d->avg_cycles * 7 + cycles) / 8;
+  if (polled)
+    {
+      d->poll_cnt++;
+      d->poll_cycles += cycles;
+    }
+  else
+    {
+      d->sleep_cnt++;
+      d->sleep_cycles += cycles;
+    }
+}
+
+/* Moves CNT sectors starting at SEC_NO between disk D and
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes, writing to D if WRITE is true and otherwise reading
+   from it.  Returns once the transfer is complete.
+   Requests are queued on D and carried out by the interrupt
+   handler in elevator order, so external per-disk locking is
+   unneeded. */
+static void
+ide_transfer (struct ata_disk *d, block_sector_t sec_no, size_t cnt,
+              void *buffer, bool write)
+{
+  while (cnt > 0)
+    {
+      size_t n = cnt < MAX_COMMAND_SECTORS ? cnt : MAX_COMMAND_SECTORS;
+      struct semaphore done;
+      struct io_request r;
+      uint64_t start;
+      bool started;
+
+      sema_init (&done, 0);
+      r.write = write;
+      r.sector = sec_no;
+      r.cnt = n;
+      r.buffer = buffer;
+      r.done = wake_requester;
+      r.aux = &done;
+      start = rdtsc ();
+      started = queue_request (d, &r);
+      wait_for_request (d, &done, started, start);
+
+      sec_no += n;
+      cnt -= n;
+      buffer = (uint8_t *) buffer + n * BLOCK_SECTOR_SIZE;
+    }
+}
+
 /* Reads sector SEC_NO from disk D into BUFFER, which must have
    room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_read (void *d, block_sector_t sec_no, void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
+  ide_transfer (d, sec_no, 1, buffer, false);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -362,38 +644,217 @@ ide_read (void *d_, block_sector_t sec_no, void *buffer)
    Internally synchronizes accesses to disks, so external
    per-disk locking is unneeded. */
 static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
+ide_write (void *d, block_sector_t sec_no, const void *buffer)
 {
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  ide_transfer (d, sec_no, 1, (void *) buffer, true);
+}
+
+/* Reads CNT sectors starting at SEC_NO from disk D into BUFFER,
+   which must have room for CNT * BLOCK_SECTOR_SIZE bytes.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_read_multi (void *d, block_sector_t sec_no, size_t cnt, void *buffer)
+{
+  ide_transfer (d, sec_no, cnt, buffer, false);
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from BUFFER,
+   which must contain CNT * BLOCK_SECTOR_SIZE bytes.  Returns
+   after the disk has acknowledged receiving all of the data.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+static void
+ide_write_multi (void *d, block_sector_t sec_no, size_t cnt,
+                 const void *buffer)
+{
+  ide_transfer (d, sec_no, cnt, (void *) buffer, true);
+}
+
+/* Queues request R on disk D and returns without waiting for
+   it.  Disks on different channels carry out their requests at
+   the same time. */
+static void
+ide_submit (void *d, struct io_request *r)
+{
+  ASSERT (r->cnt <= MAX_COMMAND_SECTORS);
+  queue_request (d, r);
+}
+
+/* Starts the next queued request on channel C, which must be
+   idle, if there is one.  Stays with the disk that was served
+   last while it has requests pending, so that one disk's
+   elevator sweep is not broken up by the other's.
+   Interrupts must be off. */
+static void
+start_request (struct channel *c)
+{
+  struct ata_disk *d = c->active_disk;
+  struct io_request *r;
+  bool multiple;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (c->active == NULL);
+
+  if (d == NULL || elevator_empty (&d->queue))
+    {
+      d = d == &c->devices[0] ? &c->devices[1] : &c->devices[0];
+      if (elevator_empty (&d->queue))
+        {
+          d = &c->devices[1];
+          if (elevator_empty (&d->queue))
+            return;
+        }
+    }
+
+  /* Each command covers one request and everything merged into
+     it.  In multiple mode the disk interrupts once per block of
+     multi_cnt sectors, otherwise once per sector. */
+  r = elevator_next (&d->queue);
+  multiple = r->total_cnt > 1 && d->multi_cnt > 0;
+  c->active = r;
+  c->active_disk = d;
+  c->seg = r;
+  c->seg_ofs = 0;
+  c->left = r->total_cnt;
+  c->per_block = multiple ? (size_t) d->multi_cnt : 1;
+  c->dma = dma_possible (c, d, r);
+
+  select_sector (d, r->sector, r->total_cnt);
+  c->expecting_interrupt = true;
+  if (c->dma)
+    start_dma (c, r);
+  else if (r->write)
+    {
+      outb (reg_command (c), multiple ? CMD_WRITE_MULTIPLE
+                                      : CMD_WRITE_SECTOR_RETRY);
+      if (!poll_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, r->sector);
+      transfer_block (c);
+    }
+  else
+    outb (reg_command (c), multiple ? CMD_READ_MULTIPLE
+                                    : CMD_READ_SECTOR_RETRY);
+}
+
+/* Returns true if request R, for disk D on channel C, can be
+   carried out by DMA. */
+static bool
+dma_possible (struct channel *c, struct ata_disk *d, struct io_request *r)
+{
+  if (c->bm_base == 0 || !d->dma)
+    return false;
+
+  /* The bus master moves whole 16-bit words. */
+  for (; r != NULL; r = r->next)
+    if ((uintptr_t) r->buffer & 1)
+      return false;
+  return true;
+}
+
+/* Fills channel C's PRD table with the buffers of request R and
+   everything merged into it, then issues the DMA command for R,
+   whose sectors have already been selected.  The disk
+   interrupts once, when the whole transfer is done.
+   Kernel virtual memory maps physical memory linearly, so each
+   buffer is contiguous in physical memory too. */
+static void
+start_dma (struct channel *c, struct io_request *r)
+{
+  uint8_t direction = r->write ? 0 : BM_CMD_READ;
+  struct prd *prd = c->prdt;
+  struct io_request *seg;
+
+  for (seg = r; seg != NULL; seg = seg->next)
+    {
+      uintptr_t addr = vtop (seg->buffer);
+      size_t size = seg->cnt * BLOCK_SECTOR_SIZE;
+
+      while (size > 0)
+        {
+          size_t chunk = 0x10000 - (addr & 0xffff);
+          if (chunk > size)
+            chunk = size;
+
+          ASSERT (prd < c->prdt + PRD_CNT);
+          prd->addr = addr;
+          prd->size = chunk & 0xffff;
+          prd->flags = 0;
+          prd++;
+
+          addr += chunk;
+          size -= chunk;
+        }
+    }
+  prd[-1].flags = PRD_EOT;
+
+  outl (bm_prdt (c), vtop (c->prdt));
+  outb (bm_command (c), direction);
+  outb (bm_status (c), inb (bm_status (c)) | BM_STA_ERR | BM_STA_INTR);
+  outb (reg_command (c), r->write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (bm_command (c), direction | BM_CMD_START);
+}
+
+/* Moves the next block of the active request on channel C
+   through the data register, walking into the following merged
+   request whenever one is used up. */
+static void
+transfer_block (struct channel *c)
+{
+  size_t n = c->left < c->per_block ? c->left : c->per_block;
+
+  c->left -= n;
+  while (n-- > 0)
+    {
+      uint8_t *sector = (uint8_t *) c->seg->buffer
+                        + c->seg_ofs * BLOCK_SECTOR_SIZE;
+
+      if (c->active->write)
+        output_sector (c, sector);
+      else
+        input_sector (c, sector);
+      if (++c->seg_ofs == c->seg->cnt)
+        {
+          c->seg = c->seg->next;
+          c->seg_ofs = 0;
+        }
+    }
+}
+
+/* Retires the active request on channel C, and everything
+   merged into it, and starts the next one.  Their callbacks run
+   later, so that the disk is kept busy and the interrupt handler
+   stays short. */
+static void
+finish_request (struct channel *c)
+{
+  block_complete (c->active);
+  c->active = NULL;
+  start_request (c);
 }
 
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_multi,
+    ide_write_multi,
+    ide_submit
   };
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and the sector count CNT to the disk's sector
+   selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sector (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt >= 1 && cnt <= MAX_COMMAND_SECTORS);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt & 0xff);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -402,7 +863,8 @@ select_sector (struct ata_disk *d, block_sector_t sec_no)
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
-   completion interrupt. */
+   completion interrupt.  Used only for commands that are not
+   queued requests. */
 static void
 issue_pio_command (struct channel *c, uint8_t command) 
 {
@@ -446,7 +908,7 @@ wait_until_idle (const struct ata_disk *d)
     {
       if ((inb (reg_status (d->channel)) & (STA_BSY | STA_DRQ)) == 0)
         return;
-      timer_usleep (10);
+      timer_udelay (10);
     }
 
   printf ("%s: idle timeout\n", d->name);
@@ -479,6 +941,23 @@ wait_while_busy (const struct ata_disk *d)
   return false;
 }
 
+/* Like wait_while_busy(), but busy-waits for at most about
+   30 ms, so that it may be called with interrupts off. */
+static bool
+poll_while_busy (const struct ata_disk *d) 
+{
+  struct channel *c = d->channel;
+  int i;
+
+  for (i = 0; i < 3000; i++)
+    {
+      if (!(inb (reg_alt_status (c)) & STA_BSY)) 
+        return (inb (reg_alt_status (c)) & STA_DRQ) != 0;
+      timer_udelay (10);
+    }
+  return false;
+}
+
 /* Program D's channel so that D is now the selected disk. */
 static void
 select_device (const struct ata_disk *d)
@@ -489,7 +968,7 @@ select_device (const struct ata_disk *d)
     dev |= DEV_DEV;
   outb (reg_device (c), dev);
   inb (reg_alt_status (c));
-  timer_nsleep (400);
+  timer_ndelay (400);
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
@@ -502,6 +981,46 @@ select_device_wait (const struct ata_disk *d)
   wait_until_idle (d);
 }
 
+/* Advances channel C's active request on an interrupt that
+   left the disk with the given STATUS.  For a read, each
+   interrupt announces a block of data to fetch; for a write,
+   each interrupt acknowledges the block sent before it. */
+static void
+request_interrupt (struct channel *c, uint8_t status)
+{
+  struct io_request *r = c->active;
+  struct ata_disk *d = c->active_disk;
+
+  if ((status & STA_ERR) || (c->left > 0 && !poll_while_busy (d)))
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+           r->write ? "write" : "read", r->sector + r->total_cnt - c->left);
+
+  if (c->left == 0)
+    {
+      ASSERT (r->write);
+      finish_request (c);
+      return;
+    }
+  transfer_block (c);
+  if (c->left == 0 && !r->write)
+    finish_request (c);
+}
+
+/* Completes channel C's active DMA request on the interrupt
+   that ends it, which left the disk with the given STATUS. */
+static void
+dma_interrupt (struct channel *c, uint8_t status)
+{
+  uint8_t bm = inb (bm_status (c));
+
+  outb (bm_command (c), 0);
+  outb (bm_status (c), bm | BM_STA_ERR | BM_STA_INTR);
+  if ((status & STA_ERR) || (bm & BM_STA_ERR))
+    PANIC ("%s: disk DMA %s failed, sector=%"PRDSNu, c->active_disk->name,
+           c->active->write ? "write" : "read", c->active->sector);
+  finish_request (c);
+}
+
 /* ATA interrupt handler. */
 static void
 interrupt_handler (struct intr_frame *f) 
@@ -513,8 +1032,14 @@ interrupt_handler (struct intr_frame *f)
       {
         if (c->expecting_interrupt) 
           {
-            inb (reg_status (c));               /* Acknowledge interrupt. */
-            sema_up (&c->completion_wait);      /* Wake up waiter. */
+            uint8_t status = inb (reg_status (c));  /* Acknowledge. */
+
+            if (c->active == NULL)
+              sema_up (&c->completion_wait);    /* Wake up waiter. */
+            else if (c->dma)
+              dma_interrupt (c, status);
+            else
+              request_interrupt (c, status);
           }
         else
           printf ("%s: unexpected interrupt\n", c->name);
@@ -1,6 +1,13 @@
 #ifndef DEVICES_IDE_H
 #define DEVICES_IDE_H
 
+#include <stdbool.h>
+
+/* Use bus master DMA when available?  False means programmed
+   I/O only. */
+extern bool ide_dma;
+
 void ide_init (void);
+void ide_print_stats (void);
 
 #endif /* devices/ide.h */
@@ -1,28 +1,97 @@
 #include "devices/input.h"
 #include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stats.h>
+#include <stdio.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "threads/waitq.h"
 
-/* Stores keys from the keyboard and serial port. */
+/* Stores keys from the keyboard and serial port.  Both write it
+   with interrupts off, so they never interrupt each other and
+   together are the queue's one producer.  It holds INPUT_DEFAULT
+   keys unless input_kb asks for more, enough for a pasted screen
+   of text to wait for a reader. */
+#define INPUT_DEFAULT 1024
+static uint8_t keys_default[INPUT_DEFAULT];
 static struct intq buffer;
 
-/* Initializes the input buffer. */
+/* Size of the input buffer in kB, or 0 for the default.  Set
+   with -input-kb; rounded down to a power of 2. */
+size_t input_kb;
+
+/* Keys added and keys dropped because the buffer was full. */
+static uint64_t key_cnt;
+static uint64_t drop_cnt;
+
+/* Threads waiting in poll() for a key. */
+static struct waitq pollers;
+
+/* Initializes the input buffer, in input_kb kB of pages if that
+   is more than the default. */
 void
 input_init (void) 
 {
-  intq_init (&buffer);
+  size_t size = 1;
+  uint8_t *keys = NULL;
+
+  if (input_kb != 0)
+    {
+      while (size * 2 <= input_kb)
+        size *= 2;
+      size *= 1024;
+      if (size > INPUT_DEFAULT)
+        keys = palloc_get_multiple (0, DIV_ROUND_UP (size, PGSIZE));
+    }
+  if (keys != NULL)
+    intq_init (&buffer, keys, 1, size);
+  else
+    intq_init (&buffer, keys_default, 1, INPUT_DEFAULT);
+  waitq_init (&pollers);
+
+  stats_add_uint64 ("input", NULL, "keys", &key_cnt);
+  stats_add_uint64 ("input", NULL, "dropped", &drop_cnt);
 }
 
-/* Adds a key to the input buffer.
-   Interrupts must be off and the buffer must not be full. */
+/* Prints input buffer statistics. */
+void
+input_print_stats (void) 
+{
+  printf ("Input: %"PRIu64" keys buffered, %"PRIu64" dropped\n",
+          key_cnt, drop_cnt);
+}
+
+/* Adds a key to the input buffer, or drops it if the buffer is
+   full.  Interrupts must be off. */
 void
 input_putc (uint8_t key) 
 {
+  input_putbuf (&key, 1);
+}
+
+/* Adds the CNT keys in KEYS to the input buffer, as many as
+   there is room for, and drops and counts the rest.  Readers
+   and pollers are woken once for the lot.  Returns the number
+   of keys added.  Interrupts must be off. */
+size_t
+input_putbuf (const uint8_t *keys, size_t cnt) 
+{
+  size_t put;
+
   ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT (!intq_full (&buffer));
 
-  intq_putc (&buffer, key);
-  serial_notify ();
+  put = intq_put (&buffer, keys, cnt);
+  key_cnt += put;
+  drop_cnt += cnt - put;
+  if (put > 0)
+    {
+      serial_notify ();
+      waitq_wake (&pollers);
+    }
+  return put;
 }
 
 /* Retrieves a key from the input buffer.
@@ -41,6 +110,16 @@ input_getc (void)
   return key;
 }
 
+/* Returns true if the input buffer is empty,
+   false otherwise.
+   Interrupts must be off. */
+bool
+input_empty (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return intq_empty (&buffer);
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
@@ -50,3 +129,20 @@ input_full (void)
   ASSERT (intr_get_level () == INTR_OFF);
   return intq_full (&buffer);
 }
+
+/* Returns the number of keys the input buffer has room for.
+   Interrupts must be off. */
+size_t
+input_room (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return buffer.cnt - intq_count (&buffer);
+}
+
+/* Puts ENTRY on the wait queue woken whenever a key is added to
+   the input buffer. */
+void
+input_waitq_add (struct waitq_entry *entry) 
+{
+  waitq_add (&pollers, entry);
+}
@@ -2,11 +2,21 @@
 #define DEVICES_INPUT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+struct waitq_entry;
+
+extern size_t input_kb;
+
 void input_init (void);
+void input_print_stats (void);
 void input_putc (uint8_t);
+size_t input_putbuf (const uint8_t *, size_t);
 uint8_t input_getc (void);
+bool input_empty (void);
 bool input_full (void);
+size_t input_room (void);
+void input_waitq_add (struct waitq_entry *);
 
 #endif /* devices/input.h */
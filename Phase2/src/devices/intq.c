@@ -1,17 +1,28 @@
 #include "devices/intq.h"
 #include <debug.h>
+#include <string.h>
 #include "threads/thread.h"
 
-static int next (int pos);
+static void copy (struct intq *q, void *dst, const void *src,
+                  unsigned pos, size_t cnt, bool to_queue);
 static void wait (struct intq *q, struct thread **waiter);
 static void signal (struct intq *q, struct thread **waiter);
 
-/* Initializes interrupt queue Q. */
+/* Initializes interrupt queue Q to hold CNT elements of
+   ELEM_SIZE bytes each in BUF.  CNT must be a power of 2, so
+   that HEAD and TAIL stay in step when they overflow. */
 void
-intq_init (struct intq *q) 
+intq_init (struct intq *q, void *buf, size_t elem_size, size_t cnt) 
 {
+  ASSERT (buf != NULL);
+  ASSERT (elem_size > 0);
+  ASSERT (cnt > 0 && (cnt & (cnt - 1)) == 0);
+
   lock_init (&q->lock);
   q->not_full = q->not_empty = NULL;
+  q->buf = buf;
+  q->elem_size = elem_size;
+  q->cnt = cnt;
   q->head = q->tail = 0;
 }
 
@@ -19,7 +30,6 @@ intq_init (struct intq *q)
 bool
 intq_empty (const struct intq *q) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
   return q->head == q->tail;
 }
 
@@ -27,72 +37,137 @@ intq_empty (const struct intq *q)
 bool
 intq_full (const struct intq *q) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
-  return next (q->head) == q->tail;
+  return intq_count (q) == q->cnt;
+}
+
+/* Returns the number of elements in Q. */
+size_t
+intq_count (const struct intq *q) 
+{
+  return q->head - q->tail;
+}
+
+/* Adds up to CNT elements from ELEMS to the end of Q, as many as
+   there is room for, and returns how many.  Never sleeps.  Only
+   Q's producer may call this. */
+size_t
+intq_put (struct intq *q, const void *elems, size_t cnt) 
+{
+  unsigned head = q->head;
+  size_t room = q->cnt - (head - q->tail);
+
+  if (cnt > room)
+    cnt = room;
+  if (cnt == 0)
+    return 0;
+
+  /* Write the elements before HEAD says they are there. */
+  copy (q, NULL, elems, head, cnt, true);
+  barrier ();
+  q->head = head + cnt;
+  barrier ();
+
+  signal (q, &q->not_empty);
+  return cnt;
+}
+
+/* Removes up to CNT elements from the front of Q into ELEMS, as
+   many as there are, and returns how many.  Never sleeps.  Only
+   Q's consumer may call this. */
+size_t
+intq_get (struct intq *q, void *elems, size_t cnt) 
+{
+  unsigned tail = q->tail;
+  size_t avail = q->head - tail;
+
+  if (cnt > avail)
+    cnt = avail;
+  if (cnt == 0)
+    return 0;
+
+  /* Read HEAD before the elements it covers, and finish with
+     them before TAIL lets the producer reuse their slots. */
+  barrier ();
+  copy (q, elems, NULL, tail, cnt, false);
+  barrier ();
+  q->tail = tail + cnt;
+  barrier ();
+
+  signal (q, &q->not_full);
+  return cnt;
 }
 
-/* Removes a byte from Q and returns it.
-   If Q is empty, sleeps until a byte is added.
+/* Removes a byte from Q, which must be a queue of bytes, and
+   returns it.  If Q is empty, sleeps until a byte is added.
    When called from an interrupt handler, Q must not be empty. */
 uint8_t
 intq_getc (struct intq *q) 
 {
   uint8_t byte;
   
-  ASSERT (intr_get_level () == INTR_OFF);
-  while (intq_empty (q)) 
-    {
-      ASSERT (!intr_context ());
-      lock_acquire (&q->lock);
-      wait (q, &q->not_empty);
-      lock_release (&q->lock);
-    }
-  
-  byte = q->buf[q->tail];
-  q->tail = next (q->tail);
-  signal (q, &q->not_full);
+  ASSERT (q->elem_size == 1);
+  while (intq_get (q, &byte, 1) == 0)
+    wait (q, &q->not_empty);
   return byte;
 }
 
-/* Adds BYTE to the end of Q.
+/* Adds BYTE to the end of Q, which must be a queue of bytes.
    If Q is full, sleeps until a byte is removed.
    When called from an interrupt handler, Q must not be full. */
 void
 intq_putc (struct intq *q, uint8_t byte) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
-  while (intq_full (q))
-    {
-      ASSERT (!intr_context ());
-      lock_acquire (&q->lock);
-      wait (q, &q->not_full);
-      lock_release (&q->lock);
-    }
-
-  q->buf[q->head] = byte;
-  q->head = next (q->head);
-  signal (q, &q->not_empty);
+  ASSERT (q->elem_size == 1);
+  while (intq_put (q, &byte, 1) == 0)
+    wait (q, &q->not_full);
 }
-
-/* Returns the position after POS within an intq. */
-static int
-next (int pos) 
+
+/* Copies CNT elements between Q's slots starting at position POS
+   and SRC, if TO_QUEUE, or DST otherwise, in at most two pieces
+   since the slots may wrap around the end of the buffer. */
+static void
+copy (struct intq *q, void *dst, const void *src,
+      unsigned pos, size_t cnt, bool to_queue) 
 {
-  return (pos + 1) % INTQ_BUFSIZE;
+  size_t ofs = pos & (q->cnt - 1);
+  size_t first = q->cnt - ofs < cnt ? q->cnt - ofs : cnt;
+  size_t sz = q->elem_size;
+
+  if (to_queue)
+    {
+      memcpy (q->buf + ofs * sz, src, first * sz);
+      memcpy (q->buf, (const uint8_t *) src + first * sz,
+              (cnt - first) * sz);
+    }
+  else
+    {
+      memcpy (dst, q->buf + ofs * sz, first * sz);
+      memcpy ((uint8_t *) dst + first * sz, q->buf,
+              (cnt - first) * sz);
+    }
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
-   member.  Waits until the given condition is true. */
+   member.  Waits until the given condition is true.  The check
+   and the sleep happen with interrupts off, so that a wake-up
+   from the other side cannot fall in between. */
 static void
-wait (struct intq *q UNUSED, struct thread **waiter) 
+wait (struct intq *q, struct thread **waiter) 
 {
+  enum intr_level old_level;
+
   ASSERT (!intr_context ());
-  ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT ((waiter == &q->not_empty && intq_empty (q))
-          || (waiter == &q->not_full && intq_full (q)));
+  ASSERT (waiter == &q->not_empty || waiter == &q->not_full);
 
-  *waiter = thread_current ();
-  thread_block ();
+  lock_acquire (&q->lock);
+  old_level = intr_disable ();
+  while (waiter == &q->not_empty ? intq_empty (q) : intq_full (q))
+    {
+      *waiter = thread_current ();
+      thread_block ();
+    }
+  intr_set_level (old_level);
+  lock_release (&q->lock);
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
@@ -102,13 +177,16 @@ wait (struct intq *q UNUSED, struct thread **waiter)
 static void
 signal (struct intq *q UNUSED, struct thread **waiter) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT ((waiter == &q->not_empty && !intq_empty (q))
-          || (waiter == &q->not_full && !intq_full (q)));
+  ASSERT (waiter == &q->not_empty || waiter == &q->not_full);
 
   if (*waiter != NULL) 
     {
-      thread_unblock (*waiter);
-      *waiter = NULL;
+      enum intr_level old_level = intr_disable ();
+      if (*waiter != NULL) 
+        {
+          thread_unblock (*waiter);
+          *waiter = NULL;
+        }
+      intr_set_level (old_level);
     }
 }
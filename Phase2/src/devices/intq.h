@@ -1,26 +1,28 @@
 #ifndef DEVICES_INTQ_H
 #define DEVICES_INTQ_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 
 /* An "interrupt queue", a circular buffer shared between
    kernel threads and external interrupt handlers.
 
-   Interrupt queue functions can be called from kernel threads or
-   from external interrupt handlers.  Except for intq_init(),
-   interrupts must be off in either case.
+   A queue has one producer and one consumer, either of which
+   may be an external interrupt handler.  Neither needs
+   interrupts off to put or get: the producer writes elements
+   and then advances HEAD, the consumer reads them and then
+   advances TAIL, with a barrier in between, so each only ever
+   sees elements the other has finished with.  Interrupts go off
+   only to sleep or to wake a sleeper.
 
-   The interrupt queue has the structure of a "monitor".  Locks
-   and condition variables from threads/synch.h cannot be used in
-   this case, as they normally would, because they can only
-   protect kernel threads from one another, not from interrupt
-   handlers. */
+   Elements are all ELEM_SIZE bytes, stored in a buffer the
+   caller provides.  intq_getc() and intq_putc() are shorthands
+   for queues of bytes. */
 
-/* Queue buffer size, in bytes. */
-#define INTQ_BUFSIZE 64
-
-/* A circular queue of bytes. */
+/* A circular queue. */
 struct intq
   {
     /* Waiting threads. */
@@ -29,14 +31,19 @@ struct intq
     struct thread *not_empty;   /* Thread waiting for not-empty condition. */
 
     /* Queue. */
-    uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
-    int head;                   /* New data is written here. */
-    int tail;                   /* Old data is read here. */
+    uint8_t *buf;               /* Buffer of CNT elements. */
+    size_t elem_size;           /* Bytes per element. */
+    unsigned cnt;               /* Capacity, a power of 2. */
+    volatile unsigned head;     /* Elements put; only producer changes. */
+    volatile unsigned tail;     /* Elements taken; only consumer changes. */
   };
 
-void intq_init (struct intq *);
+void intq_init (struct intq *, void *buf, size_t elem_size, size_t cnt);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
+size_t intq_count (const struct intq *);
+size_t intq_put (struct intq *, const void *, size_t cnt);
+size_t intq_get (struct intq *, void *, size_t cnt);
 uint8_t intq_getc (struct intq *);
 void intq_putc (struct intq *, uint8_t);
 
@@ -1,9 +1,11 @@
 #include "devices/kbd.h"
 #include <ctype.h>
 #include <debug.h>
+#include <stats.h>
 #include <stdio.h>
 #include <string.h>
 #include "devices/input.h"
+#include "devices/intq.h"
 #include "devices/shutdown.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
@@ -24,13 +26,25 @@ static bool caps_lock;
 /* Number of keys pressed. */
 static int64_t key_cnt;
 
+/* Scancodes read by keyboard_interrupt() and not yet decoded by
+   keyboard_thread(). */
+#define SCANCODE_CNT 64
+static uint16_t scancodes_buf[SCANCODE_CNT];
+static struct intq scancodes;
+
 static intr_handler_func keyboard_interrupt;
+static intr_thread_func keyboard_thread;
+static bool decode (unsigned code, uint8_t *cp);
 
 /* Initializes the keyboard. */
 void
 kbd_init (void) 
 {
-  intr_register_ext (0x21, keyboard_interrupt, "8042 Keyboard");
+  intq_init (&scancodes, scancodes_buf, sizeof *scancodes_buf,
+             SCANCODE_CNT);
+  intr_register_threaded (0x21, keyboard_interrupt, keyboard_thread,
+                          "8042 Keyboard");
+  stats_add_int64 ("kbd", NULL, "keys", &key_cnt);
 }
 
 /* Prints keyboard statistics. */
@@ -92,28 +106,65 @@ static const struct keymap shifted_keymap[] =
 
 static bool map_key (const struct keymap[], unsigned scancode, uint8_t *);
 
+/* Keyboard interrupt handler.  Only reads the scancode, which
+   acknowledges the controller, and leaves it to keyboard_thread()
+   to decode.  A scancode that finds the queue full is dropped. */
 static void
 keyboard_interrupt (struct intr_frame *args UNUSED) 
+{
+  /* Read scancode, including second byte if prefix code. */
+  uint16_t code = inb (DATA_REG);
+  if (code == 0xe0)
+    code = (code << 8) | inb (DATA_REG);
+
+  intq_put (&scancodes, &code, 1);
+}
+
+/* Decodes the scancodes the interrupt handler has queued and
+   adds the characters they stand for to the input buffer, as
+   many at once as there are, so that a burst of keys wakes the
+   reader once. */
+static void
+keyboard_thread (void) 
+{
+  uint16_t codes[SCANCODE_CNT];
+  uint8_t chars[SCANCODE_CNT];
+  size_t code_cnt;
+
+  while ((code_cnt = intq_get (&scancodes, codes, SCANCODE_CNT)) > 0)
+    {
+      size_t char_cnt = 0;
+      size_t i;
+
+      for (i = 0; i < code_cnt; i++)
+        if (decode (codes[i], &chars[char_cnt]))
+          char_cnt++;
+      if (char_cnt > 0)
+        {
+          enum intr_level old_level = intr_disable ();
+          key_cnt += input_putbuf (chars, char_cnt);
+          intr_set_level (old_level);
+        }
+    }
+}
+
+/* Updates the shift state for scancode CODE.  If CODE is a key
+   press that stands for a character, stores the character in *CP
+   and returns true; otherwise returns false. */
+static bool
+decode (unsigned code, uint8_t *cp) 
 {
   /* Status of shift keys. */
   bool shift = left_shift || right_shift;
   bool alt = left_alt || right_alt;
   bool ctrl = left_ctrl || right_ctrl;
 
-  /* Keyboard scancode. */
-  unsigned code;
-
   /* False if key pressed, true if key released. */
   bool release;
 
   /* Character that corresponds to `code'. */
   uint8_t c;
 
-  /* Read scancode, including second byte if prefix code. */
-  code = inb (DATA_REG);
-  if (code == 0xe0)
-    code = (code << 8) | inb (DATA_REG);
-
   /* Bit 0x80 distinguishes key press from key release
      (even if there's a prefix). */
   release = (code & 0x80) != 0;
@@ -153,12 +204,8 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
           if (alt)
             c += 0x80;
 
-          /* Append to keyboard buffer. */
-          if (!input_full ())
-            {
-              key_cnt++;
-              input_putc (c);
-            }
+          *cp = c;
+          return true;
         }
     }
   else
@@ -192,6 +239,7 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
             break;
           }
     }
+  return false;
 }
 
 /* Scans the array of keymaps K for SCANCODE.
@@ -0,0 +1,153 @@
+#include "devices/pci.h"
+#include <debug.h>
+#include "threads/io.h"
+
+/* This code reads and writes PCI configuration space through
+   configuration mechanism #1, the pair of I/O ports found on
+   every PC chipset since the early 1990s.  See [PCI] for
+   details.  It is just enough for drivers to find their
+   controller and its registers: find() walks every function on
+   every bus, and drivers match on class or on vendor and device
+   ID.  Pintos does not otherwise configure the bus, leaving base
+   addresses and interrupt lines as the BIOS set them. */
+
+/* I/O ports. */
+#define PCI_CONFIG_ADDR 0xcf8   /* Selects a configuration register. */
+#define PCI_CONFIG_DATA 0xcfc   /* Reads or writes the selected one. */
+
+/* Selects configuration register REG of function A. */
+static void
+select_config (struct pci_addr a, uint8_t reg)
+{
+  ASSERT (reg % 4 == 0);
+  outl (PCI_CONFIG_ADDR, (0x80000000u | (uint32_t) a.bus << 16
+                          | (uint32_t) a.dev << 11 | (uint32_t) a.func << 8
+                          | reg));
+}
+
+/* Returns the 32-bit configuration register REG of function A. */
+uint32_t
+pci_read_config (struct pci_addr a, uint8_t reg)
+{
+  select_config (a, reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Sets the 32-bit configuration register REG of function A to
+   VALUE. */
+void
+pci_write_config (struct pci_addr a, uint8_t reg, uint32_t value)
+{
+  select_config (a, reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Tells whether the function at A, whose ID and class
+   registers are ID and CLASS_REG, is the one being looked for. */
+typedef bool match_func (struct pci_addr a, uint32_t id, uint32_t class_reg,
+                         void *aux);
+
+/* Searches every PCI function for the first for which MATCH
+   returns true.  If one exists, stores its location in *A and
+   returns true, otherwise returns false. */
+static bool
+find (match_func *match, void *aux, struct pci_addr *a)
+{
+  unsigned bus;
+  struct pci_addr cur;
+
+  for (bus = 0; bus < 256; bus++)
+    {
+      cur.bus = bus;
+      for (cur.dev = 0; cur.dev < 32; cur.dev++)
+        for (cur.func = 0; cur.func < 8; cur.func++)
+          {
+            uint32_t id = pci_read_config (cur, PCI_REG_ID);
+
+            if ((id & 0xffff) == 0xffff)
+              {
+                /* No function here.  Without function 0 there
+                   are no others in this device. */
+                if (cur.func == 0)
+                  break;
+                continue;
+              }
+
+            if (match (cur, id, pci_read_config (cur, PCI_REG_CLASS), aux))
+              {
+                *a = cur;
+                return true;
+              }
+
+            /* Only multi-function devices have functions past 0. */
+            if (cur.func == 0
+                && !(pci_read_config (cur, PCI_REG_HEADER) & 0x00800000))
+              break;
+          }
+    }
+  return false;
+}
+
+/* Matches a function whose class and subclass are the two bytes
+   at AUX. */
+static bool
+match_class (struct pci_addr a UNUSED, uint32_t id UNUSED,
+             uint32_t class_reg, void *aux)
+{
+  const uint8_t *want = aux;
+  return ((class_reg >> 24) == want[0]
+          && ((class_reg >> 16) & 0xff) == want[1]);
+}
+
+/* What match_id() looks for. */
+struct id_match
+  {
+    uint32_t id;                /* Vendor and device ID register. */
+    unsigned skip;              /* Matches to pass over first. */
+  };
+
+/* Matches the function after AUX->skip others whose vendor and
+   device ID register is AUX->id. */
+static bool
+match_id (struct pci_addr a UNUSED, uint32_t id, uint32_t class_reg UNUSED,
+          void *aux)
+{
+  struct id_match *want = aux;
+
+  if (id != want->id)
+    return false;
+  if (want->skip > 0)
+    {
+      want->skip--;
+      return false;
+    }
+  return true;
+}
+
+/* Searches the PCI functions for the first with the given CLASS
+   and SUBCLASS.  If one exists, stores its location in *A and
+   returns true, otherwise returns false. */
+bool
+pci_find_class (uint8_t class, uint8_t subclass, struct pci_addr *a)
+{
+  uint8_t want[2];
+
+  want[0] = class;
+  want[1] = subclass;
+  return find (match_class, want, a);
+}
+
+/* Searches the PCI functions for the one with the given VENDOR
+   and DEVICE IDs that comes after IDX others with them.  If it
+   exists, stores its location in *A and returns true, otherwise
+   returns false. */
+bool
+pci_find_device (uint16_t vendor, uint16_t device, unsigned idx,
+                 struct pci_addr *a)
+{
+  struct id_match want;
+
+  want.id = (uint32_t) device << 16 | vendor;
+  want.skip = idx;
+  return find (match_id, &want, a);
+}
@@ -0,0 +1,39 @@
+#ifndef DEVICES_PCI_H
+#define DEVICES_PCI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Location of a PCI function in configuration space. */
+struct pci_addr
+  {
+    uint8_t bus;
+    uint8_t dev;
+    uint8_t func;
+  };
+
+/* Offsets of configuration registers used in Pintos. */
+#define PCI_REG_ID 0x00         /* Vendor ID (15:0), device ID (31:16). */
+#define PCI_REG_COMMAND 0x04    /* Command (15:0), status (31:16). */
+#define PCI_REG_CLASS 0x08      /* Revision (7:0), prog IF (15:8),
+                                   subclass (23:16), class (31:24). */
+#define PCI_REG_HEADER 0x0c     /* Header type in bits 23:16. */
+#define PCI_REG_BAR0 0x10       /* First base address register. */
+#define PCI_REG_SUBSYS 0x2c     /* Subsystem vendor (15:0), ID (31:16). */
+#define PCI_REG_INTR 0x3c       /* Interrupt line (7:0), pin (15:8). */
+
+/* Command register bits. */
+#define PCI_CMD_IO 0x0001       /* Respond to I/O space accesses. */
+#define PCI_CMD_MASTER 0x0004   /* Allow bus mastering. */
+
+/* Base address register bits. */
+#define PCI_BAR_IO 0x00000001   /* I/O space, not memory. */
+#define PCI_BAR_IO_MASK 0xfffffffc /* Base of an I/O space BAR. */
+
+uint32_t pci_read_config (struct pci_addr, uint8_t reg);
+void pci_write_config (struct pci_addr, uint8_t reg, uint32_t value);
+bool pci_find_class (uint8_t class, uint8_t subclass, struct pci_addr *);
+bool pci_find_device (uint16_t vendor, uint16_t device, unsigned idx,
+                      struct pci_addr *);
+
+#endif /* devices/pci.h */
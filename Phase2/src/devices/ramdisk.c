@@ -0,0 +1,163 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* A block device backed by kernel pages.
+
+   The pages need not be contiguous, so a large RAM disk does not
+   depend on finding a long run of free physical memory. */
+
+/* Sectors per page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A RAM disk. */
+struct ramdisk
+  {
+    uint8_t **pages;            /* Backing pages, SECTORS_PER_PAGE each. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+static struct block_operations ramdisk_operations;
+
+/* Creates a RAM disk named "rd0" of KB kB, rounded up to a whole
+   page, and registers it as a raw block device.  KB may be 0 if
+   FROM is non-null.
+
+   If FROM is non-null, it names a block device whose contents
+   are copied into the RAM disk.  If KB is 0, the RAM disk is the
+   same size as FROM; otherwise, only as much of FROM as fits is
+   copied. */
+void
+ramdisk_init (size_t kb, const char *from)
+{
+  struct block *src = NULL;
+  struct ramdisk *rd;
+  block_sector_t sector_cnt;
+  char extra_info[64];
+  size_t i;
+
+  if (from != NULL)
+    {
+      src = block_get_by_name (from);
+      if (src == NULL)
+        PANIC ("ramdisk: no such block device \"%s\"", from);
+      if (kb == 0)
+        kb = DIV_ROUND_UP (block_size (src), 2);
+    }
+  if (kb == 0)
+    return;
+
+  rd = malloc (sizeof *rd);
+  if (rd == NULL)
+    PANIC ("ramdisk: out of memory");
+  rd->page_cnt = DIV_ROUND_UP (kb * 1024, PGSIZE);
+  rd->pages = malloc (rd->page_cnt * sizeof *rd->pages);
+  if (rd->pages == NULL)
+    PANIC ("ramdisk: out of memory");
+  for (i = 0; i < rd->page_cnt; i++)
+    {
+      rd->pages[i] = palloc_get_page (PAL_ZERO);
+      if (rd->pages[i] == NULL)
+        PANIC ("ramdisk: out of memory after %zu of %zu pages",
+               i, rd->page_cnt);
+    }
+  sector_cnt = rd->page_cnt * SECTORS_PER_PAGE;
+
+  if (src != NULL)
+    {
+      block_sector_t copy_cnt = block_size (src);
+      block_sector_t sector;
+
+      if (copy_cnt > sector_cnt)
+        copy_cnt = sector_cnt;
+      for (sector = 0; sector < copy_cnt; sector += SECTORS_PER_PAGE)
+        {
+          size_t cnt = copy_cnt - sector;
+          if (cnt > SECTORS_PER_PAGE)
+            cnt = SECTORS_PER_PAGE;
+          block_read_multi (src, sector, cnt,
+                            rd->pages[sector / SECTORS_PER_PAGE]);
+        }
+      snprintf (extra_info, sizeof extra_info,
+                "RAM disk loaded from %s", block_name (src));
+    }
+  else
+    strlcpy (extra_info, "RAM disk", sizeof extra_info);
+
+  block_register ("rd0", BLOCK_RAW, extra_info, sector_cnt,
+                  &ramdisk_operations, rd);
+}
+
+/* Copies CNT sectors starting at SECTOR between RD and BUFFER,
+   into BUFFER if TO_BUFFER is true and out of it otherwise. */
+static void
+ramdisk_transfer (struct ramdisk *rd, block_sector_t sector, size_t cnt,
+                  uint8_t *buffer, bool to_buffer)
+{
+  while (cnt > 0)
+    {
+      size_t ofs = sector % SECTORS_PER_PAGE;
+      size_t chunk = SECTORS_PER_PAGE - ofs;
+      uint8_t *page_sector;
+
+      if (chunk > cnt)
+        chunk = cnt;
+      page_sector = (rd->pages[sector / SECTORS_PER_PAGE]
+                     + ofs * BLOCK_SECTOR_SIZE);
+      if (to_buffer)
+        memcpy (buffer, page_sector, chunk * BLOCK_SECTOR_SIZE);
+      else
+        memcpy (page_sector, buffer, chunk * BLOCK_SECTOR_SIZE);
+
+      sector += chunk;
+      cnt -= chunk;
+      buffer += chunk * BLOCK_SECTOR_SIZE;
+    }
+}
+
+/* Reads sector SEC_NO from RAM disk RD_ into BUFFER. */
+static void
+ramdisk_read (void *rd_, block_sector_t sec_no, void *buffer)
+{
+  ramdisk_transfer (rd_, sec_no, 1, buffer, true);
+}
+
+/* Writes BUFFER to sector SEC_NO on RAM disk RD_. */
+static void
+ramdisk_write (void *rd_, block_sector_t sec_no, const void *buffer)
+{
+  ramdisk_transfer (rd_, sec_no, 1, (uint8_t *) buffer, false);
+}
+
+/* Reads CNT sectors starting at SEC_NO from RAM disk RD_ into
+   BUFFER. */
+static void
+ramdisk_read_multi (void *rd_, block_sector_t sec_no, size_t cnt,
+                    void *buffer)
+{
+  ramdisk_transfer (rd_, sec_no, cnt, buffer, true);
+}
+
+/* Writes CNT sectors from BUFFER starting at SEC_NO on RAM disk
+   RD_. */
+static void
+ramdisk_write_multi (void *rd_, block_sector_t sec_no, size_t cnt,
+                     const void *buffer)
+{
+  ramdisk_transfer (rd_, sec_no, cnt, (uint8_t *) buffer, false);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    ramdisk_read_multi,
+    ramdisk_write_multi,
+    NULL
+  };
@@ -5,8 +5,10 @@
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* Register definitions for the 16550A UART used in PCs.
    The 16550A has a lot more going on than shown here, but this
@@ -33,6 +35,14 @@
 #define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+#define FCR_CLEAR_RX 0x02       /* Clear receive FIFO. */
+#define FCR_CLEAR_TX 0x04       /* Clear transmit FIFO. */
+
+/* Interrupt Identification Register bits. */
+#define IIR_FIFO 0xc0           /* Both set if the FIFOs are enabled. */
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
@@ -51,9 +61,39 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
+/* Bytes the 16550A's transmit FIFO holds. */
+#define TX_FIFO_SIZE 16
+
+/* Bytes serial_interrupt() may write each time the transmitter
+   runs dry: TX_FIFO_SIZE once the FIFO is enabled, or 1 on a UART
+   without one. */
+static unsigned tx_burst = 1;
+
+/* Data to be transmitted, written by serial_putbuf() and
+   drained by serial_interrupt().  It is much bigger than the
+   input queue, so that a burst of console output is queued and
+   the writer carries on instead of waiting for the port.  It
+   holds TXQ_DEFAULT bytes unless serial_txq_kb asks for more.
+   The writer also drains it by polling when it cannot sleep, so
+   interrupts must be off to touch it. */
+#define TXQ_DEFAULT 4096
+static uint8_t txq_default[TXQ_DEFAULT];
 static struct intq txq;
 
+/* Size of the transmit queue in kB, or 0 for the default.  Set
+   with -serial-kb; rounded down to a power of 2. */
+size_t serial_txq_kb;
+
+/* The thread waiting for room in txq, if any.  Writers that can
+   wait hold the kernel log's drain lock, so there is at most
+   one. */
+static struct thread *txq_waiter;
+
+static bool txq_empty (void);
+static bool txq_full (void);
+static uint8_t txq_getc (void);
+static void txq_wake (void);
+static void txq_alloc (void);
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
 static void write_ier (void);
@@ -71,7 +111,6 @@ init_poll (void)
   outb (FCR_REG, 0);                    /* Disable FIFO. */
   set_serial (9600);                    /* 9.6 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
   mode = POLL;
 } 
 
@@ -87,6 +126,15 @@ serial_init_queue (void)
     init_poll ();
   ASSERT (mode == POLL);
 
+  txq_alloc ();
+
+  /* Turn on the FIFOs, so that each transmit interrupt can send
+     TX_FIFO_SIZE bytes instead of one.  A UART without them
+     reads back as having none and keeps going a byte at a time. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RX | FCR_CLEAR_TX);
+  if ((inb (IIR_REG) & IIR_FIFO) == IIR_FIFO)
+    tx_burst = TX_FIFO_SIZE;
+
   intr_register_ext (0x20 + 4, serial_interrupt, "serial");
   mode = QUEUE;
   old_level = intr_disable ();
@@ -98,33 +146,64 @@ serial_init_queue (void)
 void
 serial_putc (uint8_t byte) 
 {
+  serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port.  Interrupts go
+   off once for the whole buffer, and it is copied into the
+   transmit queue as many bytes at a time as there is room for. */
+void
+serial_putbuf (const void *buffer, size_t n) 
+{
+  const uint8_t *p = buffer;
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit the bytes. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte); 
+      while (n-- > 0)
+        putc_poll (*p++);
     }
   else 
-    {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
-        {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
-        }
-
-      intq_putc (&txq, byte); 
-      write_ier ();
-    }
+    while (n > 0)
+      {
+        bool was_empty;
+        size_t put;
+
+        while (txq_full ())
+          {
+            if (old_level == INTR_OFF || intr_context ()
+                || txq_waiter != NULL)
+              {
+                /* Interrupts are off and the transmit queue is
+                   full.  If we wanted to wait for the queue to
+                   empty, we'd have to reenable interrupts.
+                   That's impolite, so we'll send a character via
+                   polling instead. */
+                putc_poll (txq_getc ());
+              }
+            else
+              {
+                /* Sleep until serial_interrupt() makes room. */
+                txq_waiter = thread_current ();
+                write_ier ();
+                thread_block ();
+              }
+          }
+
+        /* Queue as much as fits.  The transmit interrupt is
+           already on unless the queue was empty, so the
+           interrupt enable register only needs writing then. */
+        was_empty = txq_empty ();
+        put = intq_put (&txq, p, n);
+        p += put;
+        n -= put;
+        if (was_empty)
+          write_ier ();
+      }
   
   intr_set_level (old_level);
 }
@@ -135,8 +214,9 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (!txq_empty ())
+    putc_poll (txq_getc ());
+  txq_wake ();
   intr_set_level (old_level);
 }
 
@@ -152,6 +232,76 @@ serial_notify (void)
     write_ier ();
 }
 
+/* Returns true if the transmit queue is empty. */
+static bool
+txq_empty (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return intq_empty (&txq);
+}
+
+/* Returns true if the transmit queue is full. */
+static bool
+txq_full (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return intq_full (&txq);
+}
+
+/* Removes a byte from the transmit queue, which must not be
+   empty, and returns it. */
+static uint8_t
+txq_getc (void)
+{
+  uint8_t byte;
+
+  ASSERT (!txq_empty ());
+
+  intq_get (&txq, &byte, 1);
+  return byte;
+}
+
+/* Wakes up the thread waiting for room in the transmit queue, if
+   any, once the queue is no more than half full, so that it does
+   not wake up again for every byte sent. */
+static void
+txq_wake (void)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (txq_waiter != NULL && intq_count (&txq) <= txq.cnt / 2)
+    {
+      thread_unblock (txq_waiter);
+      txq_waiter = NULL;
+    }
+}
+
+/* Sets up the transmit queue: serial_txq_kb kB of pages if that
+   is bigger than the default and there are pages for it,
+   txq_default otherwise.  Nothing is queued before
+   interrupt-driven mode starts, so there is nothing to move. */
+static void
+txq_alloc (void)
+{
+  size_t size = 1;
+  uint8_t *buf = NULL;
+
+  ASSERT (txq_empty ());
+
+  if (serial_txq_kb != 0)
+    {
+      while (size * 2 <= serial_txq_kb)
+        size *= 2;
+      size *= 1024;
+      if (size > TXQ_DEFAULT)
+        buf = palloc_get_multiple (0, size / PGSIZE);
+    }
+  if (buf != NULL)
+    intq_init (&txq, buf, 1, size);
+  else
+    intq_init (&txq, txq_default, 1, TXQ_DEFAULT);
+}
+
 /* Configures the serial port for BPS bits per second. */
 static void
 set_serial (int bps)
@@ -182,7 +332,7 @@ write_ier (void)
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
+  if (!txq_empty ())
     ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
@@ -209,19 +359,41 @@ putc_poll (uint8_t byte)
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
 {
+  uint8_t rx[16];
+  size_t rx_cnt;
+
   /* Inquire about interrupt in UART.  Without this, we can
      occasionally miss an interrupt running under QEMU. */
   inb (IIR_REG);
 
   /* As long as we have room to receive a byte, and the hardware
-     has a byte for us, receive a byte.  */
-  while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
-    input_putc (inb (RBR_REG));
-
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+     has a byte for us, receive a byte.  Bytes go to the input
+     buffer a FIFO's worth at a time, so that a burst wakes the
+     reader once. */
+  do
+    {
+      size_t room = input_room ();
+      rx_cnt = 0;
+      while (rx_cnt < room && rx_cnt < sizeof rx
+             && (inb (LSR_REG) & LSR_DR) != 0)
+        rx[rx_cnt++] = inb (RBR_REG);
+      input_putbuf (rx, rx_cnt);
+    }
+  while (rx_cnt == sizeof rx);
+
+  /* If the transmitter has run dry, refill it: up to a FIFO's
+     worth of bytes in one go, since THRE means the whole FIFO is
+     empty. */
+  if ((inb (LSR_REG) & LSR_THRE) != 0)
+    {
+      uint8_t burst[TX_FIFO_SIZE];
+      size_t cnt = intq_get (&txq, burst, tx_burst);
+      size_t i;
+
+      for (i = 0; i < cnt; i++)
+        outb (THR_REG, burst[i]);
+    }
+  txq_wake ();
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
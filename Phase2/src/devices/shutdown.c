@@ -1,10 +1,18 @@
 #include "devices/shutdown.h"
 #include <console.h>
+#include <klog.h>
+#include <stats.h>
 #include <stdio.h>
+#include "devices/input.h"
 #include "devices/kbd.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/profile.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/exception.h"
@@ -57,6 +65,7 @@ void
 shutdown_reboot (void)
 {
   printf ("Rebooting...\n");
+  klog_flush ();
 
     /* See [kbd] for details on how to program the keyboard
      * controller. */
@@ -97,6 +106,7 @@ shutdown_power_off (void)
   print_stats ();
 
   printf ("Powering off...\n");
+  klog_flush ();
   serial_flush ();
 
   /* ACPI power-off */
@@ -133,9 +143,17 @@ print_stats (void)
 #ifdef FILESYS
   block_print_stats ();
 #endif
+  lock_print_stats ();
+  palloc_print_stats ();
+  malloc_print_stats ();
+  intr_print_stats ();
   console_print_stats ();
   kbd_print_stats ();
+  input_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+  profile_print ();
+  if (stats_enabled)
+    stats_emit ();
 }
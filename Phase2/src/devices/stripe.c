@@ -0,0 +1,227 @@
+#include "devices/stripe.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/elevator.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* A block device striped across several others (RAID 0).
+
+   The device's sectors are dealt out to the members CHUNK at a
+   time, round robin, so that a long transfer keeps every member
+   busy.  A transfer is split at chunk boundaries and each piece
+   is submitted to its member without waiting, so members on
+   different IDE channels move their pieces at the same time;
+   consecutive pieces bound for one member are adjacent on it and
+   are merged back into one command by its elevator. */
+
+/* Most member devices. */
+#define STRIPE_MAX 4
+
+/* Pieces submitted before waiting for them to finish. */
+#define PIECE_BATCH 16
+
+/* A striped device. */
+struct stripe
+  {
+    struct block *members[STRIPE_MAX];  /* Member devices. */
+    size_t member_cnt;                  /* Number of members. */
+    block_sector_t chunk;               /* Sectors per chunk. */
+  };
+
+static struct block_operations stripe_operations;
+
+/* Creates a block device named "md0" striped across the block
+   devices named in MEMBERS, separated by commas, with CHUNK
+   sectors per chunk, and registers it as a raw block device.
+   Does nothing if MEMBERS is null.  Each member contributes as
+   many whole chunks as the smallest of them holds.  For the
+   members to transfer in parallel, they should be on different
+   IDE channels, e.g. "hdb,hdd". */
+void
+stripe_init (const char *members, size_t chunk)
+{
+  struct stripe *s;
+  block_sector_t member_size = 0;
+  char extra_info[64];
+  size_t i;
+
+  if (members == NULL)
+    return;
+  if (chunk == 0 || chunk > BLOCK_SUBMIT_MAX)
+    PANIC ("stripe: chunk must be 1 to %d sectors", BLOCK_SUBMIT_MAX);
+
+  s = malloc (sizeof *s);
+  if (s == NULL)
+    PANIC ("stripe: out of memory");
+  s->member_cnt = 0;
+  s->chunk = chunk;
+  while (*members != '\0')
+    {
+      size_t len = strcspn (members, ",");
+      char name[16];
+      struct block *block;
+
+      if (s->member_cnt >= STRIPE_MAX)
+        PANIC ("stripe: more than %d members", STRIPE_MAX);
+      if (len >= sizeof name)
+        PANIC ("stripe: bad member name \"%s\"", members);
+      strlcpy (name, members, len + 1);
+      block = block_get_by_name (name);
+      if (block == NULL)
+        PANIC ("stripe: no such block device \"%s\"", name);
+      for (i = 0; i < s->member_cnt; i++)
+        if (s->members[i] == block)
+          PANIC ("stripe: \"%s\" given twice", name);
+      if (s->member_cnt == 0 || block_size (block) < member_size)
+        member_size = block_size (block);
+      s->members[s->member_cnt++] = block;
+
+      members += len;
+      if (*members == ',')
+        members++;
+    }
+  if (s->member_cnt == 0)
+    PANIC ("stripe: no members");
+  member_size -= member_size % chunk;
+  if (member_size == 0)
+    PANIC ("stripe: members are smaller than one chunk");
+
+  snprintf (extra_info, sizeof extra_info,
+            "striped across %zu devices, %zu-sector chunks",
+            s->member_cnt, chunk);
+  block_register ("md0", BLOCK_RAW, extra_info, member_size * s->member_cnt,
+                  &stripe_operations, s);
+}
+
+/* Returns the member of S holding SECTOR, and stores in
+   *MEMBER_SECTOR where it is on that member and in *LEFT how
+   many sectors, counting SECTOR, remain in its chunk. */
+static struct block *
+map_sector (const struct stripe *s, block_sector_t sector,
+            block_sector_t *member_sector, size_t *left)
+{
+  block_sector_t chunk_no = sector / s->chunk;
+  block_sector_t ofs = sector % s->chunk;
+
+  *member_sector = chunk_no / s->member_cnt * s->chunk + ofs;
+  *left = s->chunk - ofs;
+  return s->members[chunk_no % s->member_cnt];
+}
+
+/* Moves CNT sectors starting at SECTOR between S and BUFFER,
+   writing to S if WRITE is true and otherwise reading from it.
+   Returns once the transfer is complete. */
+static void
+stripe_transfer (struct stripe *s, block_sector_t sector, size_t cnt,
+                 uint8_t *buffer, bool write)
+{
+  while (cnt > 0)
+    {
+      struct io_request pieces[PIECE_BATCH];
+      struct semaphore done;
+      size_t piece_cnt = 0;
+
+      sema_init (&done, 0);
+      while (cnt > 0 && piece_cnt < PIECE_BATCH)
+        {
+          struct io_request *r = &pieces[piece_cnt++];
+          block_sector_t member_sector;
+          size_t left;
+          struct block *member = map_sector (s, sector, &member_sector,
+                                             &left);
+          size_t n = cnt < left ? cnt : left;
+
+          r->write = write;
+          r->sector = member_sector;
+          r->cnt = n;
+          r->buffer = buffer;
+          r->done = block_wake_sema;
+          r->aux = &done;
+          block_submit (member, r);
+
+          sector += n;
+          cnt -= n;
+          buffer += n * BLOCK_SECTOR_SIZE;
+        }
+      while (piece_cnt-- > 0)
+        sema_down (&done);
+    }
+}
+
+/* Reads sector SECTOR from striped device S_ into BUFFER. */
+static void
+stripe_read (void *s_, block_sector_t sector, void *buffer)
+{
+  struct stripe *s = s_;
+  block_sector_t member_sector;
+  size_t left;
+  struct block *member = map_sector (s, sector, &member_sector, &left);
+
+  block_read (member, member_sector, buffer);
+}
+
+/* Writes BUFFER to sector SECTOR on striped device S_. */
+static void
+stripe_write (void *s_, block_sector_t sector, const void *buffer)
+{
+  struct stripe *s = s_;
+  block_sector_t member_sector;
+  size_t left;
+  struct block *member = map_sector (s, sector, &member_sector, &left);
+
+  block_write (member, member_sector, buffer);
+}
+
+/* Reads CNT sectors starting at SECTOR from striped device S_
+   into BUFFER. */
+static void
+stripe_read_multi (void *s_, block_sector_t sector, size_t cnt,
+                   void *buffer)
+{
+  stripe_transfer (s_, sector, cnt, buffer, false);
+}
+
+/* Writes CNT sectors starting at SECTOR to striped device S_
+   from BUFFER. */
+static void
+stripe_write_multi (void *s_, block_sector_t sector, size_t cnt,
+                    const void *buffer)
+{
+  stripe_transfer (s_, sector, cnt, (uint8_t *) buffer, true);
+}
+
+/* Queues request R on striped device S_.  A request within one
+   chunk, such as a single sector, is passed on to its member
+   without waiting; one that spans chunks is carried out before
+   returning. */
+static void
+stripe_submit (void *s_, struct io_request *r)
+{
+  struct stripe *s = s_;
+  block_sector_t member_sector;
+  size_t left;
+  struct block *member = map_sector (s, r->sector, &member_sector, &left);
+
+  if (r->cnt <= left)
+    {
+      r->sector = member_sector;
+      block_submit (member, r);
+    }
+  else
+    {
+      stripe_transfer (s, r->sector, r->cnt, r->buffer, r->write);
+      r->done (r);
+    }
+}
+
+static struct block_operations stripe_operations =
+  {
+    stripe_read,
+    stripe_write,
+    stripe_read_multi,
+    stripe_write_multi,
+    stripe_submit
+  };
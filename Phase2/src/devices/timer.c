@@ -2,9 +2,13 @@
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
+#include <stats.h>
 #include <stdio.h>
+#include "devices/clock.h"
 #include "devices/pit.h"
 #include "threads/interrupt.h"
+#include "threads/profile.h"
+#include "threads/softirq.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
   
@@ -20,14 +24,33 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* Alarms set by timer_alarm_set(), timer_add() or timer_sleep()
+   and not gone off yet, soonest first.  Changed only with interrupts off.  The timer interrupt
+   only notices that the first is due; timer_softirq() sets them
+   off. */
+static struct list alarms = LIST_INITIALIZER (alarms);
+
+/* Most alarms timer_softirq() sets off with interrupts off at
+   once. */
+#define ALARM_BATCH 8
+
+/* Functions called by timer_add() alarms. */
+static int64_t callback_cnt;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* If nonzero, timer_calibrate() uses this as loops_per_tick
+   instead of measuring it.  Set by the -lpt kernel option. */
+unsigned timer_cached_lpt;
+
 static intr_handler_func timer_interrupt;
+static softirq_func timer_softirq;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void alarm_arm (struct timer_alarm *);
 static void real_time_delay (int64_t num, int32_t denom);
 
 /* Sets up the timer to interrupt TIMER_FREQ times per second,
@@ -37,6 +60,9 @@ timer_init (void)
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
+  softirq_register (SOFTIRQ_TIMER, timer_softirq);
+  stats_add_int64 ("timer", NULL, "ticks", &ticks);
+  stats_add_int64 ("timer", NULL, "callbacks", &callback_cnt);
 }
 
 /* Calibrates loops_per_tick, used to implement brief delays. */
@@ -46,6 +72,13 @@ timer_calibrate (void)
   unsigned high_bit, test_bit;
 
   ASSERT (intr_get_level () == INTR_ON);
+  if (timer_cached_lpt != 0)
+    {
+      loops_per_tick = timer_cached_lpt;
+      printf ("Timer: %'"PRIu64" loops/s (cached lpt=%u).\n",
+              (uint64_t) loops_per_tick * TIMER_FREQ, loops_per_tick);
+      return;
+    }
   printf ("Calibrating timer...  ");
 
   /* Approximate loops_per_tick as the largest power-of-two
@@ -63,7 +96,8 @@ timer_calibrate (void)
     if (!too_many_loops (loops_per_tick | test_bit))
       loops_per_tick |= test_bit;
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("%'"PRIu64" loops/s (lpt=%u).\n",
+          (uint64_t) loops_per_tick * TIMER_FREQ, loops_per_tick);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -89,11 +123,138 @@ timer_elapsed (int64_t then)
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  struct timer_alarm alarm;
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  old_level = intr_disable ();
+  alarm.tick = ticks + timer_ticks ();
+  alarm.deadline = 0;
+  alarm.sema = NULL;
+  alarm.func = NULL;
+  alarm.thread = thread_current ();
+  alarm_arm (&alarm);
+  thread_block ();
+  intr_set_level (old_level);
+}
+
+/* Returns true if alarm A goes off before alarm B: at an earlier
+   tick, or in the same one with an earlier deadline. */
+static bool
+alarm_less (const struct list_elem *a_, const struct list_elem *b_,
+            void *aux UNUSED)
+{
+  const struct timer_alarm *a = list_entry (a_, struct timer_alarm, elem);
+  const struct timer_alarm *b = list_entry (b_, struct timer_alarm, elem);
+
+  if (a->tick != b->tick)
+    return a->tick < b->tick;
+  return a->deadline < b->deadline;
+}
+
+/* Adds ALARM to the alarm list.  Interrupts must be off. */
+static void
+alarm_arm (struct timer_alarm *alarm)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  alarm->armed = true;
+  list_insert_ordered (&alarms, &alarm->elem, alarm_less, NULL);
+}
+
+/* Sets ALARM to up SEMA at timer tick TICK, or at the next tick
+   if TICK has passed.  ALARM must not be armed already, and must
+   be cancelled if it may still be armed when it goes out of
+   scope. */
+void
+timer_alarm_set (struct timer_alarm *alarm, int64_t tick,
+                 struct semaphore *sema)
+{
+  enum intr_level old_level;
+
+  ASSERT (sema != NULL);
+
+  alarm->tick = tick;
+  alarm->deadline = 0;
+  alarm->sema = sema;
+  alarm->func = NULL;
+  alarm->thread = NULL;
+  old_level = intr_disable ();
+  alarm_arm (alarm);
+  intr_set_level (old_level);
+}
+
+/* Disarms ALARM if it has not gone off yet. */
+void
+timer_alarm_cancel (struct timer_alarm *alarm)
+{
+  timer_cancel (alarm);
+}
+
+/* Returns the time since boot in nanoseconds, by the monotonic
+   clock, which the time-stamp counter carries between ticks. */
+int64_t
+timer_ns (void) 
+{
+  struct timespec ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Sets ALARM to call FUNC with AUX once timer_ns() reaches
+   DEADLINE, so that kernel code with something to do later need
+   not keep a thread asleep in timer_sleep() for it.  FUNC is
+   called by the timer softirq at the first tick at or after
+   DEADLINE, and never before: ticks come TIMER_NS_PER_TICK
+   apart, and there is no other timer to interrupt between them.
+   ALARM must not be armed already, and must be cancelled if it
+   may still be armed when it goes out of scope.  May be called
+   from an interrupt handler, including FUNC. */
+void
+timer_add (struct timer_alarm *alarm, int64_t deadline,
+           timer_func *func, void *aux)
+{
+  enum intr_level old_level;
+
+  ASSERT (func != NULL);
+
+  alarm->deadline = deadline;
+  alarm->sema = NULL;
+  alarm->func = func;
+  alarm->aux = aux;
+  alarm->thread = NULL;
+  old_level = intr_disable ();
+
+  /* A deadline already past at the latest tick goes off at the
+     next one, so that FUNC setting the alarm again cannot keep
+     the softirq busy. */
+  alarm->tick = DIV_ROUND_UP (deadline, TIMER_NS_PER_TICK);
+  if (alarm->tick <= ticks)
+    alarm->tick = ticks + 1;
+  alarm_arm (alarm);
+  intr_set_level (old_level);
+}
+
+/* Disarms ALARM.  Returns true if it had not gone off yet, false
+   if it had, or was never set.  A timer_add() function that has
+   started running is not waited for. */
+bool
+timer_cancel (struct timer_alarm *alarm)
+{
+  enum intr_level old_level = intr_disable ();
+  bool armed = alarm->armed;
+
+  if (armed)
+    {
+      alarm->armed = false;
+      list_remove (&alarm->elem);
+    }
+  intr_set_level (old_level);
+  return armed;
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -168,10 +329,75 @@ timer_print_stats (void)
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
 {
+  if (thread_profile)
+    profile_sample (args);
   ticks++;
-  thread_tick ();
+  clock_tick (ticks);
+
+  if (!list_empty (&alarms)
+      && list_entry (list_front (&alarms), struct timer_alarm,
+                     elem)->tick <= ticks)
+    softirq_raise (SOFTIRQ_TIMER);
+  thread_tick ((args->cs & 3) == 3);
+}
+
+/* Sets off the alarms that are due, ALARM_BATCH at a time with
+   interrupts turned off, waking the sleepers of each batch in
+   one go.  A batch ends early at an alarm that calls a function,
+   which is called once interrupts are back on. */
+static void
+timer_softirq (void)
+{
+  bool more = true;
+
+  while (more)
+    {
+      enum intr_level old_level = intr_disable ();
+      timer_func *func = NULL;
+      void *aux = NULL;
+      struct list sleepers;
+      int i;
+
+      list_init (&sleepers);
+      more = false;
+      for (i = 0; !list_empty (&alarms); i++)
+        {
+          struct timer_alarm *alarm
+            = list_entry (list_front (&alarms), struct timer_alarm, elem);
+          if (alarm->tick > ticks)
+            break;
+          if (i == ALARM_BATCH)
+            {
+              more = true;
+              break;
+            }
+          list_pop_front (&alarms);
+          alarm->armed = false;
+          if (alarm->func != NULL)
+            {
+              /* Once disarmed, ALARM may be freed or reused. */
+              func = alarm->func;
+              aux = alarm->aux;
+              more = true;
+              break;
+            }
+          if (alarm->sema != NULL)
+            sema_up (alarm->sema);
+          else
+            list_push_back (&sleepers, &alarm->thread->elem);
+        }
+      if (!list_empty (&sleepers))
+        thread_unblock_all (&sleepers);
+      intr_set_level (old_level);
+
+      if (func != NULL)
+        {
+          func (aux);
+          callback_cnt++;
+        }
+    }
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
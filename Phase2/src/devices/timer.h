@@ -1,14 +1,20 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
+struct semaphore;
+struct thread;
+
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
 void timer_init (void);
 void timer_calibrate (void);
+extern unsigned timer_cached_lpt;
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
@@ -19,6 +25,38 @@ void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* Nanoseconds per timer tick. */
+#define TIMER_NS_PER_TICK (1000000000 / TIMER_FREQ)
+
+int64_t timer_ns (void);
+
+/* Called by a timer_add() alarm when it goes off, from the timer
+   softirq: in interrupt context, with interrupts on.  May not
+   sleep, but may set the alarm again. */
+typedef void timer_func (void *aux);
+
+/* An alarm that ups a semaphore once a given tick has come, for
+   waits that give up after a while, wakes a thread in
+   timer_sleep(), or calls a function. */
+struct timer_alarm
+  {
+    struct list_elem elem;              /* Element in the alarm list. */
+    int64_t tick;                       /* When to go off. */
+    int64_t deadline;                   /* timer_add() time, or 0. */
+    struct semaphore *sema;             /* What to up then, or... */
+    timer_func *func;                   /* ...what to call, or... */
+    struct thread *thread;              /* ...if both null, what to wake. */
+    void *aux;                          /* Argument to FUNC. */
+    bool armed;                         /* Not gone off or cancelled? */
+  };
+
+void timer_alarm_set (struct timer_alarm *, int64_t tick,
+                      struct semaphore *);
+void timer_alarm_cancel (struct timer_alarm *);
+void timer_add (struct timer_alarm *, int64_t deadline,
+                timer_func *, void *aux);
+bool timer_cancel (struct timer_alarm *);
+
 /* Busy waits. */
 void timer_mdelay (int64_t milliseconds);
 void timer_udelay (int64_t microseconds);
@@ -0,0 +1,188 @@
+#include "devices/tty.h"
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/input.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/* Terminal input: the line discipline between the keys in the
+   input buffer and processes reading from stdin.
+
+   In raw mode, the default, keys are passed on as they are, as
+   soon as there are any.  In cooked mode, they are echoed and
+   collected into a line that can be edited with backspace and
+   Ctrl+U, and a reader gets nothing until the line is ended by
+   Enter, which reads as a new-line, or by Ctrl+D, which is not
+   passed on, so that Ctrl+D on an empty line reads as end of
+   file. */
+
+/* Bytes the line buffer holds.  In cooked mode, a line that
+   fills it is passed on as it is. */
+#define TTY_BUF_SIZE 256
+
+/* Control keys. */
+#define KEY_EOF 0x04            /* Ctrl+D. */
+#define KEY_BS 0x08             /* Backspace. */
+#define KEY_KILL 0x15           /* Ctrl+U. */
+#define KEY_DEL 0x7f            /* Delete, sent by many terminals
+                                   for backspace. */
+
+/* Serializes readers, and protects everything below. */
+static struct lock tty_lock;
+
+/* True in cooked mode. */
+static bool cooked_mode;
+
+/* Keys taken from the input buffer.  The first READY_LEN bytes
+   can be read; the rest, in cooked mode only, are the line being
+   edited. */
+static char buf[TTY_BUF_SIZE];
+static size_t buf_len;
+static size_t ready_len;
+
+/* Set when a cooked line ended in Ctrl+D with nothing in it, for
+   the next read to return 0. */
+static bool eof;
+
+/* Initializes terminal input. */
+void
+tty_init (void)
+{
+  lock_init_named (&tty_lock, "tty");
+}
+
+/* Echoes the erasure of the last character on the line. */
+static void
+erase (void)
+{
+  buf_len--;
+  printf ("\b \b");
+}
+
+/* Applies the line discipline to KEY.  tty_lock must be held. */
+static void
+tty_key (char key)
+{
+  if (!cooked_mode)
+    {
+      buf[buf_len++] = key;
+      ready_len = buf_len;
+      return;
+    }
+
+  switch (key)
+    {
+    case '\r':
+    case '\n':
+      buf[buf_len++] = '\n';
+      putchar ('\n');
+      ready_len = buf_len;
+      break;
+
+    case KEY_EOF:
+      if (buf_len == ready_len)
+        eof = true;
+      ready_len = buf_len;
+      break;
+
+    case KEY_BS:
+    case KEY_DEL:
+      if (buf_len > ready_len)
+        erase ();
+      break;
+
+    case KEY_KILL:
+      while (buf_len > ready_len)
+        erase ();
+      break;
+
+    default:
+      buf[buf_len++] = key;
+      putchar (key);
+      if (buf_len == TTY_BUF_SIZE)
+        ready_len = buf_len;
+      break;
+    }
+}
+
+/* Returns true if a key is waiting in the input buffer. */
+static bool
+key_waiting (void)
+{
+  enum intr_level old_level = intr_disable ();
+  bool waiting = !input_empty ();
+  intr_set_level (old_level);
+  return waiting;
+}
+
+/* Reads up to SIZE bytes of terminal input into BUFFER, waiting
+   until there is at least one byte to read, or a complete line
+   in cooked mode, and returns the number of bytes read.  Takes
+   every key already waiting, so that typed-ahead input is read
+   in one go and not a key at a time.  Returns 0 at end of file
+   or if SIZE is 0. */
+size_t
+tty_read (void *buffer, size_t size)
+{
+  size_t n;
+
+  if (size == 0)
+    return 0;
+
+  lock_acquire (&tty_lock);
+  while (ready_len == 0 && !eof)
+    tty_key (input_getc ());
+  while (buf_len < TTY_BUF_SIZE && key_waiting () && !eof)
+    tty_key (input_getc ());
+
+  if (ready_len == 0)
+    {
+      eof = false;
+      lock_release (&tty_lock);
+      return 0;
+    }
+
+  n = size < ready_len ? size : ready_len;
+  memcpy (buffer, buf, n);
+  memmove (buf, buf + n, buf_len - n);
+  buf_len -= n;
+  ready_len -= n;
+  lock_release (&tty_lock);
+  return n;
+}
+
+/* Returns POLLIN if tty_read() would not wait, and 0 otherwise,
+   first putting ENTRY, if nonnull, on the wait queue woken when a
+   key arrives.  Takes the keys already waiting, as tty_read()
+   would, so that in cooked mode a finished line counts. */
+int
+tty_poll (struct waitq_entry *entry)
+{
+  bool ready;
+
+  lock_acquire (&tty_lock);
+  if (entry != NULL)
+    input_waitq_add (entry);
+  while (buf_len < TTY_BUF_SIZE && key_waiting () && !eof)
+    tty_key (input_getc ());
+  ready = ready_len > 0 || eof;
+  lock_release (&tty_lock);
+  return ready ? POLLIN : 0;
+}
+
+/* Switches terminal input to cooked mode if COOKED is true, raw
+   mode otherwise, and returns whether it was in cooked mode.
+   Anything on a line being edited becomes readable at once. */
+bool
+tty_set_cooked (bool cooked)
+{
+  bool was_cooked;
+
+  lock_acquire (&tty_lock);
+  was_cooked = cooked_mode;
+  cooked_mode = cooked;
+  ready_len = buf_len;
+  lock_release (&tty_lock);
+  return was_cooked;
+}
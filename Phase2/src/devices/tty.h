@@ -0,0 +1,14 @@
+#ifndef DEVICES_TTY_H
+#define DEVICES_TTY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct waitq_entry;
+
+void tty_init (void);
+size_t tty_read (void *buffer, size_t size);
+int tty_poll (struct waitq_entry *);
+bool tty_set_cooked (bool cooked);
+
+#endif /* devices/tty.h */
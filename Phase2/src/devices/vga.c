@@ -26,13 +26,44 @@ static size_t cx, cy;
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+/* Shadow of the screen, in ordinary memory, that output is
+   written to.  vga_putbuf() copies what changed to the
+   framebuffer once per call, and moves the hardware cursor once,
+   instead of touching the hardware for every character.  Its
+   rows form a ring: screen row Y is shadow row (TOP + Y) %
+   ROW_CNT, so that scrolling moves TOP rather than the whole
+   screen. */
+typedef uint8_t cell[2];
+static cell shadow[ROW_CNT][COL_CNT];
+static size_t top;
+
+/* Columns of each screen row changed since the last flush(),
+   from dirty_lo up to but not including dirty_hi.  Clean rows
+   have dirty_lo >= dirty_hi. */
+static uint8_t dirty_lo[ROW_CNT], dirty_hi[ROW_CNT];
+
+/* Has the cursor moved since the last flush()? */
+static bool cursor_dirty;
+
+static void put (int c, enum intr_level *old_level);
 static void clear_row (size_t y);
 static void cls (void);
 static void newline (void);
+static void mark (size_t y, size_t x0, size_t x1);
+static void flush (void);
 static void move_cursor (void);
 static void find_cursor (size_t *x, size_t *y);
 
-/* Initializes the VGA text display. */
+/* Returns screen row Y of the shadow, an array of COL_CNT
+   character and attribute pairs. */
+static cell *
+row (size_t y)
+{
+  return shadow[(top + y) % ROW_CNT];
+}
+
+/* Initializes the VGA text display, starting the shadow off as a
+   copy of what the BIOS left on the screen. */
 static void
 init (void)
 {
@@ -40,7 +71,12 @@ init (void)
   static bool inited;
   if (!inited)
     {
+      size_t y;
+
       fb = ptov (0xb8000);
+      memcpy (shadow, fb, sizeof shadow);
+      for (y = 0; y < ROW_CNT; y++)
+        dirty_lo[y] = COL_CNT;
       find_cursor (&cx, &cy);
       inited = true; 
     }
@@ -50,13 +86,34 @@ init (void)
    characters in the conventional ways.  */
 void
 vga_putc (int c)
+{
+  char ch = c;
+  vga_putbuf (&ch, 1);
+}
+
+/* Writes the N characters in BUFFER to the VGA text display, as
+   vga_putc() would one at a time, and then brings the screen and
+   cursor up to date. */
+void
+vga_putbuf (const char *buffer, size_t n)
 {
   /* Disable interrupts to lock out interrupt handlers
      that might write to the console. */
   enum intr_level old_level = intr_disable ();
 
   init ();
-  
+  while (n-- > 0)
+    put (*buffer++, &old_level);
+  flush ();
+
+  intr_set_level (old_level);
+}
+
+/* Writes C to the shadow.  Interrupts must be off; *OLD_LEVEL is
+   the level to go back to while beeping. */
+static void
+put (int c, enum intr_level *old_level)
+{
   switch (c) 
     {
     case '\n':
@@ -83,25 +140,22 @@ vga_putc (int c)
       break;
 
     case '\a':
-      intr_set_level (old_level);
+      intr_set_level (*old_level);
       speaker_beep ();
       intr_disable ();
       break;
       
     default:
-      fb[cy][cx][0] = c;
-      fb[cy][cx][1] = GRAY_ON_BLACK;
+      row (cy)[cx][0] = c;
+      row (cy)[cx][1] = GRAY_ON_BLACK;
+      mark (cy, cx, cx + 1);
       if (++cx >= COL_CNT)
         newline ();
       break;
     }
-
-  /* Update cursor position. */
-  move_cursor ();
-
-  intr_set_level (old_level);
+  cursor_dirty = true;
 }
-
+
 /* Clears the screen and moves the cursor to the upper left. */
 static void
 cls (void)
@@ -112,7 +166,6 @@ cls (void)
     clear_row (y);
 
   cx = cy = 0;
-  move_cursor ();
 }
 
 /* Clears row Y to spaces. */
@@ -123,9 +176,10 @@ clear_row (size_t y)
 
   for (x = 0; x < COL_CNT; x++)
     {
-      fb[y][x][0] = ' ';
-      fb[y][x][1] = GRAY_ON_BLACK;
+      row (y)[x][0] = ' ';
+      row (y)[x][1] = GRAY_ON_BLACK;
     }
+  mark (y, 0, COL_CNT);
 }
 
 /* Advances the cursor to the first column in the next line on
@@ -138,12 +192,56 @@ newline (void)
   cy++;
   if (cy >= ROW_CNT)
     {
+      size_t y;
+
       cy = ROW_CNT - 1;
-      memmove (&fb[0], &fb[1], sizeof fb[0] * (ROW_CNT - 1));
+      top = (top + 1) % ROW_CNT;
+      for (y = 0; y < ROW_CNT - 1; y++)
+        mark (y, 0, COL_CNT);
       clear_row (ROW_CNT - 1);
     }
 }
 
+/* Notes that columns X0 up to X1 of screen row Y have changed. */
+static void
+mark (size_t y, size_t x0, size_t x1) 
+{
+  if (dirty_lo[y] >= dirty_hi[y])
+    {
+      dirty_lo[y] = x0;
+      dirty_hi[y] = x1;
+    }
+  else
+    {
+      if (x0 < dirty_lo[y])
+        dirty_lo[y] = x0;
+      if (x1 > dirty_hi[y])
+        dirty_hi[y] = x1;
+    }
+}
+
+/* Copies the parts of the shadow that changed to the
+   framebuffer, and moves the hardware cursor if it moved. */
+static void
+flush (void) 
+{
+  size_t y;
+
+  for (y = 0; y < ROW_CNT; y++)
+    if (dirty_lo[y] < dirty_hi[y])
+      {
+        memcpy (&fb[y][dirty_lo[y]], &row (y)[dirty_lo[y]],
+                sizeof fb[y][0] * (dirty_hi[y] - dirty_lo[y]));
+        dirty_lo[y] = COL_CNT;
+        dirty_hi[y] = 0;
+      }
+  if (cursor_dirty)
+    {
+      move_cursor ();
+      cursor_dirty = false;
+    }
+}
+
 /* Moves the hardware cursor to (cx,cy). */
 static void
 move_cursor (void) 
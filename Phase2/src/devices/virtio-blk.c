@@ -0,0 +1,449 @@
+#include "devices/virtio-blk.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <list.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "devices/block.h"
+#include "devices/elevator.h"
+#include "devices/partition.h"
+#include "devices/pci.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Driver for virtio block devices, as QEMU and KVM provide with
+   "-drive if=virtio", through the legacy PCI interface of
+   [VIRTIO] 0.9.5.  A disk is driven through one split
+   virtqueue: a table of buffer descriptors, an "available" ring
+   on which the driver posts requests, and a "used" ring on which
+   the device hands them back.  Each request takes three
+   descriptors: a header naming the operation and sector, the
+   data, and a status byte the device writes.  Requests are
+   posted as they are submitted, as many at once as the queue has
+   room for, and the host is told with a single port write,
+   instead of the dozens of register accesses an IDE command
+   takes.  The host orders the requests itself, so there is no
+   elevator. */
+
+/* PCI IDs of a (transitional) virtio block device. */
+#define VIRTIO_VENDOR 0x1af4
+#define VIRTIO_BLK_DEVICE 0x1001
+
+/* Legacy virtio registers, at offsets from I/O BAR 0. */
+#define REG_DEVICE_FEATURES 0x00 /* Features the device offers. */
+#define REG_GUEST_FEATURES 0x04 /* Features the driver accepts. */
+#define REG_QUEUE_PFN 0x08      /* Page number of selected queue. */
+#define REG_QUEUE_SIZE 0x0c     /* Entries in selected queue. */
+#define REG_QUEUE_SELECT 0x0e   /* Selects a queue. */
+#define REG_QUEUE_NOTIFY 0x10   /* Tells the device a queue has work. */
+#define REG_STATUS 0x12         /* Device status. */
+#define REG_ISR 0x13            /* Interrupt status; reading acks. */
+#define REG_CAPACITY 0x14       /* Size in sectors, 64 bits. */
+
+/* Device status bits. */
+#define STATUS_ACK 0x01         /* Driver has found the device. */
+#define STATUS_DRIVER 0x02      /* Driver knows how to drive it. */
+#define STATUS_DRIVER_OK 0x04   /* Driver is ready. */
+#define STATUS_FAILED 0x80      /* Driver gave up. */
+
+/* Virtqueues. */
+#define VIRTQ_ALIGN 4096        /* Alignment of the used ring. */
+#define VIRTQ_DESC_F_NEXT 0x1   /* Buffer continues in NEXT. */
+#define VIRTQ_DESC_F_WRITE 0x2  /* Device writes the buffer. */
+
+/* A buffer descriptor. */
+struct virtq_desc
+  {
+    uint64_t addr;              /* Physical address. */
+    uint32_t len;               /* Length in bytes. */
+    uint16_t flags;             /* VIRTQ_DESC_F_* bits. */
+    uint16_t next;              /* Next descriptor, with F_NEXT. */
+  };
+
+/* The ring of requests posted to the device. */
+struct virtq_avail
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Entries posted, wrapping. */
+    uint16_t ring[];            /* First descriptor of each. */
+  };
+
+/* A request the device has finished. */
+struct virtq_used_elem
+  {
+    uint32_t id;                /* First descriptor of the request. */
+    uint32_t len;               /* Bytes the device wrote. */
+  };
+
+/* The ring of requests handed back by the device. */
+struct virtq_used
+  {
+    uint16_t flags;
+    uint16_t idx;               /* Entries handed back, wrapping. */
+    struct virtq_used_elem ring[];
+  };
+
+/* Block request types and statuses. */
+#define VIRTIO_BLK_T_IN 0       /* Read. */
+#define VIRTIO_BLK_T_OUT 1      /* Write. */
+#define VIRTIO_BLK_S_OK 0       /* Success. */
+
+/* The header of a block request. */
+struct virtio_blk_req
+  {
+    uint32_t type;              /* VIRTIO_BLK_T_*. */
+    uint32_t reserved;
+    uint64_t sector;            /* First sector. */
+  };
+
+/* Descriptors per request. */
+#define DESC_PER_REQ 3
+
+/* A request slot: descriptors DESC_PER_REQ * its index and the
+   two after it, and the memory the header and status take. */
+struct slot
+  {
+    struct virtio_blk_req hdr;  /* Read by the device. */
+    uint8_t status;             /* Written by the device. */
+    struct io_request *r;       /* Request in the slot, or null. */
+  };
+
+/* Most virtio disks driven. */
+#define DISK_CNT 4
+
+/* A virtio disk.  Everything below IRQ is changed only with
+   interrupts off. */
+struct disk
+  {
+    char name[8];               /* "vda", "vdb", ... */
+    uint16_t io_base;           /* Base of its registers. */
+    uint8_t irq;                /* Interrupt vector. */
+
+    uint16_t q_size;            /* Descriptors in the queue. */
+    struct virtq_desc *desc;    /* Descriptor table. */
+    struct virtq_avail *avail;  /* Available ring. */
+    volatile struct virtq_used *used;   /* Used ring. */
+    uint16_t used_idx;          /* Used entries seen so far. */
+
+    struct slot *slots;         /* SLOT_CNT request slots. */
+    size_t slot_cnt;
+    uint16_t *free_slots;       /* Stack of unused slots. */
+    size_t free_cnt;
+    struct list waiting;        /* Submitted, waiting for a slot. */
+  };
+
+static struct disk disks[DISK_CNT];
+static size_t disk_cnt;
+
+static struct block_operations virtio_operations;
+
+static bool init_disk (struct disk *, struct pci_addr);
+static void post_waiting (struct disk *);
+static void post (struct disk *, struct io_request *);
+static intr_handler_func interrupt_handler;
+
+/* Finds and initializes the virtio disks, registering each as a
+   block device. */
+void
+virtio_blk_init (void) 
+{
+  struct pci_addr a;
+  unsigned idx;
+
+  for (idx = 0; disk_cnt < DISK_CNT
+         && pci_find_device (VIRTIO_VENDOR, VIRTIO_BLK_DEVICE, idx, &a);
+       idx++)
+    {
+      struct disk *d = &disks[disk_cnt];
+      uint64_t capacity;
+      size_t i;
+
+      snprintf (d->name, sizeof d->name, "vd%c", (int) ('a' + disk_cnt));
+      if (!init_disk (d, a))
+        continue;
+
+      /* Share the handler with disks on the same line. */
+      for (i = 0; i < disk_cnt; i++)
+        if (disks[i].irq == d->irq)
+          break;
+      if (i == disk_cnt)
+        intr_register_ext (d->irq, interrupt_handler, d->name);
+      disk_cnt++;
+
+      capacity = inl (d->io_base + REG_CAPACITY)
+                 | (uint64_t) inl (d->io_base + REG_CAPACITY + 4) << 32;
+      if (capacity > UINT32_MAX)
+        capacity = UINT32_MAX;
+      partition_scan (block_register (d->name, BLOCK_RAW, "virtio",
+                                      capacity, &virtio_operations, d));
+    }
+}
+
+/* Resets the virtio block device at A and sets it up as disk D.
+   Returns true if successful, false on failure. */
+static bool
+init_disk (struct disk *d, struct pci_addr a) 
+{
+  uint32_t bar = pci_read_config (a, PCI_REG_BAR0);
+  uint8_t line = pci_read_config (a, PCI_REG_INTR) & 0xff;
+  size_t avail_ofs, used_ofs, q_bytes;
+  uint8_t *q;
+  size_t i;
+
+  if (!(bar & PCI_BAR_IO) || line >= 16)
+    {
+      printf ("%s: no I/O ports or interrupt line\n", d->name);
+      return false;
+    }
+  d->io_base = bar & PCI_BAR_IO_MASK;
+  d->irq = 0x20 + line;
+  pci_write_config (a, PCI_REG_COMMAND,
+                    (pci_read_config (a, PCI_REG_COMMAND) & 0xffff)
+                    | PCI_CMD_IO | PCI_CMD_MASTER);
+
+  /* Reset, and say that we have found it and can drive it.  None
+     of the optional features is needed. */
+  outb (d->io_base + REG_STATUS, 0);
+  outb (d->io_base + REG_STATUS, STATUS_ACK);
+  outb (d->io_base + REG_STATUS, STATUS_ACK | STATUS_DRIVER);
+  outl (d->io_base + REG_GUEST_FEATURES, 0);
+
+  /* Lay out queue 0 as legacy virtio requires: the descriptor
+     table, then the available ring, then the used ring on the
+     next VIRTQ_ALIGN boundary, all in physically contiguous
+     pages, as kernel pages are. */
+  outw (d->io_base + REG_QUEUE_SELECT, 0);
+  d->q_size = inw (d->io_base + REG_QUEUE_SIZE);
+  avail_ofs = sizeof *d->desc * d->q_size;
+  used_ofs = ROUND_UP (avail_ofs + sizeof *d->avail
+                       + sizeof *d->avail->ring * (d->q_size + 1),
+                       VIRTQ_ALIGN);
+  q_bytes = ROUND_UP (used_ofs + sizeof *d->used
+                      + sizeof *d->used->ring * d->q_size
+                      + sizeof (uint16_t), PGSIZE);
+  q = d->q_size >= DESC_PER_REQ
+      ? palloc_get_contiguous (PAL_ZERO, q_bytes / PGSIZE) : NULL;
+  d->slot_cnt = d->q_size / DESC_PER_REQ;
+  d->slots = calloc (d->slot_cnt, sizeof *d->slots);
+  d->free_slots = calloc (d->slot_cnt, sizeof *d->free_slots);
+  if (q == NULL || d->slots == NULL || d->free_slots == NULL)
+    {
+      printf ("%s: cannot set up queue of %"PRIu16" entries\n",
+              d->name, d->q_size);
+      outb (d->io_base + REG_STATUS, STATUS_FAILED);
+      if (q != NULL)
+        palloc_free_multiple (q, q_bytes / PGSIZE);
+      free (d->slots);
+      free (d->free_slots);
+      return false;
+    }
+  d->desc = (struct virtq_desc *) q;
+  d->avail = (struct virtq_avail *) (q + avail_ofs);
+  d->used = (volatile struct virtq_used *) (q + used_ofs);
+  d->used_idx = 0;
+  list_init (&d->waiting);
+
+  /* Each slot's header and status descriptors never change. */
+  for (i = 0; i < d->slot_cnt; i++)
+    {
+      struct virtq_desc *desc = &d->desc[i * DESC_PER_REQ];
+
+      desc[0].addr = vtop (&d->slots[i].hdr);
+      desc[0].len = sizeof d->slots[i].hdr;
+      desc[0].flags = VIRTQ_DESC_F_NEXT;
+      desc[0].next = i * DESC_PER_REQ + 1;
+      desc[1].next = i * DESC_PER_REQ + 2;
+      desc[2].addr = vtop (&d->slots[i].status);
+      desc[2].len = sizeof d->slots[i].status;
+      desc[2].flags = VIRTQ_DESC_F_WRITE;
+      d->free_slots[i] = d->slot_cnt - 1 - i;
+    }
+  d->free_cnt = d->slot_cnt;
+
+  outl (d->io_base + REG_QUEUE_PFN, vtop (q) / PGSIZE);
+  outb (d->io_base + REG_STATUS,
+        STATUS_ACK | STATUS_DRIVER | STATUS_DRIVER_OK);
+  return true;
+}
+
+/* Puts request R, for disk D, in a free slot and on the
+   available ring.  The device is not told; the caller does that
+   once for everything it posts.  Interrupts must be off. */
+static void
+post (struct disk *d, struct io_request *r) 
+{
+  uint16_t s;
+  struct slot *slot;
+  struct virtq_desc *desc;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (d->free_cnt > 0);
+
+  s = d->free_slots[--d->free_cnt];
+  slot = &d->slots[s];
+  slot->hdr.type = r->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+  slot->hdr.reserved = 0;
+  slot->hdr.sector = r->sector;
+  slot->status = 0xff;
+  slot->r = r;
+
+  desc = &d->desc[s * DESC_PER_REQ];
+  desc[1].addr = vtop (r->buffer);
+  desc[1].len = r->cnt * BLOCK_SECTOR_SIZE;
+  desc[1].flags = VIRTQ_DESC_F_NEXT | (r->write ? 0 : VIRTQ_DESC_F_WRITE);
+
+  /* The entry must be written before the index that covers it. */
+  d->avail->ring[d->avail->idx % d->q_size] = s * DESC_PER_REQ;
+  barrier ();
+  d->avail->idx++;
+}
+
+/* Posts as many of disk D's waiting requests as there are free
+   slots for, and tells the device if there were any.
+   Interrupts must be off. */
+static void
+post_waiting (struct disk *d) 
+{
+  bool posted = false;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (d->free_cnt > 0 && !list_empty (&d->waiting))
+    {
+      post (d, list_entry (list_pop_front (&d->waiting),
+                           struct io_request, elem));
+      posted = true;
+    }
+  if (posted)
+    {
+      barrier ();
+      outw (d->io_base + REG_QUEUE_NOTIFY, 0);
+    }
+}
+
+/* Queues request R on disk D and returns without waiting for it.
+   It is posted to the device at once if the queue has room. */
+static void
+virtio_submit (void *d_, struct io_request *r) 
+{
+  struct disk *d = d_;
+  enum intr_level old_level;
+
+  r->next = NULL;
+  r->total_cnt = r->cnt;
+  old_level = intr_disable ();
+  list_push_back (&d->waiting, &r->elem);
+  post_waiting (d);
+  intr_set_level (old_level);
+}
+
+/* Moves CNT sectors starting at SEC_NO between disk D and
+   BUFFER, writing to D if WRITE is true and otherwise reading
+   from it, and returns once the transfer is complete. */
+static void
+transfer (struct disk *d, block_sector_t sec_no, size_t cnt, void *buffer,
+          bool write)
+{
+  while (cnt > 0)
+    {
+      size_t n = cnt < BLOCK_SUBMIT_MAX ? cnt : BLOCK_SUBMIT_MAX;
+      struct semaphore done;
+      struct io_request r;
+
+      sema_init (&done, 0);
+      r.write = write;
+      r.sector = sec_no;
+      r.cnt = n;
+      r.buffer = buffer;
+      r.done = block_wake_sema;
+      r.aux = &done;
+      virtio_submit (d, &r);
+      sema_down (&done);
+
+      sec_no += n;
+      cnt -= n;
+      buffer = (uint8_t *) buffer + n * BLOCK_SECTOR_SIZE;
+    }
+}
+
+/* Reads sector SEC_NO from disk D into BUFFER. */
+static void
+virtio_read (void *d, block_sector_t sec_no, void *buffer)
+{
+  transfer (d, sec_no, 1, buffer, false);
+}
+
+/* Writes sector SEC_NO to disk D from BUFFER. */
+static void
+virtio_write (void *d, block_sector_t sec_no, const void *buffer)
+{
+  transfer (d, sec_no, 1, (void *) buffer, true);
+}
+
+/* Reads CNT sectors starting at SEC_NO from disk D into
+   BUFFER. */
+static void
+virtio_read_multi (void *d, block_sector_t sec_no, size_t cnt,
+                   void *buffer)
+{
+  transfer (d, sec_no, cnt, buffer, false);
+}
+
+/* Writes CNT sectors starting at SEC_NO to disk D from
+   BUFFER. */
+static void
+virtio_write_multi (void *d, block_sector_t sec_no, size_t cnt,
+                    const void *buffer)
+{
+  transfer (d, sec_no, cnt, (void *) buffer, true);
+}
+
+static struct block_operations virtio_operations =
+  {
+    virtio_read,
+    virtio_write,
+    virtio_read_multi,
+    virtio_write_multi,
+    virtio_submit
+  };
+
+/* Virtio interrupt handler.  Takes back every request the
+   devices on this line have finished, hands them to the block
+   layer to complete, and refills the freed slots. */
+static void
+interrupt_handler (struct intr_frame *f) 
+{
+  size_t i;
+
+  for (i = 0; i < disk_cnt; i++)
+    {
+      struct disk *d = &disks[i];
+
+      if (d->irq != f->vec_no || inb (d->io_base + REG_ISR) == 0)
+        continue;
+
+      while (d->used_idx != d->used->idx)
+        {
+          uint32_t id;
+          struct slot *slot;
+
+          /* Read the entry only after the index that covers it. */
+          barrier ();
+          id = d->used->ring[d->used_idx % d->q_size].id;
+          slot = &d->slots[id / DESC_PER_REQ];
+          if (slot->status != VIRTIO_BLK_S_OK)
+            PANIC ("%s: disk %s failed, sector=%"PRDSNu, d->name,
+                   slot->r->write ? "write" : "read", slot->r->sector);
+          block_complete (slot->r);
+          slot->r = NULL;
+          d->free_slots[d->free_cnt++] = id / DESC_PER_REQ;
+          d->used_idx++;
+        }
+      post_waiting (d);
+    }
+}
@@ -37,18 +37,23 @@ main (int argc, char *argv[])
       return EXIT_FAILURE;
     }
 
-  /* Copy data. */
+  /* Copy data, inside the kernel.  copy() returns 0 both at end
+     of file and when NEW cannot grow, so check how far it got. */
   for (;;) 
     {
-      char buffer[1024];
-      int bytes_read = read (in_fd, buffer, sizeof buffer);
-      if (bytes_read == 0)
-        break;
-      if (write (out_fd, buffer, bytes_read) != bytes_read) 
+      int bytes_copied = copy (out_fd, in_fd, 65536);
+      if (bytes_copied < 0) 
         {
-          printf ("%s: write failed\n", argv[2]);
+          printf ("%s: copy failed\n", argv[2]);
           return EXIT_FAILURE;
         }
+      if (bytes_copied == 0)
+        break;
+    }
+  if (tell (in_fd) != (unsigned) filesize (in_fd)) 
+    {
+      printf ("%s: write failed\n", argv[2]);
+      return EXIT_FAILURE;
     }
 
   return EXIT_SUCCESS;
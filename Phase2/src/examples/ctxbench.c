@@ -0,0 +1,110 @@
+/* ctxbench.c
+
+   Measures what context switches cost a process in TLB misses.
+
+   Sweeps a working set of WS_PAGES pages, touching one byte per
+   page, ROUNDS times, and times each sweep with the CPU's
+   time-stamp counter.  Most sweeps run without interruption; the
+   ones that straddle a context switch also pay for refilling the
+   TLB if the switch reloaded CR3.  Prints the fastest and the
+   average sweep and how many sweeps took more than twice as long
+   as the fastest.
+
+   "ctxbench" runs alone, so it switches only with kernel threads
+   such as the idle thread.  "ctxbench N" first starts N copies
+   of "ctxbench spin" to compete for the CPU, so that it also
+   switches with other processes. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+#define PAGE_SIZE 4096
+#define WS_PAGES 64             /* Pages in the working set. */
+#define ROUNDS 20000            /* Sweeps to time. */
+#define SPIN_CNT 50000000       /* Loop iterations for a spinner. */
+#define MAX_SPINNERS 8
+
+static char ws[WS_PAGES][PAGE_SIZE];
+
+/* Returns the time-stamp counter. */
+static unsigned long long
+rdtsc (void)
+{
+  unsigned int lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long) hi << 32) | lo;
+}
+
+/* Touches one byte of each page of the working set. */
+static void
+sweep (void)
+{
+  int i;
+
+  for (i = 0; i < WS_PAGES; i++)
+    ((volatile char *) ws[i])[0]++;
+}
+
+int
+main (int argc, char *argv[])
+{
+  pid_t spinners[MAX_SPINNERS];
+  int spinner_cnt = 0;
+  unsigned long long min = (unsigned long long) -1, total = 0;
+  int slow = 0;
+  int i;
+
+  if (argc == 2 && !strcmp (argv[1], "spin"))
+    {
+      volatile int n;
+      for (n = 0; n < SPIN_CNT; n++)
+        continue;
+      return EXIT_SUCCESS;
+    }
+
+  if (argc == 2)
+    spinner_cnt = atoi (argv[1]);
+  if (argc > 2 || spinner_cnt < 0 || spinner_cnt > MAX_SPINNERS)
+    {
+      printf ("usage: ctxbench [SPINNERS]\n");
+      return EXIT_FAILURE;
+    }
+  for (i = 0; i < spinner_cnt; i++)
+    spinners[i] = exec ("ctxbench spin");
+
+  /* Fault the working set in before timing anything. */
+  sweep ();
+
+  for (i = 0; i < ROUNDS; i++)
+    {
+      unsigned long long start = rdtsc ();
+      unsigned long long cycles;
+
+      sweep ();
+      cycles = rdtsc () - start;
+      total += cycles;
+      if (cycles < min)
+        min = cycles;
+    }
+
+  /* Count the slow sweeps in a second pass, once the fastest is
+     known. */
+  for (i = 0; i < ROUNDS; i++)
+    {
+      unsigned long long start = rdtsc ();
+
+      sweep ();
+      if (rdtsc () - start > 2 * min)
+        slow++;
+    }
+
+  printf ("ctxbench: %d spinners, %d pages: fastest %llu cycles, "
+          "average %llu cycles, %d of %d sweeps slow\n",
+          spinner_cnt, WS_PAGES, min, total / ROUNDS, slow, ROUNDS);
+
+  for (i = 0; i < spinner_cnt; i++)
+    wait (spinners[i]);
+  return EXIT_SUCCESS;
+}
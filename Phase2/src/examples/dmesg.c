@@ -0,0 +1,24 @@
+/* dmesg.c
+
+   Prints the kernel log, with each line's level and the time it
+   was written, as the klog system call reads it.  The whole log
+   is read before any of it is printed, since what this program
+   prints goes into the log too. */
+
+#include <stdio.h>
+#include <syscall.h>
+
+int
+main (void)
+{
+  static char buffer[32768];
+  unsigned seq = 0;
+  size_t total = 0;
+  int n;
+
+  while (total < sizeof buffer
+         && (n = klog (&seq, buffer + total, sizeof buffer - total)) > 0)
+    total += n;
+  write (STDOUT_FILENO, buffer, total);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,42 @@
+/* free.c
+
+   Reports kernel memory usage, as returned by memstat(), in
+   pages and bytes.  "free -v" also has the kernel print its full
+   palloc and malloc report, with the call sites holding the most
+   pages, on the console.  Running it before and after a workload
+   shows whether the workload leaked kernel memory, and the user
+   pool's peak shows what -ul limit the workload would fit in. */
+
+#include <memstat.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+#define PAGE_SIZE 4096
+
+int
+main (int argc, char *argv[]) 
+{
+  struct memstat m;
+  unsigned arena_bytes;
+
+  if (argc > 1 && !strcmp (argv[1], "-v"))
+    memstat (NULL);
+
+  memstat (&m);
+  printf ("%-8s %8s %8s %8s %8s\n", "POOL", "PAGES", "USED", "PEAK", "FREE");
+  printf ("%-8s %8u %8u %8u %8u\n", "kernel",
+          m.kernel_pages, m.kernel_used, m.kernel_peak,
+          m.kernel_pages - m.kernel_used);
+  printf ("%-8s %8u %8u %8u %8u\n", "user",
+          m.user_pages, m.user_used, m.user_peak,
+          m.user_pages - m.user_used);
+
+  arena_bytes = m.malloc_arenas * PAGE_SIZE;
+  printf ("malloc: %u arena pages, %u bytes live (%u%% of arenas), "
+          "%u big block pages\n",
+          m.malloc_arenas, m.malloc_live,
+          arena_bytes > 0 ? m.malloc_live / (arena_bytes / 100) : 0,
+          m.malloc_big_pages);
+  return EXIT_SUCCESS;
+}
@@ -9,9 +9,34 @@
    each file is also printed.  This won't work until project 4. */
 
 #include <syscall.h>
+#include <dirent.h>
 #include <stdio.h>
 #include <string.h>
 
+/* Prints each entry of the directory open as DIR_FD with its
+   type, size, and inumber, a batch at a time. */
+static void
+list_entries (int dir_fd) 
+{
+  struct dirent_plus entries[16];
+  int cnt;
+
+  while ((cnt = readdir_plus (dir_fd, entries, 16)) > 0) 
+    {
+      int i;
+
+      for (i = 0; i < cnt; i++) 
+        {
+          printf ("%s: ", entries[i].name);
+          if (entries[i].is_dir)
+            printf ("directory");
+          else
+            printf ("%d-byte file", entries[i].size);
+          printf (", inumber %d\n", entries[i].inumber);
+        }
+    }
+}
+
 static bool
 list_dir (const char *dir, bool verbose) 
 {
@@ -31,32 +56,11 @@ list_dir (const char *dir, bool verbose)
         printf (" (inumber %d)", inumber (dir_fd));
       printf (":\n");
 
-      while (readdir (dir_fd, name)) 
-        {
-          printf ("%s", name); 
-          if (verbose) 
-            {
-              char full_name[128];
-              int entry_fd;
-
-              snprintf (full_name, sizeof full_name, "%s/%s", dir, name);
-              entry_fd = open (full_name);
-
-              printf (": ");
-              if (entry_fd != -1)
-                {
-                  if (isdir (entry_fd))
-                    printf ("directory");
-                  else
-                    printf ("%d-byte file", filesize (entry_fd));
-                  printf (", inumber %d", inumber (entry_fd));
-                }
-              else
-                printf ("open failed");
-              close (entry_fd);
-            }
-          printf ("\n");
-        }
+      if (verbose)
+        list_entries (dir_fd);
+      else
+        while (readdir (dir_fd, name)) 
+          printf ("%s\n", name);
     }
   else 
     printf ("%s: not a directory\n", dir);
@@ -0,0 +1,13 @@
+/* nop.c
+
+   Exits as soon as it starts.  Used by ubench to time exec and
+   wait with a program no bigger than halt that, unlike halt,
+   leaves the machine running. */
+
+#include <syscall.h>
+
+int
+main (void)
+{
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,43 @@
+/* ps.c
+
+   Lists every thread in the system with the CPU time it has used
+   and how it has been scheduled, as reported by getrusage().
+   Times are in timer ticks.  "VOL" counts switches away because
+   the thread blocked or exited, "INVOL" those while it could
+   still run, and "LOCK" the ticks it spent waiting for locks. */
+
+#include <rusage.h>
+#include <stdio.h>
+#include <syscall.h>
+
+#define MAX_THREADS 64
+
+static struct rusage usage[MAX_THREADS];
+
+int
+main (void) 
+{
+  int cnt = getrusage (RUSAGE_ALL, usage, MAX_THREADS);
+  int i;
+
+  if (cnt < 0)
+    {
+      printf ("ps: getrusage failed\n");
+      return EXIT_FAILURE;
+    }
+
+  printf ("%5s %-15s %6s %6s %6s %6s %6s %6s %6s\n",
+          "TID", "NAME", "USER", "SYS", "VOL", "INVOL", "LOCK", "FAULTS",
+          "MAJOR");
+  for (i = 0; i < cnt && i < MAX_THREADS; i++) 
+    {
+      const struct rusage *u = &usage[i];
+      printf ("%5d %-15s %6u %6u %6u %6u %6u %6u %6u\n",
+              u->tid, u->name, u->user_ticks, u->kernel_ticks,
+              u->voluntary_switches, u->involuntary_switches,
+              u->lock_wait_ticks, u->page_faults, u->faults[FAULT_MAJOR]);
+    }
+  if (cnt > MAX_THREADS)
+    printf ("(%d more threads not shown)\n", cnt - MAX_THREADS);
+  return EXIT_SUCCESS;
+}
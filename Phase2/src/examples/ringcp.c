@@ -0,0 +1,122 @@
+/* ringcp.c
+
+   Copies one file to another, like cp, but through the system
+   call rings: each round queues BATCH reads, makes them with one
+   submit, then queues a write for each block read and makes
+   those with another, so that copying BATCH blocks crosses into
+   the kernel twice instead of 2 * BATCH times. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include <syscall-ring.h>
+
+#define BLOCK_SIZE 1024         /* Bytes per read or write. */
+#define BATCH 16                /* Blocks per round. */
+
+static struct ring_sq sq __attribute__ ((aligned (RING_SIZE)));
+static struct ring_cq cq __attribute__ ((aligned (RING_SIZE)));
+static char buffers[BATCH][BLOCK_SIZE];
+
+/* Queues OP on FD with BUFFER and SIZE, tagged with USER_DATA. */
+static void
+queue (enum ring_op op, int fd, void *buffer, unsigned size,
+       unsigned user_data)
+{
+  struct ring_sqe *e = &sq.entries[sq.tail % RING_SQ_ENTRIES];
+
+  e->op = op;
+  e->fd = fd;
+  e->buffer = buffer;
+  e->size = size;
+  e->user_data = user_data;
+  sq.tail++;
+}
+
+/* Takes the next completion off the ring and returns its result,
+   storing its user data in *USER_DATA. */
+static int
+reap (unsigned *user_data)
+{
+  struct ring_cqe *c = &cq.entries[cq.head % RING_CQ_ENTRIES];
+
+  *user_data = c->user_data;
+  cq.head++;
+  return c->result;
+}
+
+int
+main (int argc, char *argv[]) 
+{
+  int in_fd, out_fd;
+
+  if (argc != 3) 
+    {
+      printf ("usage: ringcp OLD NEW\n");
+      return EXIT_FAILURE;
+    }
+  if (!ring_setup (&sq, &cq))
+    {
+      printf ("ringcp: ring_setup failed\n");
+      return EXIT_FAILURE;
+    }
+
+  /* Open input file. */
+  in_fd = open (argv[1]);
+  if (in_fd < 0) 
+    {
+      printf ("%s: open failed\n", argv[1]);
+      return EXIT_FAILURE;
+    }
+
+  /* Create and open output file. */
+  if (!create (argv[2], filesize (in_fd))) 
+    {
+      printf ("%s: create failed\n", argv[2]);
+      return EXIT_FAILURE;
+    }
+  out_fd = open (argv[2]);
+  if (out_fd < 0) 
+    {
+      printf ("%s: open failed\n", argv[2]);
+      return EXIT_FAILURE;
+    }
+
+  /* Copy data. */
+  for (;;) 
+    {
+      int lengths[BATCH];
+      int writes = 0, done, i;
+      unsigned id;
+
+      for (i = 0; i < BATCH; i++)
+        queue (RING_READ, in_fd, buffers[i], BLOCK_SIZE, i);
+      done = submit ();
+      for (i = 0; i < done; i++)
+        {
+          int bytes_read = reap (&id);
+          lengths[id] = bytes_read;
+          if (bytes_read > 0)
+            {
+              queue (RING_WRITE, out_fd, buffers[id], bytes_read, id);
+              writes++;
+            }
+        }
+      if (writes == 0)
+        break;
+
+      done = submit ();
+      for (i = 0; i < done; i++)
+        {
+          int bytes_written = reap (&id);
+          if (bytes_written != lengths[id])
+            {
+              printf ("%s: write failed\n", argv[2]);
+              return EXIT_FAILURE;
+            }
+        }
+      if (writes < BATCH)
+        break;
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+/* scbench.c
+
+   Measures the round trip of a system call that does almost no
+   work, entered through int $0x30 and through SYSENTER.
+
+   Each way calls tell on a file descriptor that is not open,
+   CALLS times, and times the loop with the CPU's time-stamp
+   counter.  Prints the average cycles per call for each.  The
+   SYSENTER loop is skipped if CPUID says the CPU does not have
+   it, since the kernel does not set it up then either. */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <syscall.h>
+#include <syscall-nr.h>
+
+#define CALLS 100000            /* Calls to time each way. */
+#define BAD_FD 1000             /* File descriptor that is not open. */
+
+/* CPUID leaf 1 feature flag in EDX for SYSENTER and SYSEXIT. */
+#define CPUID_SEP (1u << 11)
+
+/* Returns the time-stamp counter. */
+static unsigned long long
+rdtsc (void)
+{
+  unsigned int lo, hi;
+  asm volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+  return ((unsigned long long) hi << 32) | lo;
+}
+
+/* Returns true if the CPU has SYSENTER. */
+static bool
+have_sysenter (void)
+{
+  unsigned int eax, ebx, ecx, edx;
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (1));
+  return (edx & CPUID_SEP) != 0;
+}
+
+/* Calls tell (BAD_FD) through int $0x30. */
+static int
+tell_int (void)
+{
+  int retval;
+  asm volatile ("pushl %[fd]; pushl %[number]; int $0x30; addl $8, %%esp"
+                : "=a" (retval)
+                : [number] "i" (SYS_TELL), [fd] "i" (BAD_FD)
+                : "memory");
+  return retval;
+}
+
+/* Calls tell (BAD_FD) through SYSENTER. */
+static int
+tell_sysenter (void)
+{
+  int retval;
+  asm volatile ("pushl %[fd]; pushl %[number]; "
+                "movl %%esp, %%ecx; movl $1f, %%edx; sysenter; "
+                "1: addl $8, %%esp"
+                : "=a" (retval)
+                : [number] "i" (SYS_TELL), [fd] "i" (BAD_FD)
+                : "ecx", "edx", "memory");
+  return retval;
+}
+
+/* Returns the average cycles one call to CALL takes. */
+static unsigned long long
+time_calls (int (*call) (void))
+{
+  unsigned long long start;
+  int i;
+
+  call ();
+  start = rdtsc ();
+  for (i = 0; i < CALLS; i++)
+    call ();
+  return (rdtsc () - start) / CALLS;
+}
+
+int
+main (void)
+{
+  printf ("scbench: int $0x30: %llu cycles per call\n",
+          time_calls (tell_int));
+  if (have_sysenter ())
+    printf ("scbench: sysenter: %llu cycles per call\n",
+            time_calls (tell_sysenter));
+  else
+    printf ("scbench: sysenter: not supported by this CPU\n");
+  return EXIT_SUCCESS;
+}
@@ -1,10 +1,15 @@
+#include <spawn.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <syscall.h>
 
+/* Most commands in a pipeline. */
+#define STAGE_MAX 8
+
 static void read_line (char line[], size_t);
 static bool backspace (char **pos, char line[]);
+static void run_pipeline (char *command);
 
 int
 main (void)
@@ -30,6 +35,8 @@ main (void)
         {
           /* Empty command. */
         }
+      else if (strchr (command, '|') != NULL)
+        run_pipeline (command);
       else
         {
           pid_t pid = exec (command);
@@ -44,6 +51,78 @@ main (void)
   return EXIT_SUCCESS;
 }
 
+/* Runs the commands in COMMAND, separated by `|', each with its
+   stdout connected to the next one's stdin by a pipe, and waits
+   for all of them.  Each command is started by a single
+   spawn_fds() that hands it the pipes on either side, so the
+   shell's own stdin and stdout stay on the console throughout,
+   and the shell then closes its ends of them. */
+static void
+run_pipeline (char *command)
+{
+  char *stages[STAGE_MAX];
+  pid_t pids[STAGE_MAX];
+  int stage_cnt = 0;
+  int prev_read = -1;
+  char *stage, *save_ptr;
+  int i;
+
+  for (stage = strtok_r (command, "|", &save_ptr); stage != NULL;
+       stage = strtok_r (NULL, "|", &save_ptr))
+    {
+      if (stage_cnt == STAGE_MAX)
+        {
+          printf ("too many commands in pipeline\n");
+          return;
+        }
+      stages[stage_cnt++] = stage;
+    }
+
+  for (i = 0; i < stage_cnt; i++)
+    {
+      struct spawn_fd map[2];
+      int map_cnt = 0;
+      int fds[2];
+      bool last = i == stage_cnt - 1;
+
+      if (!last && pipe (fds) < 0)
+        {
+          printf ("pipe failed\n");
+          break;
+        }
+      if (prev_read >= 0)
+        {
+          map[map_cnt].to = STDIN_FILENO;
+          map[map_cnt++].from = prev_read;
+        }
+      if (!last)
+        {
+          map[map_cnt].to = STDOUT_FILENO;
+          map[map_cnt++].from = fds[1];
+        }
+
+      pids[i] = spawn_fds (stages[i], map, map_cnt);
+
+      if (prev_read >= 0)
+        close (prev_read);
+      prev_read = -1;
+      if (!last)
+        {
+          close (fds[1]);
+          prev_read = fds[0];
+        }
+      if (pids[i] == PID_ERROR)
+        printf ("\"%s\": spawn failed\n", stages[i]);
+    }
+  if (i < stage_cnt && prev_read >= 0)
+    close (prev_read);
+
+  stage_cnt = i;
+  for (i = 0; i < stage_cnt; i++)
+    if (pids[i] != PID_ERROR)
+      printf ("\"%s\": exit code %d\n", stages[i], wait (pids[i]));
+}
+
 /* Reads a line of input from the user into LINE, which has room
    for SIZE bytes.  Handles backspace and Ctrl+U in the ways
    expected by Unix users.  On return, LINE will always be
@@ -0,0 +1,49 @@
+/* top.c
+
+   Lists every thread with its state, priority and CPU time, and
+   the processor it last ran on and how long ago it stopped,
+   again and again, as the threadinfo system call reports them.
+   Takes the seconds between listings, 1 by default, and how many
+   to print, 10 by default.  threadinfo() leaves interrupts on,
+   so polling often does not hold up the threads being watched.
+   Times are in timer ticks. */
+
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+#include <threadinfo.h>
+
+static struct threadinfo info[THREADINFO_MAX];
+
+int
+main (int argc, char *argv[]) 
+{
+  static const char *states[] = {"run", "ready", "block", "dying"};
+  int seconds = argc > 1 ? atoi (argv[1]) : 1;
+  int count = argc > 2 ? atoi (argv[2]) : 10;
+  int round;
+
+  for (round = 0; round < count; round++)
+    {
+      int cnt, i, now;
+
+      if (round > 0)
+        poll (NULL, 0, seconds * 1000);
+      cnt = threadinfo (info, THREADINFO_MAX);
+      now = uptime ();
+      printf ("%5s %-15s %-5s %4s %6s %6s %3s %6s\n",
+              "TID", "NAME", "STATE", "PRI", "USER", "SYS", "CPU", "OFF");
+      for (i = 0; i < cnt && i < THREADINFO_MAX; i++) 
+        {
+          const struct threadinfo *t = &info[i];
+          unsigned off = (t->status == THREADINFO_RUNNING
+                          ? 0 : (unsigned) now - t->last_ran);
+          printf ("%5d %-15s %-5s %4d %6u %6u %3d %6u\n",
+                  t->tid, t->name, states[t->status], t->priority,
+                  t->user_ticks, t->kernel_ticks, t->cpu, off);
+        }
+      printf ("\n");
+    }
+  return EXIT_SUCCESS;
+}
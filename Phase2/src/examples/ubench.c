@@ -0,0 +1,219 @@
+/* ubench.c
+
+   Measures what crossing the user/kernel boundary costs.
+
+   Times, with the kernel's time-stamp counter (cycles()) and the
+   clock page (clock_gettime(), which takes no system call):
+     - a null system call, tell on a file descriptor that is not
+       open;
+     - read and write of 1 byte and of 4 kB to a scratch file;
+     - open and close of that file;
+     - exec and wait of "nop", which exits at once;
+     - the first touch of fresh pages, which page faults when the
+       kernel loads or zero-fills pages lazily, against a second
+       touch that does not.
+   Prints one line per measurement with the average cycles per
+   operation and the total microseconds.  "ubench NAME..." runs only the
+   named measurements: null, rw, open, exec, fault. */
+
+#include <clock.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+#define BAD_FD 1000             /* File descriptor that is not open. */
+#define TMP_FILE "ubench.tmp"   /* Scratch file. */
+#define PAGE_SIZE 4096
+#define FAULT_PAGES 64          /* Pages touched by the fault test. */
+
+static char buf[4096];
+static char fault_pages[FAULT_PAGES][PAGE_SIZE];
+
+/* Start of the measurement in progress. */
+static unsigned long long start_cycles;
+static struct timespec start_time;
+
+static void
+start (void)
+{
+  clock_gettime (CLOCK_MONOTONIC, &start_time);
+  start_cycles = cycles ();
+}
+
+/* Ends the measurement started by start(), which did OPS
+   operations, and prints the result as WHAT. */
+static void
+report (const char *what, int ops)
+{
+  unsigned long long elapsed = cycles () - start_cycles;
+  struct timespec end_time;
+  long long us;
+
+  clock_gettime (CLOCK_MONOTONIC, &end_time);
+  us = ((end_time.tv_sec - start_time.tv_sec) * 1000000
+        + (end_time.tv_nsec - start_time.tv_nsec) / 1000);
+
+  printf ("ubench: %-12s %7llu cycles/op, %6d ops, %8lld us\n",
+          what, elapsed / ops, ops, us);
+}
+
+static void
+bench_null (void)
+{
+  enum { CALLS = 100000 };
+  int i;
+
+  tell (BAD_FD);
+  start ();
+  for (i = 0; i < CALLS; i++)
+    tell (BAD_FD);
+  report ("null", CALLS);
+}
+
+/* Writes, then reads back, SIZE bytes at a time, CNT times. */
+static void
+bench_io (int fd, const char *write_name, const char *read_name,
+          int size, int cnt)
+{
+  int i;
+
+  seek (fd, 0);
+  start ();
+  for (i = 0; i < cnt; i++)
+    if (write (fd, buf, size) != size)
+      {
+        printf ("ubench: write %d bytes failed\n", size);
+        exit (EXIT_FAILURE);
+      }
+  report (write_name, cnt);
+
+  seek (fd, 0);
+  start ();
+  for (i = 0; i < cnt; i++)
+    if (read (fd, buf, size) != size)
+      {
+        printf ("ubench: read %d bytes failed\n", size);
+        exit (EXIT_FAILURE);
+      }
+  report (read_name, cnt);
+}
+
+static void
+bench_rw (void)
+{
+  int fd;
+
+  if (!create (TMP_FILE, 0) || (fd = open (TMP_FILE)) < 0)
+    {
+      printf ("ubench: could not create %s\n", TMP_FILE);
+      exit (EXIT_FAILURE);
+    }
+  bench_io (fd, "write-1", "read-1", 1, 4096);
+  bench_io (fd, "write-4k", "read-4k", sizeof buf, 64);
+  close (fd);
+  remove (TMP_FILE);
+}
+
+static void
+bench_open (void)
+{
+  enum { OPENS = 1000 };
+  int i;
+
+  if (!create (TMP_FILE, 0))
+    {
+      printf ("ubench: could not create %s\n", TMP_FILE);
+      exit (EXIT_FAILURE);
+    }
+  start ();
+  for (i = 0; i < OPENS; i++)
+    close (open (TMP_FILE));
+  report ("open-close", OPENS);
+  remove (TMP_FILE);
+}
+
+static void
+bench_exec (void)
+{
+  enum { EXECS = 50 };
+  int i;
+
+  start ();
+  for (i = 0; i < EXECS; i++)
+    {
+      pid_t pid = exec ("nop");
+      if (pid == PID_ERROR || wait (pid) != EXIT_SUCCESS)
+        {
+          printf ("ubench: exec of \"nop\" failed\n");
+          exit (EXIT_FAILURE);
+        }
+    }
+  report ("exec-wait", EXECS);
+}
+
+/* Touches one byte of each page of FAULT_PAGES. */
+static void
+touch_pages (void)
+{
+  int i;
+
+  for (i = 0; i < FAULT_PAGES; i++)
+    ((volatile char *) fault_pages[i])[0]++;
+}
+
+static void
+bench_fault (void)
+{
+  start ();
+  touch_pages ();
+  report ("fault", FAULT_PAGES);
+
+  start ();
+  touch_pages ();
+  report ("no-fault", FAULT_PAGES);
+}
+
+struct bench
+  {
+    const char *name;
+    void (*function) (void);
+  };
+
+static const struct bench benches[] =
+  {
+    {"null", bench_null},
+    {"rw", bench_rw},
+    {"open", bench_open},
+    {"exec", bench_exec},
+    {"fault", bench_fault},
+  };
+
+#define BENCH_CNT (sizeof benches / sizeof *benches)
+
+int
+main (int argc, char *argv[])
+{
+  size_t i;
+  int j;
+
+  if (argc < 2)
+    {
+      for (i = 0; i < BENCH_CNT; i++)
+        benches[i].function ();
+      return EXIT_SUCCESS;
+    }
+
+  for (j = 1; j < argc; j++)
+    {
+      for (i = 0; i < BENCH_CNT; i++)
+        if (!strcmp (argv[j], benches[i].name))
+          break;
+      if (i == BENCH_CNT)
+        {
+          printf ("ubench: unknown measurement \"%s\"\n", argv[j]);
+          return EXIT_FAILURE;
+        }
+      benches[i].function ();
+    }
+  return EXIT_SUCCESS;
+}
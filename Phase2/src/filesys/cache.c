@@ -0,0 +1,698 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <round.h>
+#include <stats.h>
+#include <stdint.h>
+#include <string.h>
+#include "devices/elevator.h"
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Buffer cache for file system sectors.
+
+   Every sector the file system reads or writes goes through a
+   fixed set of CACHE_SIZE buffers.  Writes only mark a buffer
+   dirty; dirty buffers reach the disk when they are evicted, when
+   the write-behind thread runs every WRITE_BEHIND_TICKS, and at
+   cache_flush().  Eviction uses the clock algorithm.  A second
+   thread reads runs of sectors announced by cache_read_ahead(),
+   each with one multi-sector transfer, so that a sequential
+   reader finds its next sectors already cached.
+
+   cache_lock protects all of the bookkeeping below.  Disk I/O is
+   done without it: an entry being filled from disk is marked busy
+   and an entry whose data is being copied is pinned, and neither
+   is ever chosen for eviction.
+
+   An entry written with cache_write_logged() holds metadata that
+   the journal has yet to commit.  It must not reach its home
+   sector before then, so it is neither evicted nor flushed until
+   cache_write_back() writes it out after the commit.
+
+   A writer that finds DIRTY_LIMIT entries dirty waits in
+   cache_throttle() until the write-behind thread, which it wakes
+   early, has written some of them back.  Otherwise one fast
+   writer could leave every entry dirty, and each reader that
+   missed would have to write one back before reading.  An entry
+   written with cache_write_owned() records the file it belongs
+   to, so that a flush writes each file's sectors together, in
+   order, and cache_flush_owner() can write just one file's. */
+
+#define CACHE_SIZE 64                   /* Number of cached sectors. */
+#define DIRTY_LIMIT (CACHE_SIZE / 2)    /* Most dirty entries for writers. */
+#define WRITE_BEHIND_TICKS TIMER_FREQ   /* Interval between flushes. */
+#define READ_AHEAD_SLOTS 16             /* Pending read-ahead requests. */
+
+/* A cached sector. */
+struct cache_entry
+  {
+    block_sector_t sector;              /* Sector held, if valid. */
+    bool valid;                         /* Holds a sector at all? */
+    bool dirty;                         /* Newer than the disk copy? */
+    bool accessed;                      /* Used since the hand passed? */
+    bool busy;                          /* Being read from disk? */
+    bool logged;                        /* Awaiting a journal commit? */
+    bool flushing;                      /* Being written by flush()? */
+    int pin_cnt;                        /* Threads using the data. */
+    const void *owner;                  /* File it holds data of, or NULL. */
+    uint8_t *data;                      /* BLOCK_SECTOR_SIZE bytes. */
+    struct io_request io;               /* flush()'s write of it. */
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;
+static struct condition cache_changed;  /* An entry became usable. */
+static size_t clock_hand;
+
+/* Entries that are dirty and not logged, which a flush can clean,
+   and the writers waiting in cache_throttle() for fewer. */
+static size_t dirty_cnt;
+static struct condition dirty_dropped;
+static struct semaphore flush_wanted;   /* Wakes the write-behind thread. */
+static int64_t throttle_cnt;            /* Writers made to wait. */
+
+/* A run of sectors to read ahead. */
+struct read_ahead
+  {
+    block_sector_t sector;              /* First sector. */
+    size_t cnt;                         /* Number of sectors. */
+  };
+
+/* Ring of runs waiting to be read ahead, and the buffer the
+   read-ahead thread reads them into. */
+static struct read_ahead read_ahead_queue[READ_AHEAD_SLOTS];
+static size_t read_ahead_head;
+static size_t read_ahead_cnt;
+static struct condition read_ahead_wanted;
+static uint8_t *read_ahead_buffer;
+
+static thread_func write_behind_thread NO_RETURN;
+static thread_func read_ahead_thread NO_RETURN;
+static void set_dirty (struct cache_entry *, bool dirty);
+static void flush (const void *owner, bool all);
+
+/* Initializes the buffer cache and starts its helper threads. */
+void
+cache_init (void) 
+{
+  size_t per_page = PGSIZE / BLOCK_SECTOR_SIZE;
+  uint8_t *pages;
+  size_t i;
+
+  pages = palloc_get_multiple (PAL_ASSERT, CACHE_SIZE / per_page);
+  for (i = 0; i < CACHE_SIZE; i++) 
+    {
+      cache[i].valid = false;
+      cache[i].logged = false;
+      cache[i].flushing = false;
+      cache[i].pin_cnt = 0;
+      cache[i].owner = NULL;
+      cache[i].data = pages + i * BLOCK_SECTOR_SIZE;
+    }
+  read_ahead_buffer = palloc_get_multiple (PAL_ASSERT,
+                                           DIV_ROUND_UP (CACHE_READ_AHEAD_MAX
+                                                         * BLOCK_SECTOR_SIZE,
+                                                         PGSIZE));
+  lock_init_named (&cache_lock, "cache");
+  cond_init (&cache_changed);
+  cond_init (&dirty_dropped);
+  sema_init (&flush_wanted, 0);
+  cond_init (&read_ahead_wanted);
+  stats_add_int64 ("cache", NULL, "throttled", &throttle_cnt);
+
+  thread_create_stack ("write-behind", PRI_DEFAULT, FILESYS_STACK_PAGES,
+                       write_behind_thread, NULL);
+  thread_create_stack ("read-ahead", PRI_DEFAULT, FILESYS_STACK_PAGES,
+                       read_ahead_thread, NULL);
+}
+
+/* Returns the valid entry for SECTOR, or a null pointer. */
+static struct cache_entry *
+cache_find (block_sector_t sector) 
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].valid && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Chooses an entry to reuse with the clock algorithm, or returns
+   a null pointer if every entry is pinned or busy. */
+static struct cache_entry *
+cache_pick_victim (void) 
+{
+  size_t i;
+
+  for (i = 0; i < 2 * CACHE_SIZE; i++) 
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (!e->valid)
+        return e;
+      if (e->busy || e->pin_cnt > 0 || e->logged)
+        continue;
+      if (e->accessed)
+        e->accessed = false;
+      else
+        return e;
+    }
+  return NULL;
+}
+
+/* Returns the entry for SECTOR, pinned, bringing the sector in
+   if it is not cached.  If LOAD is false the caller is about to
+   overwrite the whole sector, so its old contents are not read.
+   COUNT says whether the access counts toward the hit rate.
+   Must be called with cache_lock held. */
+static struct cache_entry *
+cache_get (block_sector_t sector, bool load, bool count) 
+{
+  struct cache_entry *e;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (;;) 
+    {
+      e = cache_find (sector);
+      if (e != NULL) 
+        {
+          if (e->busy) 
+            {
+              cond_wait (&cache_changed, &cache_lock);
+              continue;
+            }
+          e->pin_cnt++;
+          e->accessed = true;
+          if (count)
+            block_count_cache_access (fs_device, true);
+          return e;
+        }
+
+      e = cache_pick_victim ();
+      if (e == NULL) 
+        {
+          cond_wait (&cache_changed, &cache_lock);
+          continue;
+        }
+      if (e->valid && e->dirty) 
+        {
+          /* Write the victim back, then start over: SECTOR may
+             have been brought in while the lock was dropped. */
+          e->busy = true;
+          lock_release (&cache_lock);
+          block_write (fs_device, e->sector, e->data);
+          lock_acquire (&cache_lock);
+          e->busy = false;
+          set_dirty (e, false);
+          cond_broadcast (&cache_changed, &cache_lock);
+          continue;
+        }
+      break;
+    }
+
+  e->sector = sector;
+  e->valid = true;
+  e->dirty = false;
+  e->logged = false;
+  e->accessed = true;
+  e->pin_cnt = 1;
+  e->owner = NULL;
+  if (count)
+    block_count_cache_access (fs_device, false);
+  if (load) 
+    {
+      e->busy = true;
+      lock_release (&cache_lock);
+      block_read (fs_device, sector, e->data);
+      lock_acquire (&cache_lock);
+      e->busy = false;
+      cond_broadcast (&cache_changed, &cache_lock);
+    }
+  return e;
+}
+
+/* Drops a pin on E, marking it dirty if DIRTY.
+   Must be called with cache_lock held. */
+static void
+cache_put (struct cache_entry *e, bool dirty) 
+{
+  ASSERT (e->pin_cnt > 0);
+
+  if (dirty)
+    set_dirty (e, true);
+  if (--e->pin_cnt == 0)
+    cond_broadcast (&cache_changed, &cache_lock);
+}
+
+/* Reads SIZE bytes starting at offset OFS within SECTOR into
+   BUFFER. */
+void
+cache_read (block_sector_t sector, void *buffer, int ofs, int size) 
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  e = cache_get (sector, true, true);
+  lock_release (&cache_lock);
+
+  memcpy (buffer, e->data + ofs, size);
+
+  lock_acquire (&cache_lock);
+  cache_put (e, false);
+  lock_release (&cache_lock);
+}
+
+/* Reads the CNT whole sectors starting at SECTOR into BUFFER.
+   Cached sectors are copied out of the cache.  Each run of
+   uncached sectors is read from disk in one block_read_multi()
+   call straight into BUFFER, without being cached.  That is
+   safe because a sector that is not cached is current on disk.
+   The caller must keep writers away from these sectors, as
+   inode_read_at() does by holding the inode's lock. */
+void
+cache_read_multi (block_sector_t sector, size_t cnt, void *buffer_) 
+{
+  uint8_t *buffer = buffer_;
+  size_t i = 0;
+
+  while (i < cnt) 
+    {
+      size_t run = 0;
+
+      lock_acquire (&cache_lock);
+      while (i + run < cnt && cache_find (sector + i + run) == NULL)
+        {
+          block_count_cache_access (fs_device, false);
+          run++;
+        }
+      lock_release (&cache_lock);
+
+      if (run > 0) 
+        {
+          block_read_multi (fs_device, sector + i, run,
+                            buffer + i * BLOCK_SECTOR_SIZE);
+          i += run;
+        }
+      else 
+        {
+          cache_read (sector + i, buffer + i * BLOCK_SECTOR_SIZE,
+                      0, BLOCK_SECTOR_SIZE);
+          i++;
+        }
+    }
+}
+
+/* Marks E dirty if DIRTY is true and clean otherwise, keeping
+   dirty_cnt up to date and waking throttled writers when it
+   drops below DIRTY_LIMIT.  Must be called with cache_lock held. */
+static void
+set_dirty (struct cache_entry *e, bool dirty) 
+{
+  bool counted = e->dirty && !e->logged;
+
+  e->dirty = dirty;
+  if (counted == (dirty && !e->logged))
+    return;
+  if (!counted)
+    dirty_cnt++;
+  else if (dirty_cnt-- == DIRTY_LIMIT)
+    cond_broadcast (&dirty_dropped, &cache_lock);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR, starting at offset
+   OFS within the sector, and marks the entry LOGGED if that is
+   true.  OWNER, if nonnull, is the file the sector belongs to. */
+static void
+cache_write_entry (block_sector_t sector, const void *buffer, int ofs,
+                   int size, bool logged, const void *owner) 
+{
+  struct cache_entry *e;
+  bool whole = ofs == 0 && size == BLOCK_SECTOR_SIZE;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  e = cache_get (sector, !whole, true);
+  if (logged && !e->logged)
+    {
+      /* Logged entries are flushed only after a commit. */
+      bool dirty = e->dirty;
+      set_dirty (e, false);
+      e->logged = true;
+      e->dirty = dirty;
+    }
+  if (owner != NULL)
+    e->owner = owner;
+  lock_release (&cache_lock);
+
+  memcpy (e->data + ofs, buffer, size);
+
+  lock_acquire (&cache_lock);
+  cache_put (e, true);
+  lock_release (&cache_lock);
+}
+
+/* Writes SIZE bytes from BUFFER into SECTOR, starting at offset
+   OFS within the sector.  The disk is updated later. */
+void
+cache_write (block_sector_t sector, const void *buffer, int ofs, int size) 
+{
+  cache_write_entry (sector, buffer, ofs, size, false, NULL);
+}
+
+/* Like cache_write(), for a data sector of the file OWNER, whose
+   dirty sectors cache_flush_owner() can then write back. */
+void
+cache_write_owned (block_sector_t sector, const void *buffer, int ofs,
+                   int size, const void *owner) 
+{
+  ASSERT (owner != NULL);
+  cache_write_entry (sector, buffer, ofs, size, false, owner);
+}
+
+/* Like cache_write(), but for a sector the journal has logged:
+   it stays in the cache until cache_write_back() is called for
+   it. */
+void
+cache_write_logged (block_sector_t sector, const void *buffer, int ofs,
+                    int size) 
+{
+  cache_write_entry (sector, buffer, ofs, size, true, NULL);
+}
+
+/* Writes SECTOR, which cache_write_logged() wrote and the
+   journal has since committed, back to disk now, and lets it be
+   evicted and flushed like any other entry again. */
+void
+cache_write_back (block_sector_t sector) 
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  e = cache_find (sector);
+  ASSERT (e != NULL && e->logged);
+  e = cache_get (sector, true, false);
+  e->logged = false;
+  e->dirty = false;
+  lock_release (&cache_lock);
+
+  block_write (fs_device, sector, e->data);
+
+  lock_acquire (&cache_lock);
+  cache_put (e, false);
+  lock_release (&cache_lock);
+}
+
+/* Writes SECTOR to disk now if it is cached and dirty, so that
+   what the caller put there is on disk before the metadata that
+   points to it commits.  Not for a sector the journal has
+   logged. */
+void
+cache_sync (block_sector_t sector) 
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  e = cache_find (sector);
+  if (e == NULL || !e->dirty) 
+    {
+      lock_release (&cache_lock);
+      return;
+    }
+  e = cache_get (sector, true, false);
+  ASSERT (!e->logged);
+  set_dirty (e, false);
+  lock_release (&cache_lock);
+
+  block_write (fs_device, sector, e->data);
+
+  lock_acquire (&cache_lock);
+  cache_put (e, false);
+  lock_release (&cache_lock);
+}
+
+/* Copies the whole of sector SRC over sector DST, inside the
+   cache.  If SRC is not cached it is read from disk straight into
+   DST's buffer, without being cached itself and without a copy.
+   As in cache_read_multi(), the caller must keep writers away
+   from SRC.  OWNER, if nonnull, is the file DST belongs to, as
+   for cache_write_owned(). */
+void
+cache_copy (block_sector_t dst, block_sector_t src, const void *owner) 
+{
+  struct cache_entry *d, *s;
+
+  ASSERT (dst != src);
+
+  lock_acquire (&cache_lock);
+  d = cache_get (dst, false, true);
+  if (cache_find (src) == NULL) 
+    {
+      block_count_cache_access (fs_device, false);
+      d->busy = true;
+      lock_release (&cache_lock);
+      block_read (fs_device, src, d->data);
+      lock_acquire (&cache_lock);
+      d->busy = false;
+      cond_broadcast (&cache_changed, &cache_lock);
+    }
+  else 
+    {
+      s = cache_get (src, true, true);
+      lock_release (&cache_lock);
+      memcpy (d->data, s->data, BLOCK_SECTOR_SIZE);
+      lock_acquire (&cache_lock);
+      cache_put (s, false);
+    }
+  if (owner != NULL)
+    d->owner = owner;
+  cache_put (d, true);
+  lock_release (&cache_lock);
+}
+
+/* Asks for the CNT sectors starting at SECTOR, at most
+   CACHE_READ_AHEAD_MAX, to be brought into the cache in the
+   background.  Dropped if a single sector is already cached or
+   too many requests are pending. */
+void
+cache_read_ahead (block_sector_t sector, size_t cnt) 
+{
+  ASSERT (cnt > 0 && cnt <= CACHE_READ_AHEAD_MAX);
+
+  lock_acquire (&cache_lock);
+  if (read_ahead_cnt < READ_AHEAD_SLOTS
+      && (cnt > 1 || cache_find (sector) == NULL)) 
+    {
+      size_t tail = (read_ahead_head + read_ahead_cnt) % READ_AHEAD_SLOTS;
+      read_ahead_queue[tail].sector = sector;
+      read_ahead_queue[tail].cnt = cnt;
+      read_ahead_cnt++;
+      cond_signal (&read_ahead_wanted, &cache_lock);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Returns true if entry A should be written before entry B:
+   grouped by file, and in order of sector within each. */
+static bool
+flush_before (const struct cache_entry *a, const struct cache_entry *b) 
+{
+  if (a->owner != b->owner)
+    return (uintptr_t) a->owner < (uintptr_t) b->owner;
+  return a->sector < b->sector;
+}
+
+/* Writes back the dirty entries of file OWNER, or every dirty
+   entry if ALL is true, except those awaiting a journal commit.
+   All of the writes are submitted, sorted with flush_before(),
+   before any is waited for, so that each file's sectors reach
+   the device in order and disks on different channels are kept
+   busy at the same time. */
+static void
+flush (const void *owner, bool all) 
+{
+  struct cache_entry *flushed[CACHE_SIZE];
+  struct semaphore done;
+  size_t cnt = 0;
+  size_t i;
+
+  sema_init (&done, 0);
+  lock_acquire (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++) 
+    {
+      struct cache_entry *e = &cache[i];
+      if (e->valid && e->dirty && !e->busy && !e->logged && !e->flushing
+          && (all || e->owner == owner)) 
+        {
+          size_t j;
+
+          /* A writer that pins E meanwhile sets dirty again in
+             cache_put(), so its data is not lost. */
+          set_dirty (e, false);
+          e->flushing = true;
+          e->pin_cnt++;
+          e->io.write = true;
+          e->io.sector = e->sector;
+          e->io.cnt = 1;
+          e->io.buffer = e->data;
+          e->io.done = block_wake_sema;
+          e->io.aux = &done;
+
+          for (j = cnt++; j > 0 && flush_before (e, flushed[j - 1]); j--)
+            flushed[j] = flushed[j - 1];
+          flushed[j] = e;
+        }
+    }
+  lock_release (&cache_lock);
+
+  for (i = 0; i < cnt; i++)
+    block_submit (fs_device, &flushed[i]->io);
+  for (i = 0; i < cnt; i++)
+    sema_down (&done);
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < cnt; i++) 
+    {
+      flushed[i]->flushing = false;
+      cache_put (flushed[i], false);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Writes every dirty entry back to disk, except those awaiting a
+   journal commit. */
+void
+cache_flush (void) 
+{
+  flush (NULL, true);
+}
+
+/* Writes the dirty entries that cache_write_owned() wrote for
+   OWNER back to disk, and waits until they are there. */
+void
+cache_flush_owner (const void *owner) 
+{
+  ASSERT (owner != NULL);
+  flush (owner, false);
+}
+
+/* Waits, if DIRTY_LIMIT entries are dirty, until the write-behind
+   thread has brought the count back down.  Called by writers of
+   file data before they dirty more entries.  Readers never wait
+   here. */
+void
+cache_throttle (void) 
+{
+  /* Checked without the lock first: most writes are under the
+     limit, and a stale count only delays the wait by a write. */
+  if (dirty_cnt < DIRTY_LIMIT)
+    return;
+
+  lock_acquire (&cache_lock);
+  if (dirty_cnt >= DIRTY_LIMIT) 
+    {
+      throttle_cnt++;
+      sema_up (&flush_wanted);
+      while (dirty_cnt >= DIRTY_LIMIT)
+        cond_wait (&dirty_dropped, &cache_lock);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Flushes dirty entries every WRITE_BEHIND_TICKS, or sooner when
+   cache_throttle() asks. */
+static void
+write_behind_thread (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      struct timer_alarm alarm;
+
+      timer_alarm_set (&alarm, timer_ticks () + WRITE_BEHIND_TICKS,
+                       &flush_wanted);
+      sema_down (&flush_wanted);
+      timer_alarm_cancel (&alarm);
+      cache_flush ();
+    }
+}
+
+/* Brings those of the CNT sectors starting at SECTOR that are
+   not cached into the cache, reading each run of them with one
+   block_read_multi() call into read_ahead_buffer.  The entries
+   are claimed and marked busy before the lock is dropped, as in
+   cache_get().  Gives up early, since this is only a hint, if no
+   entry can be reused without writing it back first.
+   Must be called with cache_lock held. */
+static void
+cache_load_run (block_sector_t sector, size_t cnt) 
+{
+  struct cache_entry *run[CACHE_READ_AHEAD_MAX];
+  size_t i = 0;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+  ASSERT (cnt <= CACHE_READ_AHEAD_MAX);
+
+  while (i < cnt) 
+    {
+      size_t n = 0;
+      size_t j;
+
+      while (i < cnt && cache_find (sector + i) != NULL)
+        i++;
+      while (i + n < cnt && cache_find (sector + i + n) == NULL) 
+        {
+          struct cache_entry *e = cache_pick_victim ();
+          if (e == NULL || (e->valid && e->dirty))
+            break;
+          e->sector = sector + i + n;
+          e->valid = true;
+          e->dirty = false;
+          e->logged = false;
+          e->accessed = true;
+          e->busy = true;
+          run[n++] = e;
+        }
+      if (n == 0)
+        return;
+
+      lock_release (&cache_lock);
+      block_read_multi (fs_device, sector + i, n, read_ahead_buffer);
+      lock_acquire (&cache_lock);
+      for (j = 0; j < n; j++) 
+        {
+          memcpy (run[j]->data, read_ahead_buffer + j * BLOCK_SECTOR_SIZE,
+                  BLOCK_SECTOR_SIZE);
+          run[j]->busy = false;
+        }
+      cond_broadcast (&cache_changed, &cache_lock);
+      i += n;
+    }
+}
+
+/* Services cache_read_ahead() requests. */
+static void
+read_ahead_thread (void *aux UNUSED) 
+{
+  lock_acquire (&cache_lock);
+  for (;;) 
+    {
+      struct read_ahead ra;
+
+      while (read_ahead_cnt == 0)
+        cond_wait (&read_ahead_wanted, &cache_lock);
+      ra = read_ahead_queue[read_ahead_head];
+      read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_SLOTS;
+      read_ahead_cnt--;
+
+      cache_load_run (ra.sector, ra.cnt);
+    }
+}
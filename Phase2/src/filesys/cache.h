@@ -0,0 +1,24 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include "devices/block.h"
+
+/* Most sectors one cache_read_ahead() request can bring in. */
+#define CACHE_READ_AHEAD_MAX 16
+
+void cache_init (void);
+void cache_read (block_sector_t, void *, int ofs, int size);
+void cache_read_multi (block_sector_t, size_t cnt, void *);
+void cache_write (block_sector_t, const void *, int ofs, int size);
+void cache_write_owned (block_sector_t, const void *, int ofs, int size,
+                        const void *owner);
+void cache_write_logged (block_sector_t, const void *, int ofs, int size);
+void cache_write_back (block_sector_t);
+void cache_copy (block_sector_t dst, block_sector_t src, const void *owner);
+void cache_sync (block_sector_t);
+void cache_read_ahead (block_sector_t, size_t cnt);
+void cache_flush (void);
+void cache_flush_owner (const void *owner);
+void cache_throttle (void);
+
+#endif /* filesys/cache.h */
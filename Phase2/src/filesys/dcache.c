@@ -0,0 +1,169 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Directory entry cache.
+
+   Maps a directory's inode sector and a name in it to the inode
+   sector the name refers to, or to DCACHE_NEGATIVE if the name
+   is known to be missing, so that walking a path again need not
+   search each directory on the way.  Entries are added by
+   dir_lookup() and kept in step by dir_add() and dir_remove(),
+   which change directories only while holding dir_lock for
+   writing; a lookup that misses here fills the entry under the
+   same lock.  The least recently used entry is reused when the
+   cache is full. */
+
+#define DCACHE_SIZE 128                 /* Number of cached names. */
+
+/* A cached name. */
+struct dentry
+  {
+    struct hash_elem hash_elem;         /* In dentries, if in use. */
+    struct list_elem lru_elem;          /* In lru. */
+    block_sector_t dir;                 /* Directory's inode sector. */
+    char name[NAME_MAX + 1];            /* Name in the directory. */
+    block_sector_t sector;              /* Named inode, or
+                                           DCACHE_NEGATIVE. */
+    bool in_use;                        /* In dentries? */
+  };
+
+static struct dentry dentry_pool[DCACHE_SIZE];
+static struct hash dentries;
+static struct list lru;                 /* Least recently used first. */
+static struct lock dcache_lock;         /* Protects all of the above. */
+
+/* Returns a hash value for dentry E. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_int (d->dir) ^ hash_string (d->name);
+}
+
+/* Returns true if dentry A's key precedes B's. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the directory entry cache, which starts out
+   empty. */
+void
+dcache_init (void)
+{
+  size_t i;
+
+  if (!hash_init (&dentries, dentry_hash, dentry_less, NULL))
+    PANIC ("dcache_init: out of memory");
+  list_init (&lru);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    list_push_back (&lru, &dentry_pool[i].lru_elem);
+
+  /* Every path lookup takes dcache_lock, briefly and without
+     sleeping, so its holder simply runs above anyone who could
+     want it. */
+  lock_init_ceiling (&dcache_lock, PRI_MAX);
+}
+
+/* Returns the cached entry for NAME in DIR, or a null pointer.
+   dcache_lock must be held. */
+static struct dentry *
+find (block_sector_t dir, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Looks up NAME in the directory whose inode is in sector DIR.
+   If the cache knows it, stores the sector it names, or
+   DCACHE_NEGATIVE if there is no such name, in *SECTOR and
+   returns true.  Otherwise returns false. */
+bool
+dcache_lookup (block_sector_t dir, const char *name, block_sector_t *sector)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return false;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      *sector = d->sector;
+      list_remove (&d->lru_elem);
+      list_push_back (&lru, &d->lru_elem);
+    }
+  lock_release (&dcache_lock);
+  return d != NULL;
+}
+
+/* Records that NAME in the directory whose inode is in sector
+   DIR refers to SECTOR, or does not exist if SECTOR is
+   DCACHE_NEGATIVE, replacing what was known before.  The caller
+   must hold dir_lock, for writing if the directory is changing. */
+void
+dcache_insert (block_sector_t dir, const char *name, block_sector_t sector)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d == NULL)
+    {
+      d = list_entry (list_front (&lru), struct dentry, lru_elem);
+      if (d->in_use)
+        hash_delete (&dentries, &d->hash_elem);
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      d->in_use = true;
+      hash_insert (&dentries, &d->hash_elem);
+    }
+  d->sector = sector;
+  list_remove (&d->lru_elem);
+  list_push_back (&lru, &d->lru_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets every name cached for the directory whose inode is in
+   sector DIR, because it is being removed or created anew. */
+void
+dcache_drop_dir (block_sector_t dir)
+{
+  size_t i;
+
+  lock_acquire (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    {
+      struct dentry *d = &dentry_pool[i];
+      if (d->in_use && d->dir == dir)
+        {
+          hash_delete (&dentries, &d->hash_elem);
+          d->in_use = false;
+          list_remove (&d->lru_elem);
+          list_push_front (&lru, &d->lru_elem);
+        }
+    }
+  lock_release (&dcache_lock);
+}
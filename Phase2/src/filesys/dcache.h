@@ -0,0 +1,18 @@
+#ifndef FILESYS_DCACHE_H
+#define FILESYS_DCACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Sector recorded for a name known not to exist.  Sector 0 holds
+   the free map's inode, so no directory entry points there. */
+#define DCACHE_NEGATIVE ((block_sector_t) 0)
+
+void dcache_init (void);
+bool dcache_lookup (block_sector_t dir, const char *name,
+                    block_sector_t *sector);
+void dcache_insert (block_sector_t dir, const char *name,
+                    block_sector_t sector);
+void dcache_drop_dir (block_sector_t dir);
+
+#endif /* filesys/dcache.h */
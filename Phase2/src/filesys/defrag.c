@@ -0,0 +1,134 @@
+#include "filesys/defrag.h"
+#include <round.h>
+#include <stats.h>
+#include <stdint.h>
+#include "devices/timer.h"
+#include "filesys/directory.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/thread.h"
+
+/* Online defragmentation.
+
+   Files created and removed over time leave the free map in
+   small pieces, and a file written meanwhile ends up scattered
+   across them, which makes reading it back take a transfer per
+   piece.  The "defrag" thread walks the directory tree from the
+   root every DEFRAG_PASS_TICKS and has inode_defrag() move each
+   file whose data is split into more extents, runs of sectors
+   consecutive on disk, than one per DEFRAG_RUN sectors into a
+   single free run.
+
+   It runs at PRI_MIN and stays out of the way of processes using
+   the disk: before each file, it waits until no file has been
+   read or written for DEFRAG_IDLE_TICKS.  Its progress is in the
+   stats registry under "defrag". */
+
+#define DEFRAG_PASS_TICKS (30 * TIMER_FREQ)     /* Between passes. */
+#define DEFRAG_IDLE_TICKS (TIMER_FREQ / 2)      /* Quiet before a move. */
+#define DEFRAG_RUN 32                   /* Sectors per extent allowed. */
+#define DEFRAG_MAX_DEPTH 16             /* Deepest directory walked. */
+
+/* Statistics. */
+static uint64_t pass_cnt;               /* Passes finished. */
+static uint64_t scanned_cnt;            /* Files looked at. */
+static uint64_t moved_cnt;              /* Files moved. */
+static uint64_t sectors_moved;          /* Sectors they took up. */
+static uint64_t no_room_cnt;            /* Fragmented but not moved. */
+static uint64_t throttle_cnt;           /* Waits for the disk to idle. */
+
+static thread_func defrag_thread NO_RETURN;
+
+/* Starts the defragmentation thread. */
+void
+defrag_init (void) 
+{
+  stats_add_uint64 ("defrag", NULL, "passes", &pass_cnt);
+  stats_add_uint64 ("defrag", NULL, "scanned", &scanned_cnt);
+  stats_add_uint64 ("defrag", NULL, "moved", &moved_cnt);
+  stats_add_uint64 ("defrag", NULL, "sectors", &sectors_moved);
+  stats_add_uint64 ("defrag", NULL, "no_room", &no_room_cnt);
+  stats_add_uint64 ("defrag", NULL, "throttled", &throttle_cnt);
+  thread_create_stack ("defrag", PRI_MIN, FILESYS_STACK_PAGES,
+                       defrag_thread, NULL);
+}
+
+/* Moves INODE's data into one run if it is fragmented. */
+static void
+defrag_file (struct inode *inode) 
+{
+  size_t extents = inode_extent_cnt (inode);
+  size_t sectors = DIV_ROUND_UP (inode_length (inode), BLOCK_SECTOR_SIZE);
+  size_t moved;
+
+  scanned_cnt++;
+  if (extents <= 1 + sectors / DEFRAG_RUN)
+    return;
+
+  while (timer_elapsed (file_last_io ()) < DEFRAG_IDLE_TICKS) 
+    {
+      throttle_cnt++;
+      timer_sleep (DEFRAG_IDLE_TICKS);
+    }
+
+  moved = inode_defrag (inode);
+  if (moved > 0) 
+    {
+      moved_cnt++;
+      sectors_moved += moved;
+    }
+  else
+    no_room_cnt++;
+}
+
+/* Defragments the files in DIR and, up to DEFRAG_MAX_DEPTH
+   levels down from DEPTH, those in its subdirectories. */
+static void
+defrag_dir (struct dir *dir, int depth) 
+{
+  char name[NAME_MAX + 1];
+
+  while (dir_readdir (dir, name)) 
+    {
+      struct inode *inode;
+
+      if (!dir_lookup (dir, name, &inode))
+        continue;
+      if (!inode_is_dir (inode))
+        {
+          defrag_file (inode);
+          inode_close (inode);
+        }
+      else if (depth < DEFRAG_MAX_DEPTH)
+        {
+          struct dir *sub = dir_open (inode);
+
+          if (sub != NULL) 
+            {
+              defrag_dir (sub, depth + 1);
+              dir_close (sub);
+            }
+        }
+      else
+        inode_close (inode);
+    }
+}
+
+/* Makes a pass over the file system every DEFRAG_PASS_TICKS. */
+static void
+defrag_thread (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      struct dir *root;
+
+      timer_sleep (DEFRAG_PASS_TICKS);
+      root = dir_open_root ();
+      if (root == NULL)
+        continue;
+      defrag_dir (root, 0);
+      dir_close (root);
+      pass_cnt++;
+    }
+}
@@ -0,0 +1,6 @@
+#ifndef FILESYS_DEFRAG_H
+#define FILESYS_DEFRAG_H
+
+void defrag_init (void);
+
+#endif /* filesys/defrag.h */
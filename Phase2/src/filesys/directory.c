@@ -1,10 +1,17 @@
 #include "filesys/directory.h"
+#include <dirent.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir 
@@ -21,12 +28,82 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Serializes changes to directory entries and directory
+   indexes.  Lookups and readdir share it; adding and removing
+   entries, and building an index, take it exclusively, so that
+   checking for a name and claiming a slot happen atomically. */
+static struct rwlock dir_lock;
+
+/* In-memory index of the entries of a directory, so that looking
+   up a name or finding a free slot does not read the whole
+   directory.  Built the first time a directory is searched and
+   kept, across closing and reopening it, until evicted; dir_add()
+   and dir_remove() keep it in step with the directory on disk.
+   Protected by dir_lock. */
+struct dir_index
+  {
+    struct list_elem elem;              /* Element in dir_indexes. */
+    block_sector_t sector;              /* Directory's inode sector. */
+    bool accessed;                      /* Used since last eviction scan? */
+    struct hash names;                  /* In-use entries, by name. */
+    struct list free_slots;             /* Free entries. */
+    off_t end;                          /* Offset just past the last entry. */
+  };
+
+/* One directory entry in a dir_index. */
+struct index_entry
+  {
+    struct hash_elem hash_elem;         /* In names, if in use. */
+    struct list_elem free_elem;         /* In free_slots, if not. */
+    off_t ofs;                          /* Byte offset in directory. */
+    block_sector_t inode_sector;        /* Sector number of header. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+  };
+
+/* Most directory indexes kept at once. */
+#define DIR_INDEX_CNT 8
+
+/* Directory indexes, least recently built first. */
+static struct list dir_indexes;
+
+static struct dir_index *index_find (const struct dir *);
+static struct dir_index *index_get (const struct dir *);
+static void index_drop (block_sector_t sector);
+
+/* Initializes the directory module. */
+void
+dir_init (void) 
+{
+  rw_init (&dir_lock, RW_PREFER_WRITERS);
+  list_init (&dir_indexes);
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+   given SECTOR, whose parent is the directory in sector PARENT,
+   and gives it its "." and ".." entries.  The root directory is
+   its own parent.  Returns true if successful, false on
+   failure. */
 bool
-dir_create (block_sector_t sector, size_t entry_cnt)
+dir_create (block_sector_t sector, size_t entry_cnt, block_sector_t parent)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir *dir;
+  bool success;
+
+  /* Forget any index or cached names left over from a directory
+     that used to be in SECTOR. */
+  rw_write_acquire (&dir_lock);
+  index_drop (sector);
+  dcache_drop_dir (sector);
+  rw_write_release (&dir_lock);
+
+  if (!inode_create (sector, entry_cnt * sizeof (struct dir_entry), true))
+    return false;
+  dir = dir_open (inode_open (sector));
+  success = (dir != NULL
+             && dir_add (dir, ".", sector)
+             && dir_add (dir, "..", parent));
+  dir_close (dir);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -83,21 +160,261 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
-/* Searches DIR for a file with the given NAME.
+/* Sets DIR's position, where dir_readdir() reads the next entry,
+   to POS bytes from the start. */
+void
+dir_seek (struct dir *dir, off_t pos)
+{
+  dir->pos = pos;
+}
+
+/* Returns DIR's position, for a later dir_seek(). */
+off_t
+dir_tell (const struct dir *dir)
+{
+  return dir->pos;
+}
+
+/* Returns true if NAME is "." or "..", which every directory
+   has and which cannot be added or removed. */
+static bool
+is_dot_name (const char *name)
+{
+  return !strcmp (name, ".") || !strcmp (name, "..");
+}
+
+/* Directory indexes. */
+
+/* Returns a hash value for index_entry E. */
+static unsigned
+index_entry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_string (hash_entry (e, struct index_entry, hash_elem)->name);
+}
+
+/* Returns true if index_entry A's name precedes B's. */
+static bool
+index_entry_less (const struct hash_elem *a, const struct hash_elem *b,
+                  void *aux UNUSED)
+{
+  return strcmp (hash_entry (a, struct index_entry, hash_elem)->name,
+                 hash_entry (b, struct index_entry, hash_elem)->name) < 0;
+}
+
+/* Frees the index_entry that hash element E is in. */
+static void
+index_entry_free (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct index_entry, hash_elem));
+}
+
+/* Frees INDEX and its entries. */
+static void
+index_destroy (struct dir_index *index)
+{
+  while (!list_empty (&index->free_slots))
+    free (list_entry (list_pop_front (&index->free_slots),
+                      struct index_entry, free_elem));
+  hash_destroy (&index->names, index_entry_free);
+  free (index);
+}
+
+/* Returns the in-use entry of INDEX named NAME, or a null
+   pointer if there is none. */
+static struct index_entry *
+index_lookup (struct dir_index *index, const char *name)
+{
+  struct index_entry key;
+  struct hash_elem *e;
+
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&index->names, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct index_entry, hash_elem) : NULL;
+}
+
+/* Reads the entries of DIR and returns a new index of them, or a
+   null pointer if memory runs out. */
+static struct dir_index *
+index_build (const struct dir *dir)
+{
+  enum { BATCH = 32 };
+  struct dir_index *index;
+  struct dir_entry *batch;
+  off_t ofs = 0;
+  bool ok = true;
+
+  index = malloc (sizeof *index);
+  batch = malloc (BATCH * sizeof *batch);
+  if (index == NULL || batch == NULL
+      || !hash_init (&index->names, index_entry_hash, index_entry_less, NULL))
+    {
+      free (index);
+      free (batch);
+      return NULL;
+    }
+  index->sector = inode_get_inumber (dir->inode);
+  index->accessed = true;
+  list_init (&index->free_slots);
+
+  while (ok)
+    {
+      off_t n = inode_read_at (dir->inode, batch, BATCH * sizeof *batch, ofs)
+                / sizeof *batch;
+      off_t i;
+
+      for (i = 0; ok && i < n; i++, ofs += sizeof *batch)
+        {
+          struct index_entry *ie = malloc (sizeof *ie);
+
+          ok = ie != NULL;
+          if (!ok)
+            break;
+          ie->ofs = ofs;
+          ie->inode_sector = batch[i].inode_sector;
+          strlcpy (ie->name, batch[i].name, sizeof ie->name);
+          if (!batch[i].in_use)
+            list_push_back (&index->free_slots, &ie->free_elem);
+          else if (hash_insert (&index->names, &ie->hash_elem) != NULL)
+            free (ie);                  /* Duplicate: first one wins. */
+        }
+      if (n < BATCH)
+        break;
+    }
+  index->end = ofs;
+  free (batch);
+
+  if (!ok)
+    {
+      index_destroy (index);
+      return NULL;
+    }
+  return index;
+}
+
+/* Returns the index of DIR if it has been built, otherwise a
+   null pointer.  dir_lock must be held. */
+static struct dir_index *
+index_find (const struct dir *dir)
+{
+  block_sector_t sector = inode_get_inumber (dir->inode);
+  struct list_elem *e;
+
+  for (e = list_begin (&dir_indexes); e != list_end (&dir_indexes);
+       e = list_next (e))
+    {
+      struct dir_index *index = list_entry (e, struct dir_index, elem);
+      if (index->sector == sector)
+        {
+          index->accessed = true;
+          return index;
+        }
+    }
+  return NULL;
+}
+
+/* Returns the index of DIR, building it if necessary and
+   evicting another index, by second chance, to make room.
+   Returns a null pointer if memory runs out.  dir_lock must be
+   held for writing. */
+static struct dir_index *
+index_get (const struct dir *dir)
+{
+  struct dir_index *index = index_find (dir);
+
+  if (index != NULL)
+    return index;
+
+  while (list_size (&dir_indexes) >= DIR_INDEX_CNT)
+    {
+      struct dir_index *victim = list_entry (list_pop_front (&dir_indexes),
+                                             struct dir_index, elem);
+      if (victim->accessed)
+        {
+          victim->accessed = false;
+          list_push_back (&dir_indexes, &victim->elem);
+        }
+      else
+        index_destroy (victim);
+    }
+
+  index = index_build (dir);
+  if (index != NULL)
+    list_push_back (&dir_indexes, &index->elem);
+  return index;
+}
+
+/* Discards the index of the directory in SECTOR, if any.
+   dir_lock must be held for writing. */
+static void
+index_drop (block_sector_t sector)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&dir_indexes); e != list_end (&dir_indexes);
+       e = list_next (e))
+    {
+      struct dir_index *index = list_entry (e, struct dir_index, elem);
+      if (index->sector == sector)
+        {
+          list_remove (e);
+          index_destroy (index);
+          return;
+        }
+    }
+}
+
+/* Acquires dir_lock to look names up in DIR.  If DIR's index has
+   been built, acquires it for reading and returns false.
+   Otherwise acquires it for writing, builds the index, and
+   returns true. */
+static bool
+lock_for_lookup (const struct dir *dir)
+{
+  rw_read_acquire (&dir_lock);
+  if (index_find (dir) != NULL)
+    return false;
+  rw_read_release (&dir_lock);
+
+  rw_write_acquire (&dir_lock);
+  index_get (dir);
+  return true;
+}
+
+/* Searches DIR for a file with the given NAME, using DIR's index
+   if it has one and otherwise reading every entry.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   dir_lock must be held. */
 static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
+  struct dir_index *index;
   struct dir_entry e;
   size_t ofs;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  index = index_find (dir);
+  if (index != NULL)
+    {
+      struct index_entry *ie = index_lookup (index, name);
+      if (ie == NULL)
+        return false;
+      if (ep != NULL)
+        {
+          ep->inode_sector = ie->inode_sector;
+          strlcpy (ep->name, ie->name, sizeof ep->name);
+          ep->in_use = true;
+        }
+      if (ofsp != NULL)
+        *ofsp = ie->ofs;
+      return true;
+    }
+
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
@@ -114,20 +431,48 @@ lookup (const struct dir *dir, const char *name,
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
-   a null pointer.  The caller must close *INODE. */
+   a null pointer.  The caller must close *INODE.
+   The directory entry cache answers first; only a miss there
+   searches DIR, and records what it finds, present or not. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  block_sector_t dir_sector;
+  block_sector_t sector;
   struct dir_entry e;
+  bool writing;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  /* Open the inode before letting go of dir_lock, so that it
+     cannot be removed and freed in between. */
+  dir_sector = inode_get_inumber (dir->inode);
+  rw_read_acquire (&dir_lock);
+  if (dcache_lookup (dir_sector, name, &sector))
+    {
+      *inode = sector != DCACHE_NEGATIVE ? inode_open (sector) : NULL;
+      rw_read_release (&dir_lock);
+      return *inode != NULL;
+    }
+  rw_read_release (&dir_lock);
+
+  writing = lock_for_lookup (dir);
   if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+    {
+      dcache_insert (dir_sector, name, e.inode_sector);
+      *inode = inode_open (e.inode_sector);
+    }
+  else
+    {
+      dcache_insert (dir_sector, name, DCACHE_NEGATIVE);
+      *inode = NULL;
+    }
+  if (writing)
+    rw_write_release (&dir_lock);
   else
-    *inode = NULL;
+    rw_read_release (&dir_lock);
 
   return *inode != NULL;
 }
@@ -141,6 +486,8 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
+  struct dir_index *index;
+  struct index_entry *slot = NULL;
   struct dir_entry e;
   off_t ofs;
   bool success = false;
@@ -152,10 +499,36 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  rw_write_acquire (&dir_lock);
+  index = index_get (dir);
+
+  /* Check that NAME is not in use, and that DIR, if it has been
+     removed while someone still had it open, is not given new
+     entries that nothing would ever free. */
+  if (inode_is_removed (dir->inode) || lookup (dir, name, NULL, NULL))
     goto done;
 
+  /* Take a free slot from the index, or a new one at the end of
+     the directory.  If there is no index, or memory for a new
+     index entry runs out, drop back to scanning the directory. */
+  if (index != NULL)
+    {
+      if (!list_empty (&index->free_slots))
+        slot = list_entry (list_pop_front (&index->free_slots),
+                           struct index_entry, free_elem);
+      else
+        {
+          slot = malloc (sizeof *slot);
+          if (slot != NULL)
+            slot->ofs = index->end;
+          else
+            {
+              index_drop (index->sector);
+              index = NULL;
+            }
+        }
+    }
+
   /* Set OFS to offset of free slot.
      If there are no free slots, then it will be set to the
      current end-of-file.
@@ -163,27 +536,68 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  if (slot != NULL)
+    ofs = slot->ofs;
+  else
+    for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+         ofs += sizeof e) 
+      if (!e.in_use)
+        break;
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (success)
+    dcache_insert (inode_get_inumber (dir->inode), name, inode_sector);
+
+  /* Record the new entry in the index, or give the slot back. */
+  if (slot != NULL)
+    {
+      if (success)
+        {
+          strlcpy (slot->name, name, sizeof slot->name);
+          slot->inode_sector = inode_sector;
+          hash_insert (&index->names, &slot->hash_elem);
+          if (ofs == index->end)
+            index->end += sizeof e;
+        }
+      else if (ofs < index->end)
+        list_push_front (&index->free_slots, &slot->free_elem);
+      else
+        free (slot);
+    }
 
  done:
+  rw_write_release (&dir_lock);
   return success;
 }
 
+/* Returns true if directory INODE has no entries besides "."
+   and "..".  dir_lock must be held. */
+static bool
+is_empty (struct inode *inode)
+{
+  struct dir_entry e;
+  off_t ofs;
+
+  for (ofs = 0; inode_read_at (inode, &e, sizeof e, ofs) == sizeof e;
+       ofs += sizeof e)
+    if (e.in_use && !is_dot_name (e.name))
+      return false;
+  return true;
+}
+
 /* Removes any entry for NAME in DIR.
-   Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   Returns true if successful, false on failure, which occurs if
+   there is no file with the given NAME, if NAME is "." or "..",
+   or if it is a directory that has entries or that is open, as
+   the working directory of a process for example. */
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
+  struct dir_index *index;
   struct dir_entry e;
   struct inode *inode = NULL;
   bool success = false;
@@ -192,6 +606,12 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  /* The journal before dir_lock, which operations under way may
+     need to finish.  The inode is closed after the operation,
+     since that may release all of its sectors. */
+  journal_begin (inode_write_log_max (sizeof e));
+  rw_write_acquire (&dir_lock);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -201,36 +621,149 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
+  /* Only an empty directory no one else is using may go. */
+  if (inode_is_dir (inode)
+      && (is_dot_name (name) || !is_empty (inode)
+          || inode_open_cnt (inode) > 1))
+    goto done;
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
 
+  /* Keep the index in step.  If the file was a directory, its
+     own index is now stale. */
+  index = index_find (dir);
+  if (index != NULL)
+    {
+      struct index_entry *ie = index_lookup (index, name);
+      hash_delete (&index->names, &ie->hash_elem);
+      list_push_front (&index->free_slots, &ie->free_elem);
+    }
+  index_drop (e.inode_sector);
+  dcache_insert (inode_get_inumber (dir->inode), name, DCACHE_NEGATIVE);
+  dcache_drop_dir (e.inode_sector);
+
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  rw_write_release (&dir_lock);
+  journal_end ();
   inode_close (inode);
   return success;
 }
 
-/* Reads the next directory entry in DIR and stores the name in
-   NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+/* Returns the most sectors dir_add() can log, for a journal
+   operation that calls it to reserve. */
+size_t
+dir_add_log_max (void)
+{
+  return inode_write_log_max (sizeof (struct dir_entry));
+}
+
+/* Reads the next directory entry in DIR, other than "." and
+   "..", and stores the name in NAME.  Returns true if
+   successful, false if the directory contains no more
+   entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
+  rw_read_acquire (&dir_lock);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
-      if (e.in_use)
+      if (e.in_use && !is_dot_name (e.name))
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
+          break;
         } 
     }
-  return false;
+  rw_read_release (&dir_lock);
+  return found;
+}
+
+/* Compares the sectors that A and B point to, for qsort(). */
+static int
+compare_sectors (const void *a_, const void *b_) 
+{
+  const block_sector_t *a = a_;
+  const block_sector_t *b = b_;
+  return *a < *b ? -1 : *a > *b;
+}
+
+/* Queues read-ahead of the CNT inode sectors in SECTORS, sorting
+   them first so that neighbouring inodes, as a directory of
+   files created together tends to have, go to disk as one
+   request. */
+static void
+prefetch_inodes (block_sector_t *sectors, size_t cnt) 
+{
+  size_t i;
+
+  qsort (sectors, cnt, sizeof *sectors, compare_sectors);
+  for (i = 0; i < cnt; ) 
+    {
+      block_sector_t start = sectors[i];
+      size_t run = 1;
+
+      for (i++; i < cnt && sectors[i] - start < CACHE_READ_AHEAD_MAX; i++)
+        if (sectors[i] == start + run)
+          run++;
+        else if (sectors[i] != start + run - 1)
+          break;
+      cache_read_ahead (start, run);
+    }
+}
+
+/* Reads up to MAX entries of DIR, other than "." and "..", into
+   ENTRIES along with each file's type, length, and inumber.  The
+   inode sectors of the whole batch are prefetched together
+   before any is opened, so that listing a directory with its
+   attributes costs a few large reads instead of one seek per
+   file.  Returns the number of entries read, 0 at the end of
+   DIR. */
+int
+dir_readdir_plus (struct dir *dir, struct dirent_plus *entries, int max)
+{
+  block_sector_t sectors[READDIR_PLUS_MAX];
+  struct dir_entry e;
+  int cnt = 0;
+  int i;
+
+  if (max > READDIR_PLUS_MAX)
+    max = READDIR_PLUS_MAX;
+
+  /* Hold dir_lock throughout, as dir_lookup() does, so that no
+     entry's inode is removed and freed before it is opened. */
+  rw_read_acquire (&dir_lock);
+  while (cnt < max
+         && inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+    {
+      dir->pos += sizeof e;
+      if (e.in_use && !is_dot_name (e.name))
+        {
+          strlcpy (entries[cnt].name, e.name, sizeof entries[cnt].name);
+          entries[cnt].inumber = e.inode_sector;
+          sectors[cnt++] = e.inode_sector;
+        }
+    }
+  if (cnt > 0)
+    prefetch_inodes (sectors, cnt);
+
+  for (i = 0; i < cnt; i++) 
+    {
+      struct inode *inode = inode_open (entries[i].inumber);
+      entries[i].is_dir = inode != NULL && inode_is_dir (inode);
+      entries[i].size = inode != NULL ? inode_length (inode) : 0;
+      inode_close (inode);
+    }
+  rw_read_release (&dir_lock);
+  return cnt;
 }
@@ -1,34 +1,81 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include <iovec.h>
+#include <poll.h>
+#include "devices/timer.h"
+#include "filesys/cache.h"
 #include "filesys/inode.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
 
+/* Most bytes read ahead of a sequential reader. */
+#define READ_AHEAD_MAX (4 * CACHE_READ_AHEAD_MAX * BLOCK_SECTOR_SIZE)
+
 /* An open file. */
 struct file 
   {
-    struct inode *inode;        /* File's inode. */
+    const struct file_ops *ops; /* Operations on NODE. */
+    void *node;                 /* File's inode or other object. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    int ref_cnt;                /* Users, each of which closes it. */
+
+    /* Read-ahead, for files on inodes. */
+    off_t ra_next;              /* Where a sequential read would start. */
+    off_t ra_end;               /* End of what was read ahead already. */
+    off_t ra_window;            /* Bytes to read ahead of ra_next. */
   };
 
+/* Cache of struct file, made and freed with every open and
+   close. */
+static struct kmem_cache *file_cache;
+
+static const struct file_ops inode_ops;
+static void read_ahead (struct file *, off_t offset, off_t bytes_read);
+
+/* Timer tick of the last read or write of a file on disk. */
+static int64_t last_io_ticks;
+
+/* Initializes the open file module. */
+void
+file_init (void) 
+{
+  file_cache = kmem_cache_create ("file", sizeof (struct file));
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
-  if (inode != NULL && file != NULL)
+  return file_open_ops (&inode_ops, inode);
+}
+
+/* Opens a file for NODE, of which it takes ownership, accessed
+   through OPS, and returns the new file.  Returns a null pointer
+   if an allocation fails or if NODE is null. */
+struct file *
+file_open_ops (const struct file_ops *ops, void *node) 
+{
+  struct file *file = kmem_cache_alloc (file_cache);
+  if (node != NULL && file != NULL)
     {
-      file->inode = inode;
+      file->ops = ops;
+      file->node = node;
       file->pos = 0;
       file->deny_write = false;
+      file->ref_cnt = 1;
+      file->ra_next = 0;
+      file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
     {
-      inode_close (inode);
-      free (file);
+      if (node != NULL)
+        ops->close (node);
+      kmem_cache_free (file_cache, file);
       return NULL; 
     }
 }
@@ -38,26 +85,55 @@ file_open (struct inode *inode)
 struct file *
 file_reopen (struct file *file) 
 {
-  return file_open (inode_reopen (file->inode));
+  return file_open_ops (file->ops, file->ops->reopen (file->node));
+}
+
+/* Returns FILE with one more user, which must close it with
+   file_close() on its own.  Unlike file_reopen(), both users
+   share the file's position and any denial of writes.  Processes
+   may share a file, hence the interrupts off around the count. */
+struct file *
+file_dup (struct file *file) 
+{
+  enum intr_level old_level = intr_disable ();
+  file->ref_cnt++;
+  intr_set_level (old_level);
+  return file;
 }
 
-/* Closes FILE. */
+/* Closes FILE, once every user it was given to by file_dup() has
+   closed it too. */
 void
 file_close (struct file *file) 
 {
   if (file != NULL)
     {
+      enum intr_level old_level = intr_disable ();
+      bool last = --file->ref_cnt == 0;
+      intr_set_level (old_level);
+
+      if (!last)
+        return;
       file_allow_write (file);
-      inode_close (file->inode);
-      free (file); 
+      file->ops->close (file->node);
+      kmem_cache_free (file_cache, file); 
     }
 }
 
-/* Returns the inode encapsulated by FILE. */
+/* Returns the inode encapsulated by FILE, or a null pointer if
+   FILE is not backed by an on-disk inode. */
 struct inode *
 file_get_inode (struct file *file) 
 {
-  return file->inode;
+  return file->ops == &inode_ops ? file->node : NULL;
+}
+
+/* Returns the object behind FILE if FILE was opened with
+   file_open_ops() and OPS, or a null pointer otherwise. */
+void *
+file_get_node (struct file *file, const struct file_ops *ops) 
+{
+  return file->ops == ops ? file->node : NULL;
 }
 
 /* Reads SIZE bytes from FILE into BUFFER,
@@ -68,7 +144,9 @@ file_get_inode (struct file *file)
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  off_t bytes_read = file->ops->read_at (file->node, buffer, size,
+                                         file->pos);
+  read_ahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -81,7 +159,10 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  off_t bytes_read = file->ops->read_at (file->node, buffer, size,
+                                         file_ofs);
+  read_ahead (file, file_ofs, bytes_read);
+  return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
@@ -94,7 +175,8 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written = file->ops->write_at (file->node, buffer, size,
+                                            file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
@@ -110,7 +192,139 @@ off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
-  return inode_write_at (file->inode, buffer, size, file_ofs);
+  return file->ops->write_at (file->node, buffer, size, file_ofs);
+}
+
+/* Reads from FILE, starting at its current position, into the CNT
+   segments of IOV in turn.  Stops early at end of file.  Returns
+   the number of bytes read and advances FILE's position by that
+   much. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int cnt)
+{
+  off_t total = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      off_t bytes_read = file->ops->read_at (file->node, iov[i].iov_base,
+                                             iov[i].iov_len, file->pos);
+      read_ahead (file, file->pos, bytes_read);
+      file->pos += bytes_read;
+      total += bytes_read;
+      if ((size_t) bytes_read < iov[i].iov_len)
+        break;
+    }
+  return total;
+}
+
+/* Writes the CNT segments of IOV in turn to FILE, starting at its
+   current position.  Stops early if a segment is only partly
+   written.  Returns the number of bytes written and advances
+   FILE's position by that much. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int cnt)
+{
+  off_t total = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      off_t bytes_written = file->ops->write_at (file->node,
+                                                 iov[i].iov_base,
+                                                 iov[i].iov_len, file->pos);
+      file->pos += bytes_written;
+      total += bytes_written;
+      if ((size_t) bytes_written < iov[i].iov_len)
+        break;
+    }
+  return total;
+}
+
+/* Copies up to SIZE bytes from SRC, starting at its current
+   position, to DST at its current position, without the data
+   leaving the kernel.  Stops early at end of SRC or if DST cannot
+   take more.  Returns the number of bytes copied and advances
+   both positions by that much.
+   While both positions are sector-aligned, whole sectors are
+   copied block to block by inode_copy_sector().  Anything else
+   goes through a sector-sized bounce buffer. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size) 
+{
+  uint8_t *bounce = NULL;
+  off_t total = 0;
+
+  while (size > 0) 
+    {
+      off_t chunk, bytes_read, bytes_written;
+
+      if (src->ops == &inode_ops && dst->ops == &inode_ops
+          && src->node != dst->node && !inode_is_dir (dst->node)
+          && size >= BLOCK_SECTOR_SIZE
+          && src->pos % BLOCK_SECTOR_SIZE == 0
+          && dst->pos % BLOCK_SECTOR_SIZE == 0
+          && inode_copy_sector (dst->node, dst->pos, src->node, src->pos))
+        {
+          src->pos += BLOCK_SECTOR_SIZE;
+          dst->pos += BLOCK_SECTOR_SIZE;
+          total += BLOCK_SECTOR_SIZE;
+          size -= BLOCK_SECTOR_SIZE;
+          continue;
+        }
+
+      if (bounce == NULL) 
+        {
+          bounce = malloc (BLOCK_SECTOR_SIZE);
+          if (bounce == NULL)
+            break;
+        }
+
+      /* Up to the end of SRC's sector, so the next chunk starts
+         aligned in SRC. */
+      chunk = BLOCK_SECTOR_SIZE - src->pos % BLOCK_SECTOR_SIZE;
+      if (chunk > size)
+        chunk = size;
+      bytes_read = src->ops->read_at (src->node, bounce, chunk, src->pos);
+      if (bytes_read == 0)
+        break;
+      bytes_written = dst->ops->write_at (dst->node, bounce, bytes_read,
+                                          dst->pos);
+      src->pos += bytes_written;
+      dst->pos += bytes_written;
+      total += bytes_written;
+      size -= bytes_written;
+      if (bytes_written < bytes_read || bytes_read < chunk)
+        break;
+    }
+  free (bounce);
+  return total;
+}
+
+/* Extends FILE to LENGTH bytes, if it is shorter, with the
+   sectors it has yet to write set aside in one run, as
+   inode_allocate() does.  Returns true if successful, false if
+   FILE is not a file on disk or the space could not be found. */
+bool
+file_allocate (struct file *file, off_t length) 
+{
+  ASSERT (file != NULL);
+  if (file->ops != &inode_ops)
+    return false;
+  return inode_allocate (file->node, length);
+}
+
+/* Writes what has been written to FILE to disk, as
+   inode_sync() does.  Returns true if successful, false if FILE
+   is not a file on disk. */
+bool
+file_sync (struct file *file) 
+{
+  ASSERT (file != NULL);
+  if (file->ops != &inode_ops)
+    return false;
+  inode_sync (file->node);
+  return true;
 }
 
 /* Prevents write operations on FILE's underlying inode
@@ -122,7 +336,7 @@ file_deny_write (struct file *file)
   if (!file->deny_write) 
     {
       file->deny_write = true;
-      inode_deny_write (file->inode);
+      file->ops->deny_write (file->node);
     }
 }
 
@@ -136,16 +350,37 @@ file_allow_write (struct file *file)
   if (file->deny_write) 
     {
       file->deny_write = false;
-      inode_allow_write (file->inode);
+      file->ops->allow_write (file->node);
     }
 }
 
+/* Returns the timer tick at which a file on disk was last read
+   or written through an open file, so that background work on
+   the disk can stay out of the way of processes using it. */
+int64_t
+file_last_io (void) 
+{
+  return last_io_ticks;
+}
+
 /* Returns the size of FILE in bytes. */
 off_t
 file_length (struct file *file) 
 {
   ASSERT (file != NULL);
-  return inode_length (file->inode);
+  return file->ops->length (file->node);
+}
+
+/* Returns the POLL* events that hold for FILE, putting ENTRY, if
+   nonnull, on the wait queue woken when they change.  Files
+   whose reads and writes never wait are always ready. */
+int
+file_poll (struct file *file, struct waitq_entry *entry) 
+{
+  ASSERT (file != NULL);
+  if (file->ops->poll == NULL)
+    return POLLIN | POLLOUT;
+  return file->ops->poll (file->node, entry);
 }
 
 /* Sets the current position in FILE to NEW_POS bytes from the
@@ -166,3 +401,103 @@ file_tell (struct file *file)
   ASSERT (file != NULL);
   return file->pos;
 }
+
+/* Notes that BYTES_READ bytes were just read from FILE at
+   OFFSET, and reads ahead if that continues a sequential run.
+   The window read ahead starts at one sector and doubles with
+   each read that carries on where the last one stopped, up to
+   READ_AHEAD_MAX; a read anywhere else closes it again.  Only
+   what was not read ahead before is asked for.  FILE may be
+   shared, but a lost update here only costs some read-ahead. */
+static void
+read_ahead (struct file *file, off_t offset, off_t bytes_read) 
+{
+  off_t start, end;
+
+  if (file->ops != &inode_ops || bytes_read <= 0)
+    return;
+
+  if (offset != file->ra_next) 
+    {
+      file->ra_next = offset + bytes_read;
+      file->ra_end = 0;
+      file->ra_window = 0;
+      return;
+    }
+  if (file->ra_window == 0)
+    file->ra_window = BLOCK_SECTOR_SIZE;
+  else if (file->ra_window < READ_AHEAD_MAX)
+    file->ra_window *= 2;
+
+  file->ra_next = offset + bytes_read;
+  start = file->ra_end > file->ra_next ? file->ra_end : file->ra_next;
+  end = file->ra_next + file->ra_window;
+  if (end > start) 
+    {
+      inode_read_ahead (file->node, start, end - start);
+      file->ra_end = end;
+    }
+}
+
+/* File operations on on-disk inodes. */
+
+static off_t
+inode_ops_read_at (void *inode, void *buffer, off_t size, off_t offset)
+{
+  last_io_ticks = timer_ticks ();
+  return inode_read_at (inode, buffer, size, offset);
+}
+
+/* A directory's entries change only through dir_add() and
+   dir_remove(), never by writing to it as a file. */
+static off_t
+inode_ops_write_at (void *inode, const void *buffer, off_t size,
+                    off_t offset)
+{
+  if (inode_is_dir (inode))
+    return 0;
+  last_io_ticks = timer_ticks ();
+  return inode_write_at (inode, buffer, size, offset);
+}
+
+static off_t
+inode_ops_length (void *inode)
+{
+  return inode_length (inode);
+}
+
+static void *
+inode_ops_reopen (void *inode)
+{
+  return inode_reopen (inode);
+}
+
+static void
+inode_ops_close (void *inode)
+{
+  inode_close (inode);
+}
+
+static void
+inode_ops_deny_write (void *inode)
+{
+  inode_deny_write (inode);
+}
+
+static void
+inode_ops_allow_write (void *inode)
+{
+  inode_allow_write (inode);
+}
+
+static const struct file_ops inode_ops =
+  {
+    inode_ops_read_at,
+    inode_ops_write_at,
+    inode_ops_length,
+    inode_ops_reopen,
+    inode_ops_close,
+    inode_ops_deny_write,
+    inode_ops_allow_write,
+    NULL
+  };
@@ -1,21 +1,55 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
+#include <stdint.h>
 #include "filesys/off_t.h"
 
 struct inode;
+struct iovec;
+struct waitq_entry;
+
+/* Operations on the object behind an open file, which is an
+   on-disk inode for files opened with file_open() or something
+   else for files opened with file_open_ops().  NODE is the
+   object passed to file_open_ops(). */
+struct file_ops
+  {
+    off_t (*read_at) (void *node, void *, off_t size, off_t offset);
+    off_t (*write_at) (void *node, const void *, off_t size, off_t offset);
+    off_t (*length) (void *node);
+    void *(*reopen) (void *node);       /* Returns NODE, reopened. */
+    void (*close) (void *node);
+    void (*deny_write) (void *node);
+    void (*allow_write) (void *node);
+
+    /* Returns the POLL* events of <poll.h> that hold for NODE,
+       first putting ENTRY, if nonnull, on the wait queue woken
+       when they change.  Null for objects that never make their
+       users wait, which are always ready. */
+    int (*poll) (void *node, struct waitq_entry *entry);
+  };
 
 /* Opening and closing files. */
+void file_init (void);
 struct file *file_open (struct inode *);
+struct file *file_open_ops (const struct file_ops *, void *node);
 struct file *file_reopen (struct file *);
+struct file *file_dup (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
+void *file_get_node (struct file *, const struct file_ops *);
 
 /* Reading and writing. */
 off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_readv (struct file *, const struct iovec *, int cnt);
+off_t file_writev (struct file *, const struct iovec *, int cnt);
+off_t file_copy (struct file *dst, struct file *src, off_t size);
+bool file_allocate (struct file *, off_t length);
+bool file_sync (struct file *);
 
 /* Preventing writes. */
 void file_deny_write (struct file *);
@@ -25,5 +59,9 @@ void file_allow_write (struct file *);
 void file_seek (struct file *, off_t);
 off_t file_tell (struct file *);
 off_t file_length (struct file *);
+int64_t file_last_io (void);
+
+/* Waiting. */
+int file_poll (struct file *, struct waitq_entry *);
 
 #endif /* filesys/file.h */
@@ -1,16 +1,35 @@
 #include "filesys/filesys.h"
 #include <debug.h>
+#include <dirent.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
+#include "filesys/defrag.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
+#include "filesys/tarfs.h"
+#include "filesys/tmpfs.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#ifdef USERPROG
+#include "userprog/process.h"
+#endif
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
 static void do_format (void);
+static const char *mount_name (const char *name, const char *mount);
+static const char *tmpfs_name (const char *name);
+static const char *tarfs_name (const char *name);
+static struct dir *resolve (const char *path, char name[NAME_MAX + 1]);
+static struct dir *resolve_batch (const char *path, char name[NAME_MAX + 1],
+                                  const char **prev, struct dir **prev_dir);
+static struct inode *lookup (struct dir *, const char *name);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -21,13 +40,20 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  cache_init ();
+  journal_init (format);
   inode_init ();
+  file_init ();
+  dir_init ();
+  dcache_init ();
   free_map_init ();
+  tmpfs_init ();
 
   if (format) 
     do_format ();
 
   free_map_open ();
+  defrag_init ();
 }
 
 /* Shuts down the file system module, writing any unwritten data
@@ -36,9 +62,12 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  journal_commit ();
+  cache_flush ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
+   NAME is a path, absolute or relative to the working directory.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
    or if internal memory allocation fails. */
@@ -46,19 +75,60 @@ bool
 filesys_create (const char *name, off_t initial_size) 
 {
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+  char base[NAME_MAX + 1];
+  struct dir *dir;
+  bool success;
+
+  if (tmpfs_name (name) != NULL)
+    return tmpfs_create (tmpfs_name (name), initial_size);
+  if (tarfs_name (name) != NULL)
+    return false;
+
+  dir = resolve (name, base);
+  /* The new inode, its free map sector, and the entry. */
+  journal_begin (2 + dir_add_log_max ());
+  success = (dir != NULL && *base != '\0'
+             && free_map_allocate (1, &inode_sector)
+             && inode_create (inode_sector, initial_size, false)
+             && dir_add (dir, base, inode_sector));
+  if (!success && inode_sector != 0) 
+    free_map_release (inode_sector, 1);
+  journal_end ();
+  dir_close (dir);
+
+  return success;
+}
+
+/* Creates a directory named NAME, a path like filesys_create()'s.
+   Returns true if successful, false if NAME already exists, its
+   parent does not, or memory or disk space runs out. */
+bool
+filesys_mkdir (const char *name) 
+{
+  block_sector_t inode_sector = 0;
+  char base[NAME_MAX + 1];
+  struct dir *dir;
+  bool success;
+
+  dir = resolve (name, base);
+  /* As for filesys_create(): the new directory is small enough to
+     keep "." and ".." in its inode. */
+  journal_begin (2 + dir_add_log_max ());
+  success = (dir != NULL && *base != '\0'
+             && free_map_allocate (1, &inode_sector)
+             && dir_create (inode_sector, 16,
+                            inode_get_inumber (dir_get_inode (dir)))
+             && dir_add (dir, base, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
+  journal_end ();
   dir_close (dir);
 
   return success;
 }
 
-/* Opens the file with the given NAME.
+/* Opens the file or directory with the given NAME, a path like
+   filesys_create()'s.
    Returns the new file if successful or a null pointer
    otherwise.
    Fails if no file named NAME exists,
@@ -66,38 +136,419 @@ filesys_create (const char *name, off_t initial_size)
 struct file *
 filesys_open (const char *name)
 {
-  struct dir *dir = dir_open_root ();
+  char base[NAME_MAX + 1];
+  struct dir *dir;
   struct inode *inode = NULL;
 
+  if (tmpfs_name (name) != NULL)
+    return tmpfs_open (tmpfs_name (name));
+  if (tarfs_name (name) != NULL)
+    return tarfs_open (tarfs_name (name));
+
+  dir = resolve (name, base);
   if (dir != NULL)
-    dir_lookup (dir, name, &inode);
+    inode = lookup (dir, base);
   dir_close (dir);
 
   return file_open (inode);
 }
 
-/* Deletes the file named NAME.
+/* Deletes the file named NAME, a path like filesys_create()'s.
+   A directory must be empty and not in use.
    Returns true if successful, false on failure.
    Fails if no file named NAME exists,
    or if an internal memory allocation fails. */
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  char base[NAME_MAX + 1];
+  struct dir *dir;
+  bool success;
+
+  if (tmpfs_name (name) != NULL)
+    return tmpfs_remove (tmpfs_name (name));
+  if (tarfs_name (name) != NULL)
+    return false;
+
+  dir = resolve (name, base);
+  success = dir != NULL && *base != '\0' && dir_remove (dir, base);
   dir_close (dir); 
 
   return success;
 }
-
+
+/* Creates a file of INITIAL_SIZE bytes for each of the CNT paths
+   in NAMES, setting OK[i] to whether NAMES[i] was created as
+   filesys_create() would.  Consecutive names in the same
+   directory share one walk of their path, and each creation is
+   its own journal operation, so that a failure partway leaves the
+   others in place.  Returns the number created. */
+int
+filesys_create_many (const char *const names[], off_t initial_size,
+                     bool ok[], int cnt) 
+{
+  const char *prev = NULL;
+  struct dir *prev_dir = NULL;
+  int created = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++) 
+    {
+      block_sector_t inode_sector = 0;
+      char base[NAME_MAX + 1];
+      struct dir *dir;
+
+      if (tmpfs_name (names[i]) != NULL || tarfs_name (names[i]) != NULL)
+        {
+          ok[i] = filesys_create (names[i], initial_size);
+          created += ok[i];
+          continue;
+        }
+
+      dir = resolve_batch (names[i], base, &prev, &prev_dir);
+      journal_begin (2 + dir_add_log_max ());
+      ok[i] = (dir != NULL && *base != '\0'
+               && free_map_allocate (1, &inode_sector)
+               && inode_create (inode_sector, initial_size, false)
+               && dir_add (dir, base, inode_sector));
+      if (!ok[i] && inode_sector != 0) 
+        free_map_release (inode_sector, 1);
+      journal_end ();
+      dir_close (dir);
+      created += ok[i];
+      cond_resched ();
+    }
+  dir_close (prev_dir);
+
+  return created;
+}
+
+/* Deletes each of the CNT paths in NAMES as filesys_remove()
+   would, setting OK[i] to whether NAMES[i] was deleted, and
+   sharing path walks as filesys_create_many() does.  Returns the
+   number deleted. */
+int
+filesys_remove_many (const char *const names[], bool ok[], int cnt) 
+{
+  const char *prev = NULL;
+  struct dir *prev_dir = NULL;
+  int removed = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++) 
+    {
+      char base[NAME_MAX + 1];
+      struct dir *dir;
+
+      if (tmpfs_name (names[i]) != NULL || tarfs_name (names[i]) != NULL)
+        {
+          ok[i] = filesys_remove (names[i]);
+          removed += ok[i];
+          continue;
+        }
+
+      dir = resolve_batch (names[i], base, &prev, &prev_dir);
+      ok[i] = dir != NULL && *base != '\0' && dir_remove (dir, base);
+      dir_close (dir);
+      removed += ok[i];
+      cond_resched ();
+    }
+  dir_close (prev_dir);
+
+  return removed;
+}
+
+/* Looks up each of the CNT paths in NAMES, storing in ENTRIES[i]
+   the last component of NAMES[i] with its file's type, length
+   and inumber, or an empty name if there is no such file.  Path
+   walks are shared as in filesys_create_many().  Returns the
+   number found. */
+int
+filesys_stat_many (const char *const names[], struct dirent_plus *entries,
+                   int cnt) 
+{
+  const char *prev = NULL;
+  struct dir *prev_dir = NULL;
+  int found = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++) 
+    {
+      struct dirent_plus *e = &entries[i];
+      const char *slash = strrchr (names[i], '/');
+      char base[NAME_MAX + 1];
+      struct dir *dir;
+      struct inode *inode = NULL;
+
+      e->name[0] = '\0';
+      if (tmpfs_name (names[i]) != NULL || tarfs_name (names[i]) != NULL)
+        {
+          struct file *file = filesys_open (names[i]);
+
+          if (file != NULL)
+            {
+              strlcpy (e->name, slash != NULL ? slash + 1 : names[i],
+                       sizeof e->name);
+              e->is_dir = false;
+              e->inumber = -1;
+              e->size = file_length (file);
+              file_close (file);
+              found++;
+            }
+          continue;
+        }
+
+      dir = resolve_batch (names[i], base, &prev, &prev_dir);
+      if (dir != NULL)
+        inode = lookup (dir, base);
+      dir_close (dir);
+      if (inode != NULL)
+        {
+          strlcpy (e->name, base, sizeof e->name);
+          e->is_dir = inode_is_dir (inode);
+          e->inumber = inode_get_inumber (inode);
+          e->size = inode_length (inode);
+          inode_close (inode);
+          found++;
+        }
+    }
+  dir_close (prev_dir);
+
+  return found;
+}
+
+/* Makes the directory named NAME the current process's working
+   directory.  Returns true if successful, false if NAME is not a
+   directory. */
+bool
+filesys_chdir (const char *name) 
+{
+  char base[NAME_MAX + 1];
+  struct dir *dir, *cwd = NULL;
+  struct inode *inode = NULL;
+
+  dir = resolve (name, base);
+  if (dir != NULL)
+    inode = lookup (dir, base);
+  dir_close (dir);
+  if (inode == NULL || !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return false;
+    }
+  cwd = dir_open (inode);
+  if (cwd == NULL)
+    return false;
+
+#ifdef USERPROG
+  {
+    struct process *p = thread_current ()->process;
+    struct dir *old;
+
+    if (p != NULL)
+      {
+        lock_acquire (&p->files_lock);
+        old = p->cwd;
+        p->cwd = cwd;
+        lock_release (&p->files_lock);
+        cwd = old;
+      }
+  }
+#endif
+  dir_close (cwd);
+  return true;
+}
+
+/* Returns the directory that relative paths start from: the
+   current process's working directory, or the root directory
+   for a kernel thread or a process that has none.  The caller
+   must close it. */
+struct dir *
+filesys_open_cwd (void) 
+{
+#ifdef USERPROG
+  struct process *p = thread_current ()->process;
+
+  if (p != NULL)
+    {
+      struct dir *dir = NULL;
+
+      lock_acquire (&p->files_lock);
+      if (p->cwd != NULL)
+        dir = dir_reopen (p->cwd);
+      lock_release (&p->files_lock);
+      if (dir != NULL)
+        return dir;
+    }
+#endif
+  return dir_open_root ();
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, 16, ROOT_DIR_SECTOR))
     PANIC ("root directory creation failed");
   free_map_close ();
   printf ("done.\n");
 }
+
+/* If NAME is under mount point MOUNT, returns its name within
+   the mount; otherwise, returns a null pointer. */
+static const char *
+mount_name (const char *name, const char *mount) 
+{
+  size_t len = strlen (mount);
+  if (strnlen (name, len) < len || memcmp (name, mount, len))
+    return NULL;
+  return name + len;
+}
+
+/* If NAME is under the tmpfs mount point, returns its name
+   within tmpfs; otherwise, returns a null pointer. */
+static const char *
+tmpfs_name (const char *name) 
+{
+  return mount_name (name, TMPFS_MOUNT);
+}
+
+/* If the scratch archive is mounted and NAME is under its mount
+   point, returns its name within the archive; otherwise, returns
+   a null pointer. */
+static const char *
+tarfs_name (const char *name) 
+{
+  return tarfs_is_mounted () ? mount_name (name, TARFS_MOUNT) : NULL;
+}
+
+/* Copies the next component of the path at *SRCP into PART and
+   advances *SRCP past it.  Returns 1 if successful, 0 at the end
+   of the path, or -1 if the component is longer than NAME_MAX. */
+static int
+get_next_part (char part[NAME_MAX + 1], const char **srcp) 
+{
+  const char *src = *srcp;
+  char *dst = part;
+
+  /* Skip leading slashes.  If it's all slashes, we're done. */
+  while (*src == '/')
+    src++;
+  if (*src == '\0')
+    return 0;
+
+  /* Copy up to NAME_MAX characters from SRC to DST.  Add null
+     terminator. */
+  while (*src != '/' && *src != '\0') 
+    {
+      if (dst < part + NAME_MAX)
+        *dst++ = *src;
+      else
+        return -1;
+      src++; 
+    }
+  *dst = '\0';
+
+  /* Advance source pointer. */
+  *srcp = src;
+  return 1;
+}
+
+/* Walks PATH, which starts from the root directory if it begins
+   with "/" and from the working directory otherwise, through
+   every component but the last.  Returns the directory reached,
+   which the caller must close, and stores the last component in
+   NAME, or the empty string if PATH is just slashes.  Returns a
+   null pointer if PATH is empty, or a component is too long,
+   missing, or not a directory. */
+static struct dir *
+resolve (const char *path, char name[NAME_MAX + 1]) 
+{
+  char next[NAME_MAX + 1];
+  struct dir *dir;
+  int ok;
+
+  if (*path == '\0')
+    return NULL;
+  dir = *path == '/' ? dir_open_root () : filesys_open_cwd ();
+  if (dir == NULL)
+    return NULL;
+
+  *name = '\0';
+  ok = get_next_part (name, &path);
+  while (ok > 0)
+    {
+      struct inode *inode;
+
+      ok = get_next_part (next, &path);
+      if (ok == 0)
+        return dir;
+      if (ok < 0)
+        break;
+
+      /* NAME is not the last component, so it must be a
+         directory to go into. */
+      inode = NULL;
+      if (!dir_lookup (dir, name, &inode) || !inode_is_dir (inode))
+        {
+          inode_close (inode);
+          break;
+        }
+      dir_close (dir);
+      dir = dir_open (inode);
+      if (dir == NULL)
+        return NULL;
+      strlcpy (name, next, NAME_MAX + 1);
+    }
+  if (ok == 0)
+    return dir;
+  dir_close (dir);
+  return NULL;
+}
+
+/* Like resolve(), for one of a batch of paths.  *PREV is the
+   last path in the batch that resolve() walked, or a null pointer
+   before the first, and *PREV_DIR the directory it found there,
+   which the caller must close after the batch.  If PATH names an
+   entry of the same directory, spelled the same way up to its
+   last slash, that directory is reopened instead of walking
+   PATH again. */
+static struct dir *
+resolve_batch (const char *path, char name[NAME_MAX + 1],
+               const char **prev, struct dir **prev_dir) 
+{
+  const char *slash = strrchr (path, '/');
+  size_t len = slash != NULL ? (size_t) (slash - path + 1) : 0;
+  struct dir *dir;
+
+  if (*prev_dir != NULL && path[len] != '\0'
+      && strlen (path + len) <= NAME_MAX
+      && strrchr (*prev, '/') == (len > 0 ? *prev + len - 1 : NULL)
+      && memcmp (path, *prev, len) == 0)
+    {
+      strlcpy (name, path + len, NAME_MAX + 1);
+      return dir_reopen (*prev_dir);
+    }
+
+  dir = resolve (path, name);
+  dir_close (*prev_dir);
+  *prev = path;
+  *prev_dir = dir != NULL ? dir_reopen (dir) : NULL;
+  return dir;
+}
+
+/* Returns the inode named NAME in DIR, which the caller must
+   close, DIR itself if NAME is empty, or a null pointer if there
+   is none. */
+static struct inode *
+lookup (struct dir *dir, const char *name) 
+{
+  struct inode *inode = NULL;
+
+  if (*name == '\0')
+    return inode_reopen (dir_get_inode (dir));
+  dir_lookup (dir, name, &inode);
+  return inode;
+}
@@ -4,9 +4,16 @@
 #include <stdbool.h>
 #include "filesys/off_t.h"
 
+struct dir;
+struct dirent_plus;
+
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define JOURNAL_SECTOR 2        /* Start of the metadata journal. */
+
+/* Pages of guarded kernel stack for the file system's threads. */
+#define FILESYS_STACK_PAGES 4
 
 /* Block device that contains the file system. */
 extern struct block *fs_device;
@@ -16,5 +23,13 @@ void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
+int filesys_create_many (const char *const names[], off_t initial_size,
+                         bool ok[], int cnt);
+int filesys_remove_many (const char *const names[], bool ok[], int cnt);
+int filesys_stat_many (const char *const names[], struct dirent_plus *,
+                       int cnt);
+bool filesys_mkdir (const char *name);
+bool filesys_chdir (const char *name);
+struct dir *filesys_open_cwd (void);
 
 #endif /* filesys/filesys.h */
@@ -1,40 +1,195 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
+#include <stdint.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct lock free_map_lock;    /* Protects everything here. */
+
+/* Summary of the free extents in each group of GROUP_BITS
+   sectors, kept up to date with free_map.  An allocation looks
+   at the summaries to pick a group, or a chain of groups, that
+   has room for it, and scans the bitmap only within that group,
+   instead of scanning run after run of the whole map. */
+#define GROUP_BITS 256
+
+struct group
+  {
+    uint16_t head;              /* Free sectors at the start. */
+    uint16_t tail;              /* Free sectors at the end. */
+    uint16_t longest;           /* Longest free run inside. */
+  };
+
+static struct group *groups;    /* One per group of sectors. */
+static size_t group_cnt;        /* Number of groups. */
+static size_t next_group;       /* Where allocation starts looking. */
+
+static void summarize (block_sector_t, size_t cnt);
 
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
+  lock_init_named (&free_map_lock, "free map");
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+
+  group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_BITS);
+  groups = malloc (group_cnt * sizeof *groups);
+  if (groups == NULL)
+    PANIC ("free map summary allocation failed");
+  summarize (0, bitmap_size (free_map));
+}
+
+/* Returns the number of sectors in group G, which is less than
+   GROUP_BITS only for the last group. */
+static size_t
+group_size (size_t g) 
+{
+  size_t start = g * GROUP_BITS;
+  size_t left = bitmap_size (free_map) - start;
+  return left < GROUP_BITS ? left : GROUP_BITS;
+}
+
+/* Recomputes the summary of every group that holds any of the
+   CNT sectors starting at SECTOR. */
+static void
+summarize (block_sector_t sector, size_t cnt) 
+{
+  size_t g, last;
+
+  if (cnt == 0)
+    return;
+  last = (sector + cnt - 1) / GROUP_BITS;
+  for (g = sector / GROUP_BITS; g <= last; g++) 
+    {
+      size_t start = g * GROUP_BITS;
+      size_t end = start + group_size (g);
+      size_t ofs = start;
+      struct group *grp = &groups[g];
+
+      grp->head = grp->tail = grp->longest = 0;
+      while (ofs < end) 
+        {
+          size_t run_start = bitmap_scan (free_map, ofs, 1, false);
+          size_t run_end;
+
+          if (run_start == BITMAP_ERROR || run_start >= end)
+            break;
+          run_end = bitmap_scan (free_map, run_start, 1, true);
+          if (run_end == BITMAP_ERROR || run_end > end)
+            run_end = end;
+          if (run_start == start)
+            grp->head = run_end - run_start;
+          if (run_end == end)
+            grp->tail = run_end - run_start;
+          if (run_end - run_start > grp->longest)
+            grp->longest = run_end - run_start;
+          ofs = run_end;
+        }
+    }
+}
+
+/* Returns the first sector of a run of CNT free sectors, or
+   BITMAP_ERROR if there is none.  Looks at the groups in turn
+   from next_group: a group whose longest run is long enough is
+   scanned for its first fit, and otherwise the free tail of a
+   group may begin a run that continues through groups that are
+   entirely free into the head of the next. */
+static block_sector_t
+find_run (size_t cnt) 
+{
+  size_t i;
+
+  for (i = 0; i < group_cnt; i++) 
+    {
+      size_t g = (next_group + i) % group_cnt;
+      size_t run, h;
+
+      if (groups[g].longest >= cnt)
+        return bitmap_scan (free_map, g * GROUP_BITS, cnt, false);
+      if (groups[g].tail == 0)
+        continue;
+
+      run = groups[g].tail;
+      for (h = g + 1; h < group_cnt && run < cnt; h++) 
+        {
+          run += groups[h].head;
+          if (groups[h].head < group_size (h))
+            break;
+        }
+      if (run >= cnt)
+        return g * GROUP_BITS + group_size (g) - groups[g].tail;
+    }
+  return BITMAP_ERROR;
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
+   the first into *SECTORP.  Only the part of the free map file
+   that holds the new bits is written, through the journal, which
+   gathers many allocations into one commit.
    Returns true if successful, false if not enough consecutive
    sectors were available or if the free_map file could not be
    written. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  return free_map_allocate_near (0, cnt, sectorp);
+}
+
+/* Like free_map_allocate(), but takes the CNT sectors starting at
+   GOAL if they are all free.  A GOAL of 0 expresses no
+   preference, since sector 0 is never free. */
+bool
+free_map_allocate_near (block_sector_t goal, size_t cnt,
+                        block_sector_t *sectorp)
+{
+  block_sector_t sector;
+
+  /* The journal before the lock: an operation under way may need
+     the lock to finish, and journal_begin() may wait for it. */
+  journal_begin (free_map_log_cnt (cnt));
+  lock_acquire (&free_map_lock);
+  if (goal != 0 && goal + cnt <= bitmap_size (free_map)
+      && bitmap_none (free_map, goal, cnt)) 
+    {
+      bitmap_set_multiple (free_map, goal, cnt, true);
+      sector = goal;
+    }
+  else 
+    {
+      sector = find_run (cnt);
+      if (sector != BITMAP_ERROR) 
+        {
+          bitmap_set_multiple (free_map, sector, cnt, true);
+          next_group = (sector + cnt) / GROUP_BITS % group_cnt;
+        }
+    }
+  if (sector != BITMAP_ERROR) 
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      summarize (sector, cnt);
+      if (free_map_file != NULL
+          && !bitmap_write_range (free_map, free_map_file, sector, cnt))
+        {
+          bitmap_set_multiple (free_map, sector, cnt, false); 
+          summarize (sector, cnt);
+          sector = BITMAP_ERROR;
+        }
     }
+  lock_release (&free_map_lock);
+  journal_end ();
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
@@ -44,9 +199,25 @@ free_map_allocate (size_t cnt, block_sector_t *sectorp)
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  journal_begin (free_map_log_cnt (cnt));
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  summarize (sector, cnt);
+  bitmap_write_range (free_map, free_map_file, sector, cnt);
+  lock_release (&free_map_lock);
+  journal_end ();
+}
+
+/* Returns the most sectors of the free map file that allocating
+   or releasing a run of CNT sectors writes, and so logs: those
+   that the run's bits can straddle. */
+size_t
+free_map_log_cnt (size_t cnt) 
+{
+  size_t bits = BLOCK_SECTOR_SIZE * 8;
+
+  return cnt > 0 ? DIV_ROUND_UP (cnt - 1, bits) + 1 : 0;
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -58,9 +229,11 @@ free_map_open (void)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  summarize (0, bitmap_size (free_map));
 }
 
-/* Writes the free map to disk and closes the free map file. */
+/* Closes the free map file.  Every change to the free map has
+   already been written to it. */
 void
 free_map_close (void) 
 {
@@ -73,7 +246,7 @@ void
 free_map_create (void) 
 {
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
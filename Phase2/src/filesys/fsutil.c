@@ -9,6 +9,7 @@
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* List files in the root directory. */
@@ -135,6 +136,7 @@ fsutil_extract (char **argv UNUSED)
                 PANIC ("%s: write failed with %d bytes unwritten",
                        file_name, size);
               size -= chunk_size;
+              cond_resched ();
             }
 
           /* Finish up. */
@@ -208,6 +210,7 @@ fsutil_append (char **argv)
       memset (buffer + chunk_size, 0, BLOCK_SECTOR_SIZE - chunk_size);
       block_write (dst, sector++, buffer);
       size -= chunk_size;
+      cond_resched ();
     }
 
   /* Write ustar end-of-archive marker, which is two consecutive
@@ -1,23 +1,102 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of data sectors an inode points to directly. */
+#define DIRECT_CNT 121
+
+/* Number of sector numbers in an indirect block. */
+#define PTRS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/* Most sectors an open inode reserves at once for data. */
+#define RESERVE_MAX 16
+
+/* Most sectors inode_defrag() moves in one journal operation. */
+#define DEFRAG_CHUNK 8
+
+/* Most sectors allocating one data sector logs: the sector itself
+   if it is metadata, the free map sectors that it or a new
+   reservation lies in, and the two index blocks at most on the
+   way to it, with a free map sector each if they are new too. */
+#define ALLOC_LOG_MAX 6
+
+/* Most sectors one journal operation of a long write reserves.
+   At least ALLOC_LOG_MAX + 1, so that it has room for a sector and
+   the inode. */
+#define WRITE_LOG_MAX (JOURNAL_MAX / 4)
+
+/* Most bytes of data an inode can hold itself, in place of its
+   index. */
+#define INLINE_MAX ((DIRECT_CNT + 2) * sizeof (block_sector_t))
+
+/* Most data sectors an inode can index: its direct sectors, those
+   of its indirect block, and those of the indirect blocks its
+   doubly indirect block points to. */
+#define MAX_SECTORS (DIRECT_CNT + PTRS_PER_SECTOR \
+                     + PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+
+/* Sectors an open inode has taken from the free map for data it
+   has yet to write.  A file extended a few bytes at a time while
+   others grow too would otherwise be given every other free
+   sector; instead it takes a run of consecutive sectors at a time
+   and hands them out in order, so that it can later be read back
+   many sectors per transfer. */
+struct reservation
+  {
+    block_sector_t next;                /* Next sector to hand out, or
+                                           where to look for more. */
+    size_t cnt;                         /* Sectors left from NEXT on. */
+  };
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   A sector number of 0 in the index means that no sector has
+   been allocated there yet, which for a data sector reads as
+   zeros.  Sector 0 holds the free map's inode, so it is never a
+   data or index sector.
+
+   A file of at most INLINE_MAX bytes keeps its data in place of
+   the index, so that it needs no data sector and reading it no
+   second trip to the disk.  It moves out to a data sector when
+   it grows past that.
+
+   PREALLOC is the extent that inode_allocate() set aside for the
+   sectors of the file not yet written, which writes take in
+   order before any reservation of the open inode's own. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
+    /* Read by every access, so first, on the same cache line as
+       the first direct sectors. */
     off_t length;                       /* File size in bytes. */
+    uint8_t is_dir;                     /* Nonzero for a directory. */
+    uint8_t is_inline;                  /* Nonzero for inline data. */
+    uint16_t unused;                    /* Not used. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    struct reservation prealloc;        /* Preallocated data sectors. */
+    union
+      {
+        struct
+          {
+            block_sector_t direct[DIRECT_CNT];  /* Direct data sectors. */
+            block_sector_t indirect;            /* Indirect block. */
+            block_sector_t doubly_indirect;     /* Doubly indirect block. */
+          };
+        uint8_t inline_data[INLINE_MAX];        /* Data, if is_inline. */
+      };
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,51 +107,334 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
+/* Returns entry I of indirect block BLOCK, or 0 if BLOCK is 0. */
+static block_sector_t
+index_read (block_sector_t block, size_t i)
+{
+  block_sector_t sector;
+
+  if (block == 0)
+    return 0;
+  cache_read (block, &sector, i * sizeof sector, sizeof sector);
+  return sector;
+}
+
+/* Returns data sector IDX of the file that DISK_INODE describes,
+   or 0 if it has not been allocated. */
+static block_sector_t
+index_lookup (const struct inode_disk *disk_inode, size_t idx)
+{
+  if (idx < DIRECT_CNT)
+    return disk_inode->direct[idx];
+  idx -= DIRECT_CNT;
+  if (idx < PTRS_PER_SECTOR)
+    return index_read (disk_inode->indirect, idx);
+  idx -= PTRS_PER_SECTOR;
+  return index_read (index_read (disk_inode->doubly_indirect,
+                                 idx / PTRS_PER_SECTOR),
+                     idx % PTRS_PER_SECTOR);
+}
+
+/* Takes the next sector of RES into *SECTORP, first reserving
+   a new run of up to RESERVE_MAX sectors, right after the last
+   one if possible, if RES has none left.  Returns false if the
+   disk is full. */
+static bool
+reservation_take (struct reservation *res, block_sector_t *sectorp)
+{
+  if (res->cnt == 0)
+    {
+      size_t cnt;
+
+      for (cnt = RESERVE_MAX; cnt > 0; cnt /= 2)
+        if (free_map_allocate_near (res->next, cnt, &res->next))
+          break;
+      if (cnt == 0)
+        return false;
+      res->cnt = cnt;
+    }
+  *sectorp = res->next++;
+  res->cnt--;
+  return true;
+}
+
+/* Gives back the sectors left in RES. */
+static void
+reservation_release (struct reservation *res)
+{
+  if (res->cnt > 0)
+    free_map_release (res->next, res->cnt);
+  res->cnt = 0;
+}
+
+/* Allocates a sector, from RES if it is nonnull, fills it with
+   zeros, and stores its number in *SECTORP.  META says whether
+   the sector holds metadata, to be journaled: an index block, or
+   directory or free map data.  Returns true if successful, false
+   if the disk is full. */
+static bool
+allocate_zeroed (block_sector_t *sectorp, bool meta,
+                 struct reservation *res)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (res != NULL ? !reservation_take (res, sectorp)
+      : !free_map_allocate (1, sectorp))
+    return false;
+  if (meta)
+    journal_write (*sectorp, zeros, 0, BLOCK_SECTOR_SIZE);
+  else
+    cache_write (*sectorp, zeros, 0, BLOCK_SECTOR_SIZE);
+  return true;
+}
+
+/* Returns entry I of the indirect block in *BLOCK, first
+   allocating the block if *BLOCK is 0 and then the entry if it
+   is 0.  META and RES are as for allocate_zeroed(), for the
+   entry.  Returns 0 if the disk is full. */
+static block_sector_t
+index_get (block_sector_t *block, size_t i, bool meta,
+           struct reservation *res)
+{
+  block_sector_t sector;
+
+  if (*block == 0 && !allocate_zeroed (block, true, NULL))
+    return 0;
+  sector = index_read (*block, i);
+  if (sector == 0)
+    {
+      if (!allocate_zeroed (&sector, meta, res))
+        return 0;
+      journal_write (*block, &sector, i * sizeof sector, sizeof sector);
+    }
+  return sector;
+}
+
+/* Returns data sector IDX of the file that DISK_INODE describes,
+   allocating it and any index blocks on the way to it if they
+   do not exist yet.  META says whether the file's data is
+   journaled metadata.  The data sector comes from RES if it is
+   nonnull.  Returns 0 if the disk is full.  The caller must write
+   DISK_INODE back, since its direct or indirect sector numbers
+   may change. */
+static block_sector_t
+index_allocate (struct inode_disk *disk_inode, size_t idx, bool meta,
+                struct reservation *res)
+{
+  block_sector_t indirect;
+
+  ASSERT (idx < MAX_SECTORS);
+
+  if (idx < DIRECT_CNT)
+    {
+      if (disk_inode->direct[idx] == 0
+          && !allocate_zeroed (&disk_inode->direct[idx], meta, res))
+        return 0;
+      return disk_inode->direct[idx];
+    }
+  idx -= DIRECT_CNT;
+  if (idx < PTRS_PER_SECTOR)
+    return index_get (&disk_inode->indirect, idx, meta, res);
+  idx -= PTRS_PER_SECTOR;
+  indirect = index_get (&disk_inode->doubly_indirect, idx / PTRS_PER_SECTOR,
+                        true, NULL);
+  if (indirect == 0)
+    return 0;
+  return index_get (&indirect, idx % PTRS_PER_SECTOR, meta, res);
+}
+
+/* Points entry IDX of DISK_INODE's index at SECTOR.  The index
+   blocks on the way to it must exist.  The caller must write
+   DISK_INODE back, since the entry may be a direct one. */
+static void
+index_set (struct inode_disk *disk_inode, size_t idx, block_sector_t sector)
+{
+  block_sector_t block;
+
+  if (idx < DIRECT_CNT)
+    {
+      disk_inode->direct[idx] = sector;
+      return;
+    }
+  idx -= DIRECT_CNT;
+  if (idx < PTRS_PER_SECTOR)
+    block = disk_inode->indirect;
+  else
+    {
+      idx -= PTRS_PER_SECTOR;
+      block = index_read (disk_inode->doubly_indirect, idx / PTRS_PER_SECTOR);
+      idx %= PTRS_PER_SECTOR;
+    }
+  ASSERT (block != 0);
+  journal_write (block, &sector, idx * sizeof sector, sizeof sector);
+}
+
+/* Releases SECTOR, and if it is an index block of the given
+   DEPTH (1 for indirect, 2 for doubly indirect), everything it
+   points to.  Does nothing if SECTOR is 0. */
+static void
+index_release (block_sector_t sector, int depth)
+{
+  if (sector == 0)
+    return;
+  if (depth > 0)
+    {
+      size_t i;
+
+      for (i = 0; i < PTRS_PER_SECTOR; i++)
+        index_release (index_read (sector, i), depth - 1);
+    }
+  free_map_release (sector, 1);
+}
+
+/* Releases every data and index sector of DISK_INODE. */
+static void
+inode_release_sectors (struct inode_disk *disk_inode)
+{
+  size_t i;
+
+  if (disk_inode->is_inline)
+    return;
+  for (i = 0; i < DIRECT_CNT; i++)
+    index_release (disk_inode->direct[i], 0);
+  index_release (disk_inode->indirect, 1);
+  index_release (disk_inode->doubly_indirect, 2);
+}
+
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    /* Used when the inode is opened, closed, or written. */
+    struct hash_elem hash_elem;         /* Element in open_inodes. */
+    struct list_elem lru_elem;          /* Element in closed_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    unsigned write_cnt;                 /* Writes that changed data. */
+    struct reservation res;             /* Sectors set aside for data. */
+
+    /* Used by every read, and so kept next to the start of DATA,
+       which holds the length and the first sectors. */
+    struct rwlock rw;                  /* Guards data, contents, removed,
+                                           deny_write_cnt, write_cnt
+                                           and res. */
     struct inode_disk data;             /* Inode content. */
   };
 
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   POS, either because POS is past the end of INODE or because no
+   sector has been allocated there yet, or if INODE keeps its
+   data inline. */
 static block_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) 
 {
+  size_t idx = pos / BLOCK_SECTOR_SIZE;
+  block_sector_t sector;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
+  if (pos >= inode->data.length || inode->data.is_inline)
     return -1;
+
+  /* Direct sectors need no trip through the buffer cache. */
+  if (idx < DIRECT_CNT)
+    sector = inode->data.direct[idx];
+  else
+    sector = index_lookup (&inode->data, idx);
+  return sector != 0 ? sector : (block_sector_t) -1;
+}
+
+/* Open inodes, by sector, so that opening a single inode twice
+   returns the same `struct inode'.  Also holds the inodes on
+   closed_inodes. */
+static struct hash open_inodes;
+
+/* Recently closed inodes, most recently closed first.  These have
+   an open_cnt of 0 but are kept, with their inode_disk, so that
+   reopening them does not read the disk. */
+static struct list closed_inodes;
+static size_t closed_inode_cnt;
+
+/* Most inodes kept on closed_inodes. */
+#define CLOSED_INODE_MAX 16
+
+/* Protects open_inodes, closed_inodes and the open_cnt of every
+   inode on them. */
+static struct lock open_inodes_lock;
+
+/* Returns a hash value for inode E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct inode *inode = hash_entry (e, struct inode, hash_elem);
+  return hash_int (inode->sector);
+}
+
+/* Returns true if inode A's sector precedes inode B's. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, hash_elem)->sector
+          < hash_entry (b, struct inode, hash_elem)->sector);
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Returns the inode in open_inodes for SECTOR, or a null pointer
+   if there is none.  open_inodes_lock must be held. */
+static struct inode *
+find_inode (block_sector_t sector)
+{
+  struct inode key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct inode, hash_elem) : NULL;
+}
+
+/* Frees INODE, which must be on closed_inodes.
+   open_inodes_lock must be held. */
+static void
+forget_inode (struct inode *inode)
+{
+  ASSERT (inode->open_cnt == 0);
+
+  list_remove (&inode->lru_elem);
+  closed_inode_cnt--;
+  hash_delete (&open_inodes, &inode->hash_elem);
+  free (inode);
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("inode_init: out of memory");
+  hash_set_incremental (&open_inodes, true);
+  list_init (&closed_inodes);
+  lock_init_named (&open_inodes_lock, "open inodes");
 }
 
-/* Initializes an inode with LENGTH bytes of data and
-   writes the new inode to sector SECTOR on the file system
-   device.
+/* Initializes an inode with LENGTH bytes of data, for a
+   directory if IS_DIR is true, and writes the new inode to sector
+   SECTOR on the file system device.
+   The data reads as zeros, and its sectors are allocated only as
+   they are first written, so this takes the same time for any
+   LENGTH.  The free map's own sectors are the exception: they are
+   all allocated now, in runs of consecutive sectors where
+   possible, since allocating one later would write the free map
+   while it is being written.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
-inode_create (block_sector_t sector, off_t length)
+inode_create (block_sector_t sector, off_t length, bool is_dir)
 {
   struct inode_disk *disk_inode = NULL;
+  struct reservation res = {0, 0};
+  struct inode *old;
   bool success = false;
 
   ASSERT (length >= 0);
@@ -81,25 +443,37 @@ inode_create (block_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
+  /* Drop a closed inode kept for SECTOR, which is about to be
+     overwritten. */
+  lock_acquire (&open_inodes_lock);
+  old = find_inode (sector);
+  if (old != NULL && old->open_cnt == 0)
+    forget_inode (old);
+  lock_release (&open_inodes_lock);
+
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
       size_t sectors = bytes_to_sectors (length);
+      bool free_map = sector == FREE_MAP_SECTOR;
+      size_t i;
+
       disk_inode->length = length;
+      disk_inode->is_dir = is_dir;
+      disk_inode->is_inline = length <= (off_t) INLINE_MAX;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      success = sectors <= MAX_SECTORS;
+      for (i = 0; success && free_map && !disk_inode->is_inline
+                  && i < sectors; i++)
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
-        } 
+          success = index_allocate (disk_inode, i, true, &res) != 0;
+          cond_resched ();
+        }
+      reservation_release (&res);
+      if (success)
+        journal_write (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+      else
+        inode_release_sectors (disk_inode);
       free (disk_inode);
     }
   return success;
@@ -111,33 +485,45 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
   struct inode *inode;
 
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  lock_acquire (&open_inodes_lock);
+
+  /* Check whether this inode is already open, or was closed
+     recently enough to still be kept. */
+  inode = find_inode (sector);
+  if (inode != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
+      if (inode->open_cnt++ == 0)
         {
-          inode_reopen (inode);
-          return inode; 
+          list_remove (&inode->lru_elem);
+          closed_inode_cnt--;
         }
+      lock_release (&open_inodes_lock);
+      return inode; 
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize.  The sector is read before the lock is dropped so
+     that a concurrent opener never sees a half-read inode. */
   inode->sector = sector;
+  hash_insert (&open_inodes, &inode->hash_elem);
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
+  inode->write_cnt = 0;
+  inode->res.next = 0;
+  inode->res.cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  rw_init (&inode->rw, RW_PREFER_WRITERS);
+  cache_read (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -146,7 +532,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -157,32 +547,91 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
+/* Returns true if INODE is a directory. */
+bool
+inode_is_dir (const struct inode *inode)
+{
+  return inode->data.is_dir != 0;
+}
+
+/* Returns true if INODE has been removed. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
+/* Returns how many writes have changed INODE's data since it was
+   opened, which stays the same for as long as some opener keeps
+   it open and nothing writes it.  Lets a cache of something read
+   from INODE tell whether it is stale. */
+unsigned
+inode_write_cnt (const struct inode *inode)
+{
+  return inode->write_cnt;
+}
+
+/* Returns the number of openers of INODE. */
+int
+inode_open_cnt (const struct inode *inode)
+{
+  int open_cnt;
+
+  lock_acquire (&open_inodes_lock);
+  open_cnt = inode->open_cnt;
+  lock_release (&open_inodes_lock);
+  return open_cnt;
+}
+
 /* Closes INODE and writes it to disk.
-   If this was the last reference to INODE, frees its memory.
-   If INODE was also a removed inode, frees its blocks. */
+   If this was the last reference to INODE, frees its blocks if
+   it was removed and its memory, or else keeps it on
+   closed_inodes for a later inode_open().  The last close of a
+   removed inode must not be within a journal operation. */
 void
 inode_close (struct inode *inode) 
 {
+  struct reservation res = {0, 0};
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
   /* Release resources if this was the last opener. */
+  lock_acquire (&open_inodes_lock);
   if (--inode->open_cnt == 0)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
-      /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
+          /* Remove from inode table and release lock, then
+             deallocate blocks.  Each free_map_release() is a
+             journal operation of its own, so that a file of any
+             size can go: a crash part way leaks the rest, which
+             nothing points to any more. */
+          hash_delete (&open_inodes, &inode->hash_elem);
+          lock_release (&open_inodes_lock);
+
+          ASSERT (thread_current ()->journal_depth == 0);
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          inode_release_sectors (&inode->data);
+          reservation_release (&inode->data.prealloc);
+          reservation_release (&inode->res);
+          free (inode); 
+          return;
         }
 
-      free (inode); 
+      /* Keep it for reopening, evicting the least recently
+         closed inode if there are too many.  Its reservation is
+         given back once the lock is dropped. */
+      res = inode->res;
+      inode->res.cnt = 0;
+      list_push_front (&closed_inodes, &inode->lru_elem);
+      if (++closed_inode_cnt > CLOSED_INODE_MAX)
+        forget_inode (list_entry (list_back (&closed_inodes),
+                                  struct inode, lru_elem));
     }
+  lock_release (&open_inodes_lock);
+  reservation_release (&res);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -191,19 +640,34 @@ void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+  rw_write_acquire (&inode->rw);
   inode->removed = true;
+  rw_write_release (&inode->rw);
 }
 
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
+   than SIZE if an error occurs or end of file is reached.
+   Sectors never written read as zeros. */
 off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
+  rw_read_acquire (&inode->rw);
+  if (inode->data.is_inline)
+    {
+      off_t inode_left = inode->data.length - offset;
+
+      bytes_read = size < inode_left ? size : inode_left;
+      if (bytes_read > 0)
+        memcpy (buffer, inode->data.inline_data + offset, bytes_read);
+      else
+        bytes_read = 0;
+      rw_read_release (&inode->rw);
+      return bytes_read;
+    }
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -220,110 +684,606 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      if (sector_idx == (block_sector_t) -1)
+        memset (buffer + bytes_read, 0, chunk_size);
+      else if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          /* Whole sectors.  Read the run of them that is
+             contiguous on disk in one go. */
+          off_t whole = size < inode_left ? size : inode_left;
+          size_t sector_cnt = 1;
+
+          while ((off_t) (sector_cnt + 1) * BLOCK_SECTOR_SIZE <= whole
+                 && (byte_to_sector (inode,
+                                     offset + sector_cnt * BLOCK_SECTOR_SIZE)
+                     == sector_idx + sector_cnt))
+            sector_cnt++;
+          cache_read_multi (sector_idx, sector_cnt, buffer + bytes_read);
+          chunk_size = sector_cnt * BLOCK_SECTOR_SIZE;
         }
+      else
+        cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  rw_read_release (&inode->rw);
 
   return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
-   Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
-off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
-                off_t offset) 
+/* Asks for the sectors holding the SIZE bytes of INODE starting
+   at OFFSET to be read into the buffer cache in the background,
+   one request per run of them that is contiguous on disk.  Stops
+   at end of file or at a sector not allocated yet. */
+void
+inode_read_ahead (struct inode *inode, off_t offset, off_t size) 
+{
+  off_t end;
+
+  rw_read_acquire (&inode->rw);
+  end = offset + size < inode->data.length ? offset + size
+                                           : inode->data.length;
+  offset = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE);
+  while (offset < end) 
+    {
+      block_sector_t sector = byte_to_sector (inode, offset);
+      size_t cnt = 1;
+
+      if (sector == (block_sector_t) -1)
+        break;
+      offset += BLOCK_SECTOR_SIZE;
+      while (offset < end && cnt < CACHE_READ_AHEAD_MAX
+             && byte_to_sector (inode, offset) == sector + cnt) 
+        {
+          offset += BLOCK_SECTOR_SIZE;
+          cnt++;
+        }
+      cache_read_ahead (sector, cnt);
+    }
+  rw_read_release (&inode->rw);
+}
+
+/* Returns true if INODE's data is file system metadata, which
+   is journaled: a directory's entries or the free map. */
+static bool
+inode_is_metadata (const struct inode *inode) 
+{
+  return inode->data.is_dir != 0 || inode->sector == FREE_MAP_SECTOR;
+}
+
+/* Returns the reservation that INODE's next data sector comes
+   from: what is left of its preallocated extent, if anything,
+   or else its own. */
+static struct reservation *
+data_res (struct inode *inode)
+{
+  return inode->data.prealloc.cnt > 0 ? &inode->data.prealloc : &inode->res;
+}
+
+/* Moves INODE's inline data out to a data sector of its own, so
+   that it can grow past INLINE_MAX bytes.  META is as for
+   index_allocate().  Returns false if the disk is full.  The
+   caller must write INODE's inode_disk back. */
+static bool
+inline_spill (struct inode *inode, bool meta)
+{
+  struct inode_disk *disk_inode = &inode->data;
+  block_sector_t sector;
+
+  ASSERT (disk_inode->is_inline);
+
+  if (disk_inode->length > 0)
+    {
+      if (!allocate_zeroed (&sector, meta, meta ? NULL : data_res (inode)))
+        return false;
+      if (meta)
+        journal_write (sector, disk_inode->inline_data, 0,
+                       disk_inode->length);
+      else
+        cache_write_owned (sector, disk_inode->inline_data, 0,
+                           disk_inode->length, inode);
+      memset (disk_inode->inline_data, 0, INLINE_MAX);
+      disk_inode->direct[0] = sector;
+    }
+  disk_inode->is_inline = false;
+  return true;
+}
+
+/* Returns the most sectors allocating data sector IDX of INODE
+   can log, given the index blocks INODE has already and whether
+   it has sectors set aside for data.  META is as for
+   index_allocate().  INODE's lock must be held. */
+static size_t
+alloc_log_cnt (struct inode *inode, size_t idx, bool meta)
+{
+  const struct inode_disk *disk_inode = &inode->data;
+  size_t cnt;
+
+  if (meta)
+    cnt = 2;
+  else
+    cnt = data_res (inode)->cnt > 0 ? 0 : free_map_log_cnt (RESERVE_MAX);
+  if (idx < DIRECT_CNT)
+    return cnt;
+  idx -= DIRECT_CNT;
+  if (idx < PTRS_PER_SECTOR)
+    return cnt + (disk_inode->indirect != 0 ? 1 : 2);
+  idx -= PTRS_PER_SECTOR;
+  cnt += disk_inode->doubly_indirect != 0 ? 1 : 2;
+  return cnt + (index_read (disk_inode->doubly_indirect,
+                            idx / PTRS_PER_SECTOR) != 0 ? 1 : 2);
+}
+
+/* Returns how many sectors writing SIZE bytes to INODE at OFFSET
+   would log, up to WRITE_LOG_MAX, or 0 if it logs nothing, as
+   when it overwrites data already allocated within the file.
+   INODE's lock must be held. */
+static size_t
+write_log_cnt (struct inode *inode, off_t size, off_t offset)
+{
+  bool meta = inode_is_metadata (inode);
+  size_t end, idx;
+  size_t cnt = 0;
+
+  if (size <= 0)
+    return 0;
+  if (inode->data.is_inline)
+    return offset + size <= (off_t) INLINE_MAX ? 1 : WRITE_LOG_MAX;
+  end = bytes_to_sectors (offset + size);
+  for (idx = offset / BLOCK_SECTOR_SIZE;
+       idx < end && idx < MAX_SECTORS && cnt < WRITE_LOG_MAX; idx++)
+    if (index_lookup (&inode->data, idx) == 0)
+      cnt += alloc_log_cnt (inode, idx, meta);
+    else if (meta)
+      cnt++;
+  if (cnt > 0 || offset + size > inode->data.length)
+    cnt++;
+  return cnt < WRITE_LOG_MAX ? cnt : WRITE_LOG_MAX;
+}
+
+/* Returns the most sectors writing SIZE bytes to a metadata inode
+   can log, for an operation that writes a directory entry to
+   reserve: each sector written and its free map sector, three
+   index blocks with theirs, and the inode. */
+size_t
+inode_write_log_max (off_t size)
+{
+  size_t sectors = size > 0 ? DIV_ROUND_UP (size - 1, BLOCK_SECTOR_SIZE) + 1
+                            : 0;
+
+  return 2 * sectors + 3 * 2 + 1;
+}
+
+/* Does the work of inode_write_at(), with INODE's lock held.  If
+   LIMITED, stops before a sector that could log more than the
+   running journal operation has room left for, setting *MORE. */
+static off_t
+write_locked (struct inode *inode, const uint8_t *buffer, off_t size,
+              off_t offset, bool limited, bool *more)
 {
-  const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  bool dirty = false;
+  bool meta = inode_is_metadata (inode);
 
+  *more = false;
   if (inode->deny_write_cnt)
     return 0;
 
+  if (inode->data.is_inline && size > 0)
+    {
+      if (offset + size <= (off_t) INLINE_MAX)
+        {
+          memcpy (inode->data.inline_data + offset, buffer, size);
+          bytes_written = size;
+          offset += size;
+          size = 0;
+          dirty = true;
+        }
+      else if (limited && journal_room () < ALLOC_LOG_MAX + 1)
+        {
+          *more = true;
+          size = 0;
+        }
+      else if (inline_spill (inode, meta))
+        dirty = true;
+      else
+        size = 0;
+    }
+
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
       block_sector_t sector_idx = byte_to_sector (inode, offset);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      /* Bytes left in sector. */
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
 
       /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
+      int chunk_size = size < sector_left ? size : sector_left;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      if (sector_idx == (block_sector_t) -1)
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
+          size_t idx = offset / BLOCK_SECTOR_SIZE;
+
+          if (idx >= MAX_SECTORS)
+            break;
+          /* Room for the sector, and then for the inode. */
+          if (limited
+              && journal_room () < alloc_log_cnt (inode, idx, meta) + 1)
             {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
+              *more = true;
+              break;
             }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          sector_idx = index_allocate (&inode->data, idx, meta,
+                                       meta ? NULL : data_res (inode));
+          if (sector_idx == 0)
+            break;
+          dirty = true;
         }
+      else if (meta && limited && journal_room () < 2)
+        {
+          *more = true;
+          break;
+        }
+
+      if (meta)
+        journal_write (sector_idx, buffer + bytes_written, sector_ofs,
+                       chunk_size);
+      else
+        cache_write_owned (sector_idx, buffer + bytes_written, sector_ofs,
+                           chunk_size, inode);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
+  if (bytes_written > 0)
+    inode->write_cnt++;
+  if (bytes_written > 0 && offset > inode->data.length)
+    {
+      inode->data.length = offset;
+      dirty = true;
+    }
+  if (dirty)
+    journal_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
   return bytes_written;
 }
 
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   Returns the number of bytes actually written, which may be
+   less than SIZE if the disk fills up or the file would outgrow
+   the largest size an inode can index.
+   Writing past end of file extends INODE.  Sectors are
+   allocated only as they are written, so any gap between the
+   old end of file and OFFSET reads as zeros but takes no space.
+
+   A write that allocates nothing and leaves the length alone,
+   the common overwrite of a data file, logs nothing and takes
+   no journal operation.  Any other write outside an operation
+   takes operations of its own, each begun before INODE's lock
+   is taken, since journal_begin() may wait for a commit, and
+   each sized to what is left to log, up to WRITE_LOG_MAX.  A
+   write within an operation is logged in it. */
+off_t
+inode_write_at (struct inode *inode, const void *buffer_, off_t size,
+                off_t offset) 
+{
+  const uint8_t *buffer = buffer_;
+  bool nested = thread_current ()->journal_depth > 0;
+  off_t bytes_written = 0;
+
+  /* Wait for write-behind, before taking any lock, if too much
+     of the cache is dirty already. */
+  if (!inode_is_metadata (inode))
+    cache_throttle ();
+
+  for (;;) 
+    {
+      size_t cnt = 0;
+      bool more;
+
+      rw_write_acquire (&inode->rw);
+      if (!nested)
+        cnt = write_log_cnt (inode, size - bytes_written,
+                             offset + bytes_written);
+      if (cnt > 0)
+        {
+          rw_write_release (&inode->rw);
+          journal_begin (cnt);
+          rw_write_acquire (&inode->rw);
+        }
+      bytes_written += write_locked (inode, buffer + bytes_written,
+                                     size - bytes_written,
+                                     offset + bytes_written, cnt > 0, &more);
+      rw_write_release (&inode->rw);
+      if (cnt > 0)
+        journal_end ();
+      if (!more)
+        return bytes_written;
+      cond_resched ();
+    }
+}
+
+/* Copies the sector-aligned BLOCK_SECTOR_SIZE bytes of SRC at
+   SRC_OFS over those of DST at DST_OFS, which must also be
+   sector-aligned, block to block in the buffer cache.  DST is
+   extended if need be.  Returns false, having done nothing, if
+   SRC has no whole sector of data there or DST cannot take one;
+   the caller should then copy the bytes the slow way.
+   Both inodes' locks are taken in order of inode sector, so two
+   copies going in opposite directions cannot deadlock. */
+bool
+inode_copy_sector (struct inode *dst, off_t dst_ofs,
+                   struct inode *src, off_t src_ofs) 
+{
+  block_sector_t src_sector, dst_sector;
+  bool dirty = false;
+  bool success = false;
+
+  ASSERT (dst != src);
+  ASSERT (dst_ofs % BLOCK_SECTOR_SIZE == 0);
+  ASSERT (src_ofs % BLOCK_SECTOR_SIZE == 0);
+
+  if (!inode_is_metadata (dst))
+    cache_throttle ();
+  journal_begin (ALLOC_LOG_MAX + 1);
+  if (src->sector < dst->sector) 
+    {
+      rw_read_acquire (&src->rw);
+      rw_write_acquire (&dst->rw);
+    }
+  else 
+    {
+      rw_write_acquire (&dst->rw);
+      rw_read_acquire (&src->rw);
+    }
+
+  src_sector = byte_to_sector (src, src_ofs);
+  if (src_sector == (block_sector_t) -1
+      || inode_length (src) - src_ofs < BLOCK_SECTOR_SIZE
+      || dst->deny_write_cnt || dst->data.is_inline)
+    goto done;
+
+  dst_sector = byte_to_sector (dst, dst_ofs);
+  if (dst_sector == (block_sector_t) -1) 
+    {
+      size_t idx = dst_ofs / BLOCK_SECTOR_SIZE;
+
+      if (idx >= MAX_SECTORS)
+        goto done;
+      dst_sector = index_allocate (&dst->data, idx,
+                                   inode_is_metadata (dst), data_res (dst));
+      if (dst_sector == 0)
+        goto done;
+      dirty = true;
+    }
+
+  cache_copy (dst_sector, src_sector, dst);
+  if (dst_ofs + BLOCK_SECTOR_SIZE > dst->data.length) 
+    {
+      dst->data.length = dst_ofs + BLOCK_SECTOR_SIZE;
+      dirty = true;
+    }
+  dst->write_cnt++;
+  success = true;
+
+ done:
+  if (dirty)
+    journal_write (dst->sector, &dst->data, 0, BLOCK_SECTOR_SIZE);
+  rw_read_release (&src->rw);
+  rw_write_release (&dst->rw);
+  journal_end ();
+  return success;
+}
+
+/* Extends INODE to LENGTH bytes, if it is shorter, and sets
+   aside one extent of consecutive sectors for the data it does
+   not have yet, together with whatever was set aside by an
+   earlier call, so that writing the file fills the extent in
+   order instead of taking sectors wherever they are free.  The
+   new bytes read as zeros until written.
+   Returns false, having changed nothing, if INODE is metadata,
+   writes to it are denied, LENGTH is more than an inode can
+   index, or the disk has no free run of sectors long enough. */
+bool
+inode_allocate (struct inode *inode, off_t length)
+{
+  struct inode_disk *disk_inode = &inode->data;
+  struct reservation *prealloc = &disk_inode->prealloc;
+  block_sector_t start;
+  size_t need;
+  bool success = false;
+
+  ASSERT (length >= 0);
+
+  if (bytes_to_sectors (length) > MAX_SECTORS)
+    return false;
+
+  /* The new extent, the old one and the open inode's reservation
+     given back, and the inode. */
+  journal_begin (2 * free_map_log_cnt (bytes_to_sectors (length))
+                 + free_map_log_cnt (RESERVE_MAX) + 1);
+  rw_write_acquire (&inode->rw);
+  if (inode->deny_write_cnt || inode_is_metadata (inode))
+    goto done;
+  if (length <= disk_inode->length)
+    {
+      success = true;
+      goto done;
+    }
+
+  /* An inline file that is to outgrow INLINE_MAX moves its data
+     out to the first sector of the extent. */
+  if (!disk_inode->is_inline)
+    need = (bytes_to_sectors (length)
+            - bytes_to_sectors (disk_inode->length) + prealloc->cnt);
+  else if (length > (off_t) INLINE_MAX)
+    need = bytes_to_sectors (length);
+  else
+    need = 0;
+
+  /* Take the new extent before giving back the old, so that
+     failing leaves both as they were. */
+  if (need > 0)
+    {
+      if (!free_map_allocate_near (prealloc->cnt > 0 ? prealloc->next
+                                   : inode->res.next, need, &start))
+        goto done;
+      reservation_release (prealloc);
+      reservation_release (&inode->res);
+      prealloc->next = start;
+      prealloc->cnt = need;
+      if (disk_inode->is_inline)
+        inline_spill (inode, false);
+    }
+
+  disk_inode->length = length;
+  inode->write_cnt++;
+  journal_write (inode->sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+  success = true;
+
+ done:
+  rw_write_release (&inode->rw);
+  journal_end ();
+  return success;
+}
+
+/* Returns the number of extents, runs of sectors consecutive on
+   disk, that INODE's data is split into.  Returns 0 for anything
+   inode_defrag() leaves alone: a removed file, metadata, inline
+   data, a file with a sector not yet written, or one with
+   sectors still set aside by inode_allocate(). */
+static size_t
+count_extents (const struct inode *inode)
+{
+  const struct inode_disk *disk_inode = &inode->data;
+  size_t sectors = bytes_to_sectors (disk_inode->length);
+  block_sector_t prev = 0;
+  size_t cnt = 0;
+  size_t idx;
+
+  if (inode->removed || inode_is_metadata (inode) || disk_inode->is_inline
+      || disk_inode->prealloc.cnt > 0)
+    return 0;
+  for (idx = 0; idx < sectors; idx++)
+    {
+      block_sector_t sector = index_lookup (disk_inode, idx);
+
+      if (sector == 0)
+        return 0;
+      if (idx == 0 || sector != prev + 1)
+        cnt++;
+      prev = sector;
+    }
+  return cnt;
+}
+
+/* Returns the number of extents INODE's data is split into, or 0
+   if inode_defrag() would leave it alone. */
+size_t
+inode_extent_cnt (struct inode *inode)
+{
+  size_t cnt;
+
+  rw_read_acquire (&inode->rw);
+  cnt = count_extents (inode);
+  rw_read_release (&inode->rw);
+  return cnt;
+}
+
+/* Moves INODE's data into one run of free sectors near the
+   inode, if it is split into more than one extent and the free
+   map has a run that long.  Returns the number of sectors moved.
+
+   Each sector is copied in the buffer cache and written to disk
+   before the index is pointed at it, and DEFRAG_CHUNK sectors go
+   to a journal operation, so that after a crash every sector is
+   found either where it was or where it went.  The run is
+   allocated up front, so a crash part way through leaks the rest
+   of it.  INODE's lock is dropped between chunks, since the next
+   operation may wait for a commit, so its readers and writers
+   wait only for the chunk under way; a write meanwhile goes to
+   wherever its sector is at the time, and is moved with it. */
+size_t
+inode_defrag (struct inode *inode)
+{
+  struct inode_disk *disk_inode = &inode->data;
+  block_sector_t start;
+  size_t sectors, idx;
+  bool found = false;
+
+  journal_begin (free_map_log_cnt (MAX_SECTORS));
+  rw_write_acquire (&inode->rw);
+  sectors = bytes_to_sectors (disk_inode->length);
+  if (count_extents (inode) >= 2)
+    found = free_map_allocate_near (inode->sector, sectors, &start);
+  rw_write_release (&inode->rw);
+  journal_end ();
+  if (!found)
+    return 0;
+
+  for (idx = 0; idx < sectors; )
+    {
+      size_t end = idx + DEFRAG_CHUNK < sectors ? idx + DEFRAG_CHUNK
+                                                : sectors;
+
+      /* Each sector's old free map sector, the index blocks the
+         chunk's entries are in, and the inode. */
+      journal_begin (DEFRAG_CHUNK + 2 + 1);
+      rw_write_acquire (&inode->rw);
+      if (inode->removed)
+        {
+          rw_write_release (&inode->rw);
+          journal_end ();
+          break;
+        }
+      for (; idx < end; idx++)
+        {
+          block_sector_t old = index_lookup (disk_inode, idx);
+
+          cache_copy (start + idx, old, inode);
+          cache_sync (start + idx);
+          index_set (disk_inode, idx, start + idx);
+          free_map_release (old, 1);
+        }
+      journal_write (inode->sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+      rw_write_release (&inode->rw);
+      journal_end ();
+      cond_resched ();
+    }
+
+  /* A file removed meanwhile gives back what it did not get to. */
+  if (idx < sectors)
+    free_map_release (start + idx, sectors - idx);
+  return idx;
+}
+
+/* Writes INODE's data that is only in the buffer cache to disk,
+   then commits the journal, so that the data and the metadata
+   that locates it, such as INODE's length, survive a crash. */
+void
+inode_sync (struct inode *inode) 
+{
+  if (!inode_is_metadata (inode))
+    cache_flush_owner (inode);
+  journal_commit ();
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
 inode_deny_write (struct inode *inode) 
 {
+  rw_write_acquire (&inode->rw);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rw_write_release (&inode->rw);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +1292,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  rw_write_acquire (&inode->rw);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rw_write_release (&inode->rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -0,0 +1,312 @@
+#include "filesys/journal.h"
+#include <crc32.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Write-ahead journal for file system metadata.
+
+   Inodes, index blocks, directories and the free map are written
+   with journal_write() rather than cache_write().  Each sector so
+   written joins the running transaction and stays in the buffer
+   cache, held back from the disk, until the transaction commits.
+
+   A commit copies every logged sector into the journal area with
+   one sequential write and then writes the header, which lists
+   their home sectors and a crc32() of the copies: once the
+   header is on disk, the transaction will survive a crash.
+   Only then are the sectors written home, after which the
+   header is cleared again.  filesys_init() replays a header it
+   finds still set, if the copies match the checksum.
+
+   The commit thread commits every COMMIT_TICKS, so that the
+   metadata updates of all the threads that ran meanwhile share
+   one journal write.  journal_begin() and journal_end() bracket
+   an operation, such as creating a file, whose updates must
+   commit together: a commit waits until no operation is under
+   way.  Operations nest within a thread.
+
+   Every sector an operation logs must fit in the transaction, so
+   the outermost journal_begin() reserves as many sectors as the
+   operation can log, and journal_end() gives back what it did
+   not use.  An operation that finds too little room, or a commit
+   waiting, waits for the transaction to commit before it starts,
+   so that a stream of operations cannot hold a commit off.  Once
+   started, an operation never waits for the journal: it may be
+   holding locks that other operations need to finish.  One that
+   cannot tell up front how much it will log, such as a long
+   write, reserves part of it, checks journal_room() as it goes,
+   and ends the operation and begins another where it holds no
+   locks.  Writes outside any operation are operations of their
+   own. */
+
+#define JOURNAL_MAGIC 0x4a524e4c        /* Identifies a header. */
+#define COMMIT_TICKS (TIMER_FREQ / 20)  /* Interval between commits. */
+
+/* Journal header, at JOURNAL_SECTOR.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    uint32_t cnt;                       /* Sectors to replay, or 0. */
+    uint32_t crc;                       /* crc32() of their images. */
+    block_sector_t home[JOURNAL_MAX];   /* Where each one goes. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 12 - 4 * JOURNAL_MAX];
+  };
+
+static struct journal_header header;
+static uint8_t *images;                 /* JOURNAL_MAX sectors. */
+
+/* The running transaction. */
+static block_sector_t logged[JOURNAL_MAX];      /* Sectors logged. */
+static size_t logged_cnt;
+static size_t reserved_cnt;             /* Reserved, not yet logged. */
+static int active_cnt;                  /* Operations under way. */
+static bool commit_waiting;             /* No operation may start. */
+
+static struct lock journal_lock;        /* Protects all of the above. */
+static struct condition journal_done;   /* COMMIT_WAITING cleared. */
+
+static void commit (void);
+static void replay (void);
+static void write_header (size_t cnt);
+static thread_func commit_thread NO_RETURN;
+
+/* Initializes the journal, clearing it if FORMAT is true and
+   otherwise replaying a transaction left behind by a crash, and
+   starts the commit thread.  Must be called before anything is
+   read through the buffer cache. */
+void
+journal_init (bool format) 
+{
+  size_t pages = DIV_ROUND_UP (JOURNAL_MAX * BLOCK_SECTOR_SIZE, PGSIZE);
+
+  ASSERT (sizeof header == BLOCK_SECTOR_SIZE);
+
+  images = palloc_get_multiple (PAL_ASSERT, pages);
+  lock_init_named (&journal_lock, "journal");
+  cond_init (&journal_done);
+
+  if (format)
+    write_header (0);
+  else
+    replay ();
+
+  thread_create_stack ("journal", PRI_DEFAULT, FILESYS_STACK_PAGES,
+                       commit_thread, NULL);
+}
+
+/* Starts an operation whose updates must commit together and
+   that logs at most CNT sectors, first waiting for the running
+   transaction to commit if it has no room for them or a commit
+   is waiting.  Must not be called with a lock held that an
+   operation under way could need, except from within an
+   operation, whose reservation must then cover CNT as well. */
+void
+journal_begin (size_t cnt) 
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (cnt <= JOURNAL_MAX);
+
+  if (t->journal_depth++ > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  while (commit_waiting || logged_cnt + reserved_cnt + cnt > JOURNAL_MAX)
+    {
+      if (active_cnt == 0)
+        commit ();
+      else
+        {
+          commit_waiting = true;
+          cond_wait (&journal_done, &journal_lock);
+        }
+    }
+  active_cnt++;
+  reserved_cnt += cnt;
+  t->journal_room = cnt;
+  lock_release (&journal_lock);
+}
+
+/* Returns how many more new sectors the running thread's
+   operation may log, or 0 if it has none under way. */
+size_t
+journal_room (void) 
+{
+  return thread_current ()->journal_room;
+}
+
+/* Ends an operation started with journal_begin(), giving back
+   the room it reserved and did not use, and committing the
+   transaction if a commit is waiting and this was the last
+   operation under way. */
+void
+journal_end (void) 
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  ASSERT (active_cnt > 0);
+  reserved_cnt -= t->journal_room;
+  t->journal_room = 0;
+  if (--active_cnt == 0 && commit_waiting)
+    commit ();
+  lock_release (&journal_lock);
+}
+
+/* Writes SIZE bytes from BUFFER into metadata sector SECTOR,
+   starting at offset OFS within the sector, as part of the
+   running transaction.  A sector the transaction has not logged
+   yet takes one of the room the operation reserved. */
+void
+journal_write (block_sector_t sector, const void *buffer, int ofs,
+               int size) 
+{
+  struct thread *t = thread_current ();
+  bool own_op = t->journal_depth == 0;
+  size_t i;
+
+  if (own_op)
+    journal_begin (1);
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < logged_cnt; i++)
+    if (logged[i] == sector)
+      break;
+  if (i == logged_cnt)
+    {
+      if (t->journal_room > 0)
+        {
+          t->journal_room--;
+          reserved_cnt--;
+        }
+      else if (logged_cnt + reserved_cnt == JOURNAL_MAX)
+        PANIC ("journal: operation logged more than it reserved");
+      logged[logged_cnt++] = sector;
+    }
+
+  /* Still holding the lock, so that no commit can come between
+     logging the sector and the cache holding it back. */
+  cache_write_logged (sector, buffer, ofs, size);
+  lock_release (&journal_lock);
+
+  if (own_op)
+    journal_end ();
+}
+
+/* Commits the running transaction, once no operation is under
+   way, and writes its sectors home.  Operations that start
+   meanwhile wait for it. */
+void
+journal_commit (void) 
+{
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  lock_acquire (&journal_lock);
+  if (active_cnt == 0)
+    commit ();
+  else
+    {
+      commit_waiting = true;
+      while (commit_waiting)
+        cond_wait (&journal_done, &journal_lock);
+    }
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction and writes its sectors home,
+   then lets operations waiting in journal_begin() start.  No
+   operation may be under way.  journal_lock must be held. */
+static void
+commit (void) 
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  ASSERT (active_cnt == 0);
+
+  if (logged_cnt > 0) 
+    {
+      for (i = 0; i < logged_cnt; i++) 
+        {
+          cache_read (logged[i], images + i * BLOCK_SECTOR_SIZE,
+                      0, BLOCK_SECTOR_SIZE);
+          header.home[i] = logged[i];
+        }
+      block_write_multi (fs_device, JOURNAL_SECTOR + 1, logged_cnt, images);
+      header.crc = crc32 (images, logged_cnt * BLOCK_SECTOR_SIZE);
+      write_header (logged_cnt);
+
+      for (i = 0; i < logged_cnt; i++)
+        cache_write_back (logged[i]);
+      write_header (0);
+      logged_cnt = 0;
+    }
+  commit_waiting = false;
+  cond_broadcast (&journal_done, &journal_lock);
+}
+
+/* Writes the sectors listed in a committed header found on disk
+   to their homes, then clears the header.  If the copies in the
+   journal do not match the header's checksum, they did not all
+   reach the disk, so nothing is written home. */
+static void
+replay (void) 
+{
+  size_t i;
+
+  block_read (fs_device, JOURNAL_SECTOR, &header);
+  if (header.magic != JOURNAL_MAGIC || header.cnt == 0)
+    return;
+  if (header.cnt > JOURNAL_MAX)
+    PANIC ("journal header corrupt");
+
+  printf ("Replaying %"PRIu32" journaled sectors...", header.cnt);
+  block_read_multi (fs_device, JOURNAL_SECTOR + 1, header.cnt, images);
+  if (crc32 (images, header.cnt * BLOCK_SECTOR_SIZE) != header.crc)
+    {
+      write_header (0);
+      printf ("checksum mismatch, skipped.\n");
+      return;
+    }
+  for (i = 0; i < header.cnt; i++)
+    block_write (fs_device, header.home[i],
+                 images + i * BLOCK_SECTOR_SIZE);
+  write_header (0);
+  printf ("done.\n");
+}
+
+/* Writes the header with CNT sectors to replay.  Its home[]
+   entries must already be filled in. */
+static void
+write_header (size_t cnt) 
+{
+  header.magic = JOURNAL_MAGIC;
+  header.cnt = cnt;
+  block_write (fs_device, JOURNAL_SECTOR, &header);
+}
+
+/* Commits every COMMIT_TICKS. */
+static void
+commit_thread (void *aux UNUSED) 
+{
+  for (;;) 
+    {
+      timer_sleep (COMMIT_TICKS);
+      journal_commit ();
+    }
+}
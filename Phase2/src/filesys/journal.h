@@ -0,0 +1,22 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Most sectors one transaction logs. */
+#define JOURNAL_MAX 32
+
+/* Sectors the journal takes up on disk, starting at
+   JOURNAL_SECTOR: a header and room for JOURNAL_MAX sectors. */
+#define JOURNAL_SECTORS (1 + JOURNAL_MAX)
+
+void journal_init (bool format);
+void journal_begin (size_t cnt);
+size_t journal_room (void);
+void journal_end (void);
+void journal_write (block_sector_t, const void *, int ofs, int size);
+void journal_commit (void);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,348 @@
+#include "filesys/pipe.h"
+#include <debug.h>
+#include <poll.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "threads/waitq.h"
+
+/* Pages a pipe may hold before writers wait. */
+#define PIPE_PAGES 16
+
+/* A page of data in a pipe: bytes START through END - 1 of PAGE
+   are yet to be read. */
+struct pipe_buf
+  {
+    uint8_t *page;
+    uint16_t start;
+    uint16_t end;
+  };
+
+/* An anonymous pipe: a ring of pages written at one end and read
+   at the other.  Data moves through it a page at a time: a write
+   fills the last page and then takes new ones, and a read frees
+   each page it empties, so no more memory is held than there are
+   bytes waiting, rounded up to pages.  A write of whole pages
+   from a page-aligned buffer gets pages of its own, which go to
+   the reader as they are. */
+struct pipe
+  {
+    struct lock lock;                   /* Guards the members below. */
+    struct condition changed;           /* Data, room or an end went. */
+    struct waitq pollers;               /* Woken along with CHANGED. */
+    int readers;                        /* Open read ends. */
+    int writers;                        /* Open write ends. */
+    struct pipe_buf bufs[PIPE_PAGES];   /* Ring of pages. */
+    size_t head;                        /* Index of the first in BUFS. */
+    size_t cnt;                         /* Pages in BUFS. */
+    uint8_t *spare;                     /* Emptied page to reuse, or
+                                           null. */
+  };
+
+static const struct file_ops pipe_read_ops;
+static const struct file_ops pipe_write_ops;
+
+/* Creates a pipe and returns its two ends in *READ_END and
+   *WRITE_END.  Returns false if memory is short. */
+bool
+pipe_create (struct file **read_end, struct file **write_end)
+{
+  struct pipe *p = calloc (1, sizeof *p);
+  if (p == NULL)
+    return false;
+  lock_init (&p->lock);
+  cond_init (&p->changed);
+  waitq_init (&p->pollers);
+
+  /* Each end closes its half of P if it cannot be opened, and
+     the last to close frees it. */
+  p->readers = 1;
+  *read_end = file_open_ops (&pipe_read_ops, p);
+  if (*read_end == NULL)
+    return false;
+  p->writers = 1;
+  *write_end = file_open_ops (&pipe_write_ops, p);
+  if (*write_end == NULL)
+    {
+      file_close (*read_end);
+      return false;
+    }
+  return true;
+}
+
+/* Wakes everyone waiting for P to change.  P's lock must be
+   held. */
+static void
+pipe_changed (struct pipe *p)
+{
+  cond_broadcast (&p->changed, &p->lock);
+  waitq_wake (&p->pollers);
+}
+
+/* Returns the last page in P's ring. */
+static struct pipe_buf *
+last_buf (struct pipe *p)
+{
+  return &p->bufs[(p->head + p->cnt - 1) % PIPE_PAGES];
+}
+
+/* Reads SIZE bytes from pipe NODE into BUFFER, waiting until at
+   least one byte is there unless SIZE is 0.  Returns the number
+   read, which is less than SIZE if a writer has not written so
+   many yet, and 0 once every write end is closed and the pipe
+   drained.  OFFSET is ignored: a pipe has no positions. */
+static off_t
+pipe_read_at (void *node, void *buffer_, off_t size, off_t offset UNUSED)
+{
+  struct pipe *p = node;
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  lock_acquire (&p->lock);
+  while (p->cnt == 0 && p->writers > 0 && size > 0)
+    cond_wait (&p->changed, &p->lock);
+  while (bytes_read < size && p->cnt > 0)
+    {
+      struct pipe_buf *b = &p->bufs[p->head];
+      size_t chunk = b->end - b->start;
+
+      if (chunk > (size_t) (size - bytes_read))
+        chunk = size - bytes_read;
+      memcpy (buffer + bytes_read, b->page + b->start, chunk);
+      b->start += chunk;
+      bytes_read += chunk;
+      if (b->start == b->end)
+        {
+          if (p->spare == NULL)
+            p->spare = b->page;
+          else
+            palloc_free_page (b->page);
+          p->head = (p->head + 1) % PIPE_PAGES;
+          p->cnt--;
+        }
+    }
+  if (bytes_read > 0)
+    pipe_changed (p);
+  lock_release (&p->lock);
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into pipe NODE, waiting for room
+   as needed.  Returns the number written, which is less than SIZE
+   only if every read end is closed or no page can be had.  OFFSET
+   is ignored. */
+static off_t
+pipe_write_at (void *node, const void *buffer_, off_t size,
+               off_t offset UNUSED)
+{
+  struct pipe *p = node;
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = 0;
+
+  lock_acquire (&p->lock);
+  while (bytes_written < size && p->readers > 0)
+    {
+      const uint8_t *src = buffer + bytes_written;
+      size_t left = size - bytes_written;
+      struct pipe_buf *b;
+      size_t chunk;
+
+      /* Top up the last page, unless this is a whole page that
+         lines up with one. */
+      b = p->cnt > 0 ? last_buf (p) : NULL;
+      if (b == NULL || b->end == PGSIZE
+          || (pg_ofs (src) == 0 && left >= PGSIZE))
+        {
+          if (p->cnt == PIPE_PAGES)
+            {
+              cond_wait (&p->changed, &p->lock);
+              continue;
+            }
+          p->cnt++;
+          b = last_buf (p);
+          b->page = p->spare != NULL ? p->spare : palloc_get_page (0);
+          p->spare = NULL;
+          if (b->page == NULL)
+            {
+              p->cnt--;
+              break;
+            }
+          b->start = b->end = 0;
+        }
+      chunk = PGSIZE - b->end;
+      if (chunk > left)
+        chunk = left;
+      memcpy (b->page + b->end, src, chunk);
+      b->end += chunk;
+      bytes_written += chunk;
+      pipe_changed (p);
+    }
+  lock_release (&p->lock);
+  return bytes_written;
+}
+
+/* A pipe has no length.  Being empty as a file also keeps it from
+   being mapped into memory. */
+static off_t
+pipe_length (void *node UNUSED)
+{
+  return 0;
+}
+
+/* Frees P, which neither end has open any more. */
+static void
+pipe_free (struct pipe *p)
+{
+  size_t i;
+
+  for (i = 0; i < p->cnt; i++)
+    palloc_free_page (p->bufs[(p->head + i) % PIPE_PAGES].page);
+  palloc_free_page (p->spare);
+  free (p);
+}
+
+/* Opens one more read end of pipe NODE. */
+static void *
+pipe_reopen_read (void *node)
+{
+  struct pipe *p = node;
+
+  lock_acquire (&p->lock);
+  p->readers++;
+  lock_release (&p->lock);
+  return p;
+}
+
+/* Opens one more write end of pipe NODE. */
+static void *
+pipe_reopen_write (void *node)
+{
+  struct pipe *p = node;
+
+  lock_acquire (&p->lock);
+  p->writers++;
+  lock_release (&p->lock);
+  return p;
+}
+
+/* Closes a read end of pipe NODE.  Writers waiting for room wake
+   up to find no reader once the last read end is closed. */
+static void
+pipe_close_read (void *node)
+{
+  struct pipe *p = node;
+  bool unused;
+
+  lock_acquire (&p->lock);
+  unused = --p->readers == 0 && p->writers == 0;
+  pipe_changed (p);
+  lock_release (&p->lock);
+  if (unused)
+    pipe_free (p);
+}
+
+/* Closes a write end of pipe NODE.  Readers waiting for data wake
+   up to read end of file once the last write end is closed. */
+static void
+pipe_close_write (void *node)
+{
+  struct pipe *p = node;
+  bool unused;
+
+  lock_acquire (&p->lock);
+  unused = --p->writers == 0 && p->readers == 0;
+  pipe_changed (p);
+  lock_release (&p->lock);
+  if (unused)
+    pipe_free (p);
+}
+
+/* Returns the events for a read end of pipe NODE, putting ENTRY,
+   if nonnull, on its wait queue.  A read does not wait if there
+   is data or no writer. */
+static int
+pipe_poll_read (void *node, struct waitq_entry *entry)
+{
+  struct pipe *p = node;
+  int events = 0;
+
+  lock_acquire (&p->lock);
+  if (entry != NULL)
+    waitq_add (&p->pollers, entry);
+  if (p->cnt > 0)
+    events |= POLLIN;
+  if (p->writers == 0)
+    events |= POLLIN | POLLHUP;
+  lock_release (&p->lock);
+  return events;
+}
+
+/* Returns the events for a write end of pipe NODE, putting ENTRY,
+   if nonnull, on its wait queue.  A write of up to a page does
+   not wait while a page of the ring is free, and no write waits
+   once there is no reader. */
+static int
+pipe_poll_write (void *node, struct waitq_entry *entry)
+{
+  struct pipe *p = node;
+  int events = 0;
+
+  lock_acquire (&p->lock);
+  if (entry != NULL)
+    waitq_add (&p->pollers, entry);
+  if (p->cnt < PIPE_PAGES)
+    events |= POLLOUT;
+  if (p->readers == 0)
+    events |= POLLOUT | POLLERR;
+  lock_release (&p->lock);
+  return events;
+}
+
+/* Reads from a write end, or writes to a read end. */
+static off_t
+pipe_read_none (void *node UNUSED, void *buffer UNUSED, off_t size UNUSED,
+                off_t offset UNUSED)
+{
+  return 0;
+}
+
+static off_t
+pipe_write_none (void *node UNUSED, const void *buffer UNUSED,
+                 off_t size UNUSED, off_t offset UNUSED)
+{
+  return 0;
+}
+
+/* Pipes cannot be executables. */
+static void
+pipe_deny_write (void *node UNUSED)
+{
+}
+
+static const struct file_ops pipe_read_ops =
+  {
+    pipe_read_at,
+    pipe_write_none,
+    pipe_length,
+    pipe_reopen_read,
+    pipe_close_read,
+    pipe_deny_write,
+    pipe_deny_write,
+    pipe_poll_read
+  };
+
+static const struct file_ops pipe_write_ops =
+  {
+    pipe_read_none,
+    pipe_write_at,
+    pipe_length,
+    pipe_reopen_write,
+    pipe_close_write,
+    pipe_deny_write,
+    pipe_deny_write,
+    pipe_poll_write
+  };
@@ -0,0 +1,10 @@
+#ifndef FILESYS_PIPE_H
+#define FILESYS_PIPE_H
+
+#include <stdbool.h>
+
+struct file;
+
+bool pipe_create (struct file **read_end, struct file **write_end);
+
+#endif /* filesys/pipe.h */
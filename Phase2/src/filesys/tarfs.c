@@ -0,0 +1,210 @@
+#include "filesys/tarfs.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include <ustar.h>
+#include "devices/block.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+
+/* A regular file in the archive on the scratch device, read in
+   place rather than copied into the file system first: SIZE
+   bytes in the sectors that follow its header, starting at
+   SECTOR.  The archive is read-only once mounted, so an entry
+   never changes or goes away and needs no locking. */
+struct tarfs_entry
+  {
+    struct list_elem elem;              /* Element in tarfs_entries. */
+    char name[100];                     /* Name in the archive. */
+    block_sector_t sector;              /* First sector of data. */
+    off_t size;                         /* File size in bytes. */
+  };
+
+/* The scratch device, or a null pointer if not mounted. */
+static struct block *tarfs_device;
+
+/* Every regular file in the archive, in archive order. */
+static struct list tarfs_entries;
+
+static const struct file_ops tarfs_ops;
+
+/* Mounts the ustar archive on the scratch device read-only at
+   TARFS_MOUNT, reading just its headers, so that its files can be
+   opened, read and run without extracting them.  Directories in
+   the archive are skipped; the files in them keep the full names
+   the archive gives them.  An archive with a bad header is mounted
+   up to that header.  Returns false if there is no scratch device
+   or memory runs out. */
+bool
+tarfs_mount (void)
+{
+  struct block *device = block_get_role (BLOCK_SCRATCH);
+  block_sector_t sector = 0;
+  size_t file_cnt = 0;
+  void *header;
+
+  if (device == NULL)
+    return false;
+  header = malloc (BLOCK_SECTOR_SIZE);
+  if (header == NULL)
+    return false;
+
+  list_init (&tarfs_entries);
+  while (sector < block_size (device))
+    {
+      struct tarfs_entry *e;
+      const char *file_name;
+      const char *error;
+      enum ustar_type type;
+      int size;
+
+      block_read (device, sector++, header);
+      error = ustar_parse_header (header, &file_name, &type, &size);
+      if (error != NULL)
+        {
+          printf ("tarfs: bad ustar header in sector %"PRDSNu" (%s)\n",
+                  sector - 1, error);
+          break;
+        }
+      if (type == USTAR_EOF)
+        break;
+      if (type == USTAR_REGULAR)
+        {
+          e = malloc (sizeof *e);
+          if (e == NULL)
+            {
+              free (header);
+              return false;
+            }
+          strlcpy (e->name, file_name, sizeof e->name);
+          e->sector = sector;
+          e->size = size;
+          list_push_back (&tarfs_entries, &e->elem);
+          file_cnt++;
+        }
+      sector += DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
+    }
+  free (header);
+
+  tarfs_device = device;
+  printf ("Mounted %zu files from scratch device at %s.\n",
+          file_cnt, TARFS_MOUNT);
+  return true;
+}
+
+/* Returns true if the archive is mounted. */
+bool
+tarfs_is_mounted (void)
+{
+  return tarfs_device != NULL;
+}
+
+/* Opens the file named NAME in the archive.  Returns the new
+   file if successful or a null pointer otherwise. */
+struct file *
+tarfs_open (const char *name)
+{
+  struct list_elem *e;
+
+  if (tarfs_device == NULL)
+    return NULL;
+  for (e = list_begin (&tarfs_entries); e != list_end (&tarfs_entries);
+       e = list_next (e))
+    {
+      struct tarfs_entry *entry = list_entry (e, struct tarfs_entry, elem);
+      if (!strcmp (entry->name, name))
+        return file_open_ops (&tarfs_ops, entry);
+    }
+  return NULL;
+}
+
+/* File operations on archive entries. */
+
+static off_t
+tarfs_read_at (void *entry_, void *buffer_, off_t size, off_t offset)
+{
+  struct tarfs_entry *entry = entry_;
+  uint8_t *buffer = buffer_;
+  uint8_t *bounce = NULL;
+  off_t bytes_read = 0;
+
+  while (size > 0 && offset < entry->size)
+    {
+      block_sector_t sector_idx = offset / BLOCK_SECTOR_SIZE;
+      int sector_ofs = offset % BLOCK_SECTOR_SIZE;
+      off_t chunk = BLOCK_SECTOR_SIZE - sector_ofs;
+
+      if (chunk > size)
+        chunk = size;
+      if (chunk > entry->size - offset)
+        chunk = entry->size - offset;
+
+      /* BUFFER may be user memory, which a device must not be
+         handed, so every sector goes through a bounce buffer. */
+      if (bounce == NULL)
+        {
+          bounce = malloc (BLOCK_SECTOR_SIZE);
+          if (bounce == NULL)
+            break;
+        }
+      block_read (tarfs_device, entry->sector + sector_idx, bounce);
+      memcpy (buffer + bytes_read, bounce + sector_ofs, chunk);
+
+      size -= chunk;
+      offset += chunk;
+      bytes_read += chunk;
+    }
+  free (bounce);
+  return bytes_read;
+}
+
+/* The archive is read-only. */
+static off_t
+tarfs_write_at (void *entry UNUSED, const void *buffer UNUSED,
+                off_t size UNUSED, off_t offset UNUSED)
+{
+  return 0;
+}
+
+static off_t
+tarfs_length (void *entry_)
+{
+  struct tarfs_entry *entry = entry_;
+  return entry->size;
+}
+
+static void *
+tarfs_reopen (void *entry)
+{
+  return entry;
+}
+
+static void
+tarfs_close (void *entry UNUSED)
+{
+}
+
+/* Writes are never allowed, so there is nothing to deny. */
+static void
+tarfs_deny_write (void *entry UNUSED)
+{
+}
+
+static void
+tarfs_allow_write (void *entry UNUSED)
+{
+}
+
+static const struct file_ops tarfs_ops =
+  {
+    tarfs_read_at,
+    tarfs_write_at,
+    tarfs_length,
+    tarfs_reopen,
+    tarfs_close,
+    tarfs_deny_write,
+    tarfs_allow_write,
+    NULL
+  };
@@ -0,0 +1,14 @@
+#ifndef FILESYS_TARFS_H
+#define FILESYS_TARFS_H
+
+#include <stdbool.h>
+
+/* Names under this prefix are files of the tar archive on the
+   scratch device, once it is mounted, rather than disk files. */
+#define TARFS_MOUNT "/scratch/"
+
+bool tarfs_mount (void);
+bool tarfs_is_mounted (void);
+struct file *tarfs_open (const char *name);
+
+#endif /* filesys/tarfs.h */
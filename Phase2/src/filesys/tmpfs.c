@@ -0,0 +1,310 @@
+#include "filesys/tmpfs.h"
+#include <debug.h>
+#include <list.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A file held entirely in memory.  Its contents are lost at
+   shutdown, and never touch the free map, the buffer cache, or
+   the file system device. */
+struct tmpfs_node
+  {
+    struct list_elem elem;              /* Element in tmpfs_nodes. */
+    char name[NAME_MAX + 1];            /* File name. */
+    int open_cnt;                       /* Number of openers. */
+    bool removed;                       /* True if deleted. */
+    struct rwlock rw;                   /* Guards the members below. */
+    int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    off_t length;                       /* File size in bytes. */
+    size_t page_cnt;                    /* Number of elements in PAGES. */
+    uint8_t **pages;                    /* Data, a null page reads as 0s. */
+  };
+
+/* Files that have names, and the lock that protects it along
+   with the open_cnt and removed members of every node. */
+static struct list tmpfs_nodes;
+static struct lock tmpfs_lock;
+
+static const struct file_ops tmpfs_ops;
+
+/* Initializes tmpfs, which starts out empty. */
+void
+tmpfs_init (void) 
+{
+  list_init (&tmpfs_nodes);
+  lock_init (&tmpfs_lock);
+}
+
+/* Returns the node named NAME, or a null pointer if there is
+   none.  The caller must hold tmpfs_lock. */
+static struct tmpfs_node *
+lookup (const char *name) 
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&tmpfs_lock));
+  for (e = list_begin (&tmpfs_nodes); e != list_end (&tmpfs_nodes);
+       e = list_next (e))
+    {
+      struct tmpfs_node *node = list_entry (e, struct tmpfs_node, elem);
+      if (!strcmp (node->name, name))
+        return node;
+    }
+  return NULL;
+}
+
+/* Frees NODE and its data. */
+static void
+free_node (struct tmpfs_node *node) 
+{
+  size_t i;
+
+  for (i = 0; i < node->page_cnt; i++)
+    palloc_free_page (node->pages[i]);
+  free (node->pages);
+  free (node);
+}
+
+/* Creates a file named NAME, INITIAL_SIZE bytes long and
+   initially all zeros.  Returns true if successful, false if
+   NAME is empty, too long, or already exists, or if memory
+   runs out. */
+bool
+tmpfs_create (const char *name, off_t initial_size) 
+{
+  struct tmpfs_node *node;
+  bool success = false;
+
+  if (*name == '\0' || strlen (name) > NAME_MAX || strchr (name, '/')
+      || initial_size < 0)
+    return false;
+
+  lock_acquire (&tmpfs_lock);
+  if (lookup (name) == NULL)
+    {
+      node = calloc (1, sizeof *node);
+      if (node != NULL)
+        {
+          strlcpy (node->name, name, sizeof node->name);
+          rw_init (&node->rw, RW_PREFER_WRITERS);
+          node->length = initial_size;
+          list_push_back (&tmpfs_nodes, &node->elem);
+          success = true;
+        }
+    }
+  lock_release (&tmpfs_lock);
+  return success;
+}
+
+/* Opens the file named NAME.  Returns the new file if
+   successful or a null pointer otherwise. */
+struct file *
+tmpfs_open (const char *name) 
+{
+  struct tmpfs_node *node;
+
+  lock_acquire (&tmpfs_lock);
+  node = lookup (name);
+  if (node != NULL)
+    node->open_cnt++;
+  lock_release (&tmpfs_lock);
+
+  return file_open_ops (&tmpfs_ops, node);
+}
+
+/* Deletes the file named NAME.  Its data is freed when the last
+   opener closes it.  Returns true if successful, false if there
+   is no file named NAME. */
+bool
+tmpfs_remove (const char *name) 
+{
+  struct tmpfs_node *node;
+  bool unused = false;
+
+  lock_acquire (&tmpfs_lock);
+  node = lookup (name);
+  if (node != NULL)
+    {
+      list_remove (&node->elem);
+      node->removed = true;
+      unused = node->open_cnt == 0;
+    }
+  lock_release (&tmpfs_lock);
+
+  if (unused)
+    free_node (node);
+  return node != NULL;
+}
+
+/* Makes NODE's page array cover at least PAGE_CNT pages.
+   Returns true if successful, false if memory runs out.  The
+   caller must hold NODE's lock for writing. */
+static bool
+grow_page_array (struct tmpfs_node *node, size_t page_cnt) 
+{
+  uint8_t **pages;
+
+  if (page_cnt <= node->page_cnt)
+    return true;
+  if (page_cnt < node->page_cnt * 2)
+    page_cnt = node->page_cnt * 2;
+  pages = realloc (node->pages, page_cnt * sizeof *pages);
+  if (pages == NULL)
+    return false;
+  memset (pages + node->page_cnt, 0,
+          (page_cnt - node->page_cnt) * sizeof *pages);
+  node->pages = pages;
+  node->page_cnt = page_cnt;
+  return true;
+}
+
+/* File operations on tmpfs nodes. */
+
+static off_t
+tmpfs_read_at (void *node_, void *buffer_, off_t size, off_t offset) 
+{
+  struct tmpfs_node *node = node_;
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  rw_read_acquire (&node->rw);
+  while (size > 0 && offset < node->length)
+    {
+      size_t page_idx = offset / PGSIZE;
+      int page_ofs = offset % PGSIZE;
+      off_t chunk = PGSIZE - page_ofs;
+
+      if (chunk > size)
+        chunk = size;
+      if (chunk > node->length - offset)
+        chunk = node->length - offset;
+      if (page_idx < node->page_cnt && node->pages[page_idx] != NULL)
+        memcpy (buffer + bytes_read, node->pages[page_idx] + page_ofs,
+                chunk);
+      else
+        memset (buffer + bytes_read, 0, chunk);
+
+      size -= chunk;
+      offset += chunk;
+      bytes_read += chunk;
+    }
+  rw_read_release (&node->rw);
+  return bytes_read;
+}
+
+/* Unlike disk files, tmpfs files grow when written past their
+   end. */
+static off_t
+tmpfs_write_at (void *node_, const void *buffer_, off_t size, off_t offset) 
+{
+  struct tmpfs_node *node = node_;
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = 0;
+
+  rw_write_acquire (&node->rw);
+  if (node->deny_write_cnt == 0)
+    while (size > 0)
+      {
+        size_t page_idx = offset / PGSIZE;
+        int page_ofs = offset % PGSIZE;
+        off_t chunk = PGSIZE - page_ofs;
+
+        if (chunk > size)
+          chunk = size;
+        if (!grow_page_array (node, page_idx + 1))
+          break;
+        if (node->pages[page_idx] == NULL)
+          {
+            node->pages[page_idx] = palloc_get_page (PAL_ZERO);
+            if (node->pages[page_idx] == NULL)
+              break;
+          }
+        memcpy (node->pages[page_idx] + page_ofs, buffer + bytes_written,
+                chunk);
+
+        size -= chunk;
+        offset += chunk;
+        bytes_written += chunk;
+      }
+  if (offset > node->length && bytes_written > 0)
+    node->length = offset;
+  rw_write_release (&node->rw);
+  return bytes_written;
+}
+
+static off_t
+tmpfs_length (void *node_) 
+{
+  struct tmpfs_node *node = node_;
+  off_t length;
+
+  rw_read_acquire (&node->rw);
+  length = node->length;
+  rw_read_release (&node->rw);
+  return length;
+}
+
+static void *
+tmpfs_reopen (void *node_) 
+{
+  struct tmpfs_node *node = node_;
+
+  lock_acquire (&tmpfs_lock);
+  node->open_cnt++;
+  lock_release (&tmpfs_lock);
+  return node;
+}
+
+/* Closes NODE, freeing it if it was the last opener and the
+   file has been removed. */
+static void
+tmpfs_close (void *node_) 
+{
+  struct tmpfs_node *node = node_;
+  bool unused;
+
+  lock_acquire (&tmpfs_lock);
+  unused = --node->open_cnt == 0 && node->removed;
+  lock_release (&tmpfs_lock);
+
+  if (unused)
+    free_node (node);
+}
+
+static void
+tmpfs_deny_write (void *node_) 
+{
+  struct tmpfs_node *node = node_;
+
+  rw_write_acquire (&node->rw);
+  node->deny_write_cnt++;
+  rw_write_release (&node->rw);
+}
+
+static void
+tmpfs_allow_write (void *node_) 
+{
+  struct tmpfs_node *node = node_;
+
+  rw_write_acquire (&node->rw);
+  ASSERT (node->deny_write_cnt > 0);
+  node->deny_write_cnt--;
+  rw_write_release (&node->rw);
+}
+
+static const struct file_ops tmpfs_ops =
+  {
+    tmpfs_read_at,
+    tmpfs_write_at,
+    tmpfs_length,
+    tmpfs_reopen,
+    tmpfs_close,
+    tmpfs_deny_write,
+    tmpfs_allow_write,
+    NULL
+  };
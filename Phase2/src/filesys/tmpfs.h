@@ -0,0 +1,15 @@
+#ifndef FILESYS_TMPFS_H
+#define FILESYS_TMPFS_H
+
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+/* Names under this prefix are tmpfs files rather than disk files. */
+#define TMPFS_MOUNT "/tmp/"
+
+void tmpfs_init (void);
+bool tmpfs_create (const char *name, off_t initial_size);
+struct file *tmpfs_open (const char *name);
+bool tmpfs_remove (const char *name);
+
+#endif /* filesys/tmpfs.h */
@@ -12,7 +12,10 @@
    necessary libraries, including libgcc.  Thus, we can make
    Pintos work on these machines by simply implementing our own
    64-bit division routines, which are the only routines from
-   libgcc that Pintos requires.
+   libgcc that Pintos requires.  With optimization, as in a
+   release build, GCC also combines a division and remainder of
+   the same operands into one call to __udivmoddi4() or
+   __divmoddi4().
 
    Completeness is another reason to include these routines.  If
    Pintos is completely self-contained, then that makes it that
@@ -128,7 +131,7 @@ udiv64 (uint64_t n, uint64_t d)
 
 /* Divides unsigned 64-bit N by unsigned 64-bit D and returns the
    remainder. */
-static uint32_t
+static uint64_t
 umod64 (uint64_t n, uint64_t d)
 {
   return n - d * udiv64 (n, d);
@@ -147,7 +150,7 @@ sdiv64 (int64_t n, int64_t d)
 
 /* Divides signed 64-bit N by signed 64-bit D and returns the
    remainder. */
-static int32_t
+static int64_t
 smod64 (int64_t n, int64_t d)
 {
   return n - d * sdiv64 (n, d);
@@ -159,6 +162,9 @@ long long __divdi3 (long long n, long long d);
 long long __moddi3 (long long n, long long d);
 unsigned long long __udivdi3 (unsigned long long n, unsigned long long d);
 unsigned long long __umoddi3 (unsigned long long n, unsigned long long d);
+long long __divmoddi4 (long long n, long long d, long long *r);
+unsigned long long __udivmoddi4 (unsigned long long n, unsigned long long d,
+                                 unsigned long long *r);
 
 /* Signed 64-bit division. */
 long long
@@ -187,3 +193,22 @@ __umoddi3 (unsigned long long n, unsigned long long d)
 {
   return umod64 (n, d);
 }
+
+/* Signed 64-bit division, storing the remainder in *R. */
+long long
+__divmoddi4 (long long n, long long d, long long *r)
+{
+  long long q = sdiv64 (n, d);
+  *r = n - d * q;
+  return q;
+}
+
+/* Unsigned 64-bit division, storing the remainder in *R. */
+unsigned long long
+__udivmoddi4 (unsigned long long n, unsigned long long d,
+              unsigned long long *r)
+{
+  unsigned long long q = udiv64 (n, d);
+  *r = n - d * q;
+  return q;
+}
@@ -0,0 +1,47 @@
+#include <clock.h>
+
+/* Returns the time-stamp counter. */
+static inline uint64_t
+read_tsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Stores in *TS the time by CLOCK, CLOCK_REALTIME or
+   CLOCK_MONOTONIC, according to clock page P.  Returns 0 if
+   successful, -1 if CLOCK is not a clock. */
+int
+clock_page_read (const struct clock_page *p_, int clock,
+                 struct timespec *ts)
+{
+  const volatile struct clock_page *p = p_;
+  uint32_t seq, boot_sec;
+  uint64_t ns, cycles;
+
+  if (clock != CLOCK_REALTIME && clock != CLOCK_MONOTONIC)
+    return -1;
+
+  do
+    {
+      seq = p->seq;
+      asm volatile ("" : : : "memory");
+
+      cycles = read_tsc () - p->tsc_base;
+      if (cycles > p->tsc_max)
+        cycles = p->tsc_max;
+      ns = p->ns_base + (((uint64_t) (uint32_t) cycles * p->tsc_mult)
+                         >> CLOCK_SHIFT);
+      boot_sec = p->boot_sec;
+
+      asm volatile ("" : : : "memory");
+    }
+  while ((seq & 1) != 0 || seq != p->seq);
+
+  ts->tv_sec = ns / 1000000000;
+  ts->tv_nsec = ns % 1000000000;
+  if (clock == CLOCK_REALTIME)
+    ts->tv_sec += boot_sec;
+  return 0;
+}
@@ -0,0 +1,45 @@
+#ifndef __LIB_CLOCK_H
+#define __LIB_CLOCK_H
+
+#include <stdint.h>
+
+/* Clocks for clock_gettime(). */
+#define CLOCK_REALTIME 0        /* Time since the Unix epoch. */
+#define CLOCK_MONOTONIC 1       /* Time since boot, never set back. */
+
+/* A time, as clock_gettime() reports it. */
+struct timespec
+  {
+    long long tv_sec;           /* Seconds. */
+    long tv_nsec;               /* Nanoseconds, 0...999,999,999. */
+  };
+
+/* What the kernel knows about the time, updated at every timer
+   tick.  Between ticks, the time is extrapolated from the
+   time-stamp counter, but never by more than a tick's worth of
+   cycles, so that it cannot run ahead of the next tick.
+
+   The kernel maps this page read-only into every user process
+   at CLOCK_PAGE_ADDR, so that reading the time takes no system
+   call.  SEQ is odd while the kernel is changing the rest, and
+   changes every time it does: readers retry if they see it odd
+   or changed. */
+struct clock_page
+  {
+    uint32_t seq;               /* Update count; odd while updating. */
+    uint32_t boot_sec;          /* Seconds since the epoch at boot. */
+    uint32_t tsc_max;           /* TSC cycles per timer tick. */
+    uint32_t tsc_mult;          /* Nanoseconds per cycle << CLOCK_SHIFT. */
+    uint64_t tsc_base;          /* TSC at the latest tick. */
+    uint64_t ns_base;           /* Nanoseconds since boot at that tick. */
+  };
+#define CLOCK_SHIFT 24
+
+/* Where the clock page is in user processes: the page below the
+   lowest address that executables are linked at. */
+#define CLOCK_PAGE_ADDR ((const struct clock_page *) 0x08047000)
+
+int clock_page_read (const struct clock_page *, int clock,
+                     struct timespec *);
+
+#endif /* lib/clock.h */
@@ -0,0 +1,14 @@
+#ifndef __LIB_CRC32_H
+#define __LIB_CRC32_H
+
+/* CRC-32 with the polynomial 0x04c11db7 processed most
+   significant bit first, the one in the `cksum' entry of
+   [SUSv3], shared by the kernel and user programs. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint32_t crc32_update (uint32_t crc, const void *, size_t);
+uint32_t crc32 (const void *, size_t);
+
+#endif /* lib/crc32.h */
@@ -25,6 +25,7 @@ void debug_backtrace_all (void);
 /* This is outside the header guard so that debug.h may be
    included multiple times with different settings of NDEBUG. */
 #undef ASSERT
+#undef DEBUG_ASSERT
 #undef NOT_REACHED
 
 #ifndef NDEBUG
@@ -36,4 +37,15 @@ void debug_backtrace_all (void);
 #else
 #define ASSERT(CONDITION) ((void) 0)
 #define NOT_REACHED() for (;;)
+#endif
+
+/* DEBUG_ASSERT is for checks on paths that run thousands of
+   times per tick, such as list traversal and thread_current(),
+   or that cost more than the work they guard.  It is the same as
+   ASSERT, except that a release build, which defines RELEASE,
+   compiles it out. */
+#if !defined NDEBUG && !defined RELEASE
+#define DEBUG_ASSERT(CONDITION) ASSERT (CONDITION)
+#else
+#define DEBUG_ASSERT(CONDITION) ((void) 0)
 #endif /* lib/debug.h */
@@ -0,0 +1,23 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+#include <stdbool.h>
+
+/* One directory entry with its file's attributes, as reported by
+   readdir_plus(). */
+struct dirent_plus
+  {
+    char name[14 + 1];          /* Null terminated file name. */
+    bool is_dir;                /* Directory or ordinary file? */
+    int inumber;                /* Sector of the file's inode. */
+    int size;                   /* File length in bytes. */
+  };
+
+/* Most entries a single readdir_plus() fills in. */
+#define READDIR_PLUS_MAX 64
+
+/* Most names a single create_many(), remove_many() or
+   stat_many() takes. */
+#define NAMES_BATCH_MAX 64
+
+#endif /* lib/dirent.h */
@@ -0,0 +1,18 @@
+#ifndef __LIB_IOVEC_H
+#define __LIB_IOVEC_H
+
+#include <stddef.h>
+
+/* One segment of a vectored read or write.  readv() fills the
+   segments in order, and writev() writes them out in order, as
+   if they were a single buffer. */
+struct iovec
+  {
+    void *iov_base;             /* Start of the segment. */
+    size_t iov_len;             /* Bytes in it. */
+  };
+
+/* Most segments a single readv() or writev() takes. */
+#define IOV_MAX 64
+
+#endif /* lib/iovec.h */
@@ -3,6 +3,7 @@
 #include <limits.h>
 #include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
 #ifdef FILESYS
 #include "filesys/file.h"
@@ -27,6 +28,8 @@ typedef unsigned long elem_type;
 struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
+    size_t set_cnt;     /* Number of bits set to true. */
+    size_t next_fit;    /* Where bitmap_alloc() starts looking. */
     elem_type *bits;    /* Elements that represent bits. */
   };
 
@@ -69,6 +72,73 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns a mask of the bits of an element from bit START up to
+   but not including bit END, where 0 <= START < END <= ELEM_BITS. */
+static inline elem_type
+range_mask (size_t start, size_t end)
+{
+  elem_type high = (end < ELEM_BITS
+                    ? ((elem_type) 1 << end) - 1 : (elem_type) -1);
+  return high & ((elem_type) -1 << start);
+}
+
+/* Returns the number of bits set in E.  (GCC's __builtin_popcount
+   calls into libgcc, which the kernel is not linked with.) */
+static inline size_t
+popcount (elem_type e)
+{
+  e = e - ((e >> 1) & 0x55555555);
+  e = (e & 0x33333333) + ((e >> 2) & 0x33333333);
+  e = (e + (e >> 4)) & 0x0f0f0f0f;
+  return (e * 0x01010101) >> 24;
+}
+
+/* Returns the index of the first bit at or after START in B that
+   is set to VALUE, or B's bit count if there is none.  Skips
+   whole elements at a time. */
+static size_t
+next_bit (const struct bitmap *b, size_t start, bool value)
+{
+  elem_type flip = value ? 0 : (elem_type) -1;
+  size_t idx = elem_idx (start);
+  elem_type e;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+
+  e = (b->bits[idx] ^ flip) & ((elem_type) -1 << (start % ELEM_BITS));
+  while (e == 0)
+    {
+      if (++idx >= elem_cnt (b->bit_cnt))
+        return b->bit_cnt;
+      e = b->bits[idx] ^ flip;
+    }
+
+  start = idx * ELEM_BITS + __builtin_ctzl (e);
+  return start < b->bit_cnt ? start : b->bit_cnt;
+}
+
+/* Returns the number of bits in B between START and START + CNT,
+   exclusive, that are set to true, counted an element at a
+   time. */
+static size_t
+count_set (const struct bitmap *b, size_t start, size_t cnt)
+{
+  size_t end = start + cnt;
+  size_t set_cnt = 0;
+
+  while (start < end)
+    {
+      size_t ofs = start % ELEM_BITS;
+      size_t n = end - start < ELEM_BITS - ofs ? end - start : ELEM_BITS - ofs;
+
+      set_cnt += popcount (b->bits[elem_idx (start)]
+                           & range_mask (ofs, ofs + n));
+      start += n;
+    }
+  return set_cnt;
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -82,10 +152,12 @@ bitmap_create (size_t bit_cnt)
   if (b != NULL)
     {
       b->bit_cnt = bit_cnt;
+      b->set_cnt = 0;
+      b->next_fit = 0;
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
-          bitmap_set_all (b, false);
+          memset (b->bits, 0, byte_cnt (bit_cnt));
           return b;
         }
       free (b);
@@ -104,8 +176,10 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
   ASSERT (block_size >= bitmap_buf_size (bit_cnt));
 
   b->bit_cnt = bit_cnt;
+  b->set_cnt = 0;
+  b->next_fit = 0;
   b->bits = (elem_type *) (b + 1);
-  bitmap_set_all (b, false);
+  memset (b->bits, 0, byte_cnt (bit_cnt));
   return b;
 }
 
@@ -156,26 +230,31 @@ bitmap_set (struct bitmap *b, size_t idx, bool value)
 void
 bitmap_mark (struct bitmap *b, size_t bit_idx) 
 {
-  size_t idx = elem_idx (bit_idx);
-  elem_type mask = bit_mask (bit_idx);
-
-  /* This is equivalent to `b->bits[idx] |= mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the OR instruction in [IA32-v2b]. */
-  asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  elem_type *e = &b->bits[elem_idx (bit_idx)];
+
+  /* This is equivalent to `if (!(*e & mask)) { *e |= mask;
+     b->set_cnt++; }' except that it is guaranteed to be atomic
+     on a uniprocessor machine.  BTS leaves the old bit in the
+     carry flag, which survives any interrupt in between, and ADC
+     of the complemented carry updates the count in one more
+     instruction.  See the descriptions of the BTS, CMC and ADC
+     instructions in [IA32-v2a]. */
+  asm ("btsl %2, %0; cmc; adcl $0, %1"
+       : "+m" (*e), "+m" (b->set_cnt) : "r" (bit_idx % ELEM_BITS) : "cc");
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
 void
 bitmap_reset (struct bitmap *b, size_t bit_idx) 
 {
-  size_t idx = elem_idx (bit_idx);
-  elem_type mask = bit_mask (bit_idx);
-
-  /* This is equivalent to `b->bits[idx] &= ~mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the AND instruction in [IA32-v2a]. */
-  asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  elem_type *e = &b->bits[elem_idx (bit_idx)];
+
+  /* This is equivalent to `if (*e & mask) { *e &= ~mask;
+     b->set_cnt--; }' except that it is guaranteed to be atomic
+     on a uniprocessor machine.  See the descriptions of the BTR
+     and SBB instructions in [IA32-v2a] and [IA32-v2b]. */
+  asm ("btrl %2, %0; sbbl $0, %1"
+       : "+m" (*e), "+m" (b->set_cnt) : "r" (bit_idx % ELEM_BITS) : "cc");
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -184,13 +263,14 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
 void
 bitmap_flip (struct bitmap *b, size_t bit_idx) 
 {
-  size_t idx = elem_idx (bit_idx);
-  elem_type mask = bit_mask (bit_idx);
-
-  /* This is equivalent to `b->bits[idx] ^= mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the XOR instruction in [IA32-v2b]. */
-  asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  elem_type *e = &b->bits[elem_idx (bit_idx)];
+
+  /* This is equivalent to `*e ^= mask' plus the matching change
+     to b->set_cnt, except that it is guaranteed to be atomic on
+     a uniprocessor machine.  See the description of the BTC
+     instruction in [IA32-v2a]. */
+  asm ("btcl %2, %0; jc 1f; incl %1; jmp 2f; 1: decl %1; 2:"
+       : "+m" (*e), "+m" (b->set_cnt) : "r" (bit_idx % ELEM_BITS) : "cc");
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -213,18 +293,38 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE.
+   Works an element at a time; each element is updated
+   atomically, but the bits as a whole are not. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
+  size_t end = start + cnt;
+
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  while (start < end)
+    {
+      size_t idx = elem_idx (start);
+      size_t ofs = start % ELEM_BITS;
+      size_t n = end - start < ELEM_BITS - ofs ? end - start : ELEM_BITS - ofs;
+      elem_type mask = range_mask (ofs, ofs + n);
+      elem_type *e = &b->bits[idx];
+
+      if (value)
+        {
+          b->set_cnt += n - popcount (*e & mask);
+          asm ("orl %1, %0" : "+m" (*e) : "r" (mask) : "cc");
+        }
+      else
+        {
+          b->set_cnt -= popcount (*e & mask);
+          asm ("andl %1, %0" : "+m" (*e) : "r" (~mask) : "cc");
+        }
+      start += n;
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -232,17 +332,17 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  size_t set_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
-  return value_cnt;
+  if (start == 0 && cnt == b->bit_cnt)
+    set_cnt = b->set_cnt;
+  else
+    set_cnt = count_set (b, start, cnt);
+  return value ? set_cnt : cnt - set_cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -250,16 +350,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return cnt > 0 && next_bit (b, start, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -298,13 +393,21 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  if (cnt == 0)
+    return start;
+  while (cnt <= b->bit_cnt - start)
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      /* Find the next run of VALUE bits and see if it is long
+         enough.  If not, carry on after it. */
+      size_t end;
+
+      start = next_bit (b, start, value);
+      if (cnt > b->bit_cnt - start)
+        break;
+      end = next_bit (b, start, !value);
+      if (end - start >= cnt)
+        return start;
+      start = end;
     }
   return BITMAP_ERROR;
 }
@@ -324,7 +427,37 @@ bitmap_scan_and_flip (struct bitmap *b, size_t start, size_t cnt, bool value)
     bitmap_set_multiple (b, idx, cnt, !value);
   return idx;
 }
-
+
+/* Finds a group of CNT consecutive false bits in B, sets them
+   all to true, and returns the index of the first bit in the
+   group.  The search starts just past the group the previous
+   call returned and wraps around to the start of B (next fit),
+   so that allocating from a mostly full bitmap does not rescan
+   the full part each time.  If B has fewer than CNT false bits
+   in all, fails without scanning.
+   If there is no such group, returns BITMAP_ERROR.
+   Testing bits is not atomic with setting them. */
+size_t
+bitmap_alloc (struct bitmap *b, size_t cnt)
+{
+  size_t idx;
+
+  ASSERT (b != NULL);
+
+  if (cnt > b->bit_cnt - b->set_cnt)
+    return BITMAP_ERROR;
+
+  idx = bitmap_scan (b, b->next_fit, cnt, false);
+  if (idx == BITMAP_ERROR && b->next_fit > 0)
+    idx = bitmap_scan (b, 0, cnt, false);
+  if (idx != BITMAP_ERROR)
+    {
+      bitmap_set_multiple (b, idx, cnt, true);
+      b->next_fit = idx + cnt < b->bit_cnt ? idx + cnt : 0;
+    }
+  return idx;
+}
+
 /* File input and output. */
 
 #ifdef FILESYS
@@ -346,6 +479,8 @@ bitmap_read (struct bitmap *b, struct file *file)
       off_t size = byte_cnt (b->bit_cnt);
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
+      b->set_cnt = count_set (b, 0, b->bit_cnt);
+      b->next_fit = 0;
     }
   return success;
 }
@@ -358,6 +493,27 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes to FILE, which holds B as written by bitmap_write(),
+   only the bytes that contain the CNT bits starting at START.
+   On the little-endian x86, bit I is in byte I / CHAR_BIT.
+   Returns true if successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t start, size_t cnt)
+{
+  off_t ofs, size;
+
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (cnt <= b->bit_cnt - start);
+
+  if (cnt == 0)
+    return true;
+  ofs = start / CHAR_BIT;
+  size = (start + cnt - 1) / CHAR_BIT + 1 - ofs;
+  return file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs)
+         == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
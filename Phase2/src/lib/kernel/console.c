@@ -1,18 +1,24 @@
 #include <console.h>
+#include <klog.h>
 #include <stdarg.h>
+#include <stats.h>
 #include <stdio.h>
-#include "devices/serial.h"
-#include "devices/vga.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 
-static void vprintf_helper (char, void *);
+static void vprintf_helper (const char *, size_t, void *);
+static void putbuf_have_lock (const char *, size_t, int level);
 static void putchar_have_lock (uint8_t c);
 
-/* The console lock.
-   Both the vga and serial layers do their own locking, so it's
-   safe to call them at any time.
+/* Everything written to the console goes into the kernel log,
+   which writes it out to the vga display and serial port (see
+   klog.c).  printf() takes a KERN_* prefix on the format string
+   to give its output another level than KLOG_INFO.
+
+   The console lock.
+   The kernel log does its own locking, so it's safe to call it
+   at any time.
    But this lock is useful to prevent simultaneous printf() calls
    from mixing their output, which looks confusing. */
 static struct lock console_lock;
@@ -65,15 +71,17 @@ console_init (void)
 {
   lock_init (&console_lock);
   use_console_lock = true;
+  stats_add_int64 ("console", NULL, "chars", &write_cnt);
 }
 
 /* Notifies the console that a kernel panic is underway,
    which warns it to avoid trying to take the console lock from
-   now on. */
+   now on, and to write output out before returning. */
 void
 console_panic (void) 
 {
   use_console_lock = false;
+  klog_panic ();
 }
 
 /* Prints console statistics. */
@@ -119,19 +127,32 @@ console_locked_by_current_thread (void)
           || lock_held_by_current_thread (&console_lock));
 }
 
+/* What vprintf() passes to vprintf_helper(). */
+struct vprintf_aux
+  {
+    int char_cnt;               /* Characters written so far. */
+    int level;                  /* KLOG_* level to log them at. */
+  };
+
 /* The standard vprintf() function,
    which is like printf() but uses a va_list.
    Writes its output to both vga display and serial port. */
 int
 vprintf (const char *format, va_list args) 
 {
-  int char_cnt = 0;
+  struct vprintf_aux aux = {0, KLOG_INFO};
+
+  if (format[0] == KERN_SOH[0] && format[1] >= '0' && format[1] <= '7')
+    {
+      aux.level = format[1] - '0';
+      format += 2;
+    }
 
   acquire_console ();
-  __vprintf (format, args, vprintf_helper, &char_cnt);
+  __vprintf_runs (format, args, vprintf_helper, &aux);
   release_console ();
 
-  return char_cnt;
+  return aux.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -153,8 +174,7 @@ void
 putbuf (const char *buffer, size_t n) 
 {
   acquire_console ();
-  while (n-- > 0)
-    putchar_have_lock (*buffer++);
+  putbuf_have_lock (buffer, n, KLOG_INFO);
   release_console ();
 }
 
@@ -171,21 +191,33 @@ putchar (int c)
 
 /* Helper function for vprintf(). */
 static void
-vprintf_helper (char c, void *char_cnt_) 
+vprintf_helper (const char *run, size_t n, void *aux_) 
 {
-  int *char_cnt = char_cnt_;
-  (*char_cnt)++;
-  putchar_have_lock (c);
+  struct vprintf_aux *aux = aux_;
+  aux->char_cnt += n;
+  putbuf_have_lock (run, n, aux->level);
+}
+
+/* Writes the N characters in BUFFER to the kernel log at LEVEL.
+   The caller has already acquired the console lock if
+   appropriate. */
+static void
+putbuf_have_lock (const char *buffer, size_t n, int level) 
+{
+  ASSERT (console_locked_by_current_thread ());
+  write_cnt += n;
+  klog_write (level, buffer, n);
 }
 
-/* Writes C to the vga display and serial port.
+/* Writes C to the kernel log.
    The caller has already acquired the console lock if
    appropriate. */
 static void
 putchar_have_lock (uint8_t c) 
 {
+  char ch = c;
+
   ASSERT (console_locked_by_current_thread ());
   write_cnt++;
-  serial_putc (c);
-  vga_putc (c);
+  klog_write (KLOG_INFO, &ch, 1);
 }
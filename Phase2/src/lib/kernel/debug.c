@@ -96,7 +96,8 @@ print_stacktrace(struct thread *t, void *aux UNUSED)
          at the top of their kernel stack page, or the 
          switch_threads_frame's 'eip' member points at switch_entry.
          See also threads.c. */
-      if (t->stack == (uint8_t *)t + PGSIZE || saved_frame->eip == switch_entry)
+      if (t->stack == thread_kstack_top (t)
+          || saved_frame->eip == switch_entry)
         {
           printf (" thread was never scheduled.\n");
           return;
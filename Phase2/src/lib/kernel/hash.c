@@ -12,12 +12,24 @@
 #define list_elem_to_hash_elem(LIST_ELEM)                       \
         list_entry(LIST_ELEM, struct hash_elem, list_elem)
 
+/* Element per bucket ratios. */
+#define MIN_ELEMS_PER_BUCKET  1 /* Elems/bucket < 1: reduce # of buckets. */
+#define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
+#define MAX_ELEMS_PER_BUCKET  4 /* Elems/bucket > 4: increase # of buckets. */
+
+/* Old buckets moved to the new array per insertion or deletion
+   during an incremental resize. */
+#define DRAIN_BUCKETS 2
+
 static struct list *find_bucket (struct hash *, struct hash_elem *);
+static struct list *next_bucket (struct hash *, struct list *);
 static struct hash_elem *find_elem (struct hash *, struct list *,
                                     struct hash_elem *);
 static void insert_elem (struct hash *, struct list *, struct hash_elem *);
 static void remove_elem (struct hash *, struct hash_elem *);
 static void rehash (struct hash *);
+static bool start_resize (struct hash *, size_t new_bucket_cnt);
+static void drain (struct hash *, size_t bucket_cnt);
 
 /* Initializes hash table H to compute hash values using HASH and
    compare hash elements using LESS, given auxiliary data AUX. */
@@ -28,6 +40,11 @@ hash_init (struct hash *h,
   h->elem_cnt = 0;
   h->bucket_cnt = 4;
   h->buckets = malloc (sizeof *h->buckets * h->bucket_cnt);
+  h->old_buckets = NULL;
+  h->old_bucket_cnt = 0;
+  h->drain_idx = 0;
+  h->min_bucket_cnt = 4;
+  h->incremental = false;
   h->hash = hash;
   h->less = less;
   h->aux = aux;
@@ -53,12 +70,10 @@ hash_init (struct hash *h,
 void
 hash_clear (struct hash *h, hash_action_func *destructor) 
 {
-  size_t i;
+  struct list *bucket;
 
-  for (i = 0; i < h->bucket_cnt; i++) 
+  for (bucket = h->buckets; bucket != NULL; bucket = next_bucket (h, bucket))
     {
-      struct list *bucket = &h->buckets[i];
-
       if (destructor != NULL) 
         while (!list_empty (bucket)) 
           {
@@ -70,6 +85,9 @@ hash_clear (struct hash *h, hash_action_func *destructor)
       list_init (bucket); 
     }    
 
+  /* Nothing is left to move out of the old buckets. */
+  free (h->old_buckets);
+  h->old_buckets = NULL;
   h->elem_cnt = 0;
 }
 
@@ -89,6 +107,41 @@ hash_destroy (struct hash *h, hash_action_func *destructor)
   if (destructor != NULL)
     hash_clear (h, destructor);
   free (h->buckets);
+  free (h->old_buckets);
+}
+
+/* Makes hash table H resize incrementally if INCREMENTAL is true,
+   or all at once if it is false.  See hash.h for details. */
+void
+hash_set_incremental (struct hash *h, bool incremental) 
+{
+  h->incremental = incremental;
+  if (!incremental)
+    drain (h, SIZE_MAX);
+}
+
+/* Resizes hash table H, if necessary, to hold ELEM_CNT elements
+   without growing again, and keeps it from shrinking below that
+   size.  Finishes any incremental resize in progress.  Returns
+   true if successful, false if memory allocation failed, in
+   which case H is still usable but may resize later than
+   requested. */
+bool
+hash_reserve (struct hash *h, size_t elem_cnt) 
+{
+  size_t bucket_cnt = 4;
+
+  while (bucket_cnt * BEST_ELEMS_PER_BUCKET < elem_cnt)
+    bucket_cnt *= 2;
+  h->min_bucket_cnt = bucket_cnt;
+
+  drain (h, SIZE_MAX);
+  if (h->bucket_cnt >= bucket_cnt)
+    return true;
+  if (!start_resize (h, bucket_cnt))
+    return false;
+  drain (h, SIZE_MAX);
+  return true;
 }
 
 /* Inserts NEW into hash table H and returns a null pointer, if
@@ -162,13 +215,12 @@ hash_delete (struct hash *h, struct hash_elem *e)
 void
 hash_apply (struct hash *h, hash_action_func *action) 
 {
-  size_t i;
+  struct list *bucket;
   
   ASSERT (action != NULL);
 
-  for (i = 0; i < h->bucket_cnt; i++) 
+  for (bucket = h->buckets; bucket != NULL; bucket = next_bucket (h, bucket))
     {
-      struct list *bucket = &h->buckets[i];
       struct list_elem *elem, *next;
 
       for (elem = list_begin (bucket); elem != list_end (bucket); elem = next) 
@@ -223,7 +275,8 @@ hash_next (struct hash_iterator *i)
   i->elem = list_elem_to_hash_elem (list_next (&i->elem->list_elem));
   while (i->elem == list_elem_to_hash_elem (list_end (i->bucket)))
     {
-      if (++i->bucket >= i->hash->buckets + i->hash->bucket_cnt)
+      i->bucket = next_bucket (i->hash, i->bucket);
+      if (i->bucket == NULL)
         {
           i->elem = NULL;
           break;
@@ -301,12 +354,37 @@ hash_int (int i)
   return hash_bytes (&i, sizeof i);
 }
 
-/* Returns the bucket in H that E belongs in. */
+/* Returns the bucket in H that E belongs in.  While H is being
+   resized, that is E's bucket in the old array if that bucket
+   has not been moved to the new array yet. */
 static struct list *
 find_bucket (struct hash *h, struct hash_elem *e) 
 {
-  size_t bucket_idx = h->hash (e, h->aux) & (h->bucket_cnt - 1);
-  return &h->buckets[bucket_idx];
+  unsigned hash = h->hash (e, h->aux);
+
+  if (h->old_buckets != NULL)
+    {
+      size_t old_idx = hash & (h->old_bucket_cnt - 1);
+      if (old_idx >= h->drain_idx)
+        return &h->old_buckets[old_idx];
+    }
+  return &h->buckets[hash & (h->bucket_cnt - 1)];
+}
+
+/* Returns the bucket in H after BUCKET, visiting all of the
+   current buckets and then any old buckets that still hold
+   elements, or a null pointer after the last one. */
+static struct list *
+next_bucket (struct hash *h, struct list *bucket) 
+{
+  bucket++;
+  if (bucket == h->buckets + h->bucket_cnt)
+    return h->old_buckets != NULL ? h->old_buckets + h->drain_idx : NULL;
+  else if (h->old_buckets != NULL
+           && bucket == h->old_buckets + h->old_bucket_cnt)
+    return NULL;
+  else
+    return bucket;
 }
 
 /* Searches BUCKET in H for a hash element equal to E.  Returns
@@ -339,42 +417,60 @@ is_power_of_2 (size_t x)
   return x != 0 && turn_off_least_1bit (x) == 0;
 }
 
-/* Element per bucket ratios. */
-#define MIN_ELEMS_PER_BUCKET  1 /* Elems/bucket < 1: reduce # of buckets. */
-#define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
-#define MAX_ELEMS_PER_BUCKET  4 /* Elems/bucket > 4: increase # of buckets. */
-
 /* Changes the number of buckets in hash table H to match the
-   ideal.  This function can fail because of an out-of-memory
-   condition, but that'll just make hash accesses less efficient;
-   we can still continue. */
+   ideal, or, if H is already being resized incrementally, moves
+   a few more buckets to the new array.  This function can fail
+   because of an out-of-memory condition, but that'll just make
+   hash accesses less efficient; we can still continue. */
 static void
 rehash (struct hash *h) 
 {
-  size_t old_bucket_cnt, new_bucket_cnt;
-  struct list *new_buckets, *old_buckets;
-  size_t i;
+  size_t new_bucket_cnt;
 
   ASSERT (h != NULL);
 
-  /* Save old bucket info for later use. */
-  old_buckets = h->buckets;
-  old_bucket_cnt = h->bucket_cnt;
+  if (h->old_buckets != NULL)
+    {
+      drain (h, DRAIN_BUCKETS);
+      return;
+    }
 
   /* Calculate the number of buckets to use now.
      We want one bucket for about every BEST_ELEMS_PER_BUCKET.
-     We must have at least four buckets, and the number of
-     buckets must be a power of 2. */
+     We must have at least four buckets, or more if
+     hash_reserve() asked for them, and the number of buckets
+     must be a power of 2. */
   new_bucket_cnt = h->elem_cnt / BEST_ELEMS_PER_BUCKET;
   if (new_bucket_cnt < 4)
     new_bucket_cnt = 4;
   while (!is_power_of_2 (new_bucket_cnt))
     new_bucket_cnt = turn_off_least_1bit (new_bucket_cnt);
+  if (new_bucket_cnt < h->min_bucket_cnt)
+    new_bucket_cnt = h->min_bucket_cnt;
 
   /* Don't do anything if the bucket count wouldn't change. */
-  if (new_bucket_cnt == old_bucket_cnt)
+  if (new_bucket_cnt == h->bucket_cnt)
     return;
 
+  if (start_resize (h, new_bucket_cnt))
+    drain (h, h->incremental ? DRAIN_BUCKETS : SIZE_MAX);
+}
+
+/* Starts resizing H to NEW_BUCKET_CNT buckets, which must be a
+   power of 2, by installing an empty array of that many buckets
+   and keeping the current array as the old buckets, whose
+   elements drain() then moves over.  H must not already be
+   resizing.  Returns true if successful, false if memory
+   allocation failed. */
+static bool
+start_resize (struct hash *h, size_t new_bucket_cnt) 
+{
+  struct list *new_buckets;
+  size_t i;
+
+  ASSERT (h->old_buckets == NULL);
+  ASSERT (is_power_of_2 (new_bucket_cnt));
+
   /* Allocate new buckets and initialize them as empty. */
   new_buckets = malloc (sizeof *new_buckets * new_bucket_cnt);
   if (new_buckets == NULL) 
@@ -382,34 +478,46 @@ rehash (struct hash *h)
       /* Allocation failed.  This means that use of the hash table will
          be less efficient.  However, it is still usable, so
          there's no reason for it to be an error. */
-      return;
+      return false;
     }
   for (i = 0; i < new_bucket_cnt; i++) 
     list_init (&new_buckets[i]);
 
-  /* Install new bucket info. */
+  /* Install new bucket info, keeping the old for drain(). */
+  h->old_buckets = h->buckets;
+  h->old_bucket_cnt = h->bucket_cnt;
+  h->drain_idx = 0;
   h->buckets = new_buckets;
   h->bucket_cnt = new_bucket_cnt;
+  return true;
+}
 
-  /* Move each old element into the appropriate new bucket. */
-  for (i = 0; i < old_bucket_cnt; i++) 
+/* Moves the elements of up to BUCKET_CNT more old buckets in H
+   into the appropriate new buckets, freeing the old array after
+   its last bucket. */
+static void
+drain (struct hash *h, size_t bucket_cnt) 
+{
+  for (; h->old_buckets != NULL && bucket_cnt > 0; bucket_cnt--) 
     {
-      struct list *old_bucket;
-      struct list_elem *elem, *next;
+      struct list *old_bucket = &h->old_buckets[h->drain_idx];
 
-      old_bucket = &old_buckets[i];
-      for (elem = list_begin (old_bucket);
-           elem != list_end (old_bucket); elem = next) 
+      /* Advance drain_idx first, so that find_bucket() puts the
+         bucket's elements in the new array. */
+      h->drain_idx++;
+      while (!list_empty (old_bucket)) 
         {
-          struct list *new_bucket
-            = find_bucket (h, list_elem_to_hash_elem (elem));
-          next = list_next (elem);
-          list_remove (elem);
-          list_push_front (new_bucket, elem);
+          struct list_elem *elem = list_pop_front (old_bucket);
+          list_push_front (find_bucket (h, list_elem_to_hash_elem (elem)),
+                           elem);
         }
-    }
 
-  free (old_buckets);
+      if (h->drain_idx == h->old_bucket_cnt) 
+        {
+          free (h->old_buckets);
+          h->old_buckets = NULL;
+        }
+    }
 }
 
 /* Inserts E into BUCKET (in hash table H). */
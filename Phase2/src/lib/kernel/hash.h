@@ -18,7 +18,17 @@
    conversion from a struct hash_elem back to a structure object
    that contains it.  This is the same technique used in the
    linked list implementation.  Refer to lib/kernel/list.h for a
-   detailed explanation. */
+   detailed explanation.
+
+   By default, a table that grows or shrinks past a power of 2
+   moves all of its elements to a new bucket array at once,
+   inside whichever insertion or deletion crossed the line.
+   After hash_set_incremental(), it instead keeps the old array
+   around and moves a couple of its buckets at a time on each
+   later insertion or deletion, so that no single operation
+   takes time proportional to the size of the table.
+   hash_reserve() sizes the array up front for an expected
+   number of elements. */
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -61,6 +71,11 @@ struct hash
     size_t elem_cnt;            /* Number of elements in table. */
     size_t bucket_cnt;          /* Number of buckets, a power of 2. */
     struct list *buckets;       /* Array of `bucket_cnt' lists. */
+    struct list *old_buckets;   /* Array being resized from, or null. */
+    size_t old_bucket_cnt;      /* Number of buckets in `old_buckets'. */
+    size_t drain_idx;           /* Buckets of `old_buckets' moved so far. */
+    size_t min_bucket_cnt;      /* Fewest buckets, set by hash_reserve(). */
+    bool incremental;           /* Resize a few buckets at a time? */
     hash_hash_func *hash;       /* Hash function. */
     hash_less_func *less;       /* Comparison function. */
     void *aux;                  /* Auxiliary data for `hash' and `less'. */
@@ -78,6 +93,8 @@ struct hash_iterator
 bool hash_init (struct hash *, hash_hash_func *, hash_less_func *, void *aux);
 void hash_clear (struct hash *, hash_action_func *);
 void hash_destroy (struct hash *, hash_action_func *);
+void hash_set_incremental (struct hash *, bool);
+bool hash_reserve (struct hash *, size_t elem_cnt);
 
 /* Search, insertion, deletion. */
 struct hash_elem *hash_insert (struct hash *, struct hash_elem *);
@@ -0,0 +1,407 @@
+#include <klog.h>
+#include <stats.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/debugcon.h"
+#include "devices/serial.h"
+#include "devices/timer.h"
+#include "devices/vga.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Kernel log.
+
+   Everything the kernel writes to the console comes here first.
+   printf() and the rest append it to a ring of records, each
+   with a level, a sequence number and the timer tick it was
+   written at, and return without touching the console devices.
+   A low-priority thread then writes the records out to the
+   serial port and VGA display, so that heavy logging costs a
+   writer no more than a copy.  User programs read the ring with
+   the klog system call.
+
+   A record is a line where it can be: text that continues an
+   unfinished line is added to its record if the level is the
+   same and it fits.
+
+   Records before the drain position have been written out and
+   are kept only for readers, so new records overwrite the oldest
+   of them.  Records from the drain position on have yet to go
+   out and are never overwritten: a writer that would have to
+   does some of the draining itself, sleeping for the console if
+   it can, or writing to it on the spot if it cannot.  The latter
+   can overtake a chunk that the drain thread has taken but not
+   yet written out.
+
+   Until klog_start() and after klog_panic(), each writer writes
+   out its own record on the spot.
+
+   Interrupts must be off to touch the ring. */
+
+#define KLOG_SIZE 16384         /* Bytes in the ring, a power of 2. */
+#define CHUNK_SIZE 256          /* Most bytes the drain takes at once. */
+
+/* Header of a record, followed in the ring by LEN bytes of text. */
+struct record
+  {
+    uint16_t len;               /* Bytes of text. */
+    uint8_t level;              /* KLOG_* level. */
+    bool starts_line;           /* First record of a line? */
+    uint32_t seq;               /* Sequence number. */
+    int64_t ticks;              /* timer_ticks() when written. */
+  };
+
+static uint8_t ring[KLOG_SIZE];
+
+/* Positions in the ring count the bytes ever written into it,
+   wrapping around at 2**32, so distances between them are sizes.
+   The records run from first_pos to write_pos. */
+static uint32_t first_pos;      /* Oldest record. */
+static uint32_t drain_pos;      /* Next record to write out. */
+static size_t drain_ofs;        /* Bytes of it written already. */
+static uint32_t last_pos;       /* Newest record. */
+static uint32_t write_pos;      /* Just past the newest record. */
+static uint32_t next_seq;       /* Sequence number for the next one. */
+static bool line_open;          /* Newest record doesn't end a line? */
+
+int klog_console_level = KLOG_INFO;
+
+/* The drain thread. */
+static bool async;              /* Running, and not panicking? */
+static bool drain_pending;      /* Have we upped drain_sema? */
+static struct semaphore drain_sema;
+static struct lock drain_lock;  /* Held while draining a chunk. */
+static char chunk[CHUNK_SIZE];  /* Chunk drained under drain_lock. */
+
+/* Statistics. */
+static uint64_t record_cnt;     /* Records started. */
+static uint64_t inplace_cnt;    /* Writes out on the spot when full. */
+
+static void append (int level, const char *, size_t);
+static struct record get_record (uint32_t pos);
+static void copy_in (uint32_t pos, const void *, size_t);
+static void copy_out (uint32_t pos, void *, size_t);
+static bool has_room (size_t);
+static size_t take_chunk (char *, size_t);
+static bool drain_chunk (void);
+static void drain_in_place (size_t);
+static void emit (const char *, size_t);
+static thread_func drain_thread NO_RETURN;
+
+/* Starts the thread that writes the log out to the console.
+   Until then, writers write out their own records. */
+void
+klog_start (void)
+{
+  sema_init (&drain_sema, 0);
+  lock_init_named (&drain_lock, "klog");
+  stats_add_uint64 ("klog", NULL, "records", &record_cnt);
+  stats_add_uint64 ("klog", NULL, "inplace", &inplace_cnt);
+  thread_create ("klog", PRI_MIN, drain_thread, NULL);
+  async = true;
+}
+
+/* Adds the N bytes in BUFFER to the log at LEVEL.  Unless LEVEL
+   is above klog_console_level, they also go out to the console,
+   in the order written. */
+void
+klog_write (int level, const char *buffer, size_t n)
+{
+  while (n > 0)
+    {
+      size_t len = n < KLOG_RECORD_MAX ? n : KLOG_RECORD_MAX;
+
+      append (level, buffer, len);
+      buffer += len;
+      n -= len;
+    }
+}
+
+/* Writes out everything waiting for the console before
+   returning. */
+void
+klog_flush (void)
+{
+  if (async && !intr_context () && intr_get_level () == INTR_ON)
+    while (drain_chunk ())
+      continue;
+  else
+    {
+      enum intr_level old_level = intr_disable ();
+      drain_in_place (KLOG_SIZE);
+      intr_set_level (old_level);
+    }
+}
+
+/* Notifies the log that a kernel panic is under way: writes out
+   everything waiting for the console, and from now on has each
+   writer write out its own record on the spot. */
+void
+klog_panic (void)
+{
+  enum intr_level old_level = intr_disable ();
+
+  async = false;
+  drain_in_place (KLOG_SIZE);
+  intr_set_level (old_level);
+}
+
+/* Copies the records from the one numbered *SEQ on into BUFFER,
+   as text in which each line starts with its level and the time
+   it was written, as in "<6>[    1.230] Boot complete.", and
+   advances *SEQ past them.  Starts at the oldest record instead
+   if the one numbered *SEQ has been overwritten.  A record that
+   does not fit in the SIZE bytes left is cut short, and so is a
+   line still being written.  Returns the bytes copied, which is
+   0 once *SEQ is past the newest record. */
+size_t
+klog_read (uint32_t *seq, char *buffer, size_t size)
+{
+  enum intr_level old_level = intr_disable ();
+  uint32_t pos;
+  size_t n = 0;
+
+  for (pos = first_pos; pos != write_pos;
+       pos += sizeof (struct record) + get_record (pos).len)
+    if ((int32_t) (get_record (pos).seq - *seq) >= 0)
+      break;
+
+  while (pos != write_pos && n < size)
+    {
+      struct record r = get_record (pos);
+      size_t take;
+
+      if (r.starts_line)
+        {
+          char prefix[32];
+          size_t len = snprintf (prefix, sizeof prefix, "<%d>[%5lld.%03d] ",
+                                 r.level, r.ticks / TIMER_FREQ,
+                                 (int) (r.ticks % TIMER_FREQ * 1000
+                                        / TIMER_FREQ));
+
+          take = len < size - n ? len : size - n;
+          memcpy (buffer + n, prefix, take);
+          n += take;
+        }
+
+      take = r.len < size - n ? r.len : size - n;
+      copy_out (pos + sizeof r, buffer + n, take);
+      n += take;
+      *seq = r.seq + 1;
+      pos += sizeof r + r.len;
+    }
+  intr_set_level (old_level);
+  return n;
+}
+
+/* Appends the LEN bytes at BUFFER, at most KLOG_RECORD_MAX, to
+   the log at LEVEL, making room for them first. */
+static void
+append (int level, const char *buffer, size_t len)
+{
+  enum intr_level old_level = intr_disable ();
+  struct record r;
+  bool extend;
+
+  for (;;)
+    {
+      r = get_record (last_pos);
+      extend = (line_open && r.level == level
+                && r.len + len <= KLOG_RECORD_MAX);
+      if (extend && drain_pos == write_pos)
+        {
+          /* Back up the drain to the end of the text it has
+             already written out of the record we extend. */
+          drain_pos = last_pos;
+          drain_ofs = r.len;
+        }
+      if (has_room ((extend ? 0 : sizeof r) + len))
+        break;
+
+      if (async && old_level == INTR_ON && !intr_context ())
+        {
+          intr_set_level (old_level);
+          drain_chunk ();
+          intr_disable ();
+        }
+      else
+        {
+          inplace_cnt++;
+          drain_in_place ((extend ? 0 : sizeof r) + len);
+        }
+    }
+
+  /* Drop the oldest records that were written out already, to
+     make space for the new text. */
+  while (write_pos + (extend ? 0 : sizeof r) + len - first_pos > KLOG_SIZE)
+    first_pos += sizeof r + get_record (first_pos).len;
+
+  if (extend)
+    {
+      r.len += len;
+      copy_in (last_pos, &r, sizeof r);
+    }
+  else
+    {
+      r.len = len;
+      r.level = level;
+      r.starts_line = !line_open;
+      r.seq = next_seq++;
+      r.ticks = timer_ticks ();
+      last_pos = write_pos;
+      copy_in (write_pos, &r, sizeof r);
+      write_pos += sizeof r;
+      record_cnt++;
+    }
+  copy_in (write_pos, buffer, len);
+  write_pos += len;
+  line_open = buffer[len - 1] != '\n';
+
+  if (!async)
+    drain_in_place (KLOG_SIZE);
+  else if (!drain_pending)
+    {
+      drain_pending = true;
+      sema_up (&drain_sema);
+    }
+  intr_set_level (old_level);
+}
+
+/* Returns the header of the record at POS. */
+static struct record
+get_record (uint32_t pos)
+{
+  struct record r;
+
+  copy_out (pos, &r, sizeof r);
+  return r;
+}
+
+/* Copies the SIZE bytes at BUFFER into the ring at POS. */
+static void
+copy_in (uint32_t pos, const void *buffer, size_t size)
+{
+  size_t ofs = pos % KLOG_SIZE;
+  size_t n = size < KLOG_SIZE - ofs ? size : KLOG_SIZE - ofs;
+
+  memcpy (ring + ofs, buffer, n);
+  memcpy (ring, (const uint8_t *) buffer + n, size - n);
+}
+
+/* Copies SIZE bytes from the ring at POS into BUFFER. */
+static void
+copy_out (uint32_t pos, void *buffer, size_t size)
+{
+  size_t ofs = pos % KLOG_SIZE;
+  size_t n = size < KLOG_SIZE - ofs ? size : KLOG_SIZE - ofs;
+
+  memcpy (buffer, ring + ofs, n);
+  memcpy ((uint8_t *) buffer + n, ring, size - n);
+}
+
+/* Returns true if SIZE more bytes fit in the ring without
+   overwriting anything still to be written out. */
+static bool
+has_room (size_t size)
+{
+  return write_pos + size - drain_pos <= KLOG_SIZE;
+}
+
+/* Takes up to SIZE bytes of the text waiting for the console into
+   BUFFER, skipping records above klog_console_level, and moves
+   the drain position past them.  Returns the bytes taken. */
+static size_t
+take_chunk (char *buffer, size_t size)
+{
+  size_t n = 0;
+
+  while (n < size && drain_pos != write_pos)
+    {
+      struct record r = get_record (drain_pos);
+
+      if (r.level > klog_console_level)
+        drain_ofs = r.len;
+      else
+        {
+          size_t take = r.len - drain_ofs;
+
+          if (take > size - n)
+            take = size - n;
+          copy_out (drain_pos + sizeof r + drain_ofs, buffer + n, take);
+          drain_ofs += take;
+          n += take;
+        }
+      if (drain_ofs < r.len)
+        break;
+      drain_pos += sizeof r + r.len;
+      drain_ofs = 0;
+    }
+  return n;
+}
+
+/* Writes one chunk of the text waiting for the console out to
+   it.  Returns false if there was none.  Must be called from a
+   thread that can sleep. */
+static bool
+drain_chunk (void)
+{
+  enum intr_level old_level;
+  size_t n;
+
+  lock_acquire (&drain_lock);
+  old_level = intr_disable ();
+  n = take_chunk (chunk, sizeof chunk);
+  intr_set_level (old_level);
+  if (n > 0)
+    emit (chunk, n);
+  lock_release (&drain_lock);
+  return n > 0;
+}
+
+/* Writes text waiting for the console out to it with interrupts
+   off, until there is room for SIZE more bytes in the ring.  With
+   SIZE of KLOG_SIZE, that is until none is left. */
+static void
+drain_in_place (size_t size)
+{
+  char buffer[64];
+  size_t n;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  while (!has_room (size) && (n = take_chunk (buffer, sizeof buffer)) > 0)
+    emit (buffer, n);
+}
+
+/* Writes the N bytes in BUFFER to the console devices. */
+static void
+emit (const char *buffer, size_t n)
+{
+  if (debugcon_active ())
+    debugcon_putbuf (buffer, n);
+  else
+    serial_putbuf (buffer, n);
+  vga_putbuf (buffer, n);
+}
+
+/* Writes the log out to the console whenever there is something
+   new in it.  Runs at the lowest priority, or as nice as can be
+   under the MLFQS, so that it does not get in anyone's way. */
+static void
+drain_thread (void *aux UNUSED)
+{
+  thread_set_nice (20);
+  for (;;)
+    {
+      enum intr_level old_level;
+
+      sema_down (&drain_sema);
+      old_level = intr_disable ();
+      drain_pending = false;
+      intr_set_level (old_level);
+
+      while (drain_chunk ())
+        continue;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef __LIB_KERNEL_KLOG_H
+#define __LIB_KERNEL_KLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Kernel log levels, most severe first, as in syslog. */
+#define KLOG_EMERG 0            /* The system is unusable. */
+#define KLOG_ALERT 1            /* Action must be taken at once. */
+#define KLOG_CRIT 2             /* Critical conditions. */
+#define KLOG_ERR 3              /* Errors. */
+#define KLOG_WARNING 4          /* Warnings. */
+#define KLOG_NOTICE 5           /* Normal but significant. */
+#define KLOG_INFO 6             /* Informational; the default. */
+#define KLOG_DEBUG 7            /* Debugging. */
+
+/* Prefixes for a printf() format string that log the message at
+   another level than KLOG_INFO, as in
+   printf (KERN_DEBUG "evicted sector %"PRDSNu"\n", sector). */
+#define KERN_SOH "\001"
+#define KERN_EMERG KERN_SOH "0"
+#define KERN_ALERT KERN_SOH "1"
+#define KERN_CRIT KERN_SOH "2"
+#define KERN_ERR KERN_SOH "3"
+#define KERN_WARNING KERN_SOH "4"
+#define KERN_NOTICE KERN_SOH "5"
+#define KERN_INFO KERN_SOH "6"
+#define KERN_DEBUG KERN_SOH "7"
+
+/* Most bytes of text in one record. */
+#define KLOG_RECORD_MAX 1024
+
+/* -loglevel: Messages above this level are only logged, not
+   written to the console. */
+extern int klog_console_level;
+
+void klog_write (int level, const char *, size_t);
+void klog_start (void);
+void klog_flush (void);
+void klog_panic (void);
+size_t klog_read (uint32_t *seq, char *buffer, size_t size);
+
+#endif /* lib/kernel/klog.h */
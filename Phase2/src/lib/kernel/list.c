@@ -71,7 +71,7 @@ list_init (struct list *list)
 struct list_elem *
 list_begin (struct list *list)
 {
-  ASSERT (list != NULL);
+  DEBUG_ASSERT (list != NULL);
   return list->head.next;
 }
 
@@ -81,7 +81,7 @@ list_begin (struct list *list)
 struct list_elem *
 list_next (struct list_elem *elem)
 {
-  ASSERT (is_head (elem) || is_interior (elem));
+  DEBUG_ASSERT (is_head (elem) || is_interior (elem));
   return elem->next;
 }
 
@@ -93,7 +93,7 @@ list_next (struct list_elem *elem)
 struct list_elem *
 list_end (struct list *list)
 {
-  ASSERT (list != NULL);
+  DEBUG_ASSERT (list != NULL);
   return &list->tail;
 }
 
@@ -102,7 +102,7 @@ list_end (struct list *list)
 struct list_elem *
 list_rbegin (struct list *list) 
 {
-  ASSERT (list != NULL);
+  DEBUG_ASSERT (list != NULL);
   return list->tail.prev;
 }
 
@@ -112,7 +112,7 @@ list_rbegin (struct list *list)
 struct list_elem *
 list_prev (struct list_elem *elem)
 {
-  ASSERT (is_interior (elem) || is_tail (elem));
+  DEBUG_ASSERT (is_interior (elem) || is_tail (elem));
   return elem->prev;
 }
 
@@ -132,7 +132,7 @@ list_prev (struct list_elem *elem)
 struct list_elem *
 list_rend (struct list *list) 
 {
-  ASSERT (list != NULL);
+  DEBUG_ASSERT (list != NULL);
   return &list->head;
 }
 
@@ -150,7 +150,7 @@ list_rend (struct list *list)
 struct list_elem *
 list_head (struct list *list) 
 {
-  ASSERT (list != NULL);
+  DEBUG_ASSERT (list != NULL);
   return &list->head;
 }
 
@@ -158,7 +158,7 @@ list_head (struct list *list)
 struct list_elem *
 list_tail (struct list *list) 
 {
-  ASSERT (list != NULL);
+  DEBUG_ASSERT (list != NULL);
   return &list->tail;
 }
 
@@ -385,8 +385,8 @@ inplace_merge (struct list_elem *a0, struct list_elem *a1b0,
   ASSERT (a1b0 != NULL);
   ASSERT (b1 != NULL);
   ASSERT (less != NULL);
-  ASSERT (is_sorted (a0, a1b0, less, aux));
-  ASSERT (is_sorted (a1b0, b1, less, aux));
+  DEBUG_ASSERT (is_sorted (a0, a1b0, less, aux));
+  DEBUG_ASSERT (is_sorted (a1b0, b1, less, aux));
 
   while (a0 != a1b0 && a1b0 != b1)
     if (!less (a1b0, a0, aux)) 
@@ -436,7 +436,7 @@ list_sort (struct list *list, list_less_func *less, void *aux)
     }
   while (output_run_cnt > 1);
 
-  ASSERT (is_sorted (list_begin (list), list_end (list), less, aux));
+  DEBUG_ASSERT (is_sorted (list_begin (list), list_end (list), less, aux));
 }
 
 /* Inserts ELEM in the proper position in LIST, which must be
@@ -178,4 +178,122 @@ void list_unique (struct list *, struct list *duplicates,
 struct list_elem *list_max (struct list *, list_less_func *, void *aux);
 struct list_elem *list_min (struct list *, list_less_func *, void *aux);
 
+/* Typed ordered operations.
+
+   LIST_DEFINE_ORDERED (NAME, TYPE, MEMBER, KEY) defines static
+   inline functions
+
+      void NAME_insert_ordered (struct list *, struct list_elem *);
+      void NAME_sort (struct list *);
+      struct list_elem *NAME_max (struct list *);
+      struct list_elem *NAME_min (struct list *);
+
+   that behave like list_insert_ordered(), list_sort(),
+   list_max(), and list_min() on a list of TYPE linked through
+   its MEMBER list_elem and ordered by ascending value of its KEY
+   member, which may be of any type that `<' compares.  The
+   comparison is compiled inline, instead of being called
+   through a list_less_func pointer once per element.
+   LIST_DEFINE_ORDERED_DESC defines the same functions for
+   descending order of KEY.  For example:
+
+      LIST_DEFINE_ORDERED_DESC (by_priority, struct thread, elem,
+                                priority)
+
+      by_priority_insert_ordered (&ready_list, &t->elem); */
+#define LIST_DEFINE_ORDERED(NAME, TYPE, MEMBER, KEY)                    \
+        LIST_DEFINE_ORDERED_BY_ (NAME, TYPE, MEMBER, KEY, <)
+#define LIST_DEFINE_ORDERED_DESC(NAME, TYPE, MEMBER, KEY)               \
+        LIST_DEFINE_ORDERED_BY_ (NAME, TYPE, MEMBER, KEY, >)
+
+/* Does the work of LIST_DEFINE_ORDERED and
+   LIST_DEFINE_ORDERED_DESC, with element A "less" than element B
+   if A's KEY OP B's KEY.  NAME_sort() is the natural merge sort
+   of list_sort(). */
+#define LIST_DEFINE_ORDERED_BY_(NAME, TYPE, MEMBER, KEY, OP)            \
+static inline bool                                                      \
+NAME##_less (const struct list_elem *a, const struct list_elem *b)      \
+{                                                                       \
+  return (list_entry (a, TYPE, MEMBER)->KEY                             \
+          OP list_entry (b, TYPE, MEMBER)->KEY);                        \
+}                                                                       \
+                                                                        \
+static inline void                                                      \
+NAME##_insert_ordered (struct list *list, struct list_elem *elem)       \
+{                                                                       \
+  struct list_elem *e;                                                  \
+                                                                        \
+  for (e = list_begin (list); e != list_end (list); e = list_next (e))  \
+    if (NAME##_less (elem, e))                                          \
+      break;                                                            \
+  list_insert (e, elem);                                                \
+}                                                                       \
+                                                                        \
+static inline struct list_elem *                                        \
+NAME##_end_of_run (struct list_elem *a, struct list_elem *b)            \
+{                                                                       \
+  do                                                                    \
+    a = list_next (a);                                                  \
+  while (a != b && !NAME##_less (a, list_prev (a)));                    \
+  return a;                                                             \
+}                                                                       \
+                                                                        \
+static inline void                                                      \
+NAME##_sort (struct list *list)                                         \
+{                                                                       \
+  size_t output_run_cnt;                                                \
+                                                                        \
+  do                                                                    \
+    {                                                                   \
+      struct list_elem *a0, *a1b0, *b1;                                 \
+                                                                        \
+      output_run_cnt = 0;                                               \
+      for (a0 = list_begin (list); a0 != list_end (list); a0 = b1)      \
+        {                                                               \
+          output_run_cnt++;                                             \
+          a1b0 = NAME##_end_of_run (a0, list_end (list));               \
+          if (a1b0 == list_end (list))                                  \
+            break;                                                      \
+          b1 = NAME##_end_of_run (a1b0, list_end (list));               \
+                                                                        \
+          /* Merge A0...A1B0 with A1B0...B1. */                         \
+          while (a0 != a1b0 && a1b0 != b1)                              \
+            if (!NAME##_less (a1b0, a0))                                \
+              a0 = list_next (a0);                                      \
+            else                                                        \
+              {                                                         \
+                a1b0 = list_next (a1b0);                                \
+                list_splice (a0, list_prev (a1b0), a1b0);               \
+              }                                                         \
+        }                                                               \
+    }                                                                   \
+  while (output_run_cnt > 1);                                           \
+}                                                                       \
+                                                                        \
+static inline struct list_elem *                                        \
+NAME##_max (struct list *list)                                          \
+{                                                                       \
+  struct list_elem *max = list_begin (list);                            \
+  struct list_elem *e;                                                  \
+                                                                        \
+  if (max != list_end (list))                                           \
+    for (e = list_next (max); e != list_end (list); e = list_next (e))  \
+      if (NAME##_less (max, e))                                         \
+        max = e;                                                        \
+  return max;                                                           \
+}                                                                       \
+                                                                        \
+static inline struct list_elem *                                        \
+NAME##_min (struct list *list)                                          \
+{                                                                       \
+  struct list_elem *min = list_begin (list);                            \
+  struct list_elem *e;                                                  \
+                                                                        \
+  if (min != list_end (list))                                           \
+    for (e = list_next (min); e != list_end (list); e = list_next (e))  \
+      if (NAME##_less (e, min))                                         \
+        min = e;                                                        \
+  return min;                                                           \
+}
+
 #endif /* lib/kernel/list.h */
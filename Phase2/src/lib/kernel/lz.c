@@ -0,0 +1,193 @@
+#include "lz.h"
+#include <stdbool.h>
+#include <string.h>
+#include "../debug.h"
+
+/* See lz.h for basic information. */
+
+/* Largest value of a 4-bit token field before extra bytes. */
+#define FIELD_MAX 15
+
+/* Reads 4 bytes at P, which need not be aligned. */
+static inline uint32_t
+read32 (const uint8_t *p) 
+{
+  uint32_t x;
+  memcpy (&x, p, sizeof x);
+  return x;
+}
+
+/* Returns the hash table index for the 4 bytes X. */
+static inline unsigned
+hash (uint32_t x) 
+{
+  return (x * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Appends the extra bytes for a token field whose value is
+   VALUE, FIELD_MAX or more, at *OP, which has room up to END.
+   Returns false if it does not. */
+static bool
+put_length (uint8_t **op, const uint8_t *end, size_t value) 
+{
+  for (value -= FIELD_MAX; ; value -= 255)
+    {
+      if (*op >= end)
+        return false;
+      if (value < 255)
+        {
+          *(*op)++ = value;
+          return true;
+        }
+      *(*op)++ = 255;
+    }
+}
+
+/* Appends a record of the LIT_LEN literals at LIT followed, if
+   MATCH_LEN is nonzero, by a match of MATCH_LEN bytes OFFSET
+   bytes back, at *OP, which has room up to END.  Returns false
+   if it does not. */
+static bool
+put_record (uint8_t **op, const uint8_t *end, const uint8_t *lit,
+            size_t lit_len, size_t offset, size_t match_len) 
+{
+  size_t match_field = match_len != 0 ? match_len - LZ_MIN_MATCH : 0;
+  uint8_t *token = *op;
+
+  if (*op >= end)
+    return false;
+  *token = ((lit_len < FIELD_MAX ? lit_len : FIELD_MAX) << 4
+            | (match_field < FIELD_MAX ? match_field : FIELD_MAX));
+  (*op)++;
+
+  if (lit_len >= FIELD_MAX && !put_length (op, end, lit_len))
+    return false;
+  if ((size_t) (end - *op) < lit_len)
+    return false;
+  memcpy (*op, lit, lit_len);
+  *op += lit_len;
+
+  if (match_len == 0)
+    return true;
+  if (end - *op < 2)
+    return false;
+  *(*op)++ = offset;
+  *(*op)++ = offset >> 8;
+  return match_field < FIELD_MAX || put_length (op, end, match_field);
+}
+
+/* Compresses the SRC_LEN bytes at SRC, at most LZ_MAX_SRC, into
+   DST, using TABLE as scratch space.  Returns the compressed
+   length, or 0 if it would be more than DST_MAX bytes. */
+size_t
+lz_compress (const void *src_, size_t src_len, void *dst_, size_t dst_max,
+             uint16_t table[LZ_HASH_CNT]) 
+{
+  const uint8_t *src = src_;
+  const uint8_t *ip = src;
+  const uint8_t *anchor = src;
+  const uint8_t *end = src + src_len;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+
+  ASSERT (src_len <= LZ_MAX_SRC);
+
+  while (end - ip >= LZ_MIN_MATCH)
+    {
+      uint32_t word = read32 (ip);
+      unsigned h = hash (word);
+      const uint8_t *ref = src + table[h];
+      size_t len;
+
+      /* Entries left over from earlier calls point somewhere
+         into SRC too, so comparing the bytes is enough. */
+      table[h] = ip - src;
+      if (ref >= ip || read32 (ref) != word)
+        {
+          ip++;
+          continue;
+        }
+
+      len = LZ_MIN_MATCH;
+      while (ip + len < end && ref[len] == ip[len])
+        len++;
+      if (!put_record (&op, dst + dst_max, anchor, ip - anchor,
+                       ip - ref, len))
+        return 0;
+      ip += len;
+      anchor = ip;
+    }
+
+  if (!put_record (&op, dst + dst_max, anchor, end - anchor, 0, 0))
+    return 0;
+  return op - dst;
+}
+
+/* Reads the extra bytes of a token field from *IP, which has
+   data up to END, adding them to *VALUE.  Returns false if the
+   data runs out first. */
+static bool
+get_length (const uint8_t **ip, const uint8_t *end, size_t *value) 
+{
+  uint8_t b;
+
+  do
+    {
+      if (*ip >= end)
+        return false;
+      b = *(*ip)++;
+      *value += b;
+    }
+  while (b == 255);
+  return true;
+}
+
+/* Decompresses the SRC_LEN bytes at SRC, which lz_compress()
+   produced, into DST.  Returns the decompressed length, or 0 if
+   SRC is corrupt or would decompress to more than DST_MAX
+   bytes. */
+size_t
+lz_decompress (const void *src, size_t src_len, void *dst_, size_t dst_max) 
+{
+  const uint8_t *ip = src;
+  const uint8_t *end = ip + src_len;
+  uint8_t *dst = dst_;
+  uint8_t *op = dst;
+  uint8_t *op_end = dst + dst_max;
+
+  while (ip < end)
+    {
+      uint8_t token = *ip++;
+      size_t lit_len = token >> 4;
+      size_t match_len = token & FIELD_MAX;
+      size_t offset;
+      const uint8_t *ref;
+
+      if (lit_len == FIELD_MAX && !get_length (&ip, end, &lit_len))
+        return 0;
+      if ((size_t) (end - ip) < lit_len || (size_t) (op_end - op) < lit_len)
+        return 0;
+      memcpy (op, ip, lit_len);
+      op += lit_len;
+      ip += lit_len;
+      if (ip == end)
+        break;
+
+      if (end - ip < 2)
+        return 0;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (match_len == FIELD_MAX && !get_length (&ip, end, &match_len))
+        return 0;
+      match_len += LZ_MIN_MATCH;
+      if (offset == 0 || offset > (size_t) (op - dst)
+          || (size_t) (op_end - op) < match_len)
+        return 0;
+
+      /* The match may overlap the bytes being written, as a run
+         does, so copy a byte at a time. */
+      for (ref = op - offset; match_len > 0; match_len--)
+        *op++ = *ref++;
+    }
+  return op - dst;
+}
@@ -0,0 +1,41 @@
+#ifndef __LIB_KERNEL_LZ_H
+#define __LIB_KERNEL_LZ_H
+
+/* LZ compression.
+
+   A byte-oriented LZ77 codec in the style of LZ4, for buffers of
+   up to 64 kB such as pages: fast to compress, faster still to
+   decompress, and good at the long runs of zeros and repeated
+   words that pages of memory are full of.
+
+   Compressed data is a sequence of records.  Each starts with a
+   token byte whose high 4 bits give the number of literal bytes
+   that follow and whose low 4 bits give the length of a match,
+   less LZ_MIN_MATCH, that comes after them.  A field of 15 is
+   continued by extra bytes after the token (for the literal
+   count) or after the offset (for the match length), each added
+   in, up to the first that is less than 255.  After the literals
+   comes the 2-byte little-endian distance back to the match,
+   except in the last record, which has literals only.
+
+   The compressor finds matches through a hash table of recent
+   positions that the caller provides, so that it needs no
+   memory of its own; the table need not be initialized.  The
+   decompressor checks every length and distance against its
+   buffers, so corrupt input cannot make it overrun them. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define LZ_MIN_MATCH 4          /* Shortest match encoded. */
+#define LZ_HASH_BITS 12         /* Bits of hash table index. */
+#define LZ_HASH_CNT (1 << LZ_HASH_BITS) /* Hash table entries. */
+#define LZ_MAX_SRC 65536        /* Longest input. */
+
+size_t lz_compress (const void *src, size_t src_len,
+                    void *dst, size_t dst_max,
+                    uint16_t table[LZ_HASH_CNT]);
+size_t lz_decompress (const void *src, size_t src_len,
+                      void *dst, size_t dst_max);
+
+#endif /* lib/kernel/lz.h */
@@ -0,0 +1,58 @@
+#ifndef __LIB_KERNEL_RADIX_H
+#define __LIB_KERNEL_RADIX_H
+
+/* Radix tree.
+
+   A sparse map from 32-bit integer keys, such as sector numbers
+   or page numbers, to non-null pointers.  Each node is an array
+   of RADIX_FANOUT slots indexed by RADIX_BITS bits of the key,
+   so a lookup is a handful of array indexing steps with no
+   comparisons and no chains to walk, and keys that are close
+   together share nodes.  The tree is only as tall as its
+   largest key requires: keys below 64 need a single node.
+
+   radix_gang_lookup() returns the items at a run of ascending
+   keys in one call, for read-ahead and batched write-back.
+
+   Synchronization: callers must serialize radix_insert(),
+   radix_delete() and radix_destroy() themselves, but
+   radix_lookup() and radix_gang_lookup() may run at the same
+   time as one writer without taking any lock.  A writer
+   initializes every node completely before linking it into the
+   tree, and each node records its own height, so a reader sees
+   either the old or the new tree, never a half-built one.
+   Nodes are not freed until radix_destroy(), so a reader never
+   follows a pointer to freed memory; an item removed by
+   radix_delete() may still be returned to a reader that raced
+   with the removal, so the caller must not free it until such
+   readers are done. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Key bits consumed by each level, and slots per node. */
+#define RADIX_BITS 6
+#define RADIX_FANOUT (1 << RADIX_BITS)
+
+struct radix_node;
+
+/* Radix tree. */
+struct radix_tree 
+  {
+    struct radix_node *root;    /* Root node, or null if never used. */
+    size_t item_cnt;            /* Number of items. */
+  };
+
+void radix_init (struct radix_tree *);
+void radix_destroy (struct radix_tree *);
+
+bool radix_insert (struct radix_tree *, uint32_t key, void *item);
+void *radix_delete (struct radix_tree *, uint32_t key);
+void *radix_lookup (const struct radix_tree *, uint32_t key);
+size_t radix_gang_lookup (const struct radix_tree *, uint32_t first_key,
+                          void **items, uint32_t *keys, size_t max_cnt);
+
+size_t radix_size (const struct radix_tree *);
+
+#endif /* lib/kernel/radix.h */
@@ -0,0 +1,477 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* See rbtree.h for basic information.
+
+   The tree obeys the usual red-black rules, treating null child
+   pointers as black leaves:
+
+     1. The root is black.
+
+     2. A red node has no red child.
+
+     3. Every path from a node down to a leaf passes through the
+        same number of black nodes.
+
+   Together these keep the longest path from the root no more
+   than twice as long as the shortest, so the height is
+   O(log n).  The insertion and removal fix-ups follow the
+   presentation in Cormen, Leiserson, Rivest, and Stein,
+   _Introduction to Algorithms_, adapted to null leaves. */
+
+static void rotate_left (struct rb_tree *, struct rb_node *);
+static void rotate_right (struct rb_tree *, struct rb_node *);
+static void transplant (struct rb_tree *, struct rb_node *old,
+                        struct rb_node *new);
+static void insert_fixup (struct rb_tree *, struct rb_node *);
+static void remove_fixup (struct rb_tree *, struct rb_node *,
+                          struct rb_node *parent);
+
+/* Returns true if node N is red, false if it is black or a null
+   leaf. */
+static inline bool
+is_red (const struct rb_node *n) 
+{
+  return n != NULL && n->red;
+}
+
+/* Initializes TREE as an empty tree ordered by LESS, given
+   auxiliary data AUX. */
+void
+rb_init (struct rb_tree *tree, rb_less_func *less, void *aux) 
+{
+  ASSERT (tree != NULL);
+  ASSERT (less != NULL);
+
+  tree->root = NULL;
+  tree->min = NULL;
+  tree->max = NULL;
+  tree->size = 0;
+  tree->less = less;
+  tree->aux = aux;
+}
+
+/* Inserts NODE into TREE, after any nodes already in TREE that
+   compare equal to it. */
+void
+rb_insert (struct rb_tree *tree, struct rb_node *node) 
+{
+  struct rb_node *parent = NULL;
+  struct rb_node **link = &tree->root;
+  bool leftmost = true, rightmost = true;
+
+  ASSERT (tree != NULL);
+  ASSERT (node != NULL);
+
+  while (*link != NULL)
+    {
+      parent = *link;
+      if (tree->less (node, parent, tree->aux))
+        {
+          link = &parent->left;
+          rightmost = false;
+        }
+      else
+        {
+          link = &parent->right;
+          leftmost = false;
+        }
+    }
+
+  node->parent = parent;
+  node->left = node->right = NULL;
+  node->red = true;
+  *link = node;
+  if (leftmost)
+    tree->min = node;
+  if (rightmost)
+    tree->max = node;
+  tree->size++;
+
+  insert_fixup (tree, node);
+}
+
+/* Removes NODE, which must be in TREE, from TREE. */
+void
+rb_remove (struct rb_tree *tree, struct rb_node *node) 
+{
+  struct rb_node *child, *child_parent;
+  bool removed_red;
+
+  ASSERT (tree != NULL);
+  ASSERT (node != NULL);
+  ASSERT (tree->size > 0);
+
+  if (tree->min == node)
+    tree->min = rb_next (node);
+  if (tree->max == node)
+    tree->max = rb_prev (node);
+
+  if (node->left == NULL || node->right == NULL)
+    {
+      /* NODE has at most one child, which takes its place. */
+      child = node->left != NULL ? node->left : node->right;
+      child_parent = node->parent;
+      removed_red = node->red;
+      transplant (tree, node, child);
+    }
+  else
+    {
+      /* NODE's successor, which has no left child, takes its
+         place, and the successor's right child takes the
+         successor's. */
+      struct rb_node *next = node->right;
+      while (next->left != NULL)
+        next = next->left;
+
+      removed_red = next->red;
+      child = next->right;
+      if (next->parent == node)
+        child_parent = next;
+      else
+        {
+          child_parent = next->parent;
+          transplant (tree, next, child);
+          next->right = node->right;
+          next->right->parent = next;
+        }
+      transplant (tree, node, next);
+      next->left = node->left;
+      next->left->parent = next;
+      next->red = node->red;
+    }
+  tree->size--;
+
+  /* Taking a black node out of a path breaks rule 3. */
+  if (!removed_red)
+    remove_fixup (tree, child, child_parent);
+}
+
+/* Removes and returns the first node in TREE, or returns a null
+   pointer if TREE is empty. */
+struct rb_node *
+rb_pop_min (struct rb_tree *tree) 
+{
+  struct rb_node *node = tree->min;
+  if (node != NULL)
+    rb_remove (tree, node);
+  return node;
+}
+
+/* Removes and returns the last node in TREE, or returns a null
+   pointer if TREE is empty. */
+struct rb_node *
+rb_pop_max (struct rb_tree *tree) 
+{
+  struct rb_node *node = tree->max;
+  if (node != NULL)
+    rb_remove (tree, node);
+  return node;
+}
+
+/* Returns the first node in TREE, or a null pointer if TREE is
+   empty. */
+struct rb_node *
+rb_min (const struct rb_tree *tree) 
+{
+  ASSERT (tree != NULL);
+  return tree->min;
+}
+
+/* Returns the last node in TREE, or a null pointer if TREE is
+   empty. */
+struct rb_node *
+rb_max (const struct rb_tree *tree) 
+{
+  ASSERT (tree != NULL);
+  return tree->max;
+}
+
+/* Returns the node after NODE in its tree, or a null pointer if
+   NODE is the last node. */
+struct rb_node *
+rb_next (const struct rb_node *node) 
+{
+  ASSERT (node != NULL);
+
+  if (node->right != NULL)
+    {
+      node = node->right;
+      while (node->left != NULL)
+        node = node->left;
+      return (struct rb_node *) node;
+    }
+  while (node->parent != NULL && node == node->parent->right)
+    node = node->parent;
+  return node->parent;
+}
+
+/* Returns the node before NODE in its tree, or a null pointer if
+   NODE is the first node. */
+struct rb_node *
+rb_prev (const struct rb_node *node) 
+{
+  ASSERT (node != NULL);
+
+  if (node->left != NULL)
+    {
+      node = node->left;
+      while (node->right != NULL)
+        node = node->right;
+      return (struct rb_node *) node;
+    }
+  while (node->parent != NULL && node == node->parent->left)
+    node = node->parent;
+  return node->parent;
+}
+
+/* Returns the first node in TREE equal to KEY, or a null pointer
+   if there is none.  KEY need not be in TREE. */
+struct rb_node *
+rb_find (const struct rb_tree *tree, const struct rb_node *key) 
+{
+  struct rb_node *node = rb_lower_bound (tree, key);
+  if (node != NULL && !tree->less (key, node, tree->aux))
+    return node;
+  return NULL;
+}
+
+/* Returns the first node in TREE that is not less than KEY, or a
+   null pointer if there is none.  KEY need not be in TREE. */
+struct rb_node *
+rb_lower_bound (const struct rb_tree *tree, const struct rb_node *key) 
+{
+  struct rb_node *node = tree->root;
+  struct rb_node *bound = NULL;
+
+  while (node != NULL)
+    if (tree->less (node, key, tree->aux))
+      node = node->right;
+    else
+      {
+        bound = node;
+        node = node->left;
+      }
+  return bound;
+}
+
+/* Returns the first node in TREE that is greater than KEY, or a
+   null pointer if there is none.  KEY need not be in TREE. */
+struct rb_node *
+rb_upper_bound (const struct rb_tree *tree, const struct rb_node *key) 
+{
+  struct rb_node *node = tree->root;
+  struct rb_node *bound = NULL;
+
+  while (node != NULL)
+    if (tree->less (key, node, tree->aux))
+      {
+        bound = node;
+        node = node->left;
+      }
+    else
+      node = node->right;
+  return bound;
+}
+
+/* Returns the number of nodes in TREE. */
+size_t
+rb_size (const struct rb_tree *tree) 
+{
+  return tree->size;
+}
+
+/* Returns true if TREE is empty, false otherwise. */
+bool
+rb_empty (const struct rb_tree *tree) 
+{
+  return tree->size == 0;
+}
+
+/* Makes NEW, which may be null, take OLD's place under OLD's
+   parent in TREE.  Leaves OLD's own links alone. */
+static void
+transplant (struct rb_tree *tree, struct rb_node *old, struct rb_node *new) 
+{
+  if (old->parent == NULL)
+    tree->root = new;
+  else if (old == old->parent->left)
+    old->parent->left = new;
+  else
+    old->parent->right = new;
+  if (new != NULL)
+    new->parent = old->parent;
+}
+
+/* Rotates the subtree rooted at NODE to the left, so that NODE's
+   right child takes its place and NODE becomes that child's left
+   child. */
+static void
+rotate_left (struct rb_tree *tree, struct rb_node *node) 
+{
+  struct rb_node *right = node->right;
+
+  node->right = right->left;
+  if (right->left != NULL)
+    right->left->parent = node;
+  transplant (tree, node, right);
+  right->left = node;
+  node->parent = right;
+}
+
+/* Rotates the subtree rooted at NODE to the right, so that
+   NODE's left child takes its place and NODE becomes that
+   child's right child. */
+static void
+rotate_right (struct rb_tree *tree, struct rb_node *node) 
+{
+  struct rb_node *left = node->left;
+
+  node->left = left->right;
+  if (left->right != NULL)
+    left->right->parent = node;
+  transplant (tree, node, left);
+  left->right = node;
+  node->parent = left;
+}
+
+/* Restores the red-black rules after red NODE was added to TREE,
+   which can only have broken rule 2 between NODE and its
+   parent, or rule 1 if NODE is the root. */
+static void
+insert_fixup (struct rb_tree *tree, struct rb_node *node) 
+{
+  struct rb_node *parent;
+
+  while ((parent = node->parent) != NULL && parent->red)
+    {
+      /* PARENT is red, so it is not the root. */
+      struct rb_node *grandparent = parent->parent;
+
+      if (parent == grandparent->left)
+        {
+          struct rb_node *uncle = grandparent->right;
+          if (is_red (uncle))
+            {
+              /* Push the grandparent's blackness down a level
+                 and continue from the grandparent. */
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              node = grandparent;
+              continue;
+            }
+          if (node == parent->right)
+            {
+              rotate_left (tree, parent);
+              node = parent;
+              parent = node->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_right (tree, grandparent);
+        }
+      else
+        {
+          struct rb_node *uncle = grandparent->left;
+          if (is_red (uncle))
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              node = grandparent;
+              continue;
+            }
+          if (node == parent->left)
+            {
+              rotate_right (tree, parent);
+              node = parent;
+              parent = node->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_left (tree, grandparent);
+        }
+    }
+  tree->root->red = false;
+}
+
+/* Restores rule 3 after a black node was removed from above
+   NODE, which may be null, under PARENT.  Paths through NODE
+   have one black node too few. */
+static void
+remove_fixup (struct rb_tree *tree, struct rb_node *node,
+              struct rb_node *parent) 
+{
+  while (node != tree->root && !is_red (node))
+    {
+      if (node == parent->left)
+        {
+          /* The sibling exists: its paths have at least one
+             black node more than NODE's. */
+          struct rb_node *sibling = parent->right;
+          if (sibling->red)
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_left (tree, parent);
+              sibling = parent->right;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              /* Take a black node off the sibling's paths too and
+                 move the shortage up to PARENT. */
+              sibling->red = true;
+              node = parent;
+              parent = node->parent;
+            }
+          else
+            {
+              if (!is_red (sibling->right))
+                {
+                  sibling->left->red = false;
+                  sibling->red = true;
+                  rotate_right (tree, sibling);
+                  sibling = parent->right;
+                }
+              sibling->red = parent->red;
+              parent->red = false;
+              sibling->right->red = false;
+              rotate_left (tree, parent);
+              node = tree->root;
+            }
+        }
+      else
+        {
+          struct rb_node *sibling = parent->left;
+          if (sibling->red)
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_right (tree, parent);
+              sibling = parent->left;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              node = parent;
+              parent = node->parent;
+            }
+          else
+            {
+              if (!is_red (sibling->left))
+                {
+                  sibling->right->red = false;
+                  sibling->red = true;
+                  rotate_left (tree, sibling);
+                  sibling = parent->left;
+                }
+              sibling->red = parent->red;
+              parent->red = false;
+              sibling->left->red = false;
+              rotate_right (tree, parent);
+              node = tree->root;
+            }
+        }
+    }
+  if (node != NULL)
+    node->red = false;
+}
@@ -0,0 +1,120 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+
+   A balanced binary search tree, for ordered collections that
+   need O(log n) insertion and removal where a sorted list would
+   take O(n).  The tree's first and last elements are cached, so
+   rb_min() and rb_max() take constant time.
+
+   Like the linked list in list.h, this implementation does not
+   use dynamically allocated memory.  Each structure that can be
+   in a tree embeds a struct rb_node member, and the rb_entry
+   macro converts a struct rb_node back to the structure that
+   contains it.  For example:
+
+      struct foo
+        {
+          struct rb_node node;
+          int bar;
+          ...other members...
+        };
+
+      static bool
+      foo_less (const struct rb_node *a_, const struct rb_node *b_,
+                void *aux UNUSED)
+      {
+        const struct foo *a = rb_entry (a_, struct foo, node);
+        const struct foo *b = rb_entry (b_, struct foo, node);
+        return a->bar < b->bar;
+      }
+
+      struct rb_tree foo_tree;
+
+      rb_init (&foo_tree, foo_less, NULL);
+
+   Elements are visited in ascending order like so:
+
+      struct rb_node *n;
+
+      for (n = rb_min (&foo_tree); n != NULL; n = rb_next (n))
+        {
+          struct foo *f = rb_entry (n, struct foo, node);
+          ...do something with f...
+        }
+
+   A tree may hold several elements that compare equal.  Each
+   new one goes after those already in the tree, in the same way
+   as list_insert_ordered().
+
+   Modifying a tree while iterating over it invalidates the
+   iteration, except that the current element may be removed
+   after its successor has been found with rb_next(). */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Red-black tree node. */
+struct rb_node 
+  {
+    struct rb_node *parent;     /* Parent, or null for the root. */
+    struct rb_node *left;       /* Left (lesser) child, or null. */
+    struct rb_node *right;      /* Right (greater) child, or null. */
+    bool red;                   /* Red or black? */
+  };
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_node *a,
+                           const struct rb_node *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rb_tree 
+  {
+    struct rb_node *root;       /* Root node, or null if empty. */
+    struct rb_node *min;        /* First node, or null if empty. */
+    struct rb_node *max;        /* Last node, or null if empty. */
+    size_t size;                /* Number of nodes. */
+    rb_less_func *less;         /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Converts pointer to tree node RB_NODE into a pointer to the
+   structure that RB_NODE is embedded inside.  Supply the name
+   of the outer structure STRUCT and the member name MEMBER of
+   the tree node.  See the big comment at the top of the file
+   for an example. */
+#define rb_entry(RB_NODE, STRUCT, MEMBER)                       \
+        ((STRUCT *) ((uint8_t *) &(RB_NODE)->parent             \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+
+/* Insertion and removal. */
+void rb_insert (struct rb_tree *, struct rb_node *);
+void rb_remove (struct rb_tree *, struct rb_node *);
+struct rb_node *rb_pop_min (struct rb_tree *);
+struct rb_node *rb_pop_max (struct rb_tree *);
+
+/* Ordered traversal. */
+struct rb_node *rb_min (const struct rb_tree *);
+struct rb_node *rb_max (const struct rb_tree *);
+struct rb_node *rb_next (const struct rb_node *);
+struct rb_node *rb_prev (const struct rb_node *);
+
+/* Search. */
+struct rb_node *rb_find (const struct rb_tree *, const struct rb_node *);
+struct rb_node *rb_lower_bound (const struct rb_tree *,
+                                const struct rb_node *);
+struct rb_node *rb_upper_bound (const struct rb_tree *,
+                                const struct rb_node *);
+
+/* Properties. */
+size_t rb_size (const struct rb_tree *);
+bool rb_empty (const struct rb_tree *);
+
+#endif /* lib/kernel/rbtree.h */
@@ -0,0 +1,215 @@
+#include <stats.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/percpu.h"
+
+/* Output format.
+
+   stats_emit() prints a "stats: begin" line, then one line per
+   registered counter, then a "stats: end" line.  Each counter
+   line is KEY=VALUE, where KEY is GROUP.INSTANCE.FIELD (or
+   GROUP.FIELD without an instance) with every character other
+   than letters, digits, "_" and "-" turned into "_", and VALUE
+   is a decimal integer.  A histogram becomes two lines:
+   KEY.bounds, the upper bound of each bucket ("inf" for the last),
+   and KEY.counts, the count in each bucket, both separated by
+   commas.  Lines appear in the order the counters were
+   registered; a consumer should look them up by key. */
+
+/* Most counters the registry holds.  Later ones are dropped. */
+#define STATS_MAX 512
+
+/* Kinds of counters. */
+enum stats_type
+  {
+    STATS_INT64,
+    STATS_UINT64,
+    STATS_UINT,
+    STATS_SIZE,
+    STATS_PERCPU,
+    STATS_HIST
+  };
+
+/* A registered counter. */
+struct stats_entry
+  {
+    const char *group;          /* First part of the key. */
+    const char *instance;       /* Second part, or null. */
+    const char *field;          /* Last part. */
+    enum stats_type type;       /* How to read VALUE. */
+    const void *value;          /* The counter, or histogram buckets. */
+    int bucket_cnt;             /* For STATS_HIST: number of buckets. */
+    int shift;                  /* For STATS_HIST: bucket 0 counts
+                                   values below 2**SHIFT, bucket 1 those
+                                   below 2**(SHIFT + 1), and so on. */
+  };
+
+bool stats_enabled;
+
+static struct stats_entry entries[STATS_MAX];
+static size_t entry_cnt;
+static size_t dropped_cnt;
+
+static void
+add (const char *group, const char *instance, const char *field,
+     enum stats_type type, const void *value, int bucket_cnt, int shift)
+{
+  enum intr_level old_level;
+
+  ASSERT (group != NULL && field != NULL && value != NULL);
+
+  old_level = intr_disable ();
+  if (entry_cnt < STATS_MAX)
+    {
+      struct stats_entry *e = &entries[entry_cnt++];
+      e->group = group;
+      e->instance = instance;
+      e->field = field;
+      e->type = type;
+      e->value = value;
+      e->bucket_cnt = bucket_cnt;
+      e->shift = shift;
+    }
+  else
+    dropped_cnt++;
+  intr_set_level (old_level);
+}
+
+/* Registers the signed 64-bit counter VALUE. */
+void
+stats_add_int64 (const char *group, const char *instance,
+                 const char *field, const int64_t *value)
+{
+  add (group, instance, field, STATS_INT64, value, 0, 0);
+}
+
+/* Registers the unsigned 64-bit counter VALUE. */
+void
+stats_add_uint64 (const char *group, const char *instance,
+                  const char *field, const uint64_t *value)
+{
+  add (group, instance, field, STATS_UINT64, value, 0, 0);
+}
+
+/* Registers the unsigned counter VALUE. */
+void
+stats_add_uint (const char *group, const char *instance,
+                const char *field, const unsigned *value)
+{
+  add (group, instance, field, STATS_UINT, value, 0, 0);
+}
+
+/* Registers the size_t counter VALUE. */
+void
+stats_add_size (const char *group, const char *instance,
+                const char *field, const size_t *value)
+{
+  add (group, instance, field, STATS_SIZE, value, 0, 0);
+}
+
+/* Registers the per-CPU counter VALUE, whose CPUs' slots are
+   summed each time it is printed. */
+void
+stats_add_percpu (const char *group, const char *instance,
+                  const char *field, const struct percpu_counter *value)
+{
+  add (group, instance, field, STATS_PERCPU, value, 0, 0);
+}
+
+/* Registers a histogram of BUCKET_CNT buckets CNT[], where
+   bucket 0 counts values below 2**SHIFT, each later bucket those
+   below twice the previous bound, and the last bucket everything
+   else. */
+void
+stats_add_hist (const char *group, const char *instance,
+                const char *field, const unsigned *cnt,
+                int bucket_cnt, int shift)
+{
+  ASSERT (bucket_cnt > 0 && shift + bucket_cnt - 1 <= 63);
+  add (group, instance, field, STATS_HIST, cnt, bucket_cnt, shift);
+}
+
+/* Prints S with characters not allowed in keys replaced. */
+static void
+print_key_part (const char *s)
+{
+  for (; *s != '\0'; s++)
+    {
+      char c = *s;
+      bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')
+                || (c >= '0' && c <= '9') || c == '_' || c == '-';
+      putchar (ok ? c : '_');
+    }
+}
+
+/* Prints E's key followed by SUFFIX and "=". */
+static void
+print_key (const struct stats_entry *e, const char *suffix)
+{
+  print_key_part (e->group);
+  putchar ('.');
+  if (e->instance != NULL)
+    {
+      print_key_part (e->instance);
+      putchar ('.');
+    }
+  print_key_part (e->field);
+  printf ("%s=", suffix);
+}
+
+/* Prints every registered counter in the format described at the
+   top of this file. */
+void
+stats_emit (void)
+{
+  size_t i;
+  int b;
+
+  printf ("stats: begin\n");
+  printf ("stats.registered=%zu\nstats.dropped=%zu\n",
+          entry_cnt, dropped_cnt);
+  for (i = 0; i < entry_cnt; i++)
+    {
+      const struct stats_entry *e = &entries[i];
+
+      if (e->type == STATS_HIST)
+        {
+          const unsigned *cnt = e->value;
+
+          print_key (e, ".bounds");
+          for (b = 0; b < e->bucket_cnt - 1; b++)
+            printf ("%"PRIu64",", (uint64_t) 1 << (e->shift + b));
+          printf ("inf\n");
+          print_key (e, ".counts");
+          for (b = 0; b < e->bucket_cnt; b++)
+            printf ("%u%s", cnt[b], b < e->bucket_cnt - 1 ? "," : "\n");
+          continue;
+        }
+
+      print_key (e, "");
+      switch (e->type)
+        {
+        case STATS_INT64:
+          printf ("%"PRId64"\n", *(const int64_t *) e->value);
+          break;
+        case STATS_UINT64:
+          printf ("%"PRIu64"\n", *(const uint64_t *) e->value);
+          break;
+        case STATS_UINT:
+          printf ("%u\n", *(const unsigned *) e->value);
+          break;
+        case STATS_SIZE:
+          printf ("%zu\n", *(const size_t *) e->value);
+          break;
+        case STATS_PERCPU:
+          printf ("%"PRId64"\n", percpu_sum (e->value));
+          break;
+        default:
+          NOT_REACHED ();
+        }
+    }
+  printf ("stats: end\n");
+}
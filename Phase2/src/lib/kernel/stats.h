@@ -0,0 +1,39 @@
+#ifndef __LIB_KERNEL_STATS_H
+#define __LIB_KERNEL_STATS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct percpu_counter;
+
+/* Registry of named counters and histograms.
+
+   A subsystem registers a pointer to each counter it keeps
+   under a key made of GROUP, an optional INSTANCE (such as a
+   block device or lock name), and FIELD.  The registry only reads
+   the counters, when stats_emit() prints all of them in one
+   stable, machine-readable block.  All strings must remain valid
+   as long as the kernel runs. */
+
+void stats_add_int64 (const char *group, const char *instance,
+                      const char *field, const int64_t *);
+void stats_add_uint64 (const char *group, const char *instance,
+                       const char *field, const uint64_t *);
+void stats_add_uint (const char *group, const char *instance,
+                     const char *field, const unsigned *);
+void stats_add_size (const char *group, const char *instance,
+                     const char *field, const size_t *);
+void stats_add_percpu (const char *group, const char *instance,
+                       const char *field, const struct percpu_counter *);
+void stats_add_hist (const char *group, const char *instance,
+                     const char *field, const unsigned *cnt,
+                     int bucket_cnt, int shift);
+
+/* If true, stats_emit() runs at power off.
+   Set by kernel command-line option "-stats". */
+extern bool stats_enabled;
+
+void stats_emit (void);
+
+#endif /* lib/kernel/stats.h */
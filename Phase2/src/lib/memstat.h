@@ -0,0 +1,20 @@
+#ifndef __LIB_MEMSTAT_H
+#define __LIB_MEMSTAT_H
+
+/* Kernel memory usage, as reported by memstat().  Page counts
+   are in 4 kB pages; "used" counts the pages handed out now and
+   "peak" the most handed out at once since boot. */
+struct memstat
+  {
+    unsigned kernel_pages;      /* Pages in the kernel pool. */
+    unsigned kernel_used;
+    unsigned kernel_peak;
+    unsigned user_pages;        /* Pages in the user pool. */
+    unsigned user_used;
+    unsigned user_peak;
+    unsigned malloc_arenas;     /* Kernel pool pages holding small blocks. */
+    unsigned malloc_live;       /* Bytes in small blocks in use. */
+    unsigned malloc_big_pages;  /* Kernel pool pages in big blocks. */
+  };
+
+#endif /* lib/memstat.h */
@@ -0,0 +1,25 @@
+#ifndef __LIB_POLL_H
+#define __LIB_POLL_H
+
+/* One file descriptor for poll() to watch.  EVENTS says what to
+   wait for; poll() sets REVENTS to what happened, which may also
+   include POLLHUP, POLLERR and POLLNVAL whether asked for or
+   not. */
+struct pollfd
+  {
+    int fd;                     /* File descriptor, ignored if < 0. */
+    short events;               /* Events of interest. */
+    short revents;              /* Events that happened. */
+  };
+
+/* Events. */
+#define POLLIN 0x01             /* Reading would not wait. */
+#define POLLOUT 0x04            /* Writing a page would not wait. */
+#define POLLERR 0x08            /* Writing would fail: no reader. */
+#define POLLHUP 0x10            /* No writer: reads hit end of file. */
+#define POLLNVAL 0x20           /* FD is not open. */
+
+/* Most file descriptors a single poll() takes. */
+#define POLL_MAX 64
+
+#endif /* lib/poll.h */
@@ -0,0 +1,16 @@
+#ifndef __LIB_RLIMIT_H
+#define __LIB_RLIMIT_H
+
+/* Per-process resource limits, for getrlimit() and setrlimit().
+   A process starts with its parent's limits and may lower them,
+   but never raise them again. */
+#define RLIMIT_FRAMES 0         /* User frames its pages may hold. */
+#define RLIMIT_NOFILE 1         /* One more than the highest fd. */
+#define RLIMIT_NPROC 2          /* Children running at once. */
+#define RLIMIT_CPU 3            /* Timer ticks it may run for. */
+#define RLIMIT_CNT 4            /* Number of limits. */
+
+/* No limit. */
+#define RLIM_INFINITY 0xffffffffu
+
+#endif /* lib/rlimit.h */
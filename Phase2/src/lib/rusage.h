@@ -0,0 +1,37 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+/* Kinds of page fault, by how the kernel resolved them. */
+enum fault_type
+  {
+    FAULT_MINOR,                /* Brought in without waiting. */
+    FAULT_MAJOR,                /* Had to wait, usually for a read. */
+    FAULT_COW,                  /* Copied a page shared since fork. */
+    FAULT_STACK,                /* Grew the stack. */
+    FAULT_INVALID,              /* No page there: the access failed. */
+    FAULT_CNT
+  };
+
+/* Resource usage of one thread, as reported by getrusage().
+   Times are in timer ticks. */
+struct rusage
+  {
+    int tid;                    /* Thread identifier. */
+    char name[16];              /* Thread name. */
+    unsigned user_ticks;        /* Ticks spent running in user mode. */
+    unsigned kernel_ticks;      /* Ticks spent running in the kernel. */
+    unsigned voluntary_switches;   /* Gave up the CPU by blocking. */
+    unsigned involuntary_switches; /* Switched out while runnable. */
+    unsigned lock_wait_ticks;   /* Ticks spent waiting to acquire locks. */
+    unsigned page_faults;       /* Page faults taken. */
+    unsigned faults[FAULT_CNT]; /* Those by enum fault_type. */
+  };
+
+/* Values for getrusage()'s WHO argument. */
+#define RUSAGE_SELF 0           /* The calling thread. */
+#define RUSAGE_ALL 1            /* Every thread in the system. */
+
+/* Most entries a single getrusage() fills in. */
+#define RUSAGE_MAX 256
+
+#endif /* lib/rusage.h */
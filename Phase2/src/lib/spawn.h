@@ -0,0 +1,18 @@
+#ifndef __LIB_SPAWN_H
+#define __LIB_SPAWN_H
+
+/* One entry of the table of files spawn_fds() starts a process
+   with: the new process has the caller's fd FROM at its fd TO,
+   as if by dup2() before it started.  Entries are taken from the
+   caller's fds as they are at the call, not as earlier entries
+   would leave them, so two entries can swap fds. */
+struct spawn_fd
+  {
+    int to;                     /* Fd in the new process. */
+    int from;                   /* Fd in the caller. */
+  };
+
+/* Most entries spawn_fds() takes. */
+#define SPAWN_FDS_MAX 8
+
+#endif /* lib/spawn.h */
@@ -1,5 +1,74 @@
 #include <string.h>
 #include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Blocks shorter than this are moved a byte at a time, since
+   aligning for word moves would not pay off. */
+#define WORD_MIN 16
+
+bool (*memcpy_page_fn) (void *dst, const void *src);
+bool (*memzero_page_fn) (void *dst);
+
+/* Returns true if P is aligned on a STRING_PAGE_SIZE boundary. */
+static inline bool
+page_aligned (const void *p)
+{
+  return (uintptr_t) p % STRING_PAGE_SIZE == 0;
+}
+
+/* Copies SIZE bytes from SRC to DST, lowest address first, with
+   the string instructions.  Whole words are moved when DST and
+   SRC are equally aligned. */
+static void
+copy_forward (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  if (size >= WORD_MIN && (((uintptr_t) dst ^ (uintptr_t) src) & 3) == 0)
+    {
+      size_t head = -(uintptr_t) dst & 3;
+      size_t words = (size - head) / 4;
+
+      size = (size - head) % 4;
+      asm volatile ("rep movsb"
+                    : "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+    }
+  asm volatile ("rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (size) : : "memory");
+}
+
+/* Copies SIZE bytes from SRC to DST, highest address first, with
+   the string instructions run backward.  Whole words are moved
+   when DST and SRC are equally aligned. */
+static void
+copy_backward (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  /* Point at the last byte of each block. */
+  dst += size - 1;
+  src += size - 1;
+  asm volatile ("std");
+  if (size >= WORD_MIN && (((uintptr_t) dst ^ (uintptr_t) src) & 3) == 0)
+    {
+      size_t head = ((uintptr_t) dst + 1) & 3;
+      size_t words = (size - head) / 4;
+
+      size = (size - head) % 4;
+      asm volatile ("rep movsb"
+                    : "+D" (dst), "+S" (src), "+c" (head) : : "memory");
+
+      /* Word moves address the lowest byte of each word. */
+      dst -= 3;
+      src -= 3;
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words) : : "memory");
+      dst += 3;
+      src += 3;
+    }
+  asm volatile ("rep movsb"
+                : "+D" (dst), "+S" (src), "+c" (size) : : "memory");
+  asm volatile ("cld");
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,8 +81,14 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
+  if (memcpy_page_fn != NULL && page_aligned (dst) && page_aligned (src))
+    for (; size >= STRING_PAGE_SIZE && memcpy_page_fn (dst, src);
+         size -= STRING_PAGE_SIZE)
+      {
+        dst += STRING_PAGE_SIZE;
+        src += STRING_PAGE_SIZE;
+      }
+  copy_forward (dst, src, size);
 
   return dst_;
 }
@@ -29,20 +104,12 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
-  else 
-    {
-      dst += size;
-      src += size;
-      while (size-- > 0)
-        *--dst = *--src;
-    }
+  if (dst <= src || dst >= src + size)
+    copy_forward (dst, src, size);
+  else
+    copy_backward (dst, src, size);
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -58,6 +125,18 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip equal words quickly; the loop below finds which byte of
+     the first unequal word differs. */
+  if (size >= WORD_MIN && (((uintptr_t) a ^ (uintptr_t) b) & 3) == 0)
+    {
+      for (; ((uintptr_t) a & 3) != 0; a++, b++, size--)
+        if (*a != *b)
+          return *a > *b ? +1 : -1;
+      for (; size >= 4 && *(const uint32_t *) a == *(const uint32_t *) b;
+           a += 4, b += 4, size -= 4)
+        continue;
+    }
+
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -281,9 +360,26 @@ memset (void *dst_, int value, size_t size)
   unsigned char *dst = dst_;
 
   ASSERT (dst != NULL || size == 0);
-  
-  while (size-- > 0)
-    *dst++ = value;
+
+  if (value == 0 && memzero_page_fn != NULL && page_aligned (dst))
+    for (; size >= STRING_PAGE_SIZE && memzero_page_fn (dst);
+         size -= STRING_PAGE_SIZE)
+      dst += STRING_PAGE_SIZE;
+
+  if (size >= WORD_MIN)
+    {
+      uint32_t word = (unsigned char) value * 0x01010101u;
+      size_t head = -(uintptr_t) dst & 3;
+      size_t words = (size - head) / 4;
+
+      size = (size - head) % 4;
+      asm volatile ("rep stosb"
+                    : "+D" (dst), "+c" (head) : "a" (value) : "memory");
+      asm volatile ("rep stosl"
+                    : "+D" (dst), "+c" (words) : "a" (word) : "memory");
+    }
+  asm volatile ("rep stosb"
+                : "+D" (dst), "+c" (size) : "a" (value) : "memory");
 
   return dst_;
 }
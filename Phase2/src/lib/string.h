@@ -1,6 +1,7 @@
 #ifndef __LIB_STRING_H
 #define __LIB_STRING_H
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /* Standard. */
@@ -25,6 +26,15 @@ size_t strlcat (char *, const char *, size_t);
 char *strtok_r (char *, const char *, char **);
 size_t strnlen (const char *, size_t);
 
+/* Size and alignment of the blocks that memcpy() and memset()
+   hand to these routines, if set.  The kernel sets them at boot
+   to faster versions than the processor's string instructions.
+   A routine returns false, having done nothing, to decline a
+   block, which is then done the ordinary way. */
+#define STRING_PAGE_SIZE 4096
+extern bool (*memcpy_page_fn) (void *dst, const void *src);
+extern bool (*memzero_page_fn) (void *dst);
+
 /* Try to be helpful. */
 #define strcpy dont_use_strcpy_use_strlcpy
 #define strncpy dont_use_strncpy_use_strlcpy
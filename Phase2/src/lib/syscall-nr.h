@@ -28,7 +28,61 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+
+    /* Extensions. */
+    SYS_FORK,                   /* Duplicate this process. */
+    SYS_RING_SETUP,             /* Register system call rings. */
+    SYS_SUBMIT,                 /* Make the system calls queued. */
+    SYS_TTYMODE,                /* Set terminal input cooked or raw. */
+    SYS_PREAD,                  /* Read from a file at an offset. */
+    SYS_PWRITE,                 /* Write to a file at an offset. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_COPY,                   /* Copy between files in the kernel. */
+    SYS_EXECV,                  /* Start a process with an argv. */
+    SYS_SPAWN,                  /* Start a process, not waiting for it. */
+    SYS_SPAWN_STATUS,           /* Whether a spawned process loaded. */
+    SYS_WAIT_ANY,               /* Wait for any child process to die. */
+    SYS_SET_AFFINITY,           /* Choose the processors to run on. */
+    SYS_GETRUSAGE,              /* Report threads' resource usage. */
+    SYS_UPTIME,                 /* Report timer ticks since boot. */
+    SYS_CYCLES,                 /* Read the time-stamp counter. */
+    SYS_MEMSTAT,                /* Report kernel memory usage. */
+    SYS_STATS,                  /* Print the statistics registry. */
+    SYS_SBRK,                   /* Move the end of the heap. */
+    SYS_THREAD_SPAWN,           /* Start a thread in this process. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+    SYS_THREAD_EXIT,            /* End the calling thread. */
+    SYS_FUTEX_WAIT,             /* Sleep while a user word is unchanged. */
+    SYS_FUTEX_WAKE,             /* Wake threads sleeping on a word. */
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_DUP2,                   /* Duplicate a file descriptor. */
+    SYS_SHM_OPEN,               /* Open a shared memory object. */
+    SYS_SHM_UNLINK,             /* Delete a shared memory object. */
+    SYS_SHM_MAP,                /* Map a shared memory object. */
+    SYS_SHM_UNMAP,              /* Remove a shared memory mapping. */
+    SYS_POLL,                   /* Wait for file descriptors to be ready. */
+    SYS_SET_NONBLOCK,           /* Make an fd's reads and writes not wait. */
+    SYS_AIO_READ,               /* Start a read at an offset. */
+    SYS_AIO_WRITE,              /* Start a write at an offset. */
+    SYS_AIO_WAIT,               /* Wait for a started read or write. */
+    SYS_GETRLIMIT,              /* Get a resource limit. */
+    SYS_SETRLIMIT,              /* Lower a resource limit. */
+    SYS_READDIR_PLUS,           /* Read directory entries with attributes. */
+    SYS_CLOCK_GETTIME,          /* Read the wall or monotonic clock. */
+    SYS_KLOG,                   /* Read the kernel log. */
+    SYS_THREADINFO,             /* Report threads' state. */
+    SYS_UPCALL_WAIT,            /* Park until a sibling thread blocks. */
+    SYS_UPCALL_WAKE,            /* Wake parked threads. */
+    SYS_FALLOCATE,              /* Preallocate space for a file. */
+    SYS_FSYNC,                  /* Write a file's data to disk. */
+    SYS_SPAWN_FDS,              /* Start a process on given fds. */
+    SYS_CREATE_MANY,            /* Create several files. */
+    SYS_REMOVE_MANY,            /* Delete several files. */
+    SYS_STAT_MANY,              /* Look up several files' attributes. */
+    SYS_CHECKPOINT,             /* Save the process to a file. */
+    SYS_RESTORE                 /* Start a process saved to a file. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -0,0 +1,76 @@
+#ifndef __LIB_SYSCALL_RING_H
+#define __LIB_SYSCALL_RING_H
+
+#include <stdint.h>
+
+/* Batched system calls.
+
+   A process registers a submission ring and a completion ring,
+   each in a page of its own memory, with ring_setup().  It then
+   queues system calls on the submission ring and makes them all
+   with a single submit(), which posts the result of each, in
+   order, on the completion ring and returns how many it made.
+
+   Each ring's head is advanced only by its consumer and its
+   tail only by its producer: the process produces submissions
+   and consumes completions, and the kernel the other way around.
+   Both count up without wrapping to zero; an index is taken
+   modulo the ring's size.  submit() stops early if the
+   completion ring fills up.
+
+   A bad buffer or file name kills the process, as it would in
+   the system call itself.  Anything else a system call would
+   fail on, or that is not a valid operation, completes with -1. */
+
+/* Bytes in a ring.  Each ring must be aligned to a page. */
+#define RING_SIZE 4096
+
+/* Entries in each ring.  Powers of 2, so that the indexes stay
+   in step when they overflow. */
+#define RING_SQ_ENTRIES 128
+#define RING_CQ_ENTRIES 256
+
+/* Operations, with the system call each one makes. */
+enum ring_op
+  {
+    RING_READ,                  /* read (fd, buffer, size). */
+    RING_WRITE,                 /* write (fd, buffer, size). */
+    RING_SEEK,                  /* seek (fd, size), 0 on success. */
+    RING_OPEN,                  /* open (buffer). */
+    RING_CLOSE                  /* close (fd), 0 on success. */
+  };
+
+/* A system call to make. */
+struct ring_sqe
+  {
+    uint32_t op;                /* One of enum ring_op. */
+    int32_t fd;                 /* File descriptor. */
+    void *buffer;               /* Buffer, or file name for open. */
+    uint32_t size;              /* Size of buffer, or seek position. */
+    uint32_t user_data;         /* Copied to the completion. */
+  };
+
+/* The result of one. */
+struct ring_cqe
+  {
+    uint32_t user_data;         /* From the submission. */
+    int32_t result;             /* What the system call returned. */
+  };
+
+/* Submission ring. */
+struct ring_sq
+  {
+    volatile uint32_t head;     /* Next entry for the kernel. */
+    volatile uint32_t tail;     /* Next entry for the process. */
+    struct ring_sqe entries[RING_SQ_ENTRIES];
+  };
+
+/* Completion ring. */
+struct ring_cq
+  {
+    volatile uint32_t head;     /* Next entry for the process. */
+    volatile uint32_t tail;     /* Next entry for the kernel. */
+    struct ring_cqe entries[RING_CQ_ENTRIES];
+  };
+
+#endif /* lib/syscall-ring.h */
@@ -0,0 +1,28 @@
+#ifndef __LIB_THREADINFO_H
+#define __LIB_THREADINFO_H
+
+/* States of a thread, as reported by threadinfo(). */
+#define THREADINFO_RUNNING 0    /* Running. */
+#define THREADINFO_READY 1      /* Not running but ready to run. */
+#define THREADINFO_BLOCKED 2    /* Waiting for an event. */
+#define THREADINFO_DYING 3      /* About to be destroyed. */
+
+/* State of one thread, as reported by threadinfo().  Times are in
+   timer ticks. */
+struct threadinfo
+  {
+    int tid;                    /* Thread identifier. */
+    char name[16];              /* Thread name. */
+    int status;                 /* THREADINFO_* state. */
+    int priority;               /* Priority, counting those lent. */
+    unsigned user_ticks;        /* Ticks spent running in user mode. */
+    unsigned kernel_ticks;      /* Ticks spent running in the kernel. */
+    int cpu;                    /* Processor it runs or last ran on. */
+    unsigned last_ran;          /* Tick it was last switched out. */
+  };
+
+/* Most threads threadinfo() knows about.  More may run, but are
+   left out. */
+#define THREADINFO_MAX 256
+
+#endif /* lib/threadinfo.h */
@@ -45,17 +45,14 @@ putchar (int c)
   return c;
 }
 
-/* Auxiliary data for vhprintf_helper(). */
+/* Auxiliary data for write_run(). */
 struct vhprintf_aux 
   {
-    char buf[64];       /* Character buffer. */
-    char *p;            /* Current position in buffer. */
     int char_cnt;       /* Total characters written so far. */
     int handle;         /* Output file handle. */
   };
 
-static void add_char (char, void *);
-static void flush (struct vhprintf_aux *);
+static void write_run (const char *, size_t, void *);
 
 /* Formats the printf() format specification FORMAT with
    arguments given in ARGS and writes the output to the given
@@ -64,31 +61,18 @@ int
 vhprintf (int handle, const char *format, va_list args) 
 {
   struct vhprintf_aux aux;
-  aux.p = aux.buf;
   aux.char_cnt = 0;
   aux.handle = handle;
-  __vprintf (format, args, add_char, &aux);
-  flush (&aux);
+  __vprintf_runs (format, args, write_run, &aux);
   return aux.char_cnt;
 }
 
-/* Adds C to the buffer in AUX, flushing it if the buffer fills
-   up. */
+/* Writes the N-byte RUN produced by __vprintf_runs() to the
+   handle in AUX_. */
 static void
-add_char (char c, void *aux_) 
+write_run (const char *run, size_t n, void *aux_) 
 {
   struct vhprintf_aux *aux = aux_;
-  *aux->p++ = c;
-  if (aux->p >= aux->buf + sizeof aux->buf)
-    flush (aux);
-  aux->char_cnt++;
-}
-
-/* Flushes the buffer in AUX. */
-static void
-flush (struct vhprintf_aux *aux)
-{
-  if (aux->p > aux->buf)
-    write (aux->handle, aux->buf, aux->p - aux->buf);
-  aux->p = aux->buf;
+  write (aux->handle, run, n);
+  aux->char_cnt += n;
 }
@@ -0,0 +1,444 @@
+#include <malloc.h>
+#include <debug.h>
+#include <round.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* A size-class malloc() for user programs, on top of sbrk().
+
+   Each request is rounded up to a power of 2 from 16 to 1024
+   bytes, its "size class".  A block of a size class comes from a
+   one-page "arena" obtained from sbrk() and carved into blocks of
+   that size, with the size class recorded in a header at the
+   start of the page, so that free() finds it by rounding the
+   block's address down to a page boundary.
+
+   Requests beyond the largest size class get "big blocks": runs
+   of whole pages from sbrk(), with the page count in the header.
+   Freed big blocks go on an address-ordered list, where each is
+   merged with its free neighbors, and are reused first-fit,
+   split if larger than a new request needs.  The heap shrinks
+   when a free block ends up at its very top.
+
+   Free blocks of each size class are kept in two tiers.  The
+   front tier is a cache of a few free blocks per class, which
+   malloc() and free() use without touching anything else; when
+   it runs dry or fills up, a batch of blocks moves from or to the
+   central free list behind it.  A process has a single thread, so
+   there is a single cache.  With threads, each would get a cache
+   of its own from current_cache() and only the central lists
+   would need a lock, which batching keeps off the fast path. */
+
+/* Size of a page, the unit in which the heap grows. */
+#define PAGE_SIZE 4096
+
+/* Size classes: 16, 32, ..., 1024 bytes. */
+#define MIN_BLOCK 16
+#define CLASS_CNT 7
+
+/* Most free blocks the cache keeps per size class, and how many
+   move between it and the central list at a time. */
+#define CACHE_MAX 32
+#define CACHE_BATCH (CACHE_MAX / 2)
+
+/* Magic number for detecting arena corruption. */
+#define ARENA_MAGIC 0x5be7c3a1
+
+/* Size class of a big block. */
+#define CLASS_BIG CLASS_CNT
+
+/* Arena header, at the start of a page.  Its size keeps the
+   blocks after it 16-byte aligned. */
+struct arena
+  {
+    unsigned magic;             /* Always set to ARENA_MAGIC. */
+    unsigned class;             /* Size class, or CLASS_BIG. */
+    size_t page_cnt;            /* Pages in a big block. */
+    struct arena *next;         /* Next free big block. */
+  };
+
+/* Free block. */
+struct block
+  {
+    struct block *next;         /* Next free block of its class. */
+  };
+
+/* A singly linked list of free blocks of one size class. */
+struct free_list
+  {
+    struct block *head;         /* First block. */
+    size_t cnt;                 /* Number of blocks. */
+  };
+
+/* Front tier: free blocks kept for one thread. */
+struct malloc_cache
+  {
+    struct free_list lists[CLASS_CNT];
+  };
+
+/* Back tier: free blocks of each size class beyond the caches. */
+static struct free_list central[CLASS_CNT];
+
+/* Free big blocks, in order of address. */
+static struct arena *big_free;
+
+/* The process's one cache. */
+static struct malloc_cache main_cache;
+
+static struct malloc_cache *current_cache (void);
+static void *heap_grow (size_t page_cnt);
+static bool central_refill (unsigned class);
+static void cache_refill (struct malloc_cache *, unsigned class);
+static void cache_drain (struct malloc_cache *, unsigned class);
+static void *big_alloc (size_t size);
+static void big_free_block (struct arena *);
+static struct arena *block_to_arena (void *);
+
+/* Returns the cache for the running thread. */
+static struct malloc_cache *
+current_cache (void)
+{
+  return &main_cache;
+}
+
+/* Returns the size class that holds SIZE bytes, or CLASS_BIG if
+   SIZE is too big for any of them. */
+static unsigned
+size_to_class (size_t size)
+{
+  unsigned class = 0;
+  size_t block_size = MIN_BLOCK;
+
+  while (block_size < size && class < CLASS_BIG)
+    {
+      block_size *= 2;
+      class++;
+    }
+  return class;
+}
+
+/* Returns the size of the blocks in size class CLASS. */
+static size_t
+class_size (unsigned class)
+{
+  return (size_t) MIN_BLOCK << class;
+}
+
+/* Pops a block off LIST, which must not be empty. */
+static struct block *
+free_list_pop (struct free_list *list)
+{
+  struct block *b = list->head;
+  list->head = b->next;
+  list->cnt--;
+  return b;
+}
+
+/* Pushes block B onto LIST. */
+static void
+free_list_push (struct free_list *list, struct block *b)
+{
+  b->next = list->head;
+  list->head = b;
+  list->cnt++;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  struct malloc_cache *c;
+  unsigned class;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0)
+    return NULL;
+
+  class = size_to_class (size);
+  if (class == CLASS_BIG)
+    return big_alloc (size);
+
+  c = current_cache ();
+  if (c->lists[class].head == NULL)
+    {
+      cache_refill (c, class);
+      if (c->lists[class].head == NULL)
+        return NULL;
+    }
+  return free_list_pop (&c->lists[class]);
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  if (b != 0 && a > SIZE_MAX / b)
+    return NULL;
+  size = a * b;
+
+  /* Allocate and zero memory. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/* Returns the number of bytes usable in BLOCK. */
+static size_t
+block_size (void *block)
+{
+  struct arena *a = block_to_arena (block);
+
+  return (a->class == CLASS_BIG
+          ? PAGE_SIZE * a->page_cnt - sizeof *a
+          : class_size (a->class));
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer and leaves OLD_BLOCK as it was.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  else if (old_block == NULL)
+    return malloc (new_size);
+  else
+    {
+      size_t old_size = block_size (old_block);
+      void *new_block;
+
+      /* Keep the block if it is big enough and not more than
+         twice too big, so that shrinking still gives memory
+         back. */
+      if (new_size <= old_size
+          && (old_size <= MIN_BLOCK || new_size > old_size / 2))
+        return old_block;
+
+      new_block = malloc (new_size);
+      if (new_block != NULL)
+        {
+          memcpy (new_block, old_block,
+                  new_size < old_size ? new_size : old_size);
+          free (old_block);
+        }
+      return new_block;
+    }
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  struct malloc_cache *c;
+  struct arena *a;
+
+  if (p == NULL)
+    return;
+
+  a = block_to_arena (p);
+  if (a->class == CLASS_BIG)
+    {
+      big_free_block (a);
+      return;
+    }
+
+  c = current_cache ();
+  free_list_push (&c->lists[a->class], p);
+  if (c->lists[a->class].cnt > CACHE_MAX)
+    cache_drain (c, a->class);
+}
+
+/* Moves up to CACHE_BATCH blocks of size class CLASS from the
+   central list into cache C, carving a new arena if the central
+   list is empty. */
+static void
+cache_refill (struct malloc_cache *c, unsigned class)
+{
+  struct free_list *from = &central[class];
+  size_t i;
+
+  if (from->head == NULL && !central_refill (class))
+    return;
+  for (i = 0; i < CACHE_BATCH && from->head != NULL; i++)
+    free_list_push (&c->lists[class], free_list_pop (from));
+}
+
+/* Moves CACHE_BATCH blocks of size class CLASS from cache C back
+   to the central list. */
+static void
+cache_drain (struct malloc_cache *c, unsigned class)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_BATCH; i++)
+    free_list_push (&central[class], free_list_pop (&c->lists[class]));
+}
+
+/* Gets a new arena for size class CLASS and puts all of its
+   blocks on the central list.  Returns false if the heap cannot
+   grow. */
+static bool
+central_refill (unsigned class)
+{
+  size_t size = class_size (class);
+  struct arena *a = heap_grow (1);
+  uint8_t *b;
+
+  if (a == NULL)
+    return false;
+  a->magic = ARENA_MAGIC;
+  a->class = class;
+  a->page_cnt = 1;
+  a->next = NULL;
+
+  /* Push the blocks in reverse, so that they are handed out in
+     address order. */
+  for (b = (uint8_t *) a + PAGE_SIZE - size; b >= (uint8_t *) (a + 1);
+       b -= size)
+    free_list_push (&central[class], (struct block *) b);
+  return true;
+}
+
+/* Returns a big block of at least SIZE bytes, reusing a freed
+   one if there is one that is large enough, or a null pointer if
+   memory is not available. */
+static void *
+big_alloc (size_t size)
+{
+  struct arena **ap, *a;
+  size_t page_cnt;
+
+  if (size > SIZE_MAX - sizeof *a - PAGE_SIZE)
+    return NULL;
+  page_cnt = DIV_ROUND_UP (size + sizeof *a, PAGE_SIZE);
+
+  for (ap = &big_free; *ap != NULL; ap = &(*ap)->next)
+    if ((*ap)->page_cnt >= page_cnt)
+      {
+        a = *ap;
+        *ap = a->next;
+        if (a->page_cnt > page_cnt)
+          {
+            /* Give back the pages this request does not need. */
+            struct arena *rest
+              = (struct arena *) ((uint8_t *) a + page_cnt * PAGE_SIZE);
+            rest->magic = ARENA_MAGIC;
+            rest->class = CLASS_BIG;
+            rest->page_cnt = a->page_cnt - page_cnt;
+            big_free_block (rest);
+            a->page_cnt = page_cnt;
+          }
+        return a + 1;
+      }
+
+  a = heap_grow (page_cnt);
+  if (a == NULL)
+    return NULL;
+  a->magic = ARENA_MAGIC;
+  a->class = CLASS_BIG;
+  a->page_cnt = page_cnt;
+  return a + 1;
+}
+
+/* Returns the address just past big block A. */
+static uint8_t *
+big_end (struct arena *a)
+{
+  return (uint8_t *) a + a->page_cnt * PAGE_SIZE;
+}
+
+/* Frees big block A, merging it with any free big blocks right
+   next to it.  If that leaves a free block at the top of the
+   heap, the heap shrinks to give its pages back to the kernel. */
+static void
+big_free_block (struct arena *a)
+{
+  struct arena **ap = &big_free;        /* Link that will point to A. */
+  struct arena **prev_ap = NULL;        /* Link to the block before. */
+  struct arena *next;
+
+  /* Find A's place in address order. */
+  while (*ap != NULL && *ap < a)
+    {
+      prev_ap = ap;
+      ap = &(*ap)->next;
+    }
+  next = *ap;
+
+  /* Merge with the block after A. */
+  if (next != NULL && big_end (a) == (uint8_t *) next)
+    {
+      a->page_cnt += next->page_cnt;
+      next->magic = 0;
+      next = next->next;
+    }
+
+  /* Merge with the block before A, or link A in. */
+  if (prev_ap != NULL && big_end (*prev_ap) == (uint8_t *) a)
+    {
+      (*prev_ap)->page_cnt += a->page_cnt;
+      (*prev_ap)->next = next;
+      a->magic = 0;
+      ap = prev_ap;
+      a = *ap;
+    }
+  else
+    {
+      a->next = next;
+      *ap = a;
+    }
+
+  /* Only the last free block can be at the top of the heap. */
+  if (a->next == NULL && big_end (a) == (uint8_t *) sbrk (0))
+    {
+      *ap = NULL;
+      a->magic = 0;
+      sbrk (-(intptr_t) (a->page_cnt * PAGE_SIZE));
+    }
+}
+
+/* Extends the heap by PAGE_CNT pages and returns the first of
+   them, or a null pointer if the kernel refuses.  If the program
+   has moved the break itself, it is first rounded up to a page
+   boundary. */
+static void *
+heap_grow (size_t page_cnt)
+{
+  uintptr_t brk = (uintptr_t) sbrk (0);
+  size_t pad = ROUND_UP (brk, PAGE_SIZE) - brk;
+  uint8_t *p;
+
+  if (page_cnt > (INTPTR_MAX - pad) / PAGE_SIZE)
+    return NULL;
+  p = sbrk (pad + page_cnt * PAGE_SIZE);
+  return p != (void *) -1 ? p + pad : NULL;
+}
+
+/* Returns the arena that block B is inside. */
+static struct arena *
+block_to_arena (void *b)
+{
+  struct arena *a = (struct arena *) ((uintptr_t) b & ~(PAGE_SIZE - 1));
+
+  ASSERT (a != NULL);
+  ASSERT (a->magic == ARENA_MAGIC);
+  return a;
+}
@@ -0,0 +1,116 @@
+#include <sync.h>
+#include <limits.h>
+#include <syscall.h>
+
+/* Atomically sets *P to NEW if it holds OLD.  Returns what *P
+   held. */
+static inline int
+cmpxchg (int *p, int old, int new)
+{
+  int prev;
+  asm volatile ("lock cmpxchgl %2, %1"
+                : "=a" (prev), "+m" (*p)
+                : "r" (new), "0" (old)
+                : "memory");
+  return prev;
+}
+
+/* Atomically sets *P to NEW and returns what it held. */
+static inline int
+xchg (int *p, int new)
+{
+  asm volatile ("xchgl %0, %1"
+                : "+r" (new), "+m" (*p)
+                :
+                : "memory");
+  return new;
+}
+
+/* Atomically adds 1 to *P. */
+static inline void
+atomic_inc (int *p)
+{
+  asm volatile ("lock incl %0" : "+m" (*p) : : "memory");
+}
+
+void
+mutex_init (struct mutex *m)
+{
+  m->state = 0;
+}
+
+/* Takes M, sleeping in the kernel while another thread holds it.
+   A thread that has had to wait leaves the state at 2, so that
+   whoever releases M next knows to wake one up. */
+void
+mutex_lock (struct mutex *m)
+{
+  int c = cmpxchg (&m->state, 0, 1);
+  if (c == 0)
+    return;
+  if (c != 2)
+    c = xchg (&m->state, 2);
+  while (c != 0)
+    {
+      futex_wait (&m->state, 2);
+      c = xchg (&m->state, 2);
+    }
+}
+
+/* Takes M if no thread holds it.  Returns true if successful. */
+bool
+mutex_trylock (struct mutex *m)
+{
+  return cmpxchg (&m->state, 0, 1) == 0;
+}
+
+/* Releases M, which the current thread must hold, entering the
+   kernel only if a thread may be waiting for it. */
+void
+mutex_unlock (struct mutex *m)
+{
+  if (xchg (&m->state, 0) == 2)
+    futex_wake (&m->state, 1);
+}
+
+void
+condvar_init (struct condvar *cv)
+{
+  cv->seq = 0;
+}
+
+/* Releases M, which the current thread must hold, waits for CV
+   to be signalled, and takes M again.  A signal sent after M is
+   released but before the thread sleeps changes CV's sequence
+   number, so that futex_wait() returns at once.  As with any
+   condition variable, the caller must test its condition again
+   on return. */
+void
+condvar_wait (struct condvar *cv, struct mutex *m)
+{
+  int seq = cv->seq;
+
+  mutex_unlock (m);
+  futex_wait (&cv->seq, seq);
+
+  /* Woken threads may have to wait for M behind others, so take
+     it as a waiter would and have mutex_unlock() wake the rest. */
+  while (xchg (&m->state, 2) != 0)
+    futex_wait (&m->state, 2);
+}
+
+/* Wakes one thread waiting on CV, if any. */
+void
+condvar_signal (struct condvar *cv)
+{
+  atomic_inc (&cv->seq);
+  futex_wake (&cv->seq, 1);
+}
+
+/* Wakes every thread waiting on CV. */
+void
+condvar_broadcast (struct condvar *cv)
+{
+  atomic_inc (&cv->seq);
+  futex_wake (&cv->seq, INT_MAX);
+}
@@ -0,0 +1,35 @@
+#ifndef __LIB_USER_SYNC_H
+#define __LIB_USER_SYNC_H
+
+#include <stdbool.h>
+
+/* A mutex for the threads of one process.  Taken and released
+   with an atomic instruction in user space; only a thread that
+   finds it held enters the kernel, to sleep on it with
+   futex_wait(). */
+struct mutex
+  {
+    int state;          /* 0: free, 1: held, 2: held, maybe waiters. */
+  };
+
+#define MUTEX_INITIALIZER { 0 }
+
+void mutex_init (struct mutex *);
+void mutex_lock (struct mutex *);
+bool mutex_trylock (struct mutex *);
+void mutex_unlock (struct mutex *);
+
+/* A condition variable, used with a mutex. */
+struct condvar
+  {
+    int seq;            /* Bumped by every signal and broadcast. */
+  };
+
+#define CONDVAR_INITIALIZER { 0 }
+
+void condvar_init (struct condvar *);
+void condvar_wait (struct condvar *, struct mutex *);
+void condvar_signal (struct condvar *);
+void condvar_broadcast (struct condvar *);
+
+#endif /* lib/user/sync.h */
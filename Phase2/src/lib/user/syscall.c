@@ -1,16 +1,31 @@
 #include <syscall.h>
+#include <clock.h>
 #include "../syscall-nr.h"
 
+/* How the macros below enter the kernel, with the system call
+   number and arguments pushed on the user stack.  Built with
+   SYSCALL_SYSENTER defined, they use the SYSENTER fast path,
+   which returns to the address in EDX with the stack pointer in
+   ECX, so both are clobbered.  Otherwise they use int $0x30,
+   which works on every CPU. */
+#ifdef SYSCALL_SYSENTER
+#define SYSCALL_TRAP "movl %%esp, %%ecx; movl $1f, %%edx; sysenter; 1: "
+#define SYSCALL_CLOBBERS "ecx", "edx", "memory"
+#else
+#define SYSCALL_TRAP "int $0x30; "
+#define SYSCALL_CLOBBERS "memory"
+#endif
+
 /* Invokes syscall NUMBER, passing no arguments, and returns the
    return value as an `int'. */
 #define syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
-            ("pushl %[number]; int $0x30; addl $4, %%esp"       \
+            ("pushl %[number]; " SYSCALL_TRAP "addl $4, %%esp"  \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER)                          \
-               : "memory");                                     \
+               : SYSCALL_CLOBBERS);                             \
           retval;                                               \
         })
 
@@ -20,11 +35,12 @@
         ({                                                               \
           int retval;                                                    \
           asm volatile                                                   \
-            ("pushl %[arg0]; pushl %[number]; int $0x30; addl $8, %%esp" \
+            ("pushl %[arg0]; pushl %[number]; "                          \
+             SYSCALL_TRAP "addl $8, %%esp"                               \
                : "=a" (retval)                                           \
                : [number] "i" (NUMBER),                                  \
                  [arg0] "g" (ARG0)                                       \
-               : "memory");                                              \
+               : SYSCALL_CLOBBERS);                                      \
           retval;                                                        \
         })
 
@@ -35,12 +51,12 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg1]; pushl %[arg0]; "                   \
-             "pushl %[number]; int $0x30; addl $12, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP "addl $12, %%esp" \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1)                              \
-               : "memory");                                     \
+               : SYSCALL_CLOBBERS);                             \
           retval;                                               \
         })
 
@@ -51,13 +67,32 @@
           int retval;                                           \
           asm volatile                                          \
             ("pushl %[arg2]; pushl %[arg1]; pushl %[arg0]; "    \
-             "pushl %[number]; int $0x30; addl $16, %%esp"      \
+             "pushl %[number]; " SYSCALL_TRAP "addl $16, %%esp" \
                : "=a" (retval)                                  \
                : [number] "i" (NUMBER),                         \
                  [arg0] "r" (ARG0),                             \
                  [arg1] "r" (ARG1),                             \
                  [arg2] "r" (ARG2)                              \
-               : "memory");                                     \
+               : SYSCALL_CLOBBERS);                             \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, ARG2,
+   and ARG3, and returns the return value as an `int'. */
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; "                 \
+             SYSCALL_TRAP "addl $20, %%esp"                     \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "r" (ARG0),                             \
+                 [arg1] "r" (ARG1),                             \
+                 [arg2] "r" (ARG2),                             \
+                 [arg3] "r" (ARG3)                              \
+               : SYSCALL_CLOBBERS);                             \
           retval;                                               \
         })
 
@@ -153,6 +188,18 @@ munmap (mapid_t mapid)
   syscall1 (SYS_MUNMAP, mapid);
 }
 
+int
+checkpoint (int fd)
+{
+  return syscall1 (SYS_CHECKPOINT, fd);
+}
+
+pid_t
+restore (const char *file)
+{
+  return (pid_t) syscall1 (SYS_RESTORE, file);
+}
+
 bool
 chdir (const char *dir)
 {
@@ -182,3 +229,324 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
+bool
+ring_setup (struct ring_sq *sq, struct ring_cq *cq)
+{
+  return syscall2 (SYS_RING_SETUP, sq, cq);
+}
+
+int
+submit (void)
+{
+  return syscall0 (SYS_SUBMIT);
+}
+
+bool
+ttymode (bool cooked)
+{
+  return syscall1 (SYS_TTYMODE, cooked);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+readv (int fd, const struct iovec *iov, int cnt)
+{
+  return syscall3 (SYS_READV, fd, iov, cnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int cnt)
+{
+  return syscall3 (SYS_WRITEV, fd, iov, cnt);
+}
+
+int
+copy (int to, int from, unsigned size)
+{
+  return syscall3 (SYS_COPY, to, from, size);
+}
+
+pid_t
+execv (const char *file, char *const argv[])
+{
+  return (pid_t) syscall2 (SYS_EXECV, file, argv);
+}
+
+pid_t
+spawn (const char *cmd_line)
+{
+  return (pid_t) syscall1 (SYS_SPAWN, cmd_line);
+}
+
+pid_t
+spawn_fds (const char *cmd_line, const struct spawn_fd *fds, int cnt)
+{
+  return (pid_t) syscall3 (SYS_SPAWN_FDS, cmd_line, fds, cnt);
+}
+
+int
+spawn_status (pid_t pid)
+{
+  return syscall1 (SYS_SPAWN_STATUS, pid);
+}
+
+pid_t
+wait_any (int *status)
+{
+  return (pid_t) syscall1 (SYS_WAIT_ANY, status);
+}
+
+bool
+set_affinity (unsigned mask)
+{
+  return syscall1 (SYS_SET_AFFINITY, mask);
+}
+
+int
+getrusage (int who, struct rusage *usage, int cnt)
+{
+  return syscall3 (SYS_GETRUSAGE, who, usage, cnt);
+}
+
+int
+uptime (void)
+{
+  return syscall0 (SYS_UPTIME);
+}
+
+unsigned long long
+cycles (void)
+{
+  unsigned long long tsc;
+  syscall1 (SYS_CYCLES, &tsc);
+  return tsc;
+}
+
+int
+memstat (struct memstat *m)
+{
+  return syscall1 (SYS_MEMSTAT, m);
+}
+
+void
+stats (void)
+{
+  syscall0 (SYS_STATS);
+}
+
+void *
+sbrk (intptr_t increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+/* Where a thread started by thread_spawn() enters user mode, with
+   FN and AUX as its arguments. */
+static void
+thread_start (void (*fn) (void *aux), void *aux)
+{
+  fn (aux);
+  thread_exit ();
+}
+
+tid_t
+thread_spawn (void (*fn) (void *aux), void *aux)
+{
+  return syscall3 (SYS_THREAD_SPAWN, thread_start, fn, aux);
+}
+
+int
+thread_join (tid_t tid)
+{
+  return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (void)
+{
+  syscall0 (SYS_THREAD_EXIT);
+  NOT_REACHED ();
+}
+
+int
+futex_wait (int *addr, int val)
+{
+  return syscall2 (SYS_FUTEX_WAIT, addr, val);
+}
+
+int
+futex_wake (int *addr, int cnt)
+{
+  return syscall2 (SYS_FUTEX_WAKE, addr, cnt);
+}
+
+int
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+dup2 (int old_fd, int new_fd)
+{
+  return syscall2 (SYS_DUP2, old_fd, new_fd);
+}
+
+int
+shm_open (const char *name, int size)
+{
+  return syscall2 (SYS_SHM_OPEN, name, size);
+}
+
+bool
+shm_unlink (const char *name)
+{
+  return syscall1 (SYS_SHM_UNLINK, name);
+}
+
+void *
+shm_map (int fd, void *addr)
+{
+  return (void *) syscall2 (SYS_SHM_MAP, fd, addr);
+}
+
+bool
+shm_unmap (void *addr)
+{
+  return syscall1 (SYS_SHM_UNMAP, addr);
+}
+
+int
+poll (struct pollfd *fds, int nfds, int timeout)
+{
+  return syscall3 (SYS_POLL, fds, nfds, timeout);
+}
+
+bool
+set_nonblock (int fd, bool nonblock)
+{
+  return syscall2 (SYS_SET_NONBLOCK, fd, (int) nonblock);
+}
+
+int
+aio_read (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_AIO_READ, fd, buffer, size, offset);
+}
+
+int
+aio_write (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_AIO_WRITE, fd, buffer, size, offset);
+}
+
+int
+aio_wait (int id)
+{
+  return syscall1 (SYS_AIO_WAIT, id);
+}
+
+unsigned
+getrlimit (int resource)
+{
+  return syscall1 (SYS_GETRLIMIT, resource);
+}
+
+bool
+setrlimit (int resource, unsigned limit)
+{
+  return syscall2 (SYS_SETRLIMIT, resource, limit);
+}
+
+int
+readdir_plus (int fd, struct dirent_plus *entries, int cnt)
+{
+  return syscall3 (SYS_READDIR_PLUS, fd, entries, cnt);
+}
+
+int
+create_many (const char *const names[], unsigned initial_size, bool ok[],
+             int cnt)
+{
+  return syscall4 (SYS_CREATE_MANY, names, initial_size, ok, cnt);
+}
+
+int
+remove_many (const char *const names[], bool ok[], int cnt)
+{
+  return syscall3 (SYS_REMOVE_MANY, names, ok, cnt);
+}
+
+int
+stat_many (const char *const names[], struct dirent_plus *entries, int cnt)
+{
+  return syscall3 (SYS_STAT_MANY, names, entries, cnt);
+}
+
+/* Reads the clock from the clock page the kernel maps into every
+   process, without entering the kernel. */
+int
+clock_gettime (int clock, struct timespec *ts)
+{
+  return clock_page_read (CLOCK_PAGE_ADDR, clock, ts);
+}
+
+int
+clock_gettime_trap (int clock, struct timespec *ts)
+{
+  return syscall2 (SYS_CLOCK_GETTIME, clock, ts);
+}
+
+int
+klog (unsigned *seq, void *buffer, unsigned size)
+{
+  return syscall3 (SYS_KLOG, seq, buffer, size);
+}
+
+int
+threadinfo (struct threadinfo *info, int cnt)
+{
+  return syscall2 (SYS_THREADINFO, info, cnt);
+}
+
+void
+upcall_wait (void)
+{
+  syscall0 (SYS_UPCALL_WAIT);
+}
+
+void
+upcall_wake (int cnt)
+{
+  syscall1 (SYS_UPCALL_WAKE, cnt);
+}
+
+bool
+fallocate (int fd, unsigned length)
+{
+  return syscall2 (SYS_FALLOCATE, fd, length);
+}
+
+bool
+fsync (int fd)
+{
+  return syscall1 (SYS_FSYNC, fd);
+}
@@ -2,12 +2,17 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
 
 /* Process identifier. */
 typedef int pid_t;
 #define PID_ERROR ((pid_t) -1)
 
+/* Thread identifier. */
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
@@ -38,6 +43,8 @@ void close (int fd);
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
 void munmap (mapid_t);
+int checkpoint (int fd);
+pid_t restore (const char *file);
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -46,4 +53,68 @@ bool readdir (int fd, char name[READDIR_MAX_LEN + 1]);
 bool isdir (int fd);
 int inumber (int fd);
 
+/* Extensions. */
+struct ring_sq;
+struct ring_cq;
+struct iovec;
+struct rusage;
+struct threadinfo;
+struct memstat;
+struct pollfd;
+struct dirent_plus;
+struct timespec;
+struct spawn_fd;
+pid_t fork (void);
+bool ring_setup (struct ring_sq *, struct ring_cq *);
+int submit (void);
+bool ttymode (bool cooked);
+int pread (int fd, void *buffer, unsigned size, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned size, unsigned offset);
+int readv (int fd, const struct iovec *, int cnt);
+int writev (int fd, const struct iovec *, int cnt);
+int copy (int to, int from, unsigned size);
+pid_t execv (const char *file, char *const argv[]);
+pid_t spawn (const char *cmd_line);
+pid_t spawn_fds (const char *cmd_line, const struct spawn_fd *, int cnt);
+int spawn_status (pid_t);
+pid_t wait_any (int *status);
+bool set_affinity (unsigned mask);
+int getrusage (int who, struct rusage *, int cnt);
+int uptime (void);
+unsigned long long cycles (void);
+int memstat (struct memstat *);
+void stats (void);
+void *sbrk (intptr_t increment);
+tid_t thread_spawn (void (*fn) (void *aux), void *aux);
+int thread_join (tid_t);
+void thread_exit (void) NO_RETURN;
+int futex_wait (int *addr, int val);
+int futex_wake (int *addr, int cnt);
+int pipe (int fds[2]);
+int dup2 (int old_fd, int new_fd);
+int shm_open (const char *name, int size);
+bool shm_unlink (const char *name);
+void *shm_map (int fd, void *addr);
+bool shm_unmap (void *addr);
+int poll (struct pollfd *, int nfds, int timeout);
+bool set_nonblock (int fd, bool nonblock);
+int aio_read (int fd, void *buffer, unsigned size, unsigned offset);
+int aio_write (int fd, const void *buffer, unsigned size, unsigned offset);
+int aio_wait (int id);
+unsigned getrlimit (int resource);
+bool setrlimit (int resource, unsigned limit);
+int readdir_plus (int fd, struct dirent_plus *, int cnt);
+int create_many (const char *const names[], unsigned initial_size,
+                 bool ok[], int cnt);
+int remove_many (const char *const names[], bool ok[], int cnt);
+int stat_many (const char *const names[], struct dirent_plus *, int cnt);
+int clock_gettime (int clock, struct timespec *);
+int clock_gettime_trap (int clock, struct timespec *);
+int klog (unsigned *seq, void *buffer, unsigned size);
+int threadinfo (struct threadinfo *, int cnt);
+void upcall_wait (void);
+void upcall_wake (int cnt);
+bool fallocate (int fd, unsigned length);
+bool fsync (int fd);
+
 #endif /* lib/user/syscall.h */
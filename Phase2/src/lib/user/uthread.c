@@ -0,0 +1,286 @@
+#include <uthread.h>
+#include <round.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sync.h>
+#include <syscall.h>
+
+/* User-level threads, M:N.
+
+   Every kernel thread that uthread_main() starts runs
+   worker_run(), which takes user-level threads off the ready
+   queue one at a time and switches to each, until every one has
+   exited.  A user-level thread runs until it yields or exits,
+   either of which switches back to the kernel thread's loop, so
+   a switch costs a handful of instructions and the ready queue's
+   lock, not a trap.  A thread may come back on another kernel
+   thread than it left.
+
+   A kernel thread that finds the ready queue empty parks itself
+   in the kernel with upcall_wait().  There it stays until a
+   sibling kernel thread blocks, when the kernel wakes it to run
+   the threads that are ready while the sibling waits, or until
+   the last thread exits.  A kernel thread back from blocking just
+   carries on, so for a while more of them run than are needed;
+   each parks again as soon as the ready queue runs dry.
+
+   Each user-level thread's struct uthread is at the bottom of its
+   stack, which is aligned to its size, so that uthread_self()
+   finds it from the stack pointer as thread_current() does in
+   the kernel.  Stacks come from sbrk() and are reused after their
+   threads exit, never given back. */
+
+/* Random value for struct uthread's `magic' member, to detect
+   stack overflow. */
+#define UTHREAD_MAGIC 0x7e1d3a59
+
+/* Most kernel threads uthread_main() starts besides the caller's,
+   as many as a process may have. */
+#define SPAWN_MAX 32
+
+/* A user-level thread. */
+struct uthread
+  {
+    void *esp;                  /* Saved stack pointer. */
+    struct uthread *next;       /* In the ready queue or free list. */
+    struct worker *worker;      /* Kernel thread running it. */
+    bool dead;                  /* Has it exited? */
+    uthread_func *func;         /* Function it runs, */
+    void *aux;                  /* and its argument. */
+    unsigned magic;             /* Detects stack overflow. */
+  };
+
+/* A kernel thread running user-level threads. */
+struct worker
+  {
+    void *esp;                  /* Saved stack pointer of its loop. */
+  };
+
+/* Protects the members below. */
+static struct mutex lock = MUTEX_INITIALIZER;
+static struct uthread *ready_head;      /* Ready queue, FIFO. */
+static struct uthread *ready_tail;
+static struct uthread *free_list;       /* Stacks of exited threads. */
+static int live_cnt;                    /* Threads not yet exited. */
+static int kthread_total;               /* Kernel threads in use. */
+
+/* Saves the callee-saved registers on the current stack and the
+   stack pointer in *SAVE_ESP, then switches to the stack at ESP
+   and returns with the registers saved there. */
+void uthread_switch (void **save_esp, void *esp);
+asm (".text\n"
+     ".globl uthread_switch\n"
+     ".func uthread_switch\n"
+     "uthread_switch:\n"
+     "  movl 4(%esp), %eax\n"
+     "  movl 8(%esp), %ecx\n"
+     "  pushl %ebp\n"
+     "  pushl %ebx\n"
+     "  pushl %esi\n"
+     "  pushl %edi\n"
+     "  movl %esp, (%eax)\n"
+     "  movl %ecx, %esp\n"
+     "  popl %edi\n"
+     "  popl %esi\n"
+     "  popl %ebx\n"
+     "  popl %ebp\n"
+     "  ret\n"
+     ".endfunc\n");
+
+static void worker_run (void);
+static void worker_thread (void *aux);
+static void uthread_start (void) NO_RETURN;
+static void push_ready (struct uthread *);
+static struct uthread *stack_alloc (void);
+
+/* Runs FUNC with AUX as the first user-level thread on up to
+   KTHREAD_CNT kernel threads, the caller's included, and returns
+   once it and every thread started since have exited.  Returns
+   0 if successful, -1 if FUNC's thread could not be created. */
+int
+uthread_main (int kthread_cnt, uthread_func *func, void *aux) 
+{
+  tid_t tids[SPAWN_MAX];
+  int spawned = 0;
+  int i;
+
+  if (uthread_create (func, aux) == NULL)
+    return -1;
+
+  kthread_total = kthread_cnt;
+  for (i = 0; i < kthread_cnt - 1 && i < SPAWN_MAX; i++)
+    {
+      tids[spawned] = thread_spawn (worker_thread, NULL);
+      if (tids[spawned] != TID_ERROR)
+        spawned++;
+    }
+  worker_run ();
+  for (i = 0; i < spawned; i++)
+    thread_join (tids[i]);
+  return 0;
+}
+
+/* Creates a user-level thread that runs FUNC with AUX and puts it
+   on the ready queue.  Returns the new thread, or a null pointer
+   if there is no memory for its stack. */
+struct uthread *
+uthread_create (uthread_func *func, void *aux) 
+{
+  struct uthread *u;
+  uint32_t *sp;
+
+  mutex_lock (&lock);
+  u = stack_alloc ();
+  mutex_unlock (&lock);
+  if (u == NULL)
+    return NULL;
+
+  u->dead = false;
+  u->func = func;
+  u->aux = aux;
+  u->magic = UTHREAD_MAGIC;
+
+  /* What uthread_switch() pops to start the thread in
+     uthread_start(), which is never to return. */
+  sp = (uint32_t *) ((uint8_t *) u + UTHREAD_STACK_SIZE);
+  *--sp = 0;
+  *--sp = (uint32_t) uthread_start;
+  *--sp = 0;                    /* %ebp. */
+  *--sp = 0;                    /* %ebx. */
+  *--sp = 0;                    /* %esi. */
+  *--sp = 0;                    /* %edi. */
+  u->esp = sp;
+
+  mutex_lock (&lock);
+  live_cnt++;
+  push_ready (u);
+  mutex_unlock (&lock);
+  return u;
+}
+
+/* Returns the running user-level thread.  Must be called from
+   one. */
+struct uthread *
+uthread_self (void) 
+{
+  uintptr_t esp;
+  struct uthread *u;
+
+  asm ("movl %%esp, %0" : "=g" (esp));
+  u = (struct uthread *) (esp & ~(uintptr_t) (UTHREAD_STACK_SIZE - 1));
+  ASSERT (u->magic == UTHREAD_MAGIC);
+  return u;
+}
+
+/* Puts the running user-level thread back on the ready queue and
+   runs another, or the same if no other is ready. */
+void
+uthread_yield (void) 
+{
+  struct uthread *u = uthread_self ();
+
+  uthread_switch (&u->esp, u->worker->esp);
+}
+
+/* Ends the running user-level thread. */
+void
+uthread_exit (void) 
+{
+  struct uthread *u = uthread_self ();
+
+  u->dead = true;
+  uthread_switch (&u->esp, u->worker->esp);
+  NOT_REACHED ();
+}
+
+/* Runs ready user-level threads on the calling kernel thread
+   until none is left. */
+static void
+worker_run (void) 
+{
+  struct worker w;
+
+  mutex_lock (&lock);
+  while (live_cnt > 0)
+    {
+      struct uthread *u = ready_head;
+
+      if (u == NULL)
+        {
+          mutex_unlock (&lock);
+          upcall_wait ();
+          mutex_lock (&lock);
+          continue;
+        }
+      ready_head = u->next;
+      mutex_unlock (&lock);
+
+      u->worker = &w;
+      uthread_switch (&w.esp, u->esp);
+
+      mutex_lock (&lock);
+      if (!u->dead)
+        push_ready (u);
+      else
+        {
+          u->next = free_list;
+          free_list = u;
+          if (--live_cnt == 0)
+            upcall_wake (kthread_total);
+        }
+    }
+  mutex_unlock (&lock);
+}
+
+/* Runs worker_run() on a kernel thread started by uthread_main(). */
+static void
+worker_thread (void *aux UNUSED) 
+{
+  worker_run ();
+}
+
+/* Where a user-level thread starts. */
+static void
+uthread_start (void) 
+{
+  struct uthread *u = uthread_self ();
+
+  u->func (u->aux);
+  uthread_exit ();
+}
+
+/* Adds U to the back of the ready queue.  lock must be held. */
+static void
+push_ready (struct uthread *u) 
+{
+  u->next = NULL;
+  if (ready_head == NULL)
+    ready_head = u;
+  else
+    ready_tail->next = u;
+  ready_tail = u;
+}
+
+/* Returns a stack for a new thread, with room for its struct
+   uthread at the bottom, or a null pointer if sbrk() fails.  A
+   new stack is aligned by moving the break past whatever padding
+   it needs.  lock must be held. */
+static struct uthread *
+stack_alloc (void) 
+{
+  struct uthread *u = free_list;
+  uintptr_t brk;
+  size_t pad;
+  uint8_t *p;
+
+  if (u != NULL)
+    {
+      free_list = u->next;
+      return u;
+    }
+  brk = (uintptr_t) sbrk (0);
+  pad = ROUND_UP (brk, UTHREAD_STACK_SIZE) - brk;
+  p = sbrk (pad + UTHREAD_STACK_SIZE);
+  return p != (void *) -1 ? (struct uthread *) (p + pad) : NULL;
+}
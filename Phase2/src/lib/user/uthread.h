@@ -0,0 +1,31 @@
+#ifndef __LIB_USER_UTHREAD_H
+#define __LIB_USER_UTHREAD_H
+
+#include <debug.h>
+
+/* User-level threads, which switch from one to another without
+   entering the kernel.  uthread_main() runs them on a few kernel
+   threads of the process, any of which runs whichever user-level
+   thread is ready next; with uthread_yield() a thread lets the
+   one it runs on take another.  A user-level thread that blocks
+   in a system call blocks the kernel thread it is on, but the
+   kernel then wakes another to run the rest.
+
+   Threads on different kernel threads run at the same time, so
+   data they share needs a <sync.h> mutex, and malloc() wants one
+   of its own. */
+
+/* Bytes of stack each user-level thread gets, a power of 2, with
+   its struct uthread at the bottom. */
+#define UTHREAD_STACK_SIZE 16384
+
+struct uthread;
+typedef void uthread_func (void *aux);
+
+int uthread_main (int kthread_cnt, uthread_func *, void *aux);
+struct uthread *uthread_create (uthread_func *, void *aux);
+struct uthread *uthread_self (void);
+void uthread_yield (void);
+void uthread_exit (void) NO_RETURN;
+
+#endif /* lib/user/uthread.h */
@@ -0,0 +1,44 @@
+/* Creates, looks up and deletes a batch of files with
+   create_many(), stat_many() and remove_many(), checking each
+   entry's status, including those that must fail. */
+
+#include <dirent.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char *const names[] = {"a", "b", "c", "b", "d"};
+#define NAME_CNT ((int) (sizeof names / sizeof *names))
+
+void
+test_main (void)
+{
+  struct dirent_plus entries[NAME_CNT];
+  bool ok[NAME_CNT];
+  int i;
+
+  CHECK (create_many (names, 100, ok, NAME_CNT) == NAME_CNT - 1,
+         "create_many 5 names, one repeated");
+  for (i = 0; i < NAME_CNT; i++)
+    if (ok[i] != (i != 3))
+      fail ("create of \"%s\" at %d returned %d", names[i], i, ok[i]);
+
+  CHECK (stat_many (names, entries, NAME_CNT) == NAME_CNT,
+         "stat_many the same names");
+  for (i = 0; i < NAME_CNT; i++)
+    if (strcmp (entries[i].name, names[i]) || entries[i].is_dir
+        || entries[i].size != 100)
+      fail ("stat of \"%s\" found \"%s\", size %d",
+            names[i], entries[i].name, entries[i].size);
+
+  CHECK (remove_many (names, ok, NAME_CNT) == NAME_CNT - 1,
+         "remove_many the same names");
+  for (i = 0; i < NAME_CNT; i++)
+    if (ok[i] != (i != 3))
+      fail ("remove of \"%s\" at %d returned %d", names[i], i, ok[i]);
+
+  CHECK (stat_many (names, entries, NAME_CNT) == 0,
+         "stat_many finds none of them");
+  CHECK (entries[0].name[0] == '\0', "missing file has an empty name");
+}
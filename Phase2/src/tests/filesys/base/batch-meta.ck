@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(batch-meta) begin
+(batch-meta) create_many 5 names, one repeated
+(batch-meta) stat_many the same names
+(batch-meta) remove_many the same names
+(batch-meta) stat_many finds none of them
+(batch-meta) missing file has an empty name
+(batch-meta) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Preallocates space for an empty file, checks that it has
+   grown and reads as zeros, then writes it sequentially, one
+   fixed-size block at a time, and reads it back to verify it. */
+
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define TEST_SIZE 40000
+#define BLOCK_SIZE 1234
+
+static char buf[TEST_SIZE];
+static char zeros[TEST_SIZE];
+
+void
+test_main (void) 
+{
+  size_t ofs;
+  int fd;
+
+  CHECK (create ("noodle", 0), "create \"noodle\"");
+  CHECK ((fd = open ("noodle")) > 1, "open \"noodle\"");
+  CHECK (!fallocate (1, TEST_SIZE), "fallocate stdout (must fail)");
+  CHECK (fallocate (fd, TEST_SIZE), "fallocate \"noodle\"");
+  CHECK (filesize (fd) == TEST_SIZE, "filesize \"noodle\"");
+  if (read (fd, buf, sizeof buf) != sizeof buf
+      || memcmp (buf, zeros, sizeof buf))
+    fail ("preallocated \"noodle\" is not zeros");
+
+  random_bytes (buf, sizeof buf);
+  seek (fd, 0);
+  msg ("writing \"noodle\"");
+  for (ofs = 0; ofs < TEST_SIZE; ofs += BLOCK_SIZE)
+    {
+      size_t size = TEST_SIZE - ofs < BLOCK_SIZE ? TEST_SIZE - ofs
+                                                  : BLOCK_SIZE;
+      if (write (fd, buf + ofs, size) != (int) size)
+        fail ("write %zu bytes at offset %zu in \"noodle\" failed",
+              size, ofs);
+    }
+  CHECK (fallocate (fd, TEST_SIZE / 2), "fallocate shorter \"noodle\"");
+  CHECK (filesize (fd) == TEST_SIZE, "filesize \"noodle\" unchanged");
+  msg ("close \"noodle\"");
+  close (fd);
+
+  check_file ("noodle", buf, TEST_SIZE);
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fallocate-seq) begin
+(fallocate-seq) create "noodle"
+(fallocate-seq) open "noodle"
+(fallocate-seq) fallocate stdout (must fail)
+(fallocate-seq) fallocate "noodle"
+(fallocate-seq) filesize "noodle"
+(fallocate-seq) writing "noodle"
+(fallocate-seq) fallocate shorter "noodle"
+(fallocate-seq) filesize "noodle" unchanged
+(fallocate-seq) close "noodle"
+(fallocate-seq) open "noodle" for verification
+(fallocate-seq) verified contents of "noodle"
+(fallocate-seq) close "noodle"
+(fallocate-seq) end
+EOF
+pass;
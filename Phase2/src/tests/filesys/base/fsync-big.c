@@ -0,0 +1,38 @@
+/* Writes a file several times the size of the buffer cache, so
+   that the writer is throttled, then writes it to disk with
+   fsync() and reads it back to verify it. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define TEST_SIZE 98304
+#define BLOCK_SIZE 4096
+
+static char buf[TEST_SIZE];
+
+void
+test_main (void) 
+{
+  size_t ofs;
+  int fd;
+
+  CHECK (create ("pizza", 0), "create \"pizza\"");
+  CHECK ((fd = open ("pizza")) > 1, "open \"pizza\"");
+  CHECK (!fsync (1), "fsync stdout (must fail)");
+
+  random_bytes (buf, sizeof buf);
+  msg ("writing \"pizza\"");
+  for (ofs = 0; ofs < TEST_SIZE; ofs += BLOCK_SIZE)
+    if (write (fd, buf + ofs, BLOCK_SIZE) != BLOCK_SIZE)
+      fail ("write %d bytes at offset %zu in \"pizza\" failed",
+            BLOCK_SIZE, ofs);
+  CHECK (fsync (fd), "fsync \"pizza\"");
+  CHECK (fsync (fd), "fsync \"pizza\" again");
+  msg ("close \"pizza\"");
+  close (fd);
+  CHECK (!fsync (fd), "fsync closed fd (must fail)");
+
+  check_file ("pizza", buf, TEST_SIZE);
+}
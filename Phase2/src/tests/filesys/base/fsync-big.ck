@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(fsync-big) begin
+(fsync-big) create "pizza"
+(fsync-big) open "pizza"
+(fsync-big) fsync stdout (must fail)
+(fsync-big) writing "pizza"
+(fsync-big) fsync "pizza"
+(fsync-big) fsync "pizza" again
+(fsync-big) close "pizza"
+(fsync-big) fsync closed fd (must fail)
+(fsync-big) open "pizza" for verification
+(fsync-big) verified contents of "pizza"
+(fsync-big) close "pizza"
+(fsync-big) end
+EOF
+pass;
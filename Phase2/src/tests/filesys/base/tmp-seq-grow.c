@@ -0,0 +1,38 @@
+/* Grows a file under /tmp, which lives in memory rather than on
+   disk, one fixed-size block at a time, then reads it back to
+   verify it and removes it. */
+
+#include <syscall.h>
+#include "tests/filesys/seq-test.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define TEST_SIZE 20000
+#define BLOCK_SIZE 513
+
+static char buf[TEST_SIZE];
+
+static size_t
+return_block_size (void) 
+{
+  return BLOCK_SIZE;
+}
+
+static void
+check_file_size (int fd, long ofs) 
+{
+  long size = filesize (fd);
+  if (size != ofs)
+    fail ("filesize not updated properly: should be %ld, actually %ld",
+          ofs, size);
+}
+
+void
+test_main (void) 
+{
+  seq_test ("/tmp/noodle",
+            buf, sizeof buf, 0,
+            return_block_size, check_file_size);
+  CHECK (remove ("/tmp/noodle"), "remove \"/tmp/noodle\"");
+  CHECK (open ("/tmp/noodle") == -1, "open \"/tmp/noodle\" (must fail)");
+}
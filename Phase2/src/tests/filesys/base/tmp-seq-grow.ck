@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(tmp-seq-grow) begin
+(tmp-seq-grow) create "/tmp/noodle"
+(tmp-seq-grow) open "/tmp/noodle"
+(tmp-seq-grow) writing "/tmp/noodle"
+(tmp-seq-grow) close "/tmp/noodle"
+(tmp-seq-grow) open "/tmp/noodle" for verification
+(tmp-seq-grow) verified contents of "/tmp/noodle"
+(tmp-seq-grow) close "/tmp/noodle"
+(tmp-seq-grow) remove "/tmp/noodle"
+(tmp-seq-grow) open "/tmp/noodle" (must fail)
+(tmp-seq-grow) end
+EOF
+pass;
@@ -0,0 +1,48 @@
+/* Creates, writes, closes, and removes small files in bursts, as
+   a build or a mail spool does, and reports how many files per
+   tick go through the whole cycle. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define ROUNDS 50               /* Bursts. */
+#define BURST 10                /* Files per burst. */
+#define FILE_SIZE 512           /* Bytes written to each. */
+
+static char buf[FILE_SIZE];
+
+void
+test_main (void) 
+{
+  char name[16];
+  int round, i;
+
+  msg ("create and remove %d files", ROUNDS * BURST);
+  bench_start ();
+  for (round = 0; round < ROUNDS; round++) 
+    {
+      for (i = 0; i < BURST; i++) 
+        {
+          int fd;
+
+          snprintf (name, sizeof name, "f%d", i);
+          if (!create (name, 0))
+            fail ("create \"%s\" in round %d", name, round);
+          if ((fd = open (name)) < 2)
+            fail ("open \"%s\" in round %d", name, round);
+          if (write (fd, buf, FILE_SIZE) != FILE_SIZE)
+            fail ("write \"%s\" in round %d", name, round);
+          close (fd);
+        }
+      for (i = 0; i < BURST; i++) 
+        {
+          snprintf (name, sizeof name, "f%d", i);
+          if (!remove (name))
+            fail ("remove \"%s\" in round %d", name, round);
+        }
+    }
+  bench_report ("create", ROUNDS * BURST, ROUNDS * BURST * FILE_SIZE);
+}
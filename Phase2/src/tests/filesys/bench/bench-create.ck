@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-create) begin
+(bench-create) create and remove 500 files
+(bench-create) end
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Looks up files by name in directories of 10, 100, and 1000
+   entries, and reports the lookup rate for each size.  A lookup
+   is an open() and close() of a random entry. */
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define LOOKUPS 500
+
+static void
+lookup_bench (int entries) 
+{
+  char dir[16], name[32], bench[32];
+  int i;
+
+  snprintf (dir, sizeof dir, "d%d", entries);
+  CHECK (mkdir (dir), "mkdir \"%s\"", dir);
+  msg ("create %d files in \"%s\"", entries, dir);
+  for (i = 0; i < entries; i++) 
+    {
+      snprintf (name, sizeof name, "%s/f%d", dir, i);
+      if (!create (name, 0))
+        fail ("create \"%s\"", name);
+    }
+
+  bench_start ();
+  for (i = 0; i < LOOKUPS; i++) 
+    {
+      int fd;
+
+      snprintf (name, sizeof name, "%s/f%d", dir,
+                (int) (random_ulong () % entries));
+      if ((fd = open (name)) < 2)
+        fail ("open \"%s\"", name);
+      close (fd);
+    }
+  snprintf (bench, sizeof bench, "lookup-%d", entries);
+  bench_report (bench, LOOKUPS, 0);
+}
+
+void
+test_main (void) 
+{
+  random_init (0);
+  lookup_bench (10);
+  lookup_bench (100);
+  lookup_bench (1000);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-dir-lookup) begin
+(bench-dir-lookup) mkdir "d10"
+(bench-dir-lookup) create 10 files in "d10"
+(bench-dir-lookup) mkdir "d100"
+(bench-dir-lookup) create 100 files in "d100"
+(bench-dir-lookup) mkdir "d1000"
+(bench-dir-lookup) create 1000 files in "d1000"
+(bench-dir-lookup) end
+EOF
+pass;
@@ -0,0 +1,6 @@
+/* Random 4 kB writes and reads in a large file. */
+
+#define IO_SIZE 4096
+#define WRITE_NAME "rand-write-4k"
+#define READ_NAME "rand-read-4k"
+#include "tests/filesys/bench/rand.inc"
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-rand-4k) begin
+(bench-rand-4k) fill "rand"
+(bench-rand-4k) open "rand"
+(bench-rand-4k) end
+EOF
+pass;
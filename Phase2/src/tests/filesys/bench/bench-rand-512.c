@@ -0,0 +1,6 @@
+/* Random 512-byte writes and reads in a large file. */
+
+#define IO_SIZE 512
+#define WRITE_NAME "rand-write-512"
+#define READ_NAME "rand-read-512"
+#include "tests/filesys/bench/rand.inc"
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-rand-512) begin
+(bench-rand-512) fill "rand"
+(bench-rand-512) open "rand"
+(bench-rand-512) end
+EOF
+pass;
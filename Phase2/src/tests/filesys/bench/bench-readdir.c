@@ -0,0 +1,73 @@
+/* Lists a directory of 200 files with their sizes twice, first
+   with readdir() and an open() of each entry, then in batches
+   with readdir_plus(), and reports the entry rate of each.  The
+   inodes outnumber the buffer cache, so each listing finds most
+   of them on disk.  Checks that readdir_plus() reports the right
+   type and size for every entry. */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define FILE_CNT 200
+
+void
+test_main (void) 
+{
+  struct dirent_plus entries[16];
+  char name[READDIR_MAX_LEN + 1], path[32];
+  int i, cnt, seen, dir_fd;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (mkdir ("d/sub"), "mkdir \"d/sub\"");
+  msg ("create %d files in \"d\"", FILE_CNT);
+  for (i = 0; i < FILE_CNT; i++) 
+    {
+      snprintf (path, sizeof path, "d/f%d", i);
+      if (!create (path, i * 3))
+        fail ("create \"%s\"", path);
+    }
+
+  CHECK ((dir_fd = open ("d")) > 1, "open \"d\"");
+  bench_start ();
+  for (seen = 0; readdir (dir_fd, name); seen++) 
+    {
+      int fd;
+
+      snprintf (path, sizeof path, "d/%s", name);
+      if ((fd = open (path)) < 2)
+        fail ("open \"%s\"", path);
+      filesize (fd);
+      close (fd);
+    }
+  bench_report ("readdir-open", seen, 0);
+  close (dir_fd);
+
+  CHECK ((dir_fd = open ("d")) > 1, "open \"d\"");
+  bench_start ();
+  seen = 0;
+  while ((cnt = readdir_plus (dir_fd, entries, 16)) > 0)
+    for (i = 0; i < cnt; i++, seen++) 
+      {
+        struct dirent_plus *e = &entries[i];
+
+        if (!strcmp (e->name, "sub"))
+          {
+            if (!e->is_dir)
+              fail ("\"sub\" is not a directory");
+          }
+        else if (e->name[0] != 'f' || e->is_dir
+                 || e->size != atoi (e->name + 1) * 3)
+          fail ("\"%s\" has the wrong size or type", e->name);
+      }
+  bench_report ("readdir-plus", seen, 0);
+  close (dir_fd);
+
+  if (seen != FILE_CNT + 1)
+    fail ("listed %d entries, expected %d", seen, FILE_CNT + 1);
+}
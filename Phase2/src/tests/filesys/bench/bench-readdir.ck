@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-readdir) begin
+(bench-readdir) mkdir "d"
+(bench-readdir) mkdir "d/sub"
+(bench-readdir) create 200 files in "d"
+(bench-readdir) open "d"
+(bench-readdir) open "d"
+(bench-readdir) end
+EOF
+pass;
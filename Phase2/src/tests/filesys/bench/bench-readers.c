@@ -0,0 +1,24 @@
+/* Starts several processes that all read the same file
+   sequentially at once, and reports their combined rate. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+#include "tests/filesys/bench/readers.h"
+
+void
+test_main (void) 
+{
+  pid_t children[READER_CNT];
+
+  msg ("fill \"%s\"", readers_file);
+  bench_fill (readers_file, READERS_FILE_SIZE);
+
+  bench_start ();
+  exec_children ("child-bench-read", children, READER_CNT);
+  wait_children (children, READER_CNT);
+  bench_report ("readers", READER_CNT * READER_PASSES
+                * (READERS_FILE_SIZE / BENCH_CHUNK),
+                READER_CNT * READER_PASSES * READERS_FILE_SIZE);
+}
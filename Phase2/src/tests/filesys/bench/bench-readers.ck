@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-readers) begin
+(bench-readers) fill "shared"
+(bench-readers) exec child 1 of 4: "child-bench-read 0"
+(bench-readers) exec child 2 of 4: "child-bench-read 1"
+(bench-readers) exec child 3 of 4: "child-bench-read 2"
+(bench-readers) exec child 4 of 4: "child-bench-read 3"
+(bench-readers) wait for child 1 of 4 returned 0 (expected 0)
+(bench-readers) wait for child 2 of 4 returned 1 (expected 1)
+(bench-readers) wait for child 3 of 4 returned 2 (expected 2)
+(bench-readers) wait for child 4 of 4 returned 3 (expected 3)
+(bench-readers) end
+EOF
+pass;
@@ -0,0 +1,27 @@
+/* Reads a large file sequentially, one chunk at a time, and
+   reports the rate. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+static char buf[BENCH_CHUNK];
+
+void
+test_main (void) 
+{
+  const char *file_name = "seq";
+  int fd, ofs;
+
+  msg ("fill \"%s\"", file_name);
+  bench_fill (file_name, BENCH_FILE_SIZE);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  bench_start ();
+  for (ofs = 0; ofs < BENCH_FILE_SIZE; ofs += BENCH_CHUNK)
+    if (read (fd, buf, BENCH_CHUNK) != BENCH_CHUNK)
+      fail ("read %d bytes at offset %d failed", BENCH_CHUNK, ofs);
+  bench_report ("seq-read", BENCH_FILE_SIZE / BENCH_CHUNK, BENCH_FILE_SIZE);
+  close (fd);
+}
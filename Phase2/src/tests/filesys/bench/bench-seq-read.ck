@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-seq-read) begin
+(bench-seq-read) fill "seq"
+(bench-seq-read) open "seq"
+(bench-seq-read) end
+EOF
+pass;
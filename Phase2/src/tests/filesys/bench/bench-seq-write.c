@@ -0,0 +1,28 @@
+/* Writes a large file sequentially, one chunk at a time, and
+   reports the rate. */
+
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+static char buf[BENCH_CHUNK];
+
+void
+test_main (void) 
+{
+  const char *file_name = "seq";
+  int fd, ofs;
+
+  random_bytes (buf, sizeof buf);
+  CHECK (create (file_name, 0), "create \"%s\"", file_name);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  bench_start ();
+  for (ofs = 0; ofs < BENCH_FILE_SIZE; ofs += BENCH_CHUNK)
+    if (write (fd, buf, BENCH_CHUNK) != BENCH_CHUNK)
+      fail ("write %d bytes at offset %d failed", BENCH_CHUNK, ofs);
+  close (fd);
+  bench_report ("seq-write", BENCH_FILE_SIZE / BENCH_CHUNK, BENCH_FILE_SIZE);
+}
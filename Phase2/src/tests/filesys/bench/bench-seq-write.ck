@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-seq-write) begin
+(bench-seq-write) create "seq"
+(bench-seq-write) open "seq"
+(bench-seq-write) end
+EOF
+pass;
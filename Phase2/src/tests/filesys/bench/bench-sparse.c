@@ -0,0 +1,61 @@
+/* Creates and removes files of several megabytes, more than the
+   file system disk holds, and reports how many go through the
+   cycle per tick.  A file's sectors must be allocated only as
+   they are written.  Then checks that one such file reads back
+   as zeros, except for a chunk written in the middle of it. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/filesys/bench/bench.h"
+
+#define ROUNDS 20                       /* Files created. */
+#define FILE_SIZE (8 * 1024 * 1024)     /* Size of each. */
+
+static char buf[BENCH_CHUNK];
+static char zeros[BENCH_CHUNK];
+
+void
+test_main (void) 
+{
+  char name[16];
+  int round, fd;
+
+  msg ("create and remove %d sparse files", ROUNDS);
+  bench_start ();
+  for (round = 0; round < ROUNDS; round++) 
+    {
+      snprintf (name, sizeof name, "sparse%d", round);
+      if (!create (name, FILE_SIZE))
+        fail ("create \"%s\"", name);
+      if (!remove (name))
+        fail ("remove \"%s\"", name);
+    }
+  bench_report ("sparse-create", ROUNDS, 0);
+
+  CHECK (create ("sparse", FILE_SIZE), "create \"sparse\"");
+  CHECK ((fd = open ("sparse")) > 1, "open \"sparse\"");
+  CHECK (filesize (fd) == FILE_SIZE, "filesize \"sparse\"");
+
+  memset (buf, 'x', sizeof buf);
+  seek (fd, FILE_SIZE / 2);
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf,
+         "write in the middle of \"sparse\"");
+
+  msg ("read back \"sparse\"");
+  seek (fd, 0);
+  if (read (fd, buf, sizeof buf) != sizeof buf
+      || memcmp (buf, zeros, sizeof buf))
+    fail ("start of \"sparse\" is not zeros");
+  seek (fd, FILE_SIZE - sizeof buf);
+  if (read (fd, buf, sizeof buf) != sizeof buf
+      || memcmp (buf, zeros, sizeof buf))
+    fail ("end of \"sparse\" is not zeros");
+  seek (fd, FILE_SIZE / 2);
+  if (read (fd, buf, sizeof buf) != sizeof buf
+      || buf[0] != 'x' || buf[sizeof buf - 1] != 'x')
+    fail ("middle of \"sparse\" did not read back");
+  close (fd);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-sparse) begin
+(bench-sparse) create and remove 20 sparse files
+(bench-sparse) create "sparse"
+(bench-sparse) open "sparse"
+(bench-sparse) filesize "sparse"
+(bench-sparse) write in the middle of "sparse"
+(bench-sparse) read back "sparse"
+(bench-sparse) end
+EOF
+pass;
@@ -0,0 +1,60 @@
+/* Timing and reporting shared by the file system benchmarks.
+
+   Each benchmark times its measured phase in timer ticks with
+   uptime() and reports it on a line of the form
+     (TEST) bench: NAME: OPS ops, BYTES bytes, TICKS ticks, ...
+   followed by the rates.  The checker passes IGNORE_BENCH, so
+   these lines do not have to match exactly; check_bench() in
+   tests/tests.pm instead computes the rates and compares them
+   with the bounds in tests/filesys/bench/thresholds. */
+
+#include "tests/filesys/bench/bench.h"
+#include <random.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+static int start;
+static char chunk[BENCH_CHUNK];
+
+/* Starts timing a measured phase. */
+void
+bench_start (void) 
+{
+  start = uptime ();
+}
+
+/* Reports that the phase started by bench_start() did OPS
+   operations moving BYTES bytes.  A phase that took less than a
+   tick is counted as one tick. */
+void
+bench_report (const char *name, int ops, int bytes) 
+{
+  int ticks = uptime () - start;
+  int divisor = ticks > 0 ? ticks : 1;
+
+  msg ("bench: %s: %d ops, %d bytes, %d ticks, %d ops/tick, %d bytes/tick",
+       name, ops, bytes, ticks, ops / divisor, bytes / divisor);
+}
+
+/* Creates FILE_NAME holding SIZE bytes of pseudo-random data,
+   without timing it. */
+void
+bench_fill (const char *file_name, int size) 
+{
+  int fd;
+  int ofs;
+
+  if (!create (file_name, 0))
+    fail ("create \"%s\"", file_name);
+  if ((fd = open (file_name)) < 2)
+    fail ("open \"%s\"", file_name);
+  random_init (0);
+  for (ofs = 0; ofs < size; ofs += BENCH_CHUNK) 
+    {
+      int n = size - ofs < BENCH_CHUNK ? size - ofs : BENCH_CHUNK;
+      random_bytes (chunk, n);
+      if (write (fd, chunk, n) != n)
+        fail ("write %d bytes at offset %d in \"%s\"", n, ofs, file_name);
+    }
+  close (fd);
+}
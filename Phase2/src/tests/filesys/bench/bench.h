@@ -0,0 +1,13 @@
+#ifndef TESTS_FILESYS_BENCH_BENCH_H
+#define TESTS_FILESYS_BENCH_BENCH_H
+
+/* Size of the files the benchmarks read and write, and of the
+   chunks they use for sequential I/O. */
+#define BENCH_FILE_SIZE (256 * 1024)
+#define BENCH_CHUNK 4096
+
+void bench_start (void);
+void bench_report (const char *name, int ops, int bytes);
+void bench_fill (const char *file_name, int size);
+
+#endif /* tests/filesys/bench/bench.h */
@@ -0,0 +1,34 @@
+/* Child process for bench-readers.
+   Reads the shared file from start to end READER_PASSES times,
+   one chunk at a time. */
+
+#include <stdlib.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/filesys/bench/bench.h"
+#include "tests/filesys/bench/readers.h"
+
+static char buf[BENCH_CHUNK];
+
+int
+main (int argc, const char *argv[]) 
+{
+  int pass, ofs;
+  int fd;
+
+  test_name = "child-bench-read";
+  quiet = true;
+
+  CHECK (argc == 2, "argc must be 2, actually %d", argc);
+  CHECK ((fd = open (readers_file)) > 1, "open \"%s\"", readers_file);
+  for (pass = 0; pass < READER_PASSES; pass++) 
+    {
+      seek (fd, 0);
+      for (ofs = 0; ofs < READERS_FILE_SIZE; ofs += BENCH_CHUNK)
+        if (read (fd, buf, BENCH_CHUNK) != BENCH_CHUNK)
+          fail ("read %d bytes at offset %d", BENCH_CHUNK, ofs);
+    }
+  close (fd);
+
+  return atoi (argv[1]);
+}
@@ -0,0 +1,9 @@
+#ifndef TESTS_FILESYS_BENCH_READERS_H
+#define TESTS_FILESYS_BENCH_READERS_H
+
+#define READER_CNT 4                    /* Reader processes. */
+#define READER_PASSES 4                 /* Times each reads the file. */
+#define READERS_FILE_SIZE (64 * 1024)   /* Size of the file. */
+static const char readers_file[] = "shared";
+
+#endif /* tests/filesys/bench/readers.h */
@@ -0,0 +1,177 @@
+/* Test program for lib/kernel/radix.c.
+
+   Fills radix trees with dense and sparse sets of keys, then
+   checks lookup, gang lookup, and deletion against a sorted
+   array of the same keys.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <radix.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of keys in a tree that we will test. */
+#define MAX_SIZE 256
+
+static void make_keys (uint32_t keys[], size_t cnt, int pattern);
+static void sort_keys (uint32_t keys[], size_t cnt);
+static void verify_tree (struct radix_tree *, const uint32_t keys[],
+                         const bool present[], size_t cnt);
+
+/* Test the radix tree implementation. */
+void
+test (void) 
+{
+  int pattern;
+
+  printf ("testing radix trees:");
+  for (pattern = 0; pattern < 3; pattern++) 
+    {
+      size_t size;
+
+      printf (" %d", pattern);
+      for (size = 0; size <= MAX_SIZE; size += size < 16 ? 1 : 40) 
+        {
+          static uint32_t keys[MAX_SIZE];
+          static bool present[MAX_SIZE];
+          struct radix_tree tree;
+          size_t i;
+
+          make_keys (keys, size, pattern);
+          sort_keys (keys, size);
+
+          /* Insert in random order.  Each item is the address of
+             its key, so it is never null. */
+          radix_init (&tree);
+          for (i = 0; i < size; i++)
+            present[i] = false;
+          for (i = 0; i < size; i++) 
+            {
+              size_t j = random_ulong () % size;
+              while (present[j])
+                j = (j + 1) % size;
+              ASSERT (radix_insert (&tree, keys[j], &keys[j]));
+              ASSERT (!radix_insert (&tree, keys[j], &keys[j]));
+              present[j] = true;
+            }
+          verify_tree (&tree, keys, present, size);
+
+          /* Delete every other key and check again. */
+          for (i = 0; i < size; i += 2) 
+            {
+              ASSERT (radix_delete (&tree, keys[i]) == &keys[i]);
+              ASSERT (radix_delete (&tree, keys[i]) == NULL);
+              present[i] = false;
+            }
+          verify_tree (&tree, keys, present, size);
+
+          /* Put them back. */
+          for (i = 0; i < size; i += 2) 
+            {
+              ASSERT (radix_insert (&tree, keys[i], &keys[i]));
+              present[i] = true;
+            }
+          verify_tree (&tree, keys, present, size);
+
+          radix_destroy (&tree);
+          ASSERT (radix_size (&tree) == 0);
+          ASSERT (radix_lookup (&tree, size > 0 ? keys[0] : 0) == NULL);
+        }
+    }
+
+  printf (" done\n");
+  printf ("radix: PASS\n");
+}
+
+/* Stores CNT distinct keys into KEYS: consecutive small keys for
+   PATTERN 0, keys spread over the whole 32-bit range for PATTERN
+   1, and short runs of consecutive keys at random places for
+   PATTERN 2. */
+static void
+make_keys (uint32_t keys[], size_t cnt, int pattern) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (pattern == 0)
+      keys[i] = i;
+    else if (pattern == 1)
+      keys[i] = i * 0x9e3779b1u;        /* Odd, so distinct. */
+    else
+      keys[i] = (i / 8) * 0x9e3779b1u + i % 8;
+  if (pattern == 1 && cnt > 1)
+    keys[1] = UINT32_MAX;
+}
+
+/* Sorts the CNT keys in KEYS into ascending order. */
+static void
+sort_keys (uint32_t keys[], size_t cnt) 
+{
+  size_t i, j;
+
+  for (i = 1; i < cnt; i++) 
+    {
+      uint32_t key = keys[i];
+      for (j = i; j > 0 && keys[j - 1] > key; j--)
+        keys[j] = keys[j - 1];
+      keys[j] = key;
+    }
+}
+
+/* Verifies that TREE holds exactly the keys[I] for which
+   PRESENT[I] is true, CNT in all, by single lookups and by gang
+   lookups in batches of various sizes. */
+static void
+verify_tree (struct radix_tree *tree, const uint32_t keys[],
+             const bool present[], size_t cnt) 
+{
+  static void *items[MAX_SIZE];
+  static uint32_t found_keys[MAX_SIZE];
+  size_t present_cnt = 0;
+  size_t batch;
+  size_t i;
+
+  for (i = 0; i < cnt; i++) 
+    {
+      ASSERT (radix_lookup (tree, keys[i])
+              == (present[i] ? &keys[i] : NULL));
+      if (keys[i] + 1 != 0 && (i + 1 == cnt || keys[i + 1] != keys[i] + 1))
+        ASSERT (radix_lookup (tree, keys[i] + 1) == NULL);
+      present_cnt += present[i];
+    }
+  ASSERT (radix_size (tree) == present_cnt);
+
+  for (batch = 1; batch <= MAX_SIZE; batch *= 4) 
+    {
+      uint32_t next_key = 0;
+      size_t next = 0;
+      size_t n;
+
+      do 
+        {
+          size_t j;
+
+          n = radix_gang_lookup (tree, next_key, items, found_keys, batch);
+          ASSERT (n <= batch);
+          for (j = 0; j < n; j++) 
+            {
+              while (!present[next])
+                next++;
+              ASSERT (found_keys[j] == keys[next]);
+              ASSERT (items[j] == &keys[next]);
+              next++;
+            }
+          if (n > 0)
+            next_key = found_keys[n - 1] + 1;
+        }
+      while (n == batch && next_key != 0);
+      while (next < cnt && !present[next])
+        next++;
+      ASSERT (next == cnt);
+    }
+}
@@ -0,0 +1,226 @@
+/* Test program for lib/kernel/rbtree.c.
+
+   Inserts and removes values in random order, checking the
+   red-black rules, ordered traversal, search, and the cached
+   minimum and maximum after every step.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <rbtree.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Maximum number of elements in a tree that we will test. */
+#define MAX_SIZE 64
+
+/* A tree element. */
+struct value 
+  {
+    struct rb_node node;        /* Tree node. */
+    int value;                  /* Item value. */
+  };
+
+static void shuffle (struct value *[], size_t);
+static bool value_less (const struct rb_node *, const struct rb_node *,
+                        void *);
+static int verify_subtree (const struct rb_node *);
+static void verify_tree (struct rb_tree *, int size, int step);
+
+/* Test the red-black tree implementation. */
+void
+test (void) 
+{
+  int size;
+
+  printf ("testing various size trees:");
+  for (size = 0; size < MAX_SIZE; size++) 
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++) 
+        {
+          static struct value values[MAX_SIZE * 2];
+          struct value *order[MAX_SIZE];
+          struct rb_tree tree;
+          struct rb_node *n;
+          struct value key;
+          int i;
+
+          /* Insert values 0, 2, ..., 2 * (SIZE - 1) in random
+             order, verifying after each insertion. */
+          for (i = 0; i < size; i++)
+            {
+              values[i].value = i * 2;
+              order[i] = &values[i];
+            }
+          shuffle (order, size);
+          rb_init (&tree, value_less, NULL);
+          for (i = 0; i < size; i++)
+            {
+              rb_insert (&tree, &order[i]->node);
+              ASSERT (rb_size (&tree) == (size_t) i + 1);
+              verify_subtree (tree.root);
+            }
+          verify_tree (&tree, size, 2);
+
+          /* Search for each value and for the odd numbers
+             between them. */
+          for (i = -1; i <= size * 2; i++) 
+            {
+              key.value = i;
+              n = rb_find (&tree, &key.node);
+              ASSERT (i >= 0 && i < size * 2 && i % 2 == 0
+                      ? rb_entry (n, struct value, node)->value == i
+                      : n == NULL);
+
+              n = rb_lower_bound (&tree, &key.node);
+              if (i < (size - 1) * 2 + 1)
+                ASSERT (rb_entry (n, struct value, node)->value
+                        == (i <= 0 ? 0 : (i + 1) / 2 * 2));
+              else
+                ASSERT (n == NULL);
+
+              n = rb_upper_bound (&tree, &key.node);
+              if (i < (size - 1) * 2)
+                ASSERT (rb_entry (n, struct value, node)->value
+                        == (i < 0 ? 0 : i / 2 * 2 + 2));
+              else
+                ASSERT (n == NULL);
+            }
+
+          /* Add a duplicate of each value, which must come after
+             the original. */
+          for (i = 0; i < size; i++) 
+            {
+              values[size + i].value = values[i].value;
+              rb_insert (&tree, &values[size + i].node);
+            }
+          verify_subtree (tree.root);
+          for (i = 0; i < size; i++) 
+            {
+              n = rb_next (&values[i].node);
+              ASSERT (n == &values[size + i].node);
+              ASSERT (rb_find (&tree, &values[size + i].node)
+                      == &values[i].node);
+            }
+          for (i = 0; i < size; i++)
+            rb_remove (&tree, &values[size + i].node);
+          verify_tree (&tree, size, 2);
+
+          /* Remove the values in random order, verifying after
+             each removal. */
+          shuffle (order, size);
+          for (i = 0; i < size; i++) 
+            {
+              rb_remove (&tree, &order[i]->node);
+              ASSERT (rb_size (&tree) == (size_t) (size - i - 1));
+              verify_subtree (tree.root);
+            }
+          ASSERT (rb_empty (&tree));
+          ASSERT (rb_min (&tree) == NULL && rb_max (&tree) == NULL);
+
+          /* Drain a refilled tree from both ends. */
+          for (i = 0; i < size; i++)
+            rb_insert (&tree, &order[i]->node);
+          for (i = 0; i < size; i++) 
+            {
+              struct value *v;
+              if (i % 2 == 0)
+                {
+                  v = rb_entry (rb_pop_min (&tree), struct value, node);
+                  ASSERT (v->value == i / 2 * 2);
+                }
+              else
+                {
+                  v = rb_entry (rb_pop_max (&tree), struct value, node);
+                  ASSERT (v->value == (size - 1 - i / 2) * 2);
+                }
+              verify_subtree (tree.root);
+            }
+          ASSERT (rb_pop_min (&tree) == NULL);
+        }
+    }
+  
+  printf (" done\n");
+  printf ("rbtree: PASS\n");
+}
+
+/* Shuffles the CNT elements in ARRAY into random order.  Moves
+   pointers rather than values, which may be in a tree. */
+static void
+shuffle (struct value **array, size_t cnt) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j = i + random_ulong () % (cnt - i);
+      struct value *t = array[j];
+      array[j] = array[i];
+      array[i] = t;
+    }
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct rb_node *a_, const struct rb_node *b_,
+            void *aux UNUSED) 
+{
+  const struct value *a = rb_entry (a_, struct value, node);
+  const struct value *b = rb_entry (b_, struct value, node);
+  
+  return a->value < b->value;
+}
+
+/* Verifies the parent links and red-black coloring of the
+   subtree rooted at N and returns its black height. */
+static int
+verify_subtree (const struct rb_node *n) 
+{
+  int left_height, right_height;
+
+  if (n == NULL)
+    return 1;
+  if (n->parent == NULL)
+    ASSERT (!n->red);
+  if (n->left != NULL)
+    ASSERT (n->left->parent == n && !(n->red && n->left->red));
+  if (n->right != NULL)
+    ASSERT (n->right->parent == n && !(n->red && n->right->red));
+
+  left_height = verify_subtree (n->left);
+  right_height = verify_subtree (n->right);
+  ASSERT (left_height == right_height);
+  return left_height + !n->red;
+}
+
+/* Verifies that TREE contains the values 0, STEP, ..., (SIZE -
+   1) * STEP when traversed in either direction, and that its
+   cached minimum and maximum are right. */
+static void
+verify_tree (struct rb_tree *tree, int size, int step) 
+{
+  struct rb_node *n;
+  int i;
+
+  verify_subtree (tree->root);
+  ASSERT (rb_size (tree) == (size_t) size);
+  ASSERT (rb_empty (tree) == (size == 0));
+
+  for (i = 0, n = rb_min (tree); i < size && n != NULL;
+       i++, n = rb_next (n))
+    ASSERT (rb_entry (n, struct value, node)->value == i * step);
+  ASSERT (i == size && n == NULL);
+
+  for (i = size - 1, n = rb_max (tree); i >= 0 && n != NULL;
+       i--, n = rb_prev (n))
+    ASSERT (rb_entry (n, struct value, node)->value == i * step);
+  ASSERT (i == -1 && n == NULL);
+}
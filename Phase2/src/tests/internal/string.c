@@ -0,0 +1,197 @@
+/* Test program for the block functions in lib/string.c.
+
+   Checks memcpy(), memmove(), memset() and memcmp() against
+   byte-at-a-time references at every alignment and a range of
+   sizes, then prints the cycles each takes per call for blocks of
+   16 bytes to 4 kB, page-aligned, as a benchmark.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/test.h"
+
+/* Largest block checked, and the benchmark's limits. */
+#define MAX_SIZE 4096
+#define BENCH_MIN 16
+#define BENCH_REPEAT 64
+
+static uint8_t buf_a[MAX_SIZE * 2] __attribute__ ((aligned (4096)));
+static uint8_t buf_b[MAX_SIZE * 2] __attribute__ ((aligned (4096)));
+static uint8_t expect[MAX_SIZE * 2];
+
+/* Keeps the benchmarked memcmp() calls from being optimized out. */
+static volatile int cmp_sink;
+
+static void fill_random (uint8_t *, size_t);
+static void check_copy (size_t dst_ofs, size_t src_ofs, size_t size);
+static void check_move (size_t dst_ofs, size_t src_ofs, size_t size);
+static void check_set (size_t ofs, size_t size);
+static void check_cmp (size_t ofs, size_t size);
+static void bench (void);
+
+/* Sizes checked at every alignment. */
+static const size_t sizes[] =
+  {0, 1, 3, 4, 15, 16, 17, 31, 63, 64, 100, 255, 1000, 4095, 4096};
+
+void
+test (void) 
+{
+  size_t i, a, b;
+
+  printf ("testing string functions:");
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      printf (" %zu", sizes[i]);
+      for (a = 0; a < 4; a++)
+        {
+          check_set (a, sizes[i]);
+          check_cmp (a, sizes[i]);
+          for (b = 0; b < 4; b++)
+            {
+              check_copy (a, b, sizes[i]);
+              check_move (a, b, sizes[i]);
+            }
+        }
+    }
+  printf (" done\n");
+
+  bench ();
+  printf ("string: PASS\n");
+}
+
+/* Fills the SIZE bytes at P with random data. */
+static void
+fill_random (uint8_t *p, size_t size) 
+{
+  random_bytes (p, size);
+}
+
+static void
+check_copy (size_t dst_ofs, size_t src_ofs, size_t size) 
+{
+  size_t i;
+
+  fill_random (buf_a, sizeof buf_a);
+  fill_random (buf_b, sizeof buf_b);
+  for (i = 0; i < sizeof buf_b; i++)
+    expect[i] = buf_b[i];
+  for (i = 0; i < size; i++)
+    expect[dst_ofs + i] = buf_a[src_ofs + i];
+
+  ASSERT (memcpy (buf_b + dst_ofs, buf_a + src_ofs, size) == buf_b + dst_ofs);
+  for (i = 0; i < sizeof buf_b; i++)
+    ASSERT (buf_b[i] == expect[i]);
+}
+
+/* Moves within one buffer, so that the blocks overlap whenever
+   SIZE exceeds the distance between them. */
+static void
+check_move (size_t dst_ofs, size_t src_ofs, size_t size) 
+{
+  size_t i;
+
+  fill_random (buf_a, sizeof buf_a);
+  for (i = 0; i < sizeof buf_a; i++)
+    expect[i] = buf_a[i];
+  for (i = 0; i < size; i++)
+    expect[dst_ofs * 3 + i] = buf_a[src_ofs * 5 + i];
+
+  ASSERT (memmove (buf_a + dst_ofs * 3, buf_a + src_ofs * 5, size)
+          == buf_a + dst_ofs * 3);
+  for (i = 0; i < sizeof buf_a; i++)
+    ASSERT (buf_a[i] == expect[i]);
+}
+
+static void
+check_set (size_t ofs, size_t size) 
+{
+  int value = random_ulong () & 0xff;
+  size_t i;
+
+  fill_random (buf_a, sizeof buf_a);
+  for (i = 0; i < sizeof buf_a; i++)
+    expect[i] = buf_a[i];
+  for (i = 0; i < size; i++)
+    expect[ofs + i] = value;
+
+  ASSERT (memset (buf_a + ofs, value, size) == buf_a + ofs);
+  for (i = 0; i < sizeof buf_a; i++)
+    ASSERT (buf_a[i] == expect[i]);
+}
+
+/* Compares equal blocks, then blocks that differ in one random
+   byte, one way round and the other. */
+static void
+check_cmp (size_t ofs, size_t size) 
+{
+  size_t diff;
+
+  fill_random (buf_a, sizeof buf_a);
+  memcpy (buf_b + 1, buf_a + ofs, size);
+  ASSERT (memcmp (buf_a + ofs, buf_b + 1, size) == 0);
+  if (size == 0)
+    return;
+
+  diff = random_ulong () % size;
+  buf_a[ofs + diff] = 1;
+  buf_b[1 + diff] = 2;
+  ASSERT (memcmp (buf_a + ofs, buf_b + 1, size) < 0);
+  ASSERT (memcmp (buf_b + 1, buf_a + ofs, size) > 0);
+}
+
+/* Returns the time-stamp counter. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Prints the average cycles per call of each function, for
+   page-aligned blocks of each power of 2 from BENCH_MIN to
+   MAX_SIZE bytes. */
+static void
+bench (void) 
+{
+  size_t size;
+
+  printf ("cycles per call:  size  memcpy memmove  memset  memcmp\n");
+  for (size = BENCH_MIN; size <= MAX_SIZE; size *= 2)
+    {
+      uint64_t start, cycles[4];
+      int i;
+
+      start = rdtsc ();
+      for (i = 0; i < BENCH_REPEAT; i++)
+        memcpy (buf_b, buf_a, size);
+      cycles[0] = rdtsc () - start;
+
+      start = rdtsc ();
+      for (i = 0; i < BENCH_REPEAT; i++)
+        memmove (buf_a + 4, buf_a, size);
+      cycles[1] = rdtsc () - start;
+
+      start = rdtsc ();
+      for (i = 0; i < BENCH_REPEAT; i++)
+        memset (buf_a, 0, size);
+      cycles[2] = rdtsc () - start;
+
+      memcpy (buf_b, buf_a, size);
+      start = rdtsc ();
+      for (i = 0; i < BENCH_REPEAT; i++)
+        cmp_sink += memcmp (buf_a, buf_b, size);
+      cycles[3] = rdtsc () - start;
+
+      printf ("%23zu %7llu %7llu %7llu %7llu\n", size,
+              cycles[0] / BENCH_REPEAT, cycles[1] / BENCH_REPEAT,
+              cycles[2] / BENCH_REPEAT, cycles[3] / BENCH_REPEAT);
+    }
+}
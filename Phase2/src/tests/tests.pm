@@ -166,6 +166,18 @@ sub compare_output {
 	delete $options{IGNORE_EXIT_CODES};
 	@output = grep (!/^[a-zA-Z0-9-_]+: exit\(\-?\d+\)$/, @output);
     }
+    my $ignore_bench = exists $options{IGNORE_BENCH};
+    if ($ignore_bench) {
+	delete $options{IGNORE_BENCH};
+	my ($in_stats) = 0;
+	@output = grep {
+	    my ($keep) = !$in_stats && !/^\([^)]+\) bench: /
+	      && $_ ne 'stats: begin';
+	    $in_stats = 1 if $_ eq 'stats: begin';
+	    $in_stats = 0 if $_ eq 'stats: end';
+	    $keep;
+	} @output;
+    }
     my $ignore_user_faults = exists $options{IGNORE_USER_FAULTS};
     if ($ignore_user_faults) {
 	delete $options{IGNORE_USER_FAULTS};
@@ -224,9 +236,76 @@ sub compare_output {
       if $ignore_exit_codes;
     $msg .= "\n(User fault messages are excluded for matching purposes.)\n"
       if $ignore_user_faults;
+    $msg .= "\n(Benchmark results are excluded for matching purposes.)\n"
+      if $ignore_bench;
     fail "Test output failed to match any acceptable form.\n\n$msg";
 }
 
+# Benchmarks.
+
+# check_bench ($EXPECTED)
+#
+# Like check_expected, but ignores the "bench:" lines a benchmark
+# prints and instead checks the rates they report, and the block
+# device read and write counts printed at power off, against the
+# bounds for $test in the "thresholds" file next to the .ck script.
+# Each line of that file has the form
+#
+#	TEST METRIC OP VALUE
+#
+# where METRIC is NAME:ops/tick or NAME:bytes/tick for a "bench:
+# NAME:" line, or TYPE:reads or TYPE:writes for a block device of
+# type TYPE (e.g. "filesys"), or the key of a counter in the
+# "stats: begin" ... "stats: end" block printed by the stats()
+# system call (e.g. "fault.major.count"), and OP is "<=" or ">=".
+# A block of stats is ignored when matching, like "bench:" lines;
+# if there are several, the last one wins.
+sub check_bench {
+    my ($expected) = @_;
+    my (@output) = read_text_file ("$test.output");
+    common_checks ("run", @output);
+    compare_output ("run", IGNORE_BENCH => 1, IGNORE_EXIT_CODES => 1,
+		    \@output, $expected);
+
+    my (%metrics);
+    for (@output) {
+	if (my ($name, $ops, $bytes, $ticks)
+	    = /^\([^)]+\) bench: (\S+): (\d+) ops, (\d+) bytes, (\d+) ticks/) {
+	    $ticks = 1 if $ticks == 0;
+	    $metrics{"$name:ops/tick"} = $ops / $ticks;
+	    $metrics{"$name:bytes/tick"} = $bytes / $ticks;
+	} elsif (my ($type, $reads, $writes)
+		 = /^\S+ \((\S+)\): (\d+) reads, (\d+) writes$/) {
+	    $metrics{"$type:reads"} = $reads;
+	    $metrics{"$type:writes"} = $writes;
+	} elsif (my ($key, $value) = /^([\w.-]+)=(\d+)$/) {
+	    $metrics{$key} = $value;
+	}
+    }
+
+    my ($dir) = $0 =~ m%^(.*)/[^/]+$% ? $1 : '.';
+    my ($name) = $test =~ m%([^/]+)$%;
+    my (@failures);
+    for (read_text_file ("$dir/thresholds")) {
+	s/#.*//;
+	next if /^\s*$/;
+	my ($bench, $metric, $op, $value) = split;
+	next if $bench ne $name;
+	die "$dir/thresholds: bad operator \"$op\"\n"
+	  if $op ne '<=' && $op ne '>=';
+	if (!exists $metrics{$metric}) {
+	    push (@failures, "$metric: not reported\n");
+	    next;
+	}
+	my ($actual) = $metrics{$metric};
+	push (@failures, sprintf ("%s: %.1f, expected %s %s\n",
+				  $metric, $actual, $op, $value))
+	  if $op eq '<=' ? $actual > $value : $actual < $value;
+    }
+    fail "Benchmark results out of bounds:\n\n" . join ('', @failures)
+      if @failures;
+}
+
 # File system extraction.
 
 # check_archive (\%CONTENTS)
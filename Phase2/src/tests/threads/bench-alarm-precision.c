@@ -0,0 +1,90 @@
+/* Measures timer_sleep() wake-up precision with many sleepers:
+   SLEEPER_CNT threads each sleep until one of SPAN consecutive
+   target ticks, so that about SLEEPER_CNT / SPAN threads are due
+   on each tick.  Reports how many ticks late the sleepers woke
+   up, and how many cycles passed between the first and the last
+   sleeper due on the same tick getting to run. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 1000
+#define SPAN 100
+
+static int64_t base;                    /* Tick before the first target. */
+static int64_t late_total;              /* Sum of ticks late. */
+static int64_t late_max;                /* Most ticks late. */
+static uint64_t first_tsc[SPAN];        /* Earliest wake-up per target. */
+static uint64_t last_tsc[SPAN];         /* Latest wake-up per target. */
+static struct semaphore done;
+
+static thread_func sleeper_thread;
+
+void
+test_bench_alarm_precision (void) 
+{
+  uint64_t spread_max = 0;
+  int i;
+
+  sema_init (&done, 0);
+  late_total = late_max = 0;
+  for (i = 0; i < SPAN; i++)
+    first_tsc[i] = last_tsc[i] = 0;
+
+  /* Leave enough time to create all the sleepers before the first
+     is due. */
+  base = timer_ticks () + 50;
+
+  msg ("Creating %d sleepers.", SLEEPER_CNT);
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT, sleeper_thread,
+                         (void *) i) == TID_ERROR)
+        fail ("thread_create failed after %d threads", i);
+    }
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+
+  for (i = 0; i < SPAN; i++)
+    if (last_tsc[i] - first_tsc[i] > spread_max)
+      spread_max = last_tsc[i] - first_tsc[i];
+  bench ("%d sleepers, %"PRId64".%03"PRId64" ticks late on average, "
+         "%"PRId64" ticks late at most, %"PRIu64" cycles most spread",
+         SLEEPER_CNT, late_total / SLEEPER_CNT,
+         late_total * 1000 / SLEEPER_CNT % 1000, late_max, spread_max);
+  msg ("All sleepers woke up.");
+}
+
+static void
+sleeper_thread (void *slot_) 
+{
+  int slot = (int) slot_ % SPAN;
+  int64_t target = base + slot;
+  int64_t late;
+  uint64_t now;
+  enum intr_level old_level;
+
+  timer_sleep (target - timer_ticks ());
+  now = rdtsc ();
+  late = timer_ticks () - target;
+
+  old_level = intr_disable ();
+  late_total += late;
+  if (late > late_max)
+    late_max = late;
+  if (first_tsc[slot] == 0 || now < first_tsc[slot])
+    first_tsc[slot] = now;
+  if (now > last_tsc[slot])
+    last_tsc[slot] = now;
+  intr_set_level (old_level);
+
+  sema_up (&done);
+}
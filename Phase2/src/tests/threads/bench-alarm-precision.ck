@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-alarm-precision) begin
+(bench-alarm-precision) Creating 1000 sleepers.
+(bench-alarm-precision) All sleepers woke up.
+(bench-alarm-precision) end
+EOF
+pass;
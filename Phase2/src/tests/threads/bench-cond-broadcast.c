@@ -0,0 +1,85 @@
+/* Measures cond_broadcast() wake-up cost: WAITER_CNT threads wait
+   on one condition variable, and the main thread broadcasts to
+   them ROUND_CNT times, each time waiting until every waiter has
+   woken up and seen the broadcast before starting the next. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+#include "devices/timer.h"
+
+#define WAITER_CNT 32
+#define ROUND_CNT 200
+
+static struct lock lock;
+static struct condition cond;
+static int round;               /* Broadcasts so far. */
+static int woken_cnt;           /* Waiters that saw this round. */
+static struct semaphore all_woken;
+
+static thread_func waiter_thread;
+
+void
+test_bench_cond_broadcast (void) 
+{
+  int64_t start_ticks, ticks;
+  uint64_t start_tsc, cycles;
+  int i;
+
+  lock_init (&lock);
+  cond_init (&cond);
+  sema_init (&all_woken, 0);
+  round = 0;
+
+  for (i = 0; i < WAITER_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "waiter %d", i);
+      thread_create (name, PRI_DEFAULT, waiter_thread, NULL);
+    }
+
+  /* Let the waiters start waiting. */
+  timer_sleep (10);
+
+  msg ("Broadcasting to %d waiters %d times.", WAITER_CNT, ROUND_CNT);
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      lock_acquire (&lock);
+      woken_cnt = 0;
+      round++;
+      cond_broadcast (&cond, &lock);
+      lock_release (&lock);
+      sema_down (&all_woken);
+    }
+  cycles = rdtsc () - start_tsc;
+  ticks = timer_elapsed (start_ticks);
+
+  bench ("%d broadcasts to %d waiters, %"PRId64" ticks, "
+         "%"PRIu64" cycles, %"PRIu64" cycles/broadcast, "
+         "%"PRIu64" cycles/wakeup",
+         ROUND_CNT, WAITER_CNT, ticks, cycles, cycles / ROUND_CNT,
+         cycles / (ROUND_CNT * WAITER_CNT));
+  msg ("All waiters woke up every time.");
+}
+
+static void
+waiter_thread (void *aux UNUSED) 
+{
+  int seen = 0;
+
+  lock_acquire (&lock);
+  while (seen < ROUND_CNT) 
+    {
+      while (round == seen)
+        cond_wait (&cond, &lock);
+      seen = round;
+      if (++woken_cnt == WAITER_CNT)
+        sema_up (&all_woken);
+    }
+  lock_release (&lock);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-cond-broadcast) begin
+(bench-cond-broadcast) Broadcasting to 32 waiters 200 times.
+(bench-cond-broadcast) All waiters woke up every time.
+(bench-cond-broadcast) end
+EOF
+pass;
@@ -0,0 +1,171 @@
+/* Measures how many deadlines a set of periodic tasks misses
+   while a CPU-bound thread competes with them, first with the
+   tasks in the ordinary round-robin class and then with each in
+   the earliest-deadline-first class with a budget that covers its
+   work.  The tasks ask for 80% of the CPU between them, so, under
+   EDF, none should miss.  Also checks that admission control
+   turns away a task that would take the class past its share. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define TASK_CNT 3
+#define RUN_TICKS 400
+
+/* A periodic task. */
+struct task
+  {
+    int64_t period;             /* Ticks between releases. */
+    int64_t budget;             /* EDF budget per period. */
+    int64_t work;               /* CPU ticks each job needs. */
+    bool edf;                   /* Run in the EDF class? */
+    int jobs;                   /* Jobs run. */
+    int misses;                 /* Jobs that finished late. */
+    struct semaphore *admitted; /* Upped once it is scheduled. */
+    struct semaphore *done;     /* Upped when it finishes. */
+  };
+
+static volatile bool hog_stop;
+static thread_func hog_thread;
+static thread_func task_thread;
+
+static void run_tasks (bool edf, int *jobs, int *misses);
+
+void
+test_bench_edf_deadline (void) 
+{
+  struct semaphore hog_done;
+  int jobs, misses;
+
+  sema_init (&hog_done, 0);
+  hog_stop = false;
+  thread_create ("hog", PRI_DEFAULT, hog_thread, &hog_done);
+
+  msg ("Running tasks round robin.");
+  run_tasks (false, &jobs, &misses);
+  bench ("round robin: %d of %d jobs missed their deadline", misses, jobs);
+
+  msg ("Running tasks earliest deadline first.");
+  run_tasks (true, &jobs, &misses);
+  bench ("EDF: %d of %d jobs missed their deadline", misses, jobs);
+
+  hog_stop = true;
+  sema_down (&hog_done);
+  msg ("Done.");
+}
+
+/* Runs the task set for RUN_TICKS, in the EDF class if EDF, and
+   sums its jobs and misses into *JOBS and *MISSES. */
+static void
+run_tasks (bool edf, int *jobs, int *misses) 
+{
+  static const int64_t params[TASK_CNT][3] =
+    {
+      /* Period, budget, work. */
+      {10, 3, 2},
+      {20, 5, 4},
+      {40, 10, 8},
+    };
+  struct task tasks[TASK_CNT];
+  struct semaphore admitted, done;
+  int i;
+
+  sema_init (&admitted, 0);
+  sema_init (&done, 0);
+  for (i = 0; i < TASK_CNT; i++) 
+    {
+      struct task *t = &tasks[i];
+      char name[16];
+
+      t->period = params[i][0];
+      t->budget = params[i][1];
+      t->work = params[i][2];
+      t->edf = edf;
+      t->jobs = t->misses = 0;
+      t->admitted = &admitted;
+      t->done = &done;
+      snprintf (name, sizeof name, "task %d", i);
+      thread_create (name, PRI_DEFAULT, task_thread, t);
+    }
+  for (i = 0; i < TASK_CNT; i++)
+    sema_down (&admitted);
+
+  if (edf)
+    {
+      /* 80% are taken, so another 20% is too much. */
+      if (thread_set_deadline (10, 2))
+        fail ("task past the class's share was admitted");
+      msg ("Admission past capacity refused.");
+    }
+
+  *jobs = *misses = 0;
+  for (i = 0; i < TASK_CNT; i++)
+    sema_down (&done);
+  for (i = 0; i < TASK_CNT; i++) 
+    {
+      *jobs += tasks[i].jobs;
+      *misses += tasks[i].misses;
+    }
+}
+
+/* Blocks until timer tick TICK. */
+static void
+sleep_until (int64_t tick) 
+{
+  struct timer_alarm alarm;
+  struct semaphore sema;
+
+  if (tick <= timer_ticks ())
+    return;
+  sema_init (&sema, 0);
+  alarm.armed = false;
+  timer_alarm_set (&alarm, tick, &sema);
+  sema_down (&sema);
+}
+
+/* Releases a job every period for RUN_TICKS, each spinning for
+   its work ticks, and counts the jobs that finish after the end
+   of their period. */
+static void
+task_thread (void *t_) 
+{
+  struct task *t = t_;
+  struct thread *cur = thread_current ();
+  int64_t start, release;
+
+  if (t->edf && !thread_set_deadline (t->period, t->budget))
+    fail ("EDF task with period %d not admitted", (int) t->period);
+  start = timer_ticks ();
+  sema_up (t->admitted);
+
+  for (release = start; release < start + RUN_TICKS;
+       release += t->period) 
+    {
+      unsigned spun = cur->kernel_ticks;
+
+      sleep_until (release);
+      while (cur->kernel_ticks - spun < t->work)
+        barrier ();
+      t->jobs++;
+      if (timer_ticks () > release + t->period)
+        t->misses++;
+    }
+
+  if (t->edf)
+    thread_set_deadline (0, 0);
+  sema_up (t->done);
+}
+
+/* Spins until told to stop. */
+static void
+hog_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+
+  while (!hog_stop)
+    barrier ();
+  sema_up (done);
+}
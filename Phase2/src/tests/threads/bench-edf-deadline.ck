@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-edf-deadline) begin
+(bench-edf-deadline) Running tasks round robin.
+(bench-edf-deadline) Running tasks earliest deadline first.
+(bench-edf-deadline) Admission past capacity refused.
+(bench-edf-deadline) Done.
+(bench-edf-deadline) end
+EOF
+pass;
@@ -0,0 +1,73 @@
+/* Measures lock hand-off under contention: THREAD_CNT threads
+   each acquire the same lock ACQUIRE_CNT times and yield while
+   holding it, so that the others queue up behind it and almost
+   every release hands the lock to a waiter. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 4
+#define ACQUIRE_CNT 1000
+
+static struct lock lock;
+static struct semaphore done;
+static tid_t last_holder;       /* Thread that last held LOCK. */
+static int handoff_cnt;         /* Acquires by a different thread. */
+
+static thread_func contend_thread;
+
+void
+test_bench_lock_handoff (void) 
+{
+  int64_t start_ticks, ticks;
+  uint64_t start_tsc, cycles;
+  int i;
+
+  lock_init (&lock);
+  sema_init (&done, 0);
+  last_holder = TID_ERROR;
+  handoff_cnt = 0;
+
+  msg ("%d threads acquiring a lock %d times each.",
+       THREAD_CNT, ACQUIRE_CNT);
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      char name[16];
+      snprintf (name, sizeof name, "contend %d", i);
+      thread_create (name, PRI_DEFAULT, contend_thread, NULL);
+    }
+  for (i = 0; i < THREAD_CNT; i++)
+    sema_down (&done);
+  cycles = rdtsc () - start_tsc;
+  ticks = timer_elapsed (start_ticks);
+
+  bench ("%d acquires, %d handoffs, %"PRId64" ticks, %"PRIu64" cycles, "
+         "%"PRIu64" cycles/acquire",
+         THREAD_CNT * ACQUIRE_CNT, handoff_cnt, ticks, cycles,
+         cycles / (THREAD_CNT * ACQUIRE_CNT));
+  msg ("All threads finished.");
+}
+
+static void
+contend_thread (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ACQUIRE_CNT; i++) 
+    {
+      lock_acquire (&lock);
+      if (last_holder != thread_tid ())
+        handoff_cnt++;
+      last_holder = thread_tid ();
+      thread_yield ();
+      lock_release (&lock);
+    }
+  sema_up (&done);
+}
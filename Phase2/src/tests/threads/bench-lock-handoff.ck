@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-lock-handoff) begin
+(bench-lock-handoff) 4 threads acquiring a lock 1000 times each.
+(bench-lock-handoff) All threads finished.
+(bench-lock-handoff) end
+EOF
+pass;
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-mlfqs-tick-500) begin
+(bench-mlfqs-tick-500) Spinning for 200 ticks alone.
+(bench-mlfqs-tick-500) Creating 500 blocked threads.
+(bench-mlfqs-tick-500) Spinning for 200 ticks with 500 blocked threads.
+(bench-mlfqs-tick-500) All threads unblocked.
+(bench-mlfqs-tick-500) end
+EOF
+pass;
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-mlfqs-tick-60) begin
+(bench-mlfqs-tick-60) Spinning for 200 ticks alone.
+(bench-mlfqs-tick-60) Creating 60 blocked threads.
+(bench-mlfqs-tick-60) Spinning for 200 ticks with 60 blocked threads.
+(bench-mlfqs-tick-60) All threads unblocked.
+(bench-mlfqs-tick-60) end
+EOF
+pass;
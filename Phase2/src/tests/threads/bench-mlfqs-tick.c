@@ -0,0 +1,111 @@
+/* Measures the cost of timer ticks with many threads in the
+   system, which under the MLFQS is dominated by recomputing every
+   thread's priority and recent_cpu.
+
+   The main thread counts how many times it can go around a busy
+   loop in SPAN ticks with no other threads, and again after
+   creating 60 or 500 threads that block on a semaphore.  Blocked
+   threads never run, so any iterations lost went to the timer
+   interrupt and the scheduler bookkeeping that the extra threads
+   cause. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+#include "devices/timer.h"
+
+#define SPAN 200
+
+static void test_tick (int thread_cnt);
+static int64_t spin (uint64_t *cycles);
+static thread_func block_thread;
+
+void
+test_bench_mlfqs_tick_60 (void) 
+{
+  test_tick (60);
+}
+
+void
+test_bench_mlfqs_tick_500 (void) 
+{
+  test_tick (500);
+}
+
+static void
+test_tick (int thread_cnt) 
+{
+  struct semaphore blocker;
+  int64_t base_iters, iters;
+  uint64_t base_cycles, cycles, overhead;
+  int i;
+
+  ASSERT (thread_mlfqs);
+
+  sema_init (&blocker, 0);
+  msg ("Spinning for %d ticks alone.", SPAN);
+  base_iters = spin (&base_cycles);
+
+  msg ("Creating %d blocked threads.", thread_cnt);
+  for (i = 0; i < thread_cnt; i++) 
+    {
+      char name[24];
+      snprintf (name, sizeof name, "blocked %d", i);
+      if (thread_create (name, PRI_DEFAULT, block_thread, &blocker)
+          == TID_ERROR)
+        fail ("thread_create failed after %d threads", i);
+    }
+
+  /* Let all of them block. */
+  timer_sleep (10);
+
+  msg ("Spinning for %d ticks with %d blocked threads.", SPAN, thread_cnt);
+  iters = spin (&cycles);
+
+  /* The fraction of the loop's cycles lost to the extra threads,
+     applied to the cycles in a tick. */
+  overhead = 0;
+  if (iters < base_iters)
+    overhead = (base_iters - iters) * (cycles / SPAN) / base_iters;
+  bench ("%d threads, %d ticks, %"PRId64" iterations alone, "
+         "%"PRId64" iterations with threads, %"PRIu64" cycles/tick, "
+         "%"PRIu64" cycles/tick overhead",
+         thread_cnt, SPAN, base_iters, iters, cycles / SPAN, overhead);
+
+  for (i = 0; i < thread_cnt; i++)
+    sema_up (&blocker);
+  timer_sleep (10);
+  msg ("All threads unblocked.");
+}
+
+/* Counts loop iterations from the start of the next tick through
+   SPAN ticks, and stores the cycles they took in *CYCLES. */
+static int64_t
+spin (uint64_t *cycles) 
+{
+  int64_t start, iters = 0;
+  uint64_t start_tsc;
+
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+  start++;
+
+  start_tsc = rdtsc ();
+  while (timer_ticks () - start < SPAN)
+    iters++;
+  *cycles = rdtsc () - start_tsc;
+  return iters;
+}
+
+static void
+block_thread (void *blocker_) 
+{
+  struct semaphore *blocker = blocker_;
+
+  sema_down (blocker);
+}
@@ -0,0 +1,58 @@
+/* Measures semaphore hand-off latency: the main thread and a
+   partner thread bounce control back and forth ROUND_CNT times
+   through a pair of semaphores, so that every round trip is two
+   sema_up() calls, two sema_down() calls, and two context
+   switches. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+#include "devices/timer.h"
+
+#define ROUND_CNT 10000
+
+static struct semaphore ping, pong;
+static thread_func pong_thread;
+
+void
+test_bench_sema_pingpong (void) 
+{
+  int64_t start_ticks, ticks;
+  uint64_t start_tsc, cycles;
+  int i;
+
+  sema_init (&ping, 0);
+  sema_init (&pong, 0);
+  thread_create ("pong", PRI_DEFAULT, pong_thread, NULL);
+
+  msg ("Bouncing %d times.", ROUND_CNT);
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      sema_up (&ping);
+      sema_down (&pong);
+    }
+  cycles = rdtsc () - start_tsc;
+  ticks = timer_elapsed (start_ticks);
+
+  bench ("%d round trips, %"PRId64" ticks, %"PRIu64" cycles, "
+         "%"PRIu64" cycles/round trip",
+         ROUND_CNT, ticks, cycles, cycles / ROUND_CNT);
+  msg ("Done bouncing.");
+}
+
+static void
+pong_thread (void *aux UNUSED) 
+{
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      sema_down (&ping);
+      sema_up (&pong);
+    }
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-sema-pingpong) begin
+(bench-sema-pingpong) Bouncing 10000 times.
+(bench-sema-pingpong) Done bouncing.
+(bench-sema-pingpong) end
+EOF
+pass;
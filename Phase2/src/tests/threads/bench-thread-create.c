@@ -0,0 +1,52 @@
+/* Measures how fast threads can be created and reaped: creates
+   THREAD_CNT threads one after another, each of which exits as
+   soon as it runs, and waits for each before creating the next. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 1000
+
+static thread_func exit_thread;
+
+void
+test_bench_thread_create (void) 
+{
+  struct semaphore done;
+  int64_t start_ticks, ticks;
+  uint64_t start_tsc, cycles;
+  int i;
+
+  sema_init (&done, 0);
+  msg ("Creating %d threads, one at a time.", THREAD_CNT);
+
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      if (thread_create ("exit", PRI_DEFAULT, exit_thread, &done)
+          == TID_ERROR)
+        fail ("thread_create failed after %d threads", i);
+      sema_down (&done);
+    }
+  cycles = rdtsc () - start_tsc;
+  ticks = timer_elapsed (start_ticks);
+
+  bench ("%d threads, %"PRId64" ticks, %"PRIu64" cycles, "
+         "%"PRIu64" cycles/thread",
+         THREAD_CNT, ticks, cycles, cycles / THREAD_CNT);
+  msg ("All threads exited.");
+}
+
+static void
+exit_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+
+  sema_up (done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-thread-create) begin
+(bench-thread-create) Creating 1000 threads, one at a time.
+(bench-thread-create) All threads exited.
+(bench-thread-create) end
+EOF
+pass;
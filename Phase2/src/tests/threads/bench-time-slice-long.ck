@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-time-slice-long) begin
+(bench-time-slice-long) Running 2 batch threads and an interactive thread for 200 ticks.
+(bench-time-slice-long) Done.
+(bench-time-slice-long) end
+EOF
+pass;
@@ -0,0 +1,116 @@
+/* Measures the effect of time slices that depend on priority.
+
+   Two CPU-bound "batch" threads at PRI_MIN spin for SPAN ticks
+   while an "interactive" thread at PRI_MAX wakes every few ticks.
+   Reports how often the batch threads were preempted, which
+   longer slices for them should reduce, and how late the
+   interactive thread got the CPU after each wakeup, which they
+   may increase, since a woken thread waits for the running one's
+   slice to run out.  bench-time-slice runs with the default
+   slices and bench-time-slice-long with -slice=2,16. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SPAN 200
+#define BATCH_CNT 2
+#define WAKE_CNT 20
+#define WAKE_INTERVAL 7
+
+static int64_t start_time;
+static unsigned batch_switches;
+static int64_t wake_delay;
+
+static void test_time_slice (void);
+static void sleep_until (int64_t tick);
+static thread_func batch_thread;
+static thread_func interactive_thread;
+
+void
+test_bench_time_slice (void) 
+{
+  test_time_slice ();
+}
+
+void
+test_bench_time_slice_long (void) 
+{
+  test_time_slice ();
+}
+
+static void
+test_time_slice (void) 
+{
+  struct semaphore done;
+  int i;
+
+  msg ("Running %d batch threads and an interactive thread "
+       "for %d ticks.", BATCH_CNT, SPAN);
+  sema_init (&done, 0);
+  batch_switches = 0;
+  wake_delay = 0;
+  start_time = timer_ticks ();
+  for (i = 0; i < BATCH_CNT; i++) 
+    {
+      char name[16];
+
+      snprintf (name, sizeof name, "batch %d", i);
+      thread_create (name, PRI_MIN, batch_thread, &done);
+    }
+  thread_create ("interactive", PRI_MAX, interactive_thread, &done);
+  for (i = 0; i < BATCH_CNT + 1; i++)
+    sema_down (&done);
+  msg ("Done.");
+
+  bench ("slices of %u to %u ticks", thread_slice_short, thread_slice_long);
+  bench ("batch threads preempted %u times", batch_switches);
+  bench ("interactive thread woke %d ticks late in all over %d wakeups",
+         (int) wake_delay, WAKE_CNT);
+}
+
+/* Blocks until timer tick TICK. */
+static void
+sleep_until (int64_t tick) 
+{
+  struct timer_alarm alarm;
+  struct semaphore sema;
+
+  if (tick <= timer_ticks ())
+    return;
+  sema_init (&sema, 0);
+  alarm.armed = false;
+  timer_alarm_set (&alarm, tick, &sema);
+  sema_down (&sema);
+}
+
+static void
+batch_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+  struct thread *cur = thread_current ();
+
+  while (timer_elapsed (start_time) < SPAN)
+    barrier ();
+  batch_switches += cur->involuntary_switches;
+  sema_up (done);
+}
+
+static void
+interactive_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+  int i;
+
+  for (i = 1; i <= WAKE_CNT; i++) 
+    {
+      int64_t wake = start_time + i * WAKE_INTERVAL;
+
+      sleep_until (wake);
+      wake_delay += timer_ticks () - wake;
+    }
+  sema_up (done);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-time-slice) begin
+(bench-time-slice) Running 2 batch threads and an interactive thread for 200 ticks.
+(bench-time-slice) Done.
+(bench-time-slice) end
+EOF
+pass;
@@ -0,0 +1,58 @@
+/* Measures the cost of a bare thread switch: the main thread and
+   a partner thread, the only two ready, call thread_yield() in
+   turn ROUND_CNT times each, so that every call switches to the
+   other one.  Neither has a user address space or has used the
+   FPU, so this is the kernel-to-kernel path that can skip the
+   page directory, the TSS, and CR0. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tsc.h"
+#include "devices/timer.h"
+
+#define ROUND_CNT 10000
+
+static struct semaphore started;
+static thread_func yield_thread;
+
+void
+test_bench_yield_pingpong (void) 
+{
+  int64_t start_ticks, ticks;
+  uint64_t start_tsc, cycles;
+  unsigned switches;
+  struct thread *cur = thread_current ();
+  int i;
+
+  sema_init (&started, 0);
+  thread_create ("yield", PRI_DEFAULT, yield_thread, NULL);
+  sema_down (&started);
+
+  msg ("Yielding %d times.", ROUND_CNT);
+  switches = cur->involuntary_switches;
+  start_ticks = timer_ticks ();
+  start_tsc = rdtsc ();
+  for (i = 0; i < ROUND_CNT; i++)
+    thread_yield ();
+  cycles = rdtsc () - start_tsc;
+  ticks = timer_elapsed (start_ticks);
+  switches = cur->involuntary_switches - switches;
+
+  bench ("%u switches away, %"PRId64" ticks, %"PRIu64" cycles, "
+         "%"PRIu64" cycles/switch",
+         switches, ticks, cycles, cycles / (2 * ROUND_CNT));
+  msg ("Done yielding.");
+}
+
+static void
+yield_thread (void *aux UNUSED) 
+{
+  int i;
+
+  sema_up (&started);
+  for (i = 0; i < ROUND_CNT; i++)
+    thread_yield ();
+}
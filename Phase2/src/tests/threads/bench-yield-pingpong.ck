@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(bench-yield-pingpong) begin
+(bench-yield-pingpong) Yielding 10000 times.
+(bench-yield-pingpong) Done yielding.
+(bench-yield-pingpong) end
+EOF
+pass;
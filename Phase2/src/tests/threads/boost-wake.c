@@ -0,0 +1,78 @@
+/* Checks that, with "-boost", a thread that mostly sleeps gets
+   the CPU as soon as it wakes, even while another thread spins.
+
+   The "sleeper" thread first sleeps long enough to count as
+   interactive, then wakes WAKE_CNT times, each time running for
+   less than a tick.  Each time, it should be running within the
+   tick its alarm went off in, instead of waiting for the spinning
+   thread's time slice to run out. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define WAKE_CNT 10
+
+static volatile bool done;
+static thread_func hog_thread;
+static void sleep_until (int64_t tick);
+
+void
+test_boost_wake (void) 
+{
+  struct semaphore hog_done;
+  int64_t tick;
+  int on_time = 0;
+  int i;
+
+  ASSERT (thread_boost);
+
+  done = false;
+  sema_init (&hog_done, 0);
+  thread_create ("hog", PRI_DEFAULT, hog_thread, &hog_done);
+
+  msg ("Sleeping while a thread spins...");
+  tick = timer_ticks () + 60;
+  sleep_until (tick);
+  for (i = 0; i < WAKE_CNT; i++) 
+    {
+      tick += 5;
+      sleep_until (tick);
+      if (timer_ticks () == tick)
+        on_time++;
+    }
+  done = true;
+  sema_down (&hog_done);
+
+  if (on_time != WAKE_CNT)
+    fail ("woke late %d times out of %d", WAKE_CNT - on_time, WAKE_CNT);
+  msg ("Ran in the tick of every wakeup.");
+}
+
+/* Blocks until timer tick TICK. */
+static void
+sleep_until (int64_t tick) 
+{
+  struct timer_alarm alarm;
+  struct semaphore sema;
+
+  if (tick <= timer_ticks ())
+    return;
+  sema_init (&sema, 0);
+  alarm.armed = false;
+  timer_alarm_set (&alarm, tick, &sema);
+  sema_down (&sema);
+}
+
+static void
+hog_thread (void *done_) 
+{
+  struct semaphore *hog_done = done_;
+
+  while (!done)
+    barrier ();
+  sema_up (hog_done);
+}
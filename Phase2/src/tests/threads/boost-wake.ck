@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(boost-wake) begin
+(boost-wake) Sleeping while a thread spins...
+(boost-wake) Ran in the tick of every wakeup.
+(boost-wake) end
+EOF
+pass;
@@ -0,0 +1,109 @@
+/* Checks that, with "-group", the CPU is shared between
+   scheduling groups by weight, however many threads each has.
+
+   Group 0, of weight 100, has 4 threads; group 1, also of weight
+   100, has 1; and group 2, of weight 200, has 1.  Spinning
+   together for 10 seconds, the groups should receive about 250,
+   250, and 500 ticks, respectively, where sharing by thread would
+   give them 667, 167, and 167.  The main thread blocks, rather
+   than calling timer_sleep(), which would keep it in the run
+   queue. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define GROUP_CNT 3
+#define THREAD_CNT 6
+
+struct thread_info 
+  {
+    int64_t start_time;
+    struct sched_group *group;
+    int tick_count;
+  };
+
+static void sleep_until (int64_t tick);
+static void load_thread (void *aux);
+
+void
+test_group_fair (void) 
+{
+  static const int weights[GROUP_CNT] = {100, 100, 200};
+  static const int members[THREAD_CNT] = {0, 0, 0, 0, 1, 2};
+  struct sched_group groups[GROUP_CNT];
+  struct thread_info info[THREAD_CNT];
+  int64_t start_time;
+  int i;
+
+  ASSERT (thread_group_share);
+
+  for (i = 0; i < GROUP_CNT; i++)
+    sched_group_init (&groups[i], weights[i]);
+
+  start_time = timer_ticks ();
+  msg ("Starting %d threads in %d groups...", THREAD_CNT, GROUP_CNT);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      ti->group = &groups[members[i]];
+      ti->tick_count = 0;
+
+      snprintf (name, sizeof name, "load %d", i);
+      thread_create (name, PRI_DEFAULT, load_thread, ti);
+    }
+
+  msg ("Sleeping 12 seconds to let threads run, please wait...");
+  sleep_until (start_time + 12 * TIMER_FREQ);
+
+  for (i = 0; i < GROUP_CNT; i++) 
+    {
+      int ticks = 0;
+      int j;
+
+      for (j = 0; j < THREAD_CNT; j++)
+        if (members[j] == i)
+          ticks += info[j].tick_count;
+      msg ("Group %d received %d ticks.", i, ticks);
+    }
+}
+
+/* Blocks until timer tick TICK. */
+static void
+sleep_until (int64_t tick) 
+{
+  struct timer_alarm alarm;
+  struct semaphore sema;
+
+  if (tick <= timer_ticks ())
+    return;
+  sema_init (&sema, 0);
+  alarm.armed = false;
+  timer_alarm_set (&alarm, tick, &sema);
+  sema_down (&sema);
+}
+
+static void
+load_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t spin_time = 11 * TIMER_FREQ;
+  int64_t last_time = 0;
+
+  thread_set_group (ti->group);
+  sleep_until (ti->start_time + 1 * TIMER_FREQ);
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+  thread_set_group (NULL);
+}
@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+use tests::threads::mlfqs;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+common_checks ("run", @output);
+@output = get_core_output ("run", @output);
+
+my (@actual);
+local ($_);
+foreach (@output) {
+    my ($id, $count) = /Group (\d+) received (\d+) ticks\./ or next;
+    $actual[$id] = $count;
+}
+
+mlfqs_compare ("group", "%d", \@actual, [250, 250, 500], 50, [0, 2, 1],
+	       "Some tick counts were missing or differed from those "
+	       . "expected by more than 50.");
+pass;
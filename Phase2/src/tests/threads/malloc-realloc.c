@@ -0,0 +1,54 @@
+/* Checks that a 4 kB block takes a single page, that realloc()
+   keeps a block in place when it shrinks or stays within its
+   size class, and that it keeps the contents when it moves. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/vaddr.h"
+
+void
+test_malloc_realloc (void) 
+{
+  struct memstat before, after;
+  char *p, *q;
+  size_t i;
+
+  malloc_get_stats (&before);
+  p = malloc (PGSIZE);
+  malloc_get_stats (&after);
+  if (p == NULL)
+    fail ("malloc() of one page failed");
+  if (after.malloc_big_pages != before.malloc_big_pages + 1)
+    fail ("a %d-byte block took %u pages",
+          PGSIZE, after.malloc_big_pages - before.malloc_big_pages);
+  free (p);
+  msg ("A one-page block takes one page.");
+
+  p = malloc (100);
+  q = realloc (p, 120);
+  if (q != p)
+    fail ("realloc() within a size class moved the block");
+  free (q);
+
+  p = malloc (3 * PGSIZE);
+  q = realloc (p, 2 * PGSIZE + 1);
+  if (q != p)
+    fail ("realloc() shrinking a big block moved it");
+  free (q);
+  msg ("realloc() kept the block in place.");
+
+  p = malloc (100);
+  for (i = 0; i < 100; i++)
+    p[i] = i;
+  q = realloc (p, 2 * PGSIZE);
+  if (q == NULL)
+    fail ("realloc() to two pages failed");
+  for (i = 0; i < 100; i++)
+    if (q[i] != (char) i)
+      fail ("byte %zu changed when realloc() moved the block", i);
+  free (q);
+  msg ("realloc() kept the contents of a moved block.");
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-realloc) begin
+(malloc-realloc) A one-page block takes one page.
+(malloc-realloc) realloc() kept the block in place.
+(malloc-realloc) realloc() kept the contents of a moved block.
+(malloc-realloc) end
+EOF
+pass;
@@ -0,0 +1,69 @@
+/* Checks that a thread woken by an interrupt while the running
+   thread has preemption off runs as soon as preemption is back
+   on, and that one made ready without an interrupt runs at the
+   next cond_resched(). */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+static bool slept, woke;
+static struct thread *blocked;
+
+static thread_func sleeper, blocker;
+
+void
+test_preempt_point (void) 
+{
+  int64_t start;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* The sleeper outranks us, so it runs and falls asleep. */
+  thread_create ("sleeper", PRI_DEFAULT + 1, sleeper, NULL);
+  preempt_disable ();
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 20)
+    continue;
+  if (slept)
+    fail ("sleeper ran with preemption off");
+  preempt_enable ();
+  if (!slept)
+    fail ("sleeper did not run at preempt_enable()");
+  msg ("Sleeper ran at preempt_enable().");
+
+  /* Start just after a tick, so that none comes along to preempt
+     us before cond_resched() does. */
+  thread_create ("blocker", PRI_DEFAULT + 1, blocker, NULL);
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  thread_unblock (blocked);
+  if (woke)
+    fail ("blocker ran before cond_resched()");
+  cond_resched ();
+  if (!woke)
+    fail ("blocker did not run at cond_resched()");
+  msg ("Blocker ran at cond_resched().");
+}
+
+static void
+sleeper (void *aux UNUSED) 
+{
+  timer_sleep (5);
+  slept = true;
+}
+
+static void
+blocker (void *aux UNUSED) 
+{
+  enum intr_level old_level = intr_disable ();
+  blocked = thread_current ();
+  thread_block ();
+  intr_set_level (old_level);
+  woke = true;
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(preempt-point) begin
+(preempt-point) Sleeper ran at preempt_enable().
+(preempt-point) Blocker ran at cond_resched().
+(preempt-point) end
+EOF
+pass;
@@ -0,0 +1,61 @@
+/* Checks that a lock initialized with lock_init_ceiling() raises
+   its holder to the ceiling at once, so that a thread of middling
+   priority created meanwhile does not run until it is released,
+   and that a priority lent through an ordinary lock held at the
+   same time still counts while it is higher. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static struct lock ceiling_lock;
+static struct lock plain_lock;
+
+static thread_func medium_thread, high_thread;
+
+void
+test_priority_ceiling (void) 
+{
+  /* This test does not work with the MLFQS or the stride
+     scheduler. */
+  ASSERT (!thread_mlfqs && !thread_stride);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  lock_init_ceiling (&ceiling_lock, PRI_DEFAULT + 10);
+  lock_init (&plain_lock);
+
+  lock_acquire (&ceiling_lock);
+  msg ("Holding the ceiling lock at priority %d.", thread_get_priority ());
+  thread_create ("medium", PRI_DEFAULT + 5, medium_thread, NULL);
+  msg ("Medium thread should not have run yet.");
+
+  lock_acquire (&plain_lock);
+  thread_create ("high", PRI_DEFAULT + 20, high_thread, NULL);
+  msg ("Priority %d while high thread waits for the plain lock.",
+       thread_get_priority ());
+  lock_release (&plain_lock);
+  msg ("Priority %d after releasing the plain lock.",
+       thread_get_priority ());
+
+  lock_release (&ceiling_lock);
+  msg ("Priority %d after releasing the ceiling lock.",
+       thread_get_priority ());
+}
+
+static void
+medium_thread (void *aux UNUSED) 
+{
+  msg ("Medium thread ran.");
+}
+
+static void
+high_thread (void *aux UNUSED) 
+{
+  lock_acquire (&plain_lock);
+  msg ("High thread got the plain lock.");
+  lock_release (&plain_lock);
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(priority-ceiling) begin
+(priority-ceiling) Holding the ceiling lock at priority 41.
+(priority-ceiling) Medium thread should not have run yet.
+(priority-ceiling) Priority 51 while high thread waits for the plain lock.
+(priority-ceiling) High thread got the plain lock.
+(priority-ceiling) Priority 41 after releasing the plain lock.
+(priority-ceiling) Medium thread ran.
+(priority-ceiling) Priority 31 after releasing the ceiling lock.
+(priority-ceiling) end
+EOF
+pass;
@@ -0,0 +1,51 @@
+/* Checks that call_rcu() does not run a callback while a
+   read-side critical section that was under way is still open,
+   even if the reader is due to be preempted meanwhile, and that
+   rcu_barrier() returns only once every callback has run. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/rcu.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define HEAD_CNT 8
+
+static struct rcu_head heads[HEAD_CNT];
+static int freed;
+
+static rcu_func free_head;
+
+void
+test_rcu_defer (void) 
+{
+  int64_t start;
+  int i;
+
+  rcu_read_lock ();
+  for (i = 0; i < HEAD_CNT; i++)
+    call_rcu (&heads[i], free_head);
+
+  /* Spin past several time slices. */
+  start = timer_ticks ();
+  while (timer_elapsed (start) < 20)
+    continue;
+  if (freed != 0)
+    fail ("%d callbacks ran inside the read-side critical section",
+          freed);
+  rcu_read_unlock ();
+  msg ("No callback ran inside the read-side critical section.");
+
+  rcu_barrier ();
+  if (freed != HEAD_CNT)
+    fail ("%d of %d callbacks had run when rcu_barrier() returned",
+          freed, HEAD_CNT);
+  msg ("All %d callbacks ran before rcu_barrier() returned.", HEAD_CNT);
+}
+
+static void
+free_head (struct rcu_head *head UNUSED) 
+{
+  freed++;
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rcu-defer) begin
+(rcu-defer) No callback ran inside the read-side critical section.
+(rcu-defer) All 8 callbacks ran before rcu_barrier() returned.
+(rcu-defer) end
+EOF
+pass;
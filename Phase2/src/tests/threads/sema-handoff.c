@@ -0,0 +1,69 @@
+/* Checks that sema_up() hands the rest of the time slice to the
+   thread it wakes, so that the woken thread has run by the time
+   sema_up() returns, and that cond_signal() does not, since the
+   waiter needs the lock the signaller holds. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct handoff 
+  {
+    struct semaphore sema;
+    struct lock lock;
+    struct condition cond;
+    bool signalled;
+    volatile int stage;
+  };
+
+static thread_func waiter_thread;
+
+void
+test_sema_handoff (void) 
+{
+  struct handoff h;
+
+  sema_init (&h.sema, 0);
+  lock_init (&h.lock);
+  cond_init (&h.cond);
+  h.signalled = false;
+  h.stage = 0;
+  thread_create ("waiter", PRI_DEFAULT, waiter_thread, &h);
+
+  /* Let the waiter block on the semaphore. */
+  while (h.stage == 0)
+    thread_yield ();
+
+  sema_up (&h.sema);
+  if (h.stage != 2)
+    fail ("waiter had not run when sema_up() returned");
+  msg ("Waiter ran before sema_up() returned.");
+
+  lock_acquire (&h.lock);
+  h.signalled = true;
+  cond_signal (&h.cond, &h.lock);
+  if (h.stage != 2)
+    fail ("waiter ran while the lock was still held");
+  lock_release (&h.lock);
+  while (h.stage != 3)
+    thread_yield ();
+  msg ("Waiter woke from the condition after the lock was released.");
+}
+
+static void
+waiter_thread (void *h_) 
+{
+  struct handoff *h = h_;
+
+  h->stage = 1;
+  sema_down (&h->sema);
+  h->stage = 2;
+
+  lock_acquire (&h->lock);
+  while (!h->signalled)
+    cond_wait (&h->cond, &h->lock);
+  h->stage = 3;
+  lock_release (&h->lock);
+}
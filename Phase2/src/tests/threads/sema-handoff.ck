@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sema-handoff) begin
+(sema-handoff) Waiter ran before sema_up() returned.
+(sema-handoff) Waiter woke from the condition after the lock was released.
+(sema-handoff) end
+EOF
+pass;
@@ -0,0 +1,133 @@
+/* Checks that, under the stride scheduler, a thread waiting on a
+   semaphore or condition variable lends its tickets to the
+   thread registered as its signaler, and reports how long each
+   wait lasted.
+
+   A "low" thread with 1 ticket registers itself as the signaler
+   and then needs 20 ticks of CPU time before it signals.  A "hog"
+   with 100 tickets needs 400 ticks.  The main thread, with 1,000
+   tickets, waits first on a semaphore and then on a condition
+   variable.  Borrowing its tickets, the low thread should signal
+   each time long before the hog is done; without them, it would
+   get about 1 tick in 100 and finish last. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+struct signal 
+  {
+    bool use_cond;              /* Signal COND rather than SEMA. */
+    struct semaphore sema;      /* Upped by the low thread. */
+    struct lock lock;           /* Protects DONE. */
+    struct condition cond;      /* Signalled once DONE is set. */
+    bool done;
+    struct semaphore ready;     /* Upped once the signaler is set. */
+  };
+
+static thread_func low_thread;
+static thread_func hog_thread;
+static void spin (unsigned ticks);
+
+void
+test_stride_donate_sema (void) 
+{
+  struct signal signal;
+  struct semaphore hog_done;
+  int round;
+
+  ASSERT (thread_stride);
+
+  sema_init (&signal.sema, 0);
+  lock_init (&signal.lock);
+  cond_init (&signal.cond);
+  sema_init (&signal.ready, 0);
+  sema_init (&hog_done, 0);
+  thread_set_tickets (1000);
+  thread_create ("hog", PRI_DEFAULT, hog_thread, &hog_done);
+
+  for (round = 0; round < 2; round++) 
+    {
+      int64_t start;
+
+      signal.use_cond = round == 1;
+      signal.done = false;
+      thread_create ("low", PRI_DEFAULT, low_thread, &signal);
+      sema_down (&signal.ready);
+
+      start = timer_ticks ();
+      if (!signal.use_cond) 
+        {
+          msg ("Main thread waiting on the semaphore.");
+          sema_down (&signal.sema);
+        }
+      else 
+        {
+          msg ("Main thread waiting on the condition.");
+          lock_acquire (&signal.lock);
+          while (!signal.done)
+            cond_wait (&signal.cond, &signal.lock);
+          lock_release (&signal.lock);
+        }
+      bench ("inversion lasted %"PRId64" ticks", timer_elapsed (start));
+      msg ("Main thread woke.");
+    }
+
+  sema_down (&hog_done);
+  msg ("Main thread done.");
+}
+
+static void
+low_thread (void *signal_) 
+{
+  struct signal *signal = signal_;
+
+  thread_set_tickets (1);
+  if (!signal->use_cond)
+    sema_set_signaler (&signal->sema, thread_current ());
+  else
+    cond_set_signaler (&signal->cond, thread_current ());
+  sema_up (&signal->ready);
+  spin (20);
+
+  msg ("Low thread signalling.");
+  if (!signal->use_cond) 
+    {
+      sema_set_signaler (&signal->sema, NULL);
+      sema_up (&signal->sema);
+    }
+  else 
+    {
+      lock_acquire (&signal->lock);
+      cond_set_signaler (&signal->cond, NULL);
+      signal->done = true;
+      cond_signal (&signal->cond, &signal->lock);
+      lock_release (&signal->lock);
+    }
+}
+
+static void
+hog_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+
+  thread_set_tickets (100);
+  spin (400);
+  msg ("Hog finished.");
+  sema_up (done);
+}
+
+/* Spins until the current thread has run for TICKS more ticks. */
+static void
+spin (unsigned ticks) 
+{
+  struct thread *cur = thread_current ();
+  unsigned start = cur->kernel_ticks;
+
+  while (cur->kernel_ticks - start < ticks)
+    barrier ();
+}
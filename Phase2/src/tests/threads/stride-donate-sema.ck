@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_BENCH => 1, [<<'EOF']);
+(stride-donate-sema) begin
+(stride-donate-sema) Main thread waiting on the semaphore.
+(stride-donate-sema) Low thread signalling.
+(stride-donate-sema) Main thread woke.
+(stride-donate-sema) Main thread waiting on the condition.
+(stride-donate-sema) Low thread signalling.
+(stride-donate-sema) Main thread woke.
+(stride-donate-sema) Hog finished.
+(stride-donate-sema) Main thread done.
+(stride-donate-sema) end
+EOF
+pass;
@@ -0,0 +1,86 @@
+/* Checks that, under the stride scheduler, a thread waiting for a
+   lock lends its tickets to the lock's holder.
+
+   A "low" thread with 1 ticket takes a lock and then needs 20
+   ticks of CPU time to release it.  A "hog" with 100 tickets
+   needs 200 ticks.  Then the main thread, with 1,000 tickets,
+   waits for the lock.  Borrowing the main thread's tickets, the
+   low thread should release the lock long before the hog is done;
+   without them, it would get about 1 tick in 100 and finish last. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+struct locked 
+  {
+    struct lock lock;           /* Lock the low thread holds. */
+    struct semaphore held;      /* Upped once it holds it. */
+  };
+
+static thread_func low_thread;
+static thread_func hog_thread;
+static void spin (unsigned ticks);
+
+void
+test_stride_donate (void) 
+{
+  struct locked locked;
+  struct semaphore hog_done;
+
+  ASSERT (thread_stride);
+
+  lock_init (&locked.lock);
+  sema_init (&locked.held, 0);
+  sema_init (&hog_done, 0);
+  thread_set_tickets (1000);
+
+  thread_create ("low", PRI_DEFAULT, low_thread, &locked);
+  sema_down (&locked.held);
+  thread_create ("hog", PRI_DEFAULT, hog_thread, &hog_done);
+
+  msg ("Main thread waiting for the lock.");
+  lock_acquire (&locked.lock);
+  msg ("Main thread got the lock.");
+  lock_release (&locked.lock);
+
+  sema_down (&hog_done);
+  msg ("Main thread done.");
+}
+
+static void
+low_thread (void *locked_) 
+{
+  struct locked *locked = locked_;
+
+  thread_set_tickets (1);
+  lock_acquire (&locked->lock);
+  sema_up (&locked->held);
+  spin (20);
+  msg ("Low thread releasing the lock.");
+  lock_release (&locked->lock);
+}
+
+static void
+hog_thread (void *done_) 
+{
+  struct semaphore *done = done_;
+
+  thread_set_tickets (100);
+  spin (200);
+  msg ("Hog finished.");
+  sema_up (done);
+}
+
+/* Spins until the current thread has run for TICKS more ticks. */
+static void
+spin (unsigned ticks) 
+{
+  struct thread *cur = thread_current ();
+  unsigned start = cur->kernel_ticks;
+
+  while (cur->kernel_ticks - start < ticks)
+    barrier ();
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stride-donate) begin
+(stride-donate) Main thread waiting for the lock.
+(stride-donate) Low thread releasing the lock.
+(stride-donate) Main thread got the lock.
+(stride-donate) Hog finished.
+(stride-donate) Main thread done.
+(stride-donate) end
+EOF
+pass;
@@ -0,0 +1,91 @@
+/* Checks that the stride scheduler shares the CPU in proportion
+   to tickets.
+
+   Three threads with 100, 200, and 300 tickets spin together for
+   10 seconds, so they should receive about 167, 333, and 500
+   ticks, respectively.  The main thread blocks, rather than
+   calling timer_sleep(), which would keep it in the run queue
+   and give it a share too. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 3
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int tickets;
+    int tick_count;
+  };
+
+static void sleep_until (int64_t tick);
+static void load_thread (void *aux);
+
+void
+test_stride_fair (void) 
+{
+  struct thread_info info[THREAD_CNT];
+  int64_t start_time;
+  int i;
+
+  ASSERT (thread_stride);
+
+  start_time = timer_ticks ();
+  msg ("Starting %d threads...", THREAD_CNT);
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      ti->tickets = 100 * (i + 1);
+      ti->tick_count = 0;
+
+      snprintf (name, sizeof name, "load %d", i);
+      thread_create (name, PRI_DEFAULT, load_thread, ti);
+    }
+
+  msg ("Sleeping 12 seconds to let threads run, please wait...");
+  sleep_until (start_time + 12 * TIMER_FREQ);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    msg ("Thread %d received %d ticks.", i, info[i].tick_count);
+}
+
+/* Blocks until timer tick TICK. */
+static void
+sleep_until (int64_t tick) 
+{
+  struct timer_alarm alarm;
+  struct semaphore sema;
+
+  if (tick <= timer_ticks ())
+    return;
+  sema_init (&sema, 0);
+  alarm.armed = false;
+  timer_alarm_set (&alarm, tick, &sema);
+  sema_down (&sema);
+}
+
+static void
+load_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t spin_time = 11 * TIMER_FREQ;
+  int64_t last_time = 0;
+
+  thread_set_tickets (ti->tickets);
+  sleep_until (ti->start_time + 1 * TIMER_FREQ);
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+}
@@ -25,6 +25,7 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"priority-ceiling", test_priority_ceiling},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
@@ -38,6 +39,28 @@ static const struct test tests[] =
     {"mlfqs-nice-2", test_mlfqs_nice_2},
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
+    {"stride-fair", test_stride_fair},
+    {"stride-donate", test_stride_donate},
+    {"stride-donate-sema", test_stride_donate_sema},
+    {"group-fair", test_group_fair},
+    {"sema-handoff", test_sema_handoff},
+    {"boost-wake", test_boost_wake},
+    {"workqueue-flush", test_workqueue_flush},
+    {"rcu-defer", test_rcu_defer},
+    {"preempt-point", test_preempt_point},
+    {"malloc-realloc", test_malloc_realloc},
+    {"timer-callback", test_timer_callback},
+    {"bench-thread-create", test_bench_thread_create},
+    {"bench-sema-pingpong", test_bench_sema_pingpong},
+    {"bench-lock-handoff", test_bench_lock_handoff},
+    {"bench-cond-broadcast", test_bench_cond_broadcast},
+    {"bench-alarm-precision", test_bench_alarm_precision},
+    {"bench-mlfqs-tick-60", test_bench_mlfqs_tick_60},
+    {"bench-mlfqs-tick-500", test_bench_mlfqs_tick_500},
+    {"bench-edf-deadline", test_bench_edf_deadline},
+    {"bench-time-slice", test_bench_time_slice},
+    {"bench-time-slice-long", test_bench_time_slice_long},
+    {"bench-yield-pingpong", test_bench_yield_pingpong},
   };
 
 static const char *test_name;
@@ -93,6 +116,23 @@ fail (const char *format, ...)
   PANIC ("test failed");
 }
 
+/* Prints benchmark result FORMAT as if with printf(),
+   prefixing the output by the name of the test and bench:
+   and following it with a new-line character.  Checkers that
+   pass IGNORE_BENCH to check_expected() skip these lines, since
+   their values vary from run to run. */
+void
+bench (const char *format, ...) 
+{
+  va_list args;
+  
+  printf ("(%s) bench: ", test_name);
+  va_start (args, format);
+  vprintf (format, args);
+  va_end (args);
+  putchar ('\n');
+}
+
 /* Prints a message indicating the current test passed. */
 void
 pass (void) 
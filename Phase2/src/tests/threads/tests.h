@@ -19,6 +19,7 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_priority_ceiling;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
@@ -32,9 +33,32 @@ extern test_func test_mlfqs_fair_20;
 extern test_func test_mlfqs_nice_2;
 extern test_func test_mlfqs_nice_10;
 extern test_func test_mlfqs_block;
+extern test_func test_stride_fair;
+extern test_func test_stride_donate;
+extern test_func test_stride_donate_sema;
+extern test_func test_group_fair;
+extern test_func test_sema_handoff;
+extern test_func test_boost_wake;
+extern test_func test_workqueue_flush;
+extern test_func test_rcu_defer;
+extern test_func test_preempt_point;
+extern test_func test_malloc_realloc;
+extern test_func test_timer_callback;
+extern test_func test_bench_thread_create;
+extern test_func test_bench_sema_pingpong;
+extern test_func test_bench_lock_handoff;
+extern test_func test_bench_cond_broadcast;
+extern test_func test_bench_alarm_precision;
+extern test_func test_bench_mlfqs_tick_60;
+extern test_func test_bench_mlfqs_tick_500;
+extern test_func test_bench_edf_deadline;
+extern test_func test_bench_time_slice;
+extern test_func test_bench_time_slice_long;
+extern test_func test_bench_yield_pingpong;
 
 void msg (const char *, ...);
 void fail (const char *, ...);
+void bench (const char *, ...);
 void pass (void);
 
 #endif /* tests/threads/tests.h */
@@ -0,0 +1,110 @@
+/* Sets timer_add() alarms with deadlines between ticks, out of
+   order, and checks that each function is called once, in
+   deadline order, never before its deadline, except for one
+   alarm that is cancelled first.  One of them sets itself again
+   from its function until it has run several times. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "devices/timer.h"
+
+#define ALARM_CNT 5
+#define REPEAT_CNT 3
+
+struct test_alarm
+  {
+    struct timer_alarm alarm;
+    int64_t deadline;
+    int id;
+    int order;                  /* Place among calls, or -1. */
+    bool early;                 /* Called before its deadline? */
+  };
+
+static struct test_alarm alarms[ALARM_CNT];
+static struct timer_alarm repeat_alarm;
+static int64_t repeat_deadline;
+static int repeat_cnt;
+static bool repeat_early;
+
+static int call_cnt;
+static struct semaphore done;
+
+static timer_func alarm_func, repeat_func;
+
+void
+test_timer_callback (void) 
+{
+  /* Deadlines, in tenths of a tick from now. */
+  static const int delays[ALARM_CNT] = {35, 12, 58, 27, 41};
+  int64_t now;
+  int i;
+
+  sema_init (&done, 0);
+  now = timer_ns ();
+  for (i = 0; i < ALARM_CNT; i++) 
+    {
+      struct test_alarm *a = &alarms[i];
+
+      a->id = i;
+      a->order = -1;
+      a->early = false;
+      a->deadline = now + delays[i] * (TIMER_NS_PER_TICK / 10);
+      timer_add (&a->alarm, a->deadline, alarm_func, a);
+    }
+  repeat_deadline = now + TIMER_NS_PER_TICK / 2;
+  timer_add (&repeat_alarm, repeat_deadline, repeat_func, NULL);
+
+  if (!timer_cancel (&alarms[2].alarm))
+    fail ("alarm 2 went off before it was cancelled");
+  msg ("Cancelled alarm 2.");
+
+  for (i = 0; i < ALARM_CNT - 1 + REPEAT_CNT; i++)
+    sema_down (&done);
+  timer_sleep (10);
+
+  for (i = 0; i < ALARM_CNT; i++) 
+    {
+      if (alarms[i].early)
+        fail ("alarm %d was called before its deadline", i);
+      if (i != 2 && alarms[i].order < 0)
+        fail ("alarm %d was never called", i);
+    }
+  if (alarms[2].order >= 0)
+    fail ("cancelled alarm 2 was called");
+  if (alarms[1].order != 0 || alarms[3].order != 1
+      || alarms[0].order != 2 || alarms[4].order != 3)
+    fail ("alarms were not called in deadline order");
+  msg ("Alarms 1, 3, 0 and 4 were called, in that order, on time.");
+
+  if (repeat_early)
+    fail ("the repeating alarm was called before its deadline");
+  if (repeat_cnt != REPEAT_CNT)
+    fail ("the repeating alarm ran %d times, not %d",
+          repeat_cnt, REPEAT_CNT);
+  msg ("The repeating alarm ran %d times, on time.", REPEAT_CNT);
+}
+
+static void
+alarm_func (void *a_) 
+{
+  struct test_alarm *a = a_;
+
+  a->early = timer_ns () < a->deadline;
+  a->order = call_cnt++;
+  sema_up (&done);
+}
+
+static void
+repeat_func (void *aux UNUSED) 
+{
+  if (timer_ns () < repeat_deadline)
+    repeat_early = true;
+  if (++repeat_cnt < REPEAT_CNT)
+    {
+      repeat_deadline += TIMER_NS_PER_TICK * 3 / 2;
+      timer_add (&repeat_alarm, repeat_deadline, repeat_func, NULL);
+    }
+  sema_up (&done);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(timer-callback) begin
+(timer-callback) Cancelled alarm 2.
+(timer-callback) Alarms 1, 3, 0 and 4 were called, in that order, on time.
+(timer-callback) The repeating alarm ran 3 times, on time.
+(timer-callback) end
+EOF
+pass;
@@ -0,0 +1,56 @@
+/* Submits more items to a workqueue than it has workers, each
+   yielding partway through, and checks that wq_flush() returns
+   only once all of them have run, and that no more ran at once
+   than the queue has workers. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+#define ITEM_CNT 16
+#define WORKER_CNT 3
+
+static int running;
+static int max_running;
+static int done;
+
+static wq_func item;
+
+void
+test_workqueue_flush (void) 
+{
+  struct workqueue *wq;
+  int i;
+
+  wq = wq_create ("wq-test", PRI_DEFAULT, WORKER_CNT);
+  ASSERT (wq != NULL);
+
+  for (i = 0; i < ITEM_CNT; i++)
+    if (!wq_submit (wq, item, NULL))
+      fail ("wq_submit() failed for item %d", i);
+  wq_flush (wq);
+
+  if (done != ITEM_CNT)
+    fail ("%d of %d items had run when wq_flush() returned",
+          done, ITEM_CNT);
+  msg ("All %d items ran before wq_flush() returned.", ITEM_CNT);
+  if (max_running > WORKER_CNT)
+    fail ("%d items ran at once with %d workers",
+          max_running, WORKER_CNT);
+  msg ("No more items ran at once than there are workers.");
+}
+
+static void
+item (void *aux UNUSED) 
+{
+  int i;
+
+  if (++running > max_running)
+    max_running = running;
+  for (i = 0; i < 3; i++)
+    thread_yield ();
+  running--;
+  done++;
+}
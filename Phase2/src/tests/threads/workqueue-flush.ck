@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(workqueue-flush) begin
+(workqueue-flush) All 16 items ran before wq_flush() returned.
+(workqueue-flush) No more items ran at once than there are workers.
+(workqueue-flush) end
+EOF
+pass;
@@ -0,0 +1,53 @@
+/* Starts several asynchronous writes to different parts of a
+   file before waiting for any, then reads the file back with
+   asynchronous reads in flight together and checks the data.
+   This must succeed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHUNK 1024
+#define CHUNK_CNT 4
+
+static char src[CHUNK_CNT * CHUNK];
+static char dst[CHUNK_CNT * CHUNK];
+
+void
+test_main (void) 
+{
+  int ids[CHUNK_CNT];
+  int fd;
+  int i;
+
+  for (i = 0; i < CHUNK_CNT * CHUNK; i++)
+    src[i] = i % 239;
+
+  CHECK (create ("aio", 0), "create \"aio\"");
+  CHECK ((fd = open ("aio")) > 1, "open \"aio\"");
+
+  /* Last chunk first, so the file grows out of order. */
+  for (i = CHUNK_CNT - 1; i >= 0; i--)
+    if ((ids[i] = aio_write (fd, src + i * CHUNK, CHUNK, i * CHUNK)) < 0)
+      fail ("aio_write of chunk %d failed", i);
+  msg ("start %d writes", CHUNK_CNT);
+  for (i = 0; i < CHUNK_CNT; i++)
+    if (aio_wait (ids[i]) != CHUNK)
+      fail ("write of chunk %d was short", i);
+  msg ("wait for writes");
+  CHECK (aio_wait (ids[0]) == -1, "wait again fails");
+
+  for (i = 0; i < CHUNK_CNT; i++)
+    if ((ids[i] = aio_read (fd, dst + i * CHUNK, CHUNK, i * CHUNK)) < 0)
+      fail ("aio_read of chunk %d failed", i);
+  msg ("start %d reads", CHUNK_CNT);
+  for (i = CHUNK_CNT - 1; i >= 0; i--)
+    if (aio_wait (ids[i]) != CHUNK)
+      fail ("read of chunk %d was short", i);
+  msg ("wait for reads");
+  if (memcmp (src, dst, sizeof src))
+    fail ("data read differs from data written");
+  msg ("data read matches");
+  close (fd);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(aio-rw) begin
+(aio-rw) create "aio"
+(aio-rw) open "aio"
+(aio-rw) start 4 writes
+(aio-rw) wait for writes
+(aio-rw) wait again fails
+(aio-rw) start 4 reads
+(aio-rw) wait for reads
+(aio-rw) data read matches
+(aio-rw) end
+aio-rw: exit(0)
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Opens the same file many times, which must hand out a distinct
+   file descriptor each time, then closes one of them and checks
+   that the next open reuses the freed descriptor. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define OPEN_CNT 200
+
+static int handles[OPEN_CNT];
+
+void
+test_main (void) 
+{
+  int i, freed, h;
+
+  for (i = 0; i < OPEN_CNT; i++) 
+    {
+      handles[i] = open ("sample.txt");
+      if (handles[i] < 2)
+        fail ("open #%d returned %d", i, handles[i]);
+      if (i > 0 && handles[i] <= handles[i - 1])
+        fail ("open #%d returned %d after %d", i, handles[i], handles[i - 1]);
+    }
+  msg ("opened \"sample.txt\" %d times", OPEN_CNT);
+
+  freed = handles[OPEN_CNT / 2];
+  close (freed);
+  CHECK ((h = open ("sample.txt")) == freed,
+         "open \"sample.txt\" reuses closed fd");
+  CHECK (filesize (h) == (int) sizeof sample - 1,
+         "filesize of reopened fd");
+  CHECK (filesize (handles[OPEN_CNT - 1]) == (int) sizeof sample - 1,
+         "filesize of last fd");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-many) begin
+(open-many) opened "sample.txt" 200 times
+(open-many) open "sample.txt" reuses closed fd
+(open-many) filesize of reopened fd
+(open-many) filesize of last fd
+(open-many) end
+open-many: exit(0)
+EOF
+pass;
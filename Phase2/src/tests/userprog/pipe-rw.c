@@ -0,0 +1,42 @@
+/* Writes a few pages and then some through a pipe, from a
+   page-aligned buffer, reads it all back in odd-sized pieces, and
+   checks that closing the write end gives end of file.
+   This must succeed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (3 * 4096 + 100)
+
+static char src[SIZE] __attribute__ ((aligned (4096)));
+static char dst[SIZE];
+
+void
+test_main (void) 
+{
+  int fds[2];
+  size_t i, ofs;
+  int n;
+
+  for (i = 0; i < SIZE; i++)
+    src[i] = i % 251;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (write (fds[1], src, SIZE) == SIZE, "write %d bytes", SIZE);
+  for (ofs = 0; ofs < SIZE; ofs += n)
+    {
+      n = read (fds[0], dst + ofs, ofs + 777 < SIZE ? 777 : SIZE - ofs);
+      if (n <= 0)
+        fail ("read returned %d at offset %zu", n, ofs);
+    }
+  msg ("read %d bytes", SIZE);
+  if (memcmp (src, dst, SIZE))
+    fail ("data read differs from data written");
+  msg ("data read matches");
+
+  close (fds[1]);
+  CHECK (read (fds[0], dst, 1) == 0, "read after close of write end");
+  close (fds[0]);
+}
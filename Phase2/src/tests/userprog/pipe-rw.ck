@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pipe-rw) begin
+(pipe-rw) pipe
+(pipe-rw) write 12388 bytes
+(pipe-rw) read 12388 bytes
+(pipe-rw) data read matches
+(pipe-rw) read after close of write end
+(pipe-rw) end
+pipe-rw: exit(0)
+EOF
+pass;
@@ -0,0 +1,37 @@
+/* Checks that a nonblocking read of an empty pipe fails rather
+   than waiting, and that poll reports a pipe becoming readable
+   and then hung up once its write end is closed.
+   This must succeed. */
+
+#include <poll.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct pollfd pfd;
+  int fds[2];
+  char c;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (set_nonblock (fds[0], true), "set read end nonblocking");
+  CHECK (read (fds[0], &c, 1) == -1, "read of empty pipe fails");
+
+  pfd.fd = fds[0];
+  pfd.events = POLLIN;
+  CHECK (poll (&pfd, 1, 0) == 0, "poll of empty pipe");
+  CHECK (poll (&pfd, 1, 50) == 0, "poll of empty pipe times out");
+
+  CHECK (write (fds[1], "x", 1) == 1, "write 1 byte");
+  CHECK (poll (&pfd, 1, -1) == 1 && pfd.revents == POLLIN,
+         "poll after write");
+  CHECK (read (fds[0], &c, 1) == 1 && c == 'x', "read 1 byte");
+
+  close (fds[1]);
+  CHECK (poll (&pfd, 1, -1) == 1 && (pfd.revents & POLLHUP),
+         "poll after close of write end");
+  CHECK (read (fds[0], &c, 1) == 0, "read after close of write end");
+  close (fds[0]);
+}
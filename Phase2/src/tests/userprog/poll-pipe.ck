@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(poll-pipe) begin
+(poll-pipe) pipe
+(poll-pipe) set read end nonblocking
+(poll-pipe) read of empty pipe fails
+(poll-pipe) poll of empty pipe
+(poll-pipe) poll of empty pipe times out
+(poll-pipe) write 1 byte
+(poll-pipe) poll after write
+(poll-pipe) read 1 byte
+(poll-pipe) poll after close of write end
+(poll-pipe) read after close of write end
+(poll-pipe) end
+poll-pipe: exit(0)
+EOF
+pass;
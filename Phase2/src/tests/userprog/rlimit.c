@@ -0,0 +1,25 @@
+/* Lowers the limits on open files and on children and checks
+   that opening and exec then fail, and that a limit cannot be
+   raised again.
+   This must succeed. */
+
+#include <rlimit.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (getrlimit (RLIMIT_NOFILE) == RLIM_INFINITY, "no fd limit at first");
+  CHECK (setrlimit (RLIMIT_NOFILE, 3), "limit fds to 3");
+  CHECK (!setrlimit (RLIMIT_NOFILE, 4), "raise fd limit fails");
+  CHECK ((fd = open ("sample.txt")) == 2, "open \"sample.txt\" as fd 2");
+  CHECK (open ("sample.txt") == -1, "open it again fails");
+  close (fd);
+
+  CHECK (setrlimit (RLIMIT_NPROC, 0), "limit children to 0");
+  CHECK (exec ("child-simple") == -1, "exec fails");
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rlimit) begin
+(rlimit) no fd limit at first
+(rlimit) limit fds to 3
+(rlimit) raise fd limit fails
+(rlimit) open "sample.txt" as fd 2
+(rlimit) open it again fails
+(rlimit) limit children to 0
+(rlimit) exec fails
+(rlimit) end
+rlimit: exit(0)
+EOF
+pass;
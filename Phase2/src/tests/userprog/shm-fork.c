@@ -0,0 +1,55 @@
+/* Maps a shared memory object, forks, and checks that the
+   parent sees what the child stores through its inherited
+   mapping, and what a second mapping in the same process holds,
+   and that reading the object's fd gives the same bytes.
+   This must succeed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (2 * 4096)
+#define ADDR ((char *) 0x10000000)
+#define ADDR2 ((char *) 0x10100000)
+
+void
+test_main (void) 
+{
+  char buf[16];
+  pid_t child;
+  int fd;
+
+  CHECK ((fd = shm_open ("shm-fork", SIZE)) > 1, "shm_open \"shm-fork\"");
+  CHECK (shm_map (fd, ADDR) == ADDR, "shm_map");
+  strlcpy (ADDR, "from parent", SIZE);
+
+  child = fork ();
+  if (child == 0)
+    {
+      if (strcmp (ADDR, "from parent"))
+        fail ("child sees \"%s\"", ADDR);
+      strlcpy (ADDR + 4096, "from child", 4096);
+      exit (0);
+    }
+  CHECK (child > 0 && wait (child) == 0, "fork and wait for child");
+  if (strcmp (ADDR + 4096, "from child"))
+    fail ("parent sees \"%s\"", ADDR + 4096);
+  msg ("parent sees child's store");
+
+  CHECK (shm_map (fd, ADDR2) == ADDR2, "shm_map again");
+  if (strcmp (ADDR2, "from parent"))
+    fail ("second mapping holds \"%s\"", ADDR2);
+  msg ("second mapping matches");
+
+  seek (fd, 4096);
+  CHECK (read (fd, buf, sizeof buf) == sizeof buf, "read object");
+  if (strcmp (buf, "from child"))
+    fail ("object reads \"%s\"", buf);
+  msg ("object read matches");
+
+  CHECK (shm_unmap (ADDR), "shm_unmap");
+  CHECK (shm_unmap (ADDR2), "shm_unmap again");
+  CHECK (shm_unlink ("shm-fork"), "shm_unlink");
+  close (fd);
+}
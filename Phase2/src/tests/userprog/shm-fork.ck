@@ -0,0 +1,22 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-fork) begin
+(shm-fork) shm_open "shm-fork"
+(shm-fork) shm_map
+shm-fork: exit(0)
+(shm-fork) fork and wait for child
+(shm-fork) parent sees child's store
+(shm-fork) shm_map again
+(shm-fork) second mapping matches
+(shm-fork) read object
+(shm-fork) object read matches
+(shm-fork) shm_unmap
+(shm-fork) shm_unmap again
+(shm-fork) shm_unlink
+(shm-fork) end
+shm-fork: exit(0)
+EOF
+pass;
@@ -0,0 +1,44 @@
+/* Starts child-simple with its stdout on the write end of a pipe,
+   through spawn_fds(), and checks that what it prints comes out
+   of the read end while the parent's own stdout is left alone,
+   and that an entry naming an fd that is not open is refused.
+   This must succeed. */
+
+#include <spawn.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct spawn_fd map;
+  char buf[64];
+  int fds[2];
+  pid_t pid;
+  int n;
+
+  CHECK (pipe (fds) == 0, "pipe");
+  map.to = STDOUT_FILENO;
+  map.from = fds[1];
+  msg ("spawn \"child-simple\" on the pipe");
+  pid = spawn_fds ("child-simple", &map, 1);
+  if (pid == PID_ERROR)
+    fail ("spawn_fds failed");
+  close (fds[1]);
+  msg ("wait for child: %d", wait (pid));
+
+  n = read (fds[0], buf, sizeof buf - 1);
+  if (n <= 0)
+    fail ("read returned %d", n);
+  buf[n] = '\0';
+  CHECK (!strcmp (buf, "(child-simple) run\n"), "read child's output");
+  CHECK (read (fds[0], buf, 1) == 0, "read after child exited");
+  close (fds[0]);
+
+  map.from = 12;
+  CHECK (spawn_fds ("child-simple", &map, 1) == PID_ERROR,
+         "spawn_fds from a closed fd fails");
+}
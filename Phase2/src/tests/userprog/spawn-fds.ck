@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(spawn-fds) begin
+(spawn-fds) pipe
+(spawn-fds) spawn "child-simple" on the pipe
+child-simple: exit(81)
+(spawn-fds) wait for child: 81
+(spawn-fds) read child's output
+(spawn-fds) read after child exited
+(spawn-fds) spawn_fds from a closed fd fails
+(spawn-fds) end
+spawn-fds: exit(0)
+EOF
+pass;
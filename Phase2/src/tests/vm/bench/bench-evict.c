@@ -0,0 +1,41 @@
+/* Limits the process to BENCH_FRAMES user frames, then sweeps
+   over twice and four times as many heap pages, writing each, so
+   that nearly every touch evicts a dirty page and brings another
+   back from swap.  Reports the touches per tick at each level of
+   overcommit. */
+
+#include <rlimit.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/bench/bench.h"
+
+/* Timed sweeps over the pages at each level. */
+#define SWEEPS 4
+
+static void
+sweep (const char *name, int factor) 
+{
+  int pages = BENCH_FRAMES * factor;
+  char *base = bench_grow (pages);
+  int i;
+
+  /* The first pass brings in pages of zeros and fills swap. */
+  bench_touch (base, pages, true);
+
+  bench_start ();
+  for (i = 0; i < SWEEPS; i++)
+    bench_touch (base, pages, true);
+  bench_report (name, pages * SWEEPS, pages * SWEEPS * BENCH_PAGE);
+  bench_shrink (pages);
+}
+
+void
+test_main (void) 
+{
+  CHECK (setrlimit (RLIMIT_FRAMES, BENCH_FRAMES),
+         "limit frames to %d", BENCH_FRAMES);
+  sweep ("evict-2x", 2);
+  sweep ("evict-4x", 4);
+  stats ();
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-evict) begin
+(bench-evict) limit frames to 64
+(bench-evict) end
+EOF
+pass;
@@ -0,0 +1,58 @@
+/* Times page faults that bring in pages of a file mapped with
+   mmap(), pages of zeros that are written (anonymous memory), and
+   pages of zeros that are only read, which map the shared frame of
+   zeros. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/bench/bench.h"
+
+/* Pages brought in per round, and rounds per kind of fault. */
+#define PAGES 64
+#define ROUNDS 8
+
+void
+test_main (void) 
+{
+  const char *file_name = "mapped";
+  char *map_base = (char *) 0x10000000;
+  char *base;
+  int fd, i;
+
+  msg ("fill \"%s\"", file_name);
+  bench_fill (file_name, PAGES * BENCH_PAGE);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  bench_start ();
+  for (i = 0; i < ROUNDS; i++) 
+    {
+      mapid_t map = mmap (fd, map_base);
+      if (map == MAP_FAILED)
+        fail ("mmap \"%s\" failed", file_name);
+      bench_touch (map_base, PAGES, false);
+      munmap (map);
+    }
+  bench_report ("fault-file", PAGES * ROUNDS, PAGES * ROUNDS * BENCH_PAGE);
+  close (fd);
+
+  bench_start ();
+  for (i = 0; i < ROUNDS; i++) 
+    {
+      base = bench_grow (PAGES);
+      bench_touch (base, PAGES, true);
+      bench_shrink (PAGES);
+    }
+  bench_report ("fault-anon", PAGES * ROUNDS, PAGES * ROUNDS * BENCH_PAGE);
+
+  bench_start ();
+  for (i = 0; i < ROUNDS; i++) 
+    {
+      base = bench_grow (PAGES);
+      bench_touch (base, PAGES, false);
+      bench_shrink (PAGES);
+    }
+  bench_report ("fault-zero", PAGES * ROUNDS, PAGES * ROUNDS * BENCH_PAGE);
+
+  stats ();
+}
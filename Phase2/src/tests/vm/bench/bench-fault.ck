@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-fault) begin
+(bench-fault) fill "mapped"
+(bench-fault) open "mapped"
+(bench-fault) end
+EOF
+pass;
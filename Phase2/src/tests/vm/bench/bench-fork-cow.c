@@ -0,0 +1,48 @@
+/* Times fork() and wait() for a child that exits at once, with 16,
+   64, and 256 pages of written heap shared copy-on-write, then for
+   a child that writes all 64 pages, copying each. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/bench/bench.h"
+
+/* Children forked per measurement. */
+#define FORKS 8
+
+/* Forks FORKS children in turn with PAGES pages of heap, each of
+   which writes the first WRITE_PAGES of them and exits, and waits
+   for each, reporting the forks per tick as NAME. */
+static void
+fork_children (const char *name, int pages, int write_pages) 
+{
+  char *base = bench_grow (pages);
+  int i;
+
+  bench_touch (base, pages, true);
+
+  bench_start ();
+  for (i = 0; i < FORKS; i++) 
+    {
+      pid_t child = fork ();
+      if (child == 0) 
+        {
+          bench_touch (base, write_pages, true);
+          exit (0);
+        }
+      if (child < 0 || wait (child) != 0)
+        fail ("fork %d of %s failed", i, name);
+    }
+  bench_report (name, FORKS, FORKS * pages * BENCH_PAGE);
+  bench_shrink (pages);
+}
+
+void
+test_main (void) 
+{
+  fork_children ("fork-16", 16, 0);
+  fork_children ("fork-64", 64, 0);
+  fork_children ("fork-256", 256, 0);
+  fork_children ("fork-cow-64", 64, 64);
+  stats ();
+}
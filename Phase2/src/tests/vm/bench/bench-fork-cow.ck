@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-fork-cow) begin
+(bench-fork-cow) end
+EOF
+pass;
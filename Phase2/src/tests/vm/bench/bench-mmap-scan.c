@@ -0,0 +1,68 @@
+/* Scans a file from start to end, adding up its bytes, first
+   with read() into a buffer and then through a memory mapping,
+   and reports the bandwidth of each.  Each pass maps the file
+   afresh, so that the mapped scan pays for its page faults. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/bench/bench.h"
+
+/* Timed passes over the file with each method. */
+#define PASSES 4
+
+static char buf[BENCH_CHUNK];
+
+/* Returns the sum of the SIZE bytes at P. */
+static unsigned
+sum (const unsigned char *p, int size) 
+{
+  unsigned total = 0;
+  int i;
+
+  for (i = 0; i < size; i++)
+    total += p[i];
+  return total;
+}
+
+void
+test_main (void) 
+{
+  const char *file_name = "scan";
+  char *map_base = (char *) 0x10000000;
+  unsigned read_sum = 0, map_sum = 0;
+  int fd, ofs, i;
+
+  msg ("fill \"%s\"", file_name);
+  bench_fill (file_name, BENCH_FILE_SIZE);
+  CHECK ((fd = open (file_name)) > 1, "open \"%s\"", file_name);
+
+  bench_start ();
+  for (i = 0; i < PASSES; i++) 
+    {
+      seek (fd, 0);
+      for (ofs = 0; ofs < BENCH_FILE_SIZE; ofs += BENCH_CHUNK) 
+        {
+          if (read (fd, buf, BENCH_CHUNK) != BENCH_CHUNK)
+            fail ("read %d bytes at offset %d failed", BENCH_CHUNK, ofs);
+          read_sum += sum ((unsigned char *) buf, BENCH_CHUNK);
+        }
+    }
+  bench_report ("scan-read", PASSES, PASSES * BENCH_FILE_SIZE);
+
+  bench_start ();
+  for (i = 0; i < PASSES; i++) 
+    {
+      mapid_t map = mmap (fd, map_base);
+      if (map == MAP_FAILED)
+        fail ("mmap \"%s\" failed", file_name);
+      map_sum += sum ((unsigned char *) map_base, BENCH_FILE_SIZE);
+      munmap (map);
+    }
+  bench_report ("scan-mmap", PASSES, PASSES * BENCH_FILE_SIZE);
+
+  if (map_sum != read_sum)
+    fail ("mapped scan summed to %u, read() to %u", map_sum, read_sum);
+  close (fd);
+  stats ();
+}
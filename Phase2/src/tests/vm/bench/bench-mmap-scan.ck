@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-mmap-scan) begin
+(bench-mmap-scan) fill "scan"
+(bench-mmap-scan) open "scan"
+(bench-mmap-scan) end
+EOF
+pass;
@@ -0,0 +1,38 @@
+/* Limits the process to BENCH_FRAMES user frames and writes four
+   times as many heap pages, leaving most of them in swap, then
+   times reading them back in order.  Each read brings in a page
+   from swap, so the ticks per operation are the swap-in latency,
+   evictions of clean pages included. */
+
+#include <rlimit.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+#include "tests/vm/bench/bench.h"
+
+#define PAGES (BENCH_FRAMES * 4)
+
+/* Timed passes over the pages. */
+#define PASSES 2
+
+void
+test_main (void) 
+{
+  char *base;
+  int i, j;
+
+  CHECK (setrlimit (RLIMIT_FRAMES, BENCH_FRAMES),
+         "limit frames to %d", BENCH_FRAMES);
+  base = bench_grow (PAGES);
+  for (i = 0; i < PAGES; i++)
+    *(int *) (base + i * BENCH_PAGE) = i;
+
+  bench_start ();
+  for (j = 0; j < PASSES; j++)
+    for (i = 0; i < PAGES; i++)
+      if (*(volatile int *) (base + i * BENCH_PAGE) != i)
+        fail ("page %d read back wrong", i);
+  bench_report ("swap-in", PAGES * PASSES, PAGES * PASSES * BENCH_PAGE);
+
+  stats ();
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_bench ([<<'EOF']);
+(bench-swap-in) begin
+(bench-swap-in) limit frames to 64
+(bench-swap-in) end
+EOF
+pass;
@@ -0,0 +1,105 @@
+/* Timing, reporting, and memory helpers shared by the virtual
+   memory benchmarks.
+
+   As in the file system benchmarks, each measured phase is timed
+   in timer ticks and reported on a line of the form
+     (TEST) bench: NAME: OPS ops, BYTES bytes, TICKS ticks, ...
+   Each benchmark then calls stats(), which prints the kernel's
+   counters, such as the page faults of each kind and the frames
+   reclaimed.  check_bench() in tests/tests.pm ignores both when
+   matching output and checks them against the bounds in
+   tests/vm/bench/thresholds.  The counters cover the whole run,
+   from boot. */
+
+#include "tests/vm/bench/bench.h"
+#include <random.h>
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+
+static int start;
+static char chunk[BENCH_CHUNK];
+
+/* Starts timing a measured phase. */
+void
+bench_start (void) 
+{
+  start = uptime ();
+}
+
+/* Reports that the phase started by bench_start() did OPS
+   operations moving BYTES bytes.  A phase that took less than a
+   tick is counted as one tick. */
+void
+bench_report (const char *name, int ops, int bytes) 
+{
+  int ticks = uptime () - start;
+  int divisor = ticks > 0 ? ticks : 1;
+
+  msg ("bench: %s: %d ops, %d bytes, %d ticks, %d ops/tick, %d bytes/tick",
+       name, ops, bytes, ticks, ops / divisor, bytes / divisor);
+}
+
+/* Creates FILE_NAME holding SIZE bytes of pseudo-random data,
+   without timing it. */
+void
+bench_fill (const char *file_name, int size) 
+{
+  int fd;
+  int ofs;
+
+  if (!create (file_name, 0))
+    fail ("create \"%s\"", file_name);
+  if ((fd = open (file_name)) < 2)
+    fail ("open \"%s\"", file_name);
+  random_init (0);
+  for (ofs = 0; ofs < size; ofs += BENCH_CHUNK) 
+    {
+      int n = size - ofs < BENCH_CHUNK ? size - ofs : BENCH_CHUNK;
+      random_bytes (chunk, n);
+      if (write (fd, chunk, n) != n)
+        fail ("write %d bytes at offset %d in \"%s\"", n, ofs, file_name);
+    }
+  close (fd);
+}
+
+/* Moves the break up to a page boundary, then PAGES pages past
+   it, and returns the first of those pages.  They are pages of
+   zeros that have not been touched yet. */
+char *
+bench_grow (int pages) 
+{
+  uintptr_t brk = (uintptr_t) sbrk (0);
+  char *base;
+
+  if (brk % BENCH_PAGE != 0
+      && sbrk (BENCH_PAGE - brk % BENCH_PAGE) == (void *) -1)
+    fail ("sbrk to a page boundary failed");
+  base = sbrk (pages * BENCH_PAGE);
+  if (base == (void *) -1)
+    fail ("sbrk %d pages failed", pages);
+  return base;
+}
+
+/* Gives back the last PAGES pages of the heap. */
+void
+bench_shrink (int pages) 
+{
+  if (sbrk (-pages * BENCH_PAGE) == (void *) -1)
+    fail ("sbrk -%d pages failed", pages);
+}
+
+/* Touches one byte of each of the PAGES pages starting at BASE,
+   writing it if WRITE is true and reading it otherwise. */
+void
+bench_touch (char *base, int pages, bool write) 
+{
+  volatile char *p = base;
+  int i;
+
+  for (i = 0; i < pages; i++)
+    if (write)
+      p[i * BENCH_PAGE] = i;
+    else
+      (void) p[i * BENCH_PAGE];
+}
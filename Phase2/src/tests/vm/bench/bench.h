@@ -0,0 +1,26 @@
+#ifndef TESTS_VM_BENCH_BENCH_H
+#define TESTS_VM_BENCH_BENCH_H
+
+#include <stdbool.h>
+
+/* Bytes in a page. */
+#define BENCH_PAGE 4096
+
+/* Size of the files the benchmarks map and read, and of the
+   chunks they read them in. */
+#define BENCH_FILE_SIZE (256 * 1024)
+#define BENCH_CHUNK 4096
+
+/* User frames the eviction and swap benchmarks limit themselves
+   to with RLIMIT_FRAMES, so that they overcommit memory by the
+   same factor whatever the size of the user pool. */
+#define BENCH_FRAMES 64
+
+void bench_start (void);
+void bench_report (const char *name, int ops, int bytes);
+void bench_fill (const char *file_name, int size);
+char *bench_grow (int pages);
+void bench_shrink (int pages);
+void bench_touch (char *base, int pages, bool write);
+
+#endif /* tests/vm/bench/bench.h */
@@ -0,0 +1,52 @@
+/* Fills some memory and moves a file's position, checkpoints the
+   process, then clears the memory and restores the image as a
+   new process, which must resume from checkpoint() with the
+   memory and position as they were. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define WARM_SIZE (3 * 4096)
+
+static char warm[WARM_SIZE];
+
+void
+test_main (void)
+{
+  int data, image, result, status;
+  pid_t pid;
+  size_t i;
+
+  for (i = 0; i < sizeof warm; i++)
+    warm[i] = i * 13 + i / 4096;
+  CHECK (create ("data", 100), "create \"data\"");
+  CHECK ((data = open ("data")) > 1, "open \"data\"");
+  seek (data, 42);
+  CHECK (create ("image", 0), "create \"image\"");
+  CHECK ((image = open ("image")) > 1, "open \"image\"");
+
+  msg ("checkpoint");
+  result = checkpoint (image);
+  if (result == 1)
+    {
+      /* The restored process. */
+      msg ("restored: checkpoint returned 1");
+      for (i = 0; i < sizeof warm; i++)
+        if (warm[i] != (char) (i * 13 + i / 4096))
+          fail ("restored: byte %zu of warm state differs", i);
+      msg ("restored: warm state intact");
+      CHECK (tell (data) == 42, "restored: position in \"data\"");
+      exit (81);
+    }
+  CHECK (result == 0, "checkpoint returned 0");
+  close (image);
+
+  memset (warm, 0, sizeof warm);
+  seek (data, 0);
+  CHECK ((pid = restore ("image")) != PID_ERROR, "restore \"image\"");
+  status = wait (pid);
+  CHECK (status == 81, "restored process exited with 81");
+  CHECK (tell (data) == 0, "position in \"data\" unchanged here");
+}
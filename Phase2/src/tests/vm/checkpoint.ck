@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(checkpoint) begin
+(checkpoint) create "data"
+(checkpoint) open "data"
+(checkpoint) create "image"
+(checkpoint) open "image"
+(checkpoint) checkpoint
+(checkpoint) checkpoint returned 0
+(checkpoint) restore "image"
+(checkpoint) restored: checkpoint returned 1
+(checkpoint) restored: warm state intact
+(checkpoint) restored: position in "data"
+(checkpoint) restored process exited with 81
+(checkpoint) position in "data" unchanged here
+(checkpoint) end
+EOF
+pass;
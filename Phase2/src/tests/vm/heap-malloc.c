@@ -0,0 +1,109 @@
+/* Grows and shrinks the heap with sbrk(), then allocates, resizes
+   and frees blocks of many sizes with malloc() and checks that
+   none of them overlap.
+   This must succeed. */
+
+#include <malloc.h>
+#include <random.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define BLOCK_CNT 256
+
+static char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Fills block I with a pattern of its own. */
+static void
+fill (size_t i)
+{
+  memset (blocks[i], (int) i, sizes[i]);
+}
+
+/* Checks that block I still holds its pattern. */
+static void
+verify (size_t i)
+{
+  size_t j;
+
+  for (j = 0; j < sizes[i]; j++)
+    if (blocks[i][j] != (char) i)
+      fail ("block %zu of %zu bytes corrupted at byte %zu",
+            i, sizes[i], j);
+}
+
+/* Returns a random block size, mostly small, sometimes large. */
+static size_t
+random_size (void)
+{
+  return (random_ulong () % 8 == 0
+          ? random_ulong () % 20000 + 1
+          : random_ulong () % 1024 + 1);
+}
+
+void
+test_main (void)
+{
+  char *start, *p;
+  size_t i, round;
+
+  start = sbrk (0);
+  CHECK (start != (void *) -1, "sbrk (0)");
+  CHECK (sbrk (8192) == start, "sbrk (8192)");
+  memset (start, 0x5a, 8192);
+  CHECK (sbrk (0) == start + 8192, "break moved up 8192 bytes");
+  CHECK (sbrk (-8192) == start + 8192, "sbrk (-8192)");
+  CHECK (sbrk (-4096) == (void *) -1, "sbrk below the heap fails");
+  CHECK (sbrk (0x7fffffff) == (void *) -1, "sbrk into the stack fails");
+  CHECK (sbrk (4096) == start, "sbrk (4096)");
+  CHECK (start[0] == 0, "page given back and regrown is zeroed");
+  CHECK (sbrk (-4096) == start + 4096, "sbrk (-4096)");
+
+  random_init (0);
+  for (round = 0; round < 4; round++)
+    {
+      for (i = 0; i < BLOCK_CNT; i++)
+        if (blocks[i] == NULL)
+          {
+            sizes[i] = random_size ();
+            blocks[i] = malloc (sizes[i]);
+            if (blocks[i] == NULL)
+              fail ("malloc (%zu) failed", sizes[i]);
+            fill (i);
+          }
+      for (i = 0; i < BLOCK_CNT; i++)
+        verify (i);
+      for (i = 0; i < BLOCK_CNT; i++)
+        switch (random_ulong () % 3)
+          {
+          case 0:
+            free (blocks[i]);
+            blocks[i] = NULL;
+            break;
+          case 1:
+            {
+              size_t size = random_size ();
+              p = realloc (blocks[i], size);
+              if (p == NULL)
+                fail ("realloc (%zu) failed", size);
+              blocks[i] = p;
+              if (size < sizes[i])
+                sizes[i] = size;
+              verify (i);
+              sizes[i] = size;
+              fill (i);
+            }
+            break;
+          }
+    }
+  msg ("allocated, resized and freed blocks without overlap");
+
+  p = calloc (100, 100);
+  CHECK (p != NULL, "calloc (100, 100)");
+  for (i = 0; i < 100 * 100; i++)
+    if (p[i] != 0)
+      fail ("calloc'd byte %zu is nonzero", i);
+  free (p);
+}
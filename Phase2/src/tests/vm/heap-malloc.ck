@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(heap-malloc) begin
+(heap-malloc) sbrk (0)
+(heap-malloc) sbrk (8192)
+(heap-malloc) break moved up 8192 bytes
+(heap-malloc) sbrk (-8192)
+(heap-malloc) sbrk below the heap fails
+(heap-malloc) sbrk into the stack fails
+(heap-malloc) sbrk (4096)
+(heap-malloc) page given back and regrown is zeroed
+(heap-malloc) sbrk (-4096)
+(heap-malloc) allocated, resized and freed blocks without overlap
+(heap-malloc) calloc (100, 100)
+(heap-malloc) end
+EOF
+pass;
@@ -0,0 +1,49 @@
+/* Reads whole pages of a file into a page-aligned buffer, which
+   maps the page cache's frames there, then checks that writing
+   the file does not change the buffer and that writing the
+   buffer does not change the file. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE_CNT 4
+#define PAGE_SIZE 4096
+
+static char buf[PAGE_CNT * PAGE_SIZE] __attribute__ ((aligned (PAGE_SIZE)));
+static char data[PAGE_CNT * PAGE_SIZE];
+
+void
+test_main (void)
+{
+  static char check[PAGE_CNT * PAGE_SIZE];
+  size_t i;
+  int handle;
+
+  for (i = 0; i < sizeof data; i++)
+    data[i] = i * 7 + i / PAGE_SIZE;
+  CHECK (create ("data", sizeof data), "create \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\"");
+  CHECK (write (handle, data, sizeof data) == (int) sizeof data,
+         "write \"data\"");
+
+  seek (handle, 0);
+  CHECK (read (handle, buf, sizeof buf) == (int) sizeof buf,
+         "read \"data\"");
+  CHECK (!memcmp (buf, data, sizeof buf), "compare read data");
+
+  /* The buffer keeps what was read. */
+  seek (handle, 0);
+  memset (check, 'x', sizeof check);
+  CHECK (write (handle, check, sizeof check) == (int) sizeof check,
+         "overwrite \"data\"");
+  CHECK (!memcmp (buf, data, sizeof buf), "buffer unchanged by write");
+
+  /* The file keeps what was written. */
+  memset (buf + PAGE_SIZE, 'y', PAGE_SIZE);
+  CHECK (pread (handle, data, sizeof data, 0) == (int) sizeof data,
+         "pread \"data\"");
+  CHECK (!memcmp (data, check, sizeof data), "file unchanged by store");
+  close (handle);
+}
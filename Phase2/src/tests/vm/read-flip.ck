@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(read-flip) begin
+(read-flip) create "data"
+(read-flip) open "data"
+(read-flip) write "data"
+(read-flip) read "data"
+(read-flip) compare read data
+(read-flip) overwrite "data"
+(read-flip) buffer unchanged by write
+(read-flip) pread "data"
+(read-flip) file unchanged by store
+(read-flip) end
+EOF
+pass;
@@ -0,0 +1,60 @@
+/* Starts several threads in the process with thread_spawn(), each
+   of which fills a buffer on its own stack and leaves a sum of it
+   in memory the threads share, then joins them all and checks
+   their sums.
+   This must succeed. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 8
+
+static int sums[THREAD_CNT];
+
+/* Sums a stack buffer that spans several pages, filled with a
+   pattern that depends on the thread's index, which IDX_ points
+   to. */
+static void
+worker (void *idx_)
+{
+  int idx = *(int *) idx_;
+  unsigned char buf[3 * 4096];
+  size_t i;
+  int sum = 0;
+
+  memset (buf, idx + 1, sizeof buf);
+  for (i = 0; i < sizeof buf; i++)
+    sum += buf[i];
+  sums[idx] = sum;
+}
+
+void
+test_main (void)
+{
+  static int idx[THREAD_CNT];
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      idx[i] = i;
+      tids[i] = thread_spawn (worker, &idx[i]);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_spawn %d failed", i);
+    }
+  msg ("spawned %d threads", THREAD_CNT);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    if (thread_join (tids[i]) != 0)
+      fail ("thread_join %d failed", i);
+  msg ("joined %d threads", THREAD_CNT);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    if (sums[i] != (i + 1) * 3 * 4096)
+      fail ("thread %d summed %d", i, sums[i]);
+  msg ("every thread's sum is right");
+
+  CHECK (thread_join (tids[0]) == -1, "joining a joined thread fails");
+}
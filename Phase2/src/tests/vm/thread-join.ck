@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(thread-join) begin
+(thread-join) spawned 8 threads
+(thread-join) joined 8 threads
+(thread-join) every thread's sum is right
+(thread-join) joining a joined thread fails
+(thread-join) end
+EOF
+pass;
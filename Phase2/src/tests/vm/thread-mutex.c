@@ -0,0 +1,68 @@
+/* Has several threads increment a shared counter under a mutex,
+   yielding the processor inside the critical section so that the
+   others contend for it, and then waits on a condition variable
+   for the last of them to finish.
+   This must succeed. */
+
+#include <sync.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define THREAD_CNT 4
+#define ITER_CNT 2000
+
+static struct mutex mutex = MUTEX_INITIALIZER;
+static struct condvar all_done = CONDVAR_INITIALIZER;
+static int counter;
+static int done_cnt;
+
+static void
+worker (void *aux UNUSED)
+{
+  int i;
+
+  for (i = 0; i < ITER_CNT; i++)
+    {
+      int old;
+
+      mutex_lock (&mutex);
+      old = counter;
+      if (i % 100 == 0)
+        uptime ();              /* Some chance of being preempted. */
+      counter = old + 1;
+      mutex_unlock (&mutex);
+    }
+
+  mutex_lock (&mutex);
+  if (++done_cnt == THREAD_CNT)
+    condvar_signal (&all_done);
+  mutex_unlock (&mutex);
+}
+
+void
+test_main (void)
+{
+  tid_t tids[THREAD_CNT];
+  int i;
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      tids[i] = thread_spawn (worker, NULL);
+      if (tids[i] == TID_ERROR)
+        fail ("thread_spawn %d failed", i);
+    }
+
+  mutex_lock (&mutex);
+  while (done_cnt < THREAD_CNT)
+    condvar_wait (&all_done, &mutex);
+  mutex_unlock (&mutex);
+  msg ("all threads done");
+
+  for (i = 0; i < THREAD_CNT; i++)
+    if (thread_join (tids[i]) != 0)
+      fail ("thread_join %d failed", i);
+  if (counter != THREAD_CNT * ITER_CNT)
+    fail ("counter is %d, not %d", counter, THREAD_CNT * ITER_CNT);
+  msg ("counter is %d", counter);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(thread-mutex) begin
+(thread-mutex) all threads done
+(thread-mutex) counter is 8000
+(thread-mutex) end
+EOF
+pass;
@@ -0,0 +1,52 @@
+/* Runs user-level threads on two kernel threads.  One reads from
+   an empty pipe, which blocks the kernel thread it is on, so that
+   the other kernel thread has to be woken to run the thread that
+   yields a number of times and then writes what the reader is
+   waiting for.
+   This must succeed. */
+
+#include <syscall.h>
+#include <uthread.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define YIELD_CNT 100
+
+static int fds[2];
+static int yields;
+
+static void
+reader (void *aux UNUSED)
+{
+  char c;
+
+  if (read (fds[0], &c, 1) != 1)
+    fail ("read failed");
+  msg ("read '%c' after %d yields", c, yields);
+}
+
+static void
+writer (void *aux UNUSED)
+{
+  for (yields = 0; yields < YIELD_CNT; yields++)
+    uthread_yield ();
+  if (write (fds[1], "x", 1) != 1)
+    fail ("write failed");
+}
+
+static void
+start (void *aux UNUSED)
+{
+  if (uthread_create (reader, NULL) == NULL)
+    fail ("uthread_create reader failed");
+  if (uthread_create (writer, NULL) == NULL)
+    fail ("uthread_create writer failed");
+}
+
+void
+test_main (void)
+{
+  CHECK (pipe (fds) == 0, "pipe");
+  CHECK (uthread_main (2, start, NULL) == 0, "uthread_main");
+  msg ("all threads done");
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(uthread-block) begin
+(uthread-block) pipe
+(uthread-block) uthread_main
+(uthread-block) read 'x' after 100 yields
+(uthread-block) all threads done
+(uthread-block) end
+EOF
+pass;
@@ -0,0 +1,397 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Lazy FPU context switching.
+
+   The x87 FPU and SSE registers are saved and restored with
+   FXSAVE and FXRSTOR [IA32-v2a], or, on a processor without
+   them, just the x87 registers with FNSAVE and FRSTOR, but only
+   for threads that use them.  A thread switch never touches
+   them.  Instead it sets CR0.TS whenever the thread switched to
+   is not the one whose state is in the registers, the "owner",
+   so that the first FPU or SSE instruction the new thread
+   executes raises #NM [IA32-v3a] 12.5 "Using the TS Flag".  The
+   #NM handler calls fpu_claim(), which saves the owner's
+   registers in the owner's save area, loads the running
+   thread's, and makes it the owner.  A thread that never uses
+   the FPU never gets a save area and never costs a save or
+   restore.
+
+   The kernel is compiled with -msoft-float and uses the FPU only
+   in the SSE2 page copy and zero routines below, which it hands
+   to memcpy() and memset() if the processor has SSE2 and
+   FXSAVE.  They save the owner's state first, so that the owner
+   reloads it on its next #NM.  They run with interrupts off, so
+   they take only kernel pages, which cannot fault, and decline
+   user pages. */
+
+/* FXSAVE area, [IA32-v2a] "FXSAVE".  Only the control words need
+   names here. */
+struct fxsave
+  {
+    uint16_t fcw;               /* x87 control word. */
+    uint8_t reserved0[22];
+    uint32_t mxcsr;             /* SSE control and status. */
+    uint8_t reserved1[484];
+  };
+
+/* FNSAVE area, [IA32-v1] 8.1.10 "Saving the x87 FPU's State
+   with FSTENV/FNSTENV and FSAVE/FNSAVE", in 32-bit protected
+   mode, kept in the same save area as a struct fxsave when the
+   processor lacks FXSAVE. */
+struct fsave
+  {
+    uint16_t fcw;               /* x87 control word. */
+    uint16_t reserved0[3];
+    uint16_t ftw;               /* x87 tag word. */
+    uint8_t reserved1[98];
+  };
+
+/* Required alignment of a struct fxsave. */
+#define FXSAVE_ALIGN 16
+
+/* Control word values after FNINIT and at processor reset. */
+#define FCW_DEFAULT 0x037f
+#define MXCSR_DEFAULT 0x1f80
+#define FTW_EMPTY 0xffff        /* Every x87 register empty. */
+
+/* CPUID leaf 1 EDX bits.  See [IA32-v2a] "CPUID". */
+#define CPUID_FXSR (1u << 24)   /* FXSAVE and FXRSTOR. */
+#define CPUID_SSE (1u << 25)
+#define CPUID_SSE2 (1u << 26)
+
+/* CR0 and CR4 bits.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR0_MP (1u << 1)        /* Monitor coprocessor: WAIT honors TS. */
+#define CR0_EM (1u << 2)        /* Emulation: no FPU present. */
+#define CR0_TS (1u << 3)        /* Task switched: FPU use raises #NM. */
+#define CR0_NE (1u << 5)        /* Report FPU errors as #MF. */
+#define CR4_OSFXSR (1u << 9)    /* FXSAVE, FXRSTOR and SSE enabled. */
+#define CR4_OSXMMEXCPT (1u << 10) /* Report SSE errors as #XF. */
+
+/* Save areas, with room to align them. */
+static struct kmem_cache *fpu_cache;
+
+/* Thread whose state is in the FPU registers, or a null pointer
+   if none's is.  Accessed with interrupts off. */
+static struct thread *fpu_owner;
+
+/* Whether the processor has FXSAVE and FXRSTOR.  If not, save
+   areas hold a struct fsave instead, and SSE stays off. */
+static bool has_fxsr;
+
+/* Returns T's save area, aligned within the block T->fpu points
+   to. */
+static struct fxsave *
+fpu_area (const struct thread *t)
+{
+  ASSERT (t->fpu != NULL);
+  return (struct fxsave *) ROUND_UP ((uintptr_t) t->fpu, FXSAVE_ALIGN);
+}
+
+static inline void
+fxsave (struct fxsave *area)
+{
+  asm volatile ("fxsave %0" : "=m" (*area));
+}
+
+static inline void
+fxrstor (const struct fxsave *area)
+{
+  asm volatile ("fxrstor %0" : : "m" (*area));
+}
+
+/* Saves the FPU registers in T's save area.  Without FXSAVE,
+   FNSAVE also reinitializes the FPU, so the registers no longer
+   hold T's state afterward. */
+static void
+fpu_save (struct thread *t)
+{
+  if (has_fxsr)
+    fxsave (fpu_area (t));
+  else
+    {
+      struct fsave *area = (struct fsave *) fpu_area (t);
+      asm volatile ("fnsave %0" : "=m" (*area));
+    }
+}
+
+/* Loads the FPU registers from T's save area. */
+static void
+fpu_restore (const struct thread *t)
+{
+  if (has_fxsr)
+    fxrstor (fpu_area (t));
+  else
+    {
+      const struct fsave *area = (const struct fsave *) fpu_area (t);
+      asm volatile ("frstor %0" : : "m" (*area));
+    }
+}
+
+/* Whether CR0.TS is set, as last left by clts() or stts().
+   Writing CR0 serializes the CPU, so fpu_switch() does it only
+   when the bit has to change. */
+static bool ts_set;
+
+static inline void
+clts (void)
+{
+  asm volatile ("clts");
+  ts_set = false;
+}
+
+static inline void
+stts (void)
+{
+  uint32_t cr0;
+  asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+  asm volatile ("movl %0, %%cr0" : : "r" (cr0 | CR0_TS));
+  ts_set = true;
+}
+
+static bool sse2_copy_page (void *dst, const void *src);
+static bool sse2_zero_page (void *dst);
+
+/* Enables the FPU, and SSE if the processor has it, and makes
+   the first use of either raise #NM.  Must be called after
+   malloc_init(). */
+void
+fpu_init (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  uint32_t cr0, cr4;
+
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (1));
+  has_fxsr = (edx & CPUID_FXSR) != 0;
+
+  asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+  cr0 = (cr0 & ~CR0_EM) | CR0_MP | CR0_NE;
+  asm volatile ("movl %0, %%cr0" : : "r" (cr0));
+
+  /* Setting a CR4 bit the processor does not support raises #GP,
+     and SSE is usable only with FXSAVE to save it. */
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  if (has_fxsr)
+    cr4 |= CR4_OSFXSR;
+  if (has_fxsr && (edx & CPUID_SSE))
+    cr4 |= CR4_OSXMMEXCPT;
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+
+  fpu_cache = kmem_cache_create ("fpu",
+                                 sizeof (struct fxsave) + FXSAVE_ALIGN - 1);
+  stts ();
+
+  if (has_fxsr && (edx & CPUID_SSE) && (edx & CPUID_SSE2))
+    {
+      memcpy_page_fn = sse2_copy_page;
+      memzero_page_fn = sse2_zero_page;
+    }
+}
+
+/* Called by thread_schedule_tail(), with interrupts off, as
+   thread T starts running.  Lets T use the FPU freely if its
+   state is already loaded, and makes its first use trap
+   otherwise. */
+void
+fpu_switch (struct thread *t)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t == fpu_owner)
+    {
+      if (ts_set)
+        clts ();
+    }
+  else if (!ts_set)
+    stts ();
+}
+
+/* Handles #NM for the running thread: saves the previous owner's
+   FPU state, loads the running thread's, giving it a fresh one
+   the first time, and lets it use the FPU until the next thread
+   switch.  Returns false if memory for its save area ran out.
+   Interrupts must be on. */
+bool
+fpu_claim (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (cur->fpu == NULL)
+    {
+      /* Start from the state FNINIT gives, with SSE registers
+         cleared too, so nothing leaks from the last owner. */
+      struct fxsave *area;
+
+      cur->fpu = kmem_cache_alloc (fpu_cache);
+      if (cur->fpu == NULL)
+        return false;
+      area = fpu_area (cur);
+      memset (area, 0, sizeof *area);
+      if (has_fxsr)
+        {
+          area->fcw = FCW_DEFAULT;
+          area->mxcsr = MXCSR_DEFAULT;
+        }
+      else
+        {
+          struct fsave *fs = (struct fsave *) area;
+          fs->fcw = FCW_DEFAULT;
+          fs->ftw = FTW_EMPTY;
+        }
+    }
+
+  old_level = intr_disable ();
+  clts ();
+  if (fpu_owner != cur)
+    {
+      if (fpu_owner != NULL)
+        fpu_save (fpu_owner);
+      fpu_restore (cur);
+      fpu_owner = cur;
+    }
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Gives the running thread, just forked from PARENT, a copy of
+   PARENT's FPU state, if it has any.  Returns false if memory
+   ran out. */
+bool
+fpu_fork (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (parent->fpu == NULL)
+    return true;
+  cur->fpu = kmem_cache_alloc (fpu_cache);
+  if (cur->fpu == NULL)
+    return false;
+
+  /* PARENT's state may still be in the registers, which we may
+     read, although not use, by clearing TS for a moment. */
+  old_level = intr_disable ();
+  if (fpu_owner == parent)
+    {
+      clts ();
+      fpu_save (parent);
+      if (!has_fxsr)
+        fpu_owner = NULL;
+      stts ();
+    }
+  memcpy (fpu_area (cur), fpu_area (parent), sizeof (struct fxsave));
+  intr_set_level (old_level);
+  return true;
+}
+
+/* Lets the kernel use the SSE registers until fpu_kernel_end(),
+   saving the owner's state, if any, where the owner will reload
+   it from.  Returns the interrupt level to restore; interrupts
+   are off in between, so no thread switch can see the registers
+   in use. */
+static enum intr_level
+fpu_kernel_begin (void)
+{
+  enum intr_level old_level = intr_disable ();
+
+  clts ();
+  if (fpu_owner != NULL)
+    {
+      fpu_save (fpu_owner);
+      fpu_owner = NULL;
+    }
+  return old_level;
+}
+
+/* Ends a section started by fpu_kernel_begin(). */
+static void
+fpu_kernel_end (enum intr_level old_level)
+{
+  stts ();
+  intr_set_level (old_level);
+}
+
+/* Copies the page at SRC to DST, both page-aligned, 64 bytes at
+   a time through the SSE registers.  Returns false, copying
+   nothing, if either is a user address. */
+static bool
+sse2_copy_page (void *dst, const void *src)
+{
+  enum intr_level old_level;
+  int i;
+
+  if (is_user_vaddr (dst) || is_user_vaddr (src))
+    return false;
+
+  old_level = fpu_kernel_begin ();
+  for (i = 0; i < STRING_PAGE_SIZE; i += 64)
+    asm volatile ("movdqa 0(%1), %%xmm0\n\t"
+                  "movdqa 16(%1), %%xmm1\n\t"
+                  "movdqa 32(%1), %%xmm2\n\t"
+                  "movdqa 48(%1), %%xmm3\n\t"
+                  "movdqa %%xmm0, 0(%0)\n\t"
+                  "movdqa %%xmm1, 16(%0)\n\t"
+                  "movdqa %%xmm2, 32(%0)\n\t"
+                  "movdqa %%xmm3, 48(%0)"
+                  : : "r" ((char *) dst + i), "r" ((const char *) src + i)
+                  : "memory");
+  fpu_kernel_end (old_level);
+  return true;
+}
+
+/* Zeroes the page-aligned page at DST, 64 bytes at a time through
+   the SSE registers.  Returns false, zeroing nothing, if DST is a
+   user address. */
+static bool
+sse2_zero_page (void *dst)
+{
+  enum intr_level old_level;
+  int i;
+
+  if (is_user_vaddr (dst))
+    return false;
+
+  old_level = fpu_kernel_begin ();
+  asm volatile ("pxor %xmm0, %xmm0");
+  for (i = 0; i < STRING_PAGE_SIZE; i += 64)
+    asm volatile ("movdqa %%xmm0, 0(%0)\n\t"
+                  "movdqa %%xmm0, 16(%0)\n\t"
+                  "movdqa %%xmm0, 32(%0)\n\t"
+                  "movdqa %%xmm0, 48(%0)"
+                  : : "r" ((char *) dst + i) : "memory");
+  fpu_kernel_end (old_level);
+  return true;
+}
+
+/* Releases the running thread's FPU state.  Called by
+   thread_exit() before the thread stops running. */
+void
+fpu_exit (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (cur->fpu == NULL)
+    return;
+
+  old_level = intr_disable ();
+  if (fpu_owner == cur)
+    {
+      fpu_owner = NULL;
+      stts ();
+    }
+  intr_set_level (old_level);
+
+  kmem_cache_free (fpu_cache, cur->fpu);
+  cur->fpu = NULL;
+}
@@ -0,0 +1,14 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+
+struct thread;
+
+void fpu_init (void);
+void fpu_switch (struct thread *);
+bool fpu_claim (void);
+bool fpu_fork (struct thread *parent);
+void fpu_exit (void);
+
+#endif /* threads/fpu.h */
@@ -2,30 +2,45 @@
 #include <console.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <klog.h>
 #include <limits.h>
 #include <random.h>
+#include <stats.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "devices/clock.h"
 #include "devices/kbd.h"
 #include "devices/input.h"
+#include "devices/debugcon.h"
 #include "devices/serial.h"
 #include "devices/shutdown.h"
 #include "devices/timer.h"
+#include "devices/tty.h"
 #include "devices/vga.h"
 #include "devices/rtc.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/kstack.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/profile.h"
 #include "threads/pte.h"
+#include "threads/rcu.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
+#include "userprog/aio.h"
+#include "userprog/elfcache.h"
 #include "userprog/exception.h"
+#include "userprog/futex.h"
 #include "userprog/gdt.h"
+#include "userprog/share.h"
+#include "userprog/shm.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #else
@@ -34,17 +49,33 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
+#include "devices/stripe.h"
+#include "devices/virtio-blk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/tarfs.h"
+#endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#include "vm/zswap.h"
 #endif
 
 /* Page directory with kernel mappings only. */
 uint32_t *init_page_dir;
 
+/* True if 4 MB pages are enabled. */
+bool init_large_pages;
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
 
+/* -mount-scratch: Mount the scratch device's tar archive? */
+static bool mount_scratch;
+
 /* -filesys, -scratch, -swap: Names of block devices to use,
    overriding the defaults. */
 static const char *filesys_bdev_name;
@@ -52,16 +83,32 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -ramdisk, -ramdisk-from: Size in kB of the RAM disk, if any,
+   and name of a block device to load it from. */
+static size_t ramdisk_kb;
+static const char *ramdisk_from;
+
+/* -stripe, -stripe-chunk: Names of the block devices to stripe
+   together as md0, if any, and sectors per chunk. */
+static const char *stripe_members;
+static size_t stripe_chunk = 8;
 #endif /* FILESYS */
 
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
+/* -snapshot: Wait for the actions to run on the console after
+   the devices are up, so the machine can be saved first? */
+static bool snapshot;
+
 static void bss_init (void);
 static void paging_init (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
+static char **read_snapshot_actions (void);
+static void set_sched_policy (int policy);
 static void run_actions (char **argv);
 static void usage (void);
 
@@ -97,7 +144,10 @@ main (void)
   /* Initialize memory system. */
   palloc_init (user_page_limit);
   malloc_init ();
+  rcu_init ();
+  profile_init ();
   paging_init ();
+  fpu_init ();
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -110,21 +160,52 @@ main (void)
   timer_init ();
   kbd_init ();
   input_init ();
+  tty_init ();
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
+  process_init ();
+  share_init ();
+  futex_init ();
+  shm_init ();
+  aio_init ();
+  elfcache_init ();
 #endif
+  clock_init ();
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  softirq_start ();
+  intr_start_threads ();
   serial_init_queue ();
+  klog_start ();
   timer_calibrate ();
 
 #ifdef FILESYS
-  /* Initialize file system. */
+  /* Initialize block devices. */
+  block_init ();
   ide_init ();
+  virtio_blk_init ();
+  ramdisk_init (ramdisk_kb, ramdisk_from);
+  stripe_init (stripe_members, stripe_chunk);
   locate_block_devices ();
+#endif
+
+  /* Everything up to here is the same from one run to the next,
+     so this is where the harness saves or restores the machine. */
+  if (snapshot)
+    argv = read_snapshot_actions ();
+
+#ifdef FILESYS
+  /* Initialize file system. */
   filesys_init (format_filesys);
+  if (mount_scratch && !tarfs_mount ())
+    printf ("Could not mount scratch device.\n");
+#endif
+#ifdef VM
+  page_init ();
+  frame_init ();
+  swap_init ();
 #endif
 
   printf ("Boot complete.\n");
@@ -150,16 +231,56 @@ bss_init (void)
   memset (&_start_bss, 0, &_end_bss - &_start_bss);
 }
 
+/* CPUID leaf 1 feature flags in EDX.  See [IA32-v2a] "CPUID". */
+#define CPUID_PSE (1u << 3)             /* 4 MB pages. */
+#define CPUID_PGE (1u << 13)            /* Global pages. */
+
+/* CR4 flags.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR4_PSE (1u << 4)               /* Enable 4 MB pages. */
+#define CR4_PGE (1u << 7)               /* Enable global pages. */
+
+/* EFLAGS flag that can be toggled only if CPUID exists. */
+#define FLAG_ID (1u << 21)
+
+/* Returns the CPUID leaf 1 feature flags in EDX, or 0 if the CPU
+   does not have CPUID. */
+uint32_t
+cpu_features (void)
+{
+  uint32_t before, after, eax, ebx, ecx, edx;
+
+  asm volatile ("pushfl; popl %0; movl %0, %1; xorl %2, %0; "
+                "pushl %0; popfl; pushfl; popl %0; pushl %1; popfl"
+                : "=&r" (after), "=&r" (before) : "i" (FLAG_ID));
+  if (((before ^ after) & FLAG_ID) == 0)
+    return 0;
+
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (1));
+  return edx;
+}
+
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points init_page_dir to the page
-   directory it creates. */
+   directory it creates.
+
+   If the CPU supports them, each 4 MB of memory that does not
+   hold kernel text, which must stay read-only, is mapped with a
+   single 4 MB page, and kernel mappings are marked global, so
+   that they take fewer TLB entries and survive the CR3 reloads
+   of process switches. */
 static void
 paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  uint32_t features = cpu_features ();
+  bool large = (features & CPUID_PSE) != 0;
+  uint32_t global = (features & CPUID_PGE) != 0 ? PTE_G : 0;
+  uint32_t cr4;
 
   pd = init_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -171,13 +292,34 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (large && pte_idx == 0
+          && page + PTSPAN / PGSIZE <= init_ram_pages
+          && (vaddr + PTSPAN <= &_start
+              || vaddr >= &_end_kernel_text))
+        {
+          /* Map all 4 MB with one PDE. */
+          pd[pde_idx] = paddr | PTE_PS | PTE_P | PTE_W | global;
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
           pd[pde_idx] = pde_create (pt);
         }
 
-      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
+      pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text) | global;
+    }
+  kstack_init (pd);
+
+  /* 4 MB pages must be enabled before a page directory that uses
+     them is loaded. */
+  if (large)
+    {
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+      init_large_pages = true;
     }
 
   /* Store the physical address of the page directory into CR3
@@ -186,6 +328,13 @@ paging_init (void)
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (init_page_dir)));
+
+  /* Global pages are enabled only once paging is set up. */
+  if (global)
+    {
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PGE));
+    }
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -247,19 +396,98 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-mount-scratch"))
+        mount_scratch = true;
+      else if (!strcmp (name, "-pio"))
+        ide_dma = false;
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_kb = atoi (value);
+      else if (!strcmp (name, "-ramdisk-from"))
+        ramdisk_from = value;
+      else if (!strcmp (name, "-stripe"))
+        stripe_members = value;
+      else if (!strcmp (name, "-stripe-chunk"))
+        stripe_chunk = atoi (value);
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
+      else if (!strcmp (name, "-stack"))
+        page_stack_limit = (size_t) atoi (value) * 1024;
+      else if (!strcmp (name, "-populate"))
+        page_populate_max = (size_t) atoi (value);
+      else if (!strcmp (name, "-zswap"))
+        zswap_kb = (size_t) atoi (value);
+      else if (!strcmp (name, "-nohuge"))
+        page_huge = false;
 #endif
 #endif
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
+      else if (!strcmp (name, "-debugcon"))
+        {
+          if (!debugcon_init ())
+            printf ("warning: no debug console, using serial port\n");
+        }
+      else if (!strcmp (name, "-serial-kb"))
+        serial_txq_kb = atoi (value);
+      else if (!strcmp (name, "-input-kb"))
+        input_kb = atoi (value);
+      else if (!strcmp (name, "-lpt"))
+        timer_cached_lpt = atoi (value);
       else if (!strcmp (name, "-mlfqs"))
-        thread_mlfqs = true;
+        set_sched_policy (SCHED_MLFQS);
+      else if (!strcmp (name, "-slice"))
+        {
+          char *comma = value != NULL ? strchr (value, ',') : NULL;
+          if (comma == NULL || atoi (value) < 1 || atoi (comma + 1) < 1)
+            PANIC ("bad time slices `%s'", value != NULL ? value : "");
+          thread_slice_short = atoi (value);
+          thread_slice_long = atoi (comma + 1);
+        }
+      else if (!strcmp (name, "-stride"))
+        set_sched_policy (SCHED_STRIDE);
+      else if (!strcmp (name, "-group"))
+        thread_group_share = true;
+      else if (!strcmp (name, "-boost"))
+        thread_boost = true;
+      else if (!strcmp (name, "-profile"))
+        thread_profile = true;
+      else if (!strcmp (name, "-irqpri"))
+        {
+          if (value == NULL || atoi (value) < PRI_MIN
+              || atoi (value) > PRI_MAX)
+            PANIC ("bad interrupt thread priority `%s'",
+                   value != NULL ? value : "");
+          intr_thread_priority = atoi (value);
+        }
+      else if (!strcmp (name, "-intrstat"))
+        intr_stats = true;
+      else if (!strcmp (name, "-stats"))
+        stats_enabled = true;
+      else if (!strcmp (name, "-palloc"))
+        {
+          if (value != NULL && !strcmp (value, "bitmap"))
+            palloc_bitmap = true;
+          else if (value == NULL || strcmp (value, "buddy"))
+            PANIC ("unknown page allocator `%s'", value != NULL ? value : "");
+        }
+      else if (!strcmp (name, "-kstack"))
+        {
+          if (value == NULL || atoi (value) < 1
+              || atoi (value) > KSTACK_PAGES_MAX)
+            PANIC ("bad kernel stack size `%s'", value != NULL ? value : "");
+          thread_stack_pages = atoi (value);
+        }
+      else if (!strcmp (name, "-cma"))
+        palloc_cma_pages = atoi (value);
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
 #endif
+      else if (!strcmp (name, "-snapshot"))
+        snapshot = true;
+      else if (!strcmp (name, "-loglevel"))
+        klog_console_level = atoi (value);
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
@@ -277,6 +505,53 @@ parse_options (char **argv)
   return argv;
 }
 
+/* Announces that the kernel is ready to be saved, then reads the
+   actions to run from the console and returns them as an
+   argv-like array.  Each word ends in a null byte, and an empty
+   word ends the list.  A machine restored from the saved state
+   resumes in this function, waiting for its own actions. */
+static char **
+read_snapshot_actions (void) 
+{
+  static char buf[1024];
+  static char *argv[sizeof buf / 2 + 1];
+  size_t len = 0;
+  int argc = 0;
+
+  printf ("Pintos ready for snapshot.\n");
+  for (;;)
+    {
+      uint8_t c = input_getc ();
+
+      if (len >= sizeof buf)
+        PANIC ("snapshot actions overflow");
+      if (c == '\0' && (len == 0 || buf[len - 1] == '\0'))
+        break;
+      if (len == 0 || buf[len - 1] == '\0')
+        argv[argc++] = buf + len;
+      buf[len++] = c;
+    }
+  argv[argc] = NULL;
+  return argv;
+}
+
+/* Chooses scheduling policy POLICY, one of the SCHED_* values in
+   threads/thread.h, for an option that asks for it.  A kernel
+   built for one policy accepts only that one. */
+static void
+set_sched_policy (int policy) 
+{
+#if SCHED_POLICY == SCHED_ANY
+  if (policy == SCHED_MLFQS)
+    thread_mlfqs = true;
+  else
+    thread_stride = policy == SCHED_STRIDE;
+#else
+  if (policy != SCHED_POLICY)
+    PANIC ("kernel was built for another scheduling policy");
+#endif
+}
+
 /* Runs the task specified in ARGV[1]. */
 static void
 run_task (char **argv)
@@ -373,12 +648,39 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -mount-scratch     Mount scratch tar archive at /scratch/.\n"
+          "  -pio               Use programmed I/O, not DMA, for IDE disks.\n"
+          "  -ramdisk=KB        Create a KB kB RAM disk named rd0.\n"
+          "  -ramdisk-from=BDEV Load rd0 from BDEV (sized to fit by default).\n"
+          "  -stripe=BDEV,...   Stripe BDEVs as md0 for the file system.\n"
+          "  -stripe-chunk=N    Stripe N sectors at a time (default 8).\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
+          "  -stack=KB          Let user stacks grow to KB kB (default 8192).\n"
+          "  -populate=N        Load exec segments of up to N pages at once (default 16).\n"
+          "  -zswap=KB          Keep KB kB of compressed swap (default 256).\n"
+          "  -nohuge            Map user memory with 4 kB pages only.\n"
 #endif
 #endif
           "  -rs=SEED           Set random number seed to SEED.\n"
+          "  -lpt=N             Use N timer loops per tick; skip calibration.\n"
+          "  -debugcon          Write console output to the debug port.\n"
+          "  -serial-kb=KB      Queue KB kB of serial output (default 4).\n"
+          "  -input-kb=KB       Buffer KB kB of keyboard input (default 1).\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -slice=SHORT,LONG  Slices of top- and bottom-priority threads.\n"
+          "  -stride            Share the CPU in proportion to thread tickets.\n"
+          "  -group             Share the CPU between processes, then threads.\n"
+          "  -boost             Run threads that mostly sleep first on waking.\n"
+          "  -profile           Sample where time goes, print at power off.\n"
+          "  -irqpri=N          Run interrupt threads at priority N.\n"
+          "  -intrstat          Time interrupts-off windows and handlers.\n"
+          "  -stats             Print KEY=VALUE statistics at power off.\n"
+          "  -palloc=ALLOC      Allocate pages with ALLOC: buddy or bitmap.\n"
+          "  -kstack=PAGES      Give threads guarded PAGES-page stacks.\n"
+          "  -cma=COUNT         Reserve COUNT user pages for contiguous use.\n"
+          "  -snapshot          Read actions from console once devices are up.\n"
+          "  -loglevel=N        Print messages up to level N (default 6).\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -391,6 +693,9 @@ usage (void)
 static void
 locate_block_devices (void)
 {
+  /* The members of md0 must not be used on their own. */
+  if (stripe_members != NULL && filesys_bdev_name == NULL)
+    filesys_bdev_name = "md0";
   locate_block_device (BLOCK_FILESYS, filesys_bdev_name);
   locate_block_device (BLOCK_SCRATCH, scratch_bdev_name);
 #ifdef VM
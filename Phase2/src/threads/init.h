@@ -9,4 +9,9 @@
 /* Page directory with kernel mappings only. */
 extern uint32_t *init_page_dir;
 
+/* True if 4 MB pages are enabled, for user memory as well. */
+extern bool init_large_pages;
+
+uint32_t cpu_features (void);
+
 #endif /* threads/init.h */
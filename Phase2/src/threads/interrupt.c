@@ -1,14 +1,21 @@
 #include "threads/interrupt.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <stats.h>
 #include <stdint.h>
 #include <stdio.h>
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/softirq.h"
 #include "threads/thread.h"
+#include "threads/tsc.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/process.h"
+#endif
 
 /* Programmable Interrupt Controller (PIC) registers.
    A PC has two PICs, called the master and slave PICs, with the
@@ -47,6 +54,85 @@ static unsigned int unexpected_cnt[INTR_CNT];
 static bool in_external_intr;   /* Are we processing an external interrupt? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
 
+/* Threaded external interrupts.
+
+   A driver whose interrupts need real work, work that may sleep
+   or that should not hold up other threads, registers it with
+   intr_register_threaded().  The hard handler still runs first,
+   with interrupts off, to acknowledge the device.  Then the
+   IRQ's kernel thread is woken to run the rest.  Interrupts that
+   arrive before it gets to run are seen by that one run.
+
+   The threads run at intr_thread_priority, so that they can be
+   placed above or below user threads, which start at
+   PRI_DEFAULT. */
+struct intr_thread
+  {
+    intr_thread_func *func;     /* Work done in the thread. */
+    const char *name;           /* Thread name. */
+    struct thread *thread;      /* The thread, once it is running. */
+    bool pending;               /* Interrupted since FUNC last ran? */
+    bool idle;                  /* Blocked waiting for PENDING? */
+  };
+static struct intr_thread intr_threads[16];
+
+/* Priority of threaded interrupt handlers.  Set with -irqpri. */
+int intr_thread_priority = PRI_DEFAULT + 1;
+
+static thread_func intr_thread_run;
+static void intr_thread_wake (struct intr_thread *);
+
+/* Interrupt latency statistics.
+
+   If intr_stats is set, every window with interrupts off that
+   intr_disable() opens and intr_enable() closes is timed with
+   the time-stamp counter, and so is every call to an interrupt
+   handler from intr_handler().  Durations are counted in
+   histograms whose bucket B holds durations of less than
+   2**(B + STATS_SHIFT) cycles.  The windows that ran longest
+   are also kept by the call site that turned interrupts off.
+
+   A window can also end without intr_enable(), when a thread
+   switched to returns to user mode with IRET or SYSEXIT.  Such a
+   window is dropped when the next interrupt arrives from code
+   that had interrupts on, or replaced by the next one opened. */
+#define STATS_BUCKETS 16
+#define STATS_SHIFT 8
+
+/* A histogram of durations. */
+struct intr_hist
+  {
+    unsigned cnt[STATS_BUCKETS];        /* By bucket. */
+    uint64_t total;                     /* Sum of durations, in cycles. */
+    uint64_t max;                       /* Longest, in cycles. */
+  };
+
+/* A place that turned interrupts off for long. */
+struct off_site
+  {
+    void *site;                 /* Caller of intr_disable(). */
+    unsigned cnt;               /* # of windows counted here. */
+    uint64_t max;               /* Longest, in cycles. */
+  };
+
+/* Most call sites kept. */
+#define OFF_SITES 8
+
+/* If false (default), keep no statistics.
+   Controlled by kernel command-line option "-intrstat". */
+bool intr_stats;
+
+static struct intr_hist off_hist;       /* Interrupts-off windows. */
+static struct intr_hist vec_hist[INTR_CNT]; /* Handler times by vector. */
+static struct off_site off_sites[OFF_SITES];
+static uint64_t off_start;      /* When interrupts went off, or 0. */
+static void *off_site;          /* Who turned them off. */
+
+static void off_begin (void *site);
+static void off_end (void);
+static void hist_add (struct intr_hist *, uint64_t cycles);
+static void hist_print (const struct intr_hist *);
+
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
@@ -80,7 +166,22 @@ intr_get_level (void)
 enum intr_level
 intr_set_level (enum intr_level level) 
 {
-  return level == INTR_ON ? intr_enable () : intr_disable ();
+  enum intr_level old_level;
+
+  if (!intr_stats)
+    return level == INTR_ON ? intr_enable () : intr_disable ();
+
+  /* Charge the window to our caller, not to us. */
+  old_level = intr_get_level ();
+  if (level == INTR_ON)
+    intr_enable ();
+  else
+    {
+      asm volatile ("cli" : : : "memory");
+      if (old_level == INTR_ON)
+        off_begin (__builtin_return_address (0));
+    }
+  return old_level;
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
@@ -88,7 +189,12 @@ enum intr_level
 intr_enable (void) 
 {
   enum intr_level old_level = intr_get_level ();
-  ASSERT (!intr_context ());
+
+  /* Softirqs run with interrupts on; external handlers do not. */
+  ASSERT (!in_external_intr);
+
+  if (intr_stats && old_level == INTR_OFF)
+    off_end ();
 
   /* Enable interrupts by setting the interrupt flag.
 
@@ -110,6 +216,9 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (intr_stats && old_level == INTR_ON)
+    off_begin (__builtin_return_address (0));
+
   return old_level;
 }
 
@@ -155,6 +264,9 @@ intr_init (void)
   intr_names[17] = "#AC Alignment Check Exception";
   intr_names[18] = "#MC Machine-Check Exception";
   intr_names[19] = "#XF SIMD Floating-Point Exception";
+
+  stats_add_hist ("intr", NULL, "off_cycles", off_hist.cnt,
+                  STATS_BUCKETS, STATS_SHIFT);
 }
 
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
@@ -172,6 +284,8 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
     idt[vec_no] = make_intr_gate (intr_stubs[vec_no], dpl);
   intr_handlers[vec_no] = handler;
   intr_names[vec_no] = name;
+  stats_add_hist ("intr", name, "cycles", vec_hist[vec_no].cnt,
+                  STATS_BUCKETS, STATS_SHIFT);
 }
 
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
@@ -185,6 +299,93 @@ intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
+/* Registers external interrupt VEC_NO as threaded: HANDLER, if
+   not null, runs with interrupts off as for intr_register_ext(),
+   and then FUNC runs in a kernel thread named NAME, once
+   intr_start_threads() has started it. */
+void
+intr_register_threaded (uint8_t vec_no, intr_handler_func *handler,
+                        intr_thread_func *func, const char *name) 
+{
+  struct intr_thread *it = &intr_threads[vec_no - 0x20];
+
+  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+  ASSERT (func != NULL);
+
+  it->func = func;
+  it->name = name;
+  register_handler (vec_no, 0, INTR_OFF, handler, name);
+}
+
+/* Registers internal interrupt VEC_NO to switch to the task
+   whose TSS has selector SEL, named NAME for debugging purposes.
+   A task gate runs its handler on the task's stack, so it still
+   works when the current stack does not. */
+void
+intr_register_task (uint8_t vec_no, uint16_t sel, const char *name)
+{
+  ASSERT (intr_handlers[vec_no] == NULL);
+  ASSERT (vec_no < 0x20);
+
+  /* Selector in bits 16:31, present, DPL 0, type 5 (task gate).
+     See [IA32-v3a] 5.11 "IDT Descriptors". */
+  idt[vec_no] = ((uint64_t) sel << 16) | ((uint64_t) 0x85 << 40);
+  intr_names[vec_no] = name;
+}
+
+/* Starts the kernel threads of threaded interrupts registered so
+   far.  Must be called after thread_start(). */
+void
+intr_start_threads (void) 
+{
+  size_t i;
+
+  for (i = 0; i < sizeof intr_threads / sizeof *intr_threads; i++)
+    if (intr_threads[i].func != NULL && intr_threads[i].thread == NULL)
+      thread_create (intr_threads[i].name, intr_thread_priority,
+                     intr_thread_run, &intr_threads[i]);
+}
+
+/* Runs threaded interrupt IT's work each time it is woken. */
+static void
+intr_thread_run (void *it_) 
+{
+  struct intr_thread *it = it_;
+
+  intr_disable ();
+  it->thread = thread_current ();
+  for (;;)
+    {
+      while (!it->pending)
+        {
+          it->idle = true;
+          thread_block ();
+        }
+      it->pending = false;
+
+      intr_enable ();
+      it->func ();
+      intr_disable ();
+    }
+}
+
+/* Marks threaded interrupt IT pending and wakes its thread.
+   Called from intr_handler() after the hard handler. */
+static void
+intr_thread_wake (struct intr_thread *it) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  it->pending = true;
+  if (it->idle)
+    {
+      it->idle = false;
+      thread_unblock (it->thread);
+      if (intr_thread_priority > thread_get_priority ())
+        intr_yield_on_return ();
+    }
+}
+
 /* Registers internal interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The interrupt handler
    will be invoked with interrupt status LEVEL.
@@ -206,12 +407,12 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
   register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Returns true during processing of an external interrupt or
+   of the softirqs it raised, and false at all other times. */
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  return in_external_intr || softirq_active ();
 }
 
 /* During processing of an external interrupt, directs the
@@ -355,16 +556,35 @@ intr_handler (struct intr_frame *frame)
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
-      ASSERT (!intr_context ());
+      ASSERT (!in_external_intr);
 
+      /* One that arrived while softirqs ran leaves any yield
+         to the interrupt that started them. */
       in_external_intr = true;
-      yield_on_return = false;
+      if (!softirq_active ())
+        yield_on_return = false;
     }
 
-  /* Invoke the interrupt's handler. */
+  /* An interrupt from code that had interrupts on means that
+     any window we thought was open has closed unseen. */
+  if (intr_stats && (frame->eflags & FLAG_IF) != 0)
+    off_start = 0;
+
+  /* Invoke the interrupt's handler.  A threaded interrupt may
+     have only a thread. */
   handler = intr_handlers[frame->vec_no];
-  if (handler != NULL)
+  if (handler != NULL && intr_stats)
+    {
+      uint64_t start = rdtsc ();
+      handler (frame);
+      hist_add (&vec_hist[frame->vec_no], rdtsc () - start);
+    }
+  else if (handler != NULL)
     handler (frame);
+  else if (external && intr_threads[frame->vec_no - 0x20].func != NULL)
+    {
+      /* Threaded with no hard handler: the thread does it all. */
+    }
   else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
     {
       /* There is no handler, but this interrupt can trigger
@@ -380,11 +600,150 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
+      if (intr_threads[frame->vec_no - 0x20].func != NULL)
+        intr_thread_wake (&intr_threads[frame->vec_no - 0x20]);
+
       in_external_intr = false;
       pic_end_of_interrupt (frame->vec_no); 
 
-      if (yield_on_return) 
-        thread_yield (); 
+      /* Run deferred work with interrupts on, unless this
+         interrupt arrived while it was already running. */
+      if (!softirq_active ())
+        {
+          softirq_run ();
+          if (yield_on_return && !preempt_defer ())
+            thread_yield (); 
+        }
+    }
+
+#ifdef USERPROG
+  /* A thread about to go back to user mode stops there if
+     another thread of its process has called exit(), so that one
+     spinning in user mode dies at its next timer tick. */
+  if (frame->cs == SEL_UCSEG)
+    process_check_exiting ();
+#endif
+}
+
+/* Notes that SITE turned interrupts off. */
+static void
+off_begin (void *site)
+{
+  off_start = rdtsc ();
+  off_site = site;
+}
+
+/* Counts the window of interrupts off that is just ending. */
+static void
+off_end (void)
+{
+  struct off_site *s, *min;
+  uint64_t cycles;
+
+  if (off_start == 0)
+    return;
+  cycles = rdtsc () - off_start;
+  off_start = 0;
+  hist_add (&off_hist, cycles);
+
+  /* Keep the site if it is already kept or if it beats the
+     least of those that are. */
+  min = &off_sites[0];
+  for (s = off_sites; s < off_sites + OFF_SITES; s++)
+    {
+      if (s->site == off_site)
+        {
+          s->cnt++;
+          if (cycles > s->max)
+            s->max = cycles;
+          return;
+        }
+      if (s->max < min->max)
+        min = s;
+    }
+  if (cycles > min->max)
+    {
+      min->site = off_site;
+      min->cnt = 1;
+      min->max = cycles;
+    }
+}
+
+/* Adds a duration of CYCLES to H. */
+static void
+hist_add (struct intr_hist *h, uint64_t cycles)
+{
+  uint32_t high = cycles >> 32;
+  int bucket;
+
+  if (high != 0)
+    bucket = STATS_BUCKETS - 1;
+  else
+    {
+      /* Bucket of the highest set bit, if any. */
+      uint32_t low = cycles;
+      int bit = low != 0 ? 31 - __builtin_clz (low) : 0;
+      bucket = bit < STATS_SHIFT ? 0 : bit - STATS_SHIFT + 1;
+      if (bucket >= STATS_BUCKETS)
+        bucket = STATS_BUCKETS - 1;
+    }
+
+  h->cnt[bucket]++;
+  h->total += cycles;
+  if (cycles > h->max)
+    h->max = cycles;
+}
+
+/* Prints H's nonempty buckets on one line, each as the bucket's
+   upper bound in cycles, then ":", then its count. */
+static void
+hist_print (const struct intr_hist *h)
+{
+  int b;
+
+  for (b = 0; b < STATS_BUCKETS; b++)
+    if (h->cnt[b] != 0)
+      {
+        if (b < STATS_BUCKETS - 1)
+          printf (" <%u:%u", 1u << (b + STATS_SHIFT), h->cnt[b]);
+        else
+          printf (" more:%u", h->cnt[b]);
+      }
+  printf ("\n");
+}
+
+/* Prints interrupt latency statistics, if intr_stats is set. */
+void
+intr_print_stats (void)
+{
+  unsigned cnt = 0;
+  int b, i;
+
+  if (!intr_stats)
+    return;
+
+  for (b = 0; b < STATS_BUCKETS; b++)
+    cnt += off_hist.cnt[b];
+  printf ("Interrupts off: %u windows, max %"PRIu64" cycles; cycles:",
+          cnt, off_hist.max);
+  hist_print (&off_hist);
+  for (i = 0; i < OFF_SITES; i++)
+    if (off_sites[i].site != NULL)
+      printf ("  off at %p: %u windows, max %"PRIu64" cycles\n",
+              off_sites[i].site, off_sites[i].cnt, off_sites[i].max);
+
+  for (i = 0; i < INTR_CNT; i++)
+    {
+      const struct intr_hist *h = &vec_hist[i];
+
+      for (cnt = 0, b = 0; b < STATS_BUCKETS; b++)
+        cnt += h->cnt[b];
+      if (cnt == 0)
+        continue;
+      printf ("Interrupt %#04x (%s): %u calls, avg %"PRIu64
+              ", max %"PRIu64" cycles; cycles:",
+              i, intr_names[i], cnt, h->total / cnt, h->max);
+      hist_print (h);
     }
 }
 
@@ -57,14 +57,27 @@ struct intr_frame
 
 typedef void intr_handler_func (struct intr_frame *);
 
+/* The part of a threaded interrupt handler that runs in its own
+   kernel thread, with interrupts on.  It may sleep. */
+typedef void intr_thread_func (void);
+
+extern int intr_thread_priority;
+
 void intr_init (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
+void intr_register_threaded (uint8_t vec, intr_handler_func *,
+                             intr_thread_func *, const char *name);
+void intr_start_threads (void);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
+void intr_register_task (uint8_t vec, uint16_t sel, const char *name);
 bool intr_context (void);
 void intr_yield_on_return (void);
 
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
 
+extern bool intr_stats;
+void intr_print_stats (void);
+
 #endif /* threads/interrupt.h */
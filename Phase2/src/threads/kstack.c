@@ -0,0 +1,160 @@
+#include "threads/kstack.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+
+/* Guarded kernel stacks.
+
+   A thread made by thread_create_stack() with more than one page
+   of stack gets a slot of its own in this region instead of a
+   page from the kernel pool.  Its struct thread takes the top of
+   the slot, its stack the pages just below, each a page of its
+   own from the kernel pool, so that a large stack needs no
+   contiguous memory, and the rest of the slot is left unmapped.
+   A stack that overflows therefore runs into an unmapped page
+   and faults, rather than overwriting whatever is below it, and
+   the struct thread above it is never what it corrupts.
+
+   The region's page tables are made once, by kstack_init(), in
+   the initial page directory, which every process's page
+   directory copies its kernel mappings from, so a stack mapped
+   later is seen in every address space.  Slots and page table
+   entries are accessed with interrupts off. */
+
+/* Page tables for the region. */
+#define KSTACK_PT_CNT (KSTACK_SLOT * KSTACK_SLOT_CNT / PTSPAN)
+static uint32_t *page_tables[KSTACK_PT_CNT];
+
+/* Slots in use. */
+static bool slot_used[KSTACK_SLOT_CNT];
+
+/* Returns the page table entry for ADDR in the region. */
+static uint32_t *
+lookup_pte (const void *addr)
+{
+  uintptr_t ofs = (uintptr_t) addr - KSTACK_BASE;
+
+  ASSERT (kstack_contains (addr));
+  return &page_tables[ofs / PTSPAN][pt_no (addr)];
+}
+
+/* Returns the slot index of ADDR in the region. */
+static size_t
+slot_no (const void *addr)
+{
+  return ((uintptr_t) addr - KSTACK_BASE) / KSTACK_SLOT;
+}
+
+/* Returns the base of slot SLOT. */
+static uint8_t *
+slot_base (size_t slot)
+{
+  return (uint8_t *) KSTACK_BASE + slot * KSTACK_SLOT;
+}
+
+/* Makes the region's page tables in PD, the initial page
+   directory.  Physical memory must be mapped below the region. */
+void
+kstack_init (uint32_t *pd)
+{
+  size_t i;
+
+  if ((uintptr_t) ptov (init_ram_pages * PGSIZE) > KSTACK_BASE)
+    PANIC ("too much memory for the kernel stack region");
+
+  for (i = 0; i < KSTACK_PT_CNT; i++)
+    {
+      page_tables[i] = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+      pd[pd_no ((uint8_t *) KSTACK_BASE + i * PTSPAN)]
+        = pde_create (page_tables[i]);
+    }
+}
+
+/* Unmaps and frees the pages of SLOT, and gives the slot back.
+   Interrupts must be off. */
+static void
+free_slot (size_t slot)
+{
+  uint8_t *base = slot_base (slot);
+  uint8_t *page;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (page = base; page < base + KSTACK_SLOT; page += PGSIZE)
+    {
+      uint32_t *pte = lookup_pte (page);
+
+      if (*pte & PTE_P)
+        {
+          palloc_free_page (pte_get_page (*pte));
+          *pte = 0;
+          asm volatile ("invlpg (%0)" : : "r" (page) : "memory");
+        }
+    }
+  slot_used[slot] = false;
+}
+
+/* Maps a stack of PAGE_CNT zeroed pages at the top of a free
+   slot and returns where its struct thread goes.  Returns a null
+   pointer if no slot is free or memory runs out. */
+struct thread *
+kstack_alloc (size_t page_cnt)
+{
+  enum intr_level old_level;
+  size_t slot, i;
+  uint8_t *top;
+
+  ASSERT (page_cnt > 0 && page_cnt <= KSTACK_PAGES_MAX);
+
+  old_level = intr_disable ();
+  for (slot = 0; slot < KSTACK_SLOT_CNT; slot++)
+    if (!slot_used[slot])
+      break;
+  if (slot < KSTACK_SLOT_CNT)
+    slot_used[slot] = true;
+  intr_set_level (old_level);
+  if (slot == KSTACK_SLOT_CNT)
+    return NULL;
+
+  top = slot_base (slot) + KSTACK_SLOT;
+  for (i = 1; i <= page_cnt; i++)
+    {
+      void *kpage = palloc_get_page (PAL_ZERO);
+
+      if (kpage == NULL)
+        {
+          old_level = intr_disable ();
+          free_slot (slot);
+          intr_set_level (old_level);
+          return NULL;
+        }
+      old_level = intr_disable ();
+      *lookup_pte (top - i * PGSIZE) = pte_create_kernel (kpage, true);
+      intr_set_level (old_level);
+    }
+  return kstack_thread (top - 1);
+}
+
+/* Frees T's guarded stack.  Interrupts must be off, as they are
+   when a dying thread's stack is freed by the next to run. */
+void
+kstack_free (struct thread *t)
+{
+  ASSERT (kstack_contains (t));
+  free_slot (slot_no (t));
+}
+
+/* Returns the thread whose stack overflowed if ADDR is in an
+   unmapped page of a slot in use, and otherwise a null pointer.
+   For reporting a fault at ADDR. */
+struct thread *
+kstack_guard_owner (const void *addr)
+{
+  if (!kstack_contains (addr) || !slot_used[slot_no (addr)]
+      || (*lookup_pte (addr) & PTE_P) != 0)
+    return NULL;
+  return kstack_thread (addr);
+}
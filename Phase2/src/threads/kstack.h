@@ -0,0 +1,47 @@
+#ifndef THREADS_KSTACK_H
+#define THREADS_KSTACK_H
+
+#include <round.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Guarded kernel stacks live in a region of kernel virtual
+   memory above the mapping of physical memory, split into
+   KSTACK_SLOT_CNT slots of KSTACK_SLOT bytes each. */
+#define KSTACK_BASE 0xf0000000          /* Start of the region. */
+#define KSTACK_SLOT (16 * PGSIZE)       /* Bytes per slot. */
+#define KSTACK_SLOT_CNT 256             /* Number of slots. */
+
+/* Most pages a guarded stack may have.  At least the lowest page
+   of each slot stays unmapped as the guard. */
+#define KSTACK_PAGES_MAX (KSTACK_SLOT / PGSIZE - 1)
+
+/* Bytes at the top of a slot taken by its struct thread. */
+#define KSTACK_THREAD_SIZE ROUND_UP (sizeof (struct thread), 16)
+
+void kstack_init (uint32_t *pd);
+struct thread *kstack_alloc (size_t page_cnt);
+void kstack_free (struct thread *);
+struct thread *kstack_guard_owner (const void *addr);
+
+/* Returns true if ADDR is in the region of guarded stacks. */
+static inline bool
+kstack_contains (const void *addr)
+{
+  return (uintptr_t) addr - KSTACK_BASE
+         < (uintptr_t) KSTACK_SLOT * KSTACK_SLOT_CNT;
+}
+
+/* Returns the thread whose slot ADDR, which must be in the region
+   of guarded stacks, is in. */
+static inline struct thread *
+kstack_thread (const void *addr)
+{
+  uintptr_t slot = (uintptr_t) addr & ~(uintptr_t) (KSTACK_SLOT - 1);
+  return (struct thread *) (slot + KSTACK_SLOT - KSTACK_THREAD_SIZE);
+}
+
+#endif /* threads/kstack.h */
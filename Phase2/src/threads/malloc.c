@@ -1,10 +1,13 @@
 #include "threads/malloc.h"
 #include <debug.h>
 #include <list.h>
+#include <rbtree.h>
 #include <round.h>
+#include <stats.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -25,14 +28,41 @@
 
    When we free a block, we add it to its descriptor's free list.
    But if the arena that the block was in now has no in-use
-   blocks, we remove all of the arena's blocks from the free list
-   and give the arena back to the page allocator.
-
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   blocks, and the descriptor already keeps another arena with no
+   in-use blocks, we remove all of the arena's blocks from the
+   free list and give the arena back to the page allocator.
+   Keeping one empty arena spares a pattern that allocates and
+   frees a single block from getting and freeing a page each
+   time.
+
+   We can't handle blocks bigger than 1 kB using this scheme,
+   because no more than one would fit in a page with an arena
+   header.  We handle those "big blocks" by allocating contiguous
+   pages with the page allocator.  A big block has no header, so
+   that a 4 kB buffer takes one page, not two; instead a record of
+   each one's page count is kept in big_tree, keyed by address.
+   free() tells the two kinds apart by alignment: a big block
+   starts on a page boundary, and a small one never does, since
+   its arena header comes first.
+
+   realloc() keeps a block where it is when it can: a small block
+   while the new size still belongs to the same descriptor, and a
+   big block when the new size needs no more pages, or it shrinks
+   and the pages past the new end can be given back, or it grows
+   and the pages that follow are free for palloc_extend() to take.
+
+   Hot kernel objects of a fixed size can also come from an object
+   cache made with kmem_cache_create().  A cache has a descriptor
+   of its own, sized exactly for the object, and in front of it a
+   "magazine" holding a few recently freed objects.  The magazine
+   is used with interrupts off instead of under the descriptor's
+   lock; with a single CPU that is all the per-CPU magazines of a
+   slab allocator amount to.  Most allocations and frees then
+   touch neither the lock nor the free list.
+
+   Each descriptor counts its arenas and the blocks in use, and
+   their peaks, for malloc_print_stats().  Objects sitting in a
+   cache's magazine still count as in use to the descriptor. */
 
 /* Descriptor. */
 struct desc
@@ -40,7 +70,29 @@ struct desc
     size_t block_size;          /* Size of each element in bytes. */
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
+    size_t empty_cnt;           /* Arenas with no blocks in use. */
     struct lock lock;           /* Lock. */
+
+    /* Statistics, updated under LOCK. */
+    size_t arena_cnt;           /* Arenas. */
+    size_t arena_peak;          /* Most arenas at once. */
+    size_t live_cnt;            /* Blocks in use. */
+    size_t live_peak;           /* Most blocks in use at once. */
+    unsigned alloc_cnt;         /* Blocks handed out. */
+  };
+
+/* Objects kept in a cache's magazine. */
+#define MAGAZINE_SIZE 8
+
+/* Object cache. */
+struct kmem_cache
+  {
+    const char *name;           /* For debugging. */
+    struct list_elem elem;      /* Element in cache_list. */
+    struct desc desc;           /* Arenas of this object size. */
+    void *magazine[MAGAZINE_SIZE]; /* Free objects, accessed with
+                                      interrupts off. */
+    size_t magazine_cnt;        /* Number of objects in magazine. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -50,8 +102,16 @@ struct desc
 struct arena 
   {
     unsigned magic;             /* Always set to ARENA_MAGIC. */
-    struct desc *desc;          /* Owning descriptor, null for big block. */
-    size_t free_cnt;            /* Free blocks; pages in big block. */
+    struct desc *desc;          /* Owning descriptor. */
+    size_t free_cnt;            /* Free blocks. */
+  };
+
+/* Record of a big block. */
+struct big_block
+  {
+    struct rb_node node;        /* In big_tree. */
+    void *pages;                /* The block, page-aligned. */
+    size_t page_cnt;            /* Pages in it. */
   };
 
 /* Free block. */
@@ -64,8 +124,40 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Names of the descriptors' block sizes, for the statistics
+   registry. */
+static const char *const desc_names[] =
+  {"16", "32", "64", "128", "256", "512", "1024"};
+
+/* All object caches, for malloc_print_stats(). */
+static struct list cache_list;
+
+/* Records of big blocks, from big_cache, by address, under
+   big_lock. */
+static struct rb_tree big_tree;
+static struct lock big_lock;
+static struct kmem_cache *big_cache;
+
+/* Pages in big blocks, under big_lock. */
+static size_t big_pages;
+static size_t big_peak;
+
+/* Calls to realloc() that kept the block where it was. */
+static unsigned realloc_in_place;
+
+static struct desc *size_to_desc (size_t);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void desc_init (struct desc *, size_t block_size);
+static void *desc_alloc (struct desc *);
+static void desc_free (struct desc *, struct block *);
+static void desc_print_stats (const char *name, const struct desc *);
+static void desc_register_stats (const char *name, struct desc *);
+static rb_less_func big_less;
+static struct big_block *big_find (void *);
+static void *big_alloc (size_t size);
+static void big_free (void *);
+static bool big_resize (void *, size_t new_size);
 
 /* Initializes the malloc() descriptors. */
 void
@@ -73,15 +165,20 @@ malloc_init (void)
 {
   size_t block_size;
 
+  list_init (&cache_list);
   for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
     {
       struct desc *d = &descs[desc_cnt++];
       ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-      d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
-      list_init (&d->free_list);
-      lock_init (&d->lock);
+      ASSERT (desc_cnt <= sizeof desc_names / sizeof *desc_names);
+      desc_init (d, block_size);
+      desc_register_stats (desc_names[desc_cnt - 1], d);
     }
+  rb_init (&big_tree, big_less, NULL);
+  lock_init (&big_lock);
+  big_cache = kmem_cache_create ("big block", sizeof (struct big_block));
+  stats_add_size ("malloc", NULL, "big_pages", &big_pages);
+  stats_add_uint ("malloc", NULL, "realloc.in_place", &realloc_in_place);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -90,8 +187,6 @@ void *
 malloc (size_t size) 
 {
   struct desc *d;
-  struct block *b;
-  struct arena *a;
 
   /* A null pointer satisfies a request for 0 bytes. */
   if (size == 0)
@@ -99,58 +194,11 @@ malloc (size_t size)
 
   /* Find the smallest descriptor that satisfies a SIZE-byte
      request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) 
-    {
-      /* SIZE is too big for any descriptor.
-         Allocate enough pages to hold SIZE plus an arena. */
-      size_t page_cnt = DIV_ROUND_UP (size + sizeof *a, PGSIZE);
-      a = palloc_get_multiple (0, page_cnt);
-      if (a == NULL)
-        return NULL;
-
-      /* Initialize the arena to indicate a big block of PAGE_CNT
-         pages, and return it. */
-      a->magic = ARENA_MAGIC;
-      a->desc = NULL;
-      a->free_cnt = page_cnt;
-      return a + 1;
-    }
-
-  lock_acquire (&d->lock);
-
-  /* If the free list is empty, create a new arena. */
-  if (list_empty (&d->free_list))
-    {
-      size_t i;
+  d = size_to_desc (size);
+  if (d == NULL)
+    return big_alloc (size);
 
-      /* Allocate a page. */
-      a = palloc_get_page (0);
-      if (a == NULL) 
-        {
-          lock_release (&d->lock);
-          return NULL; 
-        }
-
-      /* Initialize arena and add its blocks to the free list. */
-      a->magic = ARENA_MAGIC;
-      a->desc = d;
-      a->free_cnt = d->blocks_per_arena;
-      for (i = 0; i < d->blocks_per_arena; i++) 
-        {
-          struct block *b = arena_to_block (a, i);
-          list_push_back (&d->free_list, &b->free_elem);
-        }
-    }
-
-  /* Get a block from free list and return it. */
-  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
-  a = block_to_arena (b);
-  a->free_cnt--;
-  lock_release (&d->lock);
-  return b;
+  return desc_alloc (d);
 }
 
 /* Allocates and return A times B bytes initialized to zeroes.
@@ -178,11 +226,17 @@ calloc (size_t a, size_t b)
 static size_t
 block_size (void *block) 
 {
-  struct block *b = block;
-  struct arena *a = block_to_arena (b);
-  struct desc *d = a->desc;
+  struct big_block *big;
+  size_t size;
 
-  return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+  if (pg_ofs (block) != 0)
+    return block_to_arena (block)->desc->block_size;
+
+  lock_acquire (&big_lock);
+  big = big_find (block);
+  size = big->page_cnt * PGSIZE;
+  lock_release (&big_lock);
+  return size;
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
@@ -199,6 +253,15 @@ realloc (void *old_block, size_t new_size)
       free (old_block);
       return NULL;
     }
+  else if (old_block != NULL
+           && (pg_ofs (old_block) != 0
+               ? block_to_arena (old_block)->desc == size_to_desc (new_size)
+               : size_to_desc (new_size) == NULL
+                 && big_resize (old_block, new_size)))
+    {
+      realloc_in_place++;
+      return old_block;
+    }
   else 
     {
       void *new_block = malloc (new_size);
@@ -220,49 +283,283 @@ free (void *p)
 {
   if (p != NULL)
     {
-      struct block *b = p;
-      struct arena *a = block_to_arena (b);
-      struct desc *d = a->desc;
-      
-      if (d != NULL) 
+      if (pg_ofs (p) == 0)
+        {
+          /* It's a big block.  Free its pages. */
+          big_free (p);
+        }
+      else
         {
           /* It's a normal block.  We handle it here. */
+          struct block *b = p;
+          desc_free (block_to_arena (b)->desc, b);
+        }
+    }
+}
+
+/* Creates and returns a cache of objects of SIZE bytes, named
+   NAME for debugging purposes.  Panics if memory is not
+   available, since caches are made at initialization. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size)
+{
+  struct kmem_cache *c;
+
+  size = ROUND_UP (size < sizeof (struct block) ? sizeof (struct block)
+                                                : size, sizeof (void *));
+  ASSERT (size <= (PGSIZE - sizeof (struct arena)) / 2);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("kmem_cache_create: out of memory for %s cache", name);
+  c->name = name;
+  desc_init (&c->desc, size);
+  c->magazine_cnt = 0;
+  list_push_back (&cache_list, &c->elem);
+  desc_register_stats (name, &c->desc);
+  return c;
+}
+
+/* Obtains and returns an object from cache C, taking a recently
+   freed one from its magazine if there is one.
+   Returns a null pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  enum intr_level old_level = intr_disable ();
+  if (c->magazine_cnt > 0)
+    {
+      void *p = c->magazine[--c->magazine_cnt];
+      intr_set_level (old_level);
+      return p;
+    }
+  intr_set_level (old_level);
+
+  return desc_alloc (&c->desc);
+}
 
+/* Frees object P, which must have come from kmem_cache_alloc()
+   on cache C.  It goes into C's magazine unless that is full. */
+void
+kmem_cache_free (struct kmem_cache *c, void *p)
+{
+  enum intr_level old_level;
+
+  if (p == NULL)
+    return;
+  ASSERT (block_to_arena (p)->desc == &c->desc);
+
+  old_level = intr_disable ();
+  if (c->magazine_cnt < MAGAZINE_SIZE)
+    {
 #ifndef NDEBUG
-          /* Clear the block to help detect use-after-free bugs. */
-          memset (b, 0xcc, d->block_size);
+      /* Clear the object to help detect use-after-free bugs. */
+      memset (p, 0xcc, c->desc.block_size);
 #endif
-  
-          lock_acquire (&d->lock);
+      c->magazine[c->magazine_cnt++] = p;
+      intr_set_level (old_level);
+      return;
+    }
+  intr_set_level (old_level);
 
-          /* Add block to free list. */
-          list_push_front (&d->free_list, &b->free_elem);
+  desc_free (&c->desc, p);
+}
 
-          /* If the arena is now entirely unused, free it. */
-          if (++a->free_cnt >= d->blocks_per_arena) 
-            {
-              size_t i;
-
-              ASSERT (a->free_cnt == d->blocks_per_arena);
-              for (i = 0; i < d->blocks_per_arena; i++) 
-                {
-                  struct block *b = arena_to_block (a, i);
-                  list_remove (&b->free_elem);
-                }
-              palloc_free_page (a);
-            }
+/* Initializes descriptor D for blocks of BLOCK_SIZE bytes. */
+static void
+desc_init (struct desc *d, size_t block_size)
+{
+  d->block_size = block_size;
+  d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+  list_init (&d->free_list);
+  d->empty_cnt = 0;
+  lock_init (&d->lock);
+  d->arena_cnt = d->arena_peak = 0;
+  d->live_cnt = d->live_peak = 0;
+  d->alloc_cnt = 0;
+}
 
+/* Obtains and returns a block from descriptor D, getting a new
+   arena if D has no free blocks.
+   Returns a null pointer if memory is not available. */
+static void *
+desc_alloc (struct desc *d)
+{
+  struct block *b;
+  struct arena *a;
+
+  lock_acquire (&d->lock);
+
+  /* If the free list is empty, create a new arena. */
+  if (list_empty (&d->free_list))
+    {
+      size_t i;
+
+      /* Allocate a page. */
+      a = palloc_get_page (0);
+      if (a == NULL) 
+        {
           lock_release (&d->lock);
+          return NULL; 
         }
-      else
+
+      /* Initialize arena and add its blocks to the free list. */
+      a->magic = ARENA_MAGIC;
+      a->desc = d;
+      a->free_cnt = d->blocks_per_arena;
+      d->empty_cnt++;
+      if (++d->arena_cnt > d->arena_peak)
+        d->arena_peak = d->arena_cnt;
+      for (i = 0; i < d->blocks_per_arena; i++) 
         {
-          /* It's a big block.  Free its pages. */
-          palloc_free_multiple (a, a->free_cnt);
-          return;
+          struct block *b = arena_to_block (a, i);
+          list_push_back (&d->free_list, &b->free_elem);
         }
     }
+
+  /* Get a block from free list and return it. */
+  b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
+  a = block_to_arena (b);
+  if (a->free_cnt-- == d->blocks_per_arena)
+    d->empty_cnt--;
+  if (++d->live_cnt > d->live_peak)
+    d->live_peak = d->live_cnt;
+  d->alloc_cnt++;
+  lock_release (&d->lock);
+  return b;
 }
-
+
+/* Returns block B to descriptor D, freeing its arena if the
+   arena is now unused and D already keeps an empty one. */
+static void
+desc_free (struct desc *d, struct block *b)
+{
+  struct arena *a = block_to_arena (b);
+
+#ifndef NDEBUG
+  /* Clear the block to help detect use-after-free bugs. */
+  memset (b, 0xcc, d->block_size);
+#endif
+
+  lock_acquire (&d->lock);
+
+  /* Add block to free list. */
+  list_push_front (&d->free_list, &b->free_elem);
+  d->live_cnt--;
+
+  /* If the arena is now entirely unused, keep it if it is the
+     only one, else free it. */
+  if (++a->free_cnt >= d->blocks_per_arena) 
+    {
+      ASSERT (a->free_cnt == d->blocks_per_arena);
+      if (d->empty_cnt > 0)
+        {
+          size_t i;
+
+          for (i = 0; i < d->blocks_per_arena; i++) 
+            {
+              struct block *b = arena_to_block (a, i);
+              list_remove (&b->free_elem);
+            }
+          palloc_free_page (a);
+          d->arena_cnt--;
+        }
+      else
+        d->empty_cnt++;
+    }
+
+  lock_release (&d->lock);
+}
+
+/* Fills in the malloc() members of *STATS. */
+void
+malloc_get_stats (struct memstat *stats)
+{
+  struct list_elem *e;
+  size_t i;
+
+  stats->malloc_arenas = stats->malloc_live = 0;
+  for (i = 0; i < desc_cnt; i++)
+    {
+      stats->malloc_arenas += descs[i].arena_cnt;
+      stats->malloc_live += descs[i].live_cnt * descs[i].block_size;
+    }
+  for (e = list_begin (&cache_list); e != list_end (&cache_list);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      stats->malloc_arenas += c->desc.arena_cnt;
+      stats->malloc_live += c->desc.live_cnt * c->desc.block_size;
+    }
+  stats->malloc_big_pages = big_pages;
+}
+
+/* Prints statistics for each descriptor and object cache that
+   has ever had an arena, and for big blocks. */
+void
+malloc_print_stats (void)
+{
+  struct list_elem *e;
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    desc_print_stats (NULL, &descs[i]);
+  for (e = list_begin (&cache_list); e != list_end (&cache_list);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      desc_print_stats (c->name, &c->desc);
+    }
+  printf ("Malloc big blocks: %zu pages (peak %zu)\n", big_pages, big_peak);
+}
+
+/* Prints statistics for descriptor D, belonging to the object
+   cache NAME or, if NAME is null, to malloc() itself.  The free
+   percentage is the share of blocks in D's arenas that are not
+   in use, which is memory lost to fragmentation unless D is
+   about to need it. */
+static void
+desc_print_stats (const char *name, const struct desc *d)
+{
+  size_t capacity = d->arena_cnt * d->blocks_per_arena;
+
+  if (d->arena_peak == 0)
+    return;
+
+  if (name != NULL)
+    printf ("Malloc cache %s (%zu B):", name, d->block_size);
+  else
+    printf ("Malloc %zu B:", d->block_size);
+  printf (" %zu arenas (peak %zu), %zu blocks live (peak %zu), "
+          "%u allocations, %zu%% free\n",
+          d->arena_cnt, d->arena_peak, d->live_cnt, d->live_peak,
+          d->alloc_cnt,
+          capacity > 0 ? (capacity - d->live_cnt) * 100 / capacity : 0);
+}
+
+/* Registers descriptor D's counters under NAME with the
+   statistics registry. */
+static void
+desc_register_stats (const char *name, struct desc *d)
+{
+  stats_add_size ("malloc", name, "arenas", &d->arena_cnt);
+  stats_add_size ("malloc", name, "live", &d->live_cnt);
+  stats_add_uint ("malloc", name, "allocs", &d->alloc_cnt);
+}
+
+/* Returns the smallest malloc() descriptor whose blocks hold
+   SIZE bytes, or a null pointer if SIZE needs a big block. */
+static struct desc *
+size_to_desc (size_t size)
+{
+  struct desc *d;
+
+  for (d = descs; d < descs + desc_cnt; d++)
+    if (d->block_size >= size)
+      return d;
+  return NULL;
+}
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
@@ -274,9 +571,7 @@ block_to_arena (struct block *b)
   ASSERT (a->magic == ARENA_MAGIC);
 
   /* Check that the block is properly aligned for the arena. */
-  ASSERT (a->desc == NULL
-          || (pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
-  ASSERT (a->desc != NULL || pg_ofs (b) == sizeof *a);
+  ASSERT ((pg_ofs (b) - sizeof *a) % a->desc->block_size == 0);
 
   return a;
 }
@@ -292,3 +587,103 @@ arena_to_block (struct arena *a, size_t idx)
                            + sizeof *a
                            + idx * a->desc->block_size);
 }
+
+/* Big blocks. */
+
+/* Orders big block records A and B by address. */
+static bool
+big_less (const struct rb_node *a_, const struct rb_node *b_,
+          void *aux UNUSED)
+{
+  const struct big_block *a = rb_entry (a_, struct big_block, node);
+  const struct big_block *b = rb_entry (b_, struct big_block, node);
+
+  return (uintptr_t) a->pages < (uintptr_t) b->pages;
+}
+
+/* Returns the record of the big block at PAGES, which must
+   exist.  big_lock must be held. */
+static struct big_block *
+big_find (void *pages)
+{
+  struct big_block key;
+  struct rb_node *n;
+
+  ASSERT (lock_held_by_current_thread (&big_lock));
+
+  key.pages = pages;
+  n = rb_find (&big_tree, &key.node);
+  ASSERT (n != NULL);
+  return rb_entry (n, struct big_block, node);
+}
+
+/* Returns a new big block of at least SIZE bytes, or a null
+   pointer if memory is not available. */
+static void *
+big_alloc (size_t size)
+{
+  struct big_block *big;
+
+  big = kmem_cache_alloc (big_cache);
+  if (big == NULL)
+    return NULL;
+  big->page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  big->pages = palloc_get_multiple (0, big->page_cnt);
+  if (big->pages == NULL)
+    {
+      kmem_cache_free (big_cache, big);
+      return NULL;
+    }
+
+  lock_acquire (&big_lock);
+  rb_insert (&big_tree, &big->node);
+  big_pages += big->page_cnt;
+  if (big_pages > big_peak)
+    big_peak = big_pages;
+  lock_release (&big_lock);
+  return big->pages;
+}
+
+/* Frees the big block at PAGES. */
+static void
+big_free (void *pages)
+{
+  struct big_block *big;
+
+  lock_acquire (&big_lock);
+  big = big_find (pages);
+  rb_remove (&big_tree, &big->node);
+  big_pages -= big->page_cnt;
+  lock_release (&big_lock);
+
+  palloc_free_multiple (big->pages, big->page_cnt);
+  kmem_cache_free (big_cache, big);
+}
+
+/* Tries to resize the big block at PAGES to NEW_SIZE bytes, which
+   is too big for any descriptor, without moving it.  Returns
+   true if successful, false if the pages after it are in use. */
+static bool
+big_resize (void *pages, size_t new_size)
+{
+  size_t new_cnt = DIV_ROUND_UP (new_size, PGSIZE);
+  struct big_block *big;
+  bool ok = true;
+
+  lock_acquire (&big_lock);
+  big = big_find (pages);
+  if (new_cnt < big->page_cnt)
+    palloc_free_multiple ((uint8_t *) pages + new_cnt * PGSIZE,
+                          big->page_cnt - new_cnt);
+  else if (new_cnt > big->page_cnt)
+    ok = palloc_extend (pages, big->page_cnt, new_cnt);
+  if (ok)
+    {
+      big_pages = big_pages - big->page_cnt + new_cnt;
+      if (big_pages > big_peak)
+        big_peak = big_pages;
+      big->page_cnt = new_cnt;
+    }
+  lock_release (&big_lock);
+  return ok;
+}
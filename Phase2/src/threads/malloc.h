@@ -3,11 +3,20 @@
 
 #include <debug.h>
 #include <stddef.h>
+#include <memstat.h>
 
 void malloc_init (void);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
+void malloc_get_stats (struct memstat *);
+void malloc_print_stats (void);
+
+/* Caches of fixed-size objects. */
+struct kmem_cache;
+struct kmem_cache *kmem_cache_create (const char *name, size_t size);
+void *kmem_cache_alloc (struct kmem_cache *) __attribute__ ((malloc));
+void kmem_cache_free (struct kmem_cache *, void *);
 
 #endif /* threads/malloc.h */
@@ -2,14 +2,21 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
+#include <stats.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/frame.h"
+#endif
 
 /* Page allocator.  Hands out memory in page-size (or
    page-multiple) chunks.  See malloc.h for an allocator that
@@ -23,7 +30,54 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool hands out pages with a binary buddy allocator: a
+   free block of 2**K pages starts at a page index that is a
+   multiple of 2**K, and when it and its "buddy", the block
+   whose index differs only in bit K, are both free, they are
+   merged into one free block of 2**(K+1) pages.  A request for N
+   pages takes the smallest free block that fits and frees the
+   pages past the first N again, so no pages are wasted.  The
+   "-palloc=bitmap" kernel option selects the original first-fit
+   bitmap search instead, for comparison.
+
+   With the buddy allocator, the idle thread also keeps a stock
+   of up to ZEROED_MAX pre-zeroed pages in each pool, so that
+   single-page PAL_ZERO requests, such as page tables, stacks and
+   thread structures, need not clear memory while someone waits.
+   The stock counts as allocated until it is handed out, and is
+   given back to the buddy allocator if a request cannot be met
+   otherwise.
+
+   Every page handed out is charged to the call site that asked
+   for it, the return address of palloc_get_page() or
+   palloc_get_multiple(), so that palloc_print_stats() can tell
+   who holds a pool's pages when it runs dry, and which sites
+   never give theirs back.
+
+   The "-cma=COUNT" kernel option sets aside COUNT pages at the
+   top of the user pool as a contiguous memory area, for
+   palloc_get_contiguous() to fall back on when the kernel pool
+   is too fragmented to hold a large request.  So that the area
+   is not wasted while no such request needs it, single
+   PAL_MOVABLE pages, the frame table's, are taken from it when
+   the user pool runs out.  A contiguous request then gets them
+   back by having frame_migrate() copy each movable page in its
+   way to another page and remap it. */
+
+/* Number of buddy block orders: blocks of 2**0 through
+   2**(BUDDY_ORDER_CNT - 1) pages. */
+#define BUDDY_ORDER_CNT 32
+
+/* Most pre-zeroed pages kept per pool. */
+#define ZEROED_MAX 32
+
+/* Most call sites charged separately; the rest share sites[0]. */
+#define SITE_MAX 64
+
+/* Most call sites palloc_print_stats() reports. */
+#define SITE_TOP 8
 
 /* A memory pool. */
 struct pool
@@ -31,14 +85,93 @@ struct pool
     struct lock lock;                   /* Mutual exclusion. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+
+    /* Buddy allocator.  Accessed with interrupts off rather than
+       under LOCK, because a dying thread's page is freed from
+       within the scheduler. */
+    struct list free_lists[BUDDY_ORDER_CNT];   /* Free blocks by order,
+                                                   linked through their
+                                                   first pages. */
+    uint8_t *free_order;                /* For each page, 1 + the order of
+                                           the free block it starts, or 0
+                                           if it starts none. */
+
+    /* Pre-zeroed pages, also accessed with interrupts off.  Kept
+       in an array, since links stored in the pages themselves
+       would undo the zeroing. */
+    void *zeroed[ZEROED_MAX];
+    size_t zeroed_cnt;
+
+    /* Accounting, also accessed with interrupts off. */
+    const char *name;                   /* For palloc_print_stats(). */
+    uint8_t *site_of;                   /* For each page, the index in
+                                           sites[] of its call site. */
+    size_t used_cnt;                    /* Pages handed out. */
+    size_t peak_cnt;                    /* Most pages handed out at once. */
+  };
+
+/* Pages held by one call site in one pool. */
+struct site
+  {
+    void *caller;                       /* Return address of the request. */
+    const struct pool *pool;            /* Pool the pages came from. */
+    size_t live_cnt;                    /* Pages held now. */
+    size_t peak_cnt;                    /* Most pages held at once. */
+    unsigned alloc_cnt;                 /* Requests that succeeded. */
   };
 
+/* Use the bitmap allocator instead of the buddy allocator?
+   Set by the kernel command-line option "-palloc=bitmap". */
+bool palloc_bitmap;
+
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Pages of the user pool set aside as the contiguous area.
+   Set by the kernel command-line option "-cma=COUNT". */
+size_t palloc_cma_pages;
+
+/* The contiguous memory area.  Its bitmaps and counts are
+   accessed with interrupts off, as the buddy allocator is. */
+struct cma
+  {
+    struct lock lock;                   /* One contiguous request at a
+                                           time. */
+    uint8_t *base;                      /* First page, or null if there
+                                           is no area. */
+    struct bitmap *used_map;            /* Pages handed out. */
+    struct bitmap *movable_map;         /* Those holding movable pages. */
+    size_t claim_start, claim_end;      /* Pages being claimed by a
+                                           contiguous request, which
+                                           movable pages keep out of. */
+    size_t used_cnt;                    /* Pages handed out. */
+    size_t movable_cnt;                 /* Those holding movable pages. */
+    uint64_t migrate_cnt;               /* Movable pages moved away. */
+  };
+static struct cma cma;
+
+/* Call sites, accessed with interrupts off.  sites[0] has a null
+   CALLER and collects the pages of sites that did not fit. */
+static struct site sites[SITE_MAX];
+static size_t site_cnt = 1;
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_take (struct pool *, size_t page_idx, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static void release_zeroed (struct pool *);
+static void *get_pages (enum palloc_flags, size_t page_cnt, void *caller);
+static void charge (struct pool *, size_t page_idx, size_t page_cnt,
+                    void *caller);
+static void uncharge (struct pool *, size_t page_idx, size_t page_cnt);
+static int compare_pages (const void *, const void *, void *aux);
+static void init_cma (void *base, size_t page_cnt);
+static void *cma_get_movable (void);
+static void *cma_get_contiguous (size_t page_cnt);
+static bool page_from_cma (void *page);
+static void cma_free (void *pages, size_t page_cnt);
 
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
@@ -50,15 +183,23 @@ palloc_init (size_t user_page_limit)
   uint8_t *free_end = ptov (init_ram_pages * PGSIZE);
   size_t free_pages = (free_end - free_start) / PGSIZE;
   size_t user_pages = free_pages / 2;
-  size_t kernel_pages;
+  size_t kernel_pages, cma_pages;
   if (user_pages > user_page_limit)
     user_pages = user_page_limit;
   kernel_pages = free_pages - user_pages;
 
+  /* The contiguous area may have at most half of the user pool. */
+  cma_pages = palloc_cma_pages;
+  if (cma_pages > user_pages / 2)
+    cma_pages = user_pages / 2;
+  user_pages -= cma_pages;
+
   /* Give half of memory to kernel, half to user. */
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+  if (cma_pages > 0)
+    init_cma (free_start + (kernel_pages + user_pages) * PGSIZE, cma_pages);
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
@@ -69,26 +210,204 @@ palloc_init (size_t user_page_limit)
    FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  return get_pages (flags, page_cnt, __builtin_return_address (0));
+}
+
+/* Obtains a single free page and returns its kernel virtual
+   address.
+   If PAL_USER is set, the page is obtained from the user pool,
+   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
+   then the page is filled with zeros.  If no pages are
+   available, returns a null pointer, unless PAL_ASSERT is set in
+   FLAGS, in which case the kernel panics. */
+void *
+palloc_get_page (enum palloc_flags flags) 
+{
+  return get_pages (flags, 1, __builtin_return_address (0));
+}
+
+/* Obtains and returns a group of PAGE_CNT contiguous free pages,
+   as palloc_get_multiple() does, whose physical address is a
+   multiple of PAGE_CNT pages, which must be a power of 2, as a
+   4 MB page needs.  If the first PAGE_CNT pages it gets are not
+   aligned, takes twice as many, less one, and frees those on
+   either side of the aligned run in the middle.  PAL_ZERO clears
+   only the pages kept. */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt)
+{
+  void *caller = __builtin_return_address (0);
+  enum palloc_flags get_flags = flags & ~(PAL_ZERO | PAL_ASSERT);
+  uintptr_t align = PGSIZE * page_cnt;
+  size_t head;
+  uint8_t *pages;
+
+  ASSERT (page_cnt > 0 && (page_cnt & (page_cnt - 1)) == 0);
+
+  pages = get_pages (get_flags, page_cnt, caller);
+  if (pages != NULL && vtop (pages) % align != 0)
+    {
+      palloc_free_multiple (pages, page_cnt);
+      pages = get_pages (get_flags, 2 * page_cnt - 1, caller);
+      if (pages != NULL)
+        {
+          head = (ROUND_UP (vtop (pages), align) - vtop (pages)) / PGSIZE;
+          palloc_free_multiple (pages, head);
+          palloc_free_multiple (pages + PGSIZE * (head + page_cnt),
+                                page_cnt - 1 - head);
+          pages += PGSIZE * head;
+        }
+    }
+
+  if (pages != NULL && (flags & PAL_ZERO))
+    memset (pages, 0, align);
+  if (pages == NULL && (flags & PAL_ASSERT))
+    PANIC ("palloc_get_aligned: out of pages");
+  return pages;
+}
+
+/* Obtains and returns a group of PAGE_CNT physically contiguous
+   pages, as palloc_get_multiple() does, but falls back on the
+   contiguous area if the pool is too fragmented, moving movable
+   pages out of its way.  This may sleep, so it must not be called
+   with the frame table's lock held. */
+void *
+palloc_get_contiguous (enum palloc_flags flags, size_t page_cnt)
+{
+  void *pages = get_pages (flags & ~PAL_ASSERT, page_cnt,
+                           __builtin_return_address (0));
+
+  if (pages == NULL && cma.base != NULL && page_cnt > 0)
+    {
+      pages = cma_get_contiguous (page_cnt);
+      if (pages != NULL && (flags & PAL_ZERO))
+        memset (pages, 0, PGSIZE * page_cnt);
+    }
+  if (pages == NULL && (flags & PAL_ASSERT))
+    PANIC ("palloc_get_contiguous: out of pages");
+  return pages;
+}
+
+/* Grows the PAGE_CNT pages at PAGES, which palloc_get_multiple()
+   returned, to NEW_CNT pages in place, by taking the pages that
+   follow them if those are all free.  Returns true if
+   successful, false if the run cannot grow where it is.  The new
+   pages are not cleared. */
+bool
+palloc_extend (void *pages, size_t page_cnt, size_t new_cnt)
+{
+  void *caller = __builtin_return_address (0);
+  struct pool *pool;
+  size_t page_idx, add_cnt;
+  bool ok = false;
+
+  ASSERT (pg_ofs (pages) == 0);
+  ASSERT (new_cnt >= page_cnt);
+
+  if (page_from_pool (&kernel_pool, pages))
+    pool = &kernel_pool;
+  else if (page_from_pool (&user_pool, pages))
+    pool = &user_pool;
+  else
+    return false;
+  page_idx = pg_no (pages) - pg_no (pool->base) + page_cnt;
+  add_cnt = new_cnt - page_cnt;
+  if (add_cnt == 0)
+    return true;
+  if (page_idx + add_cnt > bitmap_size (pool->used_map))
+    return false;
+
+  if (palloc_bitmap)
+    {
+      lock_acquire (&pool->lock);
+      ok = bitmap_none (pool->used_map, page_idx, add_cnt);
+      if (ok)
+        bitmap_set_multiple (pool->used_map, page_idx, add_cnt, true);
+      lock_release (&pool->lock);
+      if (ok)
+        {
+          enum intr_level old_level = intr_disable ();
+          charge (pool, page_idx, add_cnt, caller);
+          intr_set_level (old_level);
+        }
+    }
+  else
+    {
+      enum intr_level old_level = intr_disable ();
+      ok = bitmap_none (pool->used_map, page_idx, add_cnt);
+      if (ok)
+        {
+          buddy_take (pool, page_idx, add_cnt);
+          bitmap_set_multiple (pool->used_map, page_idx, add_cnt, true);
+          charge (pool, page_idx, add_cnt, caller);
+        }
+      intr_set_level (old_level);
+    }
+  return ok;
+}
+
+/* Does the work of palloc_get_multiple(), charging the pages to
+   CALLER. */
+static void *
+get_pages (enum palloc_flags flags, size_t page_cnt, void *caller)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
   void *pages;
   size_t page_idx;
+  bool zeroed = false;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
+  if (palloc_bitmap)
+    {
+      lock_acquire (&pool->lock);
+      page_idx = bitmap_alloc (pool->used_map, page_cnt);
+      lock_release (&pool->lock);
+      if (page_idx != BITMAP_ERROR)
+        {
+          enum intr_level old_level = intr_disable ();
+          charge (pool, page_idx, page_cnt, caller);
+          intr_set_level (old_level);
+        }
+    }
+  else
+    {
+      enum intr_level old_level = intr_disable ();
+      if ((flags & PAL_ZERO) && page_cnt == 1 && pool->zeroed_cnt > 0)
+        {
+          /* Take a page the idle thread has already cleared. */
+          pages = pool->zeroed[--pool->zeroed_cnt];
+          page_idx = pg_no (pages) - pg_no (pool->base);
+          zeroed = true;
+        }
+      else
+        {
+          page_idx = buddy_alloc (pool, page_cnt);
+          if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0)
+            {
+              release_zeroed (pool);
+              page_idx = buddy_alloc (pool, page_cnt);
+            }
+          if (page_idx != BITMAP_ERROR)
+            bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+        }
+      if (page_idx != BITMAP_ERROR)
+        charge (pool, page_idx, page_cnt, caller);
+      intr_set_level (old_level);
+    }
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
+  else if ((flags & PAL_MOVABLE) && page_cnt == 1)
+    pages = cma_get_movable ();
   else
     pages = NULL;
 
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      if ((flags & PAL_ZERO) && !zeroed)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -100,17 +419,51 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   return pages;
 }
 
-/* Obtains a single free page and returns its kernel virtual
-   address.
-   If PAL_USER is set, the page is obtained from the user pool,
-   otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the page is filled with zeros.  If no pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
-void *
-palloc_get_page (enum palloc_flags flags) 
+/* Clears one free page ahead of time for a later PAL_ZERO
+   request, if some pool's stock of pre-zeroed pages is short.
+   Returns true if it did, false if there was nothing to do.
+   Called by the idle thread, so it never blocks; the page is
+   cleared with interrupts on. */
+bool
+palloc_zero_idle (void)
 {
-  return palloc_get_multiple (flags, 1);
+  struct pool *pools[] = { &user_pool, &kernel_pool };
+  size_t i;
+
+  if (palloc_bitmap)
+    return false;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    {
+      struct pool *pool = pools[i];
+      enum intr_level old_level;
+      size_t page_idx;
+      void *page;
+
+      old_level = intr_disable ();
+      page_idx = pool->zeroed_cnt < ZEROED_MAX
+                 ? buddy_alloc (pool, 1) : BITMAP_ERROR;
+      if (page_idx != BITMAP_ERROR)
+        bitmap_mark (pool->used_map, page_idx);
+      intr_set_level (old_level);
+      if (page_idx == BITMAP_ERROR)
+        continue;
+
+      page = pool->base + PGSIZE * page_idx;
+      memset (page, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      if (pool->zeroed_cnt < ZEROED_MAX)
+        pool->zeroed[pool->zeroed_cnt++] = page;
+      else
+        {
+          bitmap_reset (pool->used_map, page_idx);
+          buddy_free (pool, page_idx, 1);
+        }
+      intr_set_level (old_level);
+      return true;
+    }
+  return false;
 }
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
@@ -128,17 +481,40 @@ palloc_free_multiple (void *pages, size_t page_cnt)
     pool = &kernel_pool;
   else if (page_from_pool (&user_pool, pages))
     pool = &user_pool;
+  else if (page_from_cma (pages))
+    pool = NULL;
   else
     NOT_REACHED ();
 
-  page_idx = pg_no (pages) - pg_no (pool->base);
-
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  if (pool == NULL)
+    {
+      cma_free (pages, page_cnt);
+      return;
+    }
+  page_idx = pg_no (pages) - pg_no (pool->base);
+
+  if (palloc_bitmap)
+    {
+      enum intr_level old_level = intr_disable ();
+      uncharge (pool, page_idx, page_cnt);
+      intr_set_level (old_level);
+
+      ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+    }
+  else
+    {
+      enum intr_level old_level = intr_disable ();
+      ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+      uncharge (pool, page_idx, page_cnt);
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+      buddy_free (pool, page_idx, page_cnt);
+      intr_set_level (old_level);
+    }
 }
 
 /* Frees the page at PAGE. */
@@ -148,15 +524,88 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Frees the PAGE_CNT pages whose addresses are in PAGES, in any
+   order, each allocated on its own or not.  Sorts PAGES, then
+   gives back each run of consecutive pages in one go, so that
+   tearing down an address space updates the bitmap and the buddy
+   allocator once per run instead of once per page. */
+void
+palloc_free_pages (void **pages, size_t page_cnt) 
+{
+  size_t i, run;
+
+  sort (pages, page_cnt, sizeof *pages, compare_pages, NULL);
+  for (i = 0; i < page_cnt; i += run)
+    {
+      for (run = 1; i + run < page_cnt; run++)
+        if (pages[i + run] != (uint8_t *) pages[i] + run * PGSIZE)
+          break;
+      palloc_free_multiple (pages[i], run);
+    }
+}
+
+/* Frees PAGE, which the caller has already cleared to all zeroes,
+   by adding it to its pool's stock of pre-zeroed pages, so that
+   the next single-page PAL_ZERO request takes it without clearing
+   it again.  If the stock is full, or PAGE is not from a pool
+   that keeps one, frees PAGE as palloc_free_page() would. */
+void
+palloc_free_zeroed (void *page)
+{
+  struct pool *pool;
+  enum intr_level old_level;
+  size_t page_idx;
+
+  ASSERT (pg_ofs (page) == 0);
+  if (page_from_pool (&kernel_pool, page))
+    pool = &kernel_pool;
+  else if (page_from_pool (&user_pool, page))
+    pool = &user_pool;
+  else
+    pool = NULL;
+  if (pool == NULL || palloc_bitmap)
+    {
+      palloc_free_page (page);
+      return;
+    }
+
+  page_idx = pg_no (page) - pg_no (pool->base);
+  old_level = intr_disable ();
+  ASSERT (bitmap_test (pool->used_map, page_idx));
+  uncharge (pool, page_idx, 1);
+  if (pool->zeroed_cnt < ZEROED_MAX)
+    pool->zeroed[pool->zeroed_cnt++] = page;
+  else
+    {
+      bitmap_reset (pool->used_map, page_idx);
+      buddy_free (pool, page_idx, 1);
+    }
+  intr_set_level (old_level);
+}
+
+/* Orders page addresses A and B for palloc_free_pages(). */
+static int
+compare_pages (const void *a_, const void *b_, void *aux UNUSED) 
+{
+  void *const *a = a_;
+  void *const *b = b_;
+
+  return *a < *b ? -1 : *a > *b;
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map at its base, followed by the
+     buddy allocator's free_order array and the site_of array.
+     Calculate the space needed for them
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + 2 * page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -164,9 +613,21 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  lock_init_named (&p->lock, name);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
   p->base = base + bm_pages * PGSIZE;
+  p->free_order = (uint8_t *) base + bm_size;
+  memset (p->free_order, 0, page_cnt);
+  p->site_of = p->free_order + page_cnt;
+  memset (p->site_of, 0, page_cnt);
+  p->name = name;
+  p->used_cnt = p->peak_cnt = 0;
+  stats_add_size ("palloc", name, "used", &p->used_cnt);
+  stats_add_size ("palloc", name, "peak", &p->peak_cnt);
+  for (order = 0; order < BUDDY_ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
+  buddy_free (p, 0, page_cnt);
+  p->zeroed_cnt = 0;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -180,3 +641,429 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Buddy allocator. */
+
+/* Returns the list element stored in page PAGE_IDX of POOL. */
+static struct list_elem *
+page_elem (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the smallest order whose blocks hold PAGE_CNT pages. */
+static int
+order_for (size_t page_cnt)
+{
+  int order = 0;
+
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Adds the free block of 2**ORDER pages at PAGE_IDX to POOL,
+   first merging it with its buddy for as long as the buddy is
+   free as a whole. */
+static void
+buddy_free_block (struct pool *pool, size_t page_idx, int order)
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+
+  while (order + 1 < BUDDY_ORDER_CNT)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+
+      if (buddy + ((size_t) 1 << order) > page_cnt
+          || pool->free_order[buddy] != order + 1)
+        break;
+      list_remove (page_elem (pool, buddy));
+      pool->free_order[buddy] = 0;
+      page_idx &= ~((size_t) 1 << order);
+      order++;
+    }
+
+  pool->free_order[page_idx] = order + 1;
+  list_push_front (&pool->free_lists[order], page_elem (pool, page_idx));
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in POOL, split
+   into the largest aligned blocks that cover them. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = page_idx != 0 ? __builtin_ctz (page_idx)
+                                : BUDDY_ORDER_CNT - 1;
+
+      while (((size_t) 1 << order) > page_cnt)
+        order--;
+      buddy_free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Gives POOL's pre-zeroed pages back to the buddy allocator.
+   Interrupts must be off. */
+static void
+release_zeroed (struct pool *pool)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (pool->zeroed_cnt > 0)
+    {
+      void *page = pool->zeroed[--pool->zeroed_cnt];
+      size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+      bitmap_reset (pool->used_map, page_idx);
+      buddy_free (pool, page_idx, 1);
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is large
+   enough. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  int order = order_for (page_cnt);
+  size_t page_idx;
+  int k;
+
+  for (k = order; k < BUDDY_ORDER_CNT; k++)
+    if (!list_empty (&pool->free_lists[k]))
+      break;
+  if (k >= BUDDY_ORDER_CNT)
+    return BITMAP_ERROR;
+
+  page_idx = pg_no (list_pop_front (&pool->free_lists[k]))
+             - pg_no (pool->base);
+  pool->free_order[page_idx] = 0;
+
+  /* Give back the part of the block past PAGE_CNT. */
+  buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << k) - page_cnt);
+  return page_idx;
+}
+
+/* Takes the PAGE_CNT pages starting at PAGE_IDX, all of them
+   free, out of POOL's free blocks, giving back the parts of those
+   blocks that lie outside the range. */
+static void
+buddy_take (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t end = page_idx + page_cnt;
+  size_t i = page_idx;
+
+  while (i < end)
+    {
+      size_t start, block_end;
+      int order;
+
+      /* Find the free block that holds page I. */
+      for (order = 0; order < BUDDY_ORDER_CNT; order++)
+        {
+          start = i & ~(((size_t) 1 << order) - 1);
+          if (pool->free_order[start] == order + 1)
+            break;
+        }
+      ASSERT (order < BUDDY_ORDER_CNT);
+
+      list_remove (page_elem (pool, start));
+      pool->free_order[start] = 0;
+      block_end = start + ((size_t) 1 << order);
+      if (start < page_idx)
+        buddy_free (pool, start, page_idx - start);
+      if (block_end > end)
+        buddy_free (pool, end, block_end - end);
+      i = block_end;
+    }
+}
+
+/* Contiguous memory area. */
+
+/* Sets up the contiguous area in the PAGE_CNT pages at BASE,
+   keeping its bitmaps in the first of them. */
+static void
+init_cma (void *base, size_t page_cnt)
+{
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (2 * bm_size, PGSIZE);
+
+  if (bm_pages >= page_cnt)
+    PANIC ("Not enough memory in contiguous area for bitmaps.");
+  page_cnt -= bm_pages;
+
+  printf ("%zu pages available in contiguous area.\n", page_cnt);
+
+  lock_init_named (&cma.lock, "cma");
+  cma.used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  cma.movable_map = bitmap_create_in_buf (page_cnt,
+                                          (uint8_t *) base + bm_size,
+                                          bm_size);
+  cma.base = (uint8_t *) base + bm_pages * PGSIZE;
+  stats_add_size ("palloc", "cma", "used", &cma.used_cnt);
+  stats_add_size ("palloc", "cma", "movable", &cma.movable_cnt);
+  stats_add_uint64 ("palloc", "cma", "migrated", &cma.migrate_cnt);
+}
+
+/* Returns a free page of the contiguous area, outside any range
+   being claimed, for a movable page, or a null pointer if there
+   is none. */
+static void *
+cma_get_movable (void)
+{
+  enum intr_level old_level;
+  size_t page_idx;
+
+  if (cma.base == NULL)
+    return NULL;
+
+  old_level = intr_disable ();
+  page_idx = bitmap_scan (cma.used_map, 0, 1, false);
+  if (page_idx != BITMAP_ERROR && page_idx >= cma.claim_start
+      && page_idx < cma.claim_end)
+    page_idx = bitmap_scan (cma.used_map, cma.claim_end, 1, false);
+  if (page_idx != BITMAP_ERROR)
+    {
+      bitmap_mark (cma.used_map, page_idx);
+      bitmap_mark (cma.movable_map, page_idx);
+      cma.used_cnt++;
+      cma.movable_cnt++;
+    }
+  intr_set_level (old_level);
+
+  return page_idx != BITMAP_ERROR ? cma.base + PGSIZE * page_idx : NULL;
+}
+
+/* Moves the movable page at PAGE out of the contiguous area,
+   freeing it.  Returns false if it cannot be moved now. */
+static bool
+migrate (void *page UNUSED)
+{
+#ifdef VM
+  if (frame_migrate (page))
+    {
+      cma.migrate_cnt++;
+      return true;
+    }
+#endif
+  return false;
+}
+
+/* Claims the PAGE_CNT pages at START in the contiguous area, each
+   of which is free or movable, for a contiguous request, moving
+   the movable ones away.  Returns the number claimed: PAGE_CNT,
+   or fewer if the page after the last claimed could not be
+   moved.  Called with cma.lock held and the range marked as
+   being claimed, so that movable pages stay out of it. */
+static size_t
+claim_range (size_t start, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = start; i < start + page_cnt; )
+    {
+      enum intr_level old_level = intr_disable ();
+      bool used = bitmap_test (cma.used_map, i);
+
+      if (!used)
+        {
+          bitmap_mark (cma.used_map, i);
+          cma.used_cnt++;
+        }
+      intr_set_level (old_level);
+
+      /* A movable page is freed by being moved, and then claimed
+         on the next go. */
+      if (used && !migrate (cma.base + PGSIZE * i))
+        break;
+      if (!used)
+        i++;
+    }
+  return i - start;
+}
+
+/* Returns PAGE_CNT contiguous pages from the contiguous area, or
+   a null pointer if there is no run of that many pages that are
+   each free or movable, with the movable ones moving. */
+static void *
+cma_get_contiguous (size_t page_cnt)
+{
+  size_t area_cnt = bitmap_size (cma.used_map);
+  size_t start, claimed, i;
+  void *pages = NULL;
+
+  lock_acquire (&cma.lock);
+  for (start = 0; start + page_cnt <= area_cnt; start += claimed + 1)
+    {
+      enum intr_level old_level = intr_disable ();
+
+      /* Skip past any page of another contiguous request. */
+      for (i = start; i < start + page_cnt; i++)
+        if (bitmap_test (cma.used_map, i)
+            && !bitmap_test (cma.movable_map, i))
+          break;
+      if (i < start + page_cnt)
+        {
+          intr_set_level (old_level);
+          claimed = i - start;
+          continue;
+        }
+      cma.claim_start = start;
+      cma.claim_end = start + page_cnt;
+      intr_set_level (old_level);
+
+      claimed = claim_range (start, page_cnt);
+
+      old_level = intr_disable ();
+      cma.claim_start = cma.claim_end = 0;
+      if (claimed == page_cnt)
+        pages = cma.base + PGSIZE * start;
+      else
+        {
+          bitmap_set_multiple (cma.used_map, start, claimed, false);
+          cma.used_cnt -= claimed;
+        }
+      intr_set_level (old_level);
+      if (pages != NULL)
+        break;
+    }
+  lock_release (&cma.lock);
+  return pages;
+}
+
+/* Returns true if PAGE is in the contiguous area. */
+static bool
+page_from_cma (void *page)
+{
+  return (cma.base != NULL && (uint8_t *) page >= cma.base
+          && pg_no (page) - pg_no (cma.base) < bitmap_size (cma.used_map));
+}
+
+/* Frees the PAGE_CNT pages at PAGES in the contiguous area. */
+static void
+cma_free (void *pages, size_t page_cnt)
+{
+  size_t page_idx = pg_no (pages) - pg_no (cma.base);
+  enum intr_level old_level = intr_disable ();
+
+  ASSERT (bitmap_all (cma.used_map, page_idx, page_cnt));
+  if (bitmap_test (cma.movable_map, page_idx))
+    {
+      ASSERT (page_cnt == 1);
+      bitmap_reset (cma.movable_map, page_idx);
+      cma.movable_cnt--;
+    }
+  bitmap_set_multiple (cma.used_map, page_idx, page_cnt, false);
+  cma.used_cnt -= page_cnt;
+  intr_set_level (old_level);
+}
+
+/* Accounting. */
+
+/* Charges the PAGE_CNT pages starting at PAGE_IDX in POOL, just
+   handed out, to CALLER.  Interrupts must be off. */
+static void
+charge (struct pool *pool, size_t page_idx, size_t page_cnt, void *caller)
+{
+  struct site *s;
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 1; i < site_cnt; i++)
+    if (sites[i].caller == caller && sites[i].pool == pool)
+      break;
+  if (i == site_cnt && site_cnt < SITE_MAX)
+    {
+      sites[i].caller = caller;
+      sites[i].pool = pool;
+      site_cnt++;
+    }
+  else if (i == site_cnt)
+    i = 0;
+
+  s = &sites[i];
+  memset (pool->site_of + page_idx, i, page_cnt);
+  s->alloc_cnt++;
+  s->live_cnt += page_cnt;
+  if (s->live_cnt > s->peak_cnt)
+    s->peak_cnt = s->live_cnt;
+  pool->used_cnt += page_cnt;
+  if (pool->used_cnt > pool->peak_cnt)
+    pool->peak_cnt = pool->used_cnt;
+}
+
+/* Takes the PAGE_CNT pages starting at PAGE_IDX in POOL, about to
+   be freed, off their call sites.  Interrupts must be off. */
+static void
+uncharge (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  size_t i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = page_idx; i < page_idx + page_cnt; i++)
+    sites[pool->site_of[i]].live_cnt--;
+  pool->used_cnt -= page_cnt;
+}
+
+/* Fills in the page pool members of *STATS. */
+void
+palloc_get_stats (struct memstat *stats)
+{
+  enum intr_level old_level = intr_disable ();
+
+  stats->kernel_pages = bitmap_size (kernel_pool.used_map);
+  stats->kernel_used = kernel_pool.used_cnt;
+  stats->kernel_peak = kernel_pool.peak_cnt;
+  stats->user_pages = bitmap_size (user_pool.used_map);
+  stats->user_used = user_pool.used_cnt;
+  stats->user_peak = user_pool.peak_cnt;
+  intr_set_level (old_level);
+}
+
+/* Prints each pool's usage, then the call sites holding the most
+   pages.  The addresses can be turned into function names with
+   the backtrace utility. */
+void
+palloc_print_stats (void)
+{
+  struct pool *pools[] = { &kernel_pool, &user_pool };
+  bool printed[SITE_MAX];
+  size_t i;
+
+  for (i = 0; i < sizeof pools / sizeof *pools; i++)
+    printf ("Palloc %s: %zu pages, %zu used (peak %zu), %zu pre-zeroed\n",
+            pools[i]->name, bitmap_size (pools[i]->used_map),
+            pools[i]->used_cnt, pools[i]->peak_cnt, pools[i]->zeroed_cnt);
+  if (cma.base != NULL)
+    printf ("Palloc contiguous area: %zu pages, %zu used (%zu movable), "
+            "%"PRIu64" migrated\n",
+            bitmap_size (cma.used_map), cma.used_cnt, cma.movable_cnt,
+            cma.migrate_cnt);
+
+  memset (printed, 0, sizeof printed);
+  for (i = 0; i < SITE_TOP; i++)
+    {
+      struct site *s = NULL;
+      size_t j;
+
+      for (j = 0; j < site_cnt; j++)
+        if (!printed[j] && sites[j].live_cnt > 0
+            && (s == NULL || sites[j].live_cnt > s->live_cnt))
+          s = &sites[j];
+      if (s == NULL)
+        break;
+      printed[s - sites] = true;
+
+      if (s->caller != NULL)
+        printf ("Palloc site %p (%s):", s->caller, s->pool->name);
+      else
+        printf ("Palloc other sites:");
+      printf (" %zu pages live (peak %zu), %u allocations\n",
+              s->live_cnt, s->peak_cnt, s->alloc_cnt);
+    }
+}
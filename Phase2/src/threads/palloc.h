@@ -1,20 +1,37 @@
 #ifndef THREADS_PALLOC_H
 #define THREADS_PALLOC_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <memstat.h>
 
 /* How to allocate pages. */
 enum palloc_flags
   {
     PAL_ASSERT = 001,           /* Panic on failure. */
     PAL_ZERO = 002,             /* Zero page contents. */
-    PAL_USER = 004              /* User page. */
+    PAL_USER = 004,             /* User page. */
+    PAL_MOVABLE = 010           /* User page frame_migrate() can move. */
   };
 
+/* Use the bitmap allocator instead of the buddy allocator? */
+extern bool palloc_bitmap;
+
+/* Pages of the user pool set aside as the contiguous area. */
+extern size_t palloc_cma_pages;
+
 void palloc_init (size_t user_page_limit);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_aligned (enum palloc_flags, size_t page_cnt);
+void *palloc_get_contiguous (enum palloc_flags, size_t page_cnt);
+bool palloc_extend (void *pages, size_t page_cnt, size_t new_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_free_pages (void **pages, size_t page_cnt);
+void palloc_free_zeroed (void *);
+bool palloc_zero_idle (void);
+void palloc_get_stats (struct memstat *);
+void palloc_print_stats (void);
 
 #endif /* threads/palloc.h */
@@ -0,0 +1,92 @@
+#ifndef THREADS_PERCPU_H
+#define THREADS_PERCPU_H
+
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* Per-CPU event counters.
+
+   A counter bumped on a hot path, such as ticks, sectors read or
+   page faults, keeps a slot per CPU, each in a cache line of its
+   own.  percpu_add() touches only the running CPU's slot, so CPUs
+   never contend for a counter's line and need no locked
+   instruction, and percpu_sum() adds the slots up when the
+   counter is read, which is rare.
+
+   The 64-bit add takes two instructions on an 80x86, so it runs
+   with interrupts off, which keeps an interrupt handler counting
+   the same event from losing an update.  A reader summing
+   another CPU's slot could see it torn mid-add, and would want
+   each slot read with a cmpxchg8b; with one CPU it cannot
+   happen.
+
+   Pintos runs on one CPU, so every counter has a single slot, but
+   nothing outside this file depends on that. */
+
+/* Bytes in a CPU cache line. */
+#define CACHE_LINE 64
+
+/* CPUs with a slot in each counter. */
+#define CPU_CNT 1
+
+/* One CPU's part of a counter. */
+struct percpu_slot
+  {
+    int64_t value;
+  } __attribute__ ((aligned (CACHE_LINE)));
+
+/* A per-CPU counter.  A static one starts at zero; one in
+   allocated memory must be cleared with percpu_reset(). */
+struct percpu_counter
+  {
+    struct percpu_slot cpu[CPU_CNT];
+  };
+
+/* Returns the number of the CPU the caller runs on. */
+static inline unsigned
+cpu_id (void)
+{
+  return 0;
+}
+
+/* Adds N to counter C, in the running CPU's slot. */
+static inline void
+percpu_add (struct percpu_counter *c, int64_t n)
+{
+  enum intr_level old_level = intr_disable ();
+  c->cpu[cpu_id ()].value += n;
+  intr_set_level (old_level);
+}
+
+/* Adds 1 to counter C. */
+static inline void
+percpu_inc (struct percpu_counter *c)
+{
+  percpu_add (c, 1);
+}
+
+/* Returns the value of counter C, summed over every CPU. */
+static inline int64_t
+percpu_sum (const struct percpu_counter *c)
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t sum = 0;
+  unsigned i;
+
+  for (i = 0; i < CPU_CNT; i++)
+    sum += c->cpu[i].value;
+  intr_set_level (old_level);
+  return sum;
+}
+
+/* Sets counter C to zero on every CPU. */
+static inline void
+percpu_reset (struct percpu_counter *c)
+{
+  unsigned i;
+
+  for (i = 0; i < CPU_CNT; i++)
+    c->cpu[i].value = 0;
+}
+
+#endif /* threads/percpu.h */
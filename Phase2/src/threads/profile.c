@@ -0,0 +1,248 @@
+#include "threads/profile.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#endif
+
+/* Sampling profiler.
+
+   With the "-profile" kernel command-line option, every timer
+   interrupt records where it interrupted: the interrupted EIP
+   and up to PROFILE_DEPTH - 1 return addresses found by
+   following the saved frame pointers.  Samples are counted in a
+   hash table keyed on that call chain, on whether the processor
+   was in user or kernel mode, and on the user program, if any,
+   whose address space was active.  profile_print() lists the
+   table at power off, for "backtrace --profile" to symbolize.
+
+   The kernel and the user programs are compiled without
+   -fomit-frame-pointer, so the chains are usually complete. */
+
+/* Return addresses kept per sample, counting EIP. */
+#define PROFILE_DEPTH 6
+
+/* Hash table size, in pages, and capacity. */
+#define PROFILE_PAGES 16
+#define PROFILE_SLOTS (PROFILE_PAGES * PGSIZE / sizeof (struct sample))
+
+/* Most distinct user programs told apart.  Samples from the
+   rest are counted under the last. */
+#define PROFILE_PROGS 32
+
+/* A distinct call chain and its sample count. */
+struct sample
+  {
+    uint32_t pc[PROFILE_DEPTH]; /* EIP, then return addresses, or 0. */
+    uint8_t user;               /* Sampled in user mode? */
+    uint8_t prog;               /* Index in progs[], or PROG_NONE. */
+    uint16_t cnt;               /* # of times sampled (saturates). */
+  };
+
+/* Value of prog for kernel threads, which have no address
+   space of their own. */
+#define PROG_NONE 0xff
+
+/* If false (default), do not profile.
+   Controlled by kernel command-line option "-profile". */
+bool thread_profile;
+
+static struct sample *samples;  /* Hash table of PROFILE_SLOTS. */
+static char progs[PROFILE_PROGS][16]; /* User program names. */
+static unsigned sample_cnt;     /* # of samples taken. */
+static unsigned dropped_cnt;    /* # of samples with no room. */
+
+static int walk_frames (const struct intr_frame *, uint32_t pc[]);
+#ifdef USERPROG
+static int intern_prog (const char *name);
+#endif
+
+/* Allocates the sample table and starts profiling, if
+   "-profile" was given. */
+void
+profile_init (void)
+{
+  if (!thread_profile)
+    return;
+
+  samples = palloc_get_multiple (PAL_ZERO, PROFILE_PAGES);
+  if (samples == NULL)
+    PANIC ("profile: out of memory for sample table");
+}
+
+/* Records a sample of the code that timer interrupt frame F
+   interrupted.  Called in the timer interrupt handler. */
+void
+profile_sample (const struct intr_frame *f)
+{
+  struct sample key;
+  uint32_t hash;
+  size_t i;
+  int j;
+
+  ASSERT (intr_context ());
+
+  if (samples == NULL)
+    return;
+  sample_cnt++;
+
+  memset (&key, 0, sizeof key);
+  walk_frames (f, key.pc);
+  key.prog = PROG_NONE;
+#ifdef USERPROG
+  key.user = f->cs == SEL_UCSEG;
+  if (thread_current ()->process != NULL
+      && thread_current ()->process->pagedir != NULL)
+    key.prog = intern_prog (thread_current ()->name);
+#endif
+
+  /* FNV-1a over the chain and the address space. */
+  hash = 2166136261u;
+  for (j = 0; j < PROFILE_DEPTH; j++)
+    hash = (hash ^ key.pc[j]) * 16777619u;
+  hash = (hash ^ (key.user << 8 | key.prog)) * 16777619u;
+
+  /* Linear probing.  Entries are never removed, so the first
+     empty slot ends the search. */
+  for (i = 0; i < PROFILE_SLOTS; i++)
+    {
+      struct sample *s = &samples[(hash + i) % PROFILE_SLOTS];
+      if (s->cnt == 0)
+        {
+          *s = key;
+          s->cnt = 1;
+          return;
+        }
+      if (!memcmp (s->pc, key.pc, sizeof key.pc)
+          && s->user == key.user && s->prog == key.prog)
+        {
+          if (s->cnt != UINT16_MAX)
+            s->cnt++;
+          return;
+        }
+    }
+  dropped_cnt++;
+}
+
+/* Prints the sample table, one line per call chain:
+   "profile: K|U PROGRAM COUNT EIP CALLER...", where PROGRAM is
+   "-" for kernel threads. */
+void
+profile_print (void)
+{
+  size_t i;
+
+  if (samples == NULL)
+    return;
+
+  printf ("profile: begin %u samples, %u dropped\n",
+          sample_cnt, dropped_cnt);
+  for (i = 0; i < PROFILE_SLOTS; i++)
+    {
+      const struct sample *s = &samples[i];
+      int j;
+
+      if (s->cnt == 0)
+        continue;
+      printf ("profile: %c %s %u", s->user ? 'U' : 'K',
+              s->prog != PROG_NONE ? progs[s->prog] : "-", s->cnt);
+      for (j = 0; j < PROFILE_DEPTH && s->pc[j] != 0; j++)
+        printf (" %#"PRIx32, s->pc[j]);
+      printf ("\n");
+    }
+  printf ("profile: end\n");
+}
+
+/* Reads the 32-bit word at ADDR in the interrupted context into
+   *WORD.  Returns false if ADDR is not a readable stack
+   address: one in the running thread's kernel stack for kernel
+   frames, or one mapped in its page directory for user
+   frames. */
+static bool
+read_stack (bool user UNUSED, uint32_t addr, uint32_t *word)
+{
+  if (addr % sizeof (uint32_t) != 0)
+    return false;
+#ifdef USERPROG
+  if (user)
+    {
+      uint32_t *kaddr;
+
+      if (!is_user_vaddr ((void *) addr)
+          || thread_current ()->process == NULL)
+        return false;
+      kaddr = pagedir_get_page (thread_current ()->process->pagedir,
+                                (void *) addr);
+      if (kaddr == NULL)
+        return false;
+      *word = *kaddr;
+      return true;
+    }
+#endif
+  if (pg_round_down ((void *) addr) != thread_current ())
+    return false;
+  *word = *(uint32_t *) addr;
+  return true;
+}
+
+/* Fills PC[] with the interrupted EIP and the return addresses
+   of its callers, from the frame pointer chain in F's context,
+   and returns how many it found. */
+static int
+walk_frames (const struct intr_frame *f, uint32_t pc[])
+{
+  bool user = false;
+  uint32_t ebp = f->ebp;
+  int n = 0;
+
+#ifdef USERPROG
+  user = f->cs == SEL_UCSEG;
+#endif
+  pc[n++] = (uint32_t) f->eip;
+  while (n < PROFILE_DEPTH)
+    {
+      uint32_t next, ret;
+
+      if (!read_stack (user, ebp, &next)
+          || !read_stack (user, ebp + sizeof next, &ret)
+          || ret == 0)
+        break;
+      pc[n++] = ret;
+
+      /* Stacks grow down, so callers' frames are higher. */
+      if (next <= ebp)
+        break;
+      ebp = next;
+    }
+  return n;
+}
+
+#ifdef USERPROG
+/* # of names in progs[]. */
+static int prog_cnt;
+
+/* Returns the index in progs[] for the user program NAME,
+   adding it if it is new. */
+static int
+intern_prog (const char *name)
+{
+  int i;
+
+  for (i = 0; i < prog_cnt; i++)
+    if (!strcmp (progs[i], name))
+      return i;
+  if (prog_cnt == PROFILE_PROGS)
+    return PROFILE_PROGS - 1;
+  strlcpy (progs[prog_cnt], name, sizeof progs[prog_cnt]);
+  return prog_cnt++;
+}
+#endif
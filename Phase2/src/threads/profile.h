@@ -0,0 +1,14 @@
+#ifndef THREADS_PROFILE_H
+#define THREADS_PROFILE_H
+
+#include <stdbool.h>
+
+struct intr_frame;
+
+extern bool thread_profile;
+
+void profile_init (void);
+void profile_sample (const struct intr_frame *);
+void profile_print (void);
+
+#endif /* threads/profile.h */
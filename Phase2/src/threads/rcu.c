@@ -0,0 +1,154 @@
+#include "threads/rcu.h"
+#include <debug.h>
+#include <stats.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+
+/* Read-copy update.
+
+   A reader of a table that changes rarely, such as a process's
+   fd table, brackets its lookup with rcu_read_lock() and
+   rcu_read_unlock() instead of taking a lock.  A writer, still
+   serialized with other writers by a lock, builds the new version
+   of what it changes, publishes it with rcu_assign_pointer(), and
+   passes the old one to call_rcu(), which frees it once no reader
+   can still be looking at it.
+
+   A read-side critical section may not sleep or yield, and is not
+   preempted: it runs with preemption off, so a timer interrupt
+   that would switch threads during one puts the switch off until
+   rcu_read_unlock() leaves the outermost section.  On one CPU, then, a
+   thread that reaches schedule() is not reading, and every reader
+   that was running when call_rcu() was called has finished once
+   a thread switch has happened since.  schedule() counts switches
+   through rcu_quiescent(), and call_rcu() notes the count, which
+   makes that the whole of grace-period detection.  With several
+   CPUs each would keep its own count, and a grace period would
+   end when all of them had moved on.
+
+   Callbacks run in FIFO order, in a worker of the "rcu"
+   workqueue, which is queued whenever there are callbacks waiting
+   and it is not. */
+
+/* Callbacks waiting for their grace period, oldest first, with
+   interrupts off. */
+static struct list callbacks;
+static bool reclaim_queued;             /* Reclaim item in rcu_wq? */
+static struct workqueue *rcu_wq;
+
+/* Calls to schedule() since boot. */
+static unsigned switch_cnt;
+
+/* Callbacks run. */
+static int64_t callback_cnt;
+
+static wq_func reclaim;
+
+/* Initializes read-copy update. */
+void
+rcu_init (void)
+{
+  list_init (&callbacks);
+  rcu_wq = wq_create ("rcu", PRI_DEFAULT, 1);
+  if (rcu_wq == NULL)
+    PANIC ("rcu_init: out of memory");
+  stats_add_int64 ("rcu", NULL, "callbacks", &callback_cnt);
+}
+
+/* Begins a read-side critical section.  Sections may nest. */
+void
+rcu_read_lock (void)
+{
+  preempt_disable ();
+}
+
+/* Ends a read-side critical section, yielding now if the thread
+   would have been preempted during the outermost one. */
+void
+rcu_read_unlock (void)
+{
+  preempt_enable ();
+}
+
+/* Has FUNC called with HEAD once every read-side critical section
+   under way has ended.  May not be called from an interrupt
+   handler.  FUNC runs in a kernel thread and may sleep. */
+void
+call_rcu (struct rcu_head *head, rcu_func *func)
+{
+  enum intr_level old_level;
+  bool submit;
+
+  ASSERT (!intr_context ());
+
+  head->func = func;
+  old_level = intr_disable ();
+  head->gp = switch_cnt;
+  list_push_back (&callbacks, &head->elem);
+  submit = !reclaim_queued;
+  reclaim_queued = true;
+  intr_set_level (old_level);
+
+  /* If memory is short, the callbacks wait for the next call. */
+  if (submit && !wq_submit (rcu_wq, reclaim, NULL))
+    {
+      old_level = intr_disable ();
+      reclaim_queued = false;
+      intr_set_level (old_level);
+    }
+}
+
+/* Waits until every callback passed to call_rcu() so far has
+   run. */
+void
+rcu_barrier (void)
+{
+  wq_flush (rcu_wq);
+}
+
+/* Notes that CUR, the running thread, is going through
+   schedule(), which it may not do in a read-side critical
+   section, or with preemption off at all.  Interrupts must be
+   off. */
+void
+rcu_quiescent (const struct thread *cur)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (cur->preempt_count == 0);
+
+  switch_cnt++;
+}
+
+/* Runs the callbacks whose grace periods have ended, yielding
+   until the rest's have, then until there are none. */
+static void
+reclaim (void *aux UNUSED)
+{
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      struct rcu_head *head;
+
+      if (list_empty (&callbacks))
+        {
+          reclaim_queued = false;
+          intr_set_level (old_level);
+          return;
+        }
+      head = list_entry (list_front (&callbacks), struct rcu_head, elem);
+      if (head->gp == switch_cnt)
+        {
+          /* Queued since the last switch, perhaps by a callback. */
+          intr_set_level (old_level);
+          thread_yield ();
+          continue;
+        }
+      list_pop_front (&callbacks);
+      intr_set_level (old_level);
+
+      head->func (head);
+      callback_cnt++;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef THREADS_RCU_H
+#define THREADS_RCU_H
+
+#include <list.h>
+#include <stdbool.h>
+#include "threads/synch.h"
+
+struct thread;
+
+/* Read-copy update, for tables that are read far more often than
+   they change.  See rcu.c. */
+
+/* Called once a grace period has passed since call_rcu(). */
+struct rcu_head;
+typedef void rcu_func (struct rcu_head *);
+
+/* Embedded in an object to be freed by call_rcu(). */
+struct rcu_head
+  {
+    struct list_elem elem;              /* In the callback list. */
+    rcu_func *func;                     /* Frees the object. */
+    unsigned gp;                        /* Switch count when queued. */
+  };
+
+/* Reads pointer P in a read-side critical section, so that what
+   it points to is read after it. */
+#define rcu_dereference(P) \
+        ({ typeof (P) p_ = (P); barrier (); p_; })
+
+/* Sets pointer P to V, which readers may then follow, after the
+   stores that filled in what V points to. */
+#define rcu_assign_pointer(P, V) \
+        do { barrier (); (P) = (V); } while (0)
+
+void rcu_init (void);
+void rcu_read_lock (void);
+void rcu_read_unlock (void);
+void call_rcu (struct rcu_head *, rcu_func *);
+void rcu_barrier (void);
+
+void rcu_quiescent (const struct thread *);
+
+#endif /* threads/rcu.h */
@@ -0,0 +1,170 @@
+#include "threads/softirq.h"
+#include <debug.h>
+#include <stats.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+
+/* Deferred interrupt work.
+
+   An external interrupt handler does with interrupts off only
+   what cannot wait, such as acknowledging the device, and raises
+   a softirq for the rest.  Each softirq has a bit in PENDING and
+   keeps its own queue of work, such as the list of due alarms or
+   of finished block requests.
+
+   Pending softirqs run as the outermost external interrupt
+   returns, after the PIC has been acknowledged, with interrupts
+   on, so that other devices are heard while they run.  They
+   still run in interrupt context: intr_context() is true, so
+   that a thread they wake preempts on the way out, and they may
+   not sleep.  Another interrupt that arrives meanwhile only adds
+   to PENDING, to be seen by the loop already running.
+
+   If softirqs are still being raised after SOFTIRQ_ROUNDS rounds,
+   the rest is handed to a kernel thread at PRI_MAX, so that the
+   interrupted thread gets to run again in between. */
+
+/* Rounds of pending softirqs run on one interrupt return. */
+#define SOFTIRQ_ROUNDS 4
+
+/* Handlers by softirq number. */
+static softirq_func *handlers[SOFTIRQ_CNT];
+
+/* Bit N set if softirq N has been raised and not yet run.
+   Changed only with interrupts off. */
+static unsigned pending;
+
+/* True while softirqs are running, on interrupt return or in
+   softirqd. */
+static bool running;
+
+/* The softirq thread, and whether it is blocked waiting for
+   work.  Null until softirq_start(). */
+static struct thread *softirqd_thread;
+static bool softirqd_idle;
+
+/* Rounds run on interrupt return and handed to softirqd. */
+static int64_t inline_rounds;
+static int64_t deferred_rounds;
+
+static void run_round (void);
+static thread_func softirqd;
+
+/* Sets HANDLER to do the work of softirq NR. */
+void
+softirq_register (enum softirq nr, softirq_func *handler) 
+{
+  ASSERT (nr < SOFTIRQ_CNT);
+  ASSERT (handlers[nr] == NULL);
+
+  handlers[nr] = handler;
+}
+
+/* Starts softirqd.  Until then, softirqs left over after
+   SOFTIRQ_ROUNDS wait for the next interrupt. */
+void
+softirq_start (void) 
+{
+  stats_add_int64 ("softirq", NULL, "inline.rounds", &inline_rounds);
+  stats_add_int64 ("softirq", NULL, "softirqd.rounds", &deferred_rounds);
+  thread_create ("softirqd", PRI_MAX, softirqd, NULL);
+}
+
+/* Marks softirq NR pending, to run when interrupts next return. */
+void
+softirq_raise (enum softirq nr) 
+{
+  enum intr_level old_level;
+
+  ASSERT (nr < SOFTIRQ_CNT);
+  ASSERT (handlers[nr] != NULL);
+
+  old_level = intr_disable ();
+  pending |= 1u << nr;
+  intr_set_level (old_level);
+}
+
+/* Runs pending softirqs.  Called by intr_handler() as the
+   outermost external interrupt returns, with interrupts off,
+   and returns with them off again.  Does nothing if softirqs
+   are already running. */
+void
+softirq_run (void) 
+{
+  int round;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (running || pending == 0)
+    return;
+
+  running = true;
+  for (round = 0; round < SOFTIRQ_ROUNDS && pending != 0; round++)
+    {
+      run_round ();
+      inline_rounds++;
+    }
+  if (pending != 0 && softirqd_idle)
+    {
+      softirqd_idle = false;
+      thread_unblock (softirqd_thread);
+      intr_yield_on_return ();
+    }
+  running = false;
+}
+
+/* Returns true while softirqs are running.  They count as
+   interrupt context. */
+bool
+softirq_active (void) 
+{
+  return running;
+}
+
+/* Runs the handler of every softirq pending now, with interrupts
+   on.  Ones raised meanwhile wait for the next round.  Interrupts
+   must be off, and are off again on return. */
+static void
+run_round (void) 
+{
+  unsigned todo = pending;
+  int nr;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (running);
+
+  pending = 0;
+  intr_enable ();
+  for (nr = 0; nr < SOFTIRQ_CNT; nr++)
+    if (todo & (1u << nr))
+      handlers[nr] ();
+  intr_disable ();
+}
+
+/* Runs softirqs that interrupt return left over, one round at a
+   time, until none are pending. */
+static void
+softirqd (void *aux UNUSED) 
+{
+  intr_disable ();
+  softirqd_thread = thread_current ();
+  for (;;)
+    {
+      while (pending == 0)
+        {
+          softirqd_idle = true;
+          thread_block ();
+        }
+
+      running = true;
+      run_round ();
+      deferred_rounds++;
+      running = false;
+
+      /* Let other threads run between rounds. */
+      intr_enable ();
+      thread_yield ();
+      intr_disable ();
+    }
+}
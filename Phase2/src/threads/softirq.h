@@ -0,0 +1,24 @@
+#ifndef THREADS_SOFTIRQ_H
+#define THREADS_SOFTIRQ_H
+
+#include <stdbool.h>
+
+/* Deferred interrupt work. */
+enum softirq
+  {
+    SOFTIRQ_TIMER,              /* Wake threads whose alarms are due. */
+    SOFTIRQ_BLOCK,              /* Complete finished block requests. */
+    SOFTIRQ_CNT                 /* Number of softirqs. */
+  };
+
+/* Does the deferred work of one softirq.  Called with
+   interrupts on, in interrupt context: it may not sleep. */
+typedef void softirq_func (void);
+
+void softirq_register (enum softirq, softirq_func *);
+void softirq_start (void);
+void softirq_raise (enum softirq);
+void softirq_run (void);
+bool softirq_active (void);
+
+#endif /* threads/softirq.h */
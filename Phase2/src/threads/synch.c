@@ -27,11 +27,186 @@
 */
 
 #include "threads/synch.h"
+#include <stats.h>
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* Arrival counter for wait_elem.seq. */
+static unsigned wait_seq;
+
+/* Returns the priority T waits with: its own, or the same for
+   every thread under the stride scheduler, which wakes waiters
+   in the order they came. */
+static inline int
+wait_priority (const struct thread *t) 
+{
+  return thread_stride ? PRI_MIN : t->priority;
+}
+
+/* Returns true if A should be woken before B. */
+static bool
+wait_before (const struct wait_elem *a, const struct wait_elem *b) 
+{
+  if (a->priority != b->priority)
+    return a->priority > b->priority;
+  return (int) (a->seq - b->seq) < 0;
+}
+
+/* Links heaps A and B, either of which may be empty, and returns
+   the root of the result.  A and B must be detached roots. */
+static struct wait_elem *
+wait_meld (struct wait_elem *a, struct wait_elem *b) 
+{
+  if (a == NULL)
+    return b;
+  if (b == NULL)
+    return a;
+  if (wait_before (b, a)) 
+    {
+      struct wait_elem *t = a;
+      a = b;
+      b = t;
+    }
+  b->prev = a;
+  b->next = a->child;
+  if (a->child != NULL)
+    a->child->prev = b;
+  a->child = b;
+  return a;
+}
+
+/* Combines the sibling list starting at FIRST into one heap with
+   the usual two passes: meld pairs left to right, then meld the
+   pairs right to left. */
+static struct wait_elem *
+wait_merge_pairs (struct wait_elem *first) 
+{
+  struct wait_elem *pairs = NULL;
+  struct wait_elem *result = NULL;
+
+  while (first != NULL) 
+    {
+      struct wait_elem *a = first;
+      struct wait_elem *b = a->next;
+      struct wait_elem *m;
+
+      first = b != NULL ? b->next : NULL;
+      a->next = a->prev = NULL;
+      if (b != NULL)
+        b->next = b->prev = NULL;
+      m = wait_meld (a, b);
+      m->next = pairs;
+      pairs = m;
+    }
+  while (pairs != NULL) 
+    {
+      struct wait_elem *m = pairs;
+      pairs = m->next;
+      m->next = NULL;
+      result = wait_meld (result, m);
+    }
+  return result;
+}
+
+/* Initializes Q as an empty wait queue. */
+void
+wait_queue_init (struct wait_queue *q) 
+{
+  ASSERT (q != NULL);
+  q->root = NULL;
+}
+
+/* Returns true if no thread waits in Q. */
+bool
+wait_queue_empty (const struct wait_queue *q) 
+{
+  return q->root == NULL;
+}
+
+/* Queues E for thread T in Q, keyed by the priority T waits
+   with.  Interrupts must be off. */
+void
+wait_queue_push (struct wait_queue *q, struct wait_elem *e, struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  e->thread = t;
+  e->queue = q;
+  e->priority = wait_priority (t);
+  e->seq = wait_seq++;
+  e->child = e->next = e->prev = NULL;
+  q->root = wait_meld (q->root, e);
+}
+
+/* Removes and returns the first element of Q, which must not be
+   empty.  Interrupts must be off. */
+struct wait_elem *
+wait_queue_pop (struct wait_queue *q) 
+{
+  struct wait_elem *e = q->root;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (e != NULL);
+
+  q->root = wait_merge_pairs (e->child);
+  e->queue = NULL;
+  return e;
+}
+
+/* Removes E, which may be anywhere in its queue. */
+static void
+wait_queue_remove (struct wait_elem *e) 
+{
+  struct wait_queue *q = e->queue;
+  struct wait_elem *sub;
+
+  if (q->root == e)
+    {
+      wait_queue_pop (q);
+      return;
+    }
+
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+
+  sub = wait_merge_pairs (e->child);
+  q->root = wait_meld (q->root, sub);
+  e->queue = NULL;
+}
+
+/* Requeues E if its thread's priority is no longer the one E was
+   queued with. */
+static void
+wait_elem_requeue (struct wait_elem *e) 
+{
+  if (e != NULL && e->queue != NULL
+      && e->priority != wait_priority (e->thread))
+    {
+      struct wait_queue *q = e->queue;
+      wait_queue_remove (e);
+      wait_queue_push (q, e, e->thread);
+    }
+}
+
+/* Repositions T in the semaphore and condition variable queues
+   it waits in after its priority changed.  Interrupts must be
+   off. */
+void
+wait_queue_priority_changed (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  wait_elem_requeue (&t->wait_elem);
+  wait_elem_requeue (t->cond_elem);
+}
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -47,7 +222,112 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  wait_queue_init (&sema->waiters);
+  sema->signaler = NULL;
+  sema->donated_tickets = 0;
+  sema->donated_priority = PRI_NONE;
+}
+
+/* Under the stride scheduler, a thread waiting for a semaphore
+   with an expected signaler, such as a lock's holder, lends its
+   tickets, own and donated, to the signaler, so that a signaler
+   with few tickets cannot keep one with many waiting for long.
+   A semaphore's donated_tickets counts those of the threads
+   waiting for it, and a thread's those of every semaphore it is
+   the signaler of.  Lends AMOUNT more tickets to T, or takes
+   them back if AMOUNT is negative, passing them on down the
+   chain of signalers while each is itself waiting.  Interrupts
+   must be off. */
+static void
+donate (struct thread *t, int amount)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (t != NULL)
+    {
+      struct semaphore *sema = t->waiting_sema;
+
+      t->donated_tickets += amount;
+      if (sema == NULL)
+        break;
+      sema->donated_tickets += amount;
+      t = sema->signaler;
+    }
+}
+
+/* Returns true if threads lend their priorities, as they do
+   unless the stride scheduler or "-o mlfqs" is in use. */
+static inline bool
+priority_donation (void)
+{
+  return !thread_stride && !thread_mlfqs;
+}
+
+/* Returns the highest priority of the threads in WAITERS, or
+   PRI_NONE if it is empty. */
+static inline int
+top_priority (const struct wait_queue *waiters)
+{
+  return wait_queue_empty (waiters) ? PRI_NONE : waiters->root->priority;
+}
+
+/* Unless the stride scheduler or "-o mlfqs" is in use, a thread
+   waiting for a semaphore with a signaler lends it its priority
+   instead of tickets, so that a low-priority lock holder cannot
+   keep a high-priority waiter behind threads of middling
+   priority.  A semaphore lends its signaler the highest priority
+   of its waiters, its donated_priority.  Changes the priority T is lent
+   by a semaphore from OLD to NEW, passing the change on down the
+   chain of signalers while each is itself waiting.  Interrupts
+   must be off. */
+static void
+lend_priority (struct thread *t, int old, int new)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (t != NULL && old != new && thread_lend_priority (t, old, new))
+    {
+      struct semaphore *sema = t->waiting_sema;
+
+      if (sema == NULL)
+        break;
+      old = sema->donated_priority;
+      new = sema->donated_priority = top_priority (&sema->waiters);
+      t = sema->signaler;
+    }
+}
+
+/* Makes T, or no thread if T is null, the thread expected to up
+   SEMA, to which threads waiting for SEMA lend their tickets
+   under the stride scheduler, or else their priorities.  T must
+   stay alive until it stops being SEMA's signaler or SEMA has no
+   more waiters. */
+void
+sema_set_signaler (struct semaphore *sema, struct thread *t) 
+{
+  enum intr_level old_level;
+
+  ASSERT (sema != NULL);
+
+  if (!thread_stride && !priority_donation ())
+    {
+      sema->signaler = t;
+      return;
+    }
+  old_level = intr_disable ();
+  if (thread_stride)
+    {
+      donate (sema->signaler, -sema->donated_tickets);
+      sema->signaler = t;
+      donate (t, sema->donated_tickets);
+    }
+  else
+    {
+      lend_priority (sema->signaler, sema->donated_priority, PRI_NONE);
+      sema->signaler = t;
+      lend_priority (t, PRI_NONE, sema->donated_priority);
+    }
+  intr_set_level (old_level);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -68,7 +348,23 @@ sema_down (struct semaphore *sema)
   old_level = intr_disable ();
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      struct thread *cur = thread_current ();
+
+      cur->waiting_sema = sema;
+      if (thread_stride)
+        {
+          int tickets = cur->tickets + cur->donated_tickets;
+          sema->donated_tickets += tickets;
+          donate (sema->signaler, tickets);
+        }
+      else if (priority_donation ()
+               && cur->priority > sema->donated_priority)
+        {
+          int old = sema->donated_priority;
+          sema->donated_priority = cur->priority;
+          lend_priority (sema->signaler, old, cur->priority);
+        }
+      wait_queue_push (&sema->waiters, &cur->wait_elem, cur);
       thread_block ();
     }
   sema->value--;
@@ -101,25 +397,63 @@ sema_try_down (struct semaphore *sema)
   return success;
 }
 
-/* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
-
-   This function may be called from an interrupt handler. */
-void
-sema_up (struct semaphore *sema) 
+/* Increments SEMA's value and wakes up one thread of those
+   waiting for SEMA, if any: the first to wait under the stride
+   scheduler, or else the first of the highest priority.  If
+   HAND_OFF, yields the rest of the time slice to that thread,
+   unless called from an interrupt handler or with interrupts
+   off. */
+static void
+sema_wake (struct semaphore *sema, bool hand_off) 
 {
   enum intr_level old_level;
+  struct thread *woken = NULL;
 
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+  if (!wait_queue_empty (&sema->waiters)) 
+    {
+      woken = wait_queue_pop (&sema->waiters)->thread;
+      woken->waiting_sema = NULL;
+
+      /* Take back what it lent while the signaler is sure to be
+         alive. */
+      if (thread_stride)
+        {
+          int tickets = woken->tickets + woken->donated_tickets;
+          sema->donated_tickets -= tickets;
+          donate (sema->signaler, -tickets);
+        }
+      else if (priority_donation ())
+        {
+          int old = sema->donated_priority;
+          sema->donated_priority = top_priority (&sema->waiters);
+          lend_priority (sema->signaler, old, sema->donated_priority);
+        }
+      thread_unblock (woken);
+    }
   sema->value++;
+  if (woken != NULL && hand_off && old_level == INTR_ON
+      && !intr_context ())
+    thread_yield_to (woken);
   intr_set_level (old_level);
 }
 
+/* Up or "V" operation on a semaphore.  Increments SEMA's value
+   and wakes up one thread of those waiting for SEMA, if any,
+   which then runs at once for the rest of the time slice if it
+   is of the same scheduling class and group as the caller: the
+   caller is most likely waking it to do something for it.
+
+   This function may be called from an interrupt handler, in
+   which case the thread woken waits for its turn. */
+void
+sema_up (struct semaphore *sema) 
+{
+  sema_wake (sema, true);
+}
+
 static void sema_test_helper (void *sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -179,6 +513,106 @@ lock_init (struct lock *lock)
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->stats = NULL;
+  lock->ceiling = PRI_NONE;
+}
+
+/* Initializes LOCK like lock_init(), but for the immediate
+   priority-ceiling protocol: a thread that acquires LOCK runs at
+   CEILING, or at its own priority if that is higher, until it
+   releases LOCK.  If CEILING is at least the priority of every
+   thread that takes LOCK, as it can be for a kernel lock whose
+   users are known, none of them can preempt the holder, so
+   waiting for LOCK is rare.  A thread that does wait lends the
+   holder nothing, so acquiring and releasing LOCK take constant
+   time, with no walk down a chain of holders.  Threads may hold
+   such locks and lending ones together.  Under the stride
+   scheduler or "-o mlfqs", which lend no priorities, LOCK is an
+   ordinary lock. */
+void
+lock_init_ceiling (struct lock *lock, int ceiling)
+{
+  ASSERT (ceiling >= PRI_MIN && ceiling <= PRI_MAX);
+
+  lock_init (lock);
+  lock->ceiling = ceiling;
+}
+
+/* Returns true if LOCK raises its holder to its ceiling rather
+   than borrowing from its waiters. */
+static inline bool
+lock_has_ceiling (const struct lock *lock)
+{
+  return lock->ceiling != PRI_NONE && priority_donation ();
+}
+
+/* Contention statistics kept for a lock initialized with
+   lock_init_named().  Updated only by the lock's holder, so the
+   lock itself protects them.  Times are in timer ticks. */
+struct lock_stats
+  {
+    const char *name;           /* Name given to lock_init_named(). */
+    unsigned acquire_cnt;       /* # of acquisitions. */
+    unsigned contended_cnt;     /* # that had to wait. */
+    int64_t wait_ticks;         /* Total time spent waiting. */
+    int64_t max_wait_ticks;     /* Longest wait. */
+    int64_t max_hold_ticks;     /* Longest time held. */
+    char max_holder[16];        /* Name of the thread that held it. */
+    int64_t acquired;           /* When the holder acquired it. */
+  };
+
+/* Statistics for up to LOCK_STATS_MAX named locks.  Those are
+   few and live as long as the kernel, so entries are handed out
+   once and never reclaimed; named locks beyond this many simply
+   go uncounted. */
+#define LOCK_STATS_MAX 64
+static struct lock_stats lock_stats[LOCK_STATS_MAX];
+static unsigned lock_stats_cnt;
+
+/* Most locks lock_print_stats() reports. */
+#define LOCK_STATS_TOP 10
+
+/* Initializes LOCK like lock_init(), and also names it and
+   counts how it is contended, for lock_print_stats() to
+   report.  NAME must remain valid as long as the kernel runs;
+   typically it is a string literal. */
+void
+lock_init_named (struct lock *lock, const char *name)
+{
+  enum intr_level old_level;
+
+  ASSERT (name != NULL);
+
+  lock_init (lock);
+  old_level = intr_disable ();
+  if (lock_stats_cnt < LOCK_STATS_MAX)
+    {
+      lock->stats = &lock_stats[lock_stats_cnt++];
+      memset (lock->stats, 0, sizeof *lock->stats);
+      lock->stats->name = name;
+      stats_add_uint ("lock", name, "acquires", &lock->stats->acquire_cnt);
+      stats_add_uint ("lock", name, "contended",
+                      &lock->stats->contended_cnt);
+      stats_add_int64 ("lock", name, "wait_ticks", &lock->stats->wait_ticks);
+    }
+  intr_set_level (old_level);
+}
+
+/* Makes the current thread LOCK's holder and so the signaler of
+   its semaphore, borrowing the tickets of the threads still
+   waiting for it, or raises it to LOCK's ceiling. */
+static void
+lock_take (struct lock *lock)
+{
+  lock->holder = thread_current ();
+  if (lock_has_ceiling (lock))
+    {
+      enum intr_level old_level = intr_disable ();
+      thread_lend_priority (lock->holder, PRI_NONE, lock->ceiling);
+      intr_set_level (old_level);
+    }
+  else
+    sema_set_signaler (&lock->semaphore, lock->holder);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
@@ -196,8 +630,28 @@ lock_acquire (struct lock *lock)
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
-  sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  if (!sema_try_down (&lock->semaphore))
+    {
+      int64_t start = timer_ticks ();
+      int64_t wait;
+
+      sema_down (&lock->semaphore);
+      wait = timer_elapsed (start);
+      thread_current ()->lock_wait_ticks += wait;
+      if (lock->stats != NULL)
+        {
+          lock->stats->contended_cnt++;
+          lock->stats->wait_ticks += wait;
+          if (wait > lock->stats->max_wait_ticks)
+            lock->stats->max_wait_ticks = wait;
+        }
+    }
+  lock_take (lock);
+  if (lock->stats != NULL)
+    {
+      lock->stats->acquire_cnt++;
+      lock->stats->acquired = timer_ticks ();
+    }
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -216,7 +670,14 @@ lock_try_acquire (struct lock *lock)
 
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock_take (lock);
+      if (lock->stats != NULL)
+        {
+          lock->stats->acquire_cnt++;
+          lock->stats->acquired = timer_ticks ();
+        }
+    }
   return success;
 }
 
@@ -231,8 +692,28 @@ lock_release (struct lock *lock)
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  if (lock->stats != NULL)
+    {
+      int64_t hold = timer_elapsed (lock->stats->acquired);
+      if (hold > lock->stats->max_hold_ticks)
+        {
+          lock->stats->max_hold_ticks = hold;
+          strlcpy (lock->stats->max_holder, lock->holder->name,
+                   sizeof lock->stats->max_holder);
+        }
+    }
+  if (lock_has_ceiling (lock))
+    {
+      enum intr_level old_level = intr_disable ();
+      thread_lend_priority (lock->holder, lock->ceiling, PRI_NONE);
+      intr_set_level (old_level);
+    }
+  else
+    sema_set_signaler (&lock->semaphore, NULL);
   lock->holder = NULL;
   sema_up (&lock->semaphore);
+  if (lock_has_ceiling (lock))
+    thread_yield_if_outranked ();
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -246,10 +727,41 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
+/* Prints the statistics of the LOCK_STATS_TOP named locks that
+   were waited for longest in total, most first.  Locks never
+   contended are left out. */
+void
+lock_print_stats (void)
+{
+  bool printed[LOCK_STATS_MAX];
+  int i;
+
+  memset (printed, 0, sizeof printed);
+  for (i = 0; i < LOCK_STATS_TOP; i++)
+    {
+      struct lock_stats *s = NULL;
+      unsigned j;
+
+      for (j = 0; j < lock_stats_cnt; j++)
+        if (!printed[j] && lock_stats[j].contended_cnt > 0
+            && (s == NULL || lock_stats[j].wait_ticks > s->wait_ticks))
+          s = &lock_stats[j];
+      if (s == NULL)
+        break;
+      printed[s - lock_stats] = true;
+
+      printf ("Lock %s: %u acquires, %u contended, "
+              "%lld wait ticks (max %lld), max hold %lld ticks by %s\n",
+              s->name, s->acquire_cnt, s->contended_cnt,
+              s->wait_ticks, s->max_wait_ticks, s->max_hold_ticks,
+              s->max_holder[0] != '\0' ? s->max_holder : "-");
+    }
+}
+
+/* One semaphore in a condition's wait queue. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct wait_elem elem;              /* Wait queue element. */
     struct semaphore semaphore;         /* This semaphore. */
   };
 
@@ -261,7 +773,21 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  wait_queue_init (&cond->waiters);
+  cond->signaler = NULL;
+}
+
+/* Makes T, or no thread if T is null, the thread expected to
+   signal COND.  Under the stride scheduler, threads that start
+   waiting for COND from now on lend it their tickets, as for
+   sema_set_signaler(), and T must stay alive until they have
+   been signalled. */
+void
+cond_set_signaler (struct condition *cond, struct thread *t) 
+{
+  ASSERT (cond != NULL);
+
+  cond->signaler = t;
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -288,6 +814,8 @@ void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
   struct semaphore_elem waiter;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -295,15 +823,22 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  sema_set_signaler (&waiter.semaphore, cond->signaler);
+  old_level = intr_disable ();
+  wait_queue_push (&cond->waiters, &waiter.elem, cur);
+  cur->cond_elem = &waiter.elem;
+  intr_set_level (old_level);
   lock_release (lock);
   sema_down (&waiter.semaphore);
+  cur->cond_elem = NULL;
   lock_acquire (lock);
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals one of them to wake up from its wait:
+   the first to wait under the stride scheduler, or else the
+   first of the highest priority.  LOCK must be held before
+   calling this function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -316,9 +851,16 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+  /* The waiter needs LOCK, which the caller holds, so running it
+     now would only send it straight back to sleep. */
+  if (!wait_queue_empty (&cond->waiters)) 
+    {
+      enum intr_level old_level = intr_disable ();
+      struct wait_elem *e = wait_queue_pop (&cond->waiters);
+      intr_set_level (old_level);
+      sema_wake (&wait_entry (e, struct semaphore_elem, elem)->semaphore,
+                 false);
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -333,6 +875,147 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!wait_queue_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RW as a readers-writer lock.  Any number of
+   readers can hold RW at the same time, or else a single writer.
+   With RW_PREFER_WRITERS, once a writer is waiting new readers
+   wait behind it, so a steady stream of readers cannot starve
+   writers.  With RW_PREFER_READERS, readers enter whenever no
+   writer holds RW.
+
+   Like a lock, RW cannot be acquired recursively, and it must
+   not be acquired within an interrupt handler. */
+void
+rw_init (struct rwlock *rw, enum rw_preference preference)
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->lock);
+  cond_init (&rw->readers_ok);
+  cond_init (&rw->writer_ok);
+  rw->readers = 0;
+  rw->waiting_readers = 0;
+  rw->waiting_writers = 0;
+  rw->writer = false;
+  rw->preference = preference;
+}
+
+/* Returns true if a new reader may enter RW now.  RW's lock must
+   be held. */
+static bool
+rw_read_may_enter (const struct rwlock *rw)
+{
+  return (!rw->writer
+          && (rw->preference == RW_PREFER_READERS
+              || rw->waiting_writers == 0));
+}
+
+/* Wakes whoever should enter RW next.  RW's lock must be
+   held. */
+static void
+rw_wake (struct rwlock *rw)
+{
+  if (rw->writer)
+    return;
+  if (rw->waiting_readers > 0
+      && (rw->preference == RW_PREFER_READERS || rw->waiting_writers == 0))
+    cond_broadcast (&rw->readers_ok, &rw->lock);
+  else if (rw->readers == 0 && rw->waiting_writers > 0)
+    cond_signal (&rw->writer_ok, &rw->lock);
+}
+
+/* Acquires RW for reading, sleeping until readers may enter. */
+void
+rw_read_acquire (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  rw->waiting_readers++;
+  while (!rw_read_may_enter (rw))
+    cond_wait (&rw->readers_ok, &rw->lock);
+  rw->waiting_readers--;
+  rw->readers++;
+  lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until it has no readers and
+   no other writer. */
+void
+rw_write_acquire (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+
+  lock_acquire (&rw->lock);
+  rw->waiting_writers++;
+  while (rw->writer || rw->readers > 0)
+    cond_wait (&rw->writer_ok, &rw->lock);
+  rw->waiting_writers--;
+  rw->writer = true;
+  lock_release (&rw->lock);
+}
+
+/* Tries to acquire RW for reading without sleeping.  Returns
+   true if successful, false on failure. */
+bool
+rw_try_read_acquire (struct rwlock *rw)
+{
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  success = rw_read_may_enter (rw);
+  if (success)
+    rw->readers++;
+  lock_release (&rw->lock);
+  return success;
+}
+
+/* Tries to acquire RW for writing without sleeping.  Returns
+   true if successful, false on failure. */
+bool
+rw_try_write_acquire (struct rwlock *rw)
+{
+  bool success;
+
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  success = !rw->writer && rw->readers == 0;
+  if (success)
+    rw->writer = true;
+  lock_release (&rw->lock);
+  return success;
+}
+
+/* Releases RW, which the current thread holds for reading. */
+void
+rw_read_release (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->readers > 0);
+  rw->readers--;
+  rw_wake (rw);
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread holds for writing. */
+void
+rw_write_release (struct rwlock *rw)
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->writer);
+  rw->writer = false;
+  rw_wake (rw);
+  lock_release (&rw->lock);
+}
@@ -3,44 +3,126 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct thread;
+
+/* Queue of threads waiting on a semaphore or condition variable,
+   highest priority first and first-come first-served among
+   threads of equal priority, or first-come first-served alone
+   under the stride scheduler.
+
+   It is a pairing heap, so pushing is O(1) and popping is
+   O(log n) amortized.  Each element stores the priority it was
+   queued with; wait_queue_priority_changed() moves a thread
+   whose priority changed while it waits. */
+struct wait_elem 
+  {
+    struct thread *thread;      /* Waiting thread. */
+    struct wait_queue *queue;   /* Queue holding this element, if any. */
+    int priority;               /* Priority it was queued with. */
+    unsigned seq;               /* Arrival order, for ties. */
+    struct wait_elem *child;    /* Leftmost child. */
+    struct wait_elem *next;     /* Right sibling. */
+    struct wait_elem *prev;     /* Left sibling, or parent if leftmost. */
+  };
+
+struct wait_queue 
+  {
+    struct wait_elem *root;     /* Highest priority waiter. */
+  };
+
+/* Converts pointer to wait element WAIT_ELEM into a pointer to
+   the structure that WAIT_ELEM is embedded inside, like
+   list_entry(). */
+#define wait_entry(WAIT_ELEM, STRUCT, MEMBER)           \
+        ((STRUCT *) ((uint8_t *) (WAIT_ELEM)            \
+                     - offsetof (STRUCT, MEMBER)))
+
+void wait_queue_init (struct wait_queue *);
+bool wait_queue_empty (const struct wait_queue *);
+void wait_queue_push (struct wait_queue *, struct wait_elem *,
+                      struct thread *);
+struct wait_elem *wait_queue_pop (struct wait_queue *);
+void wait_queue_priority_changed (struct thread *);
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct wait_queue waiters;  /* Waiting threads. */
+    struct thread *signaler;    /* Expected to up it, or NULL. */
+    int donated_tickets;        /* Lent to the signaler by waiters. */
+    int donated_priority;       /* Lent to the signaler, or PRI_NONE. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
+void sema_set_signaler (struct semaphore *, struct thread *);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
 void sema_self_test (void);
 
-/* Lock. */
+/* Lock.  Members are in the order that an uncontended
+   lock_acquire() uses them. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct thread *holder;      /* Thread holding lock (for debugging). */
+    int ceiling;                /* Holder's priority, or PRI_NONE. */
+    struct lock_stats *stats;   /* Contention statistics, or NULL. */
   };
 
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
+void lock_init_ceiling (struct lock *, int ceiling);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_print_stats (void);
 
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct wait_queue waiters;  /* Waiting threads. */
+    struct thread *signaler;    /* Expected to signal it, or NULL. */
   };
 
 void cond_init (struct condition *);
+void cond_set_signaler (struct condition *, struct thread *);
 void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Readers-writer lock. */
+enum rw_preference
+  {
+    RW_PREFER_READERS,          /* Readers may pass waiting writers. */
+    RW_PREFER_WRITERS           /* Waiting writers keep new readers out. */
+  };
+
+struct rwlock 
+  {
+    struct lock lock;               /* Protects the members below. */
+    struct condition readers_ok;    /* Signaled when readers may enter. */
+    struct condition writer_ok;     /* Signaled when a writer may enter. */
+    int readers;                    /* Number of readers holding it. */
+    int waiting_readers;            /* Number of readers waiting for it. */
+    int waiting_writers;            /* Number of writers waiting for it. */
+    bool writer;                    /* True while a writer holds it. */
+    enum rw_preference preference;  /* Who goes first. */
+  };
+
+void rw_init (struct rwlock *, enum rw_preference);
+void rw_read_acquire (struct rwlock *);
+void rw_write_acquire (struct rwlock *);
+bool rw_try_read_acquire (struct rwlock *);
+bool rw_try_write_acquire (struct rwlock *);
+void rw_read_release (struct rwlock *);
+void rw_write_release (struct rwlock *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -48,4 +130,55 @@ void cond_broadcast (struct condition *, struct lock *);
    reference guide for more information.*/
 #define barrier() asm volatile ("" : : : "memory")
 
+/* Sequence counter, for data that is read often by code that
+   should not turn interrupts off, such as a system call polling
+   thread state, and written by code that has them off.
+
+   A writer brackets each change with seqcount_write_begin() and
+   seqcount_write_end(), which leave the count odd in between.  A
+   reader copies the data after seqcount_read_begin(), then calls
+   seqcount_read_retry() and starts over if that returns true,
+   because a writer got in while it was copying.  Readers never
+   block a writer, but one may have to retry. */
+struct seqcount 
+  {
+    unsigned seq;               /* Even unless a write is under way. */
+  };
+
+static inline void
+seqcount_write_begin (struct seqcount *sc) 
+{
+  sc->seq++;
+  barrier ();
+}
+
+static inline void
+seqcount_write_end (struct seqcount *sc) 
+{
+  barrier ();
+  sc->seq++;
+}
+
+/* Returns the count to pass to seqcount_read_retry(), waiting
+   out any write under way. */
+static inline unsigned
+seqcount_read_begin (const struct seqcount *sc) 
+{
+  unsigned seq;
+
+  while ((seq = *(volatile const unsigned *) &sc->seq) & 1)
+    continue;
+  barrier ();
+  return seq;
+}
+
+/* Returns true if a writer changed the data since the
+   seqcount_read_begin() that returned SEQ. */
+static inline bool
+seqcount_read_retry (const struct seqcount *sc, unsigned seq) 
+{
+  barrier ();
+  return *(volatile const unsigned *) &sc->seq != seq;
+}
+
 #endif /* threads/synch.h */
@@ -1,18 +1,28 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
+#include <rusage.h>
+#include <stats.h>
+#include <threadinfo.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/kstack.h"
 #include "threads/palloc.h"
+#include "threads/percpu.h"
+#include "threads/rcu.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/thread.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
+#include "userprog/upcall.h"
 #endif
 
 /* Random value for struct thread's `magic' member.
@@ -20,9 +30,42 @@
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Threads in THREAD_READY state, that is, threads that are ready
+   to run but not actually running, other than those of the
+   earliest-deadline-first class, are kept by scheduling group.
+   Without "-group" every thread is in kernel_group; with it, so
+   are the kernel threads outside any process. */
+static struct sched_group kernel_group;
+
+/* Groups that have ready threads, lowest pass first.  Each tick a
+   thread runs adds STRIDE_ONE divided by its group's weight to
+   the group's pass, so that, over time, each group gets a share
+   of the CPU in proportion to its weight. */
+static struct rb_tree group_tree;
+
+/* Threads of the earliest-deadline-first class that are ready to
+   run, earliest deadline first.  They run before any thread in
+   a scheduling group. */
+static struct list edf_ready_list;
+
+/* Threads of that class that have used up their budget for this
+   period, to be put back on edf_ready_list at their deadline. */
+static struct list edf_throttled_list;
+
+/* Sum of budget / period over the threads of the class, in units
+   of 1 / EDF_UTIL_ONE of the CPU.  Admission control keeps it at
+   or below EDF_UTIL_MAX, so that every deadline can be met and the
+   other threads still get some time. */
+#define EDF_UTIL_ONE 10000
+#define EDF_UTIL_MAX 9000
+static int edf_util;
+
+/* With the stride scheduler, each tick a thread runs also adds
+   STRIDE_ONE divided by its tickets, own and donated, to its own
+   pass, and the thread with the lowest pass in its group runs
+   next, so that each gets a share of the group's time in
+   proportion to its tickets. */
+#define STRIDE_ONE (1 << 20)
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
@@ -31,12 +74,29 @@ static struct list all_list;
 /* Idle thread. */
 static struct thread *idle_thread;
 
+/* Thread that thread_yield_to() is handing the rest of the time
+   slice to, or NULL. */
+static struct thread *handoff;
+
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* State of a thread published for thread_get_info(), which reads
+   it with interrupts on.  Only code with interrupts off changes
+   it, inside a write of SEQ.  A slot with a tid of 0 is free. */
+struct info_slot
+  {
+    struct seqcount seq;
+    struct threadinfo info;
+  };
+
+/* Published thread state, the first THREADINFO_MAX threads to
+   need a slot getting one. */
+static struct info_slot info_slots[THREADINFO_MAX];
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame
 {
@@ -46,19 +106,60 @@ struct kernel_thread_frame
 };
 
 /* Statistics. */
-static long long idle_ticks;   /* # of timer ticks spent idle. */
-static long long kernel_ticks; /* # of timer ticks in kernel threads. */
-static long long user_ticks;   /* # of timer ticks in user programs. */
+static struct percpu_counter idle_ticks;   /* # of ticks spent idle. */
+static struct percpu_counter kernel_ticks; /* # of ticks in kernel threads. */
+static struct percpu_counter user_ticks;   /* # of ticks in user programs. */
+static struct percpu_counter resched_cnt;  /* # of cond_resched() yields. */
 
 /* Scheduling. */
 #define TIME_SLICE 4          /* # of timer ticks to give each thread. */
 static unsigned thread_ticks; /* # of timer ticks since last yield. */
 
+/* Time slices, in timer ticks, of threads of priority PRI_MAX and
+   PRI_MIN.  Those in between get slices in proportion.  Giving
+   low-priority batch threads long slices saves context switches;
+   giving high-priority ones short slices keeps them from holding
+   up the rest for long.
+   Controlled by kernel command-line option "-slice=SHORT,LONG". */
+unsigned thread_slice_short = TIME_SLICE;
+unsigned thread_slice_long = TIME_SLICE;
+
+#if SCHED_POLICY == SCHED_ANY
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* If true, use the stride scheduler.
+   Controlled by kernel command-line option "-stride". */
+bool thread_stride;
+#endif
+
+/* If true, share the CPU between scheduling groups first.
+   Controlled by kernel command-line option "-group". */
+bool thread_group_share;
+
+/* If true, a thread that spends most of its time asleep, such as
+   a shell waiting for keystrokes, goes to the front of the run
+   queue when it wakes, and takes the CPU at once if an interrupt
+   woke it.  Its sleep_avg gains the ticks it sleeps, up to
+   SLEEP_AVG_MAX, and loses one for each tick it runs, so the
+   boost lasts only while it keeps sleeping more than it runs.
+   Controlled by kernel command-line option "-boost". */
+bool thread_boost;
+
+/* Pages of kernel stack thread_create() gives a thread.  One, the
+   default, shares its page with the struct thread; more are
+   guarded.  Controlled by kernel command-line option
+   "-kstack=PAGES". */
+size_t thread_stack_pages = 1;
+#define SLEEP_AVG_MAX 100
+#define SLEEP_AVG_INTERACTIVE (SLEEP_AVG_MAX / 2)
+
+/* System load average, used with "-o mlfqs": an estimate of the
+   number of threads ready to run over the past minute. */
+static struct real load_avg;
+
 static void kernel_thread(thread_func *, void *aux);
 
 static void idle(void *aux UNUSED);
@@ -70,6 +171,28 @@ static void *alloc_frame(struct thread *, size_t size);
 static void schedule(void);
 void thread_schedule_tail(struct thread *prev);
 static tid_t allocate_tid(void);
+static void edf_make_ready(struct thread *);
+static void edf_tick(struct thread *);
+static bool stride_less(const struct rb_node *, const struct rb_node *,
+                        void *aux);
+static uint64_t stride_floor(struct sched_group *);
+static bool group_less(const struct rb_node *, const struct rb_node *,
+                       void *aux);
+static struct sched_group *thread_group(struct thread *);
+static void make_ready(struct thread *, bool woke);
+static bool wake(struct thread *);
+static void group_charge(struct sched_group *);
+static void remove_ready(struct thread *);
+static unsigned slice_for(int priority);
+static bool interactive(const struct thread *);
+static int highest_bit(uint64_t);
+static void set_priority(struct thread *, int priority);
+static bool outranked(struct thread *);
+static void mlfqs_tick(struct thread *);
+static void mlfqs_update_priority(struct thread *);
+static void info_attach(struct thread *);
+static void info_publish(struct thread *);
+static void info_detach(struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -87,16 +210,25 @@ static tid_t allocate_tid(void);
 void thread_init(void)
 {
   ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(sizeof(struct thread) - offsetof(struct thread, elem) == CACHE_LINE);
 
-  lock_init(&tid_lock);
-  list_init(&ready_list);
+  lock_init_named(&tid_lock, "tid");
+  rb_init(&group_tree, group_less, NULL);
+  sched_group_init(&kernel_group, TICKETS_DEFAULT);
+  list_init(&edf_ready_list);
+  list_init(&edf_throttled_list);
   list_init(&all_list);
+  stats_add_percpu("thread", NULL, "idle_ticks", &idle_ticks);
+  stats_add_percpu("thread", NULL, "kernel_ticks", &kernel_ticks);
+  stats_add_percpu("thread", NULL, "user_ticks", &user_ticks);
+  stats_add_percpu("thread", NULL, "cond_resched", &resched_cnt);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread();
   init_thread(initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
   initial_thread->tid = allocate_tid();
+  info_attach(initial_thread);
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -115,24 +247,46 @@ void thread_start(void)
   sema_down(&idle_started);
 }
 
-/* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
-void thread_tick(void)
+/* Called by the timer interrupt handler at each timer tick,
+   with USER true if the tick interrupted user mode.  Thus, this
+   function runs in an external interrupt context. */
+void thread_tick(bool user)
 {
   struct thread *t = thread_current();
 
   /* Update statistics. */
   if (t == idle_thread)
-    idle_ticks++;
+    percpu_inc(&idle_ticks);
+  else if (user)
+    percpu_inc(&user_ticks);
+  else
+    percpu_inc(&kernel_ticks);
+  if (user)
+    t->user_ticks++;
+  else
+    t->kernel_ticks++;
+  info_publish(t);
 #ifdef USERPROG
-  else if (t->pagedir != NULL)
-    user_ticks++;
+  // Checked against RLIMIT_CPU on the way back to user mode
+  if (t->process != NULL)
+    t->process->cpu_ticks++;
 #endif
-  else
-    kernel_ticks++;
+
+  edf_tick(t);
+  if (t != idle_thread && t->sleep_avg > 0)
+    t->sleep_avg--;
+  if (t != idle_thread && t->edf_period == 0)
+  {
+    if (thread_stride)
+      t->pass += STRIDE_ONE / (t->tickets + t->donated_tickets);
+    if (thread_group_share)
+      group_charge(thread_group(t));
+  }
+  if (thread_mlfqs)
+    mlfqs_tick(t);
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++thread_ticks >= t->time_slice || outranked(t))
     intr_yield_on_return();
 }
 
@@ -140,7 +294,8 @@ void thread_tick(void)
 void thread_print_stats(void)
 {
   printf("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-         idle_ticks, kernel_ticks, user_ticks);
+         percpu_sum(&idle_ticks), percpu_sum(&kernel_ticks),
+         percpu_sum(&user_ticks));
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -155,28 +310,46 @@ void thread_print_stats(void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   The new thread runs at PRIORITY, and at once if that is higher
+   than the current thread's, except under "-o mlfqs", where it
+   inherits the current thread's nice and recent_cpu instead. */
 tid_t thread_create(const char *name, int priority,
                     thread_func *function, void *aux)
+{
+  return thread_create_stack(name, priority, thread_stack_pages, function,
+                             aux);
+}
+
+/* Does what thread_create() does, but gives the new thread
+   STACK_PAGES pages of kernel stack.  One page holds both the
+   struct thread and its stack, as usual.  More come from the
+   guarded stack region, with an unmapped page below them, for
+   threads whose work runs deep, such as the file system's; at
+   most KSTACK_PAGES_MAX may be asked for. */
+tid_t thread_create_stack(const char *name, int priority, size_t stack_pages,
+                          thread_func *function, void *aux)
 {
   struct thread *t;
   struct kernel_thread_frame *kf;
   struct switch_entry_frame *ef;
   struct switch_threads_frame *sf;
+  enum intr_level old_level;
   tid_t tid;
 
   ASSERT(function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page(PAL_ZERO);
+  t = stack_pages > 1 ? kstack_alloc(stack_pages) : palloc_get_page(PAL_ZERO);
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread(t, name, priority);
   tid = t->tid = allocate_tid();
+  t->affinity = thread_current()->affinity;
+  old_level = intr_disable();
+  info_attach(t);
+  intr_set_level(old_level);
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame(t, sizeof *kf);
@@ -195,6 +368,10 @@ tid_t thread_create(const char *name, int priority,
 
   /* Add to run queue. */
   thread_unblock(t);
+  old_level = intr_disable();
+  if (outranked(thread_current()))
+    thread_yield();
+  intr_set_level(old_level);
 
   return tid;
 }
@@ -210,6 +387,11 @@ void thread_block(void)
   ASSERT(!intr_context());
   ASSERT(intr_get_level() == INTR_OFF);
 
+  if (thread_boost)
+    thread_current()->blocked_at = timer_ticks();
+#ifdef USERPROG
+  upcall_block(thread_current());
+#endif
   thread_current()->status = THREAD_BLOCKED;
   schedule();
 }
@@ -218,8 +400,9 @@ void thread_block(void)
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
 
-   This function does not preempt the running thread.  This can
-   be important: if the caller had disabled interrupts itself,
+   This function does not preempt the running thread, except
+   from an interrupt handler, on the way out of the handler.  This
+   can be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
    update other data. */
 void thread_unblock(struct thread *t)
@@ -229,10 +412,83 @@ void thread_unblock(struct thread *t)
   ASSERT(is_thread(t));
 
   old_level = intr_disable();
+  if (wake(t))
+    intr_yield_on_return();
+  intr_set_level(old_level);
+}
+
+/* Unblocks every thread in THREADS, a list of blocked threads
+   linked through their elem members, leaving it empty.  Meant
+   for waking many threads at once, as when several timed waits
+   end on the same tick: the run queues are updated in one pass
+   with interrupts off, and the running thread is preempted at
+   most once.  Otherwise like thread_unblock(). */
+void thread_unblock_all(struct list *threads)
+{
+  enum intr_level old_level;
+  bool preempt = false;
+
+  old_level = intr_disable();
+  while (!list_empty(threads))
+  {
+    struct thread *t = list_entry(list_pop_front(threads),
+                                  struct thread, elem);
+    DEBUG_ASSERT(is_thread(t));
+    if (wake(t))
+      preempt = true;
+  }
+  if (preempt)
+    intr_yield_on_return();
+  intr_set_level(old_level);
+}
+
+/* Makes blocked thread T ready to run.  Returns true if T was
+   woken by an interrupt and should not wait for the running
+   thread's time slice to end.  Interrupts must be off. */
+static bool wake(struct thread *t)
+{
+  struct thread *cur = running_thread();
+  bool preempt;
+
+  ASSERT(intr_get_level() == INTR_OFF);
   ASSERT(t->status == THREAD_BLOCKED);
-  list_push_back(&ready_list, &t->elem);
+
   t->status = THREAD_READY;
-  intr_set_level(old_level);
+  info_publish(t);
+  if (t->edf_period > 0)
+  {
+    // One that slept past its deadline starts a new period
+    int64_t now = timer_ticks();
+    if (now >= t->edf_deadline)
+    {
+      t->edf_deadline = now + t->edf_period;
+      t->edf_left = t->edf_budget;
+      t->edf_throttled = false;
+    }
+    edf_make_ready(t);
+
+    // Woken by an interrupt, it need not wait for the next tick
+    preempt = !t->edf_throttled &&
+              (cur->edf_period == 0 || t->edf_deadline < cur->edf_deadline);
+  }
+  else
+  {
+    if (thread_boost)
+    {
+      int64_t slept = timer_ticks() - t->blocked_at;
+      t->sleep_avg = slept < SLEEP_AVG_MAX - t->sleep_avg
+                       ? t->sleep_avg + slept : SLEEP_AVG_MAX;
+    }
+    make_ready(t, true);
+
+    // Woken by an interrupt, it need not wait out the time slice
+    preempt = cur->edf_period == 0 && thread_group(cur) == thread_group(t) &&
+              ((interactive(t) && !interactive(cur)) ||
+               (!thread_stride && t->priority > cur->priority));
+  }
+
+  // The idle thread, halted or zeroing pages, gives way at once
+  return intr_context() && (preempt || cur == idle_thread);
 }
 
 /* Returns the name of the running thread. */
@@ -253,10 +509,12 @@ thread_current(void)
   /* Make sure T is really a thread.
      If either of these assertions fire, then your thread may
      have overflowed its stack.  Each thread has less than 4 kB
-     of stack, so a few big automatic arrays or moderate
-     recursion can cause stack overflow. */
-  ASSERT(is_thread(t));
-  ASSERT(t->status == THREAD_RUNNING);
+     of stack, unless it has a guarded one, so a few big automatic
+     arrays or moderate recursion can cause stack overflow.
+     Guarded stacks catch that anyway, so these are checked only
+     outside release builds. */
+  DEBUG_ASSERT(is_thread(t));
+  DEBUG_ASSERT(t->status == THREAD_RUNNING);
 
   return t;
 }
@@ -276,12 +534,17 @@ void thread_exit(void)
 #ifdef USERPROG
   process_exit();
 #endif
+  fpu_exit();
 
-  /* Remove thread from all threads list, set our status to dying,
-     and schedule another process.  That process will destroy us
-     when it calls thread_schedule_tail(). */
+  /* Remove thread from all threads list and free its published
+     state, set our status to dying, and schedule another process.
+     That process will destroy us when it calls
+     thread_schedule_tail(). */
   intr_disable();
   list_remove(&thread_current()->allelem);
+  info_detach(thread_current());
+  if (thread_current()->edf_period > 0)
+    thread_set_deadline(0, 0);
   thread_current()->status = THREAD_DYING;
   schedule();
   NOT_REACHED();
@@ -297,13 +560,46 @@ void thread_yield(void)
   ASSERT(!intr_context());
 
   old_level = intr_disable();
-  if (cur != idle_thread)
-    list_push_back(&ready_list, &cur->elem);
+  if (cur->edf_period > 0)
+    edf_make_ready(cur);
+  else if (cur != idle_thread)
+    make_ready(cur, false);
   cur->status = THREAD_READY;
   schedule();
   intr_set_level(old_level);
 }
 
+/* Yields the CPU to T, which is ready to run, giving it the rest
+   of the current time slice, so that a thread waking another it
+   expects to answer does not wait for the scheduler to get round
+   to it.  Does nothing unless T and the current thread are both
+   ordinary threads in the same scheduling group and, outside the
+   stride scheduler, T's priority is no lower.  The current
+   thread goes back in the run queue as by thread_yield(). */
+void thread_yield_to(struct thread *t)
+{
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
+
+  ASSERT(!intr_context());
+  ASSERT(is_thread(t));
+
+  old_level = intr_disable();
+  if (t->status == THREAD_READY && t != idle_thread &&
+      cur != idle_thread && idle_thread != NULL &&
+      t->edf_period == 0 && cur->edf_period == 0 &&
+      thread_group(t) == thread_group(cur) &&
+      (thread_stride || t->priority >= cur->priority))
+  {
+    remove_ready(t);
+    make_ready(cur, false);
+    cur->status = THREAD_READY;
+    handoff = t;
+    schedule();
+  }
+  intr_set_level(old_level);
+}
+
 /* Invoke function 'func' on all threads, passing along 'aux'.
    This function must be called with interrupts off. */
 void thread_foreach(thread_action_func *func, void *aux)
@@ -320,10 +616,302 @@ void thread_foreach(thread_action_func *func, void *aux)
   }
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Fills in *R with the resource usage of T. */
+void thread_get_rusage(const struct thread *t, struct rusage *r)
+{
+  r->tid = t->tid;
+  strlcpy(r->name, t->name, sizeof r->name);
+  r->user_ticks = t->user_ticks;
+  r->kernel_ticks = t->kernel_ticks;
+  r->voluntary_switches = t->voluntary_switches;
+  r->involuntary_switches = t->involuntary_switches;
+  r->lock_wait_ticks = t->lock_wait_ticks;
+  r->page_faults = t->page_faults;
+  memcpy(r->faults, t->faults, sizeof r->faults);
+}
+
+/* Copies the state of up to CNT threads into INFO and returns
+   how many threads there are, which may be more than CNT.  Unlike
+   thread_foreach(), leaves interrupts on: each thread's state is
+   copied again if it changed while being copied, so every entry
+   is as it was at some moment, though not all at the same one.
+
+   State is published at every change of status or priority and
+   every timer tick, so ticks lag by less than one.  A thread that
+   was one of more than THREADINFO_MAX at once may not have any. */
+int thread_get_info(struct threadinfo *info, int cnt)
+{
+  int n = 0;
+
+  for (size_t i = 0; i < THREADINFO_MAX; i++)
+  {
+    struct info_slot *slot = &info_slots[i];
+    struct threadinfo copy;
+    unsigned seq;
+
+    do
+    {
+      seq = seqcount_read_begin(&slot->seq);
+      copy = slot->info;
+    } while (seqcount_read_retry(&slot->seq, seq));
+
+    if (copy.tid == 0)
+      continue;
+    if (n < cnt)
+      info[n] = copy;
+    n++;
+  }
+  return n;
+}
+
+/* Gives T, which has its tid, a slot for its published state if
+   one is free.  Interrupts must be off. */
+static void info_attach(struct thread *t)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  for (size_t i = 0; i < THREADINFO_MAX; i++)
+    if (info_slots[i].info.tid == 0)
+    {
+      t->info = &info_slots[i];
+      info_publish(t);
+      return;
+    }
+}
+
+/* Publishes T's state in its slot, if it has one.  Interrupts
+   must be off. */
+static void info_publish(struct thread *t)
+{
+  struct info_slot *slot = t->info;
+
+  if (slot == NULL)
+    return;
+  seqcount_write_begin(&slot->seq);
+  slot->info.tid = t->tid;
+  memcpy(slot->info.name, t->name, sizeof slot->info.name);
+  slot->info.status = t->status; // THREADINFO_* match enum thread_status
+  slot->info.priority = t->priority;
+  slot->info.user_ticks = t->user_ticks;
+  slot->info.kernel_ticks = t->kernel_ticks;
+  slot->info.cpu = t->last_cpu;
+  slot->info.last_ran = t->last_ran;
+  seqcount_write_end(&slot->seq);
+}
+
+/* Frees T's slot, if it has one.  Interrupts must be off. */
+static void info_detach(struct thread *t)
+{
+  struct info_slot *slot = t->info;
+
+  if (slot == NULL)
+    return;
+  seqcount_write_begin(&slot->seq);
+  memset(&slot->info, 0, sizeof slot->info);
+  seqcount_write_end(&slot->seq);
+  t->info = NULL;
+}
+
+/* Sets the current thread's priority to NEW_PRIORITY, or to
+   the highest lent to it if that is higher, and yields if that
+   leaves it outranked.  Does nothing under "-o mlfqs", which
+   sets priorities itself. */
 void thread_set_priority(int new_priority)
 {
-  thread_current()->priority = new_priority;
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
+  int lent;
+
+  ASSERT(PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable();
+  cur->base_priority = new_priority;
+  lent = highest_bit(cur->donation_bitmap);
+  set_priority(cur, new_priority > lent ? new_priority : lent);
+  if (outranked(cur))
+    thread_yield();
+  intr_set_level(old_level);
+}
+
+/* Changes one of the priorities lent to T, that of a semaphore
+   it is the signaler of (see synch.c), from OLD to NEW, either
+   of which may be PRI_NONE, and sets T's priority to the higher
+   of its own and the highest lent to it.  Returns true if that
+   changed T's priority.  Interrupts must be off. */
+bool thread_lend_priority(struct thread *t, int old, int new)
+{
+  int before = t->priority;
+  int lent;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+  ASSERT(is_thread(t));
+
+  if (old != PRI_NONE)
+  {
+    ASSERT(t->donation_cnt[old] > 0);
+    if (--t->donation_cnt[old] == 0)
+      t->donation_bitmap &= ~((uint64_t)1 << old);
+  }
+  if (new != PRI_NONE)
+  {
+    t->donation_cnt[new]++;
+    t->donation_bitmap |= (uint64_t)1 << new;
+  }
+
+  lent = highest_bit(t->donation_bitmap);
+  set_priority(t, t->base_priority > lent ? t->base_priority : lent);
+  return t->priority != before;
+}
+
+/* Yields if a ready thread outranks the running one, as it may
+   once a priority lent to it is taken back. */
+void thread_yield_if_outranked(void)
+{
+  enum intr_level old_level = intr_disable();
+
+  if (outranked(thread_current()))
+    thread_yield();
+  intr_set_level(old_level);
+}
+
+/* Keeps the running thread from being switched away from by an
+   interrupt until the matching preempt_enable().  Calls nest.
+   Unlike turning interrupts off, this lets interrupts be handled
+   meanwhile: a switch one of them would make is put off instead.
+   The thread may not sleep or yield until preemption is back on. */
+void preempt_disable(void)
+{
+  thread_current()->preempt_count++;
+  barrier();
+}
+
+/* Undoes preempt_disable(), yielding now if the thread would have
+   been preempted since the outermost call. */
+void preempt_enable(void)
+{
+  struct thread *cur = thread_current();
+
+  ASSERT(cur->preempt_count > 0);
+
+  barrier();
+  if (--cur->preempt_count == 0 && cur->preempt_pending && !intr_context())
+  {
+    cur->preempt_pending = false;
+    thread_yield();
+  }
+}
+
+/* Called by intr_handler() when an interrupt is about to preempt
+   the running thread.  Returns true, and puts the preemption off
+   until preempt_enable(), if preemption is off. */
+bool preempt_defer(void)
+{
+  struct thread *cur = thread_current();
+
+  if (cur->preempt_count == 0)
+    return false;
+  cur->preempt_pending = true;
+  return true;
+}
+
+/* A preemption point, for a loop in thread context that may run
+   for a long time.  Yields if the running thread is due to be
+   preempted but nothing has switched it out yet: a thread that
+   outranks it was made ready without an interrupt, its time slice
+   ran out with preemption off, or a preemption was put off.  Does
+   nothing with interrupts or preemption off, where it may not
+   yield. */
+void cond_resched(void)
+{
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
+
+  if (intr_context() || intr_get_level() == INTR_OFF ||
+      cur->preempt_count > 0)
+    return;
+
+  old_level = intr_disable();
+  if (cur->preempt_pending || thread_ticks >= cur->time_slice ||
+      outranked(cur))
+  {
+    cur->preempt_pending = false;
+    percpu_inc(&resched_cnt);
+    thread_yield();
+  }
+  intr_set_level(old_level);
+}
+
+/* Returns the index of the highest bit set in BITS, or PRI_NONE
+   if there is none. */
+static int highest_bit(uint64_t bits)
+{
+  uint32_t high = bits >> 32;
+  uint32_t low = bits;
+
+  if (high != 0)
+    return 63 - __builtin_clz(high);
+  if (low != 0)
+    return 31 - __builtin_clz(low);
+  return PRI_NONE;
+}
+
+/* Sets T's priority, and so its time slice, to PRIORITY, moving
+   it to the matching run queue if it is ready to run.
+   Interrupts must be off. */
+static void set_priority(struct thread *t, int priority)
+{
+  bool queued = t->status == THREAD_READY && t->edf_period == 0 &&
+                !thread_stride && t != idle_thread;
+  struct sched_group *g = thread_group(t);
+
+  if (t->priority == priority)
+    return;
+  if (queued)
+  {
+    list_remove(&t->elem);
+    if (list_empty(&g->ready[t->priority]))
+      g->ready_bitmap &= ~((uint64_t)1 << t->priority);
+  }
+  t->priority = priority;
+  t->time_slice = slice_for(priority);
+  if (queued)
+  {
+    list_push_back(&g->ready[priority], &t->elem);
+    g->ready_bitmap |= (uint64_t)1 << priority;
+  }
+  else if (t->status == THREAD_BLOCKED)
+    wait_queue_priority_changed(t);
+  info_publish(t);
+}
+
+/* Returns true if a thread ready to run in T's scheduling group
+   has a higher priority than T, which is running.  Always false
+   under the stride scheduler and for the earliest-deadline-first
+   class.  Interrupts must be off. */
+static bool outranked(struct thread *t)
+{
+  if (thread_stride || t->edf_period > 0 || t == idle_thread)
+    return false;
+  return highest_bit(thread_group(t)->ready_bitmap) > t->priority;
+}
+
+/* Returns true if T is due the boost that "-boost" gives threads
+   that mostly sleep. */
+static bool interactive(const struct thread *t)
+{
+  return thread_boost && t->sleep_avg >= SLEEP_AVG_INTERACTIVE;
+}
+
+/* Returns the time slice of a thread of PRIORITY. */
+static unsigned slice_for(int priority)
+{
+  int span = (int)thread_slice_long - (int)thread_slice_short;
+  int slice = (int)thread_slice_long
+              - span * (priority - PRI_MIN) / (PRI_MAX - PRI_MIN);
+  return slice > 0 ? slice : 1;
 }
 
 /* Returns the current thread's priority. */
@@ -332,31 +920,446 @@ int thread_get_priority(void)
   return thread_current()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
-void thread_set_nice(int nice UNUSED)
+/* Moves the current thread into the earliest-deadline-first class,
+   in which it runs ahead of every other thread, with the earliest
+   deadline first, for up to BUDGET ticks in every PERIOD ticks.
+   Its first period starts now and ends at its first deadline.  A
+   thread that uses up its budget waits for the next period, and
+   one that sleeps past its deadline starts a new period when it
+   wakes; a periodic task should sleep until its next release.
+   With PERIOD 0 it goes back to the ordinary class.
+   Returns false, changing nothing, if BUDGET is not between 1 and
+   PERIOD or admitting the thread would take the class's share of
+   the CPU above EDF_UTIL_MAX / EDF_UTIL_ONE. */
+bool thread_set_deadline(int64_t period, int64_t budget)
+{
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
+  int util = 0, old_util = 0;
+  bool ok = true;
+
+  if (period != 0 && (budget < 1 || budget > period))
+    return false;
+  if (period != 0)
+    util = DIV_ROUND_UP(budget * EDF_UTIL_ONE, period);
+
+  old_level = intr_disable();
+  if (cur->edf_period > 0)
+    old_util = DIV_ROUND_UP(cur->edf_budget * EDF_UTIL_ONE, cur->edf_period);
+  if (edf_util - old_util + util > EDF_UTIL_MAX)
+    ok = false;
+  else
+  {
+    edf_util += util - old_util;
+    cur->edf_period = period;
+    cur->edf_budget = budget;
+    cur->edf_deadline = timer_ticks() + period;
+    cur->edf_left = budget;
+    cur->edf_throttled = false;
+  }
+  intr_set_level(old_level);
+  return ok;
+}
+
+/* Puts T, of the earliest-deadline-first class, on the ready list
+   of that class in order of deadline, or aside until its next
+   period if it has no budget left.  Interrupts must be off. */
+static void edf_make_ready(struct thread *t)
+{
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (t->edf_throttled)
+    list_push_back(&edf_throttled_list, &t->elem);
+  else
+  {
+    struct list_elem *e = list_begin(&edf_ready_list);
+    while (e != list_end(&edf_ready_list) &&
+           list_entry(e, struct thread, elem)->edf_deadline
+               <= t->edf_deadline)
+      e = list_next(e);
+    list_insert(e, &t->elem);
+  }
+}
+
+/* Earliest-deadline-first bookkeeping for a timer tick charged to
+   T, the running thread: uses up its budget, starts new periods for
+   throttled threads whose deadline has come, and preempts T if a
+   thread with an earlier deadline is ready. */
+static void edf_tick(struct thread *t)
+{
+  int64_t now = timer_ticks();
+  struct list_elem *e;
+
+  if (t->edf_period > 0)
+  {
+    if (now >= t->edf_deadline)
+    {
+      // Still running at the deadline: the next period starts now
+      t->edf_deadline = now + t->edf_period;
+      t->edf_left = t->edf_budget;
+    }
+    else if (--t->edf_left <= 0)
+    {
+      t->edf_throttled = true;
+      intr_yield_on_return();
+    }
+  }
+
+  e = list_begin(&edf_throttled_list);
+  while (e != list_end(&edf_throttled_list))
+  {
+    struct thread *w = list_entry(e, struct thread, elem);
+    e = list_next(e);
+    if (now >= w->edf_deadline)
+    {
+      list_remove(&w->elem);
+      w->edf_deadline += w->edf_period;
+      if (w->edf_deadline <= now)
+        w->edf_deadline = now + w->edf_period;
+      w->edf_left = w->edf_budget;
+      w->edf_throttled = false;
+      edf_make_ready(w);
+    }
+  }
+
+  if (!list_empty(&edf_ready_list))
+  {
+    struct thread *first = list_entry(list_front(&edf_ready_list),
+                                      struct thread, elem);
+    if (t->edf_period == 0 || first->edf_deadline < t->edf_deadline)
+      intr_yield_on_return();
+  }
+}
+
+/* Returns the set of processors the current thread may run on,
+   as a bitmask of processor numbers. */
+unsigned thread_get_affinity(void)
+{
+  return thread_current()->affinity;
+}
+
+/* Restricts the current thread to the processors in MASK, a
+   bitmask of processor numbers.  This kernel runs threads only
+   on processor 0, so MASK must include it; returns false,
+   changing nothing, otherwise.  Threads the current thread
+   creates from now on inherit MASK. */
+bool thread_set_affinity(unsigned mask)
 {
-  /* Not yet implemented. */
+  if ((mask & (1u << 0)) == 0)
+    return false;
+  thread_current()->affinity = mask;
+  return true;
+}
+
+/* Sets the current thread's tickets, its share of the CPU under
+   the stride scheduler, to TICKETS, which must be between
+   TICKETS_MIN and TICKETS_MAX. */
+void thread_set_tickets(int tickets)
+{
+  ASSERT(TICKETS_MIN <= tickets && tickets <= TICKETS_MAX);
+  thread_current()->tickets = tickets;
+}
+
+/* Returns the current thread's tickets, not counting those lent
+   to it. */
+int thread_get_tickets(void)
+{
+  return thread_current()->tickets;
+}
+
+/* Orders threads in the stride run queue by pass. */
+static bool stride_less(const struct rb_node *a_, const struct rb_node *b_,
+                        void *aux UNUSED)
+{
+  const struct thread *a = rb_entry(a_, struct thread, stride_node);
+  const struct thread *b = rb_entry(b_, struct thread, stride_node);
+  return a->pass < b->pass;
+}
+
+/* Returns the lowest pass of the threads of G that are ready or
+   running, or 0 if there are none.  Interrupts must be off. */
+static uint64_t stride_floor(struct sched_group *g)
+{
+  struct thread *cur = running_thread();
+  uint64_t floor = 0;
+  bool any = false;
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (cur != idle_thread && cur->status == THREAD_RUNNING &&
+      cur->edf_period == 0 && thread_group(cur) == g)
+  {
+    floor = cur->pass;
+    any = true;
+  }
+  if (!rb_empty(&g->stride))
+  {
+    uint64_t min = rb_entry(rb_min(&g->stride),
+                            struct thread, stride_node)->pass;
+    if (!any || min < floor)
+      floor = min;
+  }
+  return floor;
+}
+
+/* Initializes G as a scheduling group with no threads and a share
+   of the CPU of WEIGHT, which must be between TICKETS_MIN and
+   TICKETS_MAX, relative to the other groups. */
+void sched_group_init(struct sched_group *g, int weight)
+{
+  int i;
+
+  ASSERT(TICKETS_MIN <= weight && weight <= TICKETS_MAX);
+
+  g->weight = weight;
+  g->pass = 0;
+  for (i = PRI_MIN; i <= PRI_MAX; i++)
+    list_init(&g->ready[i]);
+  g->ready_bitmap = 0;
+  rb_init(&g->stride, stride_less, NULL);
+}
+
+/* Moves the current thread into scheduling group G, which must
+   outlive its membership, or back to its default group if G is
+   null: its process's, if it has one, or the kernel's. */
+void thread_set_group(struct sched_group *g)
+{
+  thread_current()->group = g;
+}
+
+/* Orders scheduling groups by pass. */
+static bool group_less(const struct rb_node *a_, const struct rb_node *b_,
+                       void *aux UNUSED)
+{
+  const struct sched_group *a = rb_entry(a_, struct sched_group, node);
+  const struct sched_group *b = rb_entry(b_, struct sched_group, node);
+  return a->pass < b->pass;
+}
+
+/* Returns true if G has no ready threads. */
+static bool group_empty(struct sched_group *g)
+{
+  return g->ready_bitmap == 0 && rb_empty(&g->stride);
+}
+
+/* Returns the scheduling group that T belongs to. */
+static struct sched_group *thread_group(struct thread *t)
+{
+  if (!thread_group_share)
+    return &kernel_group;
+  if (t->group != NULL)
+    return t->group;
+#ifdef USERPROG
+  if (t->process != NULL)
+    return &t->process->group;
+#endif
+  return &kernel_group;
+}
+
+/* Adds a tick's worth of pass to G, the running thread's group,
+   keeping group_tree in order. */
+static void group_charge(struct sched_group *g)
+{
+  bool queued = !group_empty(g);
+
+  if (queued)
+    rb_remove(&group_tree, &g->node);
+  g->pass += STRIDE_ONE / g->weight;
+  if (queued)
+    rb_insert(&group_tree, &g->node);
+}
+
+/* Returns the lowest pass of the groups with ready threads and
+   that of the running thread, or 0 if there are none of them.
+   Interrupts must be off. */
+static uint64_t group_floor(void)
+{
+  struct thread *cur = running_thread();
+  uint64_t floor = 0;
+  bool any = false;
+
+  if (cur != idle_thread && cur->status == THREAD_RUNNING &&
+      cur->edf_period == 0)
+  {
+    floor = thread_group(cur)->pass;
+    any = true;
+  }
+  if (!rb_empty(&group_tree))
+  {
+    uint64_t min = rb_entry(rb_min(&group_tree),
+                            struct sched_group, node)->pass;
+    if (!any || min < floor)
+      floor = min;
+  }
+  return floor;
+}
+
+/* Takes T, which is ready to run and not of the earliest-
+   deadline-first class, out of the run queue of its scheduling
+   group.  Interrupts must be off. */
+static void remove_ready(struct thread *t)
+{
+  struct sched_group *g = thread_group(t);
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (thread_stride)
+    rb_remove(&g->stride, &t->stride_node);
+  else
+  {
+    list_remove(&t->elem);
+    if (list_empty(&g->ready[t->priority]))
+      g->ready_bitmap &= ~((uint64_t)1 << t->priority);
+  }
+  if (group_empty(g))
+    rb_remove(&group_tree, &g->node);
+}
+
+/* Puts T, which is ready to run and not of the earliest-deadline-
+   first class, in the run queue of its scheduling group, and the
+   group in group_tree if it had no ready threads.  WOKE is true
+   if T has just been unblocked.  Interrupts must be off. */
+static void make_ready(struct thread *t, bool woke)
+{
+  struct sched_group *g = thread_group(t);
+  bool was_empty = group_empty(g);
+
+  ASSERT(intr_get_level() == INTR_OFF);
+
+  if (thread_stride)
+  {
+    // One that slept does not get to catch up on the time it missed
+    uint64_t floor = stride_floor(g);
+    if (woke && t->pass < floor)
+      t->pass = floor;
+    rb_insert(&g->stride, &t->stride_node);
+  }
+  else
+  {
+    if (woke && interactive(t))
+      list_push_front(&g->ready[t->priority], &t->elem);
+    else
+      list_push_back(&g->ready[t->priority], &t->elem);
+    g->ready_bitmap |= (uint64_t)1 << t->priority;
+  }
+
+  if (was_empty)
+  {
+    // Nor does a group that had nothing to run
+    uint64_t floor = group_floor();
+    if (g->pass < floor)
+      g->pass = floor;
+    rb_insert(&group_tree, &g->node);
+  }
+}
+
+/* Sets the current thread's nice value to NICE, between -20
+   and 20, and under "-o mlfqs" recomputes its priority, yielding
+   if that leaves it outranked. */
+void thread_set_nice(int nice)
+{
+  struct thread *cur = thread_current();
+  enum intr_level old_level;
+
+  ASSERT(-20 <= nice && nice <= 20);
+
+  old_level = intr_disable();
+  cur->nice = nice;
+  if (thread_mlfqs)
+  {
+    mlfqs_update_priority(cur);
+    if (outranked(cur))
+      thread_yield();
+  }
+  intr_set_level(old_level);
 }
 
 /* Returns the current thread's nice value. */
 int thread_get_nice(void)
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int thread_get_load_avg(void)
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable();
+  int load = real_to_int_toward_nearest(multiply_by_int(load_avg, 100));
+  intr_set_level(old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int thread_get_recent_cpu(void)
 {
-  /* Not yet implemented. */
-  return 0;
+  struct real recent_cpu = thread_current()->recent_cpu;
+  return real_to_int_toward_nearest(multiply_by_int(recent_cpu, 100));
+}
+
+/* Sets T's priority under "-o mlfqs", from its recent_cpu and
+   nice, to PRI_MAX - recent_cpu / 4 - nice * 2. */
+static void mlfqs_update_priority(struct thread *t)
+{
+  int priority = PRI_MAX -
+                 real_to_int_toward_nearest(divide_by_int(t->recent_cpu, 4)) -
+                 t->nice * 2;
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  t->base_priority = priority;
+  set_priority(t, priority);
+}
+
+/* Does the timer tick's work for "-o mlfqs", with CUR the
+   running thread.  CUR's recent_cpu counts the tick.  Once a
+   second load_avg is updated and every thread's recent_cpu
+   decays:
+     load_avg = (59/60) * load_avg + (1/60) * ready_threads
+     recent_cpu = (2*load_avg)/(2*load_avg + 1) * recent_cpu + nice
+   and every thread's priority is recomputed.  In between only
+   CUR's recent_cpu changes, so every TIME_SLICE ticks only its
+   priority is. */
+static void mlfqs_tick(struct thread *cur)
+{
+  int64_t ticks = timer_ticks();
+
+  if (cur != idle_thread)
+    cur->recent_cpu = add_real_to_int(cur->recent_cpu, 1);
+
+  if (ticks % TIMER_FREQ == 0)
+  {
+    struct real decay;
+    struct list_elem *e;
+    int ready_threads = 0;
+
+    for (e = list_begin(&all_list); e != list_end(&all_list);
+         e = list_next(e))
+    {
+      struct thread *t = list_entry(e, struct thread, allelem);
+      if (t != idle_thread &&
+          (t->status == THREAD_READY || t->status == THREAD_RUNNING))
+        ready_threads++;
+    }
+    load_avg = add(multiply(FP_59_60, load_avg),
+                   multiply_by_int(FP_1_60, ready_threads));
+    decay = divide(multiply_by_int(load_avg, 2),
+                   add_real_to_int(multiply_by_int(load_avg, 2), 1));
+
+    for (e = list_begin(&all_list); e != list_end(&all_list);
+         e = list_next(e))
+    {
+      struct thread *t = list_entry(e, struct thread, allelem);
+      if (t == idle_thread)
+        continue;
+      t->recent_cpu = add_real_to_int(multiply(decay, t->recent_cpu),
+                                      t->nice);
+      mlfqs_update_priority(t);
+    }
+  }
+  else if (ticks % TIME_SLICE == 0 && cur != idle_thread)
+    mlfqs_update_priority(cur);
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
@@ -377,6 +1380,12 @@ idle(void *idle_started_ UNUSED)
 
   for (;;)
   {
+    /* Clear free pages ahead of time while nobody else wants the
+       CPU. */
+    while (rb_empty(&group_tree) && list_empty(&edf_ready_list) &&
+           palloc_zero_idle())
+      continue;
+
     /* Let someone else run. */
     intr_disable();
     thread_block();
@@ -420,12 +1429,24 @@ running_thread(void)
   /* Copy the CPU's stack pointer into `esp', and then round that
      down to the start of a page.  Because `struct thread' is
      always at the beginning of a page and the stack pointer is
-     somewhere in the middle, this locates the curent thread. */
+     somewhere in the middle, this locates the curent thread.
+     A guarded stack instead has it at the top of its slot. */
   asm("mov %%esp, %0"
       : "=g"(esp));
+  if (kstack_contains(esp))
+    return kstack_thread(esp);
   return pg_round_down(esp);
 }
 
+/* Returns the top of T's kernel stack, where it starts. */
+uint8_t *
+thread_kstack_top(const struct thread *t)
+{
+  if (kstack_contains(t))
+    return (uint8_t *)t;
+  return (uint8_t *)t + PGSIZE;
+}
+
 /* Returns true if T appears to point to a valid thread. */
 static bool
 is_thread(struct thread *t)
@@ -447,20 +1468,40 @@ init_thread(struct thread *t, const char *name, int priority)
   memset(t, 0, sizeof *t);
   t->status = THREAD_BLOCKED;
   strlcpy(t->name, name, sizeof t->name);
-  t->stack = (uint8_t *)t + PGSIZE;
+  t->stack = thread_kstack_top(t);
   t->priority = priority;
+  t->time_slice = slice_for(priority);
+  t->affinity = 1u << 0;
+  t->tickets = TICKETS_DEFAULT;
+  t->group = NULL; // the default: its process's, or the kernel's
+  t->waiting_sema = NULL;
+  if (thread_mlfqs)
+  {
+    if (t != initial_thread)
+    {
+      t->nice = thread_current()->nice;
+      t->recent_cpu = thread_current()->recent_cpu;
+    }
+    mlfqs_update_priority(t);
+  }
+  t->blocked_at = timer_ticks(); // not asleep until it first blocks
   t->magic = THREAD_MAGIC;
 
   // For Phase 2
   sema_init(&t->child_parent_relation, 0);
-  sema_init(&t->parent_wait_till_child_exit, 0);
-  list_init(&t->children);
-  list_init(&t->files_opened_by_me);
+  t->record = NULL;
+  t->children = NULL; // allocated by the first exec, spawn or fork
+  t->child_cnt = 0;
+  list_init(&t->exited_children);
+  cond_init(&t->child_exited);
+#ifdef USERPROG
+  t->process = NULL; // set by load, fork or thread_spawn
+#endif
+#ifdef VM
+  t->user_esp = NULL;
+#endif
 
-  t->exit_status = 0;
-  t->child_result_status = -1;
   t->child_success = false;
-  t->certain_tid_parent_wait_for = -1;
 
   if (t != initial_thread)
   {
@@ -492,15 +1533,35 @@ alloc_frame(struct thread *t, size_t size)
 /* Chooses and returns the next thread to be scheduled.  Should
    return a thread from the run queue, unless the run queue is
    empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+   will be in the run queue.)  Threads of the earliest-deadline-
+   first class come before the rest, which come from the group
+   with the lowest pass, in the order of the stride scheduler or
+   else highest priority first, round robin within a priority.
+   If the run queues are empty, return idle_thread. */
 static struct thread *
 next_thread_to_run(void)
 {
-  if (list_empty(&ready_list))
+  struct sched_group *g;
+  struct thread *t;
+
+  if (!list_empty(&edf_ready_list))
+    return list_entry(list_pop_front(&edf_ready_list), struct thread, elem);
+  if (rb_empty(&group_tree))
     return idle_thread;
+
+  g = rb_entry(rb_min(&group_tree), struct sched_group, node);
+  if (thread_stride)
+    t = rb_entry(rb_pop_min(&g->stride), struct thread, stride_node);
   else
-    return list_entry(list_pop_front(&ready_list), struct thread, elem);
+  {
+    int priority = highest_bit(g->ready_bitmap);
+    t = list_entry(list_pop_front(&g->ready[priority]), struct thread, elem);
+    if (list_empty(&g->ready[priority]))
+      g->ready_bitmap &= ~((uint64_t)1 << priority);
+  }
+  if (group_empty(g))
+    rb_remove(&group_tree, &g->node);
+  return t;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -525,16 +1586,25 @@ void thread_schedule_tail(struct thread *prev)
 
   ASSERT(intr_get_level() == INTR_OFF);
 
-  /* Mark us as running. */
+  /* Mark us as running, on this processor. */
   cur->status = THREAD_RUNNING;
+  cur->last_cpu = cpu_id();
+  info_publish(cur);
 
-  /* Start new time slice. */
-  thread_ticks = 0;
+  /* Start new time slice, unless handed the rest of one. */
+  if (handoff == NULL)
+    thread_ticks = 0;
+  handoff = NULL;
 
 #ifdef USERPROG
-  /* Activate the new address space. */
-  process_activate();
+  /* Activate the new address space.  A kernel thread has none and
+     never enters user mode, so it needs neither a page directory
+     of its own nor its stack in the TSS, and switching to it skips
+     both. */
+  if (cur->process != NULL)
+    process_activate();
 #endif
+  fpu_switch(cur);
 
   /* If the thread we switched from is dying, destroy its struct
      thread.  This must happen late so that thread_exit() doesn't
@@ -544,14 +1614,18 @@ void thread_schedule_tail(struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread)
   {
     ASSERT(prev != cur);
-    palloc_free_page(prev);
+    if (kstack_contains(prev))
+      kstack_free(prev);
+    else
+      palloc_free_page(prev);
   }
 }
 
 /* Schedules a new process.  At entry, interrupts must be off and
    the running process's state must have been changed from
    running to some other state.  This function finds another
-   thread to run and switches to it.
+   thread to run, or takes the one thread_yield_to() names, and
+   switches to it.
 
    It's not safe to call printf() until thread_schedule_tail()
    has completed. */
@@ -559,7 +1633,7 @@ static void
 schedule(void)
 {
   struct thread *cur = running_thread();
-  struct thread *next = next_thread_to_run();
+  struct thread *next = handoff != NULL ? handoff : next_thread_to_run();
   struct thread *prev = NULL;
 
   ASSERT(intr_get_level() == INTR_OFF);
@@ -567,7 +1641,17 @@ schedule(void)
   ASSERT(is_thread(next));
 
   if (cur != next)
+    cur->last_ran = timer_ticks();
+  info_publish(cur);
+  rcu_quiescent(cur);
+  if (cur != next)
+  {
+    if (cur->status == THREAD_READY)
+      cur->involuntary_switches++;
+    else
+      cur->voluntary_switches++;
     prev = switch_threads(cur, next);
+  }
   thread_schedule_tail(prev);
 }
 
@@ -3,8 +3,15 @@
 
 
 #include <debug.h>
+#include <hash.h>
 #include <list.h>
+#include <rbtree.h>
+#include <rusage.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/fixed_point.h"
+#include "threads/percpu.h"
+#include "threads/rcu.h"
 #include "threads/synch.h"
 
 /* States in a thread's life cycle. */
@@ -25,6 +32,28 @@ typedef int tid_t;
 #define PRI_MIN 0      /* Lowest priority. */
 #define PRI_DEFAULT 31 /* Default priority. */
 #define PRI_MAX 63     /* Highest priority. */
+#define PRI_NONE (PRI_MIN - 1) /* No priority, as a lent one. */
+
+/* Stride scheduler tickets. */
+#define TICKETS_MIN 1        /* Fewest tickets. */
+#define TICKETS_DEFAULT 100  /* Default tickets. */
+#define TICKETS_MAX 10000    /* Most tickets. */
+
+/* A scheduling group.  With "-group", the CPU is shared between
+   groups in proportion to their weights, and then between the
+   threads of each group by the thread scheduler, so that a group
+   with many threads does not crowd out one with few.  Each
+   process is a group, and the kernel threads outside processes
+   share another.  Owned by thread.c. */
+struct sched_group
+{
+   int weight;             /* Share relative to other groups. */
+   uint64_t pass;          /* Lowest runs next. */
+   struct list ready[PRI_MAX + 1]; /* Ready threads by priority. */
+   uint64_t ready_bitmap;  /* Bit P set iff ready[P] is nonempty. */
+   struct rb_tree stride;  /* Ready threads, by pass, with "-stride". */
+   struct rb_node node;    /* Element in the group run queue. */
+};
 
 /* A kernel thread or user process.
 
@@ -50,10 +79,10 @@ typedef int tid_t;
              |                                 |
              +---------------------------------+
              |              magic              |
+             |              status             |
              |                :                |
              |                :                |
              |               name              |
-             |              status             |
         0 kB +---------------------------------+
 
    The upshot of this is twofold:
@@ -75,46 +104,136 @@ typedef int tid_t;
    an assertion failure in thread_current(), which checks that
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
-   value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+   value, triggering the assertion.
+
+   A thread created with thread_create_stack() and more than one
+   page of stack is laid out the other way up, in a slot of the
+   guarded stack region (see kstack.c): `struct thread' at the
+   top, the stack below it, and an unmapped guard page below
+   that, so that an overflow faults instead of corrupting memory.
+   thread_kstack_top() gives where either kind of stack starts. */
+/* The `elem' member is an element in the run queue (thread.c)
+   while the thread is ready, and may be one in a list of other
+   blocked threads, such as a process's upcall waiters, while it
+   is blocked.  A thread waiting for a semaphore is instead in
+   the semaphore's wait queue through `wait_elem' (synch.c). */
 struct thread
 {
    /* Owned by thread.c. */
    tid_t tid;                 /* Thread identifier. */
-   enum thread_status status; /* Thread state. */
    char name[16];             /* Name (for debugging purposes). */
-   uint8_t *stack;            /* Saved stack pointer. */
-   int priority;              /* Priority. */
+   int base_priority;         /* Set by thread_set_priority(). */
+   unsigned affinity;         /* Processors it may run on. */
+   unsigned last_cpu;         /* Processor it last ran on. */
+   int64_t last_ran;          /* Tick it was last switched out. */
+   struct sched_group *group; /* Set by thread_set_group(), or NULL. */
    struct list_elem allelem;  /* List element for all threads list. */
 
-   /* Shared between thread.c and synch.c. */
-   struct list_elem elem; /* List element. */
+   /* Earliest-deadline-first class, set by thread_set_deadline().
+      Owned by thread.c. */
+   int64_t edf_period;        /* Ticks per period, or 0 if not EDF. */
+   int64_t edf_budget;        /* Ticks it may run each period. */
+   int64_t edf_deadline;      /* End of the current period. */
+   int64_t edf_left;          /* Budget left this period. */
+   bool edf_throttled;        /* Out of budget until the deadline? */
+
+   /* Stride scheduler, used with "-stride".  Owned by thread.c,
+      except donated_tickets (synch.c). */
+   int tickets;               /* Set by thread_set_tickets(). */
+   int donated_tickets;       /* Lent by threads it is to signal. */
+   uint64_t pass;             /* Lowest pass runs next. */
+   struct rb_node stride_node; /* Element in the stride run queue. */
+
+   /* Priority donation, used unless "-stride" or "-o mlfqs".  The
+      semaphores it is the signaler of each lend it the highest
+      priority of their waiters.  Owned by thread.c, except
+      waiting_sema (synch.c), which the stride scheduler's ticket
+      lending follows too. */
+   uint16_t donation_cnt[PRI_MAX + 1]; /* Semaphores lending each. */
+   uint64_t donation_bitmap;  /* Bit P set iff donation_cnt[P] != 0. */
+   struct semaphore *waiting_sema; /* Blocked on, or NULL. */
+
+   /* Owned by synch.c. */
+   struct wait_elem wait_elem;  /* In a semaphore's wait queue. */
+   struct wait_elem *cond_elem; /* In a condition's wait queue. */
+
+   /* Multi-level feedback queue scheduler, used with "-o mlfqs".
+      Owned by thread.c. */
+   int nice;                  /* Set by thread_set_nice(). */
+   struct real recent_cpu;    /* Decaying count of ticks run. */
+
+   /* Interactivity boost, used with "-boost".  Owned by thread.c. */
+   int64_t blocked_at;        /* When it last blocked. */
+   int sleep_avg;             /* Ticks of sleep not yet run off. */
+
+   /* Resource usage, reported by getrusage().  Owned by thread.c,
+      except lock_wait_ticks (synch.c) and page_faults and faults
+      (exception.c). */
+   unsigned user_ticks;           /* Ticks run in user mode. */
+   unsigned kernel_ticks;         /* Ticks run in the kernel. */
+   unsigned voluntary_switches;   /* Switched out blocked or dying. */
+   unsigned involuntary_switches; /* Switched out still ready. */
+   unsigned lock_wait_ticks;      /* Ticks waited in lock_acquire(). */
+   unsigned page_faults;          /* Page faults taken. */
+   unsigned faults[FAULT_CNT];    /* Those by enum fault_type. */
 
    /*For phase 2*/
-   tid_t certain_tid_parent_wait_for;
    bool child_success;      // depend on the load function
-   int child_result_status; // My child failed or what
-   int exit_status;         // I failed or what
-   struct thread * parent;
-   struct list children;
-   struct list files_opened_by_me; // Important for removing
+   struct thread * parent;  // Only valid while it holds my record
+   struct child_record *record;   // What my parent learns of me, or NULL
+   struct hash *children;         // My children's records by tid, or NULL
+   int child_cnt;                 // Children yet to exit, under wait_lock
+   struct list exited_children;   // Records of those that have exited
+   struct condition child_exited; // Signalled when one of them exits
 
    
-   struct list_elem ch_elem;       // To put it in children
-   struct semaphore parent_wait_till_child_exit;
-   struct semaphore child_parent_relation; // Parent forces child to work here
-   struct file *exe;
+   struct semaphore child_parent_relation; // Child tells parent it loaded
+
+#ifdef USERPROG
+   /* Owned by userprog/process.c. */
+   bool upcall_parked;      /* In upcall_wait()? */
+
+   /* Owned by userprog/pagedir.c. */
+   int tlb_batch_depth;     /* Nested pagedir_batch_begin()s. */
+#endif
+#ifdef VM
+   /* Owned by vm/page.c. */
+   void *user_esp;       /* User stack pointer on entry to a system call. */
+#endif
+#ifdef FILESYS
+   /* Owned by filesys/journal.c. */
+   int journal_depth;       /* Nested journal_begin()s. */
+   size_t journal_room;     /* Sectors reserved but not yet logged. */
+#endif
+
+   /* Everything a thread switch or a timer tick touches, on the
+      cache line that ends with MAGIC, which thread_current()
+      checks, so that each of them costs one line of the struct
+      instead of several.  Keep it within CACHE_LINE bytes. */
+
+   /* Shared between thread.c and synch.c. */
+   struct list_elem elem      /* List element. */
+     __attribute__ ((aligned (CACHE_LINE)));
+
+   /* Owned by thread.c. */
+   enum thread_status status; /* Thread state. */
+   uint8_t *stack;            /* Saved stack pointer. */
+   int priority;              /* Priority, counting those lent. */
+   unsigned time_slice;       /* Ticks it runs before preemption. */
+   struct info_slot *info;    /* Published state, or NULL. */
 
 #ifdef USERPROG
    /* Owned by userprog/process.c. */
-   uint32_t *pagedir; /* Page directory. */
+   struct process *process; /* Process it runs in, or NULL. */
 #endif
 
+   /* Owned by threads/fpu.c. */
+   void *fpu; /* FPU save area, or NULL if never used. */
+
+   /* Owned by thread.c. */
+   int preempt_count;    /* preempt_disable() calls not yet undone. */
+   bool preempt_pending; /* Preempted meanwhile, to yield once 0. */
+
    /* Owned by thread.c. */
    unsigned magic; /* Detects stack overflow. */
 };
@@ -122,25 +241,76 @@ struct thread
 struct files_opened
 {
    struct file *f;
-   struct list_elem elem;
    int file_descriptor;
+   bool nonblock; // Reads and writes that would wait fail instead
+   int ref_cnt; // The fd table's reference, plus one per call using it
+   struct rcu_head rcu; // Frees it once lookups are done with it
 };
+/* Scheduling policies.  A kernel built with "make SCHED=stride",
+   say, which defines SCHED_POLICY, has its policy fixed at compile
+   time: thread_mlfqs and thread_stride below become constants, so
+   the other policies' branches in the timer tick, the run queues
+   and the semaphores fold away, and the options that would choose
+   another policy are refused.  The default build, SCHED_ANY, keeps
+   every policy and chooses among them at boot. */
+#define SCHED_ANY 0             /* Chosen by command-line options. */
+#define SCHED_RR 1              /* Round-robin by priority. */
+#define SCHED_STRIDE 2          /* Stride scheduling by tickets. */
+#define SCHED_MLFQS 3           /* Multi-level feedback queue. */
+#ifndef SCHED_POLICY
+#define SCHED_POLICY SCHED_ANY
+#endif
+
+#if SCHED_POLICY == SCHED_ANY
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
+#else
+#define thread_mlfqs (SCHED_POLICY == SCHED_MLFQS)
+#endif
+
+/* Time slices of threads of priority PRI_MAX and PRI_MIN.
+   Controlled by kernel command-line option "-slice=SHORT,LONG". */
+extern unsigned thread_slice_short;
+extern unsigned thread_slice_long;
+
+/* If true, use the stride scheduler, which shares the CPU in
+   proportion to tickets, instead of round-robin.
+   Controlled by kernel command-line option "-stride". */
+#if SCHED_POLICY == SCHED_ANY
+extern bool thread_stride;
+#else
+#define thread_stride (SCHED_POLICY == SCHED_STRIDE)
+#endif
+
+/* If true, share the CPU between scheduling groups first.
+   Controlled by kernel command-line option "-group". */
+extern bool thread_group_share;
+
+/* If true, threads that mostly sleep run first when they wake.
+   Controlled by kernel command-line option "-boost". */
+extern bool thread_boost;
+
+/* Pages of kernel stack thread_create() gives a thread.
+   Controlled by kernel command-line option "-kstack=PAGES". */
+extern size_t thread_stack_pages;
 
 void thread_init(void);
 void thread_start(void);
 
-void thread_tick(void);
+void thread_tick(bool user);
 void thread_print_stats(void);
 
 typedef void thread_func(void *aux);
 tid_t thread_create(const char *name, int priority, thread_func *, void *);
+tid_t thread_create_stack(const char *name, int priority, size_t stack_pages,
+                          thread_func *, void *);
+uint8_t *thread_kstack_top(const struct thread *);
 
 void thread_block(void);
 void thread_unblock(struct thread *);
+void thread_unblock_all(struct list *);
 
 struct thread *thread_current(void);
 tid_t thread_tid(void);
@@ -148,6 +318,7 @@ const char *thread_name(void);
 
 void thread_exit(void) NO_RETURN;
 void thread_yield(void);
+void thread_yield_to(struct thread *);
 
 /* Performs some operation on thread t, given auxiliary data AUX. */
 typedef void thread_action_func(struct thread *t, void *aux);
@@ -155,6 +326,29 @@ void thread_foreach(thread_action_func *, void *);
 
 int thread_get_priority(void);
 void thread_set_priority(int);
+bool thread_lend_priority(struct thread *, int old, int new);
+void thread_yield_if_outranked(void);
+
+void preempt_disable(void);
+void preempt_enable(void);
+bool preempt_defer(void);
+void cond_resched(void);
+
+struct rusage;
+void thread_get_rusage(const struct thread *, struct rusage *);
+struct threadinfo;
+int thread_get_info(struct threadinfo *, int cnt);
+
+bool thread_set_deadline(int64_t period, int64_t budget);
+
+unsigned thread_get_affinity(void);
+bool thread_set_affinity(unsigned mask);
+
+int thread_get_tickets(void);
+void thread_set_tickets(int);
+
+void sched_group_init(struct sched_group *, int weight);
+void thread_set_group(struct sched_group *);
 
 int thread_get_nice(void);
 void thread_set_nice(int);
@@ -0,0 +1,18 @@
+#ifndef THREADS_TSC_H
+#define THREADS_TSC_H
+
+#include <stdint.h>
+
+/* Returns the time-stamp counter, the number of CPU cycles since
+   reset.  See [IA32-v2b] "RDTSC".  The count is only meaningful
+   relative to another reading, and under a simulator it may not
+   advance at a steady rate. */
+static inline uint64_t
+rdtsc (void)
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+#endif /* threads/tsc.h */
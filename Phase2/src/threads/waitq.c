@@ -0,0 +1,63 @@
+#include "threads/waitq.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/* Initializes Q as an empty wait queue. */
+void
+waitq_init (struct waitq *q)
+{
+  list_init (&q->entries);
+}
+
+/* Initializes ENTRY, on no queue yet, to up SEMA when a queue it
+   is put on wakes. */
+void
+waitq_entry_init (struct waitq_entry *entry, struct semaphore *sema)
+{
+  entry->queue = NULL;
+  entry->sema = sema;
+}
+
+/* Puts ENTRY, which must be on no queue, on Q. */
+void
+waitq_add (struct waitq *q, struct waitq_entry *entry)
+{
+  enum intr_level old_level;
+
+  ASSERT (entry->queue == NULL);
+
+  old_level = intr_disable ();
+  list_push_back (&q->entries, &entry->elem);
+  entry->queue = q;
+  intr_set_level (old_level);
+}
+
+/* Takes ENTRY off the queue it is on, if any. */
+void
+waitq_remove (struct waitq_entry *entry)
+{
+  enum intr_level old_level = intr_disable ();
+
+  if (entry->queue != NULL)
+    {
+      list_remove (&entry->elem);
+      entry->queue = NULL;
+    }
+  intr_set_level (old_level);
+}
+
+/* Ups the semaphore of every entry on Q.  The entries stay on Q
+   until their threads remove them.  May be called from an
+   interrupt handler. */
+void
+waitq_wake (struct waitq *q)
+{
+  enum intr_level old_level = intr_disable ();
+  struct list_elem *e;
+
+  for (e = list_begin (&q->entries); e != list_end (&q->entries);
+       e = list_next (e))
+    sema_up (list_entry (e, struct waitq_entry, elem)->sema);
+  intr_set_level (old_level);
+}
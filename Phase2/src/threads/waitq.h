@@ -0,0 +1,36 @@
+#ifndef THREADS_WAITQ_H
+#define THREADS_WAITQ_H
+
+#include <list.h>
+
+struct semaphore;
+
+/* A queue of threads to tell when the object that owns it
+   changes, for example when a pipe gets data or a key is typed.
+   A thread puts an entry on the queues of everything it waits
+   on, all pointing to one semaphore of its own, then downs the
+   semaphore: whichever object changes first wakes it, unlike a
+   condition variable, which ties its waiter to one lock.
+
+   Entries are added and removed with interrupts off, so that
+   waitq_wake() may be called from an interrupt handler. */
+struct waitq
+  {
+    struct list entries;                /* struct waitq_entry. */
+  };
+
+/* A thread's place on a waitq. */
+struct waitq_entry
+  {
+    struct list_elem elem;              /* Element in QUEUE. */
+    struct waitq *queue;                /* Queue it is on, or null. */
+    struct semaphore *sema;             /* Upped when QUEUE wakes. */
+  };
+
+void waitq_init (struct waitq *);
+void waitq_entry_init (struct waitq_entry *, struct semaphore *);
+void waitq_add (struct waitq *, struct waitq_entry *);
+void waitq_remove (struct waitq_entry *);
+void waitq_wake (struct waitq *);
+
+#endif /* threads/waitq.h */
@@ -0,0 +1,172 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <list.h>
+#include <stats.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Workqueues.
+
+   A subsystem with work to do in the background, such as I/O on
+   behalf of a process, creates a workqueue instead of a loop of
+   its own around thread_create().  wq_submit() queues a function
+   and its argument, and one of the queue's worker threads calls
+   it.  Items are started in the order submitted, but with more
+   than one worker they may run at the same time and finish in
+   any order.
+
+   Workers are started as they are needed, when an item is
+   submitted and none is idle, up to the queue's limit, and then
+   stay for as long as the kernel runs.  They run at the priority
+   given to wq_create(), which an item may not change.
+
+   wq_submit() takes a lock and allocates memory, so it may not be
+   called from an interrupt handler or a softirq, only from a
+   thread, such as a threaded interrupt handler.
+
+   Each queue has one lock for its list of items, which is enough
+   for a uniprocessor.  With several CPUs it would want a list
+   and a worker per CPU. */
+
+/* A workqueue. */
+struct workqueue
+  {
+    const char *name;                   /* Name of its workers. */
+    int priority;                       /* Priority of its workers. */
+    int max_workers;                    /* Most workers to start. */
+    int workers;                        /* Workers started. */
+    int idle;                           /* Workers free to be woken. */
+    int busy;                           /* Items queued or running. */
+    struct list items;                  /* Items not yet taken. */
+    struct lock lock;                   /* Protects the above. */
+    struct condition queued;            /* Wakes an idle worker. */
+    struct condition drained;           /* BUSY became 0. */
+    int64_t submitted;                  /* Items ever submitted. */
+  };
+
+/* An item of work. */
+struct work
+  {
+    struct list_elem elem;              /* In its queue's ITEMS. */
+    wq_func *func;                      /* Does the work. */
+    void *aux;                          /* Argument to FUNC. */
+  };
+
+static thread_func worker NO_RETURN;
+
+/* Creates and returns a workqueue whose items run in up to
+   MAX_WORKERS kernel threads named NAME, at PRIORITY.  NAME must
+   remain valid as long as the kernel runs.  Returns a null
+   pointer if memory is short. */
+struct workqueue *
+wq_create (const char *name, int priority, int max_workers)
+{
+  struct workqueue *wq;
+
+  ASSERT (name != NULL);
+  ASSERT (priority >= PRI_MIN && priority <= PRI_MAX);
+  ASSERT (max_workers > 0);
+
+  wq = malloc (sizeof *wq);
+  if (wq == NULL)
+    return NULL;
+  wq->name = name;
+  wq->priority = priority;
+  wq->max_workers = max_workers;
+  wq->workers = 0;
+  wq->idle = 0;
+  wq->busy = 0;
+  list_init (&wq->items);
+  lock_init_named (&wq->lock, name);
+  cond_init (&wq->queued);
+  cond_init (&wq->drained);
+  wq->submitted = 0;
+  stats_add_int64 ("workqueue", name, "submitted", &wq->submitted);
+  return wq;
+}
+
+/* Queues a call to FUNC with AUX in one of WQ's workers.  Returns
+   true if successful, false if memory is short or no worker
+   could be started. */
+bool
+wq_submit (struct workqueue *wq, wq_func *func, void *aux)
+{
+  struct work *w;
+
+  ASSERT (!intr_context ());
+  ASSERT (func != NULL);
+
+  w = malloc (sizeof *w);
+  if (w == NULL)
+    return false;
+  w->func = func;
+  w->aux = aux;
+
+  lock_acquire (&wq->lock);
+  if (wq->idle > 0)
+    {
+      /* The woken worker no longer counts as idle, so that the
+         next item goes to another. */
+      wq->idle--;
+      cond_signal (&wq->queued, &wq->lock);
+    }
+  else if (wq->workers < wq->max_workers)
+    {
+      if (thread_create (wq->name, wq->priority, worker, wq) != TID_ERROR)
+        wq->workers++;
+      else if (wq->workers == 0)
+        {
+          lock_release (&wq->lock);
+          free (w);
+          return false;
+        }
+    }
+  list_push_back (&wq->items, &w->elem);
+  wq->busy++;
+  wq->submitted++;
+  lock_release (&wq->lock);
+  return true;
+}
+
+/* Waits until WQ has no items queued or running.  Items that are
+   submitted meanwhile, even by its own items, are waited for
+   too. */
+void
+wq_flush (struct workqueue *wq)
+{
+  lock_acquire (&wq->lock);
+  while (wq->busy > 0)
+    cond_wait (&wq->drained, &wq->lock);
+  lock_release (&wq->lock);
+}
+
+/* Runs the items of workqueue WQ_, one at a time, forever. */
+static void
+worker (void *wq_)
+{
+  struct workqueue *wq = wq_;
+
+  lock_acquire (&wq->lock);
+  for (;;)
+    {
+      struct work *w;
+
+      while (list_empty (&wq->items))
+        {
+          wq->idle++;
+          cond_wait (&wq->queued, &wq->lock);
+        }
+      w = list_entry (list_pop_front (&wq->items), struct work, elem);
+      lock_release (&wq->lock);
+
+      w->func (w->aux);
+      free (w);
+
+      lock_acquire (&wq->lock);
+      if (--wq->busy == 0)
+        cond_broadcast (&wq->drained, &wq->lock);
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <stdbool.h>
+
+/* Does one item of work, in a worker thread of a workqueue. */
+typedef void wq_func (void *aux);
+
+struct workqueue;
+
+struct workqueue *wq_create (const char *name, int priority,
+                             int max_workers);
+bool wq_submit (struct workqueue *, wq_func *, void *aux);
+void wq_flush (struct workqueue *);
+
+#endif /* threads/workqueue.h */
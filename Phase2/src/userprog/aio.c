@@ -0,0 +1,228 @@
+#include "userprog/aio.h"
+#include <debug.h>
+#include <list.h>
+#include <poll.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "userprog/process.h"
+#include "userprog/syscall.h"
+
+/* Asynchronous file I/O.
+
+   aio_submit() queues a read or write at a given offset and
+   returns at once; one of the AIO_WORKERS threads of the aio
+   workqueue picks it up and makes the file_read_at() or file_write_at() call, so that a
+   process can keep several disk requests in flight from a single
+   thread.  Each request sits on its process's aio_requests list
+   from submission until aio_wait() collects its result.
+
+   A worker has no access to the process's memory, so a request
+   moves its data through a kernel buffer: a write's data is
+   copied in when it is submitted, and a read's is copied out to
+   the user buffer by aio_wait().  Requests move at most
+   AIO_MAX_SIZE bytes, and a process may have at most
+   AIO_MAX_REQUESTS uncollected.  The request holds its own
+   reference to the file, so closing the fd does not cancel it.
+
+   aio_lock protects every process's list and the state of every
+   request on one. */
+
+#define AIO_WORKERS 4                   /* Kernel I/O threads. */
+#define AIO_MAX_REQUESTS 16             /* Uncollected per process. */
+#define AIO_MAX_SIZE (64 * 1024)        /* Bytes per request. */
+
+/* A read or write. */
+struct aio_request
+  {
+    struct list_elem proc_elem;         /* In aio_requests, or unused
+                                           if orphaned. */
+    int id;                             /* Returned by aio_submit(). */
+    bool write;                         /* Write, not read? */
+    struct file *file;                  /* Reference of our own. */
+    void *buffer;                       /* User buffer. */
+    void *data;                         /* Kernel copy of the data. */
+    unsigned size;                      /* Bytes to move. */
+    off_t ofs;                          /* File offset. */
+    bool done;                          /* Has a worker finished? */
+    bool orphaned;                      /* Did its process exit? */
+    int result;                         /* Bytes moved, once done. */
+  };
+
+static struct workqueue *aio_wq;        /* Makes the requests. */
+static struct lock aio_lock;
+static struct condition aio_finished;   /* Some request became done. */
+
+static wq_func aio_work;
+
+/* Frees R and what it holds. */
+static void
+request_free (struct aio_request *r)
+{
+  file_close (r->file);
+  free (r->data);
+  free (r);
+}
+
+/* Initializes asynchronous I/O and starts its workers. */
+void
+aio_init (void)
+{
+  lock_init_named (&aio_lock, "aio");
+  cond_init (&aio_finished);
+  aio_wq = wq_create ("aio-worker", PRI_DEFAULT, AIO_WORKERS);
+  if (aio_wq == NULL)
+    PANIC ("aio_init: out of memory");
+}
+
+/* Queues a read of SIZE bytes at offset OFS in FILE into the user
+   BUFFER, or a write of them from it if WRITE, for the current
+   process.  BUFFER must have been checked already.  Returns the
+   request's identifier for aio_wait(), or -1 if FILE's reads and
+   writes may wait indefinitely, as a pipe's do, if the process
+   has too many requests outstanding or if memory is short.  A
+   request for more than AIO_MAX_SIZE bytes moves only that many,
+   as if it were short. */
+int
+aio_submit (struct file *file, void *buffer, unsigned size, off_t ofs,
+            bool write)
+{
+  struct process *proc = thread_current ()->process;
+  struct aio_request *r;
+  int id;
+
+  if (file_poll (file, NULL) != (POLLIN | POLLOUT) || ofs < 0)
+    return -1;
+  if (size > AIO_MAX_SIZE)
+    size = AIO_MAX_SIZE;
+
+  r = calloc (1, sizeof *r);
+  if (r == NULL)
+    return -1;
+  r->data = malloc (size > 0 ? size : 1);
+  if (r->data == NULL)
+    {
+      free (r);
+      return -1;
+    }
+  if (write)
+    memcpy (r->data, buffer, size);
+  r->write = write;
+  r->buffer = buffer;
+  r->size = size;
+  r->ofs = ofs;
+
+  lock_acquire (&aio_lock);
+  if (list_size (&proc->aio_requests) >= AIO_MAX_REQUESTS)
+    {
+      lock_release (&aio_lock);
+      free (r->data);
+      free (r);
+      return -1;
+    }
+  r->file = file_dup (file);
+  if (!wq_submit (aio_wq, aio_work, r))
+    {
+      lock_release (&aio_lock);
+      request_free (r);
+      return -1;
+    }
+  id = r->id = proc->aio_next_id++;
+  list_push_back (&proc->aio_requests, &r->proc_elem);
+  lock_release (&aio_lock);
+  return id;
+}
+
+/* Waits for the current process's request ID to finish and
+   returns the number of bytes it moved, the identifier becoming
+   free again.  Returns -1 if there is no such request.  Kills the
+   process if a read's buffer has been unmapped since. */
+int
+aio_wait (int id)
+{
+  struct process *proc = thread_current ()->process;
+  struct aio_request *r = NULL;
+  struct list_elem *e;
+  int result;
+
+  lock_acquire (&aio_lock);
+  for (e = list_begin (&proc->aio_requests);
+       e != list_end (&proc->aio_requests); e = list_next (e))
+    if (list_entry (e, struct aio_request, proc_elem)->id == id)
+      {
+        r = list_entry (e, struct aio_request, proc_elem);
+        break;
+      }
+  if (r == NULL)
+    {
+      lock_release (&aio_lock);
+      return -1;
+    }
+  while (!r->done)
+    cond_wait (&aio_finished, &aio_lock);
+  list_remove (&r->proc_elem);
+  lock_release (&aio_lock);
+
+  /* Without aio_lock, since this may fault. */
+  result = r->result;
+  if (!r->write && result > 0)
+    {
+      if (!validate_user_buffer (r->buffer, result, true))
+        {
+          request_free (r);
+          sys_exit (-1);
+        }
+      memcpy (r->buffer, r->data, result);
+    }
+  request_free (r);
+  return result;
+}
+
+/* Gives up the current process's requests.  Finished ones are
+   freed at once and the rest by their workers, so writes still
+   reach the file. */
+void
+aio_exit (void)
+{
+  struct process *proc = thread_current ()->process;
+
+  lock_acquire (&aio_lock);
+  while (!list_empty (&proc->aio_requests))
+    {
+      struct list_elem *e = list_pop_front (&proc->aio_requests);
+      struct aio_request *r = list_entry (e, struct aio_request,
+                                          proc_elem);
+      if (r->done)
+        request_free (r);
+      else
+        r->orphaned = true;
+    }
+  lock_release (&aio_lock);
+}
+
+/* Makes request R_, in a worker of the aio workqueue. */
+static void
+aio_work (void *r_)
+{
+  struct aio_request *r = r_;
+  int result;
+
+  if (r->write)
+    result = file_write_at (r->file, r->data, r->size, r->ofs);
+  else
+    result = file_read_at (r->file, r->data, r->size, r->ofs);
+
+  lock_acquire (&aio_lock);
+  if (r->orphaned)
+    request_free (r);
+  else
+    {
+      r->result = result;
+      r->done = true;
+      cond_broadcast (&aio_finished, &aio_lock);
+    }
+  lock_release (&aio_lock);
+}
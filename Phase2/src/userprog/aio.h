@@ -0,0 +1,15 @@
+#ifndef USERPROG_AIO_H
+#define USERPROG_AIO_H
+
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct file;
+
+void aio_init (void);
+int aio_submit (struct file *, void *buffer, unsigned size, off_t ofs,
+                bool write);
+int aio_wait (int id);
+void aio_exit (void);
+
+#endif /* userprog/aio.h */
@@ -0,0 +1,157 @@
+#include "userprog/elfcache.h"
+#include <debug.h>
+#include <list.h>
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Cache of parsed executables.
+
+   load() reads and checks an executable's ELF header and program
+   headers each time it runs.  The result, an elf_image, is kept
+   here for the ELFCACHE_SIZE most recently run executables, so
+   that running one again skips all of that.  An entry keeps its
+   inode open, so that the inode's write count stays meaningful,
+   and is dropped on lookup if anything has written the file since
+   or it has been removed.  Removed files are also swept out
+   whenever an entry is added, so that their blocks are not held
+   for long. */
+
+#define ELFCACHE_SIZE 16
+
+/* A cached image. */
+struct elfcache_entry
+  {
+    struct list_elem elem;              /* In entries. */
+    struct inode *inode;                /* Executable, kept open. */
+    unsigned write_cnt;                 /* Its write count then. */
+    struct elf_image *image;            /* One reference. */
+  };
+
+/* Entries, most recently used first.  entries and every image's
+   ref_cnt are protected by elfcache_lock. */
+static struct list entries;
+static size_t entry_cnt;
+static struct lock elfcache_lock;
+
+/* Returns a new image with room for SEG_CNT segments and one
+   reference, or a null pointer if memory is short. */
+struct elf_image *
+elf_image_create (size_t seg_cnt)
+{
+  struct elf_image *image;
+
+  image = malloc (sizeof *image + seg_cnt * sizeof image->segs[0]);
+  if (image != NULL)
+    {
+      image->ref_cnt = 1;
+      image->seg_cnt = seg_cnt;
+    }
+  return image;
+}
+
+/* Drops a reference to IMAGE, freeing it with the last. */
+void
+elf_image_release (struct elf_image *image)
+{
+  bool last;
+
+  if (image == NULL)
+    return;
+  lock_acquire (&elfcache_lock);
+  last = --image->ref_cnt == 0;
+  lock_release (&elfcache_lock);
+  if (last)
+    free (image);
+}
+
+/* Initializes the cache. */
+void
+elfcache_init (void)
+{
+  list_init (&entries);
+  lock_init_named (&elfcache_lock, "elfcache");
+}
+
+/* Takes E out of the cache and frees it.  elfcache_lock must be
+   held; E's image may outlive it. */
+static void
+entry_free (struct elfcache_entry *e)
+{
+  list_remove (&e->elem);
+  entry_cnt--;
+  if (--e->image->ref_cnt == 0)
+    free (e->image);
+  inode_close (e->inode);
+  free (e);
+}
+
+/* Returns the cached image of the executable INODE, with a
+   reference for the caller to release, or a null pointer if
+   there is none that is still current. */
+struct elf_image *
+elfcache_lookup (struct inode *inode)
+{
+  struct elf_image *image = NULL;
+  struct list_elem *le;
+
+  lock_acquire (&elfcache_lock);
+  for (le = list_begin (&entries); le != list_end (&entries);
+       le = list_next (le))
+    {
+      struct elfcache_entry *e = list_entry (le, struct elfcache_entry,
+                                             elem);
+      if (e->inode != inode)
+        continue;
+      if (e->write_cnt != inode_write_cnt (inode)
+          || inode_is_removed (inode))
+        entry_free (e);
+      else
+        {
+          list_remove (&e->elem);
+          list_push_front (&entries, &e->elem);
+          image = e->image;
+          image->ref_cnt++;
+        }
+      break;
+    }
+  lock_release (&elfcache_lock);
+  return image;
+}
+
+/* Caches IMAGE, parsed from INODE when inode_write_cnt() returned
+   WRITE_CNT, taking a reference of its own, unless memory is
+   short, in which case caching is skipped.  The count is taken
+   before parsing, so that a write during the parse makes the
+   entry stale.  The least recently used entry goes if the cache
+   is full. */
+void
+elfcache_insert (struct inode *inode, unsigned write_cnt,
+                 struct elf_image *image)
+{
+  struct elfcache_entry *e = malloc (sizeof *e);
+  struct list_elem *le, *next;
+
+  if (e == NULL)
+    return;
+  e->inode = inode_reopen (inode);
+  e->write_cnt = write_cnt;
+  e->image = image;
+
+  lock_acquire (&elfcache_lock);
+  for (le = list_begin (&entries); le != list_end (&entries); le = next)
+    {
+      struct elfcache_entry *old = list_entry (le, struct elfcache_entry,
+                                               elem);
+      next = list_next (le);
+      if (old->inode == inode || inode_is_removed (old->inode))
+        entry_free (old);
+    }
+  if (entry_cnt >= ELFCACHE_SIZE)
+    entry_free (list_entry (list_back (&entries), struct elfcache_entry,
+                            elem));
+  image->ref_cnt++;
+  list_push_front (&entries, &e->elem);
+  entry_cnt++;
+  lock_release (&elfcache_lock);
+}
@@ -0,0 +1,40 @@
+#ifndef USERPROG_ELFCACHE_H
+#define USERPROG_ELFCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct inode;
+
+/* A loadable segment of an executable, checked and laid out in
+   pages the way load_segment() takes it. */
+struct elf_segment
+  {
+    uint32_t file_page;                 /* Page-aligned file offset. */
+    uint32_t mem_page;                  /* User page it starts at. */
+    uint32_t read_bytes;                /* Bytes to read from the file. */
+    uint32_t zero_bytes;                /* Zeroed bytes after those. */
+    bool writable;                      /* Writable by the process? */
+  };
+
+/* What load() needs of an executable's ELF headers. */
+struct elf_image
+  {
+    int ref_cnt;                        /* Users, the cache included. */
+    void (*entry) (void);               /* Entry point. */
+    uint32_t seg_end;                   /* End of the highest segment. */
+    size_t seg_cnt;                     /* Elements in segs. */
+    struct elf_segment segs[];          /* Loadable segments, in file
+                                           order. */
+  };
+
+struct elf_image *elf_image_create (size_t seg_cnt);
+void elf_image_release (struct elf_image *);
+
+void elfcache_init (void);
+struct elf_image *elfcache_lookup (struct inode *);
+void elfcache_insert (struct inode *, unsigned write_cnt,
+                      struct elf_image *);
+
+#endif /* userprog/elfcache.h */
@@ -1,16 +1,51 @@
 #include <inttypes.h>
+#include <rusage.h>
+#include <stats.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
+#include "threads/percpu.h"
 #include "threads/thread.h"
+#include "threads/tsc.h"
+#include "threads/vaddr.h"
 #include "userprog/exception.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
 #include "userprog/syscall.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
-static long long page_fault_cnt;
+static struct percpu_counter page_fault_cnt;
+
+/* Page faults by enum fault_type, and how many cycles each took,
+   in buckets that double from 2**FAULT_SHIFT cycles. */
+#define FAULT_BUCKETS 16
+#define FAULT_SHIFT 10
+static struct percpu_counter fault_cnt[FAULT_CNT];
+static unsigned fault_hist[FAULT_CNT][FAULT_BUCKETS];
+static const char *fault_names[FAULT_CNT] =
+  {"minor", "major", "cow", "stack", "invalid"};
 
 static void kill (struct intr_frame *);
+static void fpu_unavailable (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static void count_fault (enum fault_type, uint64_t start);
+
+/* A kernel instruction that accesses user memory and may fault,
+   from get_user() or put_user() in syscall.c or get_user_int() in
+   futex.c, and where to resume if it does.  The linker gathers
+   these into one table. */
+struct user_fixup
+  {
+    uintptr_t insn;             /* Address of the access. */
+    uintptr_t resume;           /* Address to resume at. */
+  };
+extern const struct user_fixup _start_user_fixup[], _end_user_fixup[];
+
+static const struct user_fixup *find_user_fixup (uintptr_t eip);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -30,6 +65,16 @@ static void page_fault (struct intr_frame *);
 void
 exception_init (void) 
 {
+  int i;
+
+  stats_add_percpu ("exception", NULL, "page_faults", &page_fault_cnt);
+  for (i = 0; i < FAULT_CNT; i++)
+    {
+      stats_add_percpu ("fault", fault_names[i], "count", &fault_cnt[i]);
+      stats_add_hist ("fault", fault_names[i], "cycles", fault_hist[i],
+                      FAULT_BUCKETS, FAULT_SHIFT);
+    }
+
   /* These exceptions can be raised explicitly by a user program,
      e.g. via the INT, INT3, INTO, and BOUND instructions.  Thus,
      we set DPL==3, meaning that user programs are allowed to
@@ -46,7 +91,7 @@ exception_init (void)
   intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
   intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
   intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-  intr_register_int (7, 0, INTR_ON, kill,
+  intr_register_int (7, 0, INTR_ON, fpu_unavailable,
                      "#NM Device Not Available Exception");
   intr_register_int (11, 0, INTR_ON, kill, "#NP Segment Not Present");
   intr_register_int (12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
@@ -65,7 +110,7 @@ exception_init (void)
 void
 exception_print_stats (void) 
 {
-  printf ("Exception: %lld page faults\n", page_fault_cnt);
+  printf ("Exception: %lld page faults\n", percpu_sum (&page_fault_cnt));
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -109,6 +154,16 @@ kill (struct intr_frame *f)
     }
 }
 
+/* Device-not-available handler.  The running thread used the
+   FPU while another thread's FPU state was loaded, or for the
+   first time; see threads/fpu.c. */
+static void
+fpu_unavailable (struct intr_frame *f) 
+{
+  if (!fpu_claim ())
+    kill (f);
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
@@ -127,6 +182,8 @@ page_fault (struct intr_frame *f)
   bool write;        /* True: access was write, false: access was read. */
   bool user;         /* True: access by user, false: access by kernel. */
   void *fault_addr;  /* Fault address. */
+  uint64_t start = rdtsc ();
+  struct thread *t;
 
   /* Obtain faulting address, the virtual address that was
      accessed to cause the fault.  It may point to code or to
@@ -142,13 +199,75 @@ page_fault (struct intr_frame *f)
   intr_enable ();
 
   /* Count page faults. */
-  page_fault_cnt++;
+  t = thread_current ();
+  percpu_inc (&page_fault_cnt);
+  t->page_faults++;
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  if (is_user_vaddr (fault_addr) && t->process != NULL)
+    {
+      unsigned switches = t->voluntary_switches;
+
+      /* Another thread of the process brought the page in after
+         this one faulted on it.  The page directory can be read
+         without the process's lock, unlike its supplemental page
+         table, whose hash table may be rehashing under it. */
+      if (not_present
+          && pagedir_get_page (t->process->pagedir, fault_addr) != NULL)
+        {
+          count_fault (FAULT_MINOR, start);
+          return;
+        }
+
+      /* Bring in a user page that has not been loaded yet, or
+         grow the stack down to FAULT_ADDR.  This also covers the
+         kernel touching user memory on a process's behalf, in
+         which case F holds the kernel's stack pointer and the
+         user's was saved on entry to the system call. */
+      if (not_present && page_in (fault_addr, write))
+        {
+          count_fault (t->voluntary_switches != switches
+                       ? FAULT_MAJOR : FAULT_MINOR, start);
+          return;
+        }
+      if (not_present
+          && page_grow_stack (fault_addr, user ? f->esp : t->user_esp))
+        {
+          count_fault (FAULT_STACK, start);
+          return;
+        }
+
+      /* Copy a page shared copy-on-write since a fork. */
+      if (!not_present && write && page_unshare (fault_addr))
+        {
+          count_fault (FAULT_COW, start);
+          return;
+        }
+    }
+#endif
+  count_fault (FAULT_INVALID, start);
+
+  /* The kernel faulted on a user address in get_user() or
+     put_user(), which take -1 in eax to mean the access failed.
+     A fault anywhere else, e.g. in a copy to a buffer that another
+     thread unmapped after it was checked, kills the process. */
+  if (!user && is_user_vaddr (fault_addr))
+    {
+      const struct user_fixup *fixup
+        = find_user_fixup ((uintptr_t) f->eip);
+      if (fixup != NULL)
+        {
+          f->eip = (void (*) (void)) fixup->resume;
+          f->eax = 0xffffffff;
+          return;
+        }
+    }
+
    // Elta7an instruction
    sys_exit(-1);
 
@@ -161,4 +280,32 @@ page_fault (struct intr_frame *f)
           write ? "writing" : "reading",
           user ? "user" : "kernel");
   kill (f);
-}
\ No newline at end of file
+}
+
+/* Returns the fixup for the user access at EIP, or a null
+   pointer if EIP is not one. */
+static const struct user_fixup *
+find_user_fixup (uintptr_t eip)
+{
+  const struct user_fixup *fixup;
+
+  for (fixup = _start_user_fixup; fixup < _end_user_fixup; fixup++)
+    if (fixup->insn == eip)
+      return fixup;
+  return NULL;
+}
+
+/* Counts a page fault of TYPE, which began at time-stamp START,
+   for the current thread and in the statistics registry. */
+static void
+count_fault (enum fault_type type, uint64_t start)
+{
+  uint64_t cycles = rdtsc () - start;
+  int bucket = 0;
+
+  while (bucket < FAULT_BUCKETS - 1 && cycles >> (FAULT_SHIFT + bucket) != 0)
+    bucket++;
+  fault_hist[type][bucket]++;
+  percpu_inc (&fault_cnt[type]);
+  thread_current ()->faults[type]++;
+}
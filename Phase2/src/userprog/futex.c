@@ -0,0 +1,214 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <limits.h>
+#include <list.h>
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+
+/* The threads waiting on one user word.  A word is named by the
+   page directory of the process it is in and its user address,
+   so that the same address in two processes is two futexes.  A
+   queue exists only while some thread waits on it. */
+struct futex
+  {
+    struct hash_elem elem;              /* In futexes. */
+    uint32_t *pd;                       /* Address space. */
+    int *uaddr;                         /* User address of the word. */
+    struct list waiters;                /* struct futex_waiter, FIFO. */
+  };
+
+/* A thread blocked in futex_wait(). */
+struct futex_waiter
+  {
+    struct list_elem elem;              /* In its futex's waiters. */
+    struct semaphore sema;              /* Upped to wake it. */
+  };
+
+/* Futexes with waiters, by address space and address. */
+static struct hash futexes;
+
+/* Protects futexes and every queue on it. */
+static struct lock futex_lock;
+
+/* Returns a hash value for futex E. */
+static unsigned
+futex_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct futex *f = hash_entry (e, struct futex, elem);
+  return hash_bytes (&f->pd, sizeof f->pd) ^ hash_bytes (&f->uaddr,
+                                                         sizeof f->uaddr);
+}
+
+/* Returns true if futex A's key precedes B's. */
+static bool
+futex_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct futex *a = hash_entry (a_, struct futex, elem);
+  const struct futex *b = hash_entry (b_, struct futex, elem);
+
+  if (a->pd != b->pd)
+    return a->pd < b->pd;
+  return a->uaddr < b->uaddr;
+}
+
+/* Initializes the table of futexes. */
+void
+futex_init (void)
+{
+  if (!hash_init (&futexes, futex_hash, futex_less, NULL))
+    PANIC ("futex_init: out of memory");
+  lock_init_named (&futex_lock, "futex");
+}
+
+/* Returns the current process's futex at UADDR, or a null
+   pointer if no thread waits there.  futex_lock must be held. */
+static struct futex *
+futex_find (int *uaddr)
+{
+  struct futex key;
+  struct hash_elem *e;
+
+  key.pd = thread_current ()->process->pagedir;
+  key.uaddr = uaddr;
+  e = hash_find (&futexes, &key.elem);
+  return e != NULL ? hash_entry (e, struct futex, elem) : NULL;
+}
+
+/* Wakes up to CNT of the threads waiting on F, oldest first, and
+   frees F if that leaves it without waiters.  Returns the number
+   woken.  futex_lock must be held. */
+static int
+futex_wake_queue (struct futex *f, int cnt)
+{
+  int woken = 0;
+
+  while (woken < cnt && !list_empty (&f->waiters))
+    {
+      struct futex_waiter *w = list_entry (list_pop_front (&f->waiters),
+                                           struct futex_waiter, elem);
+      sema_up (&w->sema);
+      woken++;
+    }
+  if (list_empty (&f->waiters))
+    {
+      hash_delete (&futexes, &f->elem);
+      free (f);
+    }
+  return woken;
+}
+
+/* Reads the int at user address UADDR into *VAL.  Returns false,
+   instead of killing the process, if the read faults, say because
+   another thread unmapped the page: page_fault() finds the load
+   in the .user_fixup table, as for get_user() in syscall.c, and
+   resumes after it with -1 in eax. */
+static bool
+get_user_int (const int *uaddr, int *val)
+{
+  int status, word;
+
+  asm volatile ("movl $0, %0\n"
+                "1: movl %2, %1; 2:\n"
+                ".pushsection .user_fixup, \"a\"\n"
+                ".long 1b, 2b\n"
+                ".popsection"
+                : "=&a" (status), "=&r" (word)
+                : "m" (*uaddr));
+  *val = word;
+  return status != -1;
+}
+
+/* Blocks the current thread until another thread of its process
+   calls futex_wake() on UADDR, provided the int there still holds
+   VAL, which is tested under the lock futex_wake() takes, so a
+   wakeup between the caller's own test and this call is not lost.
+   UADDR must be an aligned user address.  Returns 0 after a
+   wakeup, or -1 at once if the word has changed or cannot be
+   read, memory is short or the process is exiting. */
+int
+futex_wait (int *uaddr, int val)
+{
+  struct process *proc = thread_current ()->process;
+  struct futex_waiter w;
+  struct futex *f;
+  int word;
+
+  lock_acquire (&futex_lock);
+  if (!is_user_vaddr (uaddr) || !get_user_int (uaddr, &word)
+      || word != val || proc->exiting)
+    {
+      lock_release (&futex_lock);
+      return -1;
+    }
+  f = futex_find (uaddr);
+  if (f == NULL)
+    {
+      f = malloc (sizeof *f);
+      if (f == NULL)
+        {
+          lock_release (&futex_lock);
+          return -1;
+        }
+      f->pd = proc->pagedir;
+      f->uaddr = uaddr;
+      list_init (&f->waiters);
+      hash_insert (&futexes, &f->elem);
+    }
+  sema_init (&w.sema, 0);
+  list_push_back (&f->waiters, &w.elem);
+  lock_release (&futex_lock);
+
+  sema_down (&w.sema);
+  return 0;
+}
+
+/* Wakes up to CNT threads of the current process waiting in
+   futex_wait() on UADDR.  Returns the number woken. */
+int
+futex_wake (int *uaddr, int cnt)
+{
+  struct futex *f;
+  int woken = 0;
+
+  lock_acquire (&futex_lock);
+  f = futex_find (uaddr);
+  if (f != NULL && cnt > 0)
+    woken = futex_wake_queue (f, cnt);
+  lock_release (&futex_lock);
+  return woken;
+}
+
+/* Wakes every thread waiting on a futex in address space PD, as
+   when their process starts exiting, so that they see it and
+   die.  Threads that call futex_wait() later see it there. */
+void
+futex_wake_all (uint32_t *pd)
+{
+  struct hash_iterator i;
+  bool found;
+
+  lock_acquire (&futex_lock);
+  do
+    {
+      found = false;
+      hash_first (&i, &futexes);
+      while (hash_next (&i))
+        {
+          struct futex *f = hash_entry (hash_cur (&i), struct futex, elem);
+          if (f->pd == pd)
+            {
+              /* Frees F, which ends the iteration. */
+              futex_wake_queue (f, INT_MAX);
+              found = true;
+              break;
+            }
+        }
+    }
+  while (found);
+  lock_release (&futex_lock);
+}
@@ -3,12 +3,40 @@
 #include <stddef.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
+#include "threads/thread.h"
 #include "threads/palloc.h"
+#include "userprog/share.h"
 
 static uint32_t *active_pd (void);
+
+/* The page directory last loaded by load_pagedir(), or a null
+   pointer until active_pd() first reads CR3.  The kernel keeps this
+   copy so that thread switches need not read CR3 back, which costs
+   more than a load and traps under some hypervisors. */
+static uint32_t *loaded_pd;
+static void load_pagedir (uint32_t *);
 static void invalidate_pagedir (uint32_t *);
 
+/* True if a batch (see pagedir_batch_begin()) has changed the
+   active page directory without flushing the TLB since. */
+static bool tlb_stale;
+
+/* Most page directories kept for reuse. */
+#define PD_CACHE_MAX 8
+
+/* Page directories freed by pagedir_destroy(), with their user
+   halves already cleared and their kernel halves still copied
+   from init_page_dir, ready for pagedir_create() to hand out as
+   they are.  The kernel half of init_page_dir does not change
+   once paging_init() has built it, so these never go stale.
+   Accessed with interrupts off. */
+static uint32_t *pd_cache[PD_CACHE_MAX];
+static size_t pd_cache_cnt;
+
+static void free_pt (uint32_t *pt, size_t used_start, size_t used_end);
+
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
    Returns the new page directory, or a null pointer if memory
@@ -16,17 +44,34 @@ static void invalidate_pagedir (uint32_t *);
 uint32_t *
 pagedir_create (void) 
 {
-  uint32_t *pd = palloc_get_page (0);
+  enum intr_level old_level;
+  uint32_t *pd = NULL;
+
+  old_level = intr_disable ();
+  if (pd_cache_cnt > 0)
+    pd = pd_cache[--pd_cache_cnt];
+  intr_set_level (old_level);
   if (pd != NULL)
-    memcpy (pd, init_page_dir, PGSIZE);
+    return pd;
+
+  /* Only the kernel half needs copying into a zeroed page, which
+     palloc usually has on hand already. */
+  pd = palloc_get_page (PAL_ZERO);
+  if (pd != NULL)
+    memcpy (pd + pd_no (PHYS_BASE), init_page_dir + pd_no (PHYS_BASE),
+            PGSIZE - pd_no (PHYS_BASE) * sizeof *pd);
   return pd;
 }
 
 /* Destroys page directory PD, freeing all the pages it
-   references. */
+   references.  Shared pages are released instead, and freed only
+   by the last page directory that maps them.  Page tables and PD
+   itself are cleared as they are taken apart and kept for reuse,
+   so that the next address space need not zero them again. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
+  enum intr_level old_level;
   uint32_t *pde;
 
   if (pd == NULL)
@@ -34,17 +79,73 @@ pagedir_destroy (uint32_t *pd)
 
   ASSERT (pd != init_page_dir);
   for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
+    if ((*pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+      {
+        palloc_free_multiple (ptov (*pde & ~(PTSPAN - 1)), PTSPAN / PGSIZE);
+        *pde = 0;
+      }
+    else if (*pde & PTE_P) 
       {
         uint32_t *pt = pde_get_pt (*pde);
-        uint32_t *pte;
-        
-        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-          if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
-        palloc_free_page (pt);
+        void **pages = (void **) pt;
+        size_t page_cnt = 0;
+        size_t used_start = PGSIZE / sizeof *pt;
+        size_t used_end = 0;
+        size_t i;
+
+        /* Gather the frames to free into the page table itself,
+           which has room, and free them in one batch.  Note the
+           span of entries in use, which is all that needs clearing
+           afterward. */
+        for (i = 0; i < PGSIZE / sizeof *pt; i++)
+          {
+            uint32_t pte = pt[i];
+
+            if (pte == 0)
+              continue;
+            if (used_start > i)
+              used_start = i;
+            used_end = i + 1;
+            if ((pte & (PTE_P | PTE_SHARED)) == (PTE_P | PTE_SHARED))
+              share_release (pte_get_page (pte));
+            else if (pte & PTE_P) 
+              pages[page_cnt++] = pte_get_page (pte);
+          }
+        palloc_free_pages (pages, page_cnt);
+        free_pt (pt, page_cnt > 0 ? 0 : used_start, used_end);
+        *pde = 0;
+
+        /* A large address space takes a while to tear down. */
+        cond_resched ();
       }
-  palloc_free_page (pd);
+
+  old_level = intr_disable ();
+  if (pd_cache_cnt < PD_CACHE_MAX)
+    {
+      pd_cache[pd_cache_cnt++] = pd;
+      pd = NULL;
+    }
+  intr_set_level (old_level);
+  if (pd != NULL)
+    {
+      memset (pd + pd_no (PHYS_BASE), 0,
+              PGSIZE - pd_no (PHYS_BASE) * sizeof *pd);
+      palloc_free_zeroed (pd);
+    }
+}
+
+/* Frees page table PT, whose entries other than those from
+   USED_START up to USED_END are already zero, by clearing those
+   and handing it back to palloc as a pre-zeroed page.  A process
+   touches few of the entries in most of its page tables, so this
+   is much cheaper than clearing the whole page when it is next
+   allocated. */
+static void
+free_pt (uint32_t *pt, size_t used_start, size_t used_end)
+{
+  if (used_start < used_end)
+    memset (pt + used_start, 0, (used_end - used_start) * sizeof *pt);
+  palloc_free_zeroed (pt);
 }
 
 /* Returns the address of the page table entry for virtual
@@ -52,7 +153,8 @@ pagedir_destroy (uint32_t *pd)
    If PD does not have a page table for VADDR, behavior depends
    on CREATE.  If CREATE is true, then a new page table is
    created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+   pointer is returned.  A 4 MB page has no page table entries, so
+   a null pointer is also returned for VADDR within one. */
 static uint32_t *
 lookup_page (uint32_t *pd, const void *vaddr, bool create)
 {
@@ -79,6 +181,8 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
       else
         return NULL;
     }
+  else if (*pde & PTE_PS)
+    return NULL;
 
   /* Return the page table entry. */
   pt = pde_get_pt (*pde);
@@ -118,6 +222,76 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
     return false;
 }
 
+/* Adds a mapping in page directory PD from user virtual page
+   UPAGE to KPAGE, a frame obtained from share_acquire() or
+   share_alloc(), writable only if WRITABLE is true.
+   pagedir_destroy() hands the frame back with share_release().
+   UPAGE must not already be mapped.  Returns true if successful,
+   false if memory allocation failed. */
+bool
+pagedir_set_shared_page (uint32_t *pd, void *upage, void *kpage,
+                         bool writable)
+{
+  if (!pagedir_set_page (pd, upage, kpage, writable))
+    return false;
+  *lookup_page (pd, upage, false) |= PTE_SHARED;
+  return true;
+}
+
+/* Gives DST, a page directory with no user mappings, a copy of
+   every user mapping in SRC.  Shared pages are mapped again, each
+   with another reference; every other page is copied into a new
+   frame from the user pool.  Returns false if memory runs out,
+   leaving in DST the mappings made so far for pagedir_destroy()
+   to free. */
+bool
+pagedir_copy (uint32_t *dst, uint32_t *src)
+{
+  uint32_t *pde;
+
+  ASSERT (dst != init_page_dir && src != init_page_dir);
+
+  for (pde = src; pde < src + pd_no (PHYS_BASE); pde++)
+    if (*pde & PTE_P)
+      {
+        uint32_t *pt = pde_get_pt (*pde);
+        size_t i;
+
+        for (i = 0; i < PGSIZE / sizeof *pt; i++)
+          {
+            void *upage = (void *) (((uintptr_t) (pde - src) << PDSHIFT)
+                                    | (i << PTSHIFT));
+            void *kpage;
+
+            if ((pt[i] & PTE_P) == 0)
+              continue;
+            kpage = pte_get_page (pt[i]);
+            if (pt[i] & PTE_SHARED)
+              {
+                if (!pagedir_set_shared_page (dst, upage, kpage,
+                                              (pt[i] & PTE_W) != 0))
+                  return false;
+                share_reference (kpage);
+              }
+            else
+              {
+                void *copy = palloc_get_page (PAL_USER);
+
+                if (copy == NULL)
+                  return false;
+                memcpy (copy, kpage, PGSIZE);
+                if (!pagedir_set_page (dst, upage, copy,
+                                       (pt[i] & PTE_W) != 0))
+                  {
+                    palloc_free_page (copy);
+                    return false;
+                  }
+              }
+          }
+      }
+  return true;
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
@@ -126,9 +300,15 @@ void *
 pagedir_get_page (uint32_t *pd, const void *uaddr) 
 {
   uint32_t *pte;
+  uint32_t pde;
 
   ASSERT (is_user_vaddr (uaddr));
-  
+
+  pde = pd[pd_no (uaddr)];
+  if ((pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+    return (uint8_t *) ptov (pde & ~(PTSPAN - 1))
+           + ((uintptr_t) uaddr & (PTSPAN - 1));
+
   pte = lookup_page (pd, uaddr, false);
   if (pte != NULL && (*pte & PTE_P) != 0)
     return pte_get_page (*pte) + pg_ofs (uaddr);
@@ -136,6 +316,57 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
     return NULL;
 }
 
+/* Returns true if PD maps nothing at all in the 4 MB of user
+   virtual memory, aligned, that contain UADDR: no page there has
+   ever been mapped, so it does not even have a page table. */
+bool
+pagedir_region_is_empty (uint32_t *pd, const void *uaddr)
+{
+  ASSERT (is_user_vaddr (uaddr));
+  return pd[pd_no (uaddr)] == 0;
+}
+
+/* Maps the 4 MB of user virtual memory starting at UPAGE, which
+   must be aligned and empty as pagedir_region_is_empty() says,
+   to the 4 MB of physically contiguous memory starting at KPAGE,
+   also aligned, read/write, with a single 4 MB page.  Only valid
+   if init_large_pages is true. */
+void
+pagedir_set_huge_page (uint32_t *pd, void *upage, void *kpage)
+{
+  uint32_t *pde = pd + pd_no (upage);
+
+  ASSERT (init_large_pages);
+  ASSERT ((uintptr_t) upage % PTSPAN == 0);
+  ASSERT (vtop (kpage) % PTSPAN == 0);
+  ASSERT (is_user_vaddr (upage));
+  ASSERT (*pde == 0);
+
+  *pde = vtop (kpage) | PTE_PS | PTE_U | PTE_P | PTE_W;
+}
+
+/* Replaces the 4 MB page that PD maps at UPAGE with page table
+   PT, a page from the kernel pool whose contents are overwritten,
+   so that each 4 kB page of it can be handled, and freed, on its
+   own.  The pages map the same memory as before, with the 4 MB
+   page's accessed and dirty bits. */
+void
+pagedir_split_huge_page (uint32_t *pd, const void *upage, uint32_t *pt)
+{
+  uint32_t *pde = pd + pd_no (upage);
+  uint32_t flags = *pde & (PTE_U | PTE_P | PTE_W | PTE_A | PTE_D);
+  uint32_t paddr = *pde & ~(PTSPAN - 1);
+  size_t i;
+
+  ASSERT ((*pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS));
+  ASSERT (pg_ofs (pt) == 0);
+
+  for (i = 0; i < PGSIZE / sizeof *pt; i++)
+    pt[i] = (paddr + i * PGSIZE) | flags;
+  *pde = pde_create (pt);
+  invalidate_pagedir (pd);
+}
+
 /* Marks user virtual page UPAGE "not present" in page
    directory PD.  Later accesses to the page will fault.  Other
    bits in the page table entry are preserved.
@@ -156,6 +387,38 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Points the mapping of user virtual page UPAGE in PD, which must
+   be present, at KPAGE instead, keeping its permissions and its
+   accessed and dirty bits. */
+void
+pagedir_move_page (uint32_t *pd, const void *upage, void *kpage)
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+
+  ASSERT (pg_ofs (kpage) == 0);
+  ASSERT (pte != NULL && (*pte & PTE_P) != 0);
+
+  *pte = (*pte & PTE_FLAGS) | vtop (kpage);
+  invalidate_pagedir (pd);
+}
+
+/* Makes the mapping of user virtual page UPAGE in PD writable if
+   WRITABLE is true, read-only otherwise.  UPAGE need not be
+   mapped. */
+void
+pagedir_set_writable (uint32_t *pd, const void *upage, bool writable)
+{
+  uint32_t *pte = lookup_page (pd, upage, false);
+  if (pte != NULL)
+    {
+      if (writable)
+        *pte |= PTE_W;
+      else
+        *pte &= ~(uint32_t) PTE_W;
+      invalidate_pagedir (pd);
+    }
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -222,12 +485,52 @@ pagedir_activate (uint32_t *pd)
   if (pd == NULL)
     pd = init_page_dir;
 
+  /* Loading CR3 flushes the TLB, so don't if PD is already
+     active, unless a batch left stale entries behind that the
+     thread we are switching to could use. */
+  if (active_pd () != pd || tlb_stale)
+    load_pagedir (pd);
+}
+
+/* Starts a batch of page table changes by the running thread.
+   Until the matching pagedir_batch_end(), changes to the active
+   page directory do not reload CR3 one by one; the outermost
+   pagedir_batch_end() reloads it once for all of them.  Until
+   then the TLB may hold stale entries for the pages changed, so
+   the caller must not touch those user pages itself.  Switching
+   to another thread flushes them (see pagedir_activate()), so a
+   batch may sleep.  Batches nest. */
+void
+pagedir_batch_begin (void) 
+{
+  thread_current ()->tlb_batch_depth++;
+}
+
+/* Ends a batch started by pagedir_batch_begin(), flushing the
+   TLB if it is the outermost one and left entries stale. */
+void
+pagedir_batch_end (void) 
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->tlb_batch_depth > 0);
+  if (--t->tlb_batch_depth == 0 && tlb_stale)
+    load_pagedir (active_pd ());
+}
+
+/* Loads PD into the CPU, which also flushes the TLB of all but
+   global entries. */
+static void
+load_pagedir (uint32_t *pd)
+{
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base
      Address of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
+  loaded_pd = pd;
+  tlb_stale = false;
 }
 
 /* Returns the currently active page directory. */
@@ -235,12 +538,16 @@ static uint32_t *
 active_pd (void) 
 {
   /* Copy CR3, the page directory base register (PDBR), into
-     `pd'.
+     `pd' the first time.
      See [IA32-v2a] "MOV--Move to/from Control Registers" and
      [IA32-v3a] 3.7.5 "Base Address of the Page Directory". */
-  uintptr_t pd;
-  asm volatile ("movl %%cr3, %0" : "=r" (pd));
-  return ptov (pd);
+  if (loaded_pd == NULL)
+    {
+      uintptr_t pd;
+      asm volatile ("movl %%cr3, %0" : "=r" (pd));
+      loaded_pd = ptov (pd);
+    }
+  return loaded_pd;
 }
 
 /* Seom page table changes can cause the CPU's translation
@@ -249,15 +556,22 @@ active_pd (void)
    re-activating it.
 
    This function invalidates the TLB if PD is the active page
-   directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   directory, or leaves that to the end of the running thread's
+   batch (see pagedir_batch_begin()).  (If PD is not active then
+   its entries are not in the TLB, so there is no need to
+   invalidate anything.) */
 static void
 invalidate_pagedir (uint32_t *pd) 
 {
   if (active_pd () == pd) 
     {
-      /* Re-activating PD clears the TLB.  See [IA32-v3a] 3.12
-         "Translation Lookaside Buffers (TLBs)". */
-      pagedir_activate (pd);
+      if (thread_current ()->tlb_batch_depth > 0)
+        tlb_stale = true;
+      else
+        {
+          /* Reloading PD clears the TLB.  See [IA32-v3a] 3.12
+             "Translation Lookaside Buffers (TLBs)". */
+          load_pagedir (pd);
+        }
     } 
 }
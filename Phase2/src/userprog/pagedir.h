@@ -7,12 +7,23 @@
 uint32_t *pagedir_create (void);
 void pagedir_destroy (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
+bool pagedir_set_shared_page (uint32_t *pd, void *upage, void *kpage,
+                              bool writable);
+bool pagedir_copy (uint32_t *dst, uint32_t *src);
 void *pagedir_get_page (uint32_t *pd, const void *upage);
+bool pagedir_region_is_empty (uint32_t *pd, const void *uaddr);
+void pagedir_set_huge_page (uint32_t *pd, void *upage, void *kpage);
+void pagedir_split_huge_page (uint32_t *pd, const void *upage,
+                              uint32_t *pt);
 void pagedir_clear_page (uint32_t *pd, void *upage);
+void pagedir_move_page (uint32_t *pd, const void *upage, void *kpage);
+void pagedir_set_writable (uint32_t *pd, const void *upage, bool writable);
 bool pagedir_is_dirty (uint32_t *pd, const void *upage);
 void pagedir_set_dirty (uint32_t *pd, const void *upage, bool dirty);
 bool pagedir_is_accessed (uint32_t *pd, const void *upage);
 void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
 void pagedir_activate (uint32_t *pd);
+void pagedir_batch_begin (void);
+void pagedir_batch_end (void);
 
 #endif /* userprog/pagedir.h */
@@ -1,71 +1,470 @@
+#include <clock.h>
 #include <debug.h>
 #include <inttypes.h>
 #include <round.h>
+#include <spawn.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
+#include "devices/clock.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "userprog/syscall.h"
 #include "userprog/process.h"
+#include "userprog/share.h"
+#include "userprog/aio.h"
+#include "userprog/elfcache.h"
+#include "userprog/futex.h"
+#include "userprog/shm.h"
+#include "userprog/upcall.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/checkpoint.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+
+/* A file a new process starts with, and its fd there. */
+struct exec_file
+{
+  int fd;
+  struct file *file;
+};
+
+// Most files a new process starts with: stdin, stdout and what
+// spawn_fds() adds
+#define EXEC_FILES_MAX (2 + SPAWN_FDS_MAX)
+
+/* What a new process is started with, packed into one page: the
+   argc strings of its argv back to back, each null-terminated,
+   and the name of the file to load, which may be argv[0]. */
+struct exec_args
+{
+  struct child_record *record; // The child's, shared with the parent
+  bool spawned;     // From process_spawn(), so the parent is not waiting
+  bool restore;     // file is a checkpoint() image, not an executable
+  int argc;
+  size_t len;       // Bytes of strings taken up by argv
+  const char *file; // File to load, somewhere in this page
+  int file_cnt;     // Entries of files in use
+  struct exec_file files[EXEC_FILES_MAX]; // The parent's, to start with
+  struct dir *cwd;     // The parent's working directory
+  unsigned limits[RLIMIT_CNT]; // The parent's resource limits
+  char strings[];
+};
+
+// Bytes of strings an exec_args page holds
+#define EXEC_ARGS_MAX (PGSIZE - offsetof(struct exec_args, strings))
+
+/* What a process's parent learns of it.  Held by both until the
+   parent waits for it; whichever of the two lets go last frees
+   it.  So a child that exits first leaves its status behind, and
+   a parent that exits without waiting leaves nothing behind. */
+struct child_record
+{
+  tid_t tid;
+  int exit_status;
+  int load_status;            // 0 loading, 1 loaded, -1 failed
+  bool exited;
+  struct thread *thread;      // The child once started until it exits
+  int ref_cnt;                // 2 while both parent and child hold it
+  struct hash_elem elem;      // In the parent's children
+  struct list_elem exit_elem; // In the parent's exited_children once exited
+};
+
+/* What fork_process() is started with. */
+struct fork_args
+{
+  struct intr_frame *f;
+  struct child_record *record;
+};
+
+/* A thread of a user process other than its main thread, as
+   thread_join() knows it.  Held in its process's threads until
+   joined, or until the process exits. */
+struct user_thread
+{
+  tid_t tid;
+  int slot;                // Its stack slot in the process
+  bool exited;
+  bool joining;            // Another thread is in thread_join() on it
+  struct process *process; // The process it runs in
+  void (*eip)(void);       // Where it enters user mode
+  void *esp;               // and with what stack pointer
+  struct list_elem elem;   // In its process's threads
+};
+
+/* Pages of stack a thread_spawn()ed thread gets, in slot N, below
+   the main thread's stack and the next slot up.  Under VM they are
+   only reserved, and brought in when touched. */
+#ifdef VM
+#define THREAD_STACK_PAGES 64
+#define THREAD_STACKS_TOP ((uint8_t *)PHYS_BASE - page_stack_limit)
+#else
+#define THREAD_STACK_PAGES 1
+#define THREAD_STACKS_TOP ((uint8_t *)PHYS_BASE - PGSIZE)
+#endif
+
+// Guards every child_record, and every thread's children,
+// exited_children and child_exited
+static struct lock wait_lock;
 
 static thread_func start_process NO_RETURN;
-static bool load(const char *cmdline, void (**eip)(void), void **esp);
-struct thread *find_child(tid_t tid);
+static thread_func fork_process NO_RETURN;
+static bool fork_address_space(struct thread *parent);
+static bool map_clock_page(void);
+static struct exec_args *split_cmd_line(const char *cmd_line);
+static tid_t execute(struct exec_args *args, bool spawned,
+                     const struct spawn_fd *fds, int fd_cnt);
+static bool load(const struct exec_args *args, void (**eip)(void), void **esp);
+#ifdef VM
+static bool load_checkpoint(const struct exec_args *args,
+                            struct intr_frame *if_);
+static bool exec_args_restore_fds(struct exec_args *args);
+#endif
+static bool push_stack_arguments(const struct exec_args *args, void **esp);
+static struct child_record *child_create(void);
+static tid_t child_start(struct child_record *rec, thread_func *func, void *aux,
+                         const char *name);
+static struct child_record *child_find(tid_t tid);
+static void child_attach(struct child_record *);
+static void child_forget(struct child_record *rec);
+static hash_action_func child_drop;
+static bool process_create(void);
+static void threads_reap(struct process *proc);
+static void thread_leave(struct process *proc);
+static thread_func start_user_thread NO_RETURN;
+#ifndef VM
+static bool install_page(void *upage, void *kpage, bool writable);
+#endif
 
-/* Starts a new thread running a user program loaded from
-   FILENAME.  The new thread may be scheduled (and may even exit)
+void process_init(void)
+{
+  lock_init_named(&wait_lock, "wait");
+}
+
+/* Starts a new thread running a user program loaded from the
+   first word of CMD_LINE, with the words of CMD_LINE as its
+   arguments.  The new thread may be scheduled (and may even exit)
    before process_execute() returns.  Returns the new process's
    thread id, or TID_ERROR if the thread cannot be created. */
-tid_t process_execute(const char *file_name)
+tid_t process_execute(const char *cmd_line)
 {
-  char *fn_copy;
-  tid_t tid;
-  char *bufferpointer1;
-  /* Make a copy of FILE_NAME.
+  struct exec_args *args = split_cmd_line(cmd_line);
+  if (args == NULL)
+    return TID_ERROR;
+  return execute(args, false, NULL, 0);
+}
+
+/* Like process_execute(), but returns as soon as the new thread
+   exists instead of waiting for it to load, so that several
+   children can load at once.  Whether it loaded can be polled
+   with process_spawn_status(); a child that failed to load
+   reports -1 to process_wait(). */
+tid_t process_spawn(const char *cmd_line)
+{
+  struct exec_args *args = split_cmd_line(cmd_line);
+  if (args == NULL)
+    return TID_ERROR;
+  return execute(args, true, NULL, 0);
+}
+
+/* Like process_spawn(), but the new process also starts with the
+   CNT files that FDS maps from the current process's fds, so that
+   a shell can start each command of a pipeline on its pipes
+   without pointing its own stdin and stdout at them first.
+   Returns TID_ERROR if an entry's fds are bad. */
+tid_t process_spawn_fds(const char *cmd_line, const struct spawn_fd *fds,
+                        int cnt)
+{
+  ASSERT(cnt >= 0 && cnt <= SPAWN_FDS_MAX);
+
+  struct exec_args *args = split_cmd_line(cmd_line);
+  if (args == NULL)
+    return TID_ERROR;
+  return execute(args, true, fds, cnt);
+}
+
+#ifdef VM
+/* Like process_execute(), but starts a process from the image
+   that checkpoint() wrote to FILE, instead of from an executable.
+   It resumes where checkpoint() was called, with 1 as its result,
+   and its pages are read from FILE only as they are touched. */
+tid_t process_restore(const char *file)
+{
+  struct exec_args *args = split_cmd_line(file);
+  if (args == NULL)
+    return TID_ERROR;
+  args->restore = true;
+  return execute(args, false, NULL, 0);
+}
+#endif
+
+/* Returns 1 if the child CHILD_TID of the current process has
+   loaded, 0 if it is still loading, or -1 if it failed to load or
+   is not a child that can still be waited for. */
+int process_spawn_status(tid_t child_tid)
+{
+  lock_acquire(&wait_lock);
+  struct child_record *rec = child_find(child_tid);
+  int status = rec != NULL ? rec->load_status : -1;
+  lock_release(&wait_lock);
+  return status;
+}
+
+/* Copies CMD_LINE into a new exec_args page, split into words.
+   Returns NULL if it is empty, does not fit or there is no page. */
+static struct exec_args *split_cmd_line(const char *cmd_line)
+{
+  /* Split CMD_LINE into a page of its own as we copy it.
      Otherwise there's a race between the caller and load(). */
-  fn_copy = palloc_get_page(0);
+  struct exec_args *args = palloc_get_page(0);
+  if (args == NULL)
+    return NULL;
+
+  char *dst = args->strings;
+  char *end = args->strings + EXEC_ARGS_MAX;
+  const char *p = cmd_line;
+  args->argc = 0;
+  for (;;)
+  {
+    while (*p == ' ')
+      p++;
+    if (*p == '\0')
+      break;
+    while (*p != ' ' && *p != '\0' && dst < end)
+      *dst++ = *p++;
+    if (dst == end)
+    {
+      palloc_free_page(args);
+      return NULL;
+    }
+    *dst++ = '\0';
+    args->argc++;
+  }
+  if (args->argc == 0)
+  {
+    palloc_free_page(args);
+    return NULL;
+  }
+  args->len = dst - args->strings;
+  args->file = args->strings;
+  args->restore = false;
+  return args;
+}
 
-  if (strlen(file_name) > 128){
+/* Like process_execute(), but loads FILE and passes it the
+   null-terminated ARGV as it is, without splitting anything.
+   The caller must have checked FILE, ARGV and its strings. */
+tid_t process_execv(const char *file, char *const argv[])
+{
+  struct exec_args *args = palloc_get_page(0);
+  if (args == NULL)
     return TID_ERROR;
+
+  char *dst = args->strings;
+  size_t room = EXEC_ARGS_MAX;
+  size_t n;
+  for (args->argc = 0; argv[args->argc] != NULL; args->argc++)
+  {
+    n = strnlen(argv[args->argc], room) + 1;
+    if (n > room)
+    {
+      palloc_free_page(args);
+      return TID_ERROR;
+    }
+    memcpy(dst, argv[args->argc], n);
+    dst += n;
+    room -= n;
   }
+  args->len = dst - args->strings;
 
-  if (fn_copy == NULL)
+  n = strnlen(file, room) + 1;
+  if (n > room)
+  {
+    palloc_free_page(args);
     return TID_ERROR;
-  strlcpy(fn_copy, file_name, PGSIZE);
+  }
+  memcpy(dst, file, n);
+  args->file = dst;
+  args->restore = false;
+  return execute(args, false, NULL, 0);
+}
 
-  /* Create a new thread to execute FILE_NAME. */
-  tid = thread_create(file_name, PRI_DEFAULT, start_process, fn_copy);
-  sema_down(&thread_current()->child_parent_relation);
+/* Frees ARGS along with any of the parent's files it still holds. */
+static void exec_args_free(struct exec_args *args)
+{
+  for (int i = 0; i < args->file_cnt; i++)
+  {
+    file_close(args->files[i].file);
+  }
+  dir_close(args->cwd);
+  palloc_free_page(args);
+}
 
-  if (tid == TID_ERROR){
-    free(fn_copy);
-    palloc_free_page(fn_copy);
+/* Has the process ARGS starts begin with FILE at FD, in place of
+   what ARGS had there, or with nothing there if FILE is NULL,
+   which for fd 0 and 1 means the console. */
+static void exec_args_set_file(struct exec_args *args, int fd,
+                               struct file *file)
+{
+  int i = 0;
+  while (i < args->file_cnt && args->files[i].fd != fd)
+  {
+    i++;
+  }
+  if (i < args->file_cnt)
+  {
+    file_close(args->files[i].file);
   }
+  else if (file != NULL)
+  {
+    ASSERT(args->file_cnt < EXEC_FILES_MAX);
+    args->file_cnt++;
+  }
+  if (file == NULL)
+  {
+    if (i < args->file_cnt)
+    {
+      args->files[i] = args->files[--args->file_cnt];
+    }
+    return;
+  }
+  args->files[i].fd = fd;
+  args->files[i].file = file;
+}
+
+/* Applies the CNT entries of FDS to the files ARGS starts a process
+   with.  Returns false if an entry's TO is negative or its FROM is
+   not open, except that fd 0 or 1 on the console may go to fd 0
+   or 1, which then gets the console. */
+static bool exec_args_map_fds(struct exec_args *args,
+                              const struct spawn_fd *fds, int cnt)
+{
+  for (int i = 0; i < cnt; i++)
+  {
+    struct file *file = sys_file_dup(fds[i].from);
+    if (fds[i].to < 0 ||
+        (file == NULL && ((unsigned)fds[i].from >= 2 || fds[i].to >= 2)))
+    {
+      file_close(file);
+      return false;
+    }
+    exec_args_set_file(args, fds[i].to, file);
+  }
+  return true;
+}
+
+#ifdef VM
+/* Has the process ARGS restores start with each file whose position
+   the image records, at the fd it had: the file the current process
+   has open at that fd, reopened so that its position is the
+   recorded one without moving the current process's.  An fd the
+   current process has closed is left closed.  Returns false if the
+   image cannot be read. */
+static bool exec_args_restore_fds(struct exec_args *args)
+{
+  struct checkpoint_fd fds[CHECKPOINT_FDS_MAX];
+  struct file *image = filesys_open(args->file);
+  int cnt = image != NULL ? checkpoint_read_fds(image, fds) : -1;
+  file_close(image);
+  for (int i = 0; i < cnt; i++)
+  {
+    struct file *file = sys_file_dup(fds[i].fd);
+    struct file *copy = file != NULL ? file_reopen(file) : NULL;
+    file_close(file);
+    if (copy != NULL && fds[i].fd >= 2)
+    {
+      file_seek(copy, fds[i].pos);
+      exec_args_set_file(args, fds[i].fd, copy);
+    }
+    else
+    {
+      file_close(copy);
+    }
+  }
+  return cnt >= 0;
+}
+#endif
+
+/* Starts a process with ARGS, which it frees, and unless SPAWNED
+   waits for it to load.  The child takes over the current
+   process's stdin and stdout where dup2 has pointed them at files,
+   and then the files that the FD_CNT entries of FDS map, so that
+   a pipeline can be set up before it starts, and starts in the
+   current process's working directory.  A restored process also
+   gets the files its image records. */
+static tid_t execute(struct exec_args *args, bool spawned,
+                     const struct spawn_fd *fds, int fd_cnt)
+{
+  args->spawned = spawned;
+  args->file_cnt = 0;
+  args->cwd = filesys_open_cwd();
+  for (int fd = 0; fd < 2; fd++)
+  {
+    exec_args_set_file(args, fd, sys_file_dup(fd));
+  }
+  if (!exec_args_map_fds(args, fds, fd_cnt))
+  {
+    exec_args_free(args);
+    return TID_ERROR;
+  }
+#ifdef VM
+  if (args->restore && !exec_args_restore_fds(args))
+  {
+    exec_args_free(args);
+    return TID_ERROR;
+  }
+#endif
+  process_get_limits(args->limits);
+  args->record = child_create();
+  if (args->record == NULL)
+  {
+    exec_args_free(args);
+    return TID_ERROR;
+  }
+  struct child_record *rec = args->record;
+  tid_t tid = child_start(rec, start_process, args, args->file);
+  if (tid == TID_ERROR)
+  {
+    exec_args_free(args);
+    return TID_ERROR;
+  }
+  if (spawned)
+    return tid;
 
   /*Child loaded*/
+  sema_down(&thread_current()->child_parent_relation);
   if (thread_current()->child_success)
     return tid;
 
+  // exec returning -1 means there is no child to wait for
+  lock_acquire(&wait_lock);
+  child_forget(rec);
+  lock_release(&wait_lock);
   return TID_ERROR;
 }
 
 /* A thread function that loads a user process and starts it
    running. */
 static void
-start_process(void *file_name_)
+start_process(void *args_)
 {
-  char *file_name = file_name_;
+  struct exec_args *args = args_;
   struct intr_frame if_;
   bool success;
 
@@ -75,26 +474,36 @@ start_process(void *file_name_)
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
 
-  success = load(file_name, &if_.eip, &if_.esp);
   struct thread *parent = thread_current()->parent; // Khaled el ta7an advice
+  struct thread *cur = thread_current();
+  bool spawned = args->spawned;
+  child_attach(args->record);
 
-  if (success)
+#ifdef VM
+  if (args->restore)
+    success = load_checkpoint(args, &if_);
+  else
+#endif
+    success = load(args, &if_.eip, &if_.esp);
+  for (int i = 0; success && i < args->file_cnt; i++)
   {
-    struct list *children = &parent->children;
-    struct thread *current_child = thread_current();
-    list_push_back(children, &current_child->ch_elem);
-    parent->child_success = true;
-    sema_up(&parent->child_parent_relation);             // Free the parent
-    sema_down(&thread_current()->child_parent_relation); // Child blocked after loaded till parent wakes
+    // Taken over, or closed if there is no memory for it
+    success = sys_adopt_file(args->files[i].fd, args->files[i].file);
+    args->files[i].file = NULL;
   }
-  else
+  exec_args_free(args);
+
+  cur->record->load_status = success ? 1 : -1;
+  if (!spawned)
   {
-    parent->child_success = false;
-    sema_up(&parent->child_parent_relation); // Let the parent continue normally
+    // A spawner is not waiting; process_execute is, until we say how it went
+    parent->child_success = success;
+    sema_up(&parent->child_parent_relation);
   }
 
   /* If load failed, quit. */
-  palloc_free_page(file_name);
+  if (!success)
+    thread_exit();
 
   /* Start the user process by simulating a return from an
      interrupt, implemented by intr_exit (in
@@ -109,22 +518,229 @@ start_process(void *file_name_)
   NOT_REACHED();
 }
 
-struct thread *find_child(tid_t tid)
+/* Creates a child process that is a copy of the current one and
+   resumes, like it, from the system call whose frame is F, but
+   with 0 as the call's result.  User pages are shared
+   copy-on-write under VM and copied otherwise, and open files are
+   shared.  Returns the child's thread id, or TID_ERROR if it
+   cannot be created. */
+tid_t process_fork(struct intr_frame *f)
+{
+  struct fork_args args;
+  args.f = f;
+  args.record = child_create();
+  if (args.record == NULL)
+    return TID_ERROR;
+  tid_t tid = child_start(args.record, fork_process, &args, thread_current()->name);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+  sema_down(&thread_current()->child_parent_relation);
+
+  if (thread_current()->child_success)
+    return tid;
+
+  lock_acquire(&wait_lock);
+  child_forget(args.record);
+  lock_release(&wait_lock);
+  return TID_ERROR;
+}
+
+/* A thread function that copies its parent, which is blocked in
+   process_fork() on the fork_args ARGS_, and returns to user mode
+   through a copy of the parent's interrupt frame. */
+static void
+fork_process(void *args_)
+{
+  struct fork_args *args = args_;
+  struct intr_frame if_;
+  struct thread *parent = thread_current()->parent;
+
+  memcpy(&if_, args->f, sizeof if_);
+  if_.eax = 0;
+  child_attach(args->record);
+  thread_current()->record->load_status = 1;
+
+  if (!fork_address_space(parent) || !fpu_fork(parent))
+  {
+    parent->child_success = false;
+    sema_up(&parent->child_parent_relation);
+    thread_exit();
+  }
+
+  // Same handshake as start_process
+  parent->child_success = true;
+  sema_up(&parent->child_parent_relation);
+
+  asm volatile("movl %0, %%esp; jmp intr_exit"
+               :
+               : "g"(&if_)
+               : "memory");
+  NOT_REACHED();
+}
+
+/* Gives the current thread a copy of parent's address space,
+   executable and open files.  Whatever it got before failing is
+   freed by process_exit(). */
+static bool
+fork_address_space(struct thread *parent)
 {
-  struct thread *current = thread_current();
-  struct list *my_children = &current->children;
-  struct list_elem *iter = list_begin(my_children);
+  struct process *from = parent->process;
+
+  // Same order as load(), for process_exit()
+  if (!process_create())
+    return false;
+  struct process *proc = thread_current()->process;
+#ifdef VM
+  if (!page_table_init())
+    return false;
+#endif
+  proc->pagedir = pagedir_create();
+  if (proc->pagedir == NULL)
+    return false;
+  process_activate();
 
-  while (iter != list_end(my_children))
+  // Shared, so it stays write-denied until both have exited
+  proc->exe = file_dup(from->exe);
+  memcpy(proc->limits, from->limits, sizeof proc->limits);
+
+  // The rings are at the same addresses in the copy
+  proc->ring_sq = from->ring_sq;
+  proc->ring_cq = from->ring_cq;
+
+  // Only the forking thread is copied, but the stacks of the rest
+  // come along with the address space, and keep their slots
+  proc->stack_slots = from->stack_slots;
+#ifdef VM
+  // page_fork() copies the heap's pages along with the rest
+  proc->heap_start = from->heap_start;
+  proc->heap_brk = from->heap_brk;
+  if (!page_fork(parent) || !map_clock_page())
+    return false;
+#else
+  if (!pagedir_copy(proc->pagedir, from->pagedir))
+    return false;
+#endif
+  if (!shm_fork(from))
+    return false;
+  return sys_dup_files(parent);
+}
+
+static unsigned child_hash(const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int(hash_entry(e, struct child_record, elem)->tid);
+}
+
+static bool child_less(const struct hash_elem *a, const struct hash_elem *b,
+                       void *aux UNUSED)
+{
+  return (hash_entry(a, struct child_record, elem)->tid
+          < hash_entry(b, struct child_record, elem)->tid);
+}
+
+/* Returns a record for a child the current thread is about to
+   create, or NULL if memory is short. */
+static struct child_record *child_create(void)
+{
+  struct thread *t = thread_current();
+  if (t->children == NULL)
   {
-    struct thread *this = list_entry(iter, struct thread, ch_elem);
-    iter = list_next(iter);
-    if (this->tid == tid)
+    struct hash *children = malloc(sizeof *children);
+    if (children == NULL)
+      return NULL;
+    if (!hash_init(children, child_hash, child_less, NULL))
     {
-      return this;
+      free(children);
+      return NULL;
     }
+    t->children = children;
   }
-  return NULL;
+
+  struct child_record *rec = malloc(sizeof *rec);
+  if (rec == NULL)
+    return NULL;
+  rec->tid = TID_ERROR;
+  rec->exit_status = -1;
+  rec->load_status = 0;
+  rec->exited = false;
+  rec->thread = NULL;
+  rec->ref_cnt = 2;
+  return rec;
+}
+
+/* Makes the current thread, a new child, the holder of REC, if
+   any, so that its parent can find it there while it runs. */
+static void child_attach(struct child_record *rec)
+{
+  lock_acquire(&wait_lock);
+  thread_current()->record = rec;
+  if (rec != NULL)
+    rec->thread = thread_current();
+  lock_release(&wait_lock);
+}
+
+/* Creates the thread for the child whose record is REC, running
+   FUNC (AUX), and files REC under its tid.  wait_lock is held
+   throughout, so the child cannot exit before REC is filed.
+   Frees REC and returns TID_ERROR if there is no thread, or if
+   the current thread already has as many children running as
+   its process's RLIMIT_NPROC allows. */
+static tid_t child_start(struct child_record *rec, thread_func *func, void *aux,
+                         const char *name)
+{
+  struct thread *cur = thread_current();
+  unsigned limit = cur->process != NULL ? cur->process->limits[RLIMIT_NPROC]
+                                        : RLIM_INFINITY;
+  tid_t tid = TID_ERROR;
+
+  lock_acquire(&wait_lock);
+  if ((unsigned)cur->child_cnt < limit)
+    tid = thread_create(name, PRI_DEFAULT, func, aux);
+  if (tid != TID_ERROR)
+  {
+    rec->tid = tid;
+    hash_insert(cur->children, &rec->elem);
+    cur->child_cnt++;
+  }
+  lock_release(&wait_lock);
+
+  if (tid == TID_ERROR)
+    free(rec);
+  return tid;
+}
+
+/* Returns the record of the current thread's child TID, or NULL.
+   Must be called with wait_lock held. */
+static struct child_record *child_find(tid_t tid)
+{
+  struct thread *t = thread_current();
+  struct child_record key;
+  struct hash_elem *e;
+
+  if (t->children == NULL)
+    return NULL;
+  key.tid = tid;
+  e = hash_find(t->children, &key.elem);
+  return e != NULL ? hash_entry(e, struct child_record, elem) : NULL;
+}
+
+/* Lets go of REC, a record in the current thread's children.
+   Must be called with wait_lock held. */
+static void child_forget(struct child_record *rec)
+{
+  hash_delete(thread_current()->children, &rec->elem);
+  child_drop(&rec->elem, NULL);
+}
+
+/* Lets go of the record holding E on behalf of the parent, who
+   leaves it to the child if the child is still running.
+   Must be called with wait_lock held. */
+static void child_drop(struct hash_elem *e, void *aux UNUSED)
+{
+  struct child_record *rec = hash_entry(e, struct child_record, elem);
+  if (rec->exited)
+    list_remove(&rec->exit_elem);
+  if (--rec->ref_cnt == 0)
+    free(rec);
 }
 
 /* Waits for thread TID to die and returns its exit status.  If
@@ -133,93 +749,475 @@ struct thread *find_child(tid_t tid)
    child of the calling process, or if process_wait() has already
    been successfully called for the given TID, returns -1
    immediately, without waiting.
-
-   This function will be implemented in problem 2-2.  For now, it
-   does nothing. */
+   A child that exited before the wait left its status in its
+   record, which is found by tid in O(1). */
 int process_wait(tid_t child_tid) // Shell comes here to wait  for child
 {
-  thread_current()->certain_tid_parent_wait_for = child_tid;
-  struct thread *child = find_child(child_tid);
-  if (child != NULL)
-  { // Execute it
-    list_remove(&child->ch_elem);
-    sema_up(&child->child_parent_relation);                    // Go child and execute
-    sema_down(&thread_current()->parent_wait_till_child_exit); // Wait for your child
-    return thread_current()->child_result_status;
+  struct thread *cur = thread_current();
+  int status = -1;
+
+  lock_acquire(&wait_lock);
+  struct child_record *rec = child_find(child_tid);
+  if (rec != NULL)
+  {
+    // Lend the child our share of the CPU while we wait for it
+    cond_set_signaler(&cur->child_exited, rec->thread);
+    while (!rec->exited)
+      cond_wait(&cur->child_exited, &wait_lock);
+    cond_set_signaler(&cur->child_exited, NULL);
+    status = rec->exit_status;
+    child_forget(rec);
   }
+  lock_release(&wait_lock);
+  return status;
+}
+
+/* Waits for whichever child of the current process exits first,
+   or has already exited, stores its exit status in *STATUS and
+   returns its tid.  Returns -1 at once if there are no children
+   left to wait for. */
+tid_t process_wait_any(int *status)
+{
+  struct thread *cur = thread_current();
+  tid_t tid = TID_ERROR;
 
-  return -1;
+  lock_acquire(&wait_lock);
+  if (cur->children != NULL && !hash_empty(cur->children))
+  {
+    while (list_empty(&cur->exited_children))
+      cond_wait(&cur->child_exited, &wait_lock);
+    struct child_record *rec = list_entry(list_front(&cur->exited_children),
+                                          struct child_record, exit_elem);
+    tid = rec->tid;
+    *status = rec->exit_status;
+    child_forget(rec);
+  }
+  lock_release(&wait_lock);
+  return tid;
 }
 
-/* Free the current process's resources. */
+/* Free the current process's resources.  The main thread of a
+   process waits here for its other threads to exit first, and
+   the others just leave it. */
 void process_exit(void)
 { /*For User program let's do this, check it has a parent*/
   struct thread *cur = thread_current();
-  if (cur->parent != NULL) // I'm a child
+  struct process *proc = cur->process;
+
+  if (proc != NULL && proc->main == cur)
+    threads_reap(proc);
+
+  lock_acquire(&wait_lock);
+  struct child_record *rec = cur->record;
+  if (rec != NULL) // I'm a child
   {
-    struct thread *parent = cur->parent;
-    if (parent->certain_tid_parent_wait_for == cur->tid) // if parent is waiting on me
+    // Unless it calls exit, it was killed
+    rec->exit_status = proc != NULL ? proc->exit_status : -1;
+    rec->exited = true;
+    rec->thread = NULL;
+    // The parent is alive exactly while it still holds the record
+    if (--rec->ref_cnt == 0)
+      free(rec);
+    else
     {
-      parent->child_result_status = cur->exit_status;
-      // Now parent not wating for anybody
-      // Let's reset everything
-      parent->certain_tid_parent_wait_for = -1;
-      parent->child_success = false;
-      // Free the parent
-      sema_up(&parent->parent_wait_till_child_exit);
+      cur->parent->child_cnt--;
+      list_push_back(&cur->parent->exited_children, &rec->exit_elem);
+      cond_broadcast(&cur->parent->child_exited, &wait_lock);
     }
-    // if parent is not waiting on me
-    // else
-    // {
-    //   list_remove(&cur->ch_elem);
-    // }
+    cur->record = NULL;
   }
-  file_close(thread_current()->exe); // close the exe
-  thread_current()->parent = NULL;
-  thread_current()->exe = NULL;
-
-  // Close now all files opened by me
-  struct list *files_opened = &thread_current()->files_opened_by_me;
-  struct list_elem *iter = list_begin(files_opened);
-  while (iter != list_end(files_opened))
+  // My children's records stay with those still running
+  if (cur->children != NULL)
   {
-    struct files_opened *this = list_entry(iter, struct files_opened, elem);
-    iter = list_next(iter);
-    file_close(this->f);
-    list_remove(&this->elem);
-    free(this);
+    hash_destroy(cur->children, child_drop);
+    free(cur->children);
+    cur->children = NULL;
   }
+  lock_release(&wait_lock);
+  thread_current()->parent = NULL;
 
-  // Unblock children when parent exits. Pintos is special in this handling.
-  struct list *children = &thread_current()->children;
-  struct list_elem *another_iter = list_begin(children);
-  while (another_iter != list_end(children))
+  if (proc == NULL)
+    return;
+  if (proc->main != cur)
   {
-    struct thread *ch = list_entry(another_iter, struct thread, ch_elem);
-    another_iter = list_next(another_iter);
-    ch->parent = NULL;
-    sema_up(&ch->child_parent_relation);
-    list_remove(&ch->ch_elem);
+    thread_leave(proc);
+    return;
   }
 
+  file_close(proc->exe); // close the exe
+  proc->exe = NULL;
+
+  // Requests still in flight finish without me
+  aio_exit();
+
+  // Close now all files opened by me
+  sys_close_all();
+  dir_close(proc->cwd);
+  proc->cwd = NULL;
+
   uint32_t *pd;
 
   /* Destroy the current process's page directory and switch back
      to the kernel-only page directory. */
-  pd = cur->pagedir;
+  pd = proc->pagedir;
   if (pd != NULL)
   {
+    shm_unmap_all();
+#ifdef VM
+    // Write back my mapped files, then take my frames off the frame
+    // table while the evictor can still see my pagedir
+    mmap_unmap_all();
+    frame_release_owner(proc);
+#endif
     /* Correct ordering here is crucial.  We must set
-       cur->pagedir to NULL before switching page directories,
+       proc->pagedir to NULL before switching page directories,
        so that a timer interrupt can't switch back to the
        process page directory.  We must activate the base page
        directory before destroying the process's page
        directory, or our active page directory will be one
        that's been freed (and cleared). */
-    cur->pagedir = NULL;
+    proc->pagedir = NULL;
     pagedir_activate(NULL);
     pagedir_destroy(pd);
+#ifdef VM
+    page_table_destroy();
+#endif
+  }
+  cur->process = NULL;
+  free(proc);
+}
+
+/* Gives the current thread a new, empty process, of which it is
+   the main thread.  Returns false if memory is short. */
+static bool process_create(void)
+{
+  struct thread *t = thread_current();
+  struct process *proc = calloc(1, sizeof *proc);
+  if (proc == NULL)
+    return false;
+  lock_init(&proc->lock);
+  lock_init(&proc->files_lock);
+  proc->main = t;
+  list_init(&proc->threads);
+  proc->thread_cnt = 1;
+  cond_init(&proc->thread_exited);
+  proc->exit_status = -1; // Unless it calls exit, it was killed
+  for (int i = 0; i < RLIMIT_CNT; i++)
+    proc->limits[i] = RLIM_INFINITY;
+  sched_group_init(&proc->group, TICKETS_DEFAULT);
+#ifdef VM
+  list_init(&proc->mappings);
+#endif
+  list_init(&proc->shm_mappings);
+  list_init(&proc->aio_requests);
+  list_init(&proc->upcall_waiters);
+  t->process = proc;
+  return true;
+}
+
+/* Records STATUS as the exit status of the current process and
+   marks it exiting, so that its other threads die, unless one of
+   them called exit() first.  Returns true in the first case. */
+bool process_set_exit(int status)
+{
+  struct process *proc = thread_current()->process;
+  lock_acquire(&proc->lock);
+  bool first = !proc->exiting;
+  if (first)
+  {
+    proc->exiting = true;
+    proc->exit_status = status;
+    // Threads blocked in thread_join, futex_wait or upcall_wait
+    // wake to die
+    cond_broadcast(&proc->thread_exited, &proc->lock);
+  }
+  lock_release(&proc->lock);
+  if (first)
+  {
+    futex_wake_all(proc->pagedir);
+    upcall_wake_all(proc);
+  }
+  return first;
+}
+
+/* Ends the current thread if its process is exiting, and kills
+   the process if it has run for as long as RLIMIT_CPU allows.  Its
+   threads come here on their way into and out of the kernel, so
+   every one of them dies soon after one calls exit(), unless it is
+   blocked in a system call, which it finishes first. */
+void process_check_exiting(void)
+{
+  struct process *proc = thread_current()->process;
+  if (proc == NULL)
+    return;
+  if (proc->exiting)
+  {
+    intr_enable();
+    thread_exit();
+  }
+  if (proc->cpu_ticks >= proc->limits[RLIMIT_CPU])
+  {
+    // Out of CPU time: killed, as if by an exception
+    intr_enable();
+    process_set_exit(-1);
+    thread_exit();
+  }
+}
+
+/* Stores the current process's resource limits in LIMITS, or no
+   limits at all for a kernel thread. */
+void process_get_limits(unsigned limits[RLIMIT_CNT])
+{
+  struct process *proc = thread_current()->process;
+  for (int i = 0; i < RLIMIT_CNT; i++)
+    limits[i] = proc != NULL ? proc->limits[i] : RLIM_INFINITY;
+}
+
+/* Lowers the current process's limit on RESOURCE, one of the
+   RLIMIT_*, to LIMIT.  Returns false, changing nothing, if there
+   is no such resource or LIMIT is higher than the limit now. */
+bool process_set_limit(int resource, unsigned limit)
+{
+  struct process *proc = thread_current()->process;
+  if (resource < 0 || resource >= RLIMIT_CNT)
+    return false;
+
+  lock_acquire(&proc->lock);
+  bool ok = limit <= proc->limits[resource];
+  if (ok)
+    proc->limits[resource] = limit;
+  lock_release(&proc->lock);
+  return ok;
+}
+
+/* Returns the record of PROC's thread TID, or NULL.
+   PROC's lock must be held. */
+static struct user_thread *user_thread_find(struct process *proc, tid_t tid)
+{
+  for (struct list_elem *e = list_begin(&proc->threads);
+       e != list_end(&proc->threads); e = list_next(e))
+  {
+    struct user_thread *ut = list_entry(e, struct user_thread, elem);
+    if (ut->tid == tid)
+      return ut;
+  }
+  return NULL;
+}
+
+/* Returns the top of stack slot SLOT. */
+static uint8_t *thread_stack_top(int slot)
+{
+  return THREAD_STACKS_TOP - (size_t)slot * THREAD_STACK_PAGES * PGSIZE;
+}
+
+/* Unmaps the top PAGE_CNT pages of stack slot SLOT of the current
+   process, whose lock must be held. */
+static void thread_stack_free(int slot, int page_cnt)
+{
+  uint8_t *top = thread_stack_top(slot);
+  pagedir_batch_begin();
+  for (int i = 1; i <= page_cnt; i++)
+  {
+#ifdef VM
+    page_remove(top - i * PGSIZE);
+#else
+    uint32_t *pd = thread_current()->process->pagedir;
+    void *kpage = pagedir_get_page(pd, top - i * PGSIZE);
+    pagedir_clear_page(pd, top - i * PGSIZE);
+    palloc_free_page(kpage);
+#endif
+  }
+  pagedir_batch_end();
+}
+
+/* Maps the pages of stack slot SLOT in the current process, whose
+   lock must be held.  Returns false if one of them is in use, by
+   the heap say, or memory is short. */
+static bool thread_stack_alloc(int slot)
+{
+  uint8_t *top = thread_stack_top(slot);
+  for (int i = 1; i <= THREAD_STACK_PAGES; i++)
+  {
+    uint8_t *upage = top - i * PGSIZE;
+#ifdef VM
+    if (page_is_free(upage) && page_add_file(upage, NULL, 0, 0, true))
+      continue;
+#else
+    uint8_t *kpage = palloc_get_page(PAL_USER | PAL_ZERO);
+    if (kpage != NULL && install_page(upage, kpage, true))
+      continue;
+    palloc_free_page(kpage);
+#endif
+    thread_stack_free(slot, i - 1);
+    return false;
   }
+  return true;
+}
+
+/* Starts a thread in the current process that enters user mode at
+   EIP, on a stack of its own, as if called there with FN and AUX
+   as its arguments.  It shares everything else with the process's
+   other threads.  Returns its tid, or TID_ERROR if the process is
+   exiting or has PROCESS_THREAD_MAX other threads already, or
+   memory is short. */
+tid_t process_thread_spawn(void (*eip)(void), void *fn, void *aux)
+{
+  struct thread *cur = thread_current();
+  struct process *proc = cur->process;
+  struct user_thread *ut = malloc(sizeof *ut);
+  int slot = 0;
+  if (ut == NULL)
+    return TID_ERROR;
+
+  lock_acquire(&proc->lock);
+  while (slot < PROCESS_THREAD_MAX && (proc->stack_slots & (1u << slot)))
+    slot++;
+  bool ok = !proc->exiting && slot < PROCESS_THREAD_MAX && thread_stack_alloc(slot);
+  if (ok)
+    proc->stack_slots |= 1u << slot;
+  lock_release(&proc->lock);
+  if (!ok)
+  {
+    free(ut);
+    return TID_ERROR;
+  }
+
+  // The frame of a call from nowhere: no return address
+  uint32_t *sp = (uint32_t *)thread_stack_top(slot);
+#ifdef VM
+  ok = page_in(sp - 1, true);
+#endif
+  if (ok)
+  {
+    *--sp = (uint32_t)aux;
+    *--sp = (uint32_t)fn;
+    *--sp = 0;
+  }
+
+  ut->slot = slot;
+  ut->exited = false;
+  ut->joining = false;
+  ut->process = proc;
+  ut->eip = eip;
+  ut->esp = sp;
+
+  // Held until ut is filed, which the thread needs to exit
+  lock_acquire(&proc->lock);
+  tid_t tid = ok ? thread_create(cur->name, PRI_DEFAULT, start_user_thread, ut)
+                 : TID_ERROR;
+  if (tid != TID_ERROR)
+  {
+    ut->tid = tid;
+    list_push_back(&proc->threads, &ut->elem);
+    proc->thread_cnt++;
+  }
+  else
+  {
+    thread_stack_free(slot, THREAD_STACK_PAGES);
+    proc->stack_slots &= ~(1u << slot);
+    free(ut);
+  }
+  lock_release(&proc->lock);
+  return tid;
+}
+
+/* A thread function that joins the process of the user_thread
+   UT_ and enters user mode as it says. */
+static void
+start_user_thread(void *ut_)
+{
+  struct user_thread *ut = ut_;
+  struct intr_frame if_;
+
+  thread_current()->process = ut->process;
+  process_activate();
+
+  memset(&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = ut->eip;
+  if_.esp = ut->esp;
+
+  asm volatile("movl %0, %%esp; jmp intr_exit"
+               :
+               : "g"(&if_)
+               : "memory");
+  NOT_REACHED();
+}
+
+/* Waits for thread TID of the current process, one started by
+   process_thread_spawn(), to exit, and forgets it.  Returns 0
+   once it has, or -1 at once if TID is no such thread or another
+   thread is joining it already, or as soon as the process starts
+   exiting. */
+int process_thread_join(tid_t tid)
+{
+  struct process *proc = thread_current()->process;
+  int result = -1;
+
+  lock_acquire(&proc->lock);
+  struct user_thread *ut = user_thread_find(proc, tid);
+  if (ut != NULL && !ut->joining && tid != thread_tid())
+  {
+    ut->joining = true;
+    while (!ut->exited && !proc->exiting)
+      cond_wait(&proc->thread_exited, &proc->lock);
+    ut->joining = false;
+    if (ut->exited)
+    {
+      list_remove(&ut->elem);
+      free(ut);
+      result = 0;
+    }
+  }
+  lock_release(&proc->lock);
+  return result;
+}
+
+/* Takes the current thread, which is not its main thread, out of
+   PROC: frees its stack and leaves word for thread_join() that it
+   has exited. */
+static void thread_leave(struct process *proc)
+{
+  struct thread *cur = thread_current();
+
+  lock_acquire(&proc->lock);
+  struct user_thread *ut = user_thread_find(proc, cur->tid);
+  thread_stack_free(ut->slot, THREAD_STACK_PAGES);
+  proc->stack_slots &= ~(1u << ut->slot);
+  ut->exited = true;
+
+  /* Once the count drops the main thread may destroy the page
+     directory, which stays loaded here until the next switch
+     but is not activated again for a thread without a process. */
+  cur->process = NULL;
+  proc->thread_cnt--;
+  cond_broadcast(&proc->thread_exited, &proc->lock);
+  lock_release(&proc->lock);
+}
+
+/* Marks PROC, whose main thread is the current thread, exiting,
+   and waits for its other threads to leave it, waking any that
+   are waiting in thread_join(), futex_wait() or upcall_wait() so
+   that they do. */
+static void threads_reap(struct process *proc)
+{
+  lock_acquire(&proc->lock);
+  proc->exiting = true;
+  cond_broadcast(&proc->thread_exited, &proc->lock);
+  lock_release(&proc->lock);
+
+  // Without the process lock, which a futex waiter may fault on
+  futex_wake_all(proc->pagedir);
+  upcall_wake_all(proc);
+
+  lock_acquire(&proc->lock);
+  while (proc->thread_cnt > 1)
+    cond_wait(&proc->thread_exited, &proc->lock);
+  while (!list_empty(&proc->threads))
+    free(list_entry(list_pop_front(&proc->threads), struct user_thread, elem));
+  lock_release(&proc->lock);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -229,8 +1227,13 @@ void process_activate(void)
 {
   struct thread *t = thread_current();
 
-  /* Activate thread's page tables. */
-  pagedir_activate(t->pagedir);
+  /* Activate thread's page tables.  A kernel thread has none and
+     only touches kernel mappings, which every page directory has,
+     so it keeps whichever one is loaded and switching to and back
+     from it costs no TLB flush.  process_exit() still switches to
+     the base page directory itself before destroying its own. */
+  if (t->process != NULL && t->process->pagedir != NULL)
+    pagedir_activate(t->process->pagedir);
 
   /* Set thread's kernel stack for use in processing
      interrupts. */
@@ -301,56 +1304,230 @@ struct Elf32_Phdr
 #define PF_R 4 /* Readable. */
 
 static bool setup_stack(void **esp);
+static struct elf_image *read_elf(struct file *file);
 static bool validate_segment(const struct Elf32_Phdr *, struct file *);
 static bool load_segment(struct file *file, off_t ofs, uint8_t *upage,
                          uint32_t read_bytes, uint32_t zero_bytes,
                          bool writable);
 
-/* Loads an ELF executable from FILE_NAME into the current thread.
+/* Gives the current thread a process with an empty address space,
+   the working directory and limits in ARGS.  Whatever it got
+   before failing is freed by process_exit(). */
+static bool address_space_create(const struct exec_args *args)
+{
+  struct thread *t = thread_current();
+
+  if (!process_create())
+    return false;
+
+  // Relative names, the executable's first, start where the parent was
+  if (args->cwd != NULL)
+    t->process->cwd = dir_reopen(args->cwd);
+  memcpy(t->process->limits, args->limits, sizeof args->limits);
+
+#ifdef VM
+  /* Set up the supplemental page table before the page directory,
+     so that process_exit() frees it exactly when there is a page
+     directory. */
+  if (!page_table_init())
+    return false;
+#endif
+
+  /* Allocate and activate page directory. */
+  t->process->pagedir = pagedir_create();
+  if (t->process->pagedir == NULL)
+    return false;
+  process_activate();
+  return true;
+}
+
+/* Loads the ELF executable named by ARGS into the current thread,
+   with the arguments in ARGS on its stack.
    Stores the executable's entry point into *EIP
    and its initial stack pointer into *ESP.
    Returns true if successful, false otherwise. */
-bool load(const char *file_name, void (**eip)(void), void **esp)
+static bool load(const struct exec_args *args, void (**eip)(void), void **esp)
 {
   struct thread *t = thread_current();
-  struct Elf32_Ehdr ehdr;
   struct file *file = NULL;
-  off_t file_ofs;
+  struct inode *inode;
+  struct elf_image *image = NULL;
   bool success = false;
   int i;
 
-  /*Using the strtok_r to separate agruments*/
-
-  char *file_name_copy;
-  char *buffer_ptr;
-  int arguments_lenght = strlen(file_name) + 1;
-  file_name_copy = malloc(arguments_lenght);
-  strlcpy(file_name_copy, file_name, arguments_lenght);
-  file_name_copy = strtok_r(file_name_copy, " ", &buffer_ptr); // Only file name now is in file_name_copy
-
-  /* Allocate and activate page directory. */
-  t->pagedir = pagedir_create();
-  if (t->pagedir == NULL)
+  if (!address_space_create(args))
     goto done;
-  process_activate();
 
   /* Open executable file. */
-  file = filesys_open(file_name_copy);
+  file = filesys_open(args->file);
   if (file == NULL)
   {
-    printf("load: %s: open failed\n", file_name);
+    printf("load: %s: open failed\n", args->file);
     goto done;
   }
 
-  /* Read and verify executable header. */
-  if (file_read(file, &ehdr, sizeof ehdr) != sizeof ehdr || memcmp(ehdr.e_ident, "\177ELF\1\1\1", 7) || ehdr.e_type != 2 || ehdr.e_machine != 3 || ehdr.e_version != 1 || ehdr.e_phentsize != sizeof(struct Elf32_Phdr) || ehdr.e_phnum > 1024)
+  // Point to the exe now, so that exit closes it whatever happens
+  t->process->exe = file;
+
+  /* Read and verify the headers, unless they were cached. */
+  inode = file_get_inode(file);
+  image = inode != NULL ? elfcache_lookup(inode) : NULL;
+  if (image == NULL)
   {
-    printf("load: %s: error loading executable\n", file_name);
+    unsigned write_cnt = inode != NULL ? inode_write_cnt(inode) : 0;
+    image = read_elf(file);
+    if (image == NULL)
+    {
+      printf("load: %s: error loading executable\n", args->file);
+      goto done;
+    }
+    if (inode != NULL)
+      elfcache_insert(inode, write_cnt, image);
+  }
+
+  for (i = 0; i < (int)image->seg_cnt; i++)
+  {
+    const struct elf_segment *seg = &image->segs[i];
+    if (!load_segment(file, seg->file_page, (void *)seg->mem_page,
+                      seg->read_bytes, seg->zero_bytes, seg->writable))
+      goto done;
+  }
+
+#ifdef VM
+  // The heap starts out empty, just past the highest segment
+  t->process->heap_start = t->process->heap_brk = (uint8_t *)image->seg_end;
+#endif
+
+  // After the segments, so that one in the way makes the load fail
+  if (!map_clock_page())
+  {
+    printf("load: %s: clock page address in use\n", args->file);
+    goto done;
+  }
+
+  /* Set up stack. */
+  if (!setup_stack(esp))
+    goto done;
+
+  // Pushing the argument in the stack
+  if (!push_stack_arguments(args, esp))
     goto done;
+
+  /* Start address. */
+  *eip = image->entry;
+
+  success = true;
+
+done:
+  /* We arrive here whether the load is successful or not. */
+  elf_image_release(image);
+  // Here we deny file write.
+  if (success)
+    file_deny_write(file);
+
+  return success;
+}
+
+#ifdef VM
+/* Loads the checkpoint() image named by ARGS into the current
+   thread, storing the registers it resumes with in IF_, whose
+   segment registers and flags are already set.  The image stays
+   open, write-denied, as the process's executable, since its
+   pages are read from it as they are touched.  Returns true if
+   successful, false otherwise. */
+static bool load_checkpoint(const struct exec_args *args,
+                            struct intr_frame *if_)
+{
+  struct process *proc;
+  struct file *file;
+
+  if (!address_space_create(args))
+    return false;
+  proc = thread_current()->process;
+
+  file = filesys_open(args->file);
+  if (file == NULL)
+  {
+    printf("load: %s: open failed\n", args->file);
+    return false;
+  }
+  proc->exe = file;
+  if (!checkpoint_load(file, if_))
+  {
+    printf("load: %s: error loading checkpoint\n", args->file);
+    return false;
+  }
+  if (!map_clock_page())
+  {
+    printf("load: %s: clock page address in use\n", args->file);
+    return false;
   }
+  file_deny_write(file);
+  return true;
+}
+#endif
+
+/* Lays out argc, argv and the strings ARGS holds below *ESP the
+   way main() expects them, and moves *ESP down past them.  The
+   size of everything is known up front, so the strings go in
+   with one copy.  Returns false if it does not all fit in the
+   stack page. */
+static bool push_stack_arguments(const struct exec_args *args, void **esp)
+{
+  size_t strings_size = ROUND_UP(args->len, sizeof(char *));
+  size_t argv_size = (args->argc + 1) * sizeof(char *);
+  if (strings_size + argv_size + sizeof(char **) + sizeof(int) + sizeof(void *) > PGSIZE)
+    return false;
 
-  // Point to the exe now
-  thread_current()->exe = file;
+  // Strings at the top, then zero padding down to a word boundary
+  char *strings = (char *)*esp - strings_size;
+  memcpy(strings, args->strings, args->len);
+  memset(strings + args->len, 0, strings_size - args->len);
+
+  // argv[] under them, pointing in
+  char **argv = (char **)(strings - argv_size);
+  char *arg = strings;
+  for (int i = 0; i < args->argc; i++)
+  {
+    argv[i] = arg;
+    arg += strlen(arg) + 1;
+  }
+  argv[args->argc] = NULL;
+
+  // Then main()'s arguments, and null as the return address
+  void **stack_pointer = (void **)argv;
+  *--stack_pointer = argv;
+  *--stack_pointer = (void *)args->argc;
+  *--stack_pointer = NULL;
+
+  *esp = stack_pointer;
+  return true;
+}
+
+/* load() helpers. */
+
+/* Reads and checks the ELF header and program headers of FILE and
+   returns its loadable segments, laid out in pages, in a new
+   image.  Returns a null pointer if FILE is not an executable we
+   can load or memory is short. */
+static struct elf_image *read_elf(struct file *file)
+{
+  struct Elf32_Ehdr ehdr;
+  struct elf_image *image;
+  off_t file_ofs;
+  size_t seg_cnt = 0;
+  int i;
+
+  file_seek(file, 0);
+  if (file_read(file, &ehdr, sizeof ehdr) != sizeof ehdr || memcmp(ehdr.e_ident, "\177ELF\1\1\1", 7) || ehdr.e_type != 2 || ehdr.e_machine != 3 || ehdr.e_version != 1 || ehdr.e_phentsize != sizeof(struct Elf32_Phdr) || ehdr.e_phnum > 1024)
+    return NULL;
+
+  // There are no more loadable segments than program headers
+  image = elf_image_create(ehdr.e_phnum);
+  if (image == NULL)
+    return NULL;
+  image->entry = (void (*)(void))ehdr.e_entry;
+  image->seg_end = 0;
 
   /* Read program headers. */
   file_ofs = ehdr.e_phoff;
@@ -359,11 +1536,11 @@ bool load(const char *file_name, void (**eip)(void), void **esp)
     struct Elf32_Phdr phdr;
 
     if (file_ofs < 0 || file_ofs > file_length(file))
-      goto done;
+      goto fail;
     file_seek(file, file_ofs);
 
     if (file_read(file, &phdr, sizeof phdr) != sizeof phdr)
-      goto done;
+      goto fail;
     file_ofs += sizeof phdr;
     switch (phdr.p_type)
     {
@@ -377,125 +1554,45 @@ bool load(const char *file_name, void (**eip)(void), void **esp)
     case PT_DYNAMIC:
     case PT_INTERP:
     case PT_SHLIB:
-      goto done;
+      goto fail;
     case PT_LOAD:
       if (validate_segment(&phdr, file))
       {
-        bool writable = (phdr.p_flags & PF_W) != 0;
-        uint32_t file_page = phdr.p_offset & ~PGMASK;
-        uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
+        struct elf_segment *seg = &image->segs[seg_cnt++];
         uint32_t page_offset = phdr.p_vaddr & PGMASK;
-        uint32_t read_bytes, zero_bytes;
+        seg->writable = (phdr.p_flags & PF_W) != 0;
+        seg->file_page = phdr.p_offset & ~PGMASK;
+        seg->mem_page = phdr.p_vaddr & ~PGMASK;
         if (phdr.p_filesz > 0)
         {
           /* Normal segment.
              Read initial part from disk and zero the rest. */
-          read_bytes = page_offset + phdr.p_filesz;
-          zero_bytes = (ROUND_UP(page_offset + phdr.p_memsz, PGSIZE) - read_bytes);
+          seg->read_bytes = page_offset + phdr.p_filesz;
+          seg->zero_bytes = (ROUND_UP(page_offset + phdr.p_memsz, PGSIZE) - seg->read_bytes);
         }
         else
         {
           /* Entirely zero.
              Don't read anything from disk. */
-          read_bytes = 0;
-          zero_bytes = ROUND_UP(page_offset + phdr.p_memsz, PGSIZE);
+          seg->read_bytes = 0;
+          seg->zero_bytes = ROUND_UP(page_offset + phdr.p_memsz, PGSIZE);
         }
-        if (!load_segment(file, file_page, (void *)mem_page,
-                          read_bytes, zero_bytes, writable))
-          goto done;
+        if (seg->mem_page + seg->read_bytes + seg->zero_bytes > image->seg_end)
+          image->seg_end = seg->mem_page + seg->read_bytes + seg->zero_bytes;
       }
       else
-        goto done;
+        goto fail;
       break;
     }
   }
+  image->seg_cnt = seg_cnt;
+  return image;
 
-  /* Set up stack. */
-  if (!setup_stack(esp))
-    goto done;
-
-  // Pushing the argument in the stack
-  push_stack_arguments(file_name_copy, esp, &buffer_ptr);
-  free(file_name_copy);
-
-  /* Start address. */
-  *eip = (void (*)(void))ehdr.e_entry;
-
-  success = true;
-
-done:
-  /* We arrive here whether the load is successful or not. */
-  // Here we deny file write.
-  if (success)
-    file_deny_write(file);
-
-  return success;
-}
-
-void push_stack_arguments(char *f_name, void **esp, char **save_ptr)
-{
-  void *stack_pointer = *esp;
-  int argc = 0;
-  char *ptr = f_name;
-  int total_size = 0;
-
-  // Pushing elements on the stack
-  while (ptr != NULL)
-  {
-    stack_pointer -= (strlen(ptr) + 1);
-    memcpy(stack_pointer, ptr, strlen(ptr) + 1);
-    total_size += strlen(ptr) + 1;
-    argc++;
-    ptr = strtok_r(NULL, " ", save_ptr);
-  }
-  
-  char *stack_arguments = stack_pointer;
-
-  /* The purpose of word alignment is to improve memory access performance and reduce memory fragmentation. When memory is allocated, the operating system allocates memory blocks that are aligned to word boundaries. */
-  int current_word_alignment = (4 - (total_size % 4)) % 4;
-  if (current_word_alignment != 0)
-  {
-    stack_pointer -= current_word_alignment;
-    memset(stack_pointer, 0, current_word_alignment); // Put zeros in the last word, to replace them later with Null
-  }
-  // We want the esp to be increased word by word, I don't know the size of bytes of char pointers in the arguments
-  // , so we did what we did
-  stack_pointer -= sizeof(char *);
-  memset(stack_pointer, 0, 1);
-
-  /*Now push the addresses of args in the stack*/
-
-  for (int j = argc - 1; j >= 0; j--)
-  {
-    stack_pointer -= sizeof(char *);
-    *(char **)stack_pointer = stack_arguments;
-    stack_arguments += (strlen(stack_arguments) + 1);
-  }
-  // Cast the stack pointer to a char** pointer to store the address of the first argument
-  char **address = (char **)stack_pointer;
-  // Decrement the stack pointer to make room for the char** pointer
-  stack_pointer -= sizeof(char **);
-  // Push the address of the first argument onto the stack
-  *(char ***)stack_pointer = address;
-
-  /*Now push the no. Arguments argc*/
-  stack_pointer -= sizeof(int);
-  *(int *)stack_pointer = argc;
-
-  /*Push Null as a return address till the user program edits it*/
-  stack_pointer -= sizeof(int *);
-  *(int **)stack_pointer = 0;
-
-  // Done
-
-  *esp = stack_pointer;
-  return;
+fail:
+  elf_image_release(image);
+  return NULL;
 }
 
-/* load() helpers. */
-
-static bool install_page(void *upage, void *kpage, bool writable);
-
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
 static bool
@@ -554,7 +1651,11 @@ validate_segment(const struct Elf32_Phdr *phdr, struct file *file)
    user process if WRITABLE is true, read-only otherwise.
 
    Return true if successful, false if a memory allocation error
-   or disk read error occurs. */
+   or disk read error occurs.
+
+   With VM, the pages are recorded in the supplemental page table
+   here, and page_prefetch() decides whether they are read in now
+   or by the page fault handler when first touched. */
 static bool
 load_segment(struct file *file, off_t ofs, uint8_t *upage,
              uint32_t read_bytes, uint32_t zero_bytes, bool writable)
@@ -563,7 +1664,29 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
   ASSERT(pg_ofs(upage) == 0);
   ASSERT(ofs % PGSIZE == 0);
 
-  file_seek(file, ofs);
+#ifdef VM
+  uint8_t *first_page = upage;
+  size_t page_cnt = (read_bytes + zero_bytes) / PGSIZE;
+  while (read_bytes > 0 || zero_bytes > 0)
+  {
+    size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+    size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+    if (!page_add_file(upage, file, ofs, page_read_bytes, writable))
+      return false;
+
+    /* Advance. */
+    read_bytes -= page_read_bytes;
+    zero_bytes -= page_zero_bytes;
+    ofs += page_read_bytes;
+    upage += PGSIZE;
+  }
+
+  // Small segments come in now, larger ones a block per fault
+  page_prefetch(first_page, page_cnt);
+  return true;
+#else
+
   while (read_bytes > 0 || zero_bytes > 0)
   {
     /* Calculate how to fill this page.
@@ -572,32 +1695,50 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
     size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
     size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-    /* Get a page of memory. */
-    uint8_t *kpage = palloc_get_page(PAL_USER);
-    if (kpage == NULL)
-      return false;
-
-    /* Load this page. */
-    if (file_read(file, kpage, page_read_bytes) != (int)page_read_bytes)
+    // Read-only pages of a file are shared with everyone running it
+    uint8_t *kpage = NULL;
+    if (!writable && page_read_bytes > 0)
+      kpage = share_acquire(file, ofs, page_read_bytes);
+    if (kpage != NULL)
     {
-      palloc_free_page(kpage);
-      return false;
+      uint32_t *pd = thread_current()->process->pagedir;
+      if (pagedir_get_page(pd, upage) != NULL || !pagedir_set_shared_page(pd, upage, kpage, false))
+      {
+        share_release(kpage);
+        return false;
+      }
     }
-    memset(kpage + page_read_bytes, 0, page_zero_bytes);
-
-    /* Add the page to the process's address space. */
-    if (!install_page(upage, kpage, writable))
+    else
     {
-      palloc_free_page(kpage);
-      return false;
+      /* Get a page of memory. */
+      kpage = palloc_get_page(PAL_USER);
+      if (kpage == NULL)
+        return false;
+
+      /* Load this page. */
+      if (file_read_at(file, kpage, page_read_bytes, ofs) != (int)page_read_bytes)
+      {
+        palloc_free_page(kpage);
+        return false;
+      }
+      memset(kpage + page_read_bytes, 0, page_zero_bytes);
+
+      /* Add the page to the process's address space. */
+      if (!install_page(upage, kpage, writable))
+      {
+        palloc_free_page(kpage);
+        return false;
+      }
     }
 
     /* Advance. */
     read_bytes -= page_read_bytes;
     zero_bytes -= page_zero_bytes;
+    ofs += page_read_bytes;
     upage += PGSIZE;
   }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -605,9 +1746,17 @@ load_segment(struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack(void **esp)
 {
-  uint8_t *kpage;
   bool success = false;
 
+#ifdef VM
+  // The stack page goes through the frame table so that it can be evicted
+  uint8_t *upage = ((uint8_t *)PHYS_BASE) - PGSIZE;
+  success = page_add_file(upage, NULL, 0, 0, true) && page_in(upage, true);
+  if (success)
+    *esp = PHYS_BASE;
+#else
+  uint8_t *kpage;
+
   kpage = palloc_get_page(PAL_USER | PAL_ZERO);
   if (kpage != NULL)
   {
@@ -617,9 +1766,33 @@ setup_stack(void **esp)
     else
       palloc_free_page(kpage);
   }
+#endif
   return success;
 }
 
+/* Maps the clock page read-only at CLOCK_PAGE_ADDR, so that the
+   process can read the time without a system call.  Without VM,
+   pagedir_copy() maps it into a forked child along with the rest.
+   Returns false if the address is already in use. */
+static bool
+map_clock_page(void)
+{
+  uint32_t *pd = thread_current()->process->pagedir;
+  void *upage = (void *)CLOCK_PAGE_ADDR;
+  void *kpage = clock_kpage();
+
+#ifdef VM
+  if (!page_is_free(upage))
+    return false;
+#endif
+  if (pagedir_get_page(pd, upage) != NULL
+      || !pagedir_set_shared_page(pd, upage, kpage, false))
+    return false;
+  share_reference(kpage);
+  return true;
+}
+
+#ifndef VM
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
@@ -636,5 +1809,6 @@ install_page(void *upage, void *kpage, bool writable)
 
   /* Verify that there's not already a page at that virtual
      address, then map our page there. */
-  return (pagedir_get_page(t->pagedir, upage) == NULL && pagedir_set_page(t->pagedir, upage, kpage, writable));
-}
\ No newline at end of file
+  return (pagedir_get_page(t->process->pagedir, upage) == NULL && pagedir_set_page(t->process->pagedir, upage, kpage, writable));
+}
+#endif
@@ -1,11 +1,130 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <hash.h>
+#include <list.h>
+#include <rlimit.h>
+#include <stdint.h>
+#include "threads/synch.h"
 #include "threads/thread.h"
 
-tid_t process_execute (const char *file_name);
+struct intr_frame;
+struct file;
+struct dir;
+struct files_opened;
+struct spawn_fd;
+struct bitmap;
+struct ring_sq;
+struct ring_cq;
+
+/* Most threads a process may have running besides its main
+   thread, each on a stack of its own below the main stack. */
+#define PROCESS_THREAD_MAX 32
+
+/* Slots in a process's first fd table, which is part of it. */
+#define FD_INLINE 16
+
+/* A user process: what all of its threads share.  Its main
+   thread is the one that loaded or forked it, whose tid is the
+   process's pid; thread_spawn() adds more.  Every thread of the
+   process points to it from its `process' member, and kernel
+   threads have none. */
+struct process
+  {
+    /* Serializes changes to the address space below and to the
+       thread bookkeeping.  Taken by page faults, so it must not
+       be held while touching user memory. */
+    struct lock lock;
+
+    /* Threads, protected by LOCK. */
+    struct thread *main;                /* Main thread. */
+    struct list threads;                /* Other threads, by elem of
+                                           struct user_thread. */
+    int thread_cnt;                     /* Threads yet to exit,
+                                           the main one included. */
+    uint32_t stack_slots;               /* Bit N set: stack slot N in
+                                           use. */
+    struct condition thread_exited;     /* Signalled when a thread
+                                           exits. */
+    bool exiting;                       /* exit() has been called. */
+    int exit_status;                    /* Status to report. */
+
+    /* Resource limits, and use of those not counted elsewhere. */
+    unsigned limits[RLIMIT_CNT];        /* Indexed by RLIMIT_*. */
+    unsigned cpu_ticks;                 /* Ticks run by its threads,
+                                           counted by thread_tick(). */
+    struct sched_group group;           /* Its threads' share of the
+                                           CPU, under "-group". */
+
+    /* Address space. */
+    uint32_t *pagedir;                  /* Page directory. */
+#ifdef VM
+    struct hash pages;                  /* Supplemental page table. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Identifier for the next
+                                           mapping. */
+    uint8_t *heap_start;                /* First byte of the heap,
+                                           page-aligned. */
+    uint8_t *heap_brk;                  /* End of the heap, moved by
+                                           sbrk(). */
+    size_t frame_cnt;                   /* Frames holding its pages,
+                                           under the frame table's
+                                           lock. */
+#endif
+    struct list shm_mappings;           /* Shared memory mappings. */
+    struct list aio_requests;           /* Uncollected asynchronous
+                                           I/O, protected by aio.c. */
+    int aio_next_id;                    /* Identifier for the next. */
+    struct list upcall_waiters;         /* Threads parked in
+                                           upcall_wait(), and */
+    int upcall_pending;                 /* wakeups kept for more, with
+                                           interrupts off. */
+
+    /* Files, protected by FILES_LOCK, which may be held while
+       touching user memory but not while taking LOCK otherwise. */
+    struct lock files_lock;
+    struct file *exe;                   /* Executable, write-denied. */
+    struct dir *cwd;                    /* Working directory, or NULL
+                                           for the root. */
+    struct files_opened **fd_table;     /* Open files indexed by fd. */
+    struct bitmap *fd_map;              /* Set bit means the fd is
+                                           taken. */
+    size_t fd_cap;                      /* Slots in fd_table and
+                                           fd_map. */
+    struct files_opened *fd_inline[FD_INLINE]; /* fd_table until more
+                                           fds are needed. */
+    uint32_t fd_map_inline[8];          /* Storage for fd_map until
+                                           then. */
+    char *stdout_buf;                   /* Pending fd 1 output,
+                                           allocated on first write. */
+    size_t stdout_len;                  /* Bytes held in stdout_buf. */
+    bool stdin_nonblock;                /* Console reads do not wait. */
+    struct ring_sq *ring_sq;            /* Rings registered by
+                                           ring_setup(), in user */
+    struct ring_cq *ring_cq;            /* memory, or NULL. */
+  };
+
+void process_init (void);
+tid_t process_execute (const char *cmd_line);
+tid_t process_execv (const char *file, char *const argv[]);
+tid_t process_spawn (const char *cmd_line);
+tid_t process_spawn_fds (const char *cmd_line, const struct spawn_fd *,
+                         int cnt);
+int process_spawn_status (tid_t);
+#ifdef VM
+tid_t process_restore (const char *file);
+#endif
+tid_t process_fork (struct intr_frame *);
 int process_wait (tid_t);
+tid_t process_wait_any (int *status);
 void process_exit (void);
 void process_activate (void);
 
-#endif /* userprog/process.h */
\ No newline at end of file
+tid_t process_thread_spawn (void (*eip) (void), void *fn, void *aux);
+int process_thread_join (tid_t);
+bool process_set_exit (int status);
+void process_check_exiting (void);
+void process_get_limits (unsigned limits[RLIMIT_CNT]);
+bool process_set_limit (int resource, unsigned limit);
+
+#endif /* userprog/process.h */
@@ -0,0 +1,226 @@
+#include "userprog/share.h"
+#include <debug.h>
+#include <hash.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A frame holding a read-only page of an executable, mapped by
+   every process that runs it.  The entry keeps the inode open
+   and denies writes to it, so the frame cannot go stale.  A
+   frame from share_alloc() has no inode and is only in
+   shared_kpages. */
+struct shared_page
+  {
+    struct hash_elem key_elem;          /* In shared_pages. */
+    struct hash_elem kpage_elem;        /* In shared_kpages. */
+    struct inode *inode;                /* File the page comes from,
+                                           or a null pointer. */
+    off_t ofs;                          /* Offset of page in file. */
+    size_t read_bytes;                  /* Bytes read; rest is zero. */
+    void *kpage;                        /* Frame. */
+    int ref_cnt;                        /* Number of mappings. */
+  };
+
+/* Shared pages, by inode, offset and length, and by frame. */
+static struct hash shared_pages;
+static struct hash shared_kpages;
+
+/* Protects both tables and the shared pages on them. */
+static struct lock share_lock;
+
+/* Returns a hash value for the key of shared page E. */
+static unsigned
+key_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct shared_page *sp = hash_entry (e, struct shared_page, key_elem);
+  return (hash_bytes (&sp->inode, sizeof sp->inode)
+          ^ hash_int (sp->ofs) ^ hash_int (sp->read_bytes));
+}
+
+/* Returns true if shared page A's key precedes B's. */
+static bool
+key_less (const struct hash_elem *a_, const struct hash_elem *b_,
+          void *aux UNUSED)
+{
+  const struct shared_page *a = hash_entry (a_, struct shared_page, key_elem);
+  const struct shared_page *b = hash_entry (b_, struct shared_page, key_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
+
+/* Returns a hash value for the frame of shared page E. */
+static unsigned
+kpage_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct shared_page *sp
+    = hash_entry (e, struct shared_page, kpage_elem);
+  return hash_bytes (&sp->kpage, sizeof sp->kpage);
+}
+
+/* Returns true if shared page A's frame precedes B's. */
+static bool
+kpage_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct shared_page, kpage_elem)->kpage
+          < hash_entry (b, struct shared_page, kpage_elem)->kpage);
+}
+
+/* Initializes the table of shared pages. */
+void
+share_init (void)
+{
+  if (!hash_init (&shared_pages, key_hash, key_less, NULL)
+      || !hash_init (&shared_kpages, kpage_hash, kpage_less, NULL))
+    PANIC ("share_init: out of memory");
+  lock_init_named (&share_lock, "share");
+}
+
+/* Returns a frame holding READ_BYTES bytes of FILE starting at
+   OFS followed by zeros, to be mapped read-only, reading it from
+   FILE only if no other mapping of the same page exists.  The
+   caller must give the frame back with share_release().  Returns
+   a null pointer if memory runs out or the read fails.  Only
+   kernels without VM load executables this way; with it, file
+   pages come from the page cache in vm/frame.c. */
+void *
+share_acquire (struct file *file, off_t ofs, size_t read_bytes)
+{
+  struct shared_page key, *sp;
+  struct hash_elem *e;
+
+  ASSERT (read_bytes <= PGSIZE);
+
+  /* Only files on disk are shared.  Others, such as tmpfs
+     files, have no inode to key the page by. */
+  key.inode = file_get_inode (file);
+  if (key.inode == NULL)
+    return NULL;
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+
+  lock_acquire (&share_lock);
+  e = hash_find (&shared_pages, &key.key_elem);
+  if (e != NULL)
+    {
+      sp = hash_entry (e, struct shared_page, key_elem);
+      sp->ref_cnt++;
+      lock_release (&share_lock);
+      return sp->kpage;
+    }
+
+  sp = malloc (sizeof *sp);
+  if (sp == NULL)
+    goto fail;
+  sp->kpage = palloc_get_page (PAL_USER);
+  if (sp->kpage == NULL)
+    goto fail;
+  if (file_read_at (file, sp->kpage, read_bytes, ofs) != (off_t) read_bytes)
+    goto fail;
+  memset ((uint8_t *) sp->kpage + read_bytes, 0, PGSIZE - read_bytes);
+
+  sp->inode = inode_reopen (key.inode);
+  inode_deny_write (sp->inode);
+  sp->ofs = ofs;
+  sp->read_bytes = read_bytes;
+  sp->ref_cnt = 1;
+  hash_insert (&shared_pages, &sp->key_elem);
+  hash_insert (&shared_kpages, &sp->kpage_elem);
+  lock_release (&share_lock);
+  return sp->kpage;
+
+ fail:
+  lock_release (&share_lock);
+  if (sp != NULL)
+    palloc_free_page (sp->kpage);
+  free (sp);
+  return NULL;
+}
+
+/* Returns a new zeroed frame from the user pool with one
+   reference, for memory that processes map writable and share,
+   or a null pointer if memory runs out.  share_release() drops
+   the reference. */
+void *
+share_alloc (void)
+{
+  struct shared_page *sp = malloc (sizeof *sp);
+
+  if (sp == NULL)
+    return NULL;
+  sp->kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (sp->kpage == NULL)
+    {
+      free (sp);
+      return NULL;
+    }
+  sp->inode = NULL;
+  sp->ofs = 0;
+  sp->read_bytes = 0;
+  sp->ref_cnt = 1;
+
+  lock_acquire (&share_lock);
+  hash_insert (&shared_kpages, &sp->kpage_elem);
+  lock_release (&share_lock);
+  return sp->kpage;
+}
+
+/* Adds a reference to KPAGE, which share_acquire() or
+   share_alloc() returned, for another mapping of it.
+   share_release() drops it. */
+void
+share_reference (void *kpage)
+{
+  struct shared_page key;
+  struct hash_elem *e;
+
+  key.kpage = kpage;
+
+  lock_acquire (&share_lock);
+  e = hash_find (&shared_kpages, &key.kpage_elem);
+  ASSERT (e != NULL);
+  hash_entry (e, struct shared_page, kpage_elem)->ref_cnt++;
+  lock_release (&share_lock);
+}
+
+/* Drops a reference to KPAGE, which share_acquire() or
+   share_alloc() returned, freeing it on the last one. */
+void
+share_release (void *kpage)
+{
+  struct shared_page key, *sp;
+  struct hash_elem *e;
+
+  key.kpage = kpage;
+
+  lock_acquire (&share_lock);
+  e = hash_find (&shared_kpages, &key.kpage_elem);
+  ASSERT (e != NULL);
+  sp = hash_entry (e, struct shared_page, kpage_elem);
+  if (--sp->ref_cnt > 0)
+    {
+      lock_release (&share_lock);
+      return;
+    }
+  if (sp->inode != NULL)
+    hash_delete (&shared_pages, &sp->key_elem);
+  hash_delete (&shared_kpages, &sp->kpage_elem);
+  lock_release (&share_lock);
+
+  if (sp->inode != NULL)
+    {
+      inode_allow_write (sp->inode);
+      inode_close (sp->inode);
+    }
+  palloc_free_page (sp->kpage);
+  free (sp);
+}
@@ -0,0 +1,15 @@
+#ifndef USERPROG_SHARE_H
+#define USERPROG_SHARE_H
+
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct file;
+
+void share_init (void);
+void *share_acquire (struct file *, off_t ofs, size_t read_bytes);
+void *share_alloc (void);
+void share_reference (void *kpage);
+void share_release (void *kpage);
+
+#endif /* userprog/share.h */
@@ -0,0 +1,466 @@
+#include "userprog/shm.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/share.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Largest shared memory object, in pages. */
+#define SHM_MAX_PAGES 1024
+
+/* A named shared memory object.  Its frames come from
+   share_alloc(), so every process that maps it sees the same
+   physical memory; the object holds one reference to each frame
+   and every mapping another, and the last one frees it.  The
+   frames stay off the frame table, so they are never evicted. */
+struct shm
+  {
+    struct list_elem elem;              /* Element in shm_objects. */
+    char name[NAME_MAX + 1];            /* Object name. */
+    int open_cnt;                       /* Number of openers. */
+    bool unlinked;                      /* True if deleted. */
+    off_t length;                       /* Size in bytes. */
+    size_t page_cnt;                    /* Number of elements in
+                                           KPAGES. */
+    void **kpages;                      /* Frames, fixed at creation. */
+  };
+
+/* A range of a process's address space mapped to an object. */
+struct shm_mapping
+  {
+    struct list_elem elem;              /* Element in the process's
+                                           shm_mappings. */
+    uint8_t *base;                      /* First page mapped. */
+    size_t page_cnt;                    /* Number of pages. */
+  };
+
+/* Objects that have names, and the lock that protects it along
+   with the open_cnt and unlinked members of every object. */
+static struct list shm_objects;
+static struct lock shm_lock;
+
+static const struct file_ops shm_ops;
+
+/* Initializes the table of shared memory objects, which starts
+   out empty. */
+void
+shm_init (void)
+{
+  list_init (&shm_objects);
+  lock_init (&shm_lock);
+}
+
+/* Returns the object named NAME, or a null pointer if there is
+   none.  The caller must hold shm_lock. */
+static struct shm *
+lookup (const char *name)
+{
+  struct list_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&shm_lock));
+  for (e = list_begin (&shm_objects); e != list_end (&shm_objects);
+       e = list_next (e))
+    {
+      struct shm *shm = list_entry (e, struct shm, elem);
+      if (!strcmp (shm->name, name))
+        return shm;
+    }
+  return NULL;
+}
+
+/* Frees SHM, dropping its references to its frames. */
+static void
+free_shm (struct shm *shm)
+{
+  size_t i;
+
+  for (i = 0; i < shm->page_cnt; i++)
+    if (shm->kpages[i] != NULL)
+      share_release (shm->kpages[i]);
+  free (shm->kpages);
+  free (shm);
+}
+
+/* Returns a new object named NAME, SIZE bytes long and initially
+   all zeros, or a null pointer if memory runs out. */
+static struct shm *
+create (const char *name, off_t size)
+{
+  struct shm *shm = calloc (1, sizeof *shm);
+  size_t i;
+
+  if (shm == NULL)
+    return NULL;
+  strlcpy (shm->name, name, sizeof shm->name);
+  shm->length = size;
+  shm->page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  shm->kpages = calloc (shm->page_cnt, sizeof *shm->kpages);
+  if (shm->kpages == NULL)
+    {
+      free (shm);
+      return NULL;
+    }
+  for (i = 0; i < shm->page_cnt; i++)
+    {
+      shm->kpages[i] = share_alloc ();
+      if (shm->kpages[i] == NULL)
+        {
+          free_shm (shm);
+          return NULL;
+        }
+    }
+  return shm;
+}
+
+/* Opens the shared memory object named NAME, first creating it
+   SIZE bytes long and all zeros if there is none; SIZE is
+   ignored otherwise.  The object can be read and written like a
+   file and mapped with shm_map().  Returns the new file if
+   successful, or a null pointer if NAME is empty or too long, if
+   there is no such object and SIZE is not positive or too big,
+   or if memory runs out. */
+struct file *
+shm_open (const char *name, off_t size)
+{
+  struct shm *shm;
+
+  if (*name == '\0' || strlen (name) > NAME_MAX)
+    return NULL;
+
+  lock_acquire (&shm_lock);
+  shm = lookup (name);
+  if (shm == NULL && size > 0
+      && DIV_ROUND_UP (size, PGSIZE) <= SHM_MAX_PAGES)
+    {
+      shm = create (name, size);
+      if (shm != NULL)
+        list_push_back (&shm_objects, &shm->elem);
+    }
+  if (shm != NULL)
+    shm->open_cnt++;
+  lock_release (&shm_lock);
+
+  return file_open_ops (&shm_ops, shm);
+}
+
+/* Deletes the name of the shared memory object NAME.  The object
+   is freed when the last opener closes it, and its memory when
+   the last mapping of it goes away too.  Returns true if
+   successful, false if there is no object named NAME. */
+bool
+shm_unlink (const char *name)
+{
+  struct shm *shm;
+  bool unused = false;
+
+  lock_acquire (&shm_lock);
+  shm = lookup (name);
+  if (shm != NULL)
+    {
+      list_remove (&shm->elem);
+      shm->unlinked = true;
+      unused = shm->open_cnt == 0;
+    }
+  lock_release (&shm_lock);
+
+  if (unused)
+    free_shm (shm);
+  return shm != NULL;
+}
+
+/* Returns true if UPAGE is a user page that process T has not
+   put to any use. */
+static bool
+is_free (struct process *t UNUSED, void *upage)
+{
+  if (!is_user_vaddr (upage))
+    return false;
+#ifdef VM
+  return page_is_free (upage);
+#else
+  return pagedir_get_page (t->pagedir, upage) == NULL;
+#endif
+}
+
+/* Unmaps the first PAGE_CNT pages at BASE from process T's page
+   directory, dropping their references. */
+static void
+unmap_pages (struct process *t, uint8_t *base, size_t page_cnt)
+{
+  size_t i;
+
+  pagedir_batch_begin ();
+  for (i = 0; i < page_cnt; i++)
+    {
+      void *upage = base + i * PGSIZE;
+      void *kpage = pagedir_get_page (t->pagedir, upage);
+
+      pagedir_clear_page (t->pagedir, upage);
+      share_release (kpage);
+    }
+  pagedir_batch_end ();
+}
+
+/* Maps the shared memory object open as FILE, all of it, into
+   the current process's address space at ADDR, writable.  Writes
+   there are seen at once by every other process that maps it.
+   The mapping outlives closing FILE, and a child forked later
+   inherits it.  Returns ADDR if successful, or a null pointer if
+   FILE is not a shared memory object, ADDR is null or not
+   page-aligned, any page of the range is already in use, or
+   memory allocation fails. */
+void *
+shm_map (struct file *file, void *addr)
+{
+  struct process *t = thread_current ()->process;
+  struct shm *shm = file_get_node (file, &shm_ops);
+  struct shm_mapping *m;
+  size_t i;
+
+  if (shm == NULL || addr == NULL || pg_ofs (addr) != 0)
+    return NULL;
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return NULL;
+  m->base = addr;
+  m->page_cnt = shm->page_cnt;
+
+  lock_acquire (&t->lock);
+  for (i = 0; i < m->page_cnt; i++)
+    if (!is_free (t, m->base + i * PGSIZE))
+      goto fail;
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      if (!pagedir_set_shared_page (t->pagedir, m->base + i * PGSIZE,
+                                    shm->kpages[i], true))
+        {
+          unmap_pages (t, m->base, i);
+          goto fail;
+        }
+      share_reference (shm->kpages[i]);
+    }
+  list_push_back (&t->shm_mappings, &m->elem);
+  lock_release (&t->lock);
+  return addr;
+
+ fail:
+  lock_release (&t->lock);
+  free (m);
+  return NULL;
+}
+
+/* Unmaps the shared memory mapping of the current process that
+   starts at ADDR.  Returns true if successful, false if no
+   mapping starts there. */
+bool
+shm_unmap (void *addr)
+{
+  struct process *t = thread_current ()->process;
+  struct list_elem *e;
+
+  lock_acquire (&t->lock);
+  for (e = list_begin (&t->shm_mappings); e != list_end (&t->shm_mappings);
+       e = list_next (e))
+    {
+      struct shm_mapping *m = list_entry (e, struct shm_mapping, elem);
+      if (m->base == addr)
+        {
+          list_remove (&m->elem);
+          unmap_pages (t, m->base, m->page_cnt);
+          lock_release (&t->lock);
+          free (m);
+          return true;
+        }
+    }
+  lock_release (&t->lock);
+  return false;
+}
+
+/* Gives the current process, just forked from PARENT, the shared
+   memory mappings PARENT has, at the same addresses and to the
+   same frames.  Without VM, pagedir_copy() has mapped the pages
+   already.  Returns false if memory runs out. */
+bool
+shm_fork (struct process *parent)
+{
+  struct process *t = thread_current ()->process;
+  struct list_elem *e;
+  bool success = false;
+
+  lock_acquire (&parent->lock);
+  for (e = list_begin (&parent->shm_mappings);
+       e != list_end (&parent->shm_mappings); e = list_next (e))
+    {
+      struct shm_mapping *pm = list_entry (e, struct shm_mapping, elem);
+      struct shm_mapping *m = malloc (sizeof *m);
+
+      if (m == NULL)
+        goto done;
+      m->base = pm->base;
+      m->page_cnt = pm->page_cnt;
+#ifdef VM
+      {
+        size_t i;
+
+        for (i = 0; i < m->page_cnt; i++)
+          {
+            void *upage = m->base + i * PGSIZE;
+            void *kpage = pagedir_get_page (parent->pagedir, upage);
+
+            if (!pagedir_set_shared_page (t->pagedir, upage, kpage, true))
+              {
+                unmap_pages (t, m->base, i);
+                free (m);
+                goto done;
+              }
+            share_reference (kpage);
+          }
+      }
+#endif
+      list_push_back (&t->shm_mappings, &m->elem);
+    }
+  success = true;
+
+ done:
+  lock_release (&parent->lock);
+  return success;
+}
+
+/* Unmaps all of the current process's shared memory mappings.
+   Called when it exits, before its page directory goes. */
+void
+shm_unmap_all (void)
+{
+  struct process *t = thread_current ()->process;
+
+  while (!list_empty (&t->shm_mappings))
+    {
+      struct shm_mapping *m
+        = list_entry (list_pop_front (&t->shm_mappings),
+                      struct shm_mapping, elem);
+      unmap_pages (t, m->base, m->page_cnt);
+      free (m);
+    }
+}
+
+/* File operations on shared memory objects.  As with tmpfs,
+   reads and writes see the same bytes the mappings do. */
+
+static off_t
+shm_read_at (void *shm_, void *buffer_, off_t size, off_t offset)
+{
+  struct shm *shm = shm_;
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  while (size > 0 && offset < shm->length)
+    {
+      int page_ofs = offset % PGSIZE;
+      off_t chunk = PGSIZE - page_ofs;
+
+      if (chunk > size)
+        chunk = size;
+      if (chunk > shm->length - offset)
+        chunk = shm->length - offset;
+      memcpy (buffer + bytes_read,
+              (uint8_t *) shm->kpages[offset / PGSIZE] + page_ofs, chunk);
+
+      size -= chunk;
+      offset += chunk;
+      bytes_read += chunk;
+    }
+  return bytes_read;
+}
+
+/* Objects have a fixed size, so writes stop at the end. */
+static off_t
+shm_write_at (void *shm_, const void *buffer_, off_t size, off_t offset)
+{
+  struct shm *shm = shm_;
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = 0;
+
+  while (size > 0 && offset < shm->length)
+    {
+      int page_ofs = offset % PGSIZE;
+      off_t chunk = PGSIZE - page_ofs;
+
+      if (chunk > size)
+        chunk = size;
+      if (chunk > shm->length - offset)
+        chunk = shm->length - offset;
+      memcpy ((uint8_t *) shm->kpages[offset / PGSIZE] + page_ofs,
+              buffer + bytes_written, chunk);
+
+      size -= chunk;
+      offset += chunk;
+      bytes_written += chunk;
+    }
+  return bytes_written;
+}
+
+static off_t
+shm_length (void *shm_)
+{
+  struct shm *shm = shm_;
+  return shm->length;
+}
+
+static void *
+shm_reopen (void *shm_)
+{
+  struct shm *shm = shm_;
+
+  lock_acquire (&shm_lock);
+  shm->open_cnt++;
+  lock_release (&shm_lock);
+  return shm;
+}
+
+static void
+shm_close (void *shm_)
+{
+  struct shm *shm = shm_;
+  bool unused;
+
+  lock_acquire (&shm_lock);
+  unused = --shm->open_cnt == 0 && shm->unlinked;
+  lock_release (&shm_lock);
+
+  if (unused)
+    free_shm (shm);
+}
+
+/* Writes cannot be denied, any more than stores to a mapping. */
+static void
+shm_deny_write (void *shm_ UNUSED)
+{
+}
+
+static void
+shm_allow_write (void *shm_ UNUSED)
+{
+}
+
+static const struct file_ops shm_ops =
+  {
+    shm_read_at,
+    shm_write_at,
+    shm_length,
+    shm_reopen,
+    shm_close,
+    shm_deny_write,
+    shm_allow_write,
+    NULL
+  };
@@ -0,0 +1,18 @@
+#ifndef USERPROG_SHM_H
+#define USERPROG_SHM_H
+
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct process;
+
+void shm_init (void);
+struct file *shm_open (const char *name, off_t size);
+bool shm_unlink (const char *name);
+void *shm_map (struct file *, void *addr);
+bool shm_unmap (void *addr);
+bool shm_fork (struct process *parent);
+void shm_unmap_all (void);
+
+#endif /* userprog/shm.h */
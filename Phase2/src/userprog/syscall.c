@@ -1,486 +1,2551 @@
 #include <stdio.h>
+#include <string.h>
+#include <bitmap.h>
+#include <dirent.h>
+#include <clock.h>
+#include <klog.h>
 #include <syscall-nr.h>
+#include <syscall-ring.h>
+#include <iovec.h>
+#include <poll.h>
+#include <round.h>
+#include <rlimit.h>
+#include <rusage.h>
+#include <spawn.h>
+#include <memstat.h>
+#include <stats.h>
+#include <threadinfo.h>
+#include "devices/clock.h"
+#include "devices/timer.h"
+#include "devices/tty.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/synch.h"
+#include "threads/tsc.h"
 #include "threads/vaddr.h"
+#include "threads/waitq.h"
 #include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/rcu.h"
 #include "userprog/syscall.h"
+#include "userprog/sysenter.h"
+#include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "filesys/pipe.h"
+#include "userprog/shm.h"
+#include "userprog/aio.h"
 #include "userprog/process.h"
+#include "userprog/futex.h"
+#include "userprog/upcall.h"
+#ifdef VM
+#include "vm/checkpoint.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 
-struct lock global_lock;
+#define STDOUT_BUF_SIZE 256 // bytes of fd 1 output held back per process
+#define FD_MAX 1024         // dup2 does not grow the table past this
 
 // Validations in the method required by eng el Ta7an
 
 // bool validate_stack_pointer(struct intr_frame *f);
 bool validate_address_in_virtual_memory(void *add);
-static void syscall_handler(struct intr_frame *f UNUSED);
-bool valid_esp(struct intr_frame *f);
+bool validate_user_buffer(const void *buffer, unsigned size, bool write);
+bool validate_user_string(const char *str);
+static void syscall_handler(struct intr_frame *f);
+static void syscall_stats_init(void);
 struct files_opened *sys_file_helper(int fd);
+void sys_file_put(struct files_opened *file);
+static bool fd_has_file(int fd);
+static bool fd_table_grow(struct process *t);
+static void fd_table_free(struct process *t);
+static int fd_alloc(struct files_opened *file);
+static struct inode *dir_inode_helper(struct files_opened *file);
+static int nonblock_write(struct file *, const void *buffer, unsigned size);
+static int fd_poll(int fd, struct waitq_entry *entry);
+static void stdout_write(const char *buffer, size_t size);
+static void stdout_flush(struct process *t);
+#ifdef VM
+static unsigned sys_read_pages(struct file *, void *buffer, unsigned size,
+                               off_t ofs);
+#endif
+static int iovec_copy_in(struct iovec *iov, const struct iovec *uiov, int cnt,
+                         bool write);
+
+// files_opened entries come and go with every open and close
+static struct kmem_cache *files_opened_cache;
 
 void syscall_init(void)
 {
   intr_register_int(0x30, 3, INTR_ON, syscall_handler, "syscall");
-  lock_init(&global_lock);
+  sysenter_init();
+  files_opened_cache = kmem_cache_create("files_opened", sizeof(struct files_opened));
+  syscall_stats_init();
+}
+
+/* Reads a byte at user virtual address uaddr, which must be below
+   PHYS_BASE. Returns the byte value if successful, -1 if a page
+   fault occurred: page_fault finds the load in the .user_fixup
+   table and resumes after it, with -1 in eax. */
+static int get_user(const uint8_t *uaddr)
+{
+  int result;
+  asm("1: movzbl %1, %0; 2:\n"
+      ".pushsection .user_fixup, \"a\"\n"
+      ".long 1b, 2b\n"
+      ".popsection"
+      : "=a"(result)
+      : "m"(*uaddr));
+  return result;
 }
 
-bool valid_esp(struct intr_frame *f)
+/* Writes byte to user address udst, which must be below PHYS_BASE.
+   Returns true if successful, false if a page fault occurred. */
+static bool put_user(uint8_t *udst, uint8_t byte)
 {
-  return validate_address_in_virtual_memory((int *)f->esp) || ((*(int *)f->esp) < 0) || (*(int *)f->esp) > 12;
+  int error_code;
+  asm("movl $0, %0\n"
+      "1: movb %b2, %1; 2:\n"
+      ".pushsection .user_fixup, \"a\"\n"
+      ".long 1b, 2b\n"
+      ".popsection"
+      : "=&a"(error_code), "=m"(*udst)
+      : "q"(byte));
+  return error_code != -1;
 }
 
 /*Is this thing in memory actually*/
 bool validate_address_in_virtual_memory(void *val)
 {
-  return val != NULL && is_user_vaddr(val) && pagedir_get_page(thread_current()->pagedir, val) != NULL;
+  return val != NULL && is_user_vaddr(val) && get_user(val) != -1;
 }
 
-struct files_opened *sys_file_helper(int fd)
+/* Checks that all size bytes at buffer are user memory the process
+   may read, or write if write is true, by touching one byte in
+   each page. Under VM the touch also brings each page in. After
+   this the kernel may access the buffer directly. */
+bool validate_user_buffer(const void *buffer, unsigned size, bool write)
 {
-  struct list *list_of_files = &(thread_current()->files_opened_by_me);
-  for (struct list_elem *cur = list_begin(list_of_files); cur != list_end(list_of_files); cur = list_next(cur))
+  const uint8_t *start = buffer;
+  const uint8_t *end = start + size;
+  if (size == 0)
+  {
+    return true;
+  }
+  if (start == NULL || end < start || !is_user_vaddr(end - 1))
+  {
+    return false;
+  }
+  for (const uint8_t *page = pg_round_down(start); page < end; page += PGSIZE)
   {
-    struct files_opened *cur_file = list_entry(cur, struct files_opened, elem);
-    if ((cur_file->file_descriptor) == fd)
+    uint8_t *probe = (uint8_t *)(page < start ? start : page);
+    int byte = get_user(probe);
+    if (byte == -1 || (write && !put_user(probe, byte)))
     {
-      return cur_file;
+      return false;
     }
   }
-  return NULL;
+  return true;
 }
 
-static void
-syscall_handler(struct intr_frame *f UNUSED)
+// Like validate_user_buffer for a null-terminated string
+bool validate_user_string(const char *str)
 {
-  if (!valid_esp(f))
+  const uint8_t *p = (const uint8_t *)str;
+  int byte;
+  do
   {
-    sys_exit(-1);
-  }
+    if (p == NULL || !is_user_vaddr(p) || (byte = get_user(p)) == -1)
+    {
+      return false;
+    }
+    p++;
+  } while (byte != '\0');
+  return true;
+}
 
-  // We will read only one integer telling me what operation is to be executed
-  switch (*(int *)f->esp)
-  {
+/* A heap fd table, with room for call_rcu() to free it once no
+   thread can still be reading it. */
+struct fd_array
+{
+  struct rcu_head rcu;
+  struct files_opened *slots[];
+};
 
-  case SYS_HALT:
-  {
-    system_halt_wrapper(f);
-    break;
-  }
-  case SYS_EXIT:
+/* The fd_array whose slots are table. */
+static struct fd_array *fd_array_of(struct files_opened **table)
+{
+  return (struct fd_array *)((uint8_t *)table -
+                             offsetof(struct fd_array, slots));
+}
+
+/* Frees an fd table that has been replaced, once readers are done. */
+static void fd_array_free(struct rcu_head *rcu)
+{
+  free((uint8_t *)rcu - offsetof(struct fd_array, rcu));
+}
+
+/* The open file behind fd, or NULL. fd indexes the table directly.
+   The table is shared by the process's threads and changed under
+   their files_lock, but looked at without it: fd_table_grow() sets
+   fd_table before fd_cap and frees a replaced table only after an
+   RCU grace period. The entry comes with a reference that the caller
+   gives back with sys_file_put(), so another thread closing fd
+   meanwhile only takes it out of the table. The reference is taken
+   inside the read-side section, and not once the count has reached
+   zero, which is why the last put frees the entry through call_rcu(). */
+struct files_opened *sys_file_helper(int fd)
+{
+  struct process *p = thread_current()->process;
+  struct files_opened *file = NULL;
+  rcu_read_lock();
+  if (fd >= 0 && (size_t)fd < rcu_dereference(p->fd_cap))
   {
-    system_exit_wrapper(f);
-    break;
+    file = rcu_dereference(p->fd_table)[fd];
+    if (file != NULL)
+    {
+      enum intr_level old_level = intr_disable();
+      if (file->ref_cnt > 0)
+        file->ref_cnt++;
+      else
+        file = NULL; // Closed, waiting for the grace period
+      intr_set_level(old_level);
+    }
   }
-  case SYS_EXEC:
+  rcu_read_unlock();
+  return file;
+}
+
+/* Frees an fd entry whose last reference is gone, once lookups that
+   found it before then are done. */
+static void files_opened_free(struct rcu_head *rcu)
+{
+  kmem_cache_free(files_opened_cache,
+                  (uint8_t *)rcu - offsetof(struct files_opened, rcu));
+}
+
+/* Drops a reference to file, taken by sys_file_helper() or held by
+   the fd table, closing it on the last. file may be NULL. */
+void sys_file_put(struct files_opened *file)
+{
+  if (file == NULL)
   {
-    system_exec_wrapper(f);
-    break;
+    return;
   }
-  case SYS_WAIT:
+  enum intr_level old_level = intr_disable();
+  bool last = --file->ref_cnt == 0;
+  intr_set_level(old_level);
+  if (last)
   {
-    system_wait_wrapper(f);
-    break;
+    file_close(file->f);
+    call_rcu(&file->rcu, files_opened_free);
   }
-  case SYS_CREATE:
+}
+
+// Whether the current process has a file at fd, rather than the console
+static bool fd_has_file(int fd)
+{
+  struct files_opened *file = sys_file_helper(fd);
+  sys_file_put(file);
+  return file != NULL;
+}
+
+/* Doubles the fd table of process t. On the first open it sets up
+   the FD_INLINE slots kept in the process itself, so that a process
+   that never has more files open than that opens and closes them
+   without touching the heap. Slots 0 and 1 are kept taken for stdin
+   and stdout. */
+static bool fd_table_grow(struct process *t)
+{
+  if (t->fd_cap == 0)
   {
-    system_create_wrapper(f);
-    break;
+    memset(t->fd_inline, 0, sizeof t->fd_inline);
+    t->fd_map = bitmap_create_in_buf(FD_INLINE, t->fd_map_inline,
+                                     sizeof t->fd_map_inline);
+    bitmap_mark(t->fd_map, 0);
+    bitmap_mark(t->fd_map, 1);
+    rcu_assign_pointer(t->fd_table, t->fd_inline);
+    rcu_assign_pointer(t->fd_cap, FD_INLINE);
+    return true;
   }
-  case SYS_REMOVE:
+
+  size_t new_cap = t->fd_cap * 2;
+  struct fd_array *array = malloc(sizeof *array +
+                                  new_cap * sizeof *array->slots);
+  struct bitmap *map = bitmap_create(new_cap);
+  if (array == NULL || map == NULL)
   {
-    system_remove_wrapper(f);
-    break;
+    free(array);
+    bitmap_destroy(map);
+    return false;
   }
-  case SYS_OPEN:
+  struct files_opened **table = array->slots;
+  struct files_opened **old_table = t->fd_table;
+  struct bitmap *old_map = t->fd_map;
+  memcpy(table, old_table, t->fd_cap * sizeof *table);
+  memset(table + t->fd_cap, 0, (new_cap - t->fd_cap) * sizeof *table);
+  for (size_t i = 0; i < t->fd_cap; i++)
   {
-    system_open_wrapper(f);
-    break;
+    bitmap_set(map, i, bitmap_test(old_map, i));
   }
-  case SYS_FILESIZE:
+  t->fd_map = map;
+  rcu_assign_pointer(t->fd_table, table);
+  rcu_assign_pointer(t->fd_cap, new_cap);
+  if (old_table != t->fd_inline)
   {
-    system_filesize_wrapper(f);
-    break;
+    call_rcu(&fd_array_of(old_table)->rcu, fd_array_free);
+    bitmap_destroy(old_map);
   }
+  return true;
+}
 
-  case SYS_READ:
-  {
-    system_read_wrapper(f);
-    break;
-  }
-  case SYS_WRITE:
+/* Frees the fd table of process t and its map, unless they are the
+   ones kept in the process itself. Only for a process whose other
+   threads are gone. */
+static void fd_table_free(struct process *t)
+{
+  if (t->fd_table != t->fd_inline)
   {
-    system_write_wrapper(f);
-    break;
+    free(fd_array_of(t->fd_table));
+    bitmap_destroy(t->fd_map);
   }
-  case SYS_TELL:
+}
+
+/* Gives file the lowest free fd of the current process, so closed
+   fds get reused. Returns -1 if the table cannot grow or the fd
+   would reach the process's RLIMIT_NOFILE. */
+static int fd_alloc(struct files_opened *file)
+{
+  struct process *t = thread_current()->process;
+  size_t fd = BITMAP_ERROR;
+  lock_acquire(&t->files_lock);
+  if (t->fd_map != NULL)
   {
-    sys_tell(f);
-    break;
+    fd = bitmap_scan_and_flip(t->fd_map, 0, 1, false);
   }
-  case SYS_SEEK:
+  if (fd == BITMAP_ERROR)
   {
-    sys_seek(f);
-    break;
+    if (!fd_table_grow(t))
+    {
+      lock_release(&t->files_lock);
+      return -1;
+    }
+    fd = bitmap_scan_and_flip(t->fd_map, 0, 1, false);
   }
-  case SYS_CLOSE:
+  if (fd >= t->limits[RLIMIT_NOFILE])
   {
-    system_close_wrapper(f);
-    break;
-  }
-  default:
-    break;
+    bitmap_reset(t->fd_map, fd);
+    lock_release(&t->files_lock);
+    return -1;
   }
+  file->file_descriptor = fd;
+  file->nonblock = false;
+  file->ref_cnt = 1;
+  rcu_assign_pointer(t->fd_table[fd], file);
+  lock_release(&t->files_lock);
+  return fd;
 }
 
-void system_halt_wrapper(struct intr_frame *f)
+// sysenter_entry in sysenter-stub.S comes here with the same frame int 0x30 makes
+void syscall_sysenter(struct intr_frame *f)
 {
-  sys_halt();
+  syscall_handler(f);
 }
 
-void sys_halt()
+// An argument word, once the common prologue has checked it
+union syscall_arg
 {
-  shutdown_power_off();
-}
+  int i;
+  unsigned u;
+  void *p;
+  const char *s;
+};
+
+// Carries out a call with checked arguments, returning what goes in eax
+typedef uint32_t syscall_func(struct intr_frame *, const union syscall_arg *);
 
-void system_exit_wrapper(struct intr_frame *f)
+// How the common prologue checks an argument word before the call sees it
+enum syscall_arg_kind
 {
+  ARG_INT,   // Any value
+  ARG_STR,   // A null-terminated string it may read
+  ARG_PTR,   // A pointer the call checks itself, or leaves to others
+  ARG_IN,    // SIZE bytes it may read
+  ARG_OUT,   // SIZE bytes it may write
+  ARG_IN_N,  // Readable, SIZE bytes times the next argument
+  ARG_OUT_N, // Writable, SIZE bytes times the next argument
+};
 
-  int *status_pointer = (int *) ((int *)f->esp + 1);
-  if (!validate_address_in_virtual_memory(status_pointer))
-  {
-    f->eax = -1;
-    sys_exit(-1);
-  }
+struct syscall_arg_spec
+{
+  uint8_t kind;  // enum syscall_arg_kind
+  uint16_t size; // For ARG_IN and the rest, as above
+};
 
-  f->eax = *status_pointer;
-  sys_exit(*status_pointer);
-}
+#define A_INT {ARG_INT, 0}
+#define A_STR {ARG_STR, 0}
+#define A_PTR {ARG_PTR, 0}
+#define A_IN(SIZE) {ARG_IN, (SIZE)}
+#define A_OUT(SIZE) {ARG_OUT, (SIZE)}
+#define A_IN_N(SIZE) {ARG_IN_N, (SIZE)}
+#define A_OUT_N(SIZE) {ARG_OUT_N, (SIZE)}
 
-void sys_exit(int status)
+#define SYSCALL_ARGS_MAX 4
+
+// A call, its name for the statistics, and what its arguments must be
+struct syscall_desc
 {
-  struct thread *t = thread_current();
-  char* name= t->name;
-  char * save_ptr;
-  char * exe = strtok_r (name, " ", &save_ptr);
+  syscall_func *func;
+  const char *name;
+  uint8_t argc; // Words of arguments above the number
+  struct syscall_arg_spec args[SYSCALL_ARGS_MAX];
+};
 
+static syscall_func system_halt_wrapper, system_exit_wrapper,
+    system_exec_wrapper, system_wait_wrapper, system_create_wrapper,
+    system_remove_wrapper, system_open_wrapper, system_filesize_wrapper,
+    system_read_wrapper, system_write_wrapper, system_seek_wrapper,
+    system_tell_wrapper, system_close_wrapper, system_dir_wrapper,
+    system_readdir_wrapper, system_isdir_wrapper, system_inumber_wrapper,
+    system_fork_wrapper, system_ring_setup_wrapper, system_submit_wrapper,
+    system_ttymode_wrapper, system_pread_wrapper, system_pwrite_wrapper,
+    system_readv_wrapper, system_writev_wrapper, system_copy_wrapper,
+    system_execv_wrapper, system_spawn_wrapper, system_spawn_status_wrapper,
+    system_wait_any_wrapper, system_set_affinity_wrapper,
+    system_getrusage_wrapper, system_uptime_wrapper, system_cycles_wrapper,
+    system_memstat_wrapper, system_stats_wrapper, system_sbrk_wrapper,
+    system_thread_spawn_wrapper, system_thread_join_wrapper,
+    system_thread_exit_wrapper, system_futex_wrapper, system_pipe_wrapper,
+    system_dup2_wrapper, system_shm_wrapper, system_shm_map_wrapper,
+    system_shm_unmap_wrapper, system_poll_wrapper,
+    system_set_nonblock_wrapper, system_aio_wrapper, system_aio_wait_wrapper,
+    system_getrlimit_wrapper, system_setrlimit_wrapper,
+    system_readdir_plus_wrapper, system_clock_gettime_wrapper,
+    system_klog_wrapper, system_threadinfo_wrapper, system_upcall_wrapper,
+    system_fallocate_wrapper, system_fsync_wrapper, system_spawn_fds_wrapper,
+    system_create_many_wrapper, system_remove_many_wrapper,
+    system_stat_many_wrapper;
+#ifdef VM
+static syscall_func system_mmap_wrapper, system_munmap_wrapper,
+    system_checkpoint_wrapper, system_restore_wrapper;
+#endif
 
-  t->exit_status = status;
+// By number. A number with no entry does nothing
+static const struct syscall_desc syscall_table[] = {
+    [SYS_HALT] = {system_halt_wrapper, "halt", 0, {}},
+    [SYS_EXIT] = {system_exit_wrapper, "exit", 1, {A_INT}},
+    [SYS_EXEC] = {system_exec_wrapper, "exec", 1, {A_STR}},
+    [SYS_WAIT] = {system_wait_wrapper, "wait", 1, {A_INT}},
+    [SYS_CREATE] = {system_create_wrapper, "create", 2, {A_STR, A_INT}},
+    [SYS_REMOVE] = {system_remove_wrapper, "remove", 1, {A_STR}},
+    [SYS_OPEN] = {system_open_wrapper, "open", 1, {A_STR}},
+    [SYS_FILESIZE] = {system_filesize_wrapper, "filesize", 1, {A_INT}},
+    [SYS_READ] = {system_read_wrapper, "read", 3,
+                  {A_INT, A_OUT_N(1), A_INT}},
+    [SYS_WRITE] = {system_write_wrapper, "write", 3,
+                   {A_INT, A_IN_N(1), A_INT}},
+    [SYS_SEEK] = {system_seek_wrapper, "seek", 2, {A_INT, A_INT}},
+    [SYS_TELL] = {system_tell_wrapper, "tell", 1, {A_INT}},
+    [SYS_CLOSE] = {system_close_wrapper, "close", 1, {A_INT}},
+#ifdef VM
+    [SYS_MMAP] = {system_mmap_wrapper, "mmap", 2, {A_INT, A_PTR}},
+    [SYS_MUNMAP] = {system_munmap_wrapper, "munmap", 1, {A_INT}},
+#endif
+    [SYS_CHDIR] = {system_dir_wrapper, "chdir", 1, {A_STR}},
+    [SYS_MKDIR] = {system_dir_wrapper, "mkdir", 1, {A_STR}},
+    [SYS_READDIR] = {system_readdir_wrapper, "readdir", 2,
+                     {A_INT, A_OUT(NAME_MAX + 1)}},
+    [SYS_ISDIR] = {system_isdir_wrapper, "isdir", 1, {A_INT}},
+    [SYS_INUMBER] = {system_inumber_wrapper, "inumber", 1, {A_INT}},
+    [SYS_FORK] = {system_fork_wrapper, "fork", 0, {}},
+    [SYS_RING_SETUP] = {system_ring_setup_wrapper, "ring_setup", 2,
+                        {A_PTR, A_PTR}},
+    [SYS_SUBMIT] = {system_submit_wrapper, "submit", 0, {}},
+    [SYS_TTYMODE] = {system_ttymode_wrapper, "ttymode", 1, {A_INT}},
+    [SYS_PREAD] = {system_pread_wrapper, "pread", 4,
+                   {A_INT, A_OUT_N(1), A_INT, A_INT}},
+    [SYS_PWRITE] = {system_pwrite_wrapper, "pwrite", 4,
+                    {A_INT, A_IN_N(1), A_INT, A_INT}},
+    [SYS_READV] = {system_readv_wrapper, "readv", 3, {A_INT, A_PTR, A_INT}},
+    [SYS_WRITEV] = {system_writev_wrapper, "writev", 3,
+                    {A_INT, A_PTR, A_INT}},
+    [SYS_COPY] = {system_copy_wrapper, "copy", 3, {A_INT, A_INT, A_INT}},
+    [SYS_EXECV] = {system_execv_wrapper, "execv", 2, {A_STR, A_PTR}},
+    [SYS_SPAWN] = {system_spawn_wrapper, "spawn", 1, {A_STR}},
+    [SYS_SPAWN_STATUS] = {system_spawn_status_wrapper, "spawn_status", 1,
+                          {A_INT}},
+    [SYS_WAIT_ANY] = {system_wait_any_wrapper, "wait_any", 1, {A_PTR}},
+    [SYS_SET_AFFINITY] = {system_set_affinity_wrapper, "set_affinity", 1,
+                          {A_INT}},
+    [SYS_GETRUSAGE] = {system_getrusage_wrapper, "getrusage", 3,
+                       {A_INT, A_OUT_N(sizeof(struct rusage)), A_INT}},
+    [SYS_UPTIME] = {system_uptime_wrapper, "uptime", 0, {}},
+    [SYS_CYCLES] = {system_cycles_wrapper, "cycles", 1,
+                    {A_OUT(sizeof(uint64_t))}},
+    [SYS_MEMSTAT] = {system_memstat_wrapper, "memstat", 1, {A_PTR}},
+    [SYS_STATS] = {system_stats_wrapper, "stats", 0, {}},
+    [SYS_SBRK] = {system_sbrk_wrapper, "sbrk", 1, {A_INT}},
+    [SYS_THREAD_SPAWN] = {system_thread_spawn_wrapper, "thread_spawn", 3,
+                          {A_PTR, A_PTR, A_PTR}},
+    [SYS_THREAD_JOIN] = {system_thread_join_wrapper, "thread_join", 1,
+                         {A_INT}},
+    [SYS_THREAD_EXIT] = {system_thread_exit_wrapper, "thread_exit", 0, {}},
+    [SYS_FUTEX_WAIT] = {system_futex_wrapper, "futex_wait", 2,
+                        {A_IN(sizeof(int)), A_INT}},
+    [SYS_FUTEX_WAKE] = {system_futex_wrapper, "futex_wake", 2,
+                        {A_IN(sizeof(int)), A_INT}},
+    [SYS_PIPE] = {system_pipe_wrapper, "pipe", 1, {A_OUT(2 * sizeof(int))}},
+    [SYS_DUP2] = {system_dup2_wrapper, "dup2", 2, {A_INT, A_INT}},
+    [SYS_SHM_OPEN] = {system_shm_wrapper, "shm_open", 2, {A_STR, A_INT}},
+    [SYS_SHM_UNLINK] = {system_shm_wrapper, "shm_unlink", 1, {A_STR}},
+    [SYS_SHM_MAP] = {system_shm_map_wrapper, "shm_map", 2, {A_INT, A_PTR}},
+    [SYS_SHM_UNMAP] = {system_shm_unmap_wrapper, "shm_unmap", 1, {A_PTR}},
+    [SYS_POLL] = {system_poll_wrapper, "poll", 3, {A_PTR, A_INT, A_INT}},
+    [SYS_SET_NONBLOCK] = {system_set_nonblock_wrapper, "set_nonblock", 2,
+                          {A_INT, A_INT}},
+    [SYS_AIO_READ] = {system_aio_wrapper, "aio_read", 4,
+                      {A_INT, A_OUT_N(1), A_INT, A_INT}},
+    [SYS_AIO_WRITE] = {system_aio_wrapper, "aio_write", 4,
+                       {A_INT, A_IN_N(1), A_INT, A_INT}},
+    [SYS_AIO_WAIT] = {system_aio_wait_wrapper, "aio_wait", 1, {A_INT}},
+    [SYS_GETRLIMIT] = {system_getrlimit_wrapper, "getrlimit", 1, {A_INT}},
+    [SYS_SETRLIMIT] = {system_setrlimit_wrapper, "setrlimit", 2,
+                       {A_INT, A_INT}},
+    [SYS_READDIR_PLUS] = {system_readdir_plus_wrapper, "readdir_plus", 3,
+                          {A_INT, A_OUT_N(sizeof(struct dirent_plus)),
+                           A_INT}},
+    [SYS_CLOCK_GETTIME] = {system_clock_gettime_wrapper, "clock_gettime", 2,
+                           {A_INT, A_OUT(sizeof(struct timespec))}},
+    [SYS_KLOG] = {system_klog_wrapper, "klog", 3,
+                  {A_OUT(sizeof(unsigned)), A_OUT_N(1), A_INT}},
+    [SYS_THREADINFO] = {system_threadinfo_wrapper, "threadinfo", 2,
+                        {A_OUT_N(sizeof(struct threadinfo)), A_INT}},
+    [SYS_UPCALL_WAIT] = {system_upcall_wrapper, "upcall_wait", 0, {}},
+    [SYS_UPCALL_WAKE] = {system_upcall_wrapper, "upcall_wake", 1, {A_INT}},
+    [SYS_FALLOCATE] = {system_fallocate_wrapper, "fallocate", 2,
+                       {A_INT, A_INT}},
+    [SYS_FSYNC] = {system_fsync_wrapper, "fsync", 1, {A_INT}},
+    [SYS_SPAWN_FDS] = {system_spawn_fds_wrapper, "spawn_fds", 3,
+                       {A_STR, A_IN_N(sizeof(struct spawn_fd)), A_INT}},
+    [SYS_CREATE_MANY] = {system_create_many_wrapper, "create_many", 4,
+                         {A_PTR, A_INT, A_OUT_N(sizeof(bool)), A_INT}},
+    [SYS_REMOVE_MANY] = {system_remove_many_wrapper, "remove_many", 3,
+                         {A_PTR, A_OUT_N(sizeof(bool)), A_INT}},
+    [SYS_STAT_MANY] = {system_stat_many_wrapper, "stat_many", 3,
+                       {A_PTR, A_OUT_N(sizeof(struct dirent_plus)), A_INT}},
+#ifdef VM
+    [SYS_CHECKPOINT] = {system_checkpoint_wrapper, "checkpoint", 1, {A_INT}},
+    [SYS_RESTORE] = {system_restore_wrapper, "restore", 1, {A_STR}},
+#endif
+};
 
-  printf("%s: exit(%d)\n",exe,status);
+#define SYSCALL_CNT (sizeof syscall_table / sizeof *syscall_table)
 
-  thread_exit();
-}
+// Calls made and time-stamp counter cycles spent in them, by number.
+// The cycles include any time a call spends blocked
+static unsigned syscall_calls[SYSCALL_CNT];
+static uint64_t syscall_cycles[SYSCALL_CNT];
 
-void system_exec_wrapper(struct intr_frame *f)
+// Registers the per-call counters, for syscall_init
+static void syscall_stats_init(void)
 {
-  char* cmd_line = (char*) (*((int*)f->esp + 1));
-  if (!validate_address_in_virtual_memory(cmd_line)){
-    // f->eax = -1;
-    sys_exit(-1);
+  for (size_t i = 0; i < SYSCALL_CNT; i++)
+  {
+    if (syscall_table[i].func != NULL)
+    {
+      stats_add_uint("syscall", syscall_table[i].name, "calls",
+                     &syscall_calls[i]);
+      stats_add_uint64("syscall", syscall_table[i].name, "cycles",
+                       &syscall_cycles[i]);
+    }
   }
-  
-  f->eax = sys_exec(cmd_line);
 }
 
-tid_t sys_exec(const char *file)
+/* The common prologue: copies d's arguments from uargs, the words
+   above the number on the user stack, into args, and checks each
+   as d says. Returns false if the words or any argument are not
+   user memory the process may use so. */
+static bool syscall_copy_args(const struct syscall_desc *d,
+                              const uint32_t *uargs, union syscall_arg *args)
 {
-  return process_execute(file);
+  if (!validate_user_buffer(uargs, d->argc * sizeof *uargs, false))
+  {
+    return false;
+  }
+  for (int i = 0; i < d->argc; i++)
+  {
+    args[i].u = uargs[i];
+  }
+
+  for (int i = 0; i < d->argc; i++)
+  {
+    const struct syscall_arg_spec *spec = &d->args[i];
+    unsigned size = spec->size;
+    switch (spec->kind)
+    {
+    case ARG_STR:
+      if (!validate_user_string(args[i].s))
+      {
+        return false;
+      }
+      break;
+    case ARG_IN_N:
+    case ARG_OUT_N:
+      ASSERT(i + 1 < d->argc);
+      // A count that would overflow the size cannot fit in user memory
+      if (args[i + 1].u > UINT32_MAX / size)
+      {
+        return false;
+      }
+      size *= args[i + 1].u;
+      /* Fall through. */
+    case ARG_IN:
+    case ARG_OUT:
+      if (!validate_user_buffer(args[i].p, size,
+                                spec->kind == ARG_OUT ||
+                                    spec->kind == ARG_OUT_N))
+      {
+        return false;
+      }
+      break;
+    }
+  }
+  return true;
 }
 
-void system_wait_wrapper(struct intr_frame *f)
+static void
+syscall_handler(struct intr_frame *f)
 {
-  int *tid_pointer = (int *) ((int *)f->esp + 1);
-  if (!validate_address_in_virtual_memory(tid_pointer))
+  union syscall_arg args[SYSCALL_ARGS_MAX];
+  const struct syscall_desc *d;
+  uint64_t start;
+  int number;
+
+#ifdef VM
+  // Page faults in the kernel need this to tell whether to grow the stack
+  thread_current()->user_esp = f->esp;
+#endif
+
+  // Another thread called exit: die instead of making the call
+  process_check_exiting();
+
+  if (!validate_user_buffer(f->esp, sizeof number, false))
+  {
+    sys_exit(-1);
+  }
+  number = *(int *)f->esp;
+  if (number < 0 || (size_t)number >= SYSCALL_CNT ||
+      syscall_table[number].func == NULL)
+  {
+    return;
+  }
+  d = &syscall_table[number];
+  if (!syscall_copy_args(d, (const uint32_t *)f->esp + 1, args))
   {
-    // f->eax = -1;
     sys_exit(-1);
   }
 
-  f->eax = sys_wait(*tid_pointer);
+  syscall_calls[number]++;
+  start = rdtsc();
+  f->eax = d->func(f, args);
+  syscall_cycles[number] += rdtsc() - start;
+
+  // Or while it was making it
+  process_check_exiting();
 }
 
-int sys_wait(tid_t t)
+static uint32_t system_submit_wrapper(struct intr_frame *f UNUSED,
+                                      const union syscall_arg *a UNUSED)
 {
-  return process_wait(t);
+  return sys_submit();
 }
 
-void system_write_wrapper(struct intr_frame *f)
+// Cooked if the argument is nonzero, returns the old mode
+static uint32_t system_ttymode_wrapper(struct intr_frame *f UNUSED,
+                                       const union syscall_arg *a)
 {
-  int fd = *((int *)f->esp + 1);
-  char *buffer = (char *)(*((int *)f->esp + 2));
-  // fd must not be 0 because zero is stdin, will be used in read
-  if (fd == 0 || !validate_address_in_virtual_memory(buffer))
-  { // fail, if fd is 0 (stdin), or its virtual memory
-    sys_exit(-1);
-  }
-  // Pull the fourth parameter which is size of the output
-  unsigned size = (unsigned)(*((int *)f->esp + 3));
-  f->eax = sys_write(fd, buffer, size);
+  return tty_set_cooked(a[0].i != 0);
 }
 
-int sys_write(int fd, const void *buffer, unsigned size)
+static uint32_t system_spawn_status_wrapper(struct intr_frame *f UNUSED,
+                                            const union syscall_arg *a)
 {
-  if (fd == 1)
-  { // fd is 1, writes to the stdout
-    lock_acquire(&global_lock);
-    putbuf(buffer, size);
-    lock_release(&global_lock);
-    return size;
-  }
-
-  struct files_opened *file = sys_file_helper(fd);
-  if (file == NULL)
-  { // fail
-    return -1;
-  }
-  else
-  {
-    int ans = 0;
-    lock_acquire(&global_lock);
-    ans = file_write(file->f, buffer, size);
-    lock_release(&global_lock);
-    return ans;
-  }
+  return process_spawn_status(a[0].i);
 }
 
-void system_close_wrapper(struct intr_frame *f)
+static uint32_t system_set_affinity_wrapper(struct intr_frame *f UNUSED,
+                                            const union syscall_arg *a)
 {
-  int fd = *((int *)f->esp + 1);
-
-  if (fd == 0 || fd == 1)
-  {
-    sys_exit(-1);
-    // becouse 0 and 1 belongs to stdin&stdout
-  }
-  else
-  {
-    f->eax = sys_close(fd);
-  }
+  return thread_set_affinity(a[0].u);
 }
 
-int sys_close(int fd)
+static uint32_t system_uptime_wrapper(struct intr_frame *f UNUSED,
+                                      const union syscall_arg *a UNUSED)
 {
-  struct files_opened *open = sys_file_helper(fd);
+  return timer_ticks();
+}
 
-  if (open != NULL)
-  {
-    lock_acquire(&global_lock);
-    file_close(open->f);
-    lock_release(&global_lock);
-    list_remove(&open->elem);
-    return 1;
-  }
-  else
-  {
-    return -1;
-  }
+static uint32_t system_stats_wrapper(struct intr_frame *f UNUSED,
+                                     const union syscall_arg *a UNUSED)
+{
+  stats_emit();
+  return 0;
 }
 
-void system_create_wrapper(struct intr_frame *f)
+static uint32_t system_isdir_wrapper(struct intr_frame *f UNUSED,
+                                     const union syscall_arg *a)
 {
+  return sys_isdir(a[0].i);
+}
 
-  // take it from esp
-  char *n_file = (char *)*((int *)f->esp + 1);
-  // check if it valid
-  if (!validate_address_in_virtual_memory(n_file))
-  {
-    sys_exit(-1);
-  }
-  // take size
-  unsigned int size = (unsigned)*((int *)f->esp + 2);
-  ;
-  // call sys_create and store in eax
-  f->eax = sys_create(n_file, size);
+static uint32_t system_inumber_wrapper(struct intr_frame *f UNUSED,
+                                       const union syscall_arg *a)
+{
+  return sys_inumber(a[0].i);
 }
 
-bool sys_create(const char *file, unsigned initial_size)
+// Returns the old break, or (void *) -1 if it cannot move
+static uint32_t system_sbrk_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a UNUSED)
 {
-  bool ok;
-  lock_acquire(&global_lock);
-  ok = filesys_create(file, initial_size);
-  lock_release(&global_lock);
-  return ok;
+#ifdef VM
+  return (uint32_t)page_sbrk(a[0].i);
+#else
+  return (uint32_t)-1; // No heap without the supplemental page table
+#endif
 }
 
-void system_remove_wrapper(struct intr_frame *f)
+// The library's start routine, then the function and its argument
+static uint32_t system_thread_spawn_wrapper(struct intr_frame *f UNUSED,
+                                            const union syscall_arg *a)
 {
+  void (*eip)(void) = (void (*)(void))a[0].p;
+  return is_user_vaddr(eip) ? process_thread_spawn(eip, a[1].p, a[2].p)
+                            : TID_ERROR;
+}
 
-  char *n_file = (char *)*((int *)f->esp + 1);
+static uint32_t system_thread_join_wrapper(struct intr_frame *f UNUSED,
+                                           const union syscall_arg *a)
+{
+  return process_thread_join(a[0].i);
+}
 
-  // check if it valid
-  if (!validate_address_in_virtual_memory(n_file))
+static uint32_t system_thread_exit_wrapper(struct intr_frame *f UNUSED,
+                                           const union syscall_arg *a UNUSED)
+{
+  // The main thread ending ends the process, as if it returned from main
+  if (thread_current()->process->main == thread_current())
   {
-    sys_exit(-1);
+    sys_exit(0);
   }
-  // call sys_create and store in eax
-  f->eax = sys_remove(n_file);
+  thread_exit();
 }
 
-bool sys_remove(const char *file)
+static uint32_t system_dup2_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
 {
-  bool ok;
-  lock_acquire(&global_lock);
-  ok = filesys_remove(file);
-  lock_release(&global_lock);
-  return ok;
+  return sys_dup2(a[0].i, a[1].i);
 }
 
-void system_open_wrapper(struct intr_frame *f)
+static uint32_t system_shm_map_wrapper(struct intr_frame *f UNUSED,
+                                       const union syscall_arg *a)
 {
+  return (uint32_t)sys_shm_map(a[0].i, a[1].p);
+}
 
-  char *n_file = (char *)*((int *)f->esp + 1);
-  if (!validate_address_in_virtual_memory(n_file))
-  {
-    sys_exit(-1);
-  }
-  f->eax = sys_open(n_file);
+static uint32_t system_shm_unmap_wrapper(struct intr_frame *f UNUSED,
+                                         const union syscall_arg *a)
+{
+  return shm_unmap(a[0].p);
 }
 
-int sys_open(const char *file) // return -1 1 if the file could not be opened, else return fd
+static uint32_t system_set_nonblock_wrapper(struct intr_frame *f UNUSED,
+                                            const union syscall_arg *a)
 {
-  static unsigned long fd_now = 2;
-  lock_acquire(&global_lock);
-  struct file *opened_file = filesys_open(file);
-  lock_release(&global_lock);
-  if (opened_file == NULL)
-  {
-    return -1;
-  }
-  else
-  {
+  return sys_set_nonblock(a[0].i, a[1].i);
+}
 
-    struct files_opened *thread_files = (struct files_opened *)malloc(sizeof(struct files_opened));
-    int file_fd = fd_now;
-    thread_files->file_descriptor = fd_now;
-    thread_files->f = opened_file;
+static uint32_t system_aio_wait_wrapper(struct intr_frame *f UNUSED,
+                                        const union syscall_arg *a)
+{
+  return aio_wait(a[0].i);
+}
 
-    lock_acquire(&global_lock);
-    fd_now++;
-    lock_release(&global_lock);
-    // list of opended files
-    struct list_elem *elem = &thread_files->elem;
-    list_push_back(&thread_current()->files_opened_by_me, elem);
-    return file_fd;
-  }
+static uint32_t system_getrlimit_wrapper(struct intr_frame *f UNUSED,
+                                         const union syscall_arg *a)
+{
+  return sys_getrlimit(a[0].i);
 }
 
-void system_filesize_wrapper(struct intr_frame *f)
+static uint32_t system_setrlimit_wrapper(struct intr_frame *f UNUSED,
+                                         const union syscall_arg *a)
 {
-  int *fd = (int)(*((int *)f->esp + 1));
-  struct files_opened *open_file = sys_file_helper(fd);
-  if (open_file == NULL)
-  {
-    f->eax = -1;
-  }
-  else
-  {
-    f->eax = sys_filesize(open_file);
-  }
+  return process_set_limit(a[0].i, a[1].u);
 }
 
-int sys_filesize(struct files_opened *file)
+static uint32_t system_halt_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a UNUSED)
 {
-  long ans;
-  lock_acquire(&global_lock);
-  ans = file_length(file->f);
-  lock_release(&global_lock);
-  return ans;
+  sys_halt();
+  NOT_REACHED();
+}
 
-  return 0;
+void sys_halt()
+{
+  shutdown_power_off();
 }
 
-void system_read_wrapper(struct intr_frame *f)
+static uint32_t system_exit_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
 {
+  sys_exit(a[0].i);
+  NOT_REACHED();
+}
 
-  int fd = *((int *)f->esp + 1);
-  char *buffer = (char *)(*((int *)f->esp + 2));
-  // fd must not be 1 because zero is stdin, will be used in write
-  if (fd == 1 || !validate_address_in_virtual_memory(buffer))
-  { // fail, if fd is 1 (stdin)
-    sys_exit(-1);
+void sys_exit(int status)
+{
+  struct thread *t = thread_current();
+  char* name= t->name;
+  char * save_ptr;
+  char * exe = strtok_r (name, " ", &save_ptr);
+
+  // Only the first of the process's threads to exit says so
+  if (t->process == NULL || process_set_exit(status))
+  {
+    sys_flush_stdout();
+    printf("%s: exit(%d)\n",exe,status);
   }
 
-  unsigned size = (unsigned)(*((int *)f->esp + 3));
-  f->eax = sys_read(fd, buffer, size);
+  thread_exit();
 }
 
-int sys_read(int fd, void *buffer, unsigned size)
+static uint32_t system_exec_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
 {
-  int size_of_file = size;
-  if (fd == 0)
-  {
+  return sys_exec(a[0].s);
+}
+
+tid_t sys_exec(const char *file)
+{
+  sys_flush_stdout();
+  return process_execute(file);
+}
 
-    while (size--)
+static uint32_t system_execv_wrapper(struct intr_frame *f UNUSED,
+                                     const union syscall_arg *a)
+{
+  char **argv = a[1].p;
+  // argv and every string in it, up to and including the null at the end
+  for (char **arg = argv;; arg++)
+  {
+    if (!validate_user_buffer(arg, sizeof *arg, false))
     {
-      lock_acquire(&global_lock);
-      char ch = input_getc();
-      lock_release(&global_lock);
-      buffer += ch;
+      sys_exit(-1);
     }
-    return size_of_file;
-  }
-  else if (fd == -1)
-  {
-    // negative area
-  }
-  else
-  {
-    struct files_opened *file = sys_file_helper(fd);
-    if (file == NULL)
-    { // fail
-      return -1;
+    if (*arg == NULL)
+    {
+      break;
     }
-    else
+    if (!validate_user_string(*arg))
     {
-      lock_acquire(&global_lock);
-      size_of_file = file_read(file->f, buffer, size);
-      lock_release(&global_lock);
-      return size_of_file;
+      sys_exit(-1);
     }
   }
+
+  return sys_execv(a[0].s, argv);
 }
 
-// void system_seek_wrapper(struct intr_frame *f){
+tid_t sys_execv(const char *file, char *const argv[])
+{
+  sys_flush_stdout();
+  return process_execv(file, argv);
+}
 
-// }
+static uint32_t system_spawn_wrapper(struct intr_frame *f UNUSED,
+                                     const union syscall_arg *a)
+{
+  return sys_spawn(a[0].s);
+}
 
-void sys_seek(struct intr_frame *f)
+// Like sys_exec, but the child loads while we carry on
+tid_t sys_spawn(const char *cmd_line)
 {
-  int fd = (int)(*((int *)f->esp + 1));
-  unsigned postion = (unsigned)(*((int *)f->esp + 2));
-  struct files_opened *opened_file = sys_file_helper(fd);
-  if (opened_file == NULL)
-  { // fail
-    f->eax = -1;
-  }
-  else
+  sys_flush_stdout();
+  return process_spawn(cmd_line);
+}
+
+static uint32_t system_spawn_fds_wrapper(struct intr_frame *f UNUSED,
+                                         const union syscall_arg *a)
+{
+  return sys_spawn_fds(a[0].s, a[1].p, a[2].i);
+}
+
+// Like sys_spawn, with fds mapped into the child's fd table
+tid_t sys_spawn_fds(const char *cmd_line, const struct spawn_fd *fds, int cnt)
+{
+  if (cnt < 0 || cnt > SPAWN_FDS_MAX)
   {
-    lock_acquire(&global_lock);
-    file_seek(opened_file->f, postion);
-    f->eax = postion;
-    lock_release(&global_lock);
+    return TID_ERROR;
   }
+  sys_flush_stdout();
+  return process_spawn_fds(cmd_line, fds, cnt);
 }
 
-// void system_tell_wrapper(struct intr_frame *f){
+static uint32_t system_fork_wrapper(struct intr_frame *f,
+                                    const union syscall_arg *a UNUSED)
+{
+  return sys_fork(f);
+}
 
-// }
+// The child returns from the same system call, through a copy of f
+tid_t sys_fork(struct intr_frame *f)
+{
+  // Flushed first, or the child would print the parent's pending output too
+  sys_flush_stdout();
+  return process_fork(f);
+}
 
-void sys_tell(struct intr_frame *f)
+static uint32_t system_wait_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
 {
-  int fd = (int)(*((int *)f->esp + 1));
-  struct files_opened *file = sys_file_helper(fd);
-  if (file == NULL)
-  {
-    f->eax = -1;
-  }
+  return sys_wait(a[0].i);
+}
+
+int sys_wait(tid_t t)
+{
+  sys_flush_stdout();
+  return process_wait(t);
+}
+
+static uint32_t system_wait_any_wrapper(struct intr_frame *f UNUSED,
+                                        const union syscall_arg *a)
+{
+  int *status = a[0].p;
+  // status may be null if the caller does not want it
+  if (status != NULL && !validate_user_buffer(status, sizeof *status, true))
+  {
+    sys_exit(-1);
+  }
+
+  return sys_wait_any(status);
+}
+
+tid_t sys_wait_any(int *status)
+{
+  int child_status;
+  sys_flush_stdout();
+  tid_t tid = process_wait_any(&child_status);
+  if (tid != TID_ERROR && status != NULL)
+  {
+    *status = child_status;
+  }
+  return tid;
+}
+
+static uint32_t system_getrusage_wrapper(struct intr_frame *f UNUSED,
+                                         const union syscall_arg *a)
+{
+  if ((size_t)a[2].i > RUSAGE_MAX)
+  {
+    sys_exit(-1);
+  }
+
+  return sys_getrusage(a[0].i, a[1].p, a[2].i);
+}
+
+// Collects one struct rusage per thread for sys_getrusage
+struct rusage_collect
+{
+  struct rusage *usage; // Room for cnt entries
+  int cnt;
+  int total;            // Threads seen so far
+};
+
+static void rusage_collect(struct thread *t, void *aux)
+{
+  struct rusage_collect *c = aux;
+  if (c->total < c->cnt)
+  {
+    thread_get_rusage(t, &c->usage[c->total]);
+  }
+  c->total++;
+}
+
+/* Fills usage with up to cnt entries: for who == RUSAGE_SELF the
+   caller's, for RUSAGE_ALL every thread's. Returns the number of
+   entries there are, which may be more than cnt, or -1 if who is
+   bad. The threads are gathered into a kernel buffer first, since
+   touching user memory could fault while interrupts are off. */
+int sys_getrusage(int who, struct rusage *usage, int cnt)
+{
+  if (who == RUSAGE_SELF)
+  {
+    if (cnt > 0)
+    {
+      thread_get_rusage(thread_current(), usage);
+    }
+    return 1;
+  }
+  if (who != RUSAGE_ALL)
+  {
+    return -1;
+  }
+
+  struct rusage_collect c = {NULL, cnt, 0};
+  if (cnt > 0 && (c.usage = malloc(cnt * sizeof *c.usage)) == NULL)
+  {
+    return -1;
+  }
+  enum intr_level old_level = intr_disable();
+  thread_foreach(rusage_collect, &c);
+  intr_set_level(old_level);
+
+  if (c.usage != NULL)
+  {
+    memcpy(usage, c.usage, (c.total < cnt ? c.total : cnt) * sizeof *usage);
+    free(c.usage);
+  }
+  return c.total;
+}
+
+/* Stores the time-stamp counter in the 64-bit integer the
+   argument points to. It goes through memory rather than EDX:EAX
+   because the SYSENTER return path uses EDX. */
+static uint32_t system_cycles_wrapper(struct intr_frame *f UNUSED,
+                                      const union syscall_arg *a)
+{
+  uint64_t tsc = rdtsc();
+  memcpy(a[0].p, &tsc, sizeof tsc);
+  return 0;
+}
+
+// The same as reading the clock page, which user programs have
+// mapped, but through a system call
+static uint32_t system_clock_gettime_wrapper(struct intr_frame *f UNUSED,
+                                             const union syscall_arg *a)
+{
+  struct timespec ts;
+  int result = clock_gettime(a[0].i, &ts);
+  if (result == 0)
+  {
+    memcpy(a[1].p, &ts, sizeof ts);
+  }
+  return result;
+}
+
+/* Copies kernel log text, from the record whose sequence number
+   the first argument points to on, into the buffer of the size the
+   third argument gives, and advances that number past what was
+   copied. The log is read with interrupts off, so it goes through
+   a kernel page a page at a time. Returns the bytes copied, or -1
+   if there is no memory for the page. */
+static uint32_t system_klog_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
+{
+  size_t size = a[2].u;
+  size_t total = 0;
+  uint32_t seq;
+  char *page = palloc_get_page(0);
+  if (page == NULL)
+  {
+    return -1;
+  }
+
+  memcpy(&seq, a[0].p, sizeof seq);
+  while (total < size)
+  {
+    size_t n = klog_read(&seq, page,
+                         size - total < PGSIZE ? size - total : PGSIZE);
+    if (n == 0)
+    {
+      break;
+    }
+    memcpy((char *)a[1].p + total, page, n);
+    total += n;
+  }
+  memcpy(a[0].p, &seq, sizeof seq);
+  palloc_free_page(page);
+  return total;
+}
+
+// Parks the calling thread until a sibling blocks, or wakes parked ones
+static uint32_t system_upcall_wrapper(struct intr_frame *f,
+                                      const union syscall_arg *a)
+{
+  if (*(int *)f->esp == SYS_UPCALL_WAIT)
+  {
+    upcall_wait();
+  }
+  else
+  {
+    upcall_wake(a[0].i);
+  }
+  return 0;
+}
+
+/* Fills the array the first argument points to with the state of
+   up to as many threads as the second says, without turning
+   interrupts off, so that a monitor may call it as often as it
+   likes. Returns the number of threads there are. */
+static uint32_t system_threadinfo_wrapper(struct intr_frame *f UNUSED,
+                                          const union syscall_arg *a)
+{
+  if ((size_t)a[1].i > THREADINFO_MAX)
+  {
+    sys_exit(-1);
+  }
+
+  return thread_get_info(a[0].p, a[1].i);
+}
+
+/* Copies the kernel's memory usage to the struct memstat the
+   argument points to, or if it is null prints the full palloc and
+   malloc report on the console instead. */
+static uint32_t system_memstat_wrapper(struct intr_frame *f UNUSED,
+                                       const union syscall_arg *a)
+{
+  struct memstat *dst = a[0].p;
+  struct memstat stats;
+  if (dst == NULL)
+  {
+    palloc_print_stats();
+    malloc_print_stats();
+    return 0;
+  }
+  if (!validate_user_buffer(dst, sizeof *dst, true))
+  {
+    sys_exit(-1);
+  }
+
+  palloc_get_stats(&stats);
+  malloc_get_stats(&stats);
+  memcpy(dst, &stats, sizeof stats);
+  return 0;
+}
+
+// Both take the word's address and a value: what it should still
+// hold to wait, or how many threads to wake
+static uint32_t system_futex_wrapper(struct intr_frame *f,
+                                     const union syscall_arg *a)
+{
+  int *uaddr = a[0].p;
+  if ((uintptr_t)uaddr % sizeof(int) != 0)
+  {
+    sys_exit(-1);
+  }
+  if (*(int *)f->esp == SYS_FUTEX_WAIT)
+  {
+    return futex_wait(uaddr, a[1].i);
+  }
+  else
+  {
+    return futex_wake(uaddr, a[1].i);
+  }
+}
+
+static uint32_t system_write_wrapper(struct intr_frame *f UNUSED,
+                                     const union syscall_arg *a)
+{
+  // fd must not be 0 because zero is stdin, will be used in read
+  if (a[0].i == 0)
+  {
+    sys_exit(-1);
+  }
+  return sys_write(a[0].i, a[1].p, a[2].u);
+}
+
+int sys_write(int fd, const void *buffer, unsigned size)
+{
+  if (fd == 1 && !fd_has_file(1))
+  { // fd is 1, writes to the stdout unless dup2 put a file there
+    stdout_write(buffer, size);
+    return size;
+  }
+
+  struct files_opened *file = sys_file_helper(fd);
+  int ans = -1;
+  if (file == NULL || dir_inode_helper(file) != NULL)
+  { // fail, also for a directory, which only mkdir and remove change
+  }
+  else if (file->nonblock)
+  {
+    ans = nonblock_write(file->f, buffer, size);
+  }
+  else
+  {
+    ans = file_write(file->f, buffer, size);
+  }
+  sys_file_put(file);
+  return ans;
+}
+
+static uint32_t system_close_wrapper(struct intr_frame *f UNUSED,
+                                     const union syscall_arg *a)
+{
+  int fd = a[0].i;
+
+  if ((fd == 0 || fd == 1) && !fd_has_file(fd))
+  {
+    sys_exit(-1);
+    // becouse 0 and 1 belongs to stdin&stdout, unless dup2 moved them
+  }
+  return sys_close(fd);
+}
+
+int sys_close(int fd)
+{
+  struct process *t = thread_current()->process;
+  struct files_opened *open = NULL;
+
+  // Taken out under the lock, so two threads cannot both close it
+  lock_acquire(&t->files_lock);
+  if (fd >= 0 && (size_t)fd < t->fd_cap && t->fd_table[fd] != NULL)
+  {
+    open = t->fd_table[fd];
+    t->fd_table[fd] = NULL;
+    // A redirected stdin or stdout goes back to the console
+    if (fd > 1)
+      bitmap_reset(t->fd_map, fd);
+  }
+  lock_release(&t->files_lock);
+
+  if (open != NULL)
+  {
+    // Calls still using it keep it open until they are done
+    sys_file_put(open);
+    return 1;
+  }
+  else
+  {
+    return -1;
+  }
+}
+
+/* Writes SIZE bytes to the console through the current process's
+   stdout buffer. The buffer is handed to putbuf, which takes the
+   console lock once, whenever a newline goes in or it fills up, so
+   a program printing one character at a time does not pay for a
+   lock round trip per byte. Writes too big for the buffer skip it. */
+static void stdout_write(const char *buffer, size_t size)
+{
+  struct process *t = thread_current()->process;
+  // One lock for the buffer, so lines of different threads stay whole
+  lock_acquire(&t->files_lock);
+  if (t->stdout_buf == NULL)
+  {
+    t->stdout_buf = malloc(STDOUT_BUF_SIZE);
+    if (t->stdout_buf == NULL)
+    {
+      putbuf(buffer, size);
+      lock_release(&t->files_lock);
+      return;
+    }
+  }
+
+  if (t->stdout_len + size > STDOUT_BUF_SIZE)
+    stdout_flush(t);
+  if (size >= STDOUT_BUF_SIZE)
+  {
+    putbuf(buffer, size);
+  }
+  else
+  {
+    memcpy(t->stdout_buf + t->stdout_len, buffer, size);
+    t->stdout_len += size;
+    if (memchr(buffer, '\n', size) != NULL || t->stdout_len == STDOUT_BUF_SIZE)
+      stdout_flush(t);
+  }
+  lock_release(&t->files_lock);
+}
+
+/* Writes out whatever process t has buffered for fd 1. Its files_lock
+   must be held. */
+static void stdout_flush(struct process *t)
+{
+  if (t->stdout_len > 0)
+  {
+    putbuf(t->stdout_buf, t->stdout_len);
+    t->stdout_len = 0;
+  }
+}
+
+/* Writes out whatever the current process has buffered for fd 1. */
+void sys_flush_stdout(void)
+{
+  struct process *t = thread_current()->process;
+  if (t == NULL)
+  {
+    return;
+  }
+  lock_acquire(&t->files_lock);
+  stdout_flush(t);
+  lock_release(&t->files_lock);
+}
+
+/* Closes every file the current process still has open and frees its
+   fd table. Called from process_exit, once the process's other
+   threads are gone. */
+void sys_close_all(void)
+{
+  struct process *t = thread_current()->process;
+  sys_flush_stdout();
+  free(t->stdout_buf);
+  t->stdout_buf = NULL;
+  for (size_t fd = 0; fd < t->fd_cap; fd++)
+  {
+    sys_file_put(t->fd_table[fd]);
+  }
+  fd_table_free(t);
+  t->fd_table = NULL;
+  t->fd_map = NULL;
+  t->fd_cap = 0;
+}
+
+/* Puts file at fd in the current process, closing what was there and
+   growing the table if need be. fd 0 and 1 then read and write file
+   instead of the console. Returns false, and closes file, if memory
+   runs out or fd is not below the process's RLIMIT_NOFILE. */
+bool sys_adopt_file(int fd, struct file *file)
+{
+  struct process *t = thread_current()->process;
+  struct files_opened *open = NULL;
+  struct files_opened *old = NULL;
+  if ((unsigned)fd < t->limits[RLIMIT_NOFILE])
+  {
+    open = kmem_cache_alloc(files_opened_cache);
+  }
+  if (open == NULL)
+  {
+    file_close(file);
+    return false;
+  }
+  open->f = file;
+  open->file_descriptor = fd;
+  open->nonblock = false;
+  open->ref_cnt = 1;
+
+  lock_acquire(&t->files_lock);
+  while ((size_t)fd >= t->fd_cap)
+  {
+    if (!fd_table_grow(t))
+    {
+      lock_release(&t->files_lock);
+      kmem_cache_free(files_opened_cache, open);
+      file_close(file);
+      return false;
+    }
+  }
+  old = t->fd_table[fd];
+  rcu_assign_pointer(t->fd_table[fd], open);
+  bitmap_mark(t->fd_map, fd);
+  lock_release(&t->files_lock);
+
+  sys_file_put(old);
+  return true;
+}
+
+/* Makes fd new_fd of the current process refer to the same open file
+   as old_fd, sharing its position, as Unix dup2 does. Used to point
+   stdin or stdout at a pipe before exec, whose child takes them over.
+   Returns new_fd, or -1 if old_fd is not open or new_fd is out of
+   range. */
+int sys_dup2(int old_fd, int new_fd)
+{
+  struct files_opened *file = sys_file_helper(old_fd);
+  int ans = -1;
+  if (file == NULL || new_fd < 0 || new_fd >= FD_MAX)
+  {
+  }
+  else if (old_fd == new_fd)
+  {
+    ans = new_fd;
+  }
+  else if (sys_adopt_file(new_fd, file_dup(file->f)))
+  {
+    ans = new_fd;
+  }
+  sys_file_put(file);
+  return ans;
+}
+
+/* The file the current process has at fd, with one more reference
+   for the caller, or NULL if it has none there, as at fd 0 and 1
+   while they are the console. */
+struct file *sys_file_dup(int fd)
+{
+  if (thread_current()->process == NULL)
+  {
+    return NULL; // The kernel starting the first process
+  }
+  struct files_opened *file = sys_file_helper(fd);
+  struct file *dup = file != NULL ? file_dup(file->f) : NULL;
+  sys_file_put(file);
+  return dup;
+}
+
+static uint32_t system_pipe_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
+{
+  return sys_pipe(a[0].p);
+}
+
+/* Makes a pipe and stores the fds of its read and write ends in
+   fds[0] and fds[1]. Returns 0, or -1 if memory runs out. */
+int sys_pipe(int fds[2])
+{
+  struct files_opened *read_end = kmem_cache_alloc(files_opened_cache);
+  struct files_opened *write_end = kmem_cache_alloc(files_opened_cache);
+  if (read_end == NULL || write_end == NULL ||
+      !pipe_create(&read_end->f, &write_end->f))
+  {
+    kmem_cache_free(files_opened_cache, read_end);
+    kmem_cache_free(files_opened_cache, write_end);
+    return -1;
+  }
+
+  int read_fd = fd_alloc(read_end);
+  if (read_fd < 0)
+  {
+    file_close(read_end->f);
+    kmem_cache_free(files_opened_cache, read_end);
+  }
+  int write_fd = read_fd < 0 ? -1 : fd_alloc(write_end);
+  if (write_fd < 0)
+  {
+    file_close(write_end->f);
+    kmem_cache_free(files_opened_cache, write_end);
+    if (read_fd >= 0)
+      sys_close(read_fd);
+    return -1;
+  }
+  fds[0] = read_fd;
+  fds[1] = write_fd;
+  return 0;
+}
+
+static uint32_t system_shm_wrapper(struct intr_frame *f,
+                                   const union syscall_arg *a)
+{
+  if (*(int *)f->esp == SYS_SHM_OPEN)
+  {
+    return sys_shm_open(a[0].s, a[1].i);
+  }
   else
   {
-    lock_acquire(&global_lock);
-    f->eax = file_tell(file->f);
-    lock_release(&global_lock);
+    return shm_unlink(a[0].s);
+  }
+}
+
+/* Opens the shared memory object name, creating it size bytes long if
+   there is none, and returns its fd, or -1 on failure. The fd reads
+   and writes the object like a file, and sys_shm_map maps it. */
+int sys_shm_open(const char *name, int size)
+{
+  struct file *shm = shm_open(name, size);
+  if (shm == NULL)
+  {
+    return -1;
+  }
+  struct files_opened *open = kmem_cache_alloc(files_opened_cache);
+  int fd = -1;
+  if (open != NULL)
+  {
+    open->f = shm;
+    fd = fd_alloc(open);
+  }
+  if (fd == -1)
+  {
+    file_close(shm);
+    kmem_cache_free(files_opened_cache, open);
+  }
+  return fd;
+}
+
+// The same frames in every process that maps the object, so no copy
+void *sys_shm_map(int fd, void *addr)
+{
+  struct files_opened *file = sys_file_helper(fd);
+  if (file == NULL)
+  {
+    return NULL;
+  }
+  void *map = shm_map(file->f, addr);
+  sys_file_put(file);
+  return map;
+}
+
+/* Gives the current process, just forked by thread parent, the files
+   parent's process has open at the same fds. Each struct file is
+   shared through file_dup, position and all, as after a Unix fork.
+   Returns false if memory runs out. Called from process_fork. */
+bool sys_dup_files(struct thread *parent_thread)
+{
+  struct process *t = thread_current()->process;
+  struct process *parent = parent_thread->process;
+  bool success = false;
+  lock_acquire(&parent->files_lock);
+  while (t->fd_cap < parent->fd_cap)
+  {
+    if (!fd_table_grow(t))
+    {
+      goto done;
+    }
   }
-}
\ No newline at end of file
+  for (size_t fd = 0; fd < parent->fd_cap; fd++)
+  {
+    struct files_opened *open = parent->fd_table[fd];
+    if (open == NULL)
+    {
+      continue;
+    }
+    struct files_opened *copy = kmem_cache_alloc(files_opened_cache);
+    if (copy == NULL)
+    {
+      goto done;
+    }
+    copy->f = file_dup(open->f);
+    copy->file_descriptor = open->file_descriptor;
+    copy->nonblock = open->nonblock;
+    copy->ref_cnt = 1;
+    t->fd_table[fd] = copy;
+    bitmap_mark(t->fd_map, fd);
+  }
+  // The working directory goes along, but a chdir in one is not seen by the other
+  if (parent->cwd != NULL)
+  {
+    t->cwd = dir_reopen(parent->cwd);
+    if (t->cwd == NULL)
+    {
+      goto done;
+    }
+  }
+  success = true;
+
+done:
+  lock_release(&parent->files_lock);
+  return success;
+}
+
+/* Writes what fits of size bytes from buffer to file, a page at a
+   time while file_poll says a page will not wait, for write on a
+   nonblocking fd. Returns the bytes written, or -1 if there was no
+   room at all. */
+static int nonblock_write(struct file *file, const void *buffer, unsigned size)
+{
+  unsigned done = 0;
+  while (done < size && (file_poll(file, NULL) & POLLOUT))
+  {
+    unsigned chunk = size - done < PGSIZE ? size - done : PGSIZE;
+    unsigned n = file_write(file, (const char *)buffer + done, chunk);
+    done += n;
+    if (n < chunk)
+    {
+      break;
+    }
+  }
+  return done > 0 || size == 0 ? (int)done : -1;
+}
+
+/* Makes reads and writes on fd fail with -1 instead of waiting if
+   nonblock, or wait again if not. Only this fd is affected, not
+   others sharing its file through dup2 or fork. The console's stdin
+   has a flag of its own. Returns false if fd is not open. */
+bool sys_set_nonblock(int fd, bool nonblock)
+{
+  struct process *t = thread_current()->process;
+  struct files_opened *file = sys_file_helper(fd);
+  if (file != NULL)
+  {
+    file->nonblock = nonblock;
+    sys_file_put(file);
+    return true;
+  }
+  if (fd == 0)
+  {
+    t->stdin_nonblock = nonblock;
+    return true;
+  }
+  return fd == 1; // Console output never waits
+}
+
+/* The POLL* events that hold for fd, with entry, if not NULL, put on
+   the queue that is woken when they change. */
+static int fd_poll(int fd, struct waitq_entry *entry)
+{
+  struct files_opened *file = sys_file_helper(fd);
+  if (file != NULL)
+  {
+    int events = file_poll(file->f, entry);
+    sys_file_put(file);
+    return events;
+  }
+  if (fd == 0)
+  {
+    return tty_poll(entry);
+  }
+  return fd == 1 ? POLLOUT : POLLNVAL;
+}
+
+static uint32_t system_poll_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
+{
+  struct pollfd *fds = a[0].p;
+  int nfds = a[1].i;
+  if (nfds < 0 || nfds > POLL_MAX)
+  {
+    return -1;
+  }
+  if (!validate_user_buffer(fds, nfds * sizeof *fds, true))
+  {
+    sys_exit(-1);
+  }
+  return sys_poll(fds, nfds, a[2].i);
+}
+
+/* Waits until at least one of the nfds fds in fds has one of its
+   events, or timeout milliseconds pass, or forever if timeout is
+   negative, and sets each revents. Returns the number of fds with
+   events, 0 on timeout, or -1 if memory runs out. The thread sleeps
+   on one semaphore that every fd's wait queue, and the timer for the
+   timeout, can wake, so nothing is polled in a loop. */
+int sys_poll(struct pollfd *ufds, int nfds, int timeout)
+{
+  size_t each = sizeof(struct pollfd) + sizeof(struct waitq_entry);
+  struct pollfd *fds = malloc(nfds * each + 1);
+  if (fds == NULL)
+  {
+    return -1;
+  }
+  struct waitq_entry *entries = (struct waitq_entry *)(fds + nfds);
+  memcpy(fds, ufds, nfds * sizeof *fds);
+
+  struct semaphore wakeup;
+  sema_init(&wakeup, 0);
+  for (int i = 0; i < nfds; i++)
+  {
+    waitq_entry_init(&entries[i], &wakeup);
+  }
+  struct timer_alarm alarm;
+  alarm.armed = false;
+  if (timeout > 0)
+  {
+    int64_t ticks = DIV_ROUND_UP((int64_t)timeout * TIMER_FREQ, 1000);
+    timer_alarm_set(&alarm, timer_ticks() + ticks, &wakeup);
+  }
+
+  // Go on every queue on the first pass, before looking, so a change
+  // right after a look still wakes us
+  int ready;
+  for (bool first = true;; first = false)
+  {
+    ready = 0;
+    for (int i = 0; i < nfds; i++)
+    {
+      fds[i].revents = 0;
+      if (fds[i].fd < 0)
+      {
+        continue;
+      }
+      int events = fd_poll(fds[i].fd, first ? &entries[i] : NULL);
+      int wanted = fds[i].events | POLLHUP | POLLERR | POLLNVAL;
+      fds[i].revents = events & wanted;
+      if (fds[i].revents != 0)
+      {
+        ready++;
+      }
+    }
+    if (ready > 0 || timeout == 0 || (timeout > 0 && !alarm.armed))
+    {
+      break;
+    }
+    sema_down(&wakeup);
+  }
+
+  timer_alarm_cancel(&alarm);
+  for (int i = 0; i < nfds; i++)
+  {
+    waitq_remove(&entries[i]);
+  }
+  for (int i = 0; i < nfds; i++)
+  {
+    ufds[i].revents = fds[i].revents;
+  }
+  free(fds);
+  return ready;
+}
+
+static uint32_t system_dir_wrapper(struct intr_frame *f,
+                                   const union syscall_arg *a)
+{
+  if (*(int *)f->esp == SYS_CHDIR)
+  {
+    return filesys_chdir(a[0].s);
+  }
+  else
+  {
+    return filesys_mkdir(a[0].s);
+  }
+}
+
+// The inode file is open on if it is a directory, or NULL
+static struct inode *dir_inode_helper(struct files_opened *file)
+{
+  if (file == NULL)
+  {
+    return NULL;
+  }
+  struct inode *inode = file_get_inode(file->f);
+  return inode != NULL && inode_is_dir(inode) ? inode : NULL;
+}
+
+static uint32_t system_readdir_wrapper(struct intr_frame *f UNUSED,
+                                       const union syscall_arg *a)
+{
+  return sys_readdir(a[0].i, a[1].p);
+}
+
+/* Stores in name the next entry of the directory open as fd, other
+   than "." and "..". The file position keeps the place between
+   calls. Returns false at the end or if fd is not a directory. */
+bool sys_readdir(int fd, char *name)
+{
+  struct files_opened *open = sys_file_helper(fd);
+  struct inode *inode = dir_inode_helper(open);
+  struct dir *dir = inode != NULL ? dir_open(inode_reopen(inode)) : NULL;
+  if (dir == NULL)
+  {
+    sys_file_put(open);
+    return false;
+  }
+  struct file *file = open->f;
+  dir_seek(dir, file_tell(file));
+  bool found = dir_readdir(dir, name);
+  file_seek(file, dir_tell(dir));
+  dir_close(dir);
+  sys_file_put(open);
+  return found;
+}
+
+static uint32_t system_readdir_plus_wrapper(struct intr_frame *f UNUSED,
+                                            const union syscall_arg *a)
+{
+  if ((size_t)a[2].i > READDIR_PLUS_MAX)
+  {
+    sys_exit(-1);
+  }
+  return sys_readdir_plus(a[0].i, a[1].p, a[2].i);
+}
+
+/* Stores in entries up to cnt of the next entries of the directory
+   open as fd, with each file's type, size and inumber, so that a
+   listing needs no open() per file. The entries are gathered in a
+   kernel buffer first, since filling them in holds the directory
+   lock. Returns the number stored, 0 at the end, or -1 if fd is
+   not a directory. */
+int sys_readdir_plus(int fd, struct dirent_plus *entries, int cnt)
+{
+  struct files_opened *open = sys_file_helper(fd);
+  struct inode *inode = dir_inode_helper(open);
+  if (inode == NULL || cnt == 0)
+  {
+    sys_file_put(open);
+    return inode == NULL ? -1 : 0;
+  }
+  struct dirent_plus *buf = malloc(cnt * sizeof *buf);
+  struct dir *dir = buf != NULL ? dir_open(inode_reopen(inode)) : NULL;
+  if (dir == NULL)
+  {
+    free(buf);
+    sys_file_put(open);
+    return -1;
+  }
+  struct file *file = open->f;
+  dir_seek(dir, file_tell(file));
+  int found = dir_readdir_plus(dir, buf, cnt);
+  file_seek(file, dir_tell(dir));
+  dir_close(dir);
+  sys_file_put(open);
+  memcpy(entries, buf, found * sizeof *buf);
+  free(buf);
+  return found;
+}
+
+bool sys_isdir(int fd)
+{
+  struct files_opened *file = sys_file_helper(fd);
+  bool is_dir = dir_inode_helper(file) != NULL;
+  sys_file_put(file);
+  return is_dir;
+}
+
+// The inode's sector, unique among the files on disk
+int sys_inumber(int fd)
+{
+  struct files_opened *file = sys_file_helper(fd);
+  struct inode *inode = file != NULL ? file_get_inode(file->f) : NULL;
+  int inumber = inode != NULL ? (int)inode_get_inumber(inode) : -1;
+  sys_file_put(file);
+  return inumber;
+}
+
+static uint32_t system_create_wrapper(struct intr_frame *f UNUSED,
+                                      const union syscall_arg *a)
+{
+  return sys_create(a[0].s, a[1].u);
+}
+
+bool sys_create(const char *file, unsigned initial_size)
+{
+  bool ok;
+  ok = filesys_create(file, initial_size);
+  return ok;
+}
+
+static uint32_t system_remove_wrapper(struct intr_frame *f UNUSED,
+                                      const union syscall_arg *a)
+{
+  return sys_remove(a[0].s);
+}
+
+bool sys_remove(const char *file)
+{
+  bool ok;
+  ok = filesys_remove(file);
+  return ok;
+}
+
+/* Copies the cnt name pointers at unames into names, checking
+   that they and every string they point to are user memory, so
+   that another thread cannot change a pointer once it is checked.
+   Kills the process if not. */
+static void copy_user_names(const char *const unames[], int cnt,
+                            const char *names[NAMES_BATCH_MAX])
+{
+  if (cnt < 0 || cnt > NAMES_BATCH_MAX ||
+      !validate_user_buffer(unames, cnt * sizeof *unames, false))
+  {
+    sys_exit(-1);
+  }
+  memcpy(names, unames, cnt * sizeof *unames);
+  for (int i = 0; i < cnt; i++)
+  {
+    if (!validate_user_string(names[i]))
+    {
+      sys_exit(-1);
+    }
+  }
+}
+
+static uint32_t system_create_many_wrapper(struct intr_frame *f UNUSED,
+                                           const union syscall_arg *a)
+{
+  const char *names[NAMES_BATCH_MAX];
+  copy_user_names(a[0].p, a[3].i, names);
+  return sys_create_many(names, a[1].u, a[2].p, a[3].i);
+}
+
+/* Creates a file of initial_size bytes for each of the cnt names,
+   in one trap, setting ok[i] to whether names[i] was created.
+   Returns the number created. */
+int sys_create_many(const char *const names[], unsigned initial_size,
+                    bool ok[], int cnt)
+{
+  return filesys_create_many(names, initial_size, ok, cnt);
+}
+
+static uint32_t system_remove_many_wrapper(struct intr_frame *f UNUSED,
+                                           const union syscall_arg *a)
+{
+  const char *names[NAMES_BATCH_MAX];
+  copy_user_names(a[0].p, a[2].i, names);
+  return sys_remove_many(names, a[1].p, a[2].i);
+}
+
+// Like sys_create_many for remove
+int sys_remove_many(const char *const names[], bool ok[], int cnt)
+{
+  return filesys_remove_many(names, ok, cnt);
+}
+
+static uint32_t system_stat_many_wrapper(struct intr_frame *f UNUSED,
+                                         const union syscall_arg *a)
+{
+  const char *names[NAMES_BATCH_MAX];
+  copy_user_names(a[0].p, a[2].i, names);
+  return sys_stat_many(names, a[1].p, a[2].i);
+}
+
+/* Stores in entries[i] the type, size and inumber of the file
+   names[i] names, with its last component as the entry's name, or
+   an empty name if there is no such file, so that checking many
+   paths takes one trap. Returns the number found. */
+int sys_stat_many(const char *const names[], struct dirent_plus *entries,
+                  int cnt)
+{
+  return filesys_stat_many(names, entries, cnt);
+}
+
+static uint32_t system_open_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
+{
+  return sys_open(a[0].s);
+}
+
+int sys_open(const char *file) // return -1 1 if the file could not be opened, else return fd
+{
+  struct file *opened_file = filesys_open(file);
+  if (opened_file == NULL)
+  {
+    return -1;
+  }
+  else
+  {
+
+    struct files_opened *thread_files = kmem_cache_alloc(files_opened_cache);
+    int file_fd = -1;
+    if (thread_files != NULL)
+    {
+      thread_files->f = opened_file;
+      file_fd = fd_alloc(thread_files);
+    }
+    if (file_fd == -1)
+    {
+      file_close(opened_file);
+      kmem_cache_free(files_opened_cache, thread_files);
+    }
+    return file_fd;
+  }
+}
+
+static uint32_t system_filesize_wrapper(struct intr_frame *f UNUSED,
+                                        const union syscall_arg *a)
+{
+  struct files_opened *open_file = sys_file_helper(a[0].i);
+  if (open_file == NULL)
+  {
+    return -1;
+  }
+  int size = sys_filesize(open_file);
+  sys_file_put(open_file);
+  return size;
+}
+
+int sys_filesize(struct files_opened *file)
+{
+  long ans;
+  ans = file_length(file->f);
+  return ans;
+
+  return 0;
+}
+
+static uint32_t system_read_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
+{
+  // fd must not be 1 because one is stdout, will be used in write
+  if (a[0].i == 1)
+  {
+    sys_exit(-1);
+  }
+  return sys_read(a[0].i, a[1].p, a[2].u);
+}
+
+int sys_read(int fd, void *buffer, unsigned size)
+{
+  int size_of_file = size;
+  if (fd == 0 && !fd_has_file(0))
+  {
+    // The buffer was checked to be writable, so it takes a line at once.
+    // A prompt without a newline has to be on the screen before we wait
+    sys_flush_stdout();
+    if (thread_current()->process->stdin_nonblock && size > 0 &&
+        !(tty_poll(NULL) & POLLIN))
+    {
+      return -1;
+    }
+    return tty_read(buffer, size);
+  }
+  else if (fd == -1)
+  {
+    // negative area
+  }
+  else
+  {
+    struct files_opened *file = sys_file_helper(fd);
+    if (file == NULL)
+    { // fail
+      return -1;
+    }
+    else if (file->nonblock && size > 0 &&
+             !(file_poll(file->f, NULL) & POLLIN))
+    {
+      size_of_file = -1; // Nothing to read yet
+    }
+    else
+    {
+#ifdef VM
+      off_t pos = file_tell(file->f);
+      unsigned flipped = sys_read_pages(file->f, buffer, size, pos);
+      if (flipped > 0)
+      {
+        file_seek(file->f, pos + flipped);
+        size_of_file = flipped + file_read(file->f,
+                                           (uint8_t *)buffer + flipped,
+                                           size - flipped);
+        sys_file_put(file);
+        return size_of_file;
+      }
+#endif
+      size_of_file = file_read(file->f, buffer, size);
+    }
+    sys_file_put(file);
+    return size_of_file;
+  }
+}
+
+#ifdef VM
+// For a read at a page boundary of a file into a page-aligned buffer,
+// maps the page cache's frames for the whole file pages it covers into
+// the buffer copy-on-write instead of copying them. Stops at the first
+// page that is not private anonymous memory, or at the end of the file.
+// Returns the bytes read that way, a multiple of PGSIZE, for the caller
+// to read the rest after
+static unsigned sys_read_pages(struct file *f, void *buffer, unsigned size,
+                               off_t ofs)
+{
+  unsigned n = 0;
+  off_t length;
+
+  if (pg_ofs(buffer) != 0 || ofs % PGSIZE != 0 || size < PGSIZE ||
+      file_get_inode(f) == NULL)
+  {
+    return 0;
+  }
+  length = file_length(f);
+  while (size - n >= PGSIZE && ofs + (off_t)n + PGSIZE <= length &&
+         page_read_file((uint8_t *)buffer + n, f, ofs + n))
+  {
+    n += PGSIZE;
+  }
+  return n;
+}
+#endif
+
+static uint32_t system_pread_wrapper(struct intr_frame *f UNUSED,
+                                     const union syscall_arg *a)
+{
+  return sys_pread(a[0].i, a[1].p, a[2].u, a[3].u);
+}
+
+// Reads at offset without moving the file position, so a random read is
+// one trap instead of a seek and a read. The console has no offsets
+int sys_pread(int fd, void *buffer, unsigned size, unsigned offset)
+{
+  if (fd == 0 || fd == 1)
+  {
+    return -1;
+  }
+  struct files_opened *file = sys_file_helper(fd);
+  if (file == NULL)
+  {
+    return -1;
+  }
+  int ans;
+#ifdef VM
+  unsigned flipped = sys_read_pages(file->f, buffer, size, offset);
+  if (flipped > 0)
+  {
+    ans = flipped + file_read_at(file->f, (uint8_t *)buffer + flipped,
+                                 size - flipped, offset + flipped);
+    sys_file_put(file);
+    return ans;
+  }
+#endif
+  ans = file_read_at(file->f, buffer, size, offset);
+  sys_file_put(file);
+  return ans;
+}
+
+static uint32_t system_pwrite_wrapper(struct intr_frame *f UNUSED,
+                                      const union syscall_arg *a)
+{
+  return sys_pwrite(a[0].i, a[1].p, a[2].u, a[3].u);
+}
+
+int sys_pwrite(int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  if (fd == 0 || fd == 1)
+  {
+    return -1;
+  }
+  struct files_opened *file = sys_file_helper(fd);
+  if (file == NULL)
+  {
+    return -1;
+  }
+  int ans = file_write_at(file->f, buffer, size, offset);
+  sys_file_put(file);
+  return ans;
+}
+
+// The current process's limit on resource, or 0 if there is no such
+// resource
+unsigned sys_getrlimit(int resource)
+{
+  if (resource < 0 || resource >= RLIMIT_CNT)
+  {
+    return 0;
+  }
+  return thread_current()->process->limits[resource];
+}
+
+static uint32_t system_aio_wrapper(struct intr_frame *f,
+                                   const union syscall_arg *a)
+{
+  bool write = *(int *)f->esp == SYS_AIO_WRITE;
+  return sys_aio_submit(a[0].i, a[1].p, a[2].u, a[3].u, write);
+}
+
+// Like pread and pwrite, but returns an id for aio_wait as soon as the
+// request is queued for the I/O workers
+int sys_aio_submit(int fd, void *buffer, unsigned size, unsigned offset,
+                   bool write)
+{
+  if (fd == 0 || fd == 1)
+  {
+    return -1;
+  }
+  struct files_opened *file = sys_file_helper(fd);
+  if (file == NULL || dir_inode_helper(file) != NULL)
+  {
+    sys_file_put(file);
+    return -1;
+  }
+  int id = aio_submit(file->f, buffer, size, offset, write);
+  sys_file_put(file);
+  return id;
+}
+
+/* Copies the cnt entries of the user iovec array uiov into iov and
+   checks every segment they describe, for writing into if write.
+   Returns cnt, or -1 if cnt is out of range. Kills the process if
+   the array or a segment is bad, as read and write do. */
+static int iovec_copy_in(struct iovec *iov, const struct iovec *uiov, int cnt,
+                         bool write)
+{
+  if (cnt < 0 || cnt > IOV_MAX)
+  {
+    return -1;
+  }
+  if (!validate_user_buffer(uiov, cnt * sizeof *uiov, false))
+  {
+    sys_exit(-1);
+  }
+  memcpy(iov, uiov, cnt * sizeof *uiov);
+  for (int i = 0; i < cnt; i++)
+  {
+    if (!validate_user_buffer(iov[i].iov_base, iov[i].iov_len, write))
+    {
+      sys_exit(-1);
+    }
+  }
+  return cnt;
+}
+
+static uint32_t system_readv_wrapper(struct intr_frame *f UNUSED,
+                                     const union syscall_arg *a)
+{
+  struct iovec iov[IOV_MAX];
+  // Same as read, stdout cannot be read
+  if (a[0].i == 1)
+  {
+    sys_exit(-1);
+  }
+  int cnt = iovec_copy_in(iov, a[1].p, a[2].i, true);
+  return cnt < 0 ? -1 : sys_readv(a[0].i, iov, cnt);
+}
+
+// iov is a kernel copy whose segments have all been checked
+int sys_readv(int fd, const struct iovec *iov, int cnt)
+{
+  if (fd == 0 && !fd_has_file(0))
+  {
+    int total = 0;
+    for (int i = 0; i < cnt; i++)
+    {
+      int n = sys_read(0, iov[i].iov_base, iov[i].iov_len);
+      total += n;
+      if ((size_t)n < iov[i].iov_len)
+      {
+        break;
+      }
+    }
+    return total;
+  }
+  struct files_opened *file = sys_file_helper(fd);
+  if (file == NULL)
+  {
+    return -1;
+  }
+  int ans = file_readv(file->f, iov, cnt);
+  sys_file_put(file);
+  return ans;
+}
+
+static uint32_t system_writev_wrapper(struct intr_frame *f UNUSED,
+                                      const union syscall_arg *a)
+{
+  struct iovec iov[IOV_MAX];
+  // Same as write, stdin cannot be written
+  if (a[0].i == 0)
+  {
+    sys_exit(-1);
+  }
+  int cnt = iovec_copy_in(iov, a[1].p, a[2].i, false);
+  return cnt < 0 ? -1 : sys_writev(a[0].i, iov, cnt);
+}
+
+int sys_writev(int fd, const struct iovec *iov, int cnt)
+{
+  if (fd == 1 && !fd_has_file(1))
+  {
+    int total = 0;
+    for (int i = 0; i < cnt; i++)
+    {
+      stdout_write(iov[i].iov_base, iov[i].iov_len);
+      total += iov[i].iov_len;
+    }
+    return total;
+  }
+  struct files_opened *file = sys_file_helper(fd);
+  if (file == NULL)
+  {
+    return -1;
+  }
+  int ans = file_writev(file->f, iov, cnt);
+  sys_file_put(file);
+  return ans;
+}
+
+static uint32_t system_copy_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
+{
+  return sys_copy(a[0].i, a[1].i, a[2].u);
+}
+
+// Copies between two files in the kernel, so no buffer needs checking.
+// The console is not a file, so fds 0 and 1 are refused
+int sys_copy(int to, int from, unsigned size)
+{
+  if (to == 0 || to == 1 || from == 0 || from == 1)
+  {
+    return -1;
+  }
+  struct files_opened *dst = sys_file_helper(to);
+  struct files_opened *src = sys_file_helper(from);
+  int ans = -1;
+  if (dst != NULL && src != NULL)
+  {
+    ans = file_copy(dst->f, src->f, size);
+  }
+  sys_file_put(dst);
+  sys_file_put(src);
+  return ans;
+}
+
+static uint32_t system_fallocate_wrapper(struct intr_frame *f UNUSED,
+                                         const union syscall_arg *a)
+{
+  return sys_fallocate(a[0].i, a[1].u);
+}
+
+// Grows the file to length bytes with the sectors it has yet to write
+// set aside in one run, so that writing it later lays it out
+// contiguously. Directories and the console are refused
+bool sys_fallocate(int fd, unsigned length)
+{
+  if (fd == 0 || fd == 1 || length > INT32_MAX)
+  {
+    return false;
+  }
+  struct files_opened *file = sys_file_helper(fd);
+  if (file == NULL)
+  {
+    return false;
+  }
+  bool ok = file_allocate(file->f, length);
+  sys_file_put(file);
+  return ok;
+}
+
+static uint32_t system_fsync_wrapper(struct intr_frame *f UNUSED,
+                                     const union syscall_arg *a)
+{
+  return sys_fsync(a[0].i);
+}
+
+// Writes what has been written to the file to disk, data and metadata,
+// instead of leaving it to write-behind or shutdown. Pipes and the
+// console have nothing to write
+bool sys_fsync(int fd)
+{
+  if (fd == 0 || fd == 1)
+  {
+    return false;
+  }
+  struct files_opened *file = sys_file_helper(fd);
+  if (file == NULL)
+  {
+    return false;
+  }
+  bool ok = file_sync(file->f);
+  sys_file_put(file);
+  return ok;
+}
+
+static uint32_t system_seek_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
+{
+  struct files_opened *opened_file = sys_file_helper(a[0].i);
+  if (opened_file == NULL)
+  { // fail
+    return -1;
+  }
+  file_seek(opened_file->f, a[1].u);
+  sys_file_put(opened_file);
+  return a[1].u;
+}
+
+static uint32_t system_tell_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
+{
+  struct files_opened *file = sys_file_helper(a[0].i);
+  if (file == NULL)
+  {
+    return -1;
+  }
+  unsigned pos = file_tell(file->f);
+  sys_file_put(file);
+  return pos;
+}
+
+#ifdef VM
+static uint32_t system_mmap_wrapper(struct intr_frame *f UNUSED,
+                                    const union syscall_arg *a)
+{
+  return sys_mmap(a[0].i, a[1].p);
+}
+
+// Pages are read in on first touch, so no copy through a kernel buffer
+int sys_mmap(int fd, void *addr)
+{
+  // stdin and stdout cannot be mapped
+  if (fd == 0 || fd == 1)
+  {
+    return -1;
+  }
+  struct files_opened *file = sys_file_helper(fd);
+  if (file == NULL)
+  {
+    return -1;
+  }
+  int mapping = mmap_map(file->f, addr);
+  sys_file_put(file);
+  return mapping;
+}
+
+static uint32_t system_munmap_wrapper(struct intr_frame *f UNUSED,
+                                      const union syscall_arg *a)
+{
+  sys_munmap(a[0].i);
+  return 0;
+}
+
+void sys_munmap(int mapping)
+{
+  mmap_unmap(mapping);
+}
+
+static uint32_t system_checkpoint_wrapper(struct intr_frame *f,
+                                          const union syscall_arg *a)
+{
+  return sys_checkpoint(f, a[0].i);
+}
+
+/* Writes an image of the process, resuming from this call, to the
+   file open as fd, along with the positions of the first of its
+   other open files. A process restore()d from the image gets 1
+   from the call, and this one 0, or -1 if the image could not be
+   written. */
+int sys_checkpoint(struct intr_frame *f, int fd)
+{
+  if (fd == 0 || fd == 1)
+  {
+    return -1;
+  }
+  struct files_opened *file = sys_file_helper(fd);
+  if (file == NULL)
+  {
+    return -1;
+  }
+
+  struct process *t = thread_current()->process;
+  struct checkpoint_fd fds[CHECKPOINT_FDS_MAX];
+  int cnt = 0;
+  lock_acquire(&t->files_lock);
+  for (size_t i = 2; i < t->fd_cap && cnt < CHECKPOINT_FDS_MAX; i++)
+  {
+    struct files_opened *open = t->fd_table[i];
+    // Only files on disk can be reopened at the same position
+    if (open != NULL && open != file && file_get_inode(open->f) != NULL)
+    {
+      fds[cnt].fd = i;
+      fds[cnt].pos = file_tell(open->f);
+      cnt++;
+    }
+  }
+  lock_release(&t->files_lock);
+
+  sys_flush_stdout();
+  int ans = checkpoint_save(file->f, f, fds, cnt) ? 0 : -1;
+  sys_file_put(file);
+  return ans;
+}
+
+static uint32_t system_restore_wrapper(struct intr_frame *f UNUSED,
+                                       const union syscall_arg *a)
+{
+  return sys_restore(a[0].s);
+}
+
+tid_t sys_restore(const char *file)
+{
+  sys_flush_stdout();
+  return process_restore(file);
+}
+#endif
+
+static uint32_t system_ring_setup_wrapper(struct intr_frame *f UNUSED,
+                                          const union syscall_arg *a)
+{
+  return sys_ring_setup(a[0].p, a[1].p);
+}
+
+// Each ring must be a page of its own that the process can write
+bool sys_ring_setup(struct ring_sq *sq, struct ring_cq *cq)
+{
+  if (pg_ofs(sq) != 0 || pg_ofs(cq) != 0 || (void *)sq == (void *)cq ||
+      !validate_user_buffer(sq, RING_SIZE, true) ||
+      !validate_user_buffer(cq, RING_SIZE, true))
+  {
+    return false;
+  }
+  struct process *t = thread_current()->process;
+  t->ring_sq = sq;
+  t->ring_cq = cq;
+  return true;
+}
+
+/* Makes the system call e asks for and returns its result. The
+   pointers in e are checked the way their own wrappers check them,
+   but fds that those would exit on just fail. */
+static int ring_do(const struct ring_sqe *e)
+{
+  switch (e->op)
+  {
+  case RING_READ:
+  {
+    if (e->fd < 0 || e->fd == 1)
+    {
+      return -1;
+    }
+    if (!validate_user_buffer(e->buffer, e->size, true))
+    {
+      sys_exit(-1);
+    }
+    return sys_read(e->fd, e->buffer, e->size);
+  }
+  case RING_WRITE:
+  {
+    if (e->fd == 0)
+    {
+      return -1;
+    }
+    if (!validate_user_buffer(e->buffer, e->size, false))
+    {
+      sys_exit(-1);
+    }
+    return sys_write(e->fd, e->buffer, e->size);
+  }
+  case RING_SEEK:
+  {
+    struct files_opened *file = sys_file_helper(e->fd);
+    if (file == NULL)
+    {
+      return -1;
+    }
+    file_seek(file->f, e->size);
+    sys_file_put(file);
+    return 0;
+  }
+  case RING_OPEN:
+  {
+    if (!validate_user_string(e->buffer))
+    {
+      sys_exit(-1);
+    }
+    return sys_open(e->buffer);
+  }
+  case RING_CLOSE:
+  {
+    if (e->fd == 0 || e->fd == 1)
+    {
+      return -1;
+    }
+    return sys_close(e->fd) == 1 ? 0 : -1;
+  }
+  default:
+    return -1;
+  }
+}
+
+/* Makes the system calls queued on the current process's
+   submission ring, posting each result on its completion ring,
+   until the first is empty or the second is full. Returns how many
+   it made, or -1 if no rings are registered. */
+int sys_submit(void)
+{
+  struct process *t = thread_current()->process;
+  struct ring_sq *sq = t->ring_sq;
+  struct ring_cq *cq = t->ring_cq;
+  if (sq == NULL)
+  {
+    return -1;
+  }
+  // The process may have unmapped them since ring_setup
+  if (!validate_user_buffer(sq, RING_SIZE, true) ||
+      !validate_user_buffer(cq, RING_SIZE, true))
+  {
+    sys_exit(-1);
+  }
+
+  int done = 0;
+  uint32_t head = sq->head;
+  uint32_t cq_tail = cq->tail;
+  while (head != sq->tail && cq_tail - cq->head < RING_CQ_ENTRIES)
+  {
+    // A copy, so the process cannot change it under the checks
+    struct ring_sqe e = sq->entries[head % RING_SQ_ENTRIES];
+    struct ring_cqe *c = &cq->entries[cq_tail % RING_CQ_ENTRIES];
+    c->result = ring_do(&e);
+    c->user_data = e.user_data;
+    cq->tail = ++cq_tail;
+    sq->head = ++head;
+    done++;
+  }
+  return done;
+}
@@ -1,44 +1,78 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+struct file;
+struct iovec;
+struct rusage;
+struct pollfd;
+struct dirent_plus;
+struct spawn_fd;
+struct ring_sq;
+struct ring_cq;
 
-extern struct lock global_lock; // filesystem functions will be mutually exclusive
 
 
 void syscall_init (void);
-
-// wrappers
-void system_exit_wrapper(struct intr_frame *f);
-void system_exec_wrapper(struct intr_frame *f);
-void system_wait_wrapper(struct intr_frame *f);
-void system_halt_wrapper(struct intr_frame *f);
-
-void system_create_wrapper(struct intr_frame *f);
-void system_remove_wrapper(struct intr_frame *f);
-void system_open_wrapper(struct intr_frame *f);
-void system_filesize_wrapper(struct intr_frame *f);
-void system_read_wrapper(struct intr_frame *f);
-void system_write_wrapper(struct intr_frame *f);
-void system_close_wrapper(struct intr_frame *f);
-// void system_tell_wrapper(struct intr_frame *f);
-// void system_seek_wrapper(struct intr_frame *f);
+void syscall_sysenter (struct intr_frame *f);
 
 // fun_to call file & system call
 
 void sys_halt ();
 int sys_wait (tid_t t);
+tid_t sys_wait_any (int *status);
 void sys_exit (int status);
+bool validate_user_buffer(const void *buffer, unsigned size, bool write);
 tid_t sys_exec (const char *file);
+tid_t sys_execv (const char *file, char *const argv[]);
+tid_t sys_spawn (const char *cmd_line);
+tid_t sys_spawn_fds (const char *cmd_line, const struct spawn_fd *, int cnt);
+tid_t sys_fork (struct intr_frame *f);
 
 int sys_write(int fd, const void *buffer, unsigned size);
 int sys_read(int fd, void *buffer, unsigned size);
+int sys_pread (int fd, void *buffer, unsigned size, unsigned offset);
+int sys_pwrite (int fd, const void *buffer, unsigned size, unsigned offset);
+unsigned sys_getrlimit (int resource);
+int sys_aio_submit (int fd, void *buffer, unsigned size, unsigned offset,
+                    bool write);
+int sys_readv (int fd, const struct iovec *iov, int cnt);
+int sys_writev (int fd, const struct iovec *iov, int cnt);
+int sys_copy (int to, int from, unsigned size);
+bool sys_fallocate (int fd, unsigned length);
+bool sys_fsync (int fd);
+int sys_getrusage (int who, struct rusage *usage, int cnt);
 bool sys_create (const char *file, unsigned initial_size);
 bool sys_remove (const char *file);
+int sys_create_many (const char *const names[], unsigned initial_size,
+                     bool ok[], int cnt);
+int sys_remove_many (const char *const names[], bool ok[], int cnt);
+int sys_stat_many (const char *const names[], struct dirent_plus *, int cnt);
 int sys_open (const char *file);
 int sys_filesize (struct files_opened *file);
-void sys_seek (struct intr_frame *f);
-void sys_tell(struct intr_frame *f);
 int sys_close (int fd);
+void sys_close_all (void);
+void sys_flush_stdout (void);
+bool sys_dup_files (struct thread *parent);
+bool sys_adopt_file (int fd, struct file *);
+int sys_dup2 (int old_fd, int new_fd);
+struct file *sys_file_dup (int fd);
+int sys_pipe (int fds[2]);
+int sys_shm_open (const char *name, int size);
+bool sys_readdir (int fd, char *name);
+int sys_readdir_plus (int fd, struct dirent_plus *, int cnt);
+bool sys_isdir (int fd);
+int sys_inumber (int fd);
+int sys_poll (struct pollfd *fds, int nfds, int timeout);
+bool sys_set_nonblock (int fd, bool nonblock);
+void *sys_shm_map (int fd, void *addr);
+bool sys_ring_setup (struct ring_sq *sq, struct ring_cq *cq);
+int sys_submit (void);
+#ifdef VM
+int sys_mmap (int fd, void *addr);
+void sys_munmap (int mapping);
+int sys_checkpoint (struct intr_frame *f, int fd);
+tid_t sys_restore (const char *file);
+#endif
 
 
 #endif /* userprog/syscall.h */
\ No newline at end of file
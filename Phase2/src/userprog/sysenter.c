@@ -0,0 +1,45 @@
+#include "userprog/sysenter.h"
+#include <stdint.h>
+#include "threads/init.h"
+#include "threads/loader.h"
+#include "userprog/tss.h"
+
+/* Model-specific registers that SYSENTER loads CS, ESP, and EIP
+   from.  See [IA32-v2b] "SYSENTER". */
+#define MSR_SYSENTER_CS 0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+/* CPUID leaf 1 feature flag in EDX for SYSENTER and SYSEXIT. */
+#define CPUID_SEP (1u << 11)
+
+/* Entry point, in sysenter-stub.S. */
+void sysenter_entry (void);
+
+/* Writes VALUE to model-specific register MSR. */
+static void
+write_msr (uint32_t msr, uint64_t value)
+{
+  asm volatile ("wrmsr"
+                : : "c" (msr), "a" ((uint32_t) value),
+                    "d" ((uint32_t) (value >> 32)));
+}
+
+/* Lets user processes enter system calls through SYSENTER as
+   well as int $0x30, if the CPU has it.  SYSEXIT goes back to the
+   user segments that follow SEL_KCSEG in the GDT, which is how
+   gdt_init() lays them out.  SYSENTER always loads the same stack
+   pointer, so it is pointed at the TSS's esp0, which tss_update()
+   keeps set to the running thread's kernel stack, and the entry
+   stub loads the stack pointer from there.  Must be called after
+   tss_init(). */
+void
+sysenter_init (void)
+{
+  if ((cpu_features () & CPUID_SEP) == 0)
+    return;
+
+  write_msr (MSR_SYSENTER_CS, SEL_KCSEG);
+  write_msr (MSR_SYSENTER_ESP, (uintptr_t) tss_get_esp0 ());
+  write_msr (MSR_SYSENTER_EIP, (uintptr_t) sysenter_entry);
+}
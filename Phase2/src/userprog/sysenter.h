@@ -0,0 +1,6 @@
+#ifndef USERPROG_SYSENTER_H
+#define USERPROG_SYSENTER_H
+
+void sysenter_init (void);
+
+#endif /* userprog/sysenter.h */
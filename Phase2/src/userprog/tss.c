@@ -2,6 +2,10 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/flags.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/kstack.h"
 #include "threads/thread.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -75,6 +79,21 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* A double fault switches to this task, rather than pushing onto
+   the current stack, which is how a guarded kernel stack that
+   overflows gets reported instead of resetting the machine: the
+   page fault on its guard page cannot be delivered on the stack
+   that caused it, and neither could a double fault.  The task
+   runs on the lower page of the two-page guarded stack of the
+   "double-fault" thread, which blocks for good as soon as it
+   runs, keeping its own frames in the page above, so that
+   thread_current() still finds a thread there. */
+static struct tss *df_tss;
+static struct thread *df_thread;
+
+static void df_park (void *aux);
+static void double_fault (void);
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -86,6 +105,53 @@ tss_init (void)
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update ();
+
+  df_tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  df_tss->cr3 = vtop (init_page_dir);
+  df_tss->eip = double_fault;
+  df_tss->eflags = FLAG_MBS;
+  df_tss->cs = SEL_KCSEG;
+  df_tss->ss = df_tss->ds = df_tss->es = SEL_KDSEG;
+  df_tss->bitmap = 0xdfff;
+  thread_create_stack ("double-fault", PRI_MAX, 2, df_park, NULL);
+}
+
+/* Returns the TSS that double faults switch to. */
+struct tss *
+tss_get_double_fault (void)
+{
+  ASSERT (df_tss != NULL);
+  return df_tss;
+}
+
+/* Gives the double fault task the page below the running
+   thread's struct thread for its stack, points double faults at
+   the task, and blocks for good. */
+static void
+df_park (void *aux UNUSED)
+{
+  df_thread = thread_current ();
+  intr_disable ();
+  df_tss->esp = (uint32_t) pg_round_down (df_thread);
+  intr_register_task (0x08, SEL_DFTSS, "#DF Double Fault Exception");
+  thread_block ();
+  NOT_REACHED ();
+}
+
+/* Runs, as its own task, on a double fault.  The page fault that
+   caused it, if it was one, left its address in CR2. */
+static void
+double_fault (void)
+{
+  struct thread *t;
+  void *fault_addr;
+
+  asm ("movl %%cr2, %0" : "=r" (fault_addr));
+  df_thread->status = THREAD_RUNNING;
+  t = kstack_guard_owner (fault_addr);
+  if (t != NULL)
+    PANIC ("kernel stack overflow in thread `%s' at %p", t->name, fault_addr);
+  PANIC ("double fault");
 }
 
 /* Returns the kernel TSS. */
@@ -96,11 +162,20 @@ tss_get (void)
   return tss;
 }
 
+/* Returns where the TSS keeps the ring 0 stack pointer, for an
+   entry path that the CPU does not switch stacks for by itself. */
+void **
+tss_get_esp0 (void)
+{
+  ASSERT (tss != NULL);
+  return &tss->esp0;
+}
+
 /* Sets the ring 0 stack pointer in the TSS to point to the end
    of the thread stack. */
 void
 tss_update (void) 
 {
   ASSERT (tss != NULL);
-  tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  tss->esp0 = thread_kstack_top (thread_current ());
 }
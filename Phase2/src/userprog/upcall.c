@@ -0,0 +1,103 @@
+#include "userprog/upcall.h"
+#include <debug.h>
+#include <list.h>
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#include "userprog/process.h"
+
+/* Scheduler upcalls, for a user-level thread runtime that runs
+   its threads on a few kernel threads of a process.
+
+   While it has nothing to run, a kernel thread of the runtime
+   parks itself with upcall_wait().  Whenever another thread of
+   the same process blocks in the kernel, in a read() say, the
+   kernel wakes a parked thread, which goes on running the
+   user-level threads that the blocked one cannot.  This is the
+   "block" half of scheduler activations; the runtime learns that
+   a blocked thread is back when it returns to user space.
+
+   A wakeup that finds no thread parked, from upcall_wake() or a
+   block, is kept for the next thread to park, so that the runtime
+   does not lose one that comes between its deciding to park and
+   parking.  A few are kept from upcall_wake() but only one from
+   blocks: the runtime can make sense of a spurious wakeup, but not
+   of a missing one.
+
+   The parked threads and kept wakeups of a process are touched
+   only with interrupts off, since thread_block() wakes a thread
+   from under the scheduler. */
+
+/* Parks the current thread until another thread of its process
+   blocks or calls upcall_wake(), unless a kept wakeup lets it
+   return at once.  Also returns at once, or wakes, when the
+   process is exiting. */
+void
+upcall_wait (void)
+{
+  struct thread *cur = thread_current ();
+  struct process *proc = cur->process;
+  enum intr_level old_level = intr_disable ();
+
+  if (proc->upcall_pending > 0)
+    proc->upcall_pending--;
+  else if (!proc->exiting)
+    {
+      list_push_back (&proc->upcall_waiters, &cur->elem);
+      cur->upcall_parked = true;
+      thread_block ();
+      cur->upcall_parked = false;
+    }
+  intr_set_level (old_level);
+}
+
+/* Wakes up to CNT threads of the current process parked in
+   upcall_wait(), keeping wakeups for as many of the rest as
+   there are threads to use them. */
+void
+upcall_wake (int cnt)
+{
+  struct process *proc = thread_current ()->process;
+  enum intr_level old_level = intr_disable ();
+
+  for (; cnt > 0 && !list_empty (&proc->upcall_waiters); cnt--)
+    thread_unblock (list_entry (list_pop_front (&proc->upcall_waiters),
+                                struct thread, elem));
+  if (cnt > PROCESS_THREAD_MAX + 1 - proc->upcall_pending)
+    cnt = PROCESS_THREAD_MAX + 1 - proc->upcall_pending;
+  if (cnt > 0)
+    proc->upcall_pending += cnt;
+  intr_set_level (old_level);
+}
+
+/* Called by thread_block() as T, the running thread, blocks:
+   wakes a thread of T's process parked in upcall_wait() to take
+   its place, or keeps a wakeup for the next.  Interrupts must be
+   off. */
+void
+upcall_block (struct thread *t)
+{
+  struct process *proc = t->process;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (proc == NULL || t->upcall_parked)
+    return;
+  if (!list_empty (&proc->upcall_waiters))
+    thread_unblock (list_entry (list_pop_front (&proc->upcall_waiters),
+                                struct thread, elem));
+  else if (proc->upcall_pending == 0)
+    proc->upcall_pending = 1;
+}
+
+/* Wakes every thread of PROC parked in upcall_wait(), as when
+   PROC starts exiting, so that they see it and die. */
+void
+upcall_wake_all (struct process *proc)
+{
+  enum intr_level old_level = intr_disable ();
+
+  while (!list_empty (&proc->upcall_waiters))
+    thread_unblock (list_entry (list_pop_front (&proc->upcall_waiters),
+                                struct thread, elem));
+  intr_set_level (old_level);
+}
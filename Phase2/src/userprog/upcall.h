@@ -0,0 +1,12 @@
+#ifndef USERPROG_UPCALL_H
+#define USERPROG_UPCALL_H
+
+struct process;
+struct thread;
+
+void upcall_wait (void);
+void upcall_wake (int cnt);
+void upcall_block (struct thread *);
+void upcall_wake_all (struct process *);
+
+#endif /* userprog/upcall.h */
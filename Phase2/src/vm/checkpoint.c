@@ -0,0 +1,271 @@
+#include "vm/checkpoint.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Checkpoint images.
+
+   checkpoint_save() writes the current process's user pages, the
+   registers of the system call it is in, and the positions of
+   some of its open files to a file.  A process that restore()
+   starts from the image resumes from that system call with 1 as
+   its result, where the checkpointing process got 0, so that a
+   program can warm up once and then be started warm any number
+   of times.
+
+   The image is a header, a table with an entry for each page,
+   and then, from the next page boundary, a copy of every page
+   that is not all zeros, in table order.  Each page-aligned copy
+   can be read in the same way as a page of an executable, so
+   checkpoint_load() reads nothing but the header and table:
+   every page is only recorded in the supplemental page table,
+   and comes in from the image when first touched, or from swap
+   once it has been written.
+
+   Only the calling thread's registers are saved, so other
+   threads of the process should be idle while it checkpoints,
+   and only its main thread is restored.  Pages of memory-mapped
+   files and shared memory are left out, as by fork(). */
+
+#define CHECKPOINT_MAGIC 0x43484b50     /* Identifies an image. */
+
+/* Flags in the low bits of a page table entry, whose high bits
+   are the page's user address. */
+#define CKPT_WRITABLE 0x1               /* Writable by the process. */
+#define CKPT_ZERO 0x2                   /* All zeros, so no copy. */
+
+/* Entries of the page table read or written at once. */
+#define TABLE_CHUNK (PGSIZE / sizeof (uint32_t))
+
+/* Image header, at offset 0. */
+struct checkpoint_header
+  {
+    unsigned magic;                     /* CHECKPOINT_MAGIC. */
+    uint32_t edi, esi, ebp, ebx;        /* Registers at the system */
+    uint32_t edx, ecx, eip, esp;        /* call. */
+    uint32_t heap_start, heap_brk;      /* Heap bounds. */
+    uint32_t stack_slots;               /* Thread stack slots in use. */
+    uint32_t page_cnt;                  /* Entries in the page table. */
+    uint32_t fd_cnt;                    /* Entries of FDS in use. */
+    struct checkpoint_fd fds[CHECKPOINT_FDS_MAX];
+  };
+
+/* Returns the offset of the first page copy in an image with
+   PAGE_CNT pages. */
+static off_t
+data_start (size_t page_cnt)
+{
+  return ROUND_UP (sizeof (struct checkpoint_header)
+                   + page_cnt * sizeof (uint32_t), PGSIZE);
+}
+
+/* Returns true if process T's page P holds nothing but zeros
+   without having to be read: it is not from a file, has never
+   been written to swap, and is not mapped. */
+static bool
+is_zero (struct process *t, const struct page *p)
+{
+  return (p->file == NULL && p->frame == NULL
+          && p->swap_sector == SWAP_NONE
+          && pagedir_get_page (t->pagedir, p->upage) == NULL);
+}
+
+/* Writes a checkpoint of the current process to FILE, from offset
+   0, with the registers of the system call whose frame is F and
+   the FD_CNT positions in FDS.  Pages that are not in memory are
+   brought in to be copied.  Returns false if memory runs out or
+   FILE cannot be written. */
+bool
+checkpoint_save (struct file *file, const struct intr_frame *f,
+                 const struct checkpoint_fd *fds, int fd_cnt)
+{
+  struct process *t = thread_current ()->process;
+  struct checkpoint_header h;
+  struct hash_iterator i;
+  uint32_t *table;
+  void *buf = NULL;
+  size_t cnt = 0;
+  size_t n;
+  off_t ofs;
+  bool success = false;
+
+  ASSERT (fd_cnt >= 0 && fd_cnt <= CHECKPOINT_FDS_MAX);
+
+  /* List the pages under the process's lock, then copy them
+     without it, since copying may fault them in. */
+  lock_acquire (&t->lock);
+  table = malloc (hash_size (&t->pages) * sizeof *table);
+  if (table == NULL)
+    {
+      lock_release (&t->lock);
+      return false;
+    }
+  hash_first (&i, &t->pages);
+  while (hash_next (&i))
+    {
+      struct page *p = hash_entry (hash_cur (&i), struct page, hash_elem);
+
+      if (p->writeback)
+        continue;
+      table[cnt++] = ((uintptr_t) p->upage
+                      | (p->writable ? CKPT_WRITABLE : 0)
+                      | (is_zero (t, p) ? CKPT_ZERO : 0));
+    }
+  lock_release (&t->lock);
+
+  memset (&h, 0, sizeof h);
+  h.edi = f->edi;
+  h.esi = f->esi;
+  h.ebp = f->ebp;
+  h.ebx = f->ebx;
+  h.edx = f->edx;
+  h.ecx = f->ecx;
+  h.eip = (uintptr_t) f->eip;
+  h.esp = (uintptr_t) f->esp;
+  h.heap_start = (uintptr_t) t->heap_start;
+  h.heap_brk = (uintptr_t) t->heap_brk;
+  h.stack_slots = t->stack_slots;
+  h.page_cnt = cnt;
+  h.fd_cnt = fd_cnt;
+  memcpy (h.fds, fds, fd_cnt * sizeof *fds);
+
+  /* The header goes in last, with its magic number, so that an
+     image cut short is never loaded. */
+  buf = palloc_get_page (0);
+  if (buf == NULL
+      || file_write_at (file, &h, sizeof h, 0) != sizeof h
+      || (file_write_at (file, table, cnt * sizeof *table, sizeof h)
+          != (off_t) (cnt * sizeof *table)))
+    goto done;
+  ofs = data_start (cnt);
+  for (n = 0; n < cnt; n++)
+    if (!(table[n] & CKPT_ZERO))
+      {
+        memcpy (buf, (void *) (table[n] & ~PGMASK), PGSIZE);
+        if (file_write_at (file, buf, PGSIZE, ofs) != PGSIZE)
+          goto done;
+        ofs += PGSIZE;
+      }
+  h.magic = CHECKPOINT_MAGIC;
+  success = file_write_at (file, &h, sizeof h, 0) == sizeof h;
+
+ done:
+  palloc_free_page (buf);
+  free (table);
+  return success;
+}
+
+/* Reads the header of the image in FILE into H.  Returns false if
+   FILE does not hold a whole image. */
+static bool
+read_header (struct file *file, struct checkpoint_header *h)
+{
+  return (file_read_at (file, h, sizeof *h, 0) == sizeof *h
+          && h->magic == CHECKPOINT_MAGIC
+          && h->fd_cnt <= CHECKPOINT_FDS_MAX
+          && h->page_cnt <= (uintptr_t) PHYS_BASE / PGSIZE);
+}
+
+/* Stores in FDS the open file positions that the image in FILE
+   records.  Returns how many there are, or -1 if FILE does not
+   hold an image. */
+int
+checkpoint_read_fds (struct file *file,
+                     struct checkpoint_fd fds[CHECKPOINT_FDS_MAX])
+{
+  struct checkpoint_header h;
+
+  if (!read_header (file, &h))
+    return -1;
+  memcpy (fds, h.fds, h.fd_cnt * sizeof *fds);
+  return h.fd_cnt;
+}
+
+/* Gives the current process, whose page directory and
+   supplemental page table are new and empty, the pages of the
+   image in FILE, to be read from FILE as they are touched, and
+   its heap, and stores in F the registers to resume with.  FILE
+   must stay open as long as the process may touch a page it has
+   not yet.  Returns false if FILE does not hold an image or
+   memory runs out. */
+bool
+checkpoint_load (struct file *file, struct intr_frame *f)
+{
+  struct process *t = thread_current ()->process;
+  struct checkpoint_header h;
+  uint32_t *table;
+  size_t first, i;
+  off_t ofs;
+  bool success = false;
+
+  if (!read_header (file, &h))
+    return false;
+  table = palloc_get_page (0);
+  if (table == NULL)
+    return false;
+
+  ofs = data_start (h.page_cnt);
+  for (first = 0; first < h.page_cnt; first += TABLE_CHUNK)
+    {
+      size_t n = h.page_cnt - first < TABLE_CHUNK
+                 ? h.page_cnt - first : TABLE_CHUNK;
+
+      if (file_read_at (file, table, n * sizeof *table,
+                        sizeof h + first * sizeof *table)
+          != (off_t) (n * sizeof *table))
+        goto done;
+      for (i = 0; i < n; i++)
+        {
+          void *upage = (void *) (table[i] & ~PGMASK);
+          bool writable = (table[i] & CKPT_WRITABLE) != 0;
+
+          if (upage == NULL || !is_user_vaddr (upage))
+            goto done;
+          if (table[i] & CKPT_ZERO)
+            {
+              if (!page_add_file (upage, NULL, 0, 0, writable))
+                goto done;
+            }
+          else
+            {
+              if (!page_add_file (upage, file, ofs, PGSIZE, writable))
+                goto done;
+              ofs += PGSIZE;
+            }
+        }
+    }
+  if (file_length (file) < ofs
+      || h.heap_start > h.heap_brk
+      || !is_user_vaddr ((void *) h.heap_brk))
+    goto done;
+
+  t->heap_start = (uint8_t *) h.heap_start;
+  t->heap_brk = (uint8_t *) h.heap_brk;
+  t->stack_slots = h.stack_slots;
+
+  f->edi = h.edi;
+  f->esi = h.esi;
+  f->ebp = h.ebp;
+  f->ebx = h.ebx;
+  f->edx = h.edx;
+  f->ecx = h.ecx;
+  f->eax = 1;
+  f->eip = (void (*) (void)) h.eip;
+  f->esp = (void *) h.esp;
+  success = true;
+
+ done:
+  palloc_free_page (table);
+  return success;
+}
@@ -0,0 +1,27 @@
+#ifndef VM_CHECKPOINT_H
+#define VM_CHECKPOINT_H
+
+#include <spawn.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct intr_frame;
+
+/* Most open files whose positions a checkpoint records. */
+#define CHECKPOINT_FDS_MAX SPAWN_FDS_MAX
+
+/* An open file's position, as a checkpoint records it. */
+struct checkpoint_fd
+  {
+    int fd;                             /* File descriptor. */
+    off_t pos;                          /* Position in the file. */
+  };
+
+bool checkpoint_save (struct file *, const struct intr_frame *,
+                      const struct checkpoint_fd *, int fd_cnt);
+int checkpoint_read_fds (struct file *,
+                         struct checkpoint_fd fds[CHECKPOINT_FDS_MAX]);
+bool checkpoint_load (struct file *, struct intr_frame *);
+
+#endif /* vm/checkpoint.h */
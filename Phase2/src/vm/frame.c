@@ -0,0 +1,1063 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <memstat.h>
+#include <stats.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/swap.h"
+
+/* Eviction is by WSClock.  A page's age is how much CPU time its
+   owner has had since the page was last seen used, which the
+   aging thread samples from the accessed bits every AGE_TICKS.
+   A page younger than WS_TAU is in its owner's working set, so a
+   process scanning through a large file ages only its own pages
+   and leaves everyone else's alone, and a process that is
+   blocked does not see its working set age at all. */
+#define AGE_TICKS (TIMER_FREQ / 10)     /* Interval between agings. */
+#define WS_TAU (TIMER_FREQ / 2)         /* Working set window. */
+
+/* Free user pages below which the aging thread evicts a batch of
+   frames itself and writes back dirty file pages, so that page
+   faults find a free page or a clean victim waiting. */
+#define FREE_LOW 16
+
+/* Statistics. */
+static uint64_t reclaim_cnt;    /* Frames freed by the aging thread. */
+static uint64_t clean_cnt;      /* File pages it wrote back. */
+static uint64_t huge_cnt;       /* 4 MB pages mapped. */
+static uint64_t split_cnt;      /* 4 MB pages split. */
+
+/* Every frame that holds a user page, in clock order. */
+static struct list frames;
+
+/* The clock hand: the next frame to consider for eviction, or
+   list_end (&frames). */
+static struct list_elem *hand;
+
+/* Protects frames, hand, the frames on the list, and the
+   pages they hold.  Evictions happen entirely while it is held,
+   so a page whose owner faults on it while it is going out to
+   swap is not looked at again until it is gone. */
+static struct lock frame_lock;
+
+/* The page cache: frames holding pages of files, by inode,
+   offset and length.  Every page brought in from a file, whether
+   of an executable or a memory-mapped file, is looked for here
+   first, so that processes mapping the same page share a frame.
+   A cached frame keeps its inode open and is stale once anything
+   has written the inode.  Cached frames are on the frame table
+   like any other and are evicted by the same clock, but unmapped
+   from every process at once.  Protected by frame_lock. */
+static struct hash file_pages;
+
+/* A 4 MB page holding FRAME_HUGE_PAGES pages of zeros, or what a
+   process has written over them, for the aligned region of its
+   address space at UPAGE.  Its frames are not on the frame table,
+   so it is never evicted as it stands, but it is split into
+   ordinary frames when memory runs short, or when one of its
+   pages has to be handled by itself, so that the process never
+   has to know.  The frame structures and the page table that 4 kB
+   pages would need are allocated along with it, so that splitting
+   it cannot fail; until then the page table holds the pages. */
+struct huge_page
+  {
+    struct list_elem elem;              /* Element in huge_pages. */
+    struct process *owner;              /* Process it belongs to. */
+    uint8_t *upage;                     /* User virtual address. */
+    uint8_t *kpage;                     /* Kernel virtual address. */
+    struct page **pages;                /* Its pages, in order, in the
+                                           page table to be. */
+    struct list frames;                 /* Frame structures to be. */
+  };
+
+/* Every huge page, oldest first.  Protected by frame_lock. */
+static struct list huge_pages;
+
+/* Returns a hash value for the file page that frame E holds. */
+static unsigned
+file_page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct frame *f = hash_entry (e, struct frame, cache_elem);
+  return (hash_bytes (&f->inode, sizeof f->inode)
+          ^ hash_int (f->ofs) ^ hash_int (f->read_bytes));
+}
+
+/* Returns true if the file page in frame A precedes B's. */
+static bool
+file_page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+                void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, cache_elem);
+  const struct frame *b = hash_entry (b_, struct frame, cache_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
+
+static void aging_thread (void *aux);
+static void free_huge (struct huge_page *);
+static void split_huge (struct huge_page *);
+
+/* Initializes the frame table and starts the aging thread. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  list_init (&huge_pages);
+  hand = list_end (&frames);
+  lock_init_named (&frame_lock, "frame");
+  if (!hash_init (&file_pages, file_page_hash, file_page_less, NULL))
+    PANIC ("frame_init: out of memory");
+
+  stats_add_uint64 ("frame", NULL, "reclaimed", &reclaim_cnt);
+  stats_add_uint64 ("frame", NULL, "cleaned", &clean_cnt);
+  stats_add_uint64 ("frame", NULL, "huge", &huge_cnt);
+  stats_add_uint64 ("frame", NULL, "split", &split_cnt);
+  thread_create ("frame-age", PRI_DEFAULT, aging_thread, NULL);
+}
+
+/* Removes F from the frame table, moving the clock hand past it
+   if necessary.  frame_lock must be held. */
+static void
+frame_remove (struct frame *f)
+{
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+}
+
+/* Drops a pin on F, and frees F if that was the last pin and no
+   page is held in it any more, which happens when every process
+   that shared it has taken a copy or exited, unless F stays on
+   in the page cache.  frame_lock must be held. */
+static void
+frame_put (struct frame *f)
+{
+  ASSERT (f->pin_cnt > 0);
+
+  if (--f->pin_cnt == 0 && list_empty (&f->pages) && f->inode == NULL)
+    {
+      frame_remove (f);
+      palloc_free_page (f->kpage);
+      free (f);
+    }
+}
+
+/* Takes F out of the page cache, leaving it an ordinary frame
+   for the pages it still holds.  frame_lock must be held. */
+static void
+uncache (struct frame *f)
+{
+  ASSERT (f->inode != NULL);
+
+  hash_delete (&file_pages, &f->cache_elem);
+  inode_close (f->inode);
+  f->inode = NULL;
+}
+
+/* Returns the cached frame holding the page of KEY's inode,
+   offset and length, or a null pointer if there is none that is
+   still current.  A stale one is taken out of the cache.
+   frame_lock must be held. */
+static struct frame *
+cache_lookup (struct frame *key)
+{
+  struct hash_elem *e = hash_find (&file_pages, &key->cache_elem);
+  struct frame *f;
+
+  if (e == NULL)
+    return NULL;
+  f = hash_entry (e, struct frame, cache_elem);
+  if (f->write_cnt == inode_write_cnt (f->inode))
+    return f;
+
+  uncache (f);
+  if (list_empty (&f->pages) && f->pin_cnt == 0)
+    {
+      frame_remove (f);
+      palloc_free_page (f->kpage);
+      free (f);
+    }
+  return NULL;
+}
+
+/* Puts PAGE in F.  frame_lock must be held. */
+static void
+frame_attach (struct frame *f, struct page *page)
+{
+  list_push_back (&f->pages, &page->frame_elem);
+  page->frame = f;
+  page->owner->frame_cnt++;
+  page->last_use = page->owner->cpu_ticks;
+}
+
+/* Returns true if F holds the page of more than one process. */
+static bool
+frame_is_shared (struct frame *f)
+{
+  return list_begin (&f->pages) != list_rbegin (&f->pages);
+}
+
+/* Returns the page F holds, which must be its only one. */
+static struct page *
+frame_page (struct frame *f)
+{
+  ASSERT (!list_empty (&f->pages) && !frame_is_shared (f));
+
+  return list_entry (list_front (&f->pages), struct page, frame_elem);
+}
+
+/* Returns true if any process mapping cached frame F has used it
+   since the last call, clearing the accessed bits as it goes.
+   frame_lock must be held. */
+static bool
+cached_frame_accessed (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      if (pagedir_is_accessed (pd, p->upage))
+        {
+          pagedir_set_accessed (pd, p->upage, false);
+          accessed = true;
+        }
+    }
+  return accessed;
+}
+
+/* Returns true if any process maps cached frame F dirty, which
+   it does only if it read() the page into memory of its own and
+   so cannot have it from the file again.  frame_lock must be
+   held. */
+static bool
+cached_frame_dirty (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+
+      if (pagedir_is_dirty (p->owner->pagedir, p->upage))
+        return true;
+    }
+  return false;
+}
+
+/* Unmaps cached frame F from every process that maps it clean,
+   since they can have the page from the file again, and returns
+   true if just one page, mapped dirty, is left in it, which
+   evict() can then put in swap as it would a private page.
+   frame_lock must be held. */
+static bool
+cached_frame_drop_clean (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages); )
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+
+      e = list_next (e);
+      if (!pagedir_is_dirty (p->owner->pagedir, p->upage))
+        {
+          list_remove (&p->frame_elem);
+          pagedir_clear_page (p->owner->pagedir, p->upage);
+          p->owner->frame_cnt--;
+          p->frame = NULL;
+        }
+    }
+  return !list_empty (&f->pages) && !frame_is_shared (f);
+}
+
+/* Returns true if the page in private frame F has been used
+   since the last call, clearing its accessed bit and noting the
+   time as its last use if so.  frame_lock must be held. */
+static bool
+frame_accessed (struct frame *f)
+{
+  struct page *p = frame_page (f);
+  uint32_t *pd = p->owner->pagedir;
+
+  if (!pagedir_is_accessed (pd, p->upage))
+    return false;
+  pagedir_set_accessed (pd, p->upage, false);
+  p->last_use = p->owner->cpu_ticks;
+  return true;
+}
+
+/* Returns how long the page in private frame F has gone unused,
+   in ticks of its owner's CPU time. */
+static unsigned
+frame_age (struct frame *f)
+{
+  struct page *p = frame_page (f);
+  return p->owner->cpu_ticks - p->last_use;
+}
+
+/* Unmaps F from every process that maps it and takes their pages
+   out of it.  frame_lock must be held. */
+static void
+unmap_all (struct frame *f)
+{
+  while (!list_empty (&f->pages))
+    {
+      struct page *p = list_entry (list_pop_front (&f->pages),
+                                   struct page, frame_elem);
+      pagedir_clear_page (p->owner->pagedir, p->upage);
+      p->owner->frame_cnt--;
+      p->frame = NULL;
+    }
+}
+
+/* Advances the clock hand and returns the frame it passed over.
+   The frame table must not be empty.  frame_lock must be held. */
+static struct frame *
+clock_next (void)
+{
+  struct frame *f;
+
+  if (hand == list_end (&frames))
+    hand = list_begin (&frames);
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Sorts the CNT frames in DIRTY[] by owner and then by user
+   address. */
+static void
+sort_by_address (struct frame *dirty[], size_t cnt)
+{
+  size_t i, j;
+
+  for (i = 1; i < cnt; i++)
+    {
+      struct frame *f = dirty[i];
+      struct page *p = frame_page (f);
+
+      for (j = i; j > 0; j--)
+        {
+          struct page *q = frame_page (dirty[j - 1]);
+          if (q->owner < p->owner
+              || (q->owner == p->owner && q->upage < p->upage))
+            break;
+          dirty[j] = dirty[j - 1];
+        }
+      dirty[j] = f;
+    }
+}
+
+/* Unmaps up to SWAP_BATCH frames chosen by WSClock, writes the
+   dirty ones to swap, and frees all of them but the first, whose
+   page is returned, or a null pointer if no frame could be
+   freed.  The hand takes pages that are out of their owners'
+   working sets and clean, since page_in() can read them from
+   their file again or zero them.  Dirty ones are taken only if
+   there is no clean one, and the page unused longest only if
+   every page is in a working set.  Frames shared copy-on-write
+   are passed over: they are copied away from soon enough if
+   written, and evicting one would mean unmapping it from every
+   process.  A frame in the page cache is clean and can be had
+   again from its file, so it is taken once none of the
+   processes mapping it, if any, has used it since the hand last
+   passed, and unmapped from all of them, unless one maps it
+   dirty, which makes it as good as shared copy-on-write.  If OWNER is nonnull,
+   only frames holding its pages alone are considered.
+   frame_lock must be held. */
+static struct frame *
+evict (struct process *owner)
+{
+  struct frame *victims[SWAP_BATCH];
+  struct frame *dirty[SWAP_BATCH];
+  void *dirty_kpages[SWAP_BATCH];
+  block_sector_t sectors[SWAP_BATCH];
+  size_t victim_cnt = 0, dirty_cnt = 0;
+  struct frame *oldest = NULL;
+  unsigned oldest_age = 0;
+  size_t frame_cnt = list_size (&frames);
+  size_t step, i;
+  struct frame *result = NULL;
+
+  pagedir_batch_begin ();
+  /* A second pass, taken only if the first found nothing, sees
+     every accessed bit clear. */
+  for (step = 0; step < 2 * frame_cnt && victim_cnt < SWAP_BATCH; step++)
+    {
+      struct frame *f;
+      struct page *p;
+      unsigned age;
+
+      if (step == frame_cnt
+          && (victim_cnt > 0 || dirty_cnt > 0 || oldest != NULL))
+        break;
+      f = clock_next ();
+      if (f->pin_cnt > 0)
+        continue;
+      if (f->inode != NULL && owner == NULL)
+        {
+          if (cached_frame_accessed (f))
+            continue;
+          if (!cached_frame_dirty (f))
+            victims[victim_cnt++] = f;
+          else if (dirty_cnt < SWAP_BATCH && cached_frame_drop_clean (f))
+            dirty[dirty_cnt++] = f;
+          continue;
+        }
+      if (frame_is_shared (f) || list_empty (&f->pages))
+        continue;
+      p = frame_page (f);
+      if (owner != NULL && p->owner != owner)
+        continue;
+      if (frame_accessed (f))
+        continue;
+
+      age = frame_age (f);
+      if (age <= WS_TAU)
+        {
+          if (oldest == NULL || age > oldest_age)
+            {
+              oldest = f;
+              oldest_age = age;
+            }
+        }
+      else if (!pagedir_is_dirty (p->owner->pagedir, p->upage))
+        victims[victim_cnt++] = f;
+      else if (dirty_cnt < SWAP_BATCH)
+        dirty[dirty_cnt++] = f;
+    }
+  if (victim_cnt == 0)
+    {
+      for (i = 0; i < dirty_cnt; i++)
+        victims[victim_cnt++] = dirty[i];
+      if (victim_cnt == 0 && oldest != NULL)
+        victims[victim_cnt++] = oldest;
+    }
+
+  dirty_cnt = 0;
+  for (i = 0; i < victim_cnt; i++)
+    {
+      struct frame *f = victims[i];
+      struct page *p;
+      uint32_t *pd;
+
+      f->pin_cnt = 1;
+      if (f->inode != NULL && owner == NULL && !cached_frame_dirty (f))
+        {
+          unmap_all (f);
+          uncache (f);
+          continue;
+        }
+
+      /* Unmap before testing the dirty bit, so that the owner
+         cannot dirty the page after the test. */
+      p = frame_page (f);
+      pd = p->owner->pagedir;
+      pagedir_clear_page (pd, p->upage);
+      if (pagedir_is_dirty (pd, p->upage))
+        {
+          /* Memory-mapped files go back to the file, not swap. */
+          if (p->writeback)
+            file_write_at (p->file, f->kpage, p->read_bytes, p->file_ofs);
+          else
+            dirty[dirty_cnt++] = f;
+        }
+      if (f->inode != NULL)
+        uncache (f);
+    }
+
+  /* Neighbouring pages of a process go out in address order, into
+     neighbouring slots if the batch gets a run of its own, so that
+     a fault on one of them can read the others in with it. */
+  sort_by_address (dirty, dirty_cnt);
+  for (i = 0; i < dirty_cnt; i++)
+    dirty_kpages[i] = dirty[i]->kpage;
+
+  if (dirty_cnt > 0 && !swap_out (dirty_kpages, dirty_cnt, sectors))
+    {
+      /* No room in swap: map the dirty pages again and keep them. */
+      for (i = 0; i < dirty_cnt; i++)
+        {
+          struct frame *f = dirty[i];
+          struct page *p = frame_page (f);
+          uint32_t *pd = p->owner->pagedir;
+
+          if (!pagedir_set_page (pd, p->upage, f->kpage, p->writable))
+            PANIC ("evict: cannot remap page");
+          pagedir_set_dirty (pd, p->upage, true);
+          f->pin_cnt = 0;
+        }
+      dirty_cnt = 0;
+    }
+  for (i = 0; i < dirty_cnt; i++)
+    frame_page (dirty[i])->swap_sector = sectors[i];
+
+  for (i = 0; i < victim_cnt; i++)
+    {
+      struct frame *f = victims[i];
+
+      if (f->pin_cnt == 0)
+        continue;               /* Remapped above. */
+      frame_remove (f);
+      if (!list_empty (&f->pages))
+        {
+          struct page *p = frame_page (f);
+          p->owner->frame_cnt--;
+          p->frame = NULL;
+        }
+      if (result == NULL)
+        result = f;
+      else
+        {
+          palloc_free_page (f->kpage);
+          free (f);
+        }
+    }
+  pagedir_batch_end ();
+  return result;
+}
+
+/* Samples the accessed bit of every private frame, and, if FLUSH,
+   writes back up to SWAP_BATCH dirty pages of memory-mapped files
+   that are out of their owners' working sets, leaving them mapped
+   but clean for evict() to take without waiting on the file.
+   frame_lock must be held. */
+static void
+age_frames (bool flush)
+{
+  struct list_elem *e;
+  size_t clean = 0;
+
+  pagedir_batch_begin ();
+  for (e = list_begin (&frames); e != list_end (&frames); e = list_next (e))
+    {
+      struct frame *f = list_entry (e, struct frame, elem);
+      struct page *p;
+      uint32_t *pd;
+
+      if (f->pin_cnt > 0 || frame_is_shared (f) || list_empty (&f->pages))
+        continue;
+      if (frame_accessed (f) || !flush || clean >= SWAP_BATCH)
+        continue;
+      p = frame_page (f);
+      pd = p->owner->pagedir;
+      if (p->writeback && frame_age (f) > WS_TAU
+          && pagedir_is_dirty (pd, p->upage))
+        {
+          /* A write during the write back sets the dirty bit
+             again, so it is not lost. */
+          pagedir_set_dirty (pd, p->upage, false);
+          file_write_at (p->file, f->kpage, p->read_bytes, p->file_ofs);
+          clean++;
+        }
+    }
+  pagedir_batch_end ();
+  clean_cnt += clean;
+}
+
+/* Ages the frame table every AGE_TICKS and, when free memory runs
+   low, writes back and evicts a batch of frames itself, so that
+   processes faulting do not have to. */
+static void
+aging_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      struct memstat ms;
+      bool low;
+
+      timer_sleep (AGE_TICKS);
+      palloc_get_stats (&ms);
+      low = ms.user_pages - ms.user_used < FREE_LOW;
+
+      lock_acquire (&frame_lock);
+      if (low && !list_empty (&huge_pages))
+        split_huge (list_entry (list_front (&huge_pages),
+                                struct huge_page, elem));
+      age_frames (low);
+      if (low && !list_empty (&frames))
+        {
+          size_t frame_cnt = list_size (&frames);
+          struct frame *f = evict (NULL);
+          if (f != NULL)
+            {
+              palloc_free_page (f->kpage);
+              free (f);
+            }
+          reclaim_cnt += frame_cnt - list_size (&frames);
+        }
+      lock_release (&frame_lock);
+    }
+}
+
+/* Returns a new frame, pinned, on the frame table but holding no
+   page, for a page of OWNER.  Takes a free page from the user
+   pool if there is one and OWNER is under its RLIMIT_FRAMES, and
+   otherwise, if MAY_EVICT, evicts another frame: one of OWNER's
+   own if it is at its limit, so that it pages against itself
+   rather than everyone else.  Returns a null pointer if no frame
+   can be found.  frame_lock must be held. */
+static struct frame *
+new_frame (struct process *owner, bool may_evict)
+{
+  bool under_limit = owner->frame_cnt < owner->limits[RLIMIT_FRAMES];
+  struct frame *f = NULL;
+  void *kpage = NULL;
+
+  if (under_limit)
+    kpage = palloc_get_page (PAL_USER | PAL_MOVABLE);
+  if (kpage != NULL)
+    {
+      f = malloc (sizeof *f);
+      if (f == NULL)
+        {
+          palloc_free_page (kpage);
+          return NULL;
+        }
+      f->kpage = kpage;
+    }
+  else if (may_evict)
+    {
+      /* The pages of a huge page can be evicted once it is
+         split. */
+      if (under_limit && !list_empty (&huge_pages))
+        split_huge (list_entry (list_front (&huge_pages),
+                                struct huge_page, elem));
+      f = evict (under_limit ? NULL : owner);
+    }
+  if (f == NULL)
+    return NULL;
+
+  list_init (&f->pages);
+  f->pin_cnt = 1;
+  f->inode = NULL;
+  list_push_back (&frames, &f->elem);
+  return f;
+}
+
+/* Returns a frame, pinned, for the current thread to load PAGE
+   into, evicting another frame if the user pool is exhausted and
+   MAY_EVICT is true.  Returns a null pointer if no frame can be
+   found. */
+struct frame *
+frame_alloc (struct page *page, bool may_evict)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = new_frame (page->owner, may_evict);
+  if (f != NULL)
+    frame_attach (f, page);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Returns a frame, pinned, holding PAGE's READ_BYTES bytes of
+   its file followed by zeros, with PAGE in it.  The frame comes
+   from the page cache if it has a current copy of the page, and
+   otherwise is read now and cached, so the caller must map it
+   read-only.  Evicts another frame for it only if MAY_EVICT.
+   Returns a null pointer if PAGE's file has no inode to cache it
+   by, if no frame can be had, or if the read fails. */
+struct frame *
+frame_get_file (struct page *page, bool may_evict)
+{
+  struct inode *inode = file_get_inode (page->file);
+  struct frame key, *f;
+  unsigned write_cnt;
+
+  if (inode == NULL)
+    return NULL;
+  key.inode = inode;
+  key.ofs = page->file_ofs;
+  key.read_bytes = page->read_bytes;
+
+  lock_acquire (&frame_lock);
+  f = cache_lookup (&key);
+  if (f != NULL)
+    f->pin_cnt++;
+  else
+    f = new_frame (page->owner, may_evict);
+  if (f != NULL)
+    frame_attach (f, page);
+  lock_release (&frame_lock);
+  if (f == NULL || f->inode != NULL)
+    return f;
+
+  /* The count is taken before reading, so that a write during the
+     read makes the copy stale. */
+  write_cnt = inode_write_cnt (inode);
+  if (file_read_at (page->file, f->kpage, page->read_bytes, page->file_ofs)
+      != (off_t) page->read_bytes)
+    {
+      frame_free (f, page);
+      return NULL;
+    }
+  memset ((uint8_t *) f->kpage + page->read_bytes, 0,
+          PGSIZE - page->read_bytes);
+
+  /* Another process may have cached the same page meanwhile, in
+     which case this copy stays private to PAGE. */
+  lock_acquire (&frame_lock);
+  if (cache_lookup (&key) == NULL)
+    {
+      f->inode = inode_reopen (inode);
+      f->ofs = key.ofs;
+      f->read_bytes = key.read_bytes;
+      f->write_cnt = write_cnt;
+      hash_insert (&file_pages, &f->cache_elem);
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Pins and returns the frame that holds PAGE, or returns a null
+   pointer if PAGE is not in memory. */
+struct frame *
+frame_pin (struct page *page)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = page->frame;
+  if (f != NULL)
+    f->pin_cnt++;
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Drops a pin on F, making it, once no one else has it pinned, a
+   candidate for eviction. */
+void
+frame_unpin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  frame_put (f);
+  lock_release (&frame_lock);
+}
+
+/* Takes PAGE, which must no longer be mapped, out of F, which
+   the caller has pinned, and frees F and its page unless another
+   process still has its own page in it. */
+void
+frame_free (struct frame *f, struct page *page)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (page->frame == f);
+  list_remove (&page->frame_elem);
+  page->frame = NULL;
+  page->owner->frame_cnt--;
+  frame_put (f);
+  lock_release (&frame_lock);
+}
+
+/* Puts PAGE, a page of a process being forked, into the frame
+   that holds PARENT, its parent's copy of it, if there is one,
+   and returns that frame.  Returns a null pointer if PARENT is
+   not in memory.  Both processes must map the frame read-only
+   from now on, until frame_unshare() says otherwise. */
+struct frame *
+frame_share (struct page *parent, struct page *page)
+{
+  struct frame *f;
+
+  lock_acquire (&frame_lock);
+  f = parent->frame;
+  if (f != NULL)
+    frame_attach (f, page);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Called before the current thread writes to PAGE, which is held
+   in F, pinned by the caller, and mapped read-only.  Returns true
+   if PAGE is the only page in F and no one else has F pinned, in
+   which case the page may be written in place, and F leaves the
+   page cache if it was in it.  Otherwise takes PAGE out of F and
+   returns false, leaving F pinned for the caller to copy from and
+   then unpin. */
+bool
+frame_unshare (struct frame *f, struct page *page)
+{
+  bool alone;
+
+  lock_acquire (&frame_lock);
+  ASSERT (page->frame == f);
+  alone = !frame_is_shared (f) && f->pin_cnt == 1;
+  if (alone && f->inode != NULL)
+    uncache (f);
+  if (!alone)
+    {
+      list_remove (&page->frame_elem);
+      page->frame = NULL;
+      page->owner->frame_cnt--;
+    }
+  lock_release (&frame_lock);
+  return alone;
+}
+
+/* Takes every page of process T out of the frame table, without
+   freeing the user pages themselves, which T's page directory maps
+   and pagedir_destroy() frees.  A frame that another process
+   still uses, or is copying from, or that the page cache keeps,
+   is unmapped from T instead, so that it survives.  Must be
+   called before the page directory goes away. */
+void
+frame_release_owner (struct process *t)
+{
+  struct list_elem *e;
+
+  lock_acquire (&frame_lock);
+  pagedir_batch_begin ();
+  for (e = list_begin (&frames); e != list_end (&frames); )
+    {
+      struct frame *f = list_entry (e, struct frame, elem);
+      struct list_elem *pe;
+
+      e = list_next (e);
+      for (pe = list_begin (&f->pages); pe != list_end (&f->pages);
+           pe = list_next (pe))
+        {
+          struct page *p = list_entry (pe, struct page, frame_elem);
+
+          if (p->owner != t)
+            continue;
+          list_remove (&p->frame_elem);
+          p->frame = NULL;
+          t->frame_cnt--;
+          if (list_empty (&f->pages) && f->pin_cnt == 0
+              && f->inode == NULL)
+            {
+              frame_remove (f);
+              free (f);
+            }
+          else
+            pagedir_clear_page (t->pagedir, p->upage);
+          break;
+        }
+    }
+  pagedir_batch_end ();
+
+  /* The huge pages' memory goes with the page directory too. */
+  for (e = list_begin (&huge_pages); e != list_end (&huge_pages); )
+    {
+      struct huge_page *h = list_entry (e, struct huge_page, elem);
+
+      e = list_next (e);
+      if (h->owner != t)
+        continue;
+      list_remove (&h->elem);
+      t->frame_cnt -= FRAME_HUGE_PAGES;
+      free_huge (h);
+    }
+  ASSERT (t->frame_cnt == 0);
+  lock_release (&frame_lock);
+}
+
+/* Moves the frame that holds the movable page at KPAGE to
+   another page and frees KPAGE, for palloc_get_contiguous().
+   Every process that maps the frame is pointed at the copy.
+   Interrupts are off from the copy until the mappings move, so
+   that no one writes to the frame between.  Returns false if
+   KPAGE is not the page of an unpinned frame whose pages are all
+   mapped, or if no other page can be had. */
+bool
+frame_migrate (void *kpage)
+{
+  struct list_elem *e;
+  struct frame *f = NULL;
+  bool success = false;
+
+  lock_acquire (&frame_lock);
+  for (e = list_begin (&frames); e != list_end (&frames); e = list_next (e))
+    if (list_entry (e, struct frame, elem)->kpage == kpage)
+      {
+        f = list_entry (e, struct frame, elem);
+        break;
+      }
+
+  /* A page not yet mapped, as in page_fork() between
+     frame_share() and its mapping, would be mapped to KPAGE. */
+  if (f != NULL && f->pin_cnt == 0)
+    {
+      for (e = list_begin (&f->pages); e != list_end (&f->pages);
+           e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          if (pagedir_get_page (p->owner->pagedir, p->upage) != kpage)
+            break;
+        }
+      if (e == list_end (&f->pages))
+        {
+          void *copy = palloc_get_page (PAL_USER | PAL_MOVABLE);
+
+          if (copy != NULL)
+            {
+              enum intr_level old_level = intr_disable ();
+
+              memcpy (copy, kpage, PGSIZE);
+              for (e = list_begin (&f->pages); e != list_end (&f->pages);
+                   e = list_next (e))
+                {
+                  struct page *p = list_entry (e, struct page, frame_elem);
+                  pagedir_move_page (p->owner->pagedir, p->upage, copy);
+                }
+              f->kpage = copy;
+              intr_set_level (old_level);
+              palloc_free_page (kpage);
+              success = true;
+            }
+        }
+    }
+  lock_release (&frame_lock);
+  return success;
+}
+
+/* Frees huge page H's bookkeeping: its frame structures, its
+   page table to be, and H itself, but not its memory. */
+static void
+free_huge (struct huge_page *h)
+{
+  while (!list_empty (&h->frames))
+    free (list_entry (list_pop_front (&h->frames), struct frame, elem));
+  palloc_free_page (h->pages);
+  free (h);
+}
+
+/* Maps the FRAME_HUGE_PAGES pages in PAGES, consecutive pages of
+   zeros at an aligned address that their owner has mapped nothing
+   near yet, with a single zeroed 4 MB page, and hands PAGES, a
+   page from the kernel pool, over to it.  Returns false, leaving
+   PAGES to the caller, if the owner would go over its
+   RLIMIT_FRAMES or no aligned run of free pages, or memory for
+   the bookkeeping, can be had. */
+bool
+frame_alloc_huge (struct page **pages)
+{
+  struct process *owner = pages[0]->owner;
+  struct huge_page *h;
+  size_t i;
+
+  if (owner->frame_cnt + FRAME_HUGE_PAGES > owner->limits[RLIMIT_FRAMES])
+    return false;
+  h = malloc (sizeof *h);
+  if (h == NULL)
+    return false;
+  h->owner = owner;
+  h->upage = pages[0]->upage;
+  h->pages = pages;
+  list_init (&h->frames);
+  for (i = 0; i < FRAME_HUGE_PAGES; i++)
+    {
+      struct frame *f = malloc (sizeof *f);
+      if (f == NULL)
+        break;
+      list_push_back (&h->frames, &f->elem);
+    }
+  h->kpage = (i == FRAME_HUGE_PAGES
+              ? palloc_get_aligned (PAL_USER | PAL_ZERO, FRAME_HUGE_PAGES)
+              : NULL);
+  if (h->kpage == NULL)
+    {
+      while (!list_empty (&h->frames))
+        free (list_entry (list_pop_front (&h->frames), struct frame, elem));
+      free (h);
+      return false;
+    }
+
+  lock_acquire (&frame_lock);
+  pagedir_set_huge_page (owner->pagedir, h->upage, h->kpage);
+  list_push_back (&huge_pages, &h->elem);
+  owner->frame_cnt += FRAME_HUGE_PAGES;
+  huge_cnt++;
+  lock_release (&frame_lock);
+  return true;
+}
+
+/* Splits huge page H into FRAME_HUGE_PAGES ordinary frames on
+   the frame table, mapped by the page table H brought along, and
+   frees H.  frame_lock must be held. */
+static void
+split_huge (struct huge_page *h)
+{
+  size_t i;
+
+  list_remove (&h->elem);
+  h->owner->frame_cnt -= FRAME_HUGE_PAGES;
+  for (i = 0; i < FRAME_HUGE_PAGES; i++)
+    {
+      struct frame *f = list_entry (list_pop_front (&h->frames),
+                                    struct frame, elem);
+
+      f->kpage = h->kpage + i * PGSIZE;
+      list_init (&f->pages);
+      f->pin_cnt = 0;
+      f->inode = NULL;
+      list_push_back (&frames, &f->elem);
+      frame_attach (f, h->pages[i]);
+    }
+  pagedir_split_huge_page (h->owner->pagedir, h->upage,
+                           (uint32_t *) h->pages);
+  split_cnt++;
+  free (h);
+}
+
+/* Splits process T's huge page that holds the page at UPAGE, if
+   it has one, so that the page can be handled by itself. */
+void
+frame_split_huge (struct process *t, const void *upage)
+{
+  uint8_t *base = (uint8_t *) ((uintptr_t) upage & ~(PTSPAN - 1));
+  struct list_elem *e;
+
+  lock_acquire (&frame_lock);
+  for (e = list_begin (&huge_pages); e != list_end (&huge_pages);
+       e = list_next (e))
+    {
+      struct huge_page *h = list_entry (e, struct huge_page, elem);
+      if (h->owner == t && h->upage == base)
+        {
+          split_huge (h);
+          break;
+        }
+    }
+  lock_release (&frame_lock);
+}
+
+/* Splits every huge page of process T. */
+void
+frame_split_all (struct process *t)
+{
+  struct list_elem *e;
+
+  lock_acquire (&frame_lock);
+  for (e = list_begin (&huge_pages); e != list_end (&huge_pages); )
+    {
+      struct huge_page *h = list_entry (e, struct huge_page, elem);
+
+      e = list_next (e);
+      if (h->owner == t)
+        split_huge (h);
+    }
+  lock_release (&frame_lock);
+}
@@ -0,0 +1,56 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include "filesys/off_t.h"
+#include "threads/pte.h"
+#include "vm/page.h"
+
+struct inode;
+struct process;
+
+/* A user frame: a page from the user pool holding a page of some
+   process.  After a fork, the same frame holds the page for the
+   parent and the child alike, mapped read-only in both, until
+   one of them writes to it and gets a copy of its own.
+
+   A frame in the page cache holds a page of a file instead, for
+   every process that maps that page, read-only, and stays cached
+   after the last of them unmaps it, until it is evicted. */
+struct frame
+  {
+    struct list_elem elem;              /* Element in frame table. */
+    void *kpage;                        /* Kernel virtual address. */
+    struct list pages;                  /* Pages it holds, by their
+                                           frame_elem. */
+    unsigned pin_cnt;                   /* Not to be evicted if
+                                           nonzero. */
+
+    /* Page cache, if INODE is nonnull. */
+    struct hash_elem cache_elem;        /* Element in the page cache. */
+    struct inode *inode;                /* File the page is from. */
+    off_t ofs;                          /* Offset of page in INODE. */
+    size_t read_bytes;                  /* Bytes of INODE; rest zero. */
+    unsigned write_cnt;                 /* INODE's write count then. */
+  };
+
+/* Pages in a 4 MB page. */
+#define FRAME_HUGE_PAGES (PTSPAN / PGSIZE)
+
+void frame_init (void);
+struct frame *frame_alloc (struct page *, bool may_evict);
+struct frame *frame_get_file (struct page *, bool may_evict);
+struct frame *frame_pin (struct page *);
+void frame_unpin (struct frame *);
+void frame_free (struct frame *, struct page *);
+struct frame *frame_share (struct page *parent, struct page *);
+bool frame_unshare (struct frame *, struct page *);
+void frame_release_owner (struct process *);
+bool frame_migrate (void *kpage);
+bool frame_alloc_huge (struct page **pages);
+void frame_split_huge (struct process *, const void *upage);
+void frame_split_all (struct process *);
+
+#endif /* vm/frame.h */
@@ -0,0 +1,138 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+
+static int map (struct process *, struct file *, void *addr);
+
+/* Maps FILE into the current process's address space at ADDR.
+   The pages are only recorded in the supplemental page table
+   here; page faults read them in, and dirty ones are written
+   back when evicted or unmapped.  The mapping has its own
+   reopened file, so it outlives closing FILE.  Returns the new
+   mapping's identifier, or -1 if FILE is empty, ADDR is null or
+   not page-aligned, any page of the range is already in use, or
+   memory allocation fails. */
+int
+mmap_map (struct file *file, void *addr)
+{
+  struct process *t = thread_current ()->process;
+  int id;
+
+  lock_acquire (&t->lock);
+  id = map (t, file, addr);
+  lock_release (&t->lock);
+  return id;
+}
+
+/* Does mmap_map()'s work for process T, whose lock is held. */
+static int
+map (struct process *t, struct file *file, void *addr)
+{
+  struct mapping *m;
+  off_t length = file_length (file);
+  size_t i;
+
+  if (length == 0 || addr == NULL || pg_ofs (addr) != 0)
+    return -1;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return -1;
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      uint8_t *upage = (uint8_t *) addr + i * PGSIZE;
+      if (!is_user_vaddr (upage) || !page_is_free (upage))
+        {
+          free (m);
+          return -1;
+        }
+    }
+
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    {
+      free (m);
+      return -1;
+    }
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_mapping ((uint8_t *) addr + ofs, m->file, ofs,
+                             read_bytes))
+        {
+          while (i-- > 0)
+            page_remove ((uint8_t *) addr + i * PGSIZE);
+          file_close (m->file);
+          free (m);
+          return -1;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+}
+
+/* Unmaps mapping M of the current process, writing back its
+   dirty pages.  The process's lock must be held, unless it is
+   exiting with no other threads. */
+static void
+unmap (struct mapping *m)
+{
+  size_t i;
+
+  pagedir_batch_begin ();
+  for (i = 0; i < m->page_cnt; i++)
+    page_remove ((uint8_t *) m->base + i * PGSIZE);
+  pagedir_batch_end ();
+  list_remove (&m->elem);
+  file_close (m->file);
+  free (m);
+}
+
+/* Unmaps the current process's mapping ID, writing back its
+   dirty pages.  Returns false if there is no such mapping. */
+bool
+mmap_unmap (int id)
+{
+  struct process *t = thread_current ()->process;
+  struct list_elem *e;
+  bool found = false;
+
+  lock_acquire (&t->lock);
+  for (e = list_begin (&t->mappings); e != list_end (&t->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        {
+          unmap (m);
+          found = true;
+          break;
+        }
+    }
+  lock_release (&t->lock);
+  return found;
+}
+
+/* Unmaps all of the current process's mappings, as when it
+   exits, by which time its other threads have too. */
+void
+mmap_unmap_all (void)
+{
+  struct process *t = thread_current ()->process;
+
+  while (!list_empty (&t->mappings))
+    unmap (list_entry (list_front (&t->mappings), struct mapping, elem));
+}
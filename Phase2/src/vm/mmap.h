@@ -0,0 +1,24 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct file;
+
+/* A memory-mapped file. */
+struct mapping
+  {
+    struct list_elem elem;              /* Element in process's mappings. */
+    int id;                             /* Mapping identifier. */
+    struct file *file;                  /* Reopened file. */
+    void *base;                         /* First page mapped. */
+    size_t page_cnt;                    /* Number of pages mapped. */
+  };
+
+int mmap_map (struct file *, void *addr);
+bool mmap_unmap (int id);
+void mmap_unmap_all (void);
+
+#endif /* vm/mmap.h */
@@ -0,0 +1,869 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "userprog/share.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Most bytes the user stack may grow to.  Set with -stack. */
+size_t page_stack_limit = 8 * 1024 * 1024;
+
+/* Executable segments of at most this many pages are brought in
+   whole at exec rather than a page per fault.  Set with -populate;
+   0 turns it off. */
+size_t page_populate_max = 16;
+
+/* Bring in aligned 4 MB regions of zeros, such as a large heap or
+   BSS, as 4 MB pages where the CPU has them?  Cleared with
+   -nohuge. */
+bool page_huge = true;
+
+/* A fault on a read-only page of a larger segment also maps the
+   pages that share the block of this many pages around it. */
+#define FAULT_AROUND_PAGES 8
+
+/* How far below the stack pointer an access may be and still be
+   taken to grow the stack: PUSHA writes 32 bytes below it before
+   moving it. */
+#define STACK_SLOP 32
+
+/* Cache of struct page, made and freed once per user page. */
+static struct kmem_cache *page_cache;
+
+/* A frame of zeros, shared read-only by every page of zeros that
+   has only been read so far, such as BSS and heap pages that are
+   never written.  A write fault gives the page a frame of its
+   own.  It is a frame from share_alloc(), so each mapping holds
+   a reference and pagedir_destroy() and page_fork() treat it
+   like any other shared page, and it is never on the frame
+   table, so it is never evicted. */
+static void *zero_kpage;
+
+static void *move_brk (struct process *, intptr_t increment);
+static bool unshare_page (const void *addr);
+static bool load_page (const void *addr, bool write);
+
+/* Returns a hash value for page E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_bytes (&p->upage, sizeof p->upage);
+}
+
+/* Returns true if page A's address precedes page B's. */
+static bool
+page_less (const struct hash_elem *a, const struct hash_elem *b,
+           void *aux UNUSED)
+{
+  return (hash_entry (a, struct page, hash_elem)->upage
+          < hash_entry (b, struct page, hash_elem)->upage);
+}
+
+/* Frees the page that hash element E is in and its swap slot,
+   if any. */
+static void
+page_free (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, hash_elem);
+
+  if (p->swap_sector != SWAP_NONE)
+    swap_free (p->swap_sector);
+  kmem_cache_free (page_cache, p);
+}
+
+/* Returns the current process. */
+static struct process *
+current_process (void)
+{
+  return thread_current ()->process;
+}
+
+/* Returns the current process's page for the user page containing
+   ADDR, or a null pointer if it has none. */
+static struct page *
+page_lookup (const void *addr)
+{
+  struct page key;
+  struct hash_elem *e;
+
+  key.upage = pg_round_down (addr);
+  e = hash_find (&current_process ()->pages, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Initializes the supplemental page table module. */
+void
+page_init (void)
+{
+  page_cache = kmem_cache_create ("page", sizeof (struct page));
+  zero_kpage = share_alloc ();
+  if (zero_kpage == NULL)
+    PANIC ("page_init: out of memory");
+}
+
+/* Returns true if process T has its page P mapped to the shared
+   frame of zeros. */
+static bool
+maps_zero (struct process *t, const struct page *p)
+{
+  return pagedir_get_page (t->pagedir, p->upage) == zero_kpage;
+}
+
+/* Unmaps process T's page P from the shared frame of zeros. */
+static void
+unmap_zero (struct process *t, struct page *p)
+{
+  pagedir_clear_page (t->pagedir, p->upage);
+  share_release (zero_kpage);
+}
+
+/* Initializes the current process's supplemental page table.
+   Returns false if memory allocation fails. */
+bool
+page_table_init (void)
+{
+  struct hash *pages = &current_process ()->pages;
+
+  if (!hash_init (pages, page_hash, page_less, NULL))
+    return false;
+
+  /* Page faults insert into this table, so spread its resizes
+     out rather than moving every page at once. */
+  hash_set_incremental (pages, true);
+  return true;
+}
+
+/* Frees the current process's supplemental page table.  Must be
+   called after frame_release_owner(), so that no page is being
+   evicted.  The frames its pages were loaded into belong to the
+   page directory, which frees them. */
+void
+page_table_destroy (void)
+{
+  hash_destroy (&current_process ()->pages, page_free);
+}
+
+/* Adds a page at UPAGE to the current process's supplemental
+   page table, as described for page_add_file(), that is written
+   back to FILE if WRITEBACK is true. */
+static bool
+page_add (void *upage, struct file *file, off_t ofs,
+          size_t read_bytes, bool writable, bool writeback)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = kmem_cache_alloc (page_cache);
+  if (p == NULL)
+    return false;
+  p->owner = current_process ();
+  p->upage = upage;
+  p->writable = writable;
+  p->file = read_bytes > 0 ? file : NULL;
+  p->file_ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->swap_sector = SWAP_NONE;
+  p->writeback = writeback;
+  p->fault_around = false;
+  p->frame = NULL;
+  if (hash_insert (&current_process ()->pages, &p->hash_elem) != NULL)
+    {
+      kmem_cache_free (page_cache, p);
+      return false;
+    }
+  return true;
+}
+
+/* Records that user page UPAGE is to be loaded, when first
+   touched, with READ_BYTES bytes of FILE starting at OFS followed
+   by zeros.  The page is writable by the process if WRITABLE is
+   true.  Returns false if UPAGE already has a page or memory
+   allocation fails.
+
+   This and the other functions here that change the table without
+   saying otherwise must be called with the process's lock held,
+   unless it has only the one thread, as while it loads. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  return page_add (upage, file, ofs, read_bytes, writable, false);
+}
+
+/* Like page_add_file(), but for a writable page of a
+   memory-mapped file: changes to its first READ_BYTES bytes are
+   written back to FILE when it is evicted or removed. */
+bool
+page_add_mapping (void *upage, struct file *file, off_t ofs,
+                  size_t read_bytes)
+{
+  return page_add (upage, file, ofs, read_bytes, true, true);
+}
+
+/* Returns true if the current process has no page at UPAGE, in
+   either its supplemental page table or its page directory. */
+bool
+page_is_free (const void *upage)
+{
+  return (page_lookup (upage) == NULL
+          && pagedir_get_page (current_process ()->pagedir, upage) == NULL);
+}
+
+/* Removes the current process's page at UPAGE from its address
+   space, writing it back first if it is a dirty page of a
+   memory-mapped file. */
+void
+page_remove (void *upage)
+{
+  struct process *t = current_process ();
+  struct page *p = page_lookup (upage);
+  struct frame *f;
+
+  ASSERT (p != NULL);
+
+  frame_split_huge (t, upage);
+  f = frame_pin (p);
+  if (f != NULL)
+    {
+      if (p->writeback && pagedir_is_dirty (t->pagedir, p->upage))
+        file_write_at (p->file, f->kpage, p->read_bytes, p->file_ofs);
+      pagedir_clear_page (t->pagedir, p->upage);
+      frame_free (f, p);
+    }
+  else if (maps_zero (t, p))
+    unmap_zero (t, p);
+  hash_delete (&t->pages, &p->hash_elem);
+  page_free (&p->hash_elem, NULL);
+}
+
+/* Gives the current process, just forked by thread PARENT, a
+   copy of PARENT's pages other than those of its memory-mapped
+   files, which are not inherited.  A page in a frame is shared
+   copy-on-write: the frame is mapped read-only in both processes
+   until one of them writes to it and page_unshare() copies it.  A
+   swapped-out page gets a swap slot of its own, a shared
+   read-only page one more reference, and a page not loaded yet is
+   loaded from the same file when first touched.  PARENT must be
+   blocked until this returns, and the lock on its process keeps
+   its other threads from changing its pages meanwhile.  PARENT's
+   huge pages are split first, so that their pages can be shared
+   one by one.  Returns false if memory or swap runs out. */
+bool
+page_fork (struct thread *parent_thread)
+{
+  struct process *t = current_process ();
+  struct process *parent = parent_thread->process;
+  struct hash_iterator i;
+  bool success = false;
+
+  lock_acquire (&parent->lock);
+  frame_split_all (parent);
+  hash_first (&i, &parent->pages);
+  while (hash_next (&i))
+    {
+      struct page *pp = hash_entry (hash_cur (&i), struct page, hash_elem);
+      struct page *p;
+      struct frame *f;
+      void *kpage;
+
+      if (pp->writeback)
+        continue;
+      p = kmem_cache_alloc (page_cache);
+      if (p == NULL)
+        goto done;
+      *p = *pp;
+      p->owner = t;
+      p->swap_sector = SWAP_NONE;
+      p->frame = NULL;
+      hash_insert (&t->pages, &p->hash_elem);
+
+      /* A copy-on-write page keeps its dirty bit in both
+         processes, or whichever one ends up with the frame alone
+         could have it evicted without being written to swap. */
+      f = frame_share (pp, p);
+      if (f != NULL)
+        {
+          if (!pagedir_set_page (t->pagedir, p->upage, f->kpage, false))
+            goto done;
+          pagedir_set_dirty (t->pagedir, p->upage,
+                             pagedir_is_dirty (parent->pagedir, pp->upage));
+          pagedir_set_writable (parent->pagedir, pp->upage, false);
+        }
+      else if (pp->swap_sector != SWAP_NONE)
+        {
+          p->swap_sector = swap_copy (pp->swap_sector);
+          if (p->swap_sector == SWAP_NONE)
+            goto done;
+        }
+      else if ((kpage = pagedir_get_page (parent->pagedir, pp->upage))
+               != NULL)
+        {
+          /* Mapped but off the frame table: a shared page. */
+          if (!pagedir_set_shared_page (t->pagedir, p->upage, kpage, false))
+            goto done;
+          share_reference (kpage);
+        }
+    }
+  success = true;
+
+ done:
+  lock_release (&parent->lock);
+  return success;
+}
+
+/* Brings in page P of process T, a page of zeros, together with
+   every other page of the aligned 4 MB region around it, as one
+   4 MB page, if they are all writable pages of zeros that T has
+   never mapped.  Returns false, having done nothing, if they are
+   not or there is no memory for it, in which case P must come in
+   as a page of its own; it will then be the first page table
+   entry in the region, so the region is looked at only once. */
+static bool
+bring_in_huge (struct process *t, struct page *p)
+{
+  uint8_t *base = (uint8_t *) ((uintptr_t) p->upage & ~(PTSPAN - 1));
+  struct page **pages;
+  size_t i;
+
+  if (!page_huge || !init_large_pages
+      || !pagedir_region_is_empty (t->pagedir, base))
+    return false;
+  pages = palloc_get_page (0);
+  if (pages == NULL)
+    return false;
+  for (i = 0; i < FRAME_HUGE_PAGES; i++)
+    {
+      struct page *q = page_lookup (base + i * PGSIZE);
+      if (q == NULL || q->file != NULL || !q->writable
+          || q->swap_sector != SWAP_NONE)
+        break;
+      pages[i] = q;
+    }
+  if (i < FRAME_HUGE_PAGES || !frame_alloc_huge (pages))
+    {
+      palloc_free_page (pages);
+      return false;
+    }
+  return true;
+}
+
+/* Returns T's page at UPAGE if it is out in swap, neither mapped
+   nor on its way out, or a null pointer otherwise. */
+static struct page *
+swapped_page (struct process *t, const void *upage)
+{
+  struct page *q = page_lookup (upage);
+
+  if (q == NULL || q->swap_sector == SWAP_NONE || q->frame != NULL
+      || pagedir_get_page (t->pagedir, upage) != NULL)
+    return NULL;
+  return q;
+}
+
+/* Reads page P of process T from swap into KPAGE.  The pages
+   around it in the aligned block of SWAP_BATCH pages that went
+   out with it, into the slots just before and after its own on
+   the swap device, are read in the same request and mapped too,
+   since eviction writes neighbours out together and they tend to
+   be wanted together.  They are only worth free memory, not an
+   eviction, so the run stops at the first that cannot have a
+   frame.  Like P, each neighbour's slot is freed once it is
+   mapped, and it is mapped dirty. */
+static void
+swap_around (struct process *t, struct page *p, void *kpage)
+{
+  uintptr_t block = SWAP_BATCH * PGSIZE;
+  uint8_t *base = (uint8_t *) ((uintptr_t) p->upage & ~(block - 1));
+  size_t idx = ((uint8_t *) p->upage - base) / PGSIZE;
+  struct page *run[SWAP_BATCH];
+  struct frame *frames[SWAP_BATCH];
+  void *kpages[SWAP_BATCH];
+  size_t first, last, i;
+
+  run[idx] = p;
+  frames[idx] = NULL;
+  for (first = idx; first > 0; first--)
+    {
+      struct page *q = swapped_page (t, base + (first - 1) * PGSIZE);
+      if (q == NULL || !swap_follows (q->swap_sector, run[first]->swap_sector)
+          || (frames[first - 1] = frame_alloc (q, false)) == NULL)
+        break;
+      run[first - 1] = q;
+    }
+  for (last = idx; last + 1 < SWAP_BATCH; last++)
+    {
+      struct page *q = swapped_page (t, base + (last + 1) * PGSIZE);
+      if (q == NULL || !swap_follows (run[last]->swap_sector, q->swap_sector)
+          || (frames[last + 1] = frame_alloc (q, false)) == NULL)
+        break;
+      run[last + 1] = q;
+    }
+  if (first == last)
+    {
+      swap_in (p->swap_sector, kpage);
+      return;
+    }
+
+  for (i = first; i <= last; i++)
+    kpages[i - first] = i == idx ? kpage : frames[i]->kpage;
+  swap_in_run (run[first]->swap_sector, kpages, last - first + 1);
+
+  for (i = first; i <= last; i++)
+    {
+      struct page *q = run[i];
+
+      if (q == p)
+        continue;
+      if (!pagedir_set_page (t->pagedir, q->upage, frames[i]->kpage,
+                             q->writable))
+        {
+          /* Still in swap, so it can fault in later. */
+          frame_free (frames[i], q);
+          continue;
+        }
+      pagedir_set_dirty (t->pagedir, q->upage, true);
+      swap_free (q->swap_sector);
+      q->swap_sector = SWAP_NONE;
+      frame_unpin (frames[i]);
+    }
+}
+
+/* Brings in page P of process T, which is not mapped, for
+   writing if WRITE is true or only for reading otherwise. */
+static bool
+bring_in (struct process *t, struct page *p, bool write)
+{
+  struct frame *f;
+  uint8_t *kpage;
+  bool dirty = false;
+
+  /* A file page comes from the page cache, shared with every
+     process that maps it, and is mapped read-only even if it is
+     writable: a write faults, and page_unshare() then gives the
+     process a copy of its own or takes the frame out of the
+     cache.  A file with no inode to cache by gets a private
+     copy. */
+  if (p->file != NULL && p->swap_sector == SWAP_NONE)
+    {
+      f = frame_get_file (p, true);
+      if (f != NULL)
+        {
+          if (!pagedir_set_page (t->pagedir, p->upage, f->kpage, false))
+            {
+              frame_free (f, p);
+              return false;
+            }
+          frame_unpin (f);
+          return true;
+        }
+    }
+
+  if (p->file == NULL && p->swap_sector == SWAP_NONE
+      && bring_in_huge (t, p))
+    return true;
+
+  /* A page of zeros that is only being read maps the shared frame
+     of zeros, read-only, until it is written. */
+  if (!write && p->file == NULL && p->swap_sector == SWAP_NONE)
+    {
+      if (!pagedir_set_shared_page (t->pagedir, p->upage, zero_kpage,
+                                    false))
+        return false;
+      share_reference (zero_kpage);
+      return true;
+    }
+
+  /* The page is not mapped, so it is not on the frame table and
+     cannot be evicted under us.  frame_alloc() also waits out any
+     eviction that was writing it to swap. */
+  f = frame_alloc (p, true);
+  if (f == NULL)
+    return false;
+  kpage = f->kpage;
+
+  if (p->swap_sector != SWAP_NONE)
+    {
+      /* The swap slot is freed once the page is mapped, and then
+         the page must go out again even if it is not written
+         to. */
+      swap_around (t, p, kpage);
+      dirty = true;
+    }
+  else
+    {
+      if (p->file != NULL
+          && file_read_at (p->file, kpage, p->read_bytes, p->file_ofs)
+             != (off_t) p->read_bytes)
+        {
+          frame_free (f, p);
+          return false;
+        }
+      memset (kpage + p->read_bytes, 0, PGSIZE - p->read_bytes);
+    }
+
+  if (!pagedir_set_page (t->pagedir, p->upage, kpage, p->writable))
+    {
+      frame_free (f, p);
+      return false;
+    }
+  if (dirty)
+    {
+      pagedir_set_dirty (t->pagedir, p->upage, true);
+      swap_free (p->swap_sector);
+      p->swap_sector = SWAP_NONE;
+    }
+  frame_unpin (f);
+  return true;
+}
+
+/* Maps the read-only file pages marked for fault-around in the
+   block of FAULT_AROUND_PAGES around P, which was just brought
+   in, from the page cache.  They are only worth free memory, not
+   an eviction, so this stops at the first that cannot be had. */
+static void
+fault_around (struct process *t, struct page *p)
+{
+  uintptr_t block = FAULT_AROUND_PAGES * PGSIZE;
+  uint8_t *base = (uint8_t *) ((uintptr_t) p->upage & ~(block - 1));
+  size_t i;
+
+  for (i = 0; i < FAULT_AROUND_PAGES; i++)
+    {
+      uint8_t *upage = base + i * PGSIZE;
+      struct page *q = page_lookup (upage);
+      struct frame *f;
+
+      if (q == NULL || q == p || !q->fault_around
+          || pagedir_get_page (t->pagedir, upage) != NULL)
+        continue;
+      f = frame_get_file (q, false);
+      if (f == NULL)
+        break;
+      if (!pagedir_set_page (t->pagedir, upage, f->kpage, false))
+        {
+          frame_free (f, q);
+          break;
+        }
+      frame_unpin (f);
+    }
+}
+
+/* Does page_in()'s work with the process's lock held. */
+static bool
+load_page (const void *addr, bool write)
+{
+  struct process *t = current_process ();
+  struct page *p;
+
+  if (!is_user_vaddr (addr))
+    return false;
+  p = page_lookup (addr);
+  if (p == NULL)
+    return false;
+  if (pagedir_get_page (t->pagedir, p->upage) != NULL)
+    return true;
+  if (!bring_in (t, p, write))
+    return false;
+  if (p->fault_around)
+    fault_around (t, p);
+  return true;
+}
+
+/* Chooses how the PAGE_CNT pages of an executable segment, just
+   added at UPAGE, come in.  A segment of at most
+   page_populate_max pages is brought in now, in order, so that
+   its reads go out back to back and the buffer cache's read-ahead
+   can run ahead of them, instead of one fault at a time later.
+   In a larger segment, each read-only file page is marked so that
+   a fault on it maps its neighbours too.  A page that cannot be
+   brought in now is left to fault as usual.  Takes the process's
+   lock. */
+void
+page_prefetch (void *upage, size_t page_cnt)
+{
+  struct lock *lock = &current_process ()->lock;
+  uint8_t *base = upage;
+  size_t i;
+
+  ASSERT (pg_ofs (upage) == 0);
+
+  lock_acquire (lock);
+  if (page_cnt <= page_populate_max)
+    {
+      for (i = 0; i < page_cnt; i++)
+        if (!load_page (base + i * PGSIZE, false))
+          break;
+    }
+  else
+    for (i = 0; i < page_cnt; i++)
+      {
+        struct page *p = page_lookup (base + i * PGSIZE);
+        if (p != NULL && !p->writable && p->file != NULL)
+          p->fault_around = true;
+      }
+  lock_release (lock);
+}
+
+/* Brings the current process's user page containing ADDR into
+   memory, if it has a page there, for writing if WRITE is true
+   or only for reading otherwise.  Returns true if the page is
+   now mapped, false if there is no page at ADDR or loading it
+   fails.  Takes the process's lock, so that two of its threads
+   faulting on one page load it once. */
+bool
+page_in (const void *addr, bool write)
+{
+  struct lock *lock = &current_process ()->lock;
+  bool success;
+
+  lock_acquire (lock);
+  success = load_page (addr, write);
+  lock_release (lock);
+  return success;
+}
+
+/* Grows the current thread's stack to cover ADDR, given that the
+   user stack pointer is ESP, if the access looks like a stack
+   access: no more than STACK_SLOP bytes below ESP and within
+   page_stack_limit of the top of user memory.  The new page is
+   zeroed and brought in at once.  Returns true if successful.
+   Only the main thread's stack grows; those of other threads are
+   in the table from the start.  Takes the process's lock. */
+bool
+page_grow_stack (const void *addr, const void *esp)
+{
+  struct lock *lock = &current_process ()->lock;
+  uint8_t *upage = pg_round_down (addr);
+  bool success = false;
+
+  if (!is_user_vaddr (addr)
+      || (const uint8_t *) addr < (const uint8_t *) esp - STACK_SLOP
+      || (uintptr_t) PHYS_BASE - (uintptr_t) upage > page_stack_limit)
+    return false;
+
+  lock_acquire (lock);
+  if (page_add_file (upage, NULL, 0, 0, true))
+    {
+      success = load_page (upage, true);
+      if (!success)
+        page_remove (upage);
+    }
+  lock_release (lock);
+  return success;
+}
+
+/* Moves the current process's program break INCREMENT bytes,
+   adding zeroed pages to its supplemental page table when it
+   grows, which are brought in only when first touched, and
+   removing pages that end up wholly above it when it shrinks.
+   The heap may not shrink below where load() started it, nor
+   grow into the region reserved for the stack or over a page
+   that is already in use, such as a memory-mapped file.  Returns
+   the previous break, or (void *) -1 if the break cannot move,
+   in which case it stays where it was.  Takes the process's
+   lock. */
+void *
+page_sbrk (intptr_t increment)
+{
+  struct process *t = current_process ();
+  void *old;
+
+  lock_acquire (&t->lock);
+  old = move_brk (t, increment);
+  lock_release (&t->lock);
+  return old;
+}
+
+/* Does page_sbrk()'s work for process T, whose lock is held. */
+static void *
+move_brk (struct process *t, intptr_t increment)
+{
+  uintptr_t old_brk = (uintptr_t) t->heap_brk;
+  uintptr_t heap_limit = (uintptr_t) PHYS_BASE - page_stack_limit;
+  uint8_t *old_end = (uint8_t *) ROUND_UP (old_brk, PGSIZE);
+  uint8_t *new_end;
+  uint8_t *upage;
+
+  if (t->heap_start == NULL
+      || (increment < 0
+          ? -(uintptr_t) increment > old_brk - (uintptr_t) t->heap_start
+          : old_brk > heap_limit
+            || (uintptr_t) increment > heap_limit - old_brk))
+    return (void *) -1;
+  new_end = (uint8_t *) ROUND_UP (old_brk + increment, PGSIZE);
+
+  for (upage = old_end; upage < new_end; upage += PGSIZE)
+    if (!page_is_free (upage) || !page_add_file (upage, NULL, 0, 0, true))
+      {
+        while (upage > old_end)
+          page_remove (upage -= PGSIZE);
+        return (void *) -1;
+      }
+  pagedir_batch_begin ();
+  for (upage = new_end; upage < old_end; upage += PGSIZE)
+    page_remove (upage);
+  pagedir_batch_end ();
+
+  t->heap_brk += increment;
+  return (void *) old_brk;
+}
+
+/* Reads the page of FILE at OFS, which must be page-aligned and
+   lie wholly within FILE, into the current process's page at
+   UPAGE, by mapping the page cache's frame for it there, shared
+   read-only, instead of copying it.  A write then faults and
+   page_unshare() gives the process a copy, as for any page of a
+   file.  UPAGE must be a writable page of zeros, or of what the
+   process has written there, and whatever it held is dropped.
+   The mapping is dirty from the start, since FILE may be written
+   while it stands: evicting the page puts it in swap rather than
+   reading it from FILE again.  Returns false, leaving the page
+   alone, if it is not such a page or FILE has no inode to cache
+   by, or, leaving it zeros, if the frame cannot be had.  Takes
+   the process's lock. */
+bool
+page_read_file (void *upage, struct file *file, off_t ofs)
+{
+  struct process *t = current_process ();
+  struct page *p;
+  struct frame *f;
+  void *kpage;
+  bool success = false;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (ofs % PGSIZE == 0);
+
+  if (file_get_inode (file) == NULL)
+    return false;
+  lock_acquire (&t->lock);
+  p = page_lookup (upage);
+  if (p == NULL || !p->writable || p->file != NULL || p->writeback)
+    goto done;
+
+  frame_split_huge (t, upage);
+  f = frame_pin (p);
+  kpage = pagedir_get_page (t->pagedir, upage);
+  if (f != NULL)
+    {
+      pagedir_clear_page (t->pagedir, upage);
+      frame_free (f, p);
+    }
+  else if (kpage == zero_kpage)
+    unmap_zero (t, p);
+  else if (kpage != NULL)
+    goto done;                  /* Some other shared page. */
+  if (p->swap_sector != SWAP_NONE)
+    {
+      swap_free (p->swap_sector);
+      p->swap_sector = SWAP_NONE;
+    }
+
+  /* The page is a file page only while the frame is had. */
+  p->file = file;
+  p->file_ofs = ofs;
+  p->read_bytes = PGSIZE;
+  f = frame_get_file (p, true);
+  p->file = NULL;
+  p->file_ofs = 0;
+  p->read_bytes = 0;
+  if (f == NULL)
+    goto done;
+  if (!pagedir_set_page (t->pagedir, upage, f->kpage, false))
+    {
+      frame_free (f, p);
+      goto done;
+    }
+  pagedir_set_dirty (t->pagedir, upage, true);
+  frame_unpin (f);
+  success = true;
+
+ done:
+  lock_release (&t->lock);
+  return success;
+}
+
+/* Handles a write by the current thread to its user page
+   containing ADDR that faulted because the page is mapped
+   read-only, by giving its process a writable copy if it shares
+   the page copy-on-write with another process or maps the shared
+   frame of zeros, or by making the mapping writable if it no
+   longer does.  Returns false if the
+   page is not writable at all or memory runs out.  Takes the
+   process's lock. */
+bool
+page_unshare (const void *addr)
+{
+  struct lock *lock = &current_process ()->lock;
+  bool success;
+
+  lock_acquire (lock);
+  success = unshare_page (addr);
+  lock_release (lock);
+  return success;
+}
+
+/* Does page_unshare()'s work with the process's lock held. */
+static bool
+unshare_page (const void *addr)
+{
+  struct process *t = current_process ();
+  struct page *p;
+  struct frame *old, *new;
+
+  if (!is_user_vaddr (addr))
+    return false;
+  p = page_lookup (addr);
+  if (p == NULL || !p->writable)
+    return false;
+
+  if (maps_zero (t, p))
+    {
+      unmap_zero (t, p);
+      return bring_in (t, p, true);
+    }
+
+  /* Evicted since the fault, but only after the process that
+     shared it had copied it or exited. */
+  old = frame_pin (p);
+  if (old == NULL)
+    return load_page (addr, true);
+
+  if (frame_unshare (old, p))
+    {
+      pagedir_set_writable (t->pagedir, p->upage, true);
+      frame_unpin (old);
+      return true;
+    }
+
+  /* P is out of OLD now, so it must not stay mapped to it. */
+  new = frame_alloc (p, true);
+  if (new == NULL)
+    {
+      pagedir_clear_page (t->pagedir, p->upage);
+      frame_unpin (old);
+      return false;
+    }
+  memcpy (new->kpage, old->kpage, PGSIZE);
+  pagedir_clear_page (t->pagedir, p->upage);
+  frame_unpin (old);
+  if (!pagedir_set_page (t->pagedir, p->upage, new->kpage, true))
+    {
+      frame_free (new, p);
+      return false;
+    }
+  pagedir_set_dirty (t->pagedir, p->upage, true);
+  frame_unpin (new);
+  return true;
+}
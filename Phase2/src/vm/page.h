@@ -0,0 +1,70 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "devices/block.h"
+#include "filesys/off_t.h"
+
+struct file;
+struct frame;
+struct process;
+struct thread;
+
+/* Supplemental page table entry: what a user page should hold
+   when it is brought in.  If it has been swapped out, that is
+   the copy in swap at SWAP_SECTOR.  Otherwise the first
+   READ_BYTES bytes come from FILE starting at FILE_OFS, and the
+   rest of the page is zeroed.  A page of a memory-mapped file is
+   written back to FILE, instead of swap, when it is dirty. */
+struct page
+  {
+    struct hash_elem hash_elem;         /* Element in process's pages. */
+    struct process *owner;              /* Process it belongs to. */
+    void *upage;                        /* User virtual address. */
+    bool writable;                      /* Writable by the process? */
+    struct file *file;                  /* File to read from, if any. */
+    off_t file_ofs;                     /* Offset in FILE. */
+    size_t read_bytes;                  /* Bytes to read from FILE. */
+    block_sector_t swap_sector;         /* Swap slot, or SWAP_NONE. */
+    bool writeback;                     /* Memory-mapped file page? */
+    bool fault_around;                  /* Bring in its neighbours
+                                           along with it? */
+    struct frame *frame;                /* Frame holding it, if any. */
+    unsigned last_use;                  /* Owner's cpu_ticks when it
+                                           was last seen used. */
+    struct list_elem frame_elem;        /* Element in frame's pages.
+                                           Both protected by the
+                                           frame table's lock. */
+  };
+
+/* Most bytes the user stack may grow to. */
+extern size_t page_stack_limit;
+
+/* Largest executable segment, in pages, brought in at exec. */
+extern size_t page_populate_max;
+
+/* Use 4 MB pages for large regions of zeros? */
+extern bool page_huge;
+
+void page_init (void);
+bool page_table_init (void);
+void page_table_destroy (void);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_mapping (void *upage, struct file *, off_t ofs,
+                       size_t read_bytes);
+void page_prefetch (void *upage, size_t page_cnt);
+void page_remove (void *upage);
+bool page_is_free (const void *upage);
+bool page_fork (struct thread *parent);
+bool page_in (const void *addr, bool write);
+bool page_read_file (void *upage, struct file *, off_t ofs);
+bool page_unshare (const void *addr);
+bool page_grow_stack (const void *addr, const void *esp);
+void *page_sbrk (intptr_t increment);
+
+#endif /* vm/page.h */
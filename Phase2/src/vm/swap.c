@@ -0,0 +1,318 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <crc32.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <stats.h>
+#include <string.h>
+#include "devices/elevator.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+#include "vm/zswap.h"
+
+/* Sectors per page. */
+#define PAGE_SECTORS (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A swap slot is either the first sector of a page on the swap
+   device or, with this bit set, a slot of the compressed swap
+   cache.  SWAP_NONE is neither. */
+#define ZSWAP_BIT 0x80000000u
+
+/* Returns true if swap slot SECTOR is in the compressed cache. */
+static inline bool
+is_zswap (block_sector_t sector)
+{
+  return sector != SWAP_NONE && (sector & ZSWAP_BIT) != 0;
+}
+
+/* The swap device, or a null pointer if there is none. */
+static struct block *swap_device;
+
+/* Used sectors of swap_device.  Slots are handed out by sector,
+   not by page, so that a batch of pages can go into one run of
+   sectors with a single request. */
+static struct bitmap *swap_map;
+
+/* SWAP_BATCH contiguous kernel pages that a batch of pages is
+   gathered into before it is written. */
+static uint8_t *swap_buffer;
+
+/* Protects swap_map and swap_buffer. */
+static struct lock swap_lock;
+
+#ifndef RELEASE
+/* The crc32() of the page at each sector of swap_device that is
+   the first of a slot, so that a page that comes back different
+   from how it went out is caught.  Left out of release builds. */
+static uint32_t *swap_sums;
+#endif
+
+/* Pages read by swap_in_run() besides the first of each run. */
+static uint64_t readahead_cnt;
+
+static bool write_pages (void *kpages[], size_t cnt,
+                         block_sector_t sectors[]);
+static void record_sum (block_sector_t, const void *page);
+static void check_sum (block_sector_t, const void *page);
+
+/* Initializes the compressed swap cache and the swap area on the
+   BLOCK_SWAP device, if there is one.  Without either, swap_out()
+   always fails. */
+void
+swap_init (void)
+{
+  lock_init_named (&swap_lock, "swap");
+  stats_add_uint64 ("swap", NULL, "readahead", &readahead_cnt);
+  zswap_init ();
+  swap_device = block_get_role (BLOCK_SWAP);
+  if (swap_device == NULL)
+    return;
+
+  swap_map = bitmap_create (block_size (swap_device));
+  swap_buffer = palloc_get_multiple (0, SWAP_BATCH);
+  if (swap_map == NULL || swap_buffer == NULL)
+    PANIC ("swap_init: out of memory");
+#ifndef RELEASE
+  swap_sums = malloc (block_size (swap_device) * sizeof *swap_sums);
+  if (swap_sums == NULL)
+    PANIC ("swap_init: out of memory");
+#endif
+}
+
+/* Writes the CNT pages at KPAGES[] to swap and stores the slot
+   each one went to in SECTORS[].  Each page goes to the
+   compressed swap cache if it compresses well and there is room,
+   and otherwise to the swap device.  Returns true if successful,
+   false if swap is full or missing, in which case nothing is
+   written. */
+bool
+swap_out (void *kpages[], size_t cnt, block_sector_t sectors[])
+{
+  void *disk_kpages[SWAP_BATCH];
+  block_sector_t disk_sectors[SWAP_BATCH];
+  size_t disk_idx[SWAP_BATCH];
+  size_t disk_cnt = 0;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_BATCH);
+
+  for (i = 0; i < cnt; i++)
+    {
+      unsigned slot;
+
+      if (zswap_store (kpages[i], &slot))
+        sectors[i] = slot | ZSWAP_BIT;
+      else
+        {
+          disk_idx[disk_cnt] = i;
+          disk_kpages[disk_cnt++] = kpages[i];
+        }
+    }
+  if (disk_cnt == 0)
+    return true;
+
+  if (!write_pages (disk_kpages, disk_cnt, disk_sectors))
+    {
+      for (i = 0; i < cnt; i++)
+        if (is_zswap (sectors[i]))
+          zswap_free (sectors[i] & ~ZSWAP_BIT);
+      return false;
+    }
+  for (i = 0; i < disk_cnt; i++)
+    sectors[disk_idx[i]] = disk_sectors[i];
+  return true;
+}
+
+/* Writes the CNT pages at KPAGES[] to the swap device and stores
+   the first sector each one went to in SECTORS[].  If a run of
+   sectors for all of them is free, they are gathered into one
+   write; otherwise each page is written by its own request, all
+   of them in flight at once.  Returns true if successful, false
+   if the device is full or missing, in which case nothing is
+   written. */
+static bool
+write_pages (void *kpages[], size_t cnt, block_sector_t sectors[])
+{
+  struct io_request reqs[SWAP_BATCH];
+  struct semaphore done;
+  block_sector_t run;
+  size_t i;
+
+  if (swap_device == NULL)
+    return false;
+
+  lock_acquire (&swap_lock);
+  run = cnt > 1 ? bitmap_alloc (swap_map, cnt * PAGE_SECTORS) : BITMAP_ERROR;
+  if (run != BITMAP_ERROR)
+    {
+      for (i = 0; i < cnt; i++)
+        {
+          memcpy (swap_buffer + i * PGSIZE, kpages[i], PGSIZE);
+          sectors[i] = run + i * PAGE_SECTORS;
+          record_sum (sectors[i], kpages[i]);
+        }
+      block_write_multi (swap_device, run, cnt * PAGE_SECTORS, swap_buffer);
+      lock_release (&swap_lock);
+      return true;
+    }
+
+  for (i = 0; i < cnt; i++)
+    {
+      sectors[i] = bitmap_alloc (swap_map, PAGE_SECTORS);
+      if (sectors[i] == BITMAP_ERROR)
+        {
+          while (i-- > 0)
+            bitmap_set_multiple (swap_map, sectors[i], PAGE_SECTORS, false);
+          lock_release (&swap_lock);
+          return false;
+        }
+    }
+  lock_release (&swap_lock);
+
+  /* Submit every page before waiting for any, so that the disk
+     can take them in its own order. */
+  sema_init (&done, 0);
+  for (i = 0; i < cnt; i++)
+    {
+      record_sum (sectors[i], kpages[i]);
+      reqs[i].write = true;
+      reqs[i].sector = sectors[i];
+      reqs[i].cnt = PAGE_SECTORS;
+      reqs[i].buffer = kpages[i];
+      reqs[i].done = block_wake_sema;
+      reqs[i].aux = &done;
+      block_submit (swap_device, &reqs[i]);
+    }
+  for (i = 0; i < cnt; i++)
+    sema_down (&done);
+  return true;
+}
+
+/* Reads the page stored at SECTOR in swap into KPAGE.  The slot
+   stays in use until swap_free(). */
+void
+swap_in (block_sector_t sector, void *kpage)
+{
+  if (is_zswap (sector))
+    {
+      zswap_load (sector & ~ZSWAP_BIT, kpage);
+      return;
+    }
+  ASSERT (swap_device != NULL);
+
+  block_read_multi (swap_device, sector, PAGE_SECTORS, kpage);
+  check_sum (sector, kpage);
+}
+
+/* Reads the CNT pages stored in the run of slots on the swap
+   device that starts at SECTOR, each one following the last as
+   swap_follows() has it, into KPAGES[], in one request.  The
+   slots stay in use until swap_free(). */
+void
+swap_in_run (block_sector_t sector, void *kpages[], size_t cnt)
+{
+  size_t i;
+
+  ASSERT (cnt > 0 && cnt <= SWAP_BATCH);
+  ASSERT (swap_device != NULL && !is_zswap (sector));
+
+  lock_acquire (&swap_lock);
+  block_read_multi (swap_device, sector, cnt * PAGE_SECTORS, swap_buffer);
+  for (i = 0; i < cnt; i++)
+    {
+      memcpy (kpages[i], swap_buffer + i * PGSIZE, PGSIZE);
+      check_sum (sector + i * PAGE_SECTORS, kpages[i]);
+    }
+  readahead_cnt += cnt - 1;
+  lock_release (&swap_lock);
+}
+
+/* Returns true if swap slot B is the slot right after A on the
+   swap device, so that the two can be read in one request. */
+bool
+swap_follows (block_sector_t a, block_sector_t b)
+{
+  return (a != SWAP_NONE && b != SWAP_NONE && !is_zswap (a) && !is_zswap (b)
+          && b == a + PAGE_SECTORS);
+}
+
+/* Copies the page stored at SECTOR in swap into a new slot and
+   returns the new slot's first sector, or SWAP_NONE if swap is
+   full. */
+block_sector_t
+swap_copy (block_sector_t sector)
+{
+  block_sector_t copy;
+
+  if (is_zswap (sector))
+    {
+      unsigned slot;
+
+      if (zswap_copy (sector & ~ZSWAP_BIT, &slot))
+        return slot | ZSWAP_BIT;
+
+      /* The cache is full: copy the page out to the device. */
+      if (swap_device == NULL)
+        return SWAP_NONE;
+      lock_acquire (&swap_lock);
+      copy = bitmap_alloc (swap_map, PAGE_SECTORS);
+      if (copy != BITMAP_ERROR)
+        {
+          zswap_load (sector & ~ZSWAP_BIT, swap_buffer);
+          record_sum (copy, swap_buffer);
+          block_write_multi (swap_device, copy, PAGE_SECTORS, swap_buffer);
+        }
+      lock_release (&swap_lock);
+      return copy != BITMAP_ERROR ? copy : SWAP_NONE;
+    }
+  ASSERT (swap_device != NULL);
+
+  lock_acquire (&swap_lock);
+  copy = bitmap_alloc (swap_map, PAGE_SECTORS);
+  if (copy != BITMAP_ERROR)
+    {
+      block_read_multi (swap_device, sector, PAGE_SECTORS, swap_buffer);
+      check_sum (sector, swap_buffer);
+      record_sum (copy, swap_buffer);
+      block_write_multi (swap_device, copy, PAGE_SECTORS, swap_buffer);
+    }
+  lock_release (&swap_lock);
+  return copy != BITMAP_ERROR ? copy : SWAP_NONE;
+}
+
+/* Frees the swap slot of the page stored at SECTOR. */
+void
+swap_free (block_sector_t sector)
+{
+  if (is_zswap (sector))
+    {
+      zswap_free (sector & ~ZSWAP_BIT);
+      return;
+    }
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_all (swap_map, sector, PAGE_SECTORS));
+  bitmap_set_multiple (swap_map, sector, PAGE_SECTORS, false);
+  lock_release (&swap_lock);
+}
+
+/* Notes the checksum of PAGE, which goes to the slot at SECTOR. */
+static void
+record_sum (block_sector_t sector UNUSED, const void *page UNUSED)
+{
+#ifndef RELEASE
+  swap_sums[sector] = crc32 (page, PGSIZE);
+#endif
+}
+
+/* Panics if PAGE, just read from the slot at SECTOR, is not what
+   was written there. */
+static void
+check_sum (block_sector_t sector UNUSED, const void *page UNUSED)
+{
+#ifndef RELEASE
+  if (crc32 (page, PGSIZE) != swap_sums[sector])
+    PANIC ("swap slot at sector %"PRDSNu" is corrupt", sector);
+#endif
+}
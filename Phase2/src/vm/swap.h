@@ -0,0 +1,23 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* A swap slot that holds no page.  Other slots are opaque: a page
+   may be on the swap device or in the compressed swap cache. */
+#define SWAP_NONE ((block_sector_t) -1)
+
+/* Most pages swap_out() writes in one request. */
+#define SWAP_BATCH 4
+
+void swap_init (void);
+bool swap_out (void *kpages[], size_t cnt, block_sector_t sectors[]);
+void swap_in (block_sector_t, void *kpage);
+void swap_in_run (block_sector_t, void *kpages[], size_t cnt);
+bool swap_follows (block_sector_t, block_sector_t);
+block_sector_t swap_copy (block_sector_t);
+void swap_free (block_sector_t);
+
+#endif /* vm/swap.h */
@@ -0,0 +1,200 @@
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <lz.h>
+#include <stats.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Compressed swap cache.  swap_out() offers every page here
+   first, and only pages that do not compress well, or that find
+   the cache full, go to the swap device.  Pages of zeros and of
+   repeated words, common in the BSS and in sparse arrays,
+   shrink to a few dozen bytes, so the cache holds many times
+   more pages than it takes memory, and reading one back costs a
+   decompression instead of a disk read.
+
+   The compressed pages are blocks from malloc(), so they come
+   from the kernel pool and not from the user pool that eviction
+   is trying to refill. */
+
+/* Pages that compress to more than this go to the swap device
+   instead: the space saved would not pay for the time. */
+#define MAX_LEN (PGSIZE * 3 / 4)
+
+/* Bytes of cache per slot, so that there are enough slots for
+   pages that compress about this well. */
+#define BYTES_PER_SLOT 128
+
+size_t zswap_kb = 256;
+
+/* A compressed page. */
+struct zslot
+  {
+    void *data;                 /* Compressed bytes, from malloc(). */
+    size_t len;                 /* Number of bytes in DATA. */
+  };
+
+/* Slots, and which of them are in use. */
+static struct zslot *slots;
+static struct bitmap *slot_map;
+
+/* Compressed bytes held, and the most allowed. */
+static size_t used_bytes;
+static size_t max_bytes;
+
+/* Scratch space for compression. */
+static uint16_t hash_table[LZ_HASH_CNT];
+static uint8_t *scratch;
+
+/* Protects all of the above. */
+static struct lock zswap_lock;
+
+/* Statistics. */
+static uint64_t store_cnt;      /* Pages stored. */
+static uint64_t reject_cnt;     /* Pages that did not compress. */
+static uint64_t full_cnt;       /* Pages turned away by a full cache. */
+static uint64_t load_cnt;       /* Pages read back. */
+
+/* Sets up a compressed swap cache of zswap_kb kB. */
+void
+zswap_init (void)
+{
+  size_t slot_cnt;
+
+  lock_init_named (&zswap_lock, "zswap");
+  if (zswap_kb == 0)
+    return;
+
+  max_bytes = zswap_kb * 1024;
+  slot_cnt = max_bytes / BYTES_PER_SLOT;
+  slots = malloc (slot_cnt * sizeof *slots);
+  slot_map = bitmap_create (slot_cnt);
+  scratch = palloc_get_page (0);
+  if (slots == NULL || slot_map == NULL || scratch == NULL)
+    PANIC ("zswap_init: out of memory");
+
+  stats_add_uint64 ("zswap", NULL, "stored", &store_cnt);
+  stats_add_uint64 ("zswap", NULL, "rejected", &reject_cnt);
+  stats_add_uint64 ("zswap", NULL, "full", &full_cnt);
+  stats_add_uint64 ("zswap", NULL, "loaded", &load_cnt);
+  stats_add_size ("zswap", NULL, "bytes", &used_bytes);
+}
+
+/* Takes a free slot and gives it a copy of the LEN bytes at
+   DATA.  Returns the slot's index, or BITMAP_ERROR if the cache
+   is full.  The lock must be held. */
+static size_t
+store (const void *data, size_t len)
+{
+  size_t idx;
+  void *copy;
+
+  ASSERT (lock_held_by_current_thread (&zswap_lock));
+
+  if (used_bytes + len > max_bytes)
+    return BITMAP_ERROR;
+  idx = bitmap_scan_and_flip (slot_map, 0, 1, false);
+  if (idx == BITMAP_ERROR)
+    return BITMAP_ERROR;
+  copy = malloc (len);
+  if (copy == NULL)
+    {
+      bitmap_reset (slot_map, idx);
+      return BITMAP_ERROR;
+    }
+  memcpy (copy, data, len);
+  slots[idx].data = copy;
+  slots[idx].len = len;
+  used_bytes += len;
+  return idx;
+}
+
+/* Compresses the page at KPAGE into the cache and stores its
+   slot in *SLOT.  Returns false, storing nothing, if the page
+   does not compress well or the cache is full or missing. */
+bool
+zswap_store (const void *kpage, unsigned *slot)
+{
+  size_t len, idx;
+
+  if (slots == NULL)
+    return false;
+
+  lock_acquire (&zswap_lock);
+  len = lz_compress (kpage, PGSIZE, scratch, MAX_LEN, hash_table);
+  if (len == 0)
+    {
+      reject_cnt++;
+      lock_release (&zswap_lock);
+      return false;
+    }
+  idx = store (scratch, len);
+  if (idx == BITMAP_ERROR)
+    {
+      full_cnt++;
+      lock_release (&zswap_lock);
+      return false;
+    }
+  store_cnt++;
+  lock_release (&zswap_lock);
+
+  *slot = idx;
+  return true;
+}
+
+/* Decompresses the page in SLOT into KPAGE.  The slot stays in
+   use until zswap_free(). */
+void
+zswap_load (unsigned slot, void *kpage)
+{
+  struct zslot z;
+
+  lock_acquire (&zswap_lock);
+  ASSERT (bitmap_test (slot_map, slot));
+  z = slots[slot];
+  load_cnt++;
+  lock_release (&zswap_lock);
+
+  /* Only the slot's owner frees it, so Z stays valid. */
+  if (lz_decompress (z.data, z.len, kpage, PGSIZE) != PGSIZE)
+    PANIC ("zswap: slot %u is corrupt", slot);
+}
+
+/* Copies the page in SLOT into a new slot and stores the new
+   slot in *COPY.  Returns false if the cache is full. */
+bool
+zswap_copy (unsigned slot, unsigned *copy)
+{
+  size_t idx;
+
+  lock_acquire (&zswap_lock);
+  ASSERT (bitmap_test (slot_map, slot));
+  idx = store (slots[slot].data, slots[slot].len);
+  lock_release (&zswap_lock);
+
+  if (idx == BITMAP_ERROR)
+    return false;
+  *copy = idx;
+  return true;
+}
+
+/* Frees SLOT. */
+void
+zswap_free (unsigned slot)
+{
+  void *data;
+
+  lock_acquire (&zswap_lock);
+  ASSERT (bitmap_test (slot_map, slot));
+  bitmap_reset (slot_map, slot);
+  data = slots[slot].data;
+  used_bytes -= slots[slot].len;
+  lock_release (&zswap_lock);
+
+  free (data);
+}
@@ -0,0 +1,17 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Most memory the compressed swap cache takes, in kB, or 0 for
+   none.  Set with -zswap. */
+extern size_t zswap_kb;
+
+void zswap_init (void);
+bool zswap_store (const void *kpage, unsigned *slot);
+void zswap_load (unsigned slot, void *kpage);
+bool zswap_copy (unsigned slot, unsigned *copy);
+void zswap_free (unsigned slot);
+
+#endif /* vm/zswap.h */